@@ -0,0 +1,99 @@
+// Token-bucket bandwidth scheduler shared by concurrent transfers.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace openscp {
+
+enum class TransferDirection { Upload, Download };
+
+// Paces transfer streams against one shared budget per direction.
+//
+// Every stream opens a Flow and reports the bytes it moved through
+// acquire(), which blocks until those bytes fit into the budget. Budgets
+// are tracked as a virtual finish time (GCRA form of a token bucket), so
+// waits are computed exactly instead of being polled, and idle time only
+// banks a short burst. While several flows share a direction, each one is
+// also paced to its fair share of the budget so large-chunk backends do
+// not starve small-chunk ones. A flow may carry its own cap on top.
+class BandwidthScheduler {
+    public:
+    using Clock = std::chrono::steady_clock;
+
+    // One transfer stream. Closing (destroying) it releases its fair share.
+    class Flow {
+        public:
+        ~Flow();
+        Flow(const Flow &) = delete;
+        Flow &operator=(const Flow &) = delete;
+
+        TransferDirection direction() const { return dir_; }
+        // Per-flow cap in bytes/s; 0 = only the shared budget applies.
+        void setRateLimit(std::uint64_t bytesPerSec) {
+            rateLimit_.store(bytesPerSec);
+        }
+        std::uint64_t rateLimit() const { return rateLimit_.load(); }
+
+        private:
+        friend class BandwidthScheduler;
+        Flow(BandwidthScheduler *owner, TransferDirection dir)
+            : owner_(owner), dir_(dir) {}
+
+        BandwidthScheduler *owner_;
+        TransferDirection dir_;
+        std::atomic<std::uint64_t> rateLimit_{0};
+        // Virtual finish times (guarded by the owner's mutex)
+        Clock::time_point capTat_{};
+        Clock::time_point fairTat_{};
+    };
+
+    BandwidthScheduler() = default;
+    BandwidthScheduler(const BandwidthScheduler &) = delete;
+    BandwidthScheduler &operator=(const BandwidthScheduler &) = delete;
+
+    // Shared budget for a direction in bytes/s; 0 = unlimited.
+    void setRate(TransferDirection dir, std::uint64_t bytesPerSec);
+    std::uint64_t rate(TransferDirection dir) const;
+
+    // Register a stream. The scheduler must outlive the returned flow.
+    std::shared_ptr<Flow> openFlow(TransferDirection dir);
+
+    // Charge `bytes` to the flow and wait until they fit the budgets.
+    // Returns false if shouldCancel() turned true while waiting.
+    bool acquire(Flow &flow, std::size_t bytes,
+                 const std::function<bool()> &shouldCancel = {});
+
+    // Idle time that may be spent later as a burst.
+    static constexpr std::chrono::milliseconds kBurst{50};
+    // Cancellation is polled at least this often while waiting.
+    static constexpr std::chrono::milliseconds kCancelPoll{20};
+
+    private:
+    struct Bucket {
+        std::atomic<std::uint64_t> rate{0};
+        Clock::time_point tat{};
+        int activeFlows = 0;
+    };
+
+    Bucket &bucket(TransferDirection dir) {
+        return dir == TransferDirection::Upload ? upload_ : download_;
+    }
+    const Bucket &bucket(TransferDirection dir) const {
+        return dir == TransferDirection::Upload ? upload_ : download_;
+    }
+    void closeFlow(Flow &flow);
+    Clock::time_point reserveLocked(Flow &flow, std::size_t bytes,
+                                    Clock::time_point now);
+
+    mutable std::mutex mtx_; // protects virtual times and flow counts
+    Bucket upload_;
+    Bucket download_;
+};
+
+} // namespace openscp
@@ -0,0 +1,165 @@
+// SftpClient decorator that serves directory listings from a ListingCache.
+#pragma once
+#include "ListingCache.hpp"
+#include "SftpClient.hpp"
+
+#include <functional>
+#include <memory>
+
+namespace openscp {
+
+// Wraps a connected backend. list() answers from the cache while the entry
+// is fresh and refills it otherwise; every mutating call invalidates the
+// directories it touches. Connections created via newConnectionLike() are
+// wrapped with the same cache, so transfer workers keep it coherent too.
+class CachingSftpClient : public SftpClient {
+    public:
+    CachingSftpClient(std::unique_ptr<SftpClient> inner,
+                      std::shared_ptr<ListingCache> cache);
+    ~CachingSftpClient() override = default;
+
+    const std::shared_ptr<ListingCache> &cache() const { return cache_; }
+    SftpClient *inner() const { return inner_.get(); }
+
+    // Called with each path a mutating call through this client may have
+    // changed, after the cache was updated. Not carried over to
+    // newConnectionLike(), so other session caches can follow changes made
+    // from the panel without reacting to their own workers.
+    using MutationHook = std::function<void(const std::string &path)>;
+    void setMutationHook(MutationHook hook) { hook_ = std::move(hook); }
+
+    Protocol protocol() const override { return inner_->protocol(); }
+    ProtocolCapabilities capabilities() const override {
+        return inner_->capabilities();
+    }
+
+    bool connect(const SessionOptions &opt, std::string &err) override;
+    void disconnect() override { inner_->disconnect(); }
+    void interrupt() override { inner_->interrupt(); }
+    bool isConnected() const override { return inner_->isConnected(); }
+    bool negotiatedAlgorithms(SshAlgorithms &out) const override {
+        return inner_->negotiatedAlgorithms(out);
+    }
+    bool connectTimings(ConnectTimings &out) const override {
+        return inner_->connectTimings(out);
+    }
+    bool networkTuning(NetworkTuning &out) const override {
+        return inner_->networkTuning(out);
+    }
+    bool ping(std::uint32_t &rtt_ms, std::string &err) override {
+        return inner_->ping(rtt_ms, err);
+    }
+
+    bool list(const std::string &remote_path, std::vector<FileInfo> &out,
+              std::string &err) override;
+    // Streams through to the backend; listings up to kMaxStreamedCacheEntries
+    // are kept for the cache on the way.
+    bool listStream(const std::string &remote_path,
+                    const ListBatchCB &onBatch, std::string &err) override;
+    static constexpr std::size_t kMaxStreamedCacheEntries = 50000;
+    bool listTree(const std::string &remote_dir, const TreeEntryCB &onEntry,
+                  std::string &err) override {
+        return inner_->listTree(remote_dir, onEntry, err);
+    }
+    bool findEntries(const std::string &remote_dir, const FindOptions &filter,
+                     const FindEntryCB &onEntry, bool &partial,
+                     std::string &err,
+                     std::function<bool()> shouldCancel) override {
+        return inner_->findEntries(remote_dir, filter, onEntry, partial, err,
+                                   std::move(shouldCancel));
+    }
+
+    bool get(const std::string &remote, const std::string &local,
+             std::string &err,
+             std::function<void(std::size_t, std::size_t)> progress,
+             std::function<bool()> shouldCancel, bool resume) override;
+    bool getRange(const std::string &remote, const std::string &local,
+                  std::uint64_t offset, std::uint64_t length, std::string &err,
+                  std::function<void(std::size_t, std::size_t)> progress,
+                  std::function<bool()> shouldCancel) override {
+        return inner_->getRange(remote, local, offset, length, err,
+                                std::move(progress), std::move(shouldCancel));
+    }
+
+    bool put(const std::string &local, const std::string &remote,
+             std::string &err,
+             std::function<void(std::size_t, std::size_t)> progress,
+             std::function<bool()> shouldCancel, bool resume) override;
+
+    bool readStream(const std::string &remote, std::uint64_t offset,
+                    const ReadSink &sink, std::string &err,
+                    std::function<bool()> shouldCancel = {}) override {
+        return inner_->readStream(remote, offset, sink, err,
+                                  std::move(shouldCancel));
+    }
+    bool writeStream(const std::string &remote, bool append,
+                     const WriteSource &source, std::string &err,
+                     std::function<bool()> shouldCancel = {}) override;
+
+    bool putDelta(const std::string &local, const std::string &remote,
+                  std::string &err,
+                  std::function<void(std::size_t, std::size_t)> progress,
+                  std::function<bool()> shouldCancel) override;
+
+    bool putBatch(const std::string &local_root,
+                  const std::vector<std::string> &relative_paths,
+                  const std::string &remote_root, std::string &err,
+                  const BatchFileCB &onFile,
+                  std::function<bool()> shouldCancel) override;
+    bool getBatch(const std::string &remote_root,
+                  const std::vector<std::string> &relative_paths,
+                  const std::string &local_root, std::string &err,
+                  const BatchFileCB &onFile,
+                  std::function<bool()> shouldCancel) override {
+        return inner_->getBatch(remote_root, relative_paths, local_root, err,
+                                onFile, std::move(shouldCancel));
+    }
+
+    bool exists(const std::string &remote_path, bool &isDir,
+                std::string &err) override;
+
+    bool stat(const std::string &remote_path, FileInfo &info,
+              std::string &err) override;
+
+    bool chmod(const std::string &remote_path, std::uint32_t mode,
+               std::string &err) override;
+
+    bool chmodTree(const std::string &remote_path, std::uint32_t mode,
+                   std::string &err,
+                   std::function<bool()> shouldCancel) override;
+
+    bool chown(const std::string &remote_path, std::uint32_t uid,
+               std::uint32_t gid, std::string &err) override;
+
+    bool setTimes(const std::string &remote_path, std::uint64_t atime,
+                  std::uint64_t mtime, std::string &err) override;
+
+    bool mkdir(const std::string &remote_dir, std::string &err,
+               unsigned int mode = 0755) override;
+
+    bool removeFile(const std::string &remote_path, std::string &err) override;
+
+    bool removeDir(const std::string &remote_dir, std::string &err) override;
+
+    bool rename(const std::string &from, const std::string &to,
+                std::string &err, bool overwrite = false) override;
+
+    bool copyRemote(const std::string &from, const std::string &to,
+                    std::string &err, bool overwrite,
+                    std::function<bool()> shouldCancel) override;
+
+    std::unique_ptr<SftpClient> newConnectionLike(const SessionOptions &opt,
+                                                  std::string &err) override;
+
+    private:
+    void touched(const std::string &path) const {
+        if (hook_)
+            hook_(path);
+    }
+
+    std::unique_ptr<SftpClient> inner_;
+    std::shared_ptr<ListingCache> cache_;
+    MutationHook hook_;
+};
+
+} // namespace openscp
@@ -0,0 +1,82 @@
+// Chunked SHA-256 digests for verifying very large files.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openscp {
+
+// SHA-256 of one chunk. Leaves are plain SHA-256 of the chunk bytes, so a
+// server can produce the same list with `split -b <chunk> --filter=sha256sum`.
+using ChunkDigest = std::array<unsigned char, 32>;
+
+// Digests of the consecutive `chunk_size` pieces of a file, in order; only
+// the last one may cover fewer bytes.
+struct ChunkDigests {
+    std::uint64_t chunk_size = 0;
+    std::vector<ChunkDigest> chunks;
+};
+
+// Chunks are at least 4 MiB; larger files use larger chunks so the digest
+// list (and the server's answer) stays small.
+constexpr std::uint64_t kMinIntegrityChunkSize = 4 * 1024 * 1024;
+constexpr std::uint64_t kMaxIntegrityChunks = 16384;
+
+std::uint64_t integrityChunkSize(std::uint64_t fileSize);
+
+// Digest [0, length) of a local file in `chunkSize` pieces. Chunks are
+// handed out to `threads` workers (0: one per core), each reading its own
+// ranges, so a 100 GB file is not bound to a single core. `shouldCancel`
+// is only polled on the calling thread.
+bool hashLocalChunks(const std::string &path, std::uint64_t length,
+                     std::uint64_t chunkSize, std::vector<ChunkDigest> &out,
+                     std::string &err, unsigned threads = 0,
+                     const std::function<bool()> &shouldCancel = {});
+
+// Root of the binary hash tree over `chunks`: each parent is
+// SHA-256(0x01 || left || right) and an odd node moves up unchanged. The
+// root of a single chunk is that chunk's digest; of none, SHA-256("").
+ChunkDigest chunkTreeRoot(const std::vector<ChunkDigest> &chunks);
+
+// Indexes of the chunks of `have` that `want` lacks or digests differently.
+std::vector<std::size_t> mismatchedChunks(const std::vector<ChunkDigest> &have,
+                                          const std::vector<ChunkDigest> &want);
+
+// Streaming counterpart of hashLocalChunks() for data that arrives in
+// order: `onChunk` receives each digest as soon as its chunk is complete.
+class ChunkHasher {
+    public:
+    ChunkHasher(std::uint64_t chunkSize,
+                std::function<void(const ChunkDigest &)> onChunk);
+    ~ChunkHasher();
+    ChunkHasher(const ChunkHasher &) = delete;
+    ChunkHasher &operator=(const ChunkHasher &) = delete;
+
+    void update(const void *data, std::size_t n);
+    // Emit the trailing partial chunk, if any. False if hashing failed.
+    bool finish();
+    bool ok() const;
+
+    private:
+    struct State;
+    std::unique_ptr<State> s_;
+};
+
+// Per-chunk digests of a download are kept in a text file next to its
+// .part, one hex digest per line after a header naming the chunk size, so
+// a resume can tell which chunks still hold the right bytes.
+std::string chunkSidecarPath(const std::string &partPath);
+bool saveChunkDigests(const std::string &path, const ChunkDigests &digests,
+                      std::string &err);
+bool appendChunkDigest(const std::string &path, const ChunkDigest &digest,
+                       std::string &err);
+// A torn last line (crash during an append) ends the list early.
+bool loadChunkDigests(const std::string &path, ChunkDigests &out,
+                      std::string &err);
+
+} // namespace openscp
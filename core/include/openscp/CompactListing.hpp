@@ -0,0 +1,78 @@
+// Struct-of-arrays storage for large directory listings.
+#pragma once
+#include "SftpTypes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace openscp {
+
+// Compact form of a std::vector<FileInfo>. All names live back to back in
+// one pool and every attribute has its own array, so a listing costs a few
+// allocations in total instead of one or two per entry (~37 bytes per entry
+// plus the name bytes). Entries are addressed by index and never reordered;
+// callers keep their own index permutation for sorting and filtering.
+// Producers may attach a precomputed sort key to every entry (for example a
+// case-folded name) so consumers can sort with plain byte comparisons.
+// Pool offsets are 64-bit, so neither pool wraps past 4 GiB.
+class CompactListing {
+    public:
+    std::size_t size() const { return nameEnd_.size(); }
+    bool empty() const { return nameEnd_.empty(); }
+    void reserve(std::size_t entries, std::size_t nameBytes = 0);
+    void clear();
+    void shrinkToFit();
+
+    void push_back(const FileInfo &f);
+    void push_back(const FileInfo &f, std::string_view sortKey);
+    void append(const std::vector<FileInfo> &entries);
+    void append(const CompactListing &other);
+
+    std::string_view name(std::size_t i) const {
+        const std::uint64_t begin = i ? nameEnd_[i - 1] : 0;
+        return std::string_view(pool_.data() + begin, nameEnd_[i] - begin);
+    }
+    bool isDir(std::size_t i) const { return (flags_[i] & kDir) != 0; }
+    bool hasSize(std::size_t i) const { return (flags_[i] & kHasSize) != 0; }
+    std::uint64_t fileSize(std::size_t i) const { return size_[i]; }
+    std::uint64_t mtime(std::size_t i) const { return mtime_[i]; }
+    std::uint32_t mode(std::size_t i) const { return mode_[i]; }
+    std::uint32_t uid(std::size_t i) const { return uid_[i]; }
+    std::uint32_t gid(std::size_t i) const { return gid_[i]; }
+
+    // True when every entry carries a sort key.
+    bool hasSortKeys() const {
+        return !nameEnd_.empty() && keyEnd_.size() == nameEnd_.size();
+    }
+    std::string_view sortKey(std::size_t i) const {
+        const std::uint64_t begin = i ? keyEnd_[i - 1] : 0;
+        return std::string_view(keyPool_.data() + begin, keyEnd_[i] - begin);
+    }
+
+    FileInfo at(std::size_t i) const;
+    // Entry i of this listing equals entry j of `other` (all fields).
+    bool sameEntry(std::size_t i, const CompactListing &other,
+                   std::size_t j) const;
+
+    // Heap bytes held by the arrays (capacity, not size).
+    std::size_t memoryUsage() const;
+
+    private:
+    enum : std::uint8_t { kDir = 1u << 0, kHasSize = 1u << 1 };
+
+    std::string pool_;                   // all names, not NUL-separated
+    std::vector<std::uint64_t> nameEnd_; // end offset of name i in pool_
+    std::vector<std::uint64_t> size_;
+    std::vector<std::uint64_t> mtime_;
+    std::vector<std::uint32_t> mode_;
+    std::vector<std::uint32_t> uid_;
+    std::vector<std::uint32_t> gid_;
+    std::vector<std::uint8_t> flags_;
+    std::string keyPool_;               // sort keys, same layout as pool_
+    std::vector<std::uint64_t> keyEnd_; // empty when keys are not used
+};
+
+} // namespace openscp
@@ -0,0 +1,80 @@
+// AIMD controller for the number of concurrent transfers.
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace openscp {
+
+// What the transfer queue observed over one control interval.
+struct ConcurrencySample {
+    std::chrono::milliseconds interval{0};
+    std::uint64_t bytes = 0;    // moved by all tasks during the interval
+    std::uint32_t completed = 0; // tasks that finished in the interval
+    // Tasks that failed with a network-class error (timeouts, resets):
+    // the signal that the server or link is overloaded.
+    std::uint32_t failed = 0;
+    // Mean duration of the completed tasks; 0 when none completed.
+    std::chrono::milliseconds meanTaskTime{0};
+    int active = 0;       // tasks running at the end of the interval
+    bool backlog = false; // queued tasks were waiting for a worker
+    // Transport round trip measured during the interval (SftpClient::ping);
+    // 0 when none was.
+    std::chrono::milliseconds rtt{0};
+};
+
+// Tunes the worker limit from observed goodput, AIMD style.
+//
+// While the queue is saturated (a backlog and every slot busy) the limit
+// is probed one worker at a time: a probe is kept only if aggregate bytes/s
+// rose by at least kProbeGain, otherwise it is undone and probing pauses.
+// Network errors or task times inflating without any goodput gain are
+// treated as contention and cut the limit multiplicatively. So is a
+// round trip inflated well above the lowest one seen: the link's queues
+// are filling, and no probe starts while it lasts. The limit always stays
+// within [minLimit, maxLimit].
+class ConcurrencyController {
+    public:
+    static constexpr double kProbeGain = 0.05;
+    static constexpr double kDecrease = 0.7;
+    // Intervals without probing after a decrease or a failed probe.
+    static constexpr int kHoldIntervals = 5;
+    // A probe is judged this many intervals after it took effect, so new
+    // sessions have connected.
+    static constexpr int kProbeSettleIntervals = 2;
+    // A task-time increase of this factor counts as contention.
+    static constexpr double kTaskTimeInflation = 2.0;
+    // A round trip this many times the lowest one, and at least
+    // kRttSlackMs above it, counts as queueing delay.
+    static constexpr double kRttInflation = 2.0;
+    static constexpr int kRttSlackMs = 20;
+
+    ConcurrencyController(int minLimit, int maxLimit, int initial);
+
+    void setBounds(int minLimit, int maxLimit);
+    int minLimit() const { return min_; }
+    int maxLimit() const { return max_; }
+    int limit() const { return limit_; }
+
+    // Feed one interval; returns the (possibly changed) limit.
+    int update(const ConcurrencySample &sample);
+
+    private:
+    void decrease();
+
+    int min_;
+    int max_;
+    int limit_;
+    int hold_ = 0;
+    // Probe in flight: limit before it, goodput then, intervals left.
+    int probeFrom_ = 0;
+    double probeBaseRate_ = 0.0;
+    int probeSettle_ = 0;
+    // Smoothed goodput (bytes/s) and task time at the current limit
+    double rate_ = 0.0;
+    double taskMs_ = 0.0;
+    // Lowest round trip seen: the path's delay without our queues
+    double minRttMs_ = 0.0;
+};
+
+} // namespace openscp
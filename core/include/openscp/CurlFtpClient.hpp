@@ -3,10 +3,13 @@
 #include "SftpClient.hpp"
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 
 namespace openscp {
 
+class CurlHandleCache;
+
 class CurlFtpClient : public SftpClient {
     public:
     explicit CurlFtpClient(Protocol protocol = Protocol::Ftp);
@@ -21,9 +24,13 @@ class CurlFtpClient : public SftpClient {
     void disconnect() override;
     void interrupt() override;
     bool isConnected() const override;
+    // NOOP on the reused control connection.
+    bool ping(std::uint32_t &rtt_ms, std::string &err) override;
 
     bool list(const std::string &remote_path, std::vector<FileInfo> &out,
               std::string &err) override;
+    bool listStream(const std::string &remote_path,
+                    const ListBatchCB &onBatch, std::string &err) override;
 
     bool get(const std::string &remote, const std::string &local,
              std::string &err,
@@ -35,6 +42,13 @@ class CurlFtpClient : public SftpClient {
              std::function<void(std::size_t, std::size_t)> progress,
              std::function<bool()> shouldCancel, bool resume) override;
 
+    bool readStream(const std::string &remote, std::uint64_t offset,
+                    const ReadSink &sink, std::string &err,
+                    std::function<bool()> shouldCancel = {}) override;
+    bool writeStream(const std::string &remote, bool append,
+                     const WriteSource &source, std::string &err,
+                     std::function<bool()> shouldCancel = {}) override;
+
     bool exists(const std::string &remote_path, bool &isDir,
                 std::string &err) override;
 
@@ -63,12 +77,25 @@ class CurlFtpClient : public SftpClient {
     std::unique_ptr<SftpClient> newConnectionLike(const SessionOptions &opt,
                                                   std::string &err) override;
 
+    // Optional commands advertised by the server's FEAT reply.
+    struct Features {
+        bool known = false; // FEAT was answered
+        bool mlst = false;
+        bool size = false;
+        bool mdtm = false;
+    };
+    // Probed once per connect().
+    Features features() const;
+
     private:
     Protocol protocol_ = Protocol::Ftp;
     mutable std::mutex stateMutex_;
     SessionOptions options_{};
     bool connected_ = false;
+    Features features_{};
     std::atomic<bool> interrupted_{false};
+    // Reusable easy handle (keeps the control connection between calls)
+    std::shared_ptr<CurlHandleCache> handles_;
 };
 
 } // namespace openscp
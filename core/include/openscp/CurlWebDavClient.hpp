@@ -3,13 +3,16 @@
 #include "SftpClient.hpp"
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 
 namespace openscp {
 
+class CurlHandleCache;
+
 class CurlWebDavClient : public SftpClient {
     public:
-    CurlWebDavClient() = default;
+    CurlWebDavClient();
     ~CurlWebDavClient() override = default;
 
     Protocol protocol() const override { return Protocol::WebDav; }
@@ -21,9 +24,17 @@ class CurlWebDavClient : public SftpClient {
     void disconnect() override;
     void interrupt() override;
     bool isConnected() const override;
+    // OPTIONS request on the reused connection.
+    bool ping(std::uint32_t &rtt_ms, std::string &err) override;
 
     bool list(const std::string &remote_path, std::vector<FileInfo> &out,
               std::string &err) override;
+    bool listStream(const std::string &remote_path,
+                    const ListBatchCB &onBatch, std::string &err) override;
+
+    // Depth: infinity PROPFIND where allowed, else a parallel Depth: 1 walk.
+    bool listTree(const std::string &remote_dir, const TreeEntryCB &onEntry,
+                  std::string &err) override;
 
     bool get(const std::string &remote, const std::string &local,
              std::string &err,
@@ -35,6 +46,13 @@ class CurlWebDavClient : public SftpClient {
              std::function<void(std::size_t, std::size_t)> progress,
              std::function<bool()> shouldCancel, bool resume) override;
 
+    bool readStream(const std::string &remote, std::uint64_t offset,
+                    const ReadSink &sink, std::string &err,
+                    std::function<bool()> shouldCancel = {}) override;
+    bool writeStream(const std::string &remote, bool append,
+                     const WriteSource &source, std::string &err,
+                     std::function<bool()> shouldCancel = {}) override;
+
     bool exists(const std::string &remote_path, bool &isDir,
                 std::string &err) override;
 
@@ -60,6 +78,10 @@ class CurlWebDavClient : public SftpClient {
     bool rename(const std::string &from, const std::string &to,
                 std::string &err, bool overwrite = false) override;
 
+    bool copyRemote(const std::string &from, const std::string &to,
+                    std::string &err, bool overwrite,
+                    std::function<bool()> shouldCancel) override;
+
     std::unique_ptr<SftpClient> newConnectionLike(const SessionOptions &opt,
                                                   std::string &err) override;
 
@@ -68,6 +90,8 @@ class CurlWebDavClient : public SftpClient {
     SessionOptions options_{};
     bool connected_ = false;
     std::atomic<bool> interrupted_{false};
+    // Reusable easy handle (keeps the HTTP connection between requests)
+    std::shared_ptr<CurlHandleCache> handles_;
 };
 
 } // namespace openscp
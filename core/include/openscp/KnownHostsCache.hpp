@@ -0,0 +1,50 @@
+// Parsed known_hosts files shared by every connection of the process.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace openscp {
+
+// Whether a known_hosts line names one of `tokens`, either plainly or as
+// an OpenSSH hashed name (|1|salt|hmac). Comments and blank lines never
+// match; a leading @marker is skipped.
+bool knownHostsLineMatches(const std::string &line,
+                           const std::vector<std::string> &tokens);
+
+// Keeps each known_hosts file parsed in memory with its plain names
+// indexed, so a connect looks up only the lines of its host instead of
+// re-reading a large managed file. A file is parsed again when its size
+// or mtime changes; writers in this process also invalidate it. Hashed
+// names are matched once per host and remembered with the file version.
+class KnownHostsCache {
+    public:
+    static KnownHostsCache &shared();
+
+    // Lines of `path` that may describe host:port, in file order. False,
+    // with `err` set, when the file cannot be read.
+    bool linesFor(const std::string &path, const std::string &host,
+                  std::uint16_t port, std::vector<std::string> &out,
+                  std::string &err);
+    // `path` was written by this process.
+    void invalidate(const std::string &path);
+    void clear();
+
+    // Files parsed so far, including re-parses after a change.
+    std::uint64_t loads() const;
+
+    private:
+    struct File;
+
+    std::shared_ptr<File> snapshot(const std::string &path, std::string &err);
+
+    mutable std::mutex mtx_; // protects all fields below
+    std::unordered_map<std::string, std::shared_ptr<File>> files_;
+    std::uint64_t loads_ = 0;
+};
+
+} // namespace openscp
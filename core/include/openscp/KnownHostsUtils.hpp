@@ -1,14 +1,55 @@
 // known_hosts helper utilities shared by core and UI layers.
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace openscp {
 
+// Every writer below holds an exclusive lock on `<khPath>.lock` for the
+// duration of its read-modify-write, so concurrent connections (and other
+// OpenSCP processes) never lose each other's updates. The lock file is
+// created next to known_hosts on first write and left in place.
+
+// Append one OpenSSH-format entry. Only the new line is written and
+// synced; the existing file is never rewritten. The file (and its 0700
+// parent directory) is created when missing.
+bool AppendKnownHostLine(const std::string &khPath, const std::string &line,
+                         std::string &err);
+
+// Entries to drop for host:port: on port 22 "host" and "[host]:22",
+// otherwise "[host]:port", in plain or hashed form. A non-empty
+// `key_type` (e.g. "ssh-ed25519") limits the removal to that key type.
+struct KnownHostTarget {
+    std::string host;
+    std::uint16_t port = 22;
+    std::string key_type;
+};
+
+// Remove the entries of all `targets` with one read and at most one atomic
+// rewrite of the file. `removed` receives the number of lines dropped.
+bool RemoveKnownHostEntries(const std::string &khPath,
+                            const std::vector<KnownHostTarget> &targets,
+                            std::string &err, std::size_t *removed = nullptr);
+
+// Remove the entries of `targets` and append `line` under a single lock
+// and one atomic rewrite, so no other writer sees the file in between.
+// The file must exist.
+bool ReplaceKnownHostEntries(const std::string &khPath,
+                             const std::vector<KnownHostTarget> &targets,
+                             const std::string &line, std::string &err);
+
 // Remove a known_hosts entry for host:port and rewrite the file atomically.
 // Returns true when the operation completes without fatal errors.
 bool RemoveKnownHostEntry(const std::string &khPath, const std::string &host,
                           std::uint16_t port, std::string &err);
 
+// Atomic full rewrite that drops repeated identical entries (as appends
+// can leave behind) and blank lines; comments are kept. `dropped` receives
+// the number of lines removed. Nothing is written when nothing changes.
+bool CompactKnownHosts(const std::string &khPath, std::string &err,
+                       std::size_t *dropped = nullptr);
+
 } // namespace openscp
@@ -20,6 +20,15 @@ class Libssh2ScpClient : public SftpClient {
     void disconnect() override;
     void interrupt() override;
     bool isConnected() const override;
+    bool negotiatedAlgorithms(SshAlgorithms &out) const override {
+        return delegate_.negotiatedAlgorithms(out);
+    }
+    bool connectTimings(ConnectTimings &out) const override {
+        return delegate_.connectTimings(out);
+    }
+    bool networkTuning(NetworkTuning &out) const override {
+        return delegate_.networkTuning(out);
+    }
 
     bool list(const std::string &remote_path, std::vector<FileInfo> &out,
               std::string &err) override;
@@ -34,6 +43,24 @@ class Libssh2ScpClient : public SftpClient {
              std::function<void(std::size_t, std::size_t)> progress,
              std::function<bool()> shouldCancel, bool resume) override;
 
+    bool putBatch(const std::string &local_root,
+                  const std::vector<std::string> &relative_paths,
+                  const std::string &remote_root, std::string &err,
+                  const BatchFileCB &onFile,
+                  std::function<bool()> shouldCancel) override;
+
+    bool getBatch(const std::string &remote_root,
+                  const std::vector<std::string> &relative_paths,
+                  const std::string &local_root, std::string &err,
+                  const BatchFileCB &onFile,
+                  std::function<bool()> shouldCancel) override;
+
+    // Runs on the shared SSH transport like the archive batches.
+    bool findEntries(const std::string &remote_dir, const FindOptions &filter,
+                     const FindEntryCB &onEntry, bool &partial,
+                     std::string &err,
+                     std::function<bool()> shouldCancel) override;
+
     bool exists(const std::string &remote_path, bool &isDir,
                 std::string &err) override;
 
@@ -72,6 +99,13 @@ class Libssh2ScpClient : public SftpClient {
         std::function<void(std::size_t, std::size_t)> progress,
         std::function<bool()> shouldCancel);
     bool sftpFallbackEnabled() const;
+    LocalIoOptions localIoOptions() const;
+    // Large files: parallel SFTP range readers on this session's transport.
+    bool getViaParallelSftpRanges(
+        const std::string &remote, const std::string &local,
+        std::uint64_t total, std::string &err,
+        const std::function<void(std::size_t, std::size_t)> &progress,
+        const std::function<bool()> &shouldCancel);
 
     Libssh2SftpClient delegate_;
     std::optional<SessionOptions> sessionOptions_;
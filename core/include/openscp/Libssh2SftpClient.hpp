@@ -2,8 +2,12 @@
 // Encapsulates the SSH session, SFTP channel, and TCP socket.
 #pragma once
 #include "KnownHostsUtils.hpp"
+#include "LocalFileIO.hpp"
 #include "SftpClient.hpp"
+#include <atomic>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -14,6 +18,14 @@ struct _LIBSSH2_SFTP_HANDLE;
 
 namespace openscp {
 
+struct SharedSshTransport;
+class TransportLock;
+
+// SFTP channels opened on one multiplexed transport, the connecting client's
+// own included (SessionOptions::ssh_multiplex). Kept below OpenSSH's default
+// MaxSessions (10) so exec channels (hashing, tar batches) still fit.
+inline constexpr int kMaxSftpChannelsPerTransport = 6;
+
 class Libssh2SftpClient : public SftpClient {
     public:
     Libssh2SftpClient();
@@ -31,20 +43,56 @@ class Libssh2SftpClient : public SftpClient {
     void disconnect() override;
     void interrupt() override;
     bool isConnected() const override { return connected_; }
+    bool negotiatedAlgorithms(SshAlgorithms &out) const override;
+    bool connectTimings(ConnectTimings &out) const override;
+    bool networkTuning(NetworkTuning &out) const override;
+    bool ping(std::uint32_t &rtt_ms, std::string &err) override;
 
     bool list(const std::string &remote_path, std::vector<FileInfo> &out,
               std::string &err) override;
+    bool listStream(const std::string &remote_path,
+                    const ListBatchCB &onBatch, std::string &err) override;
 
     bool get(const std::string &remote, const std::string &local,
              std::string &err,
              std::function<void(std::size_t, std::size_t)> progress,
              std::function<bool()> shouldCancel, bool resume) override;
 
+    bool getRange(const std::string &remote, const std::string &local,
+                  std::uint64_t offset, std::uint64_t length, std::string &err,
+                  std::function<void(std::size_t, std::size_t)> progress,
+                  std::function<bool()> shouldCancel) override;
+
+    // Pipelined like get()/put(), without a local file.
+    bool readStream(const std::string &remote, std::uint64_t offset,
+                    const ReadSink &sink, std::string &err,
+                    std::function<bool()> shouldCancel) override;
+    bool writeStream(const std::string &remote, bool append,
+                     const WriteSource &source, std::string &err,
+                     std::function<bool()> shouldCancel) override;
+
     bool put(const std::string &local, const std::string &remote,
              std::string &err,
              std::function<void(std::size_t, std::size_t)> progress,
              std::function<bool()> shouldCancel, bool resume) override;
 
+    bool putDelta(const std::string &local, const std::string &remote,
+                  std::string &err,
+                  std::function<void(std::size_t, std::size_t)> progress,
+                  std::function<bool()> shouldCancel) override;
+
+    bool putBatch(const std::string &local_root,
+                  const std::vector<std::string> &relative_paths,
+                  const std::string &remote_root, std::string &err,
+                  const BatchFileCB &onFile,
+                  std::function<bool()> shouldCancel) override;
+
+    bool getBatch(const std::string &remote_root,
+                  const std::vector<std::string> &relative_paths,
+                  const std::string &local_root, std::string &err,
+                  const BatchFileCB &onFile,
+                  std::function<bool()> shouldCancel) override;
+
     bool exists(const std::string &remote_path, bool &isDir,
                 std::string &err) override;
 
@@ -54,6 +102,18 @@ class Libssh2SftpClient : public SftpClient {
     bool chmod(const std::string &remote_path, std::uint32_t mode,
                std::string &err) override;
 
+    // `chmod -R` over an exec channel.
+    bool chmodTree(const std::string &remote_path, std::uint32_t mode,
+                   std::string &err,
+                   std::function<bool()> shouldCancel) override;
+
+    // find(1) over an exec channel, NUL-separated output parsed as it
+    // streams in.
+    bool findEntries(const std::string &remote_dir, const FindOptions &filter,
+                     const FindEntryCB &onEntry, bool &partial,
+                     std::string &err,
+                     std::function<bool()> shouldCancel) override;
+
     bool chown(const std::string &remote_path, std::uint32_t uid,
                std::uint32_t gid, std::string &err) override;
 
@@ -70,12 +130,19 @@ class Libssh2SftpClient : public SftpClient {
     bool rename(const std::string &from, const std::string &to,
                 std::string &err, bool overwrite = false) override;
 
+    // `cp -Rp` over an exec channel: libssh2 cannot send the SFTP
+    // copy-file/copy-data extension requests.
+    bool copyRemote(const std::string &from, const std::string &to,
+                    std::string &err, bool overwrite,
+                    std::function<bool()> shouldCancel) override;
+
     std::unique_ptr<SftpClient> newConnectionLike(const SessionOptions &opt,
                                                   std::string &err) override;
 
     // Exposed for protocol adapters that share the authenticated SSH transport
     // (for example, SCP channel operations).
     _LIBSSH2_SESSION *sessionHandle() const { return session_; }
+    int socketHandle() const { return sock_; }
 
     private:
     bool connected_ = false;
@@ -84,6 +151,26 @@ class Libssh2SftpClient : public SftpClient {
     _LIBSSH2_SFTP *sftp_ = nullptr;       // <- same
     TransferIntegrityPolicy transferIntegrityPolicy_ =
         TransferIntegrityPolicy::Optional;
+    bool chunkedIntegrity_ = false;
+    std::size_t sftpPipelineDepth_ = 64;
+    std::size_t sftpRequestSize_ = 32 * 1024;
+    LocalIoOptions localIo_{};
+    SshAlgorithms negotiated_{}; // guarded by stateMutex_
+    std::optional<ConnectTimings> lastTimings_; // guarded by stateMutex_
+    std::optional<NetworkTuning> networkTuning_; // guarded by stateMutex_
+    // Set when the transport may host several SFTP channels; every operation
+    // then takes its turn on it (see ChannelTurn in the .cpp).
+    std::shared_ptr<SharedSshTransport> mux_;
+    // Taken by every operation on a private transport, so ping() may come
+    // from another thread.
+    std::unique_ptr<TransportLock> io_;
+    // Set by interrupt(). On a shared transport this is the only way to
+    // stop this channel: operations refuse their turn, transfer loops stop
+    // at their next cancel check and ping() stops waiting for its reply.
+    std::atomic<bool> interrupted_{false};
+    // Set once the server rejects exec'd sha256sum; integrity checks then
+    // re-read the remote file over SFTP for the rest of the session.
+    bool serverHashUnavailable_ = false;
     mutable std::mutex stateMutex_;
 #ifndef _WIN32
     int jumpProxyPid_ = -1;
@@ -91,11 +178,20 @@ class Libssh2SftpClient : public SftpClient {
 #endif
 
     // TCP connection + SSH handshake and authentication.
-    bool tcpConnect(const SessionOptions &opt, std::string &err);
+    bool tcpConnect(const SessionOptions &opt, std::string &err,
+                    ConnectTimings &timings);
     bool sshHandshakeAuth(const SessionOptions &opt, std::string &err,
-                          bool initializeSftpSubsystem);
+                          bool initializeSftpSubsystem,
+                          ConnectTimings &timings);
     bool connectInternal(const SessionOptions &opt, std::string &err,
                          bool initializeSftpSubsystem);
+    void applyTuning(const SessionOptions &opt);
+    void applyNetworkTuning(const SessionOptions &opt,
+                            const ConnectTimings &timings);
+    // Another SFTP channel on this client's multiplexed transport; nullptr
+    // when the transport is full or the server refuses the channel.
+    std::unique_ptr<Libssh2SftpClient>
+    openMultiplexedChannel(const SessionOptions &opt, std::string &err);
 #ifndef _WIN32
     bool describeJumpTunnelFailure(std::string &err);
 #endif
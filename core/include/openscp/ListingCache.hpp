@@ -0,0 +1,67 @@
+// Per-session cache of remote directory listings.
+#pragma once
+#include "SftpTypes.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace openscp {
+
+// Thread-safe map of normalized directory path -> last listing, shared by
+// every connection of one session. Entries younger than the TTL are served
+// as-is; older ones can still be shown while the caller revalidates them.
+// Mutations performed through the session invalidate the affected entries
+// (see CachingSftpClient), so the TTL only covers changes made by others.
+class ListingCache {
+    public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::seconds kDefaultTtl{30};
+    static constexpr std::size_t kDefaultMaxEntries = 512;
+
+    explicit ListingCache(Clock::duration ttl = kDefaultTtl,
+                          std::size_t maxEntries = kDefaultMaxEntries)
+        : ttl_(ttl), maxEntries_(maxEntries ? maxEntries : 1) {}
+
+    // Copy the cached listing of `path` into `out`. Returns false on a miss;
+    // `fresh` (optional) tells whether the entry is still within the TTL.
+    bool lookup(const std::string &path, std::vector<FileInfo> &out,
+                bool *fresh = nullptr) const;
+    // Whether `path` is cached and still within the TTL (no copy).
+    bool isFresh(const std::string &path) const;
+    void store(const std::string &path, std::vector<FileInfo> items);
+
+    // Drop the listing of directory `path`.
+    void invalidate(const std::string &path);
+    // Drop the listing of the directory containing `path`.
+    void invalidateParentOf(const std::string &path);
+    // Drop `path` and every cached directory below it.
+    void invalidateTree(const std::string &path);
+    void clear();
+
+    void setTtl(Clock::duration ttl);
+    Clock::duration ttl() const;
+
+    // "/a//b/" -> "/a/b"; relative paths are anchored at "/".
+    static std::string normalizePath(const std::string &path);
+    static std::string parentPath(const std::string &path);
+
+    private:
+    struct Entry {
+        std::vector<FileInfo> items;
+        Clock::time_point fetchedAt;
+    };
+
+    void evictOldestLocked();
+
+    mutable std::mutex mtx_; // protects all fields below
+    std::unordered_map<std::string, Entry> entries_;
+    Clock::duration ttl_;
+    std::size_t maxEntries_;
+};
+
+} // namespace openscp
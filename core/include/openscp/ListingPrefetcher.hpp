@@ -0,0 +1,68 @@
+// Background warming of a ListingCache with likely-next directories.
+#pragma once
+#include "ListingCache.hpp"
+#include "SftpClient.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openscp {
+
+// Lists the directories of the latest request on one dedicated session
+// (opened on first use and kept until the prefetcher is destroyed), so it
+// never competes with the foreground connection. Work starts once requests
+// have been quiet for Budget::idle_delay, directories that are still fresh
+// in the cache are skipped, and each request stops at its directory and
+// entry budgets. A new request or cancel() abandons the current one,
+// including a listing in progress (at its next batch).
+//
+// The destructor does not wait for the worker: a session that is still
+// being opened (possibly asking the user for a host key or OTP on the UI
+// thread) finishes in the background and is then closed. The factory must
+// therefore not capture anything that may die with the owner.
+class ListingPrefetcher {
+    public:
+    using Clock = std::chrono::steady_clock;
+    // Opens the prefetch session; nullptr (with err) when none is available,
+    // which disables prefetching for the lifetime of the prefetcher.
+    using SessionFactory =
+        std::function<std::unique_ptr<SftpClient>(std::string &err)>;
+
+    struct Budget {
+        std::size_t max_directories = 24; // per request
+        std::size_t max_entries = 20000;  // summed over a request
+        std::chrono::milliseconds idle_delay{250};
+    };
+
+    ListingPrefetcher(std::shared_ptr<ListingCache> cache,
+                      SessionFactory factory);
+    ListingPrefetcher(std::shared_ptr<ListingCache> cache,
+                      SessionFactory factory, Budget budget);
+    ~ListingPrefetcher();
+    ListingPrefetcher(const ListingPrefetcher &) = delete;
+    ListingPrefetcher &operator=(const ListingPrefetcher &) = delete;
+
+    // Replace any pending or running request with `dirs`, most wanted
+    // first.
+    void prefetch(std::vector<std::string> dirs);
+    void cancel();
+    // Block until no request is pending or running.
+    void waitIdle();
+    // Directories listed and stored in the cache so far.
+    std::uint64_t listedCount() const;
+
+    private:
+    struct State;
+    static void run(const std::shared_ptr<State> &st);
+    static void runRequest(State &st, const std::vector<std::string> &dirs,
+                           std::uint64_t generation);
+
+    std::shared_ptr<State> st_;
+};
+
+} // namespace openscp
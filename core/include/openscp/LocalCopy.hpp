@@ -0,0 +1,61 @@
+// Parallel local copy/move engine using in-kernel copies where available.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace openscp {
+
+// How a file's data was copied, best first.
+enum class LocalCopyMethod {
+    None,          // nothing copied (error or empty file)
+    Rename,        // move within one filesystem
+    Clone,         // reflink / copy-on-write clone (FICLONE, clonefile)
+    CopyFileRange, // in-kernel copy (copy_file_range)
+    Sendfile,      // in-kernel copy (sendfile)
+    ReadWrite,     // user-space buffer copy
+};
+
+// Copy the regular file `src` to `dst` (replaced if it exists), keeping its
+// permission bits. The fastest method the filesystems support is picked
+// per file. `progress` receives the bytes copied so far and may return
+// false to cancel.
+bool copyLocalFile(const std::string &src, const std::string &dst,
+                   const std::function<bool(std::uint64_t)> &progress,
+                   LocalCopyMethod *used, std::string &err);
+
+// One top-level entry to copy (a file or a folder tree) to `target`.
+struct LocalCopyItem {
+    std::string source;
+    std::string target;
+};
+
+struct LocalCopyOptions {
+    // Files copied at the same time.
+    int threads = 4;
+    // Remove each source once it was copied completely (move). Sources on
+    // the target's filesystem are renamed instead when the target does not
+    // exist yet.
+    bool move = false;
+    // Aggregate bytes copied and the total of the planned files. Called
+    // from the worker threads, at most every few MiB per file.
+    std::function<void(std::uint64_t done, std::uint64_t total)> progress;
+    std::function<bool()> shouldCancel;
+};
+
+struct LocalCopyOutcome {
+    bool ok = false;
+    std::string error; // first error of the item
+};
+
+// Copy every item; folders are created before their files are copied in
+// parallel, largest first. Returns one outcome per item (in order); false
+// if any item failed or the run was canceled.
+bool runLocalCopy(const std::vector<LocalCopyItem> &items,
+                  const LocalCopyOptions &opt,
+                  std::vector<LocalCopyOutcome> &outcomes);
+
+} // namespace openscp
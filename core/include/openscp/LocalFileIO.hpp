@@ -0,0 +1,159 @@
+// Local file I/O shared by the transfer loops of every backend.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace openscp {
+
+struct SessionOptions;
+
+// Tuning for the local side of a transfer.
+struct LocalIoOptions {
+    // Bytes moved per local read/write call. Clamped to
+    // [kMinLocalIoBufferSize, kMaxLocalIoBufferSize].
+    std::size_t buffer_size = 256 * 1024;
+    // Keep transferred data out of the OS page cache (F_NOCACHE on macOS;
+    // write-behind plus POSIX_FADV_DONTNEED on Linux). Useful for multi-GB
+    // copies that would otherwise evict everything else from memory.
+    bool bypass_cache = false;
+    // Leave all-zero blocks of downloads as holes instead of writing them,
+    // so mostly-empty disk images do not take their full size on disk.
+    bool sparse_files = true;
+};
+
+constexpr std::size_t kMinLocalIoBufferSize = 64 * 1024;
+constexpr std::size_t kMaxLocalIoBufferSize = 16 * 1024 * 1024;
+
+// Local I/O options taken from the session settings (clamped).
+LocalIoOptions localIoOptionsFrom(const SessionOptions &opt);
+
+// Page-aligned scratch buffer. Allocated once per transfer, so the buffer
+// handed to read()/write() never straddles more pages than necessary.
+class LocalIoBuffer {
+    public:
+    explicit LocalIoBuffer(std::size_t size);
+    char *data() { return data_.get(); }
+    std::size_t size() const { return size_; }
+
+    private:
+    struct Free {
+        void operator()(char *p) const;
+    };
+    std::unique_ptr<char, Free> data_;
+    std::size_t size_ = 0;
+};
+
+// Read-only access to a local file by offset. Regular files are
+// memory-mapped when possible, so read() hands out pointers into the page
+// cache without copying; otherwise (empty files, mapping failures, special
+// files) it falls back to positioned reads into the caller's scratch
+// buffer. Each mapped window is checked against the current file size
+// first; when another process truncates the file mid-transfer the mapping
+// is dropped and reads continue with pread(), which returns the short
+// file instead of faulting.
+class LocalFileReader {
+    public:
+    LocalFileReader() = default;
+    ~LocalFileReader() { close(); }
+    LocalFileReader(const LocalFileReader &) = delete;
+    LocalFileReader &operator=(const LocalFileReader &) = delete;
+
+    bool open(const std::string &path, const LocalIoOptions &opt,
+              std::string &err);
+    void close();
+    bool isOpen() const;
+    std::uint64_t size() const { return size_; }
+    bool mapped() const { return map_ != nullptr; }
+
+    // Up to `max` bytes at `offset` (0 at EOF). `data` points into the
+    // mapping or into `scratch` (which must hold `max` bytes) and stays
+    // valid until the next call.
+    bool read(std::uint64_t offset, std::size_t max, char *scratch,
+              const char *&data, std::size_t &n, std::string &err);
+
+    private:
+    bool mappingCovers(std::uint64_t end);
+    void dropConsumed(std::uint64_t upTo);
+
+    LocalIoOptions opt_{};
+    std::uint64_t size_ = 0;
+    const char *map_ = nullptr;
+    std::uint64_t dropped_ = 0; // bytes already released from the cache
+#ifdef _WIN32
+    std::FILE *file_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// Positioned writes to a local file, with best-effort preallocation so
+// large downloads land in contiguous extents instead of growing the file a
+// chunk at a time. With sparse_files, aligned all-zero blocks that land in
+// a region already reading as zeros (past EOF, or a hole reported by
+// SEEK_DATA) are skipped; sync()/close() extend the file over a trailing
+// hole and give reserved blocks under skipped ranges back.
+class LocalFileWriter {
+    public:
+    enum class Mode {
+        Truncate, // create or truncate
+        Keep,     // create if missing, keep existing contents
+    };
+
+    LocalFileWriter() = default;
+    ~LocalFileWriter();
+    LocalFileWriter(const LocalFileWriter &) = delete;
+    LocalFileWriter &operator=(const LocalFileWriter &) = delete;
+
+    bool open(const std::string &path, Mode mode, const LocalIoOptions &opt,
+              std::string &err);
+    bool isOpen() const;
+    // Size of the file when it was opened.
+    std::uint64_t initialSize() const { return initialSize_; }
+
+    // Reserve disk blocks for a file of `total` bytes without changing its
+    // visible size, so an interrupted download still leaves a .part whose
+    // length is the number of bytes received. Returns false (harmlessly)
+    // where the platform or filesystem cannot do that.
+    bool preallocate(std::uint64_t total);
+    bool writeAt(std::uint64_t offset, const char *data, std::size_t len,
+                 std::string &err);
+    bool truncate(std::uint64_t size, std::string &err);
+    // Flush to stable storage (fsync / _commit).
+    bool sync(std::string &err);
+    // Close the file; false when the final flush failed.
+    bool close(std::string &err);
+
+    private:
+    bool writeRaw(std::uint64_t offset, const char *data, std::size_t len,
+                  std::string &err);
+    bool regionIsHole(std::uint64_t offset, std::size_t len) const;
+    void releaseHoles();
+    bool settleLength(std::string &err);
+    void writeBehind(std::size_t len);
+
+    LocalIoOptions opt_{};
+    std::uint64_t initialSize_ = 0;
+    std::uint64_t unflushed_ = 0;  // written since the last write-behind
+    std::uint64_t logicalEnd_ = 0; // end of the data, skipped holes included
+    std::uint64_t allocEnd_ = 0;   // end of blocks that may be reserved
+    bool skippedHoles_ = false;    // some zero block was not written
+    std::uint64_t touchedBegin_ = 0; // span written through this writer
+    std::uint64_t touchedEnd_ = 0;
+#ifdef _WIN32
+    std::FILE *file_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// Move a finished download over `to` (replacing it) and, on POSIX, sync the
+// parent directory so the rename itself survives a crash. `from` must
+// already be on stable storage.
+bool replaceLocalFileAtomic(const std::string &from, const std::string &to,
+                            std::string &err);
+
+} // namespace openscp
@@ -1,141 +1,203 @@
-// Simulated SFTP client for UI testing without network.
+// Simulated SFTP client for UI testing and load profiling without network.
 #pragma once
 #include "SftpClient.hpp"
-#include <unordered_map>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
 
 namespace openscp {
 
+// Link and server behaviour of a MockFileSystem. The defaults answer
+// instantly and never fail.
+struct MockSftpProfile {
+    std::chrono::microseconds rtt{0};             // per request
+    std::chrono::microseconds connect_latency{0}; // per connect()
+    // Shared by every session of the file system, like one uplink.
+    // 0 means unlimited.
+    double bandwidth_bytes_per_sec = 0.0;
+    // Chance that a request fails with "Injected failure".
+    double failure_rate = 0.0;
+    // Chance per transferred chunk that the session drops mid-transfer
+    // (isConnected() turns false), for resume and reconnect paths.
+    double drop_rate = 0.0;
+    // Chance per transferred chunk that it is sent again, costing one more
+    // rtt, like a lost packet.
+    double loss_rate = 0.0;
+    // Bytes a session keeps in flight before waiting for an answer, like
+    // the SFTP request window: a transfer takes at least one rtt per
+    // window. 0 means unlimited.
+    std::size_t window_bytes = 0;
+    std::size_t chunk_size = 64 * 1024;
+    std::uint32_t seed = 1;
+};
+
+// Totals since the file system was created.
+struct MockSftpStats {
+    std::uint64_t requests = 0;
+    std::uint64_t bytes_downloaded = 0;
+    std::uint64_t bytes_uploaded = 0;
+    std::uint64_t injected_failures = 0;
+};
+
+// In-memory "server" shared by the sessions cloned from one client.
+// Synthetic files (addSyntheticFiles/addSyntheticTree) are described by a
+// count and a size instead of being stored, so directories of millions of
+// entries cost a few bytes; their contents are a fixed byte pattern.
+class MockFileSystem {
+    public:
+    MockFileSystem(); // just "/"
+    ~MockFileSystem();
+    MockFileSystem(const MockFileSystem &) = delete;
+    MockFileSystem &operator=(const MockFileSystem &) = delete;
+
+    // The small demo tree (/home, /var, readme.txt, ...) of the UI mock.
+    static std::shared_ptr<MockFileSystem> demo();
+
+    MockSftpProfile profile() const;
+    void setProfile(const MockSftpProfile &profile);
+    // Keep uploaded bytes (default). Off, uploads only record their size
+    // and read back as the synthetic pattern, for multi-GB load runs.
+    void setKeepContents(bool keep);
+
+    // Create `path` and any missing parents.
+    bool addDirectory(const std::string &path, std::uint32_t mode = 0755);
+    // Create or replace a file (parents are created).
+    bool addFile(const std::string &path, std::uint64_t size);
+    bool addFile(const std::string &path, std::string contents);
+    // `count` files named "<prefix><index>" (zero-padded to equal width) of
+    // `size` bytes each in `dir`, which is created if needed.
+    bool addSyntheticFiles(const std::string &dir, std::uint64_t count,
+                           std::uint64_t size,
+                           const std::string &prefix = "file_");
+    // `depth` levels of `fanout` directories each below `root`, with
+    // `files` synthetic files of `size` bytes in every directory (root
+    // included). Returns the number of entries created.
+    std::uint64_t addSyntheticTree(const std::string &root, int depth,
+                                   std::uint32_t fanout, std::uint64_t files,
+                                   std::uint64_t size);
+
+    // Contents of a file, synthetic or not. False if it does not exist.
+    bool readFile(const std::string &path, std::string &out) const;
+    MockSftpStats stats() const;
+
+    private:
+    friend class MockSftpClient;
+    struct Impl;
+    std::unique_ptr<Impl> d_;
+};
+
 class MockSftpClient : public SftpClient {
     public:
+    // A private demo tree (MockFileSystem::demo()).
+    MockSftpClient();
+    explicit MockSftpClient(std::shared_ptr<MockFileSystem> fs);
+
+    const std::shared_ptr<MockFileSystem> &fileSystem() const { return fs_; }
+
     bool connect(const SessionOptions &opt, std::string &err) override;
     void disconnect() override;
+    // Makes the running operation fail at its next chunk or batch.
+    void interrupt() override { interrupted_ = true; }
     bool isConnected() const override { return connected_; }
+    // One request's worth of the profile's rtt.
+    bool ping(std::uint32_t &rtt_ms, std::string &err) override;
 
+    // Sorted (directories first, then by name).
     bool list(const std::string &remote_path, std::vector<FileInfo> &out,
               std::string &err) override;
+    // One round trip per kListBatchSize entries.
+    bool listStream(const std::string &remote_path,
+                    const ListBatchCB &onBatch, std::string &err) override;
 
-    // Methods not supported in the mock; return false with a message.
     bool get(const std::string &remote, const std::string &local,
              std::string &err,
              std::function<void(std::size_t, std::size_t)> progress,
-             std::function<bool()> shouldCancel, bool resume) override {
-        (void)remote;
-        (void)local;
-        (void)progress;
-        (void)shouldCancel;
-        // Keep message text as-is (UI/localization). Only comments translated.
-        err = "Mock no soporta GET";
-        return false;
-    }
-
+             std::function<bool()> shouldCancel, bool resume) override;
+    bool getRange(const std::string &remote, const std::string &local,
+                  std::uint64_t offset, std::uint64_t length, std::string &err,
+                  std::function<void(std::size_t, std::size_t)> progress,
+                  std::function<bool()> shouldCancel) override;
     bool put(const std::string &local, const std::string &remote,
              std::string &err,
              std::function<void(std::size_t, std::size_t)> progress,
-             std::function<bool()> shouldCancel, bool resume) override {
-        (void)local;
-        (void)remote;
-        (void)progress;
-        (void)shouldCancel;
-        err = "Mock no soporta PUT";
-        return false;
-    }
+             std::function<bool()> shouldCancel, bool resume) override;
+    // Only blocks that differ from the remote file cross the link.
+    bool putDelta(const std::string &local, const std::string &remote,
+                  std::string &err,
+                  std::function<void(std::size_t, std::size_t)> progress,
+                  std::function<bool()> shouldCancel) override;
+    // One round trip per batch instead of one per file.
+    bool putBatch(const std::string &local_root,
+                  const std::vector<std::string> &relative_paths,
+                  const std::string &remote_root, std::string &err,
+                  const BatchFileCB &onFile,
+                  std::function<bool()> shouldCancel) override;
+    bool getBatch(const std::string &remote_root,
+                  const std::vector<std::string> &relative_paths,
+                  const std::string &local_root, std::string &err,
+                  const BatchFileCB &onFile,
+                  std::function<bool()> shouldCancel) override;
+    bool copyRemote(const std::string &from, const std::string &to,
+                    std::string &err, bool overwrite,
+                    std::function<bool()> shouldCancel) override;
+    bool readStream(const std::string &remote, std::uint64_t offset,
+                    const ReadSink &sink, std::string &err,
+                    std::function<bool()> shouldCancel) override;
+    // Like put(): what was written before a failure stays on the "server".
+    bool writeStream(const std::string &remote, bool append,
+                     const WriteSource &source, std::string &err,
+                     std::function<bool()> shouldCancel) override;
 
     bool exists(const std::string &remote_path, bool &isDir,
-                std::string &err) override {
-        isDir = false;
-        (void)remote_path;
-        err = "Mock no soporta exists";
-        return false;
-    }
-
+                std::string &err) override;
     bool stat(const std::string &remote_path, FileInfo &info,
-              std::string &err) override {
-        (void)remote_path;
-        (void)info;
-        err = "Mock no soporta stat";
-        return false;
-    }
-
-    bool mkdir(const std::string &remote_dir, std::string &err,
-               unsigned int mode = 0755) override {
-        (void)remote_dir;
-        (void)mode;
-        err = "Mock no soporta mkdir";
-        return false;
-    }
-
-    bool removeFile(const std::string &remote_path, std::string &err) override {
-        (void)remote_path;
-        err = "Mock no soporta remove";
-        return false;
-    }
-
-    bool removeDir(const std::string &remote_dir, std::string &err) override {
-        (void)remote_dir;
-        err = "Mock no soporta rmdir";
-        return false;
-    }
-
-    bool rename(const std::string &from, const std::string &to,
-                std::string &err, bool overwrite = false) override {
-        (void)from;
-        (void)to;
-        (void)overwrite;
-        err = "Mock no soporta rename";
-        return false;
-    }
-
+              std::string &err) override;
     bool chmod(const std::string &remote_path, std::uint32_t mode,
-               std::string &err) override {
-        (void)remote_path;
-        (void)mode;
-        err = "Mock no soporta chmod";
-        return false;
-    }
-
+               std::string &err) override;
+    bool chmodTree(const std::string &remote_path, std::uint32_t mode,
+                   std::string &err,
+                   std::function<bool()> shouldCancel) override;
     bool chown(const std::string &remote_path, std::uint32_t uid,
-               std::uint32_t gid, std::string &err) override {
-        (void)remote_path;
-        (void)uid;
-        (void)gid;
-        err = "Mock no soporta chown";
-        return false;
-    }
-
+               std::uint32_t gid, std::string &err) override;
     bool setTimes(const std::string &remote_path, std::uint64_t atime,
                   std::uint64_t mtime, std::string &err) override;
+    bool mkdir(const std::string &remote_dir, std::string &err,
+               unsigned int mode = 0755) override;
+    bool removeFile(const std::string &remote_path, std::string &err) override;
+    bool removeDir(const std::string &remote_dir, std::string &err) override;
+    bool rename(const std::string &from, const std::string &to,
+                std::string &err, bool overwrite = false) override;
 
+    // Another session on the same file system.
     std::unique_ptr<SftpClient> newConnectionLike(const SessionOptions &opt,
                                                   std::string &err) override;
 
     private:
-    bool connected_ = false;
+    // Round trip plus failure injection; false (with err) if the request
+    // fails.
+    bool beginRequest(std::string &err);
+    // Push `bytes` through the simulated link.
+    bool transmit(std::size_t bytes, bool upload,
+                  const std::function<bool()> &shouldCancel, std::string &err);
+    bool download(const std::string &remote, const std::string &local,
+                  bool resume,
+                  const std::function<void(std::size_t, std::size_t)> &progress,
+                  const std::function<bool()> &shouldCancel, std::string &err);
+    bool upload(const std::string &local, const std::string &remote,
+                bool resume,
+                const std::function<void(std::size_t, std::size_t)> &progress,
+                const std::function<bool()> &shouldCancel, std::string &err);
+
+    std::shared_ptr<MockFileSystem> fs_;
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> interrupted_{false};
     SessionOptions lastOpt_{};
-
-    // Mini simulated "remote FS": path -> list of entries
-    std::unordered_map<std::string, std::vector<FileInfo>> fs_ = {
-        {"/",
-         {
-             {"home", true, 0, false, 0, 0, 0, 0},
-             {"var", true, 0, false, 0, 0, 0, 0},
-             {"readme.txt", false, 1280, true, 0, 0, 0, 0},
-         }},
-        {"/home",
-         {
-             {"luis", true, 0, false, 0, 0, 0, 0},
-             {"guest", true, 0, false, 0, 0, 0, 0},
-             {"notes.md", false, 2048, true, 0, 0, 0, 0},
-         }},
-        {"/home/luis",
-         {
-             {"proyectos", true, 0, false, 0, 0, 0, 0},
-             {"foto.jpg", false, 34567, true, 0, 0, 0, 0},
-         }},
-        {"/var",
-         {
-             {"log", true, 0, false, 0, 0, 0, 0},
-         }},
-    };
+    // Window of the running transfer (see MockSftpProfile::window_bytes).
+    std::chrono::steady_clock::time_point windowStart_{};
+    std::size_t windowBytes_ = 0;
 };
 
 } // namespace openscp
@@ -0,0 +1,69 @@
+// Interned storage for many paths that share directories.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace openscp {
+
+// Keeps a large set of paths as a reference to an interned directory
+// prefix (everything up to and including the last '/') plus a leaf name
+// in one shared pool. The files of one folder share a single copy of the
+// folder's path, and a path costs a 16-byte Ref plus its leaf bytes
+// instead of a heap string each. Paths round-trip exactly.
+//
+// Removing a path only counts its leaf as garbage; the owner rebuilds the
+// pool (see needsCompaction()) by interning the live paths into a fresh
+// one. Directory prefixes are kept until then. Not thread-safe: the owner
+// serializes access. Leaf offsets are 64-bit, so the pool grows past
+// 4 GiB; a single leaf over 4 GiB keeps its excess in the prefix.
+class PathPool {
+    public:
+    struct Ref {
+        std::uint64_t leafBegin = 0;
+        std::uint32_t dir = 0; // 0 = no directory prefix
+        std::uint32_t leafSize = 0;
+    };
+
+    PathPool() = default;
+    // The directory index points into dirs_; moving keeps the strings
+    // where they are, copying would not.
+    PathPool(const PathPool &) = delete;
+    PathPool &operator=(const PathPool &) = delete;
+    PathPool(PathPool &&) = default;
+    PathPool &operator=(PathPool &&) = default;
+
+    Ref intern(std::string_view path);
+    std::string str(const Ref &r) const;
+    std::string_view directory(const Ref &r) const {
+        return r.dir ? std::string_view(dirs_[r.dir - 1]) : std::string_view();
+    }
+    std::string_view leaf(const Ref &r) const {
+        return std::string_view(leaves_.data() + r.leafBegin, r.leafSize);
+    }
+
+    // The path of `r` is no longer referenced.
+    void release(const Ref &r) { garbage_ += r.leafSize; }
+    // Most of the leaf pool belongs to released paths.
+    bool needsCompaction() const;
+    void clear();
+
+    std::size_t directories() const { return dirs_.size(); }
+    // Heap bytes held by the pool (approximate for the directory index).
+    std::size_t memoryUsage() const;
+
+    private:
+    std::uint32_t internDirectory(std::string_view dir);
+
+    // Stable element addresses: dirIndex_ keys point into these strings.
+    std::deque<std::string> dirs_;
+    std::unordered_map<std::string_view, std::uint32_t> dirIndex_;
+    std::uint32_t lastDir_ = 0; // consecutive paths are often siblings
+    std::string leaves_;        // all leaf names, back to back
+    std::size_t garbage_ = 0;   // leaf bytes of released paths
+};
+
+} // namespace openscp
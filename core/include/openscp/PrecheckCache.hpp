@@ -0,0 +1,86 @@
+// Destination prechecks of queued transfers answered from listings.
+#pragma once
+#include "SftpClient.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace openscp {
+
+// Answers "does this remote path exist, and with which size and mtime"
+// for many sibling paths from one listing of their directory, instead of
+// an exists() and a stat() round trip per path. Shared by the transfer
+// workers of one session: the first lookup in a directory lists it with
+// the caller's client while concurrent lookups there wait for that
+// listing. Workers report what they create or change, so listings stay
+// right while the queue runs; the TTL bounds changes made by others.
+// A directory with more than `maxEntries` children is not held: paths in
+// it are answered with exists() and stat() instead.
+class PrecheckCache {
+    public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::seconds kDefaultTtl{15};
+    static constexpr std::size_t kDefaultMaxDirectories = 4096;
+    static constexpr std::size_t kDefaultMaxEntries = 20000;
+
+    explicit PrecheckCache(Clock::duration ttl = kDefaultTtl,
+                           std::size_t maxDirectories = kDefaultMaxDirectories,
+                           std::size_t maxEntries = kDefaultMaxEntries)
+        : ttl_(ttl), maxDirectories_(maxDirectories ? maxDirectories : 1),
+          maxEntries_(maxEntries ? maxEntries : 1) {}
+
+    // Look `path` up in the listing of its parent, listing the parent with
+    // `client` if needed. A parent that does not exist answers "missing".
+    // Returns false, with `err` set, when the parent could not be listed
+    // for another reason; callers then ask the server directly.
+    bool lookup(SftpClient &client, const std::string &path, bool &exists,
+                FileInfo &info, std::string &err);
+    // Whether `dir` is known to be an existing directory.
+    bool knownDirectory(const std::string &dir);
+
+    // `dir` was just created (empty).
+    void noteDirectory(const std::string &dir);
+    // A file was written at `path`.
+    void noteFile(const std::string &path, std::uint64_t size,
+                  std::uint64_t mtime);
+    // `path` (a file or a whole tree) may have changed in unknown ways.
+    void invalidate(const std::string &path);
+    void clear();
+
+    // Directory listings fetched so far.
+    std::uint64_t listings() const;
+
+    private:
+    struct Dir {
+        bool loading = false;
+        bool ready = false;
+        bool missing = false; // the directory itself does not exist
+        bool dirty = false;   // changed while loading; do not keep that
+        bool oversized = false; // too many entries; ask the server per path
+        std::uint64_t loadId = 0;
+        Clock::time_point fetchedAt;
+        std::unordered_map<std::string, FileInfo> entries;
+    };
+
+    bool freshLocked(const Dir &d) const;
+    // Record a child of `dir` (if its listing is held) after a change.
+    void putEntryLocked(const std::string &dir, FileInfo info);
+    void evictOldestLocked();
+
+    mutable std::mutex mtx_; // protects all fields below
+    std::condition_variable loaded_;
+    std::unordered_map<std::string, Dir> dirs_;
+    std::uint64_t nextLoadId_ = 1;
+    std::uint64_t listings_ = 0;
+    Clock::duration ttl_;
+    std::size_t maxDirectories_;
+    std::size_t maxEntries_;
+};
+
+} // namespace openscp
@@ -0,0 +1,24 @@
+// Permission checks of remote directories from their attributes alone.
+#pragma once
+#include "SftpTypes.hpp"
+
+#include <cstdint>
+#include <optional>
+
+namespace openscp {
+
+enum class AccessVerdict { ReadOnly, Unknown };
+
+// Whether the session is denied creating entries in the directory
+// described by `dir` (attributes from stat()/list()), judged from its mode
+// bits, owner and group without touching the server. `sessionUid` is the
+// uid the server runs the session as, when known. Mode bits can only rule
+// writing out: a read-only mount, an ACL or root squashing may still
+// refuse what they allow. So the answer is ReadOnly when the applicable
+// permission class lacks write or search permission whatever the
+// session's (unknown) groups, and Unknown otherwise; callers then probe by
+// creating an entry.
+AccessVerdict directoryWriteAccess(const FileInfo &dir,
+                                   std::optional<std::uint32_t> sessionUid);
+
+} // namespace openscp
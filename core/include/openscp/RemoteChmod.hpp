@@ -0,0 +1,51 @@
+// Recursive permission changes of remote trees.
+#pragma once
+#include "SftpClient.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace openscp {
+
+struct RemoteChmodRoot {
+    std::string path;
+    bool is_dir = false; // directories are walked, anything else is changed
+};
+
+struct RemoteChmodProgress {
+    std::uint64_t changed = 0;     // entries changed by the walk
+    std::uint64_t dirs_listed = 0;
+    std::uint64_t server_side = 0; // roots changed by a single command
+    std::uint64_t failures = 0;
+};
+
+struct RemoteChmodJob {
+    std::vector<RemoteChmodRoot> roots;
+    std::uint32_t mode = 0; // permission bits applied to every entry
+    // Ask the server to change each directory root with one command
+    // (SftpClient::chmodTree) before falling back to the walk.
+    bool server_side = true;
+    // Running totals after each unit of work; calls are serialized.
+    std::function<void(const RemoteChmodProgress &)> progress;
+    // Copied once per worker, so a stateful callable is never shared.
+    std::function<bool()> shouldCancel;
+};
+
+// Entries of one directory changed per unit of work.
+inline constexpr std::size_t kRemoteChmodBatch = 128;
+
+// Apply job.mode to every root and, for directories, to everything below
+// them. A directory root is first handed to clients[0]->chmodTree(); when
+// the server cannot do that, or reports a failure, the tree is walked
+// breadth-first with one worker per client, each directory being changed
+// before it is listed. Listed symlinks are skipped. Entries that cannot be
+// changed are counted and the walk goes on. `stats` receives the final
+// totals. Returns false if anything failed or the job was canceled.
+bool runRemoteChmod(const std::vector<SftpClient *> &clients,
+                    const RemoteChmodJob &job, RemoteChmodProgress &stats,
+                    std::string &err);
+
+} // namespace openscp
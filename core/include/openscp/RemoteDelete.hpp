@@ -0,0 +1,50 @@
+// Recursive delete of remote trees over several sessions.
+#pragma once
+#include "SftpClient.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace openscp {
+
+// One selected entry. Directories are emptied first; anything else
+// (including a symlink to a directory) is removed as a file.
+struct RemoteDeleteRoot {
+    std::string path;
+    bool is_dir = false;
+};
+
+struct RemoteDeleteProgress {
+    std::uint64_t files_removed = 0;
+    std::uint64_t dirs_removed = 0;
+    std::uint64_t dirs_listed = 0;
+    std::uint64_t failures = 0;
+};
+
+struct RemoteDeleteJob {
+    std::vector<RemoteDeleteRoot> roots;
+    // Running totals after each unit of work; calls are serialized.
+    std::function<void(const RemoteDeleteProgress &)> progress;
+    // Copied once per worker, so a stateful callable is never shared.
+    std::function<bool()> shouldCancel;
+};
+
+// Files of one directory removed per unit of work, so a huge flat folder
+// is spread over every session instead of draining on one.
+inline constexpr std::size_t kRemoteDeleteBatch = 128;
+
+// Delete job.roots breadth-first with one worker per client: workers list
+// directories, remove their files in batches and remove each directory
+// once everything below it is gone. Listed symlinks are removed, never
+// followed. An entry that cannot be removed only keeps its ancestors;
+// the rest of the tree is still deleted. Entries that vanish meanwhile
+// count as removed. `stats` receives the final totals. Returns false if
+// anything was left behind or the job was canceled.
+bool runRemoteDelete(const std::vector<SftpClient *> &clients,
+                     const RemoteDeleteJob &job, RemoteDeleteProgress &stats,
+                     std::string &err);
+
+} // namespace openscp
@@ -0,0 +1,91 @@
+// Paged read access to a remote file without downloading it.
+#pragma once
+#include "SftpClient.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace openscp {
+
+// Reads parts of one remote file through SftpClient::readStream()
+// (positioned reads: SFTP seek, FTP REST, HTTP Range). The file is split
+// into fixed-size blocks; a read fetches only the blocks it touches that
+// are not cached, each run of missing blocks in one request, and the most
+// recently used blocks are kept up to a memory budget. follow() is the
+// `tail -f` step: it stats the file and fetches only what was appended.
+// Not thread-safe; one caller drives a view.
+class RemoteFileView {
+    public:
+    static constexpr std::size_t kDefaultBlockSize = 256 * 1024;
+    static constexpr std::size_t kDefaultCacheBytes = 32 * 1024 * 1024;
+
+    RemoteFileView(SftpClient &client, std::string path,
+                   std::size_t blockSize = kDefaultBlockSize,
+                   std::size_t cacheBytes = kDefaultCacheBytes);
+
+    // Stat the file and take its current size and mtime. The cache is
+    // dropped when the file was replaced rather than appended to: it
+    // shrank (truncated or rotated), its mtime went backwards, or it was
+    // modified without changing size.
+    bool refresh(std::string &err);
+    std::uint64_t size() const { return size_; }
+    const std::string &path() const { return path_; }
+
+    // Copy up to `length` bytes at `offset` into `out`; fewer at the end of
+    // the file, none past it.
+    bool read(std::uint64_t offset, std::size_t length, std::string &out,
+              std::string &err, const std::function<bool()> &shouldCancel = {});
+
+    // Stat the file again. If it grew, `appended` receives the new bytes
+    // (only the last `maxBytes` of them if there are more) starting at
+    // `appendedAt`. If it was replaced (see refresh()), `truncated` is set
+    // and the cache dropped; the caller starts over.
+    bool follow(std::string &appended, std::uint64_t &appendedAt,
+                bool &truncated, std::string &err,
+                std::size_t maxBytes = kDefaultBlockSize,
+                const std::function<bool()> &shouldCancel = {});
+
+    std::size_t cachedBytes() const { return cached_; }
+    // Bytes received from the server so far.
+    std::uint64_t fetchedBytes() const { return fetched_; }
+    void clear();
+
+    private:
+    struct Block {
+        std::string data; // shorter than a block only at the end of file
+        std::list<std::uint64_t>::iterator lru;
+    };
+
+    // refresh(); `replaced` tells whether the cache had to be dropped.
+    bool restat(bool &replaced, std::string &err);
+    // Bytes a complete block `index` holds at the current size.
+    std::size_t expectedBlockBytes(std::uint64_t index) const;
+    const Block *usableBlock(std::uint64_t index);
+    // Read [offset, offset + length) from the server into `out`.
+    bool fetchRange(std::uint64_t offset, std::size_t length, std::string &out,
+                    std::string &err,
+                    const std::function<bool()> &shouldCancel);
+    // Put bytes read at `offset` into the cache: whole blocks, or the
+    // continuation of a cached partial block.
+    void absorb(std::uint64_t offset, const std::string &data);
+    void touch(Block &b);
+    void evict();
+
+    SftpClient &client_;
+    std::string path_;
+    std::size_t blockSize_;
+    std::size_t cacheBytes_;
+    std::uint64_t size_ = 0;
+    std::uint64_t mtime_ = 0; // 0 until stat reports one
+    bool statted_ = false;
+    std::unordered_map<std::uint64_t, Block> blocks_;
+    std::list<std::uint64_t> lru_; // most recently used first
+    std::size_t cached_ = 0;
+    std::uint64_t fetched_ = 0;
+};
+
+} // namespace openscp
@@ -0,0 +1,66 @@
+// Recursive name search in remote trees.
+#pragma once
+#include "SftpClient.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace openscp {
+
+struct RemoteFindMatch {
+    std::string relative; // below the searched root, '/'-separated
+    bool is_dir = false;
+};
+
+struct RemoteFindProgress {
+    std::uint64_t matches = 0;
+    std::uint64_t scanned = 0;     // entries looked at
+    std::uint64_t dirs_listed = 0; // by the walk
+    std::uint64_t failures = 0;    // folders that could not be searched
+    bool server_side = false;      // answered by SftpClient::findEntries
+    bool truncated = false;        // stopped at max_matches
+};
+
+struct RemoteFindJob {
+    std::string root;
+    // Hidden entries and an optional name pattern the server may apply
+    // before anything is sent. The pattern must accept at least every
+    // name `match` accepts; the walk ignores it.
+    FindOptions filter;
+    // Final test of each entry name, run here and possibly from several
+    // workers at once; empty accepts all.
+    std::function<bool(const std::string &name)> match;
+    // Ask clients[0]->findEntries() before falling back to the walk.
+    bool server_side = true;
+    std::size_t max_matches = 0; // 0 = no limit
+    // Called once when the walk starts, to add sessions that list folders
+    // in parallel with clients[0]; they stay owned by the caller.
+    std::function<void(std::vector<SftpClient *> &)> walk_sessions;
+    // Matches in small batches as they are found; calls are serialized.
+    std::function<void(std::vector<RemoteFindMatch> &&)> on_matches;
+    // Running totals, serialized as well.
+    std::function<void(const RemoteFindProgress &)> progress;
+    // Copied once per worker, so a stateful callable is never shared.
+    std::function<bool()> shouldCancel;
+};
+
+// Matches delivered per on_matches call at most, and the longest a found
+// match waits for its batch to fill.
+inline constexpr std::size_t kRemoteFindBatch = 256;
+inline constexpr int kRemoteFindFlushMs = 100;
+
+// Search job.root: with one server-side findEntries() where the backend
+// has it, otherwise breadth-first with one worker per session, listing
+// each folder once. Listed symlinks are reported but not followed. A
+// server-side search that fails before reporting anything falls back to
+// the walk. Folders that cannot be read are counted and skipped. `stats`
+// receives the final totals. Returns false if the job was canceled or the
+// root itself could not be searched.
+bool runRemoteFind(const std::vector<SftpClient *> &clients,
+                   const RemoteFindJob &job, RemoteFindProgress &stats,
+                   std::string &err);
+
+} // namespace openscp
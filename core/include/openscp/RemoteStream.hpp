@@ -0,0 +1,67 @@
+// Server-to-server copy of one file streamed through memory.
+#pragma once
+#include "SftpClient.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace openscp {
+
+// Bounded byte queue between one producer and one consumer thread. The
+// producer waits while it is full and the consumer while it is empty, so
+// the faster side is paced by the slower one within a fixed footprint.
+class ByteRing {
+    public:
+    explicit ByteRing(std::size_t capacity);
+    ByteRing(const ByteRing &) = delete;
+    ByteRing &operator=(const ByteRing &) = delete;
+
+    // Producer: copy all of `data` in, waiting for room. False once the
+    // consumer closed the ring.
+    bool write(const char *data, std::size_t size);
+    // Producer: no more data; `ok` false marks the stream as failed.
+    void finish(bool ok);
+    // Consumer: copy up to `size` bytes out, waiting for data. Returns 0 at
+    // the end of a finished stream and -1 once buffered data ran out of a
+    // failed one.
+    std::ptrdiff_t read(char *out, std::size_t size);
+    // Consumer: stop taking data; pending and later writes fail.
+    void close();
+
+    std::size_t capacity() const { return buf_.size(); }
+
+    private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<char> buf_;
+    std::size_t head_ = 0; // next byte to read
+    std::size_t size_ = 0; // buffered bytes
+    bool finished_ = false;
+    bool failed_ = false;
+    bool closed_ = false;
+};
+
+inline constexpr std::size_t kRemoteStreamBufferBytes = 8 * 1024 * 1024;
+
+// Copy `from` on session `src` to `to` on session `dst` (any two backends
+// with capabilities().supports_streaming). A helper thread reads the file
+// into a ring of `bufferBytes` while the calling thread writes it out, so
+// the data is neither staged on the local disk nor held whole in memory.
+// The copy lands in "<to>.part" and is renamed over `to` once complete;
+// with `resume` (and supports_resume on both sides) an existing .part is
+// continued from its size. Progress reports bytes written of the source
+// size (0 if unknown) and runs on the calling thread; `shouldCancel` is
+// polled from both threads (the reader calls its own copy), so any state
+// it shares with `progress` must be synchronized.
+bool streamRemoteFile(
+    SftpClient &src, const std::string &from, SftpClient &dst,
+    const std::string &to, std::string &err,
+    const std::function<void(std::size_t, std::size_t)> &progress = {},
+    const std::function<bool()> &shouldCancel = {}, bool resume = false,
+    std::size_t bufferBytes = kRemoteStreamBufferBytes);
+
+} // namespace openscp
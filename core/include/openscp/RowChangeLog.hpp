@@ -0,0 +1,59 @@
+// Versioned log of row changes that list views replay incrementally.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace openscp {
+
+// One change to a list. Rows of Appended/Removed records are those of the
+// list as the previous record left it; an Updated record names its item by
+// id, and the owner resolves the row it is at now.
+struct RowChange {
+    enum class Kind { Appended, Removed, Updated } kind = Kind::Updated;
+    int row = 0;          // Appended/Removed: first row
+    int count = 0;        // Appended/Removed: number of rows
+    std::uint64_t id = 0; // Updated: item whose state changed
+};
+
+// Records are numbered; the version is the number after the newest one. A
+// reader keeps the version it last read and fetches the records after it.
+// Adjacent appends, and repeated updates of one item, fold into the newest
+// record, but only while no reader has been handed it: a record a reader
+// already holds never changes, or the reader would miss the rest. The
+// oldest records are dropped past `maxRecords`; a reader that falls behind
+// them must reload the whole list.
+//
+// Not thread-safe: the owner guards it with its list lock.
+class RowChangeLog {
+    public:
+    explicit RowChangeLog(std::size_t maxRecords = 65536)
+        : maxRecords_(maxRecords) {}
+
+    void appended(int row);
+    void removed(int row, int count);
+    void updated(std::uint64_t id);
+
+    // The current version, for a reader about to load the whole list.
+    std::uint64_t readVersion() const;
+    // Append the records after `version` to `out` and advance `version`;
+    // false when they are no longer (or not yet) in the log.
+    bool readSince(std::uint64_t &version, std::vector<RowChange> &out) const;
+
+    private:
+    std::uint64_t version() const { return base_ + records_.size(); }
+    // Whether the newest record may still be extended.
+    bool lastUnread() const {
+        return !records_.empty() && readUpTo_ < version();
+    }
+    void push(const RowChange &c);
+
+    std::size_t maxRecords_;
+    std::deque<RowChange> records_;
+    std::uint64_t base_ = 0; // version before records_.front()
+    mutable std::uint64_t readUpTo_ = 0; // newest version handed out
+};
+
+} // namespace openscp
@@ -0,0 +1,67 @@
+// Segmented download of one large file over several sessions.
+#pragma once
+#include "SftpClient.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace openscp {
+
+// One byte range of a segmented download.
+struct TransferSegment {
+    std::uint64_t offset = 0;
+    std::uint64_t length = 0;
+    bool done = false;
+};
+
+// Never split a file into segments smaller than this (default).
+inline constexpr std::uint64_t kMinTransferSegmentBytes = 64ull * 1024 * 1024;
+
+struct SegmentedDownloadJob {
+    std::string remote;
+    std::string local;
+    std::uint64_t size = 0;  // remote size in bytes
+    std::uint64_t mtime = 0; // remote mtime; a change invalidates resume
+    bool resume = false;     // reuse completed segments of an earlier try
+    std::uint64_t minSegmentBytes = kMinTransferSegmentBytes;
+    // Aggregate bytes over all segments; calls are serialized.
+    std::function<void(std::size_t, std::size_t)> progress;
+    // Copied once per worker, so a stateful callable is never shared.
+    std::function<bool()> shouldCancel;
+};
+
+// Split `total` bytes into up to `count` contiguous segments of at least
+// `minSegmentBytes` each (the last one absorbs the remainder).
+std::vector<TransferSegment>
+planTransferSegments(std::uint64_t total, std::size_t count,
+                     std::uint64_t minSegmentBytes = kMinTransferSegmentBytes);
+
+// "<local>.part" receives the data; "<local>.part.segments" records which
+// segments are complete (with the remote size and mtime they belong to).
+std::string segmentedPartPath(const std::string &local);
+std::string segmentedStatePath(const std::string &local);
+
+bool saveSegmentState(const std::string &path, std::uint64_t size,
+                      std::uint64_t mtime,
+                      const std::vector<TransferSegment> &segments,
+                      std::string &err);
+// False if the file is missing, malformed or describes another version of
+// the remote file.
+bool loadSegmentState(const std::string &path, std::uint64_t size,
+                      std::uint64_t mtime,
+                      std::vector<TransferSegment> &segments);
+
+// Download job.remote into job.local, running one worker per client (each
+// calling getRange() for the next pending segment). The .part file is
+// preallocated to the full size; segment completion is persisted as it
+// happens, so a canceled or failed run resumes with job.resume set. A
+// segment that fails is requeued once for another session before the whole
+// download fails. On success the synced .part replaces job.local and the
+// state file is removed.
+bool runSegmentedDownload(const std::vector<SftpClient *> &clients,
+                          const SegmentedDownloadJob &job, std::string &err);
+
+} // namespace openscp
@@ -0,0 +1,113 @@
+// Asynchronous remote operations queued on one session.
+#pragma once
+#include "SftpClient.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace openscp {
+
+// Outcome of a queued operation: what the blocking call returned.
+struct AsyncStatus {
+    bool ok = false;
+    std::string error;
+};
+
+template <typename T> struct AsyncResult : AsyncStatus {
+    T value{};
+};
+
+// Runs SftpClient operations for any number of callers on one session that
+// is owned by a single I/O thread. Operations run in submission order and
+// back to back, so a burst of small requests costs one round trip each on
+// an already open channel instead of a thread or a blocked UI per request.
+// Each submission either returns a std::future or takes a completion that
+// runs on the I/O thread; UI code posts that completion to its own thread.
+//
+// The session is opened by the factory on first use and reopened for the
+// next operation after one leaves it disconnected; a failed open fails
+// only the operation waiting for it. Like ListingPrefetcher, the destructor
+// does not wait: it interrupts the running operation, queued ones complete
+// with "Session closed", and the thread finishes on its own. The factory
+// must therefore not capture anything that may die with the owner.
+class SessionExecutor {
+    public:
+    using SessionFactory =
+        std::function<std::unique_ptr<SftpClient>(std::string &err)>;
+    // One blocking call: returns success, fills `value` or `err`.
+    template <typename T>
+    using Operation = std::function<bool(SftpClient &, T &value,
+                                         std::string &err)>;
+    template <typename T>
+    using Completion = std::function<void(AsyncResult<T>)>;
+
+    explicit SessionExecutor(SessionFactory factory);
+    ~SessionExecutor();
+    SessionExecutor(const SessionExecutor &) = delete;
+    SessionExecutor &operator=(const SessionExecutor &) = delete;
+
+    // Queue `op`; `done` runs on the I/O thread once it has finished.
+    template <typename T> void submit(Operation<T> op, Completion<T> done);
+    template <typename T> std::future<AsyncResult<T>> submit(Operation<T> op);
+
+    std::future<AsyncResult<FileInfo>> stat(const std::string &path);
+    std::future<AsyncResult<std::vector<FileInfo>>>
+    list(const std::string &path);
+    std::future<AsyncStatus> mkdir(const std::string &path,
+                                   unsigned int mode = 0755);
+    std::future<AsyncStatus> rename(const std::string &from,
+                                    const std::string &to,
+                                    bool overwrite = false);
+    std::future<AsyncStatus> chmod(const std::string &path,
+                                   std::uint32_t mode);
+    std::future<AsyncStatus> removeFile(const std::string &path);
+
+    // Complete every operation that has not started with "Canceled".
+    void cancelPending();
+    // Operations queued or running.
+    std::size_t pending() const;
+
+    private:
+    // `client` is null when no session could be opened; `err` says why.
+    using Job = std::function<void(SftpClient *client, const std::string &err)>;
+
+    struct State;
+    void enqueue(Job job);
+    std::future<AsyncStatus>
+    run(std::function<bool(SftpClient &, std::string &)> op);
+    static void loop(const std::shared_ptr<State> &st);
+
+    std::shared_ptr<State> st_;
+};
+
+template <typename T>
+void SessionExecutor::submit(Operation<T> op, Completion<T> done) {
+    enqueue([op = std::move(op), done = std::move(done)](
+                SftpClient *client, const std::string &openErr) {
+        AsyncResult<T> r;
+        if (!client)
+            r.error = openErr;
+        else
+            r.ok = op(*client, r.value, r.error);
+        if (done)
+            done(std::move(r));
+    });
+}
+
+template <typename T>
+std::future<AsyncResult<T>> SessionExecutor::submit(Operation<T> op) {
+    auto promise = std::make_shared<std::promise<AsyncResult<T>>>();
+    std::future<AsyncResult<T>> f = promise->get_future();
+    submit<T>(std::move(op), [promise](AsyncResult<T> r) {
+        promise->set_value(std::move(r));
+    });
+    return f;
+}
+
+} // namespace openscp
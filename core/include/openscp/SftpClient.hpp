@@ -2,6 +2,8 @@
 // libssh2-based SFTP/SCP backends) follow this API to keep the UI decoupled.
 #pragma once
 #include "SftpTypes.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 
@@ -26,11 +28,101 @@ class SftpClient {
     // cancellation paths). Backends that cannot interrupt may keep no-op.
     virtual void interrupt() {}
     virtual bool isConnected() const = 0;
+    // Algorithms negotiated for the current SSH session. False when not
+    // connected or for protocols without an SSH transport.
+    virtual bool negotiatedAlgorithms(SshAlgorithms &out) const {
+        (void)out;
+        return false;
+    }
+    // Phase timings of the last connect; false for backends that do not
+    // measure them.
+    virtual bool connectTimings(ConnectTimings &out) const {
+        (void)out;
+        return false;
+    }
+    // Socket and SSH window sizes in effect for the current connection;
+    // false for backends that do not tune them.
+    virtual bool networkTuning(NetworkTuning &out) const {
+        (void)out;
+        return false;
+    }
+
+    // Cheapest liveness check of the transport
+    // (capabilities().supports_ping): one short round trip, timed into
+    // `rtt_ms`. Unlike other operations it may be called from another
+    // thread while the client is in use; it then waits for its turn.
+    virtual bool ping(std::uint32_t &rtt_ms, std::string &err) {
+        rtt_ms = 0;
+        err = "Ping not supported by this backend";
+        return false;
+    }
 
     // Remote directory listing
     virtual bool list(const std::string &remote_path,
                       std::vector<FileInfo> &out, std::string &err) = 0;
 
+    // Directory listing delivered in batches as the server sends it, so
+    // callers can show huge directories before they are fully read. Entries
+    // arrive unsorted. Returning false from onBatch stops the listing (the
+    // call then fails with "Canceled by user"). Backends without a native
+    // stream deliver list()'s result in one batch.
+    using ListBatchCB = std::function<bool(std::vector<FileInfo> &&batch)>;
+    static constexpr std::size_t kListBatchSize = 1024;
+    virtual bool listStream(const std::string &remote_path,
+                            const ListBatchCB &onBatch, std::string &err) {
+        std::vector<FileInfo> out;
+        if (!list(remote_path, out, err))
+            return false;
+        if (!out.empty() && !onBatch(std::move(out))) {
+            err = "Canceled by user";
+            return false;
+        }
+        return true;
+    }
+
+    // Entry found by listTree(): its parent directory and its metadata.
+    // Returning false stops the enumeration.
+    using TreeEntryCB =
+        std::function<bool(const std::string & /*parent*/, const FileInfo &)>;
+
+    // Enumerate everything below remote_dir in as few requests as the server
+    // allows (capabilities().supports_tree_listing). Entries stream into
+    // onEntry as they arrive, in no particular order, one call at a time.
+    // Returns false with err empty if remote_dir does not exist.
+    virtual bool listTree(const std::string &remote_dir,
+                          const TreeEntryCB &onEntry, std::string &err) {
+        (void)remote_dir;
+        (void)onEntry;
+        err = "Tree listing is not supported by this backend.";
+        return false;
+    }
+
+    // Entry found by findEntries(): its path relative to the searched folder
+    // ('/'-separated) and whether it is a folder. Returning false stops the
+    // search.
+    using FindEntryCB =
+        std::function<bool(const std::string & /*relative*/, bool /*isDir*/)>;
+
+    // Search everything below remote_dir on the server
+    // (capabilities().supports_remote_find), so a whole tree costs one
+    // request instead of one listing per folder. Entries passing `filter`
+    // stream into onEntry as the server finds them; symlinks are reported
+    // but not followed. `partial` is set when some folders could not be
+    // read. Stopping from onEntry still returns true.
+    virtual bool findEntries(const std::string &remote_dir,
+                             const FindOptions &filter,
+                             const FindEntryCB &onEntry, bool &partial,
+                             std::string &err,
+                             std::function<bool()> shouldCancel = {}) {
+        (void)remote_dir;
+        (void)filter;
+        (void)onEntry;
+        (void)shouldCancel;
+        partial = false;
+        err = "Server-side search is not supported by this backend.";
+        return false;
+    }
+
     // Download a remote file to local; if resume=true, try to continue a
     // partial download
     virtual bool
@@ -39,6 +131,26 @@ class SftpClient {
             progress = {},
         std::function<bool()> shouldCancel = {}, bool resume = false) = 0;
 
+    // Copy bytes [offset, offset + length) of `remote` into the existing
+    // local file `local` at the same offset, leaving the rest of the file
+    // untouched (capabilities().supports_ranged_get). Used by segmented
+    // downloads; progress reports bytes of this range only.
+    virtual bool getRange(
+        const std::string &remote, const std::string &local,
+        std::uint64_t offset, std::uint64_t length, std::string &err,
+        std::function<void(std::size_t /*done*/, std::size_t /*total*/)>
+            progress = {},
+        std::function<bool()> shouldCancel = {}) {
+        (void)remote;
+        (void)local;
+        (void)offset;
+        (void)length;
+        (void)progress;
+        (void)shouldCancel;
+        err = "Ranged downloads are not supported by this backend.";
+        return false;
+    }
+
     // Upload a local file to remote; if resume=true, try to continue a partial
     // upload
     virtual bool
@@ -47,6 +159,120 @@ class SftpClient {
             progress = {},
         std::function<bool()> shouldCancel = {}, bool resume = false) = 0;
 
+    // Delta re-upload (capabilities().supports_delta_upload) of a local file
+    // over an existing remote one: both sides digest the file in fixed
+    // blocks, the remote file is duplicated on the server into a temporary
+    // "<remote>.delta.<pid>" (mode preserved), only blocks whose digests
+    // differ are written into it and the verified result is renamed over
+    // `remote`. Progress reports only the changed bytes written to the
+    // server, out of the changed total. Fails without touching `remote`
+    // when the server cannot hash or copy files; callers then fall back to
+    // put().
+    virtual bool
+    putDelta(const std::string &local, const std::string &remote,
+             std::string &err,
+             std::function<void(std::size_t /*done*/, std::size_t /*total*/)>
+                 progress = {},
+             std::function<bool()> shouldCancel = {}) {
+        (void)local;
+        (void)remote;
+        (void)progress;
+        (void)shouldCancel;
+        err = "Delta uploads are not supported by this backend.";
+        return false;
+    }
+
+    // Reported per file of an archive batch: its path relative to the batch
+    // root and its size.
+    using BatchFileCB =
+        std::function<void(const std::string & /*relative*/, std::uint64_t)>;
+
+    // Archive batches (capabilities().supports_batch_archive) move many
+    // small files as one tar stream over a single exec channel instead of
+    // one open/write/close round trip per file. relative_paths name regular
+    // files below both roots with '/' separators; missing directories are
+    // created and existing files replaced. A failed batch may have moved
+    // any subset of the files.
+    //
+    // Upload: onFile fires as each file has been streamed to the server.
+    virtual bool putBatch(const std::string &local_root,
+                          const std::vector<std::string> &relative_paths,
+                          const std::string &remote_root, std::string &err,
+                          const BatchFileCB &onFile = {},
+                          std::function<bool()> shouldCancel = {}) {
+        (void)local_root;
+        (void)relative_paths;
+        (void)remote_root;
+        (void)onFile;
+        (void)shouldCancel;
+        err = "Archive batches are not supported by this backend.";
+        return false;
+    }
+    // Download: onFile fires as each file lands in its final local place,
+    // so the reported files are complete even when the call fails.
+    virtual bool getBatch(const std::string &remote_root,
+                          const std::vector<std::string> &relative_paths,
+                          const std::string &local_root, std::string &err,
+                          const BatchFileCB &onFile = {},
+                          std::function<bool()> shouldCancel = {}) {
+        (void)remote_root;
+        (void)relative_paths;
+        (void)local_root;
+        (void)onFile;
+        (void)shouldCancel;
+        err = "Archive batches are not supported by this backend.";
+        return false;
+    }
+
+    // Server-side copy (capabilities().supports_server_copy): duplicate a
+    // file or a whole folder tree inside the server, so no byte travels
+    // through the client. Fails when `to` exists unless `overwrite` is set;
+    // a folder is never replaced. A failed folder copy may leave a partial
+    // tree at `to`.
+    virtual bool copyRemote(const std::string &from, const std::string &to,
+                            std::string &err, bool overwrite = false,
+                            std::function<bool()> shouldCancel = {}) {
+        (void)from;
+        (void)to;
+        (void)overwrite;
+        (void)shouldCancel;
+        err = "Server-side copy is not supported by this backend.";
+        return false;
+    }
+
+    // Streamed file access (capabilities().supports_streaming), for copies
+    // between two sessions that never touch the local disk (see
+    // streamRemoteFile). readStream() passes the bytes of `remote` from
+    // `offset` on to `sink` in transfer-sized chunks; a false return from
+    // the sink stops the read and fails the call.
+    using ReadSink = std::function<bool(const char *data, std::size_t size)>;
+    virtual bool readStream(const std::string &remote, std::uint64_t offset,
+                            const ReadSink &sink, std::string &err,
+                            std::function<bool()> shouldCancel = {}) {
+        (void)remote;
+        (void)offset;
+        (void)sink;
+        (void)shouldCancel;
+        err = "Streamed reads are not supported by this backend.";
+        return false;
+    }
+    // Fills `buf` with up to `size` bytes and returns how many; 0 ends the
+    // file, a negative value aborts the write.
+    using WriteSource =
+        std::function<std::ptrdiff_t(char *buf, std::size_t size)>;
+    // Create or truncate `remote` (with `append`, continue after its current
+    // end) and write what `source` produces until it ends.
+    virtual bool writeStream(const std::string &remote, bool append,
+                             const WriteSource &source, std::string &err,
+                             std::function<bool()> shouldCancel = {}) {
+        (void)remote;
+        (void)append;
+        (void)source;
+        (void)shouldCancel;
+        err = "Streamed writes are not supported by this backend.";
+        return false;
+    }
+
     // Check existence (leave err empty if "does not exist")
     virtual bool exists(const std::string &remote_path, bool &isDir,
                         std::string &err) = 0;
@@ -59,6 +285,20 @@ class SftpClient {
     virtual bool chmod(const std::string &remote_path, std::uint32_t mode,
                        std::string &err) = 0;
 
+    // Apply the permission bits of `mode` to `remote_path` and everything
+    // below it in one server-side command, without following symlinks.
+    // Backends that cannot do that fail; runRemoteChmod() then walks the
+    // tree with chmod().
+    virtual bool chmodTree(const std::string &remote_path, std::uint32_t mode,
+                           std::string &err,
+                           std::function<bool()> shouldCancel = {}) {
+        (void)remote_path;
+        (void)mode;
+        (void)shouldCancel;
+        err = "Recursive chmod is not supported by this backend.";
+        return false;
+    }
+
     // Change owner/group (if supported by the server)
     virtual bool chown(const std::string &remote_path, std::uint32_t uid,
                        std::uint32_t gid, std::string &err) = 0;
@@ -4,6 +4,7 @@
 #pragma once
 #include <algorithm>
 #include <cctype>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <optional>
@@ -122,8 +123,16 @@ inline WebDavScheme webDavSchemeFromStorageName(const std::string &raw) {
 struct ProtocolCapabilities {
     bool implemented = false;
     bool supports_listing = false;
+    bool supports_tree_listing = false; // SftpClient::listTree()
     bool supports_file_transfers = false;
     bool supports_resume = false;
+    bool supports_ranged_get = false;    // SftpClient::getRange()
+    bool supports_batch_archive = false; // SftpClient::putBatch/getBatch
+    bool supports_delta_upload = false;  // SftpClient::putDelta()
+    bool supports_server_copy = false;   // SftpClient::copyRemote()
+    bool supports_streaming = false;     // SftpClient::readStream/writeStream
+    bool supports_remote_find = false;   // SftpClient::findEntries()
+    bool supports_ping = false;          // SftpClient::ping()
     bool supports_metadata = false;
     bool supports_permissions = false;
     bool supports_ownership = false;
@@ -231,6 +240,13 @@ inline ProtocolCapabilities capabilitiesForProtocol(Protocol protocol) {
         caps.supports_listing = true;
         caps.supports_file_transfers = true;
         caps.supports_resume = true;
+        caps.supports_ranged_get = true;
+        caps.supports_batch_archive = true;
+        caps.supports_delta_upload = true;
+        caps.supports_server_copy = true;
+        caps.supports_streaming = true;
+        caps.supports_remote_find = true;
+        caps.supports_ping = true;
         caps.supports_metadata = true;
         caps.supports_permissions = true;
         caps.supports_ownership = true;
@@ -243,6 +259,8 @@ inline ProtocolCapabilities capabilitiesForProtocol(Protocol protocol) {
     case Protocol::Scp:
         caps.implemented = true;
         caps.supports_file_transfers = true;
+        caps.supports_batch_archive = true;
+        caps.supports_remote_find = true;
         caps.supports_proxy = true;
         caps.supports_jump_host = true;
         caps.supports_known_hosts = true;
@@ -252,6 +270,9 @@ inline ProtocolCapabilities capabilitiesForProtocol(Protocol protocol) {
         caps.implemented = true;
         caps.supports_listing = true;
         caps.supports_file_transfers = true;
+        caps.supports_streaming = true;
+        caps.supports_ping = true;
+        caps.supports_metadata = true;
         caps.supports_proxy = true;
 #endif
         return caps;
@@ -260,6 +281,9 @@ inline ProtocolCapabilities capabilitiesForProtocol(Protocol protocol) {
         caps.implemented = true;
         caps.supports_listing = true;
         caps.supports_file_transfers = true;
+        caps.supports_streaming = true;
+        caps.supports_ping = true;
+        caps.supports_metadata = true;
         caps.supports_proxy = true;
 #endif
         return caps;
@@ -267,7 +291,11 @@ inline ProtocolCapabilities capabilitiesForProtocol(Protocol protocol) {
 #if OPENSCP_HAS_CURL_WEBDAV
         caps.implemented = true;
         caps.supports_listing = true;
+        caps.supports_tree_listing = true;
         caps.supports_file_transfers = true;
+        caps.supports_server_copy = true;
+        caps.supports_streaming = true;
+        caps.supports_ping = true;
         caps.supports_metadata = true;
         caps.supports_proxy = true;
 #endif
@@ -287,6 +315,14 @@ struct FileInfo {
     std::uint32_t gid = 0;
 };
 
+// Filters of a server-side search (SftpClient::findEntries).
+struct FindOptions {
+    std::string name_glob; // shell pattern for entry names; empty = all
+    bool case_insensitive = false;
+    // Otherwise dot entries and everything below dot folders are skipped.
+    bool include_hidden = false;
+};
+
 // Result for keyboard-interactive prompt handling.
 // - Handled: callback provided answers in "responses".
 // - Unhandled: callback could not answer; backend may use heuristic fallback.
@@ -299,6 +335,104 @@ using KbdIntPromptsCB = std::function<KbdIntPromptResult(
     const std::vector<std::string> &prompts,
     std::vector<std::string> &responses)>;
 
+// Algorithms agreed on in the SSH handshake. "_cs" is the client-to-server
+// direction, "_sc" server-to-client.
+struct SshAlgorithms {
+    std::string kex;
+    std::string host_key;
+    std::string cipher_cs;
+    std::string cipher_sc;
+    std::string mac_cs;
+    std::string mac_sc;
+    std::string compression_cs;
+    std::string compression_sc;
+};
+
+// Where the time of the last connect went, in milliseconds per phase. A
+// phase that did not run (no proxy, no SFTP subsystem, a failed earlier
+// phase) stays 0.
+struct ConnectTimings {
+    std::uint32_t dns_ms = 0;
+    std::uint32_t tcp_ms = 0;       // address race until one socket connects
+    std::uint32_t tunnel_ms = 0;    // proxy handshake or jump host tunnel
+    std::uint32_t kex_ms = 0;       // SSH banners and key exchange
+    std::uint32_t host_key_ms = 0;  // known_hosts check, prompts included
+    std::uint32_t auth_ms = 0;
+    std::uint32_t sftp_init_ms = 0;
+    std::uint32_t total_ms = 0;
+    std::uint32_t tcp_attempts = 0; // connect() calls started by the race
+    std::string peer;               // address that won, e.g. "[::1]:22"
+};
+
+// Socket and SSH window sizes in effect after connecting, as read back from
+// the OS and libssh2 (Linux reports socket buffers doubled for its
+// bookkeeping overhead). Zero where a value could not be read.
+struct NetworkTuning {
+    std::uint32_t rtt_ms = 0;          // measured when auto-tuning
+    std::uint64_t bdp_bytes = 0;       // bandwidth-delay product planned for
+    std::uint32_t send_buffer = 0;     // SO_SNDBUF
+    std::uint32_t recv_buffer = 0;     // SO_RCVBUF
+    bool nodelay = false;              // TCP_NODELAY
+    std::uint32_t ssh_window = 0;      // SFTP channel receive window
+    std::uint32_t pipeline_depth = 0;  // SFTP requests kept in flight
+    bool auto_tuned = false;
+};
+
+// Bytes in flight needed to fill `linkMbps` over a round trip of `rttMs`,
+// kept within [256 KiB, 64 MiB] (a lost measurement or a LAN round trip of
+// 0 ms still gets a useful window; a wild one cannot pin gigabytes).
+inline std::uint64_t bandwidthDelayBytes(std::uint32_t rttMs,
+                                         std::uint32_t linkMbps) {
+    constexpr std::uint64_t kMin = 256 * 1024;
+    constexpr std::uint64_t kMax = 64 * 1024 * 1024;
+    const std::uint64_t bytes =
+        static_cast<std::uint64_t>(linkMbps) * 1000000 / 8 * rttMs / 1000;
+    return bytes < kMin ? kMin : (bytes > kMax ? kMax : bytes);
+}
+
+// One-line summary, e.g. "RTT 84 ms, BDP 10 MiB, socket buffers 16 MiB /
+// 16 MiB, SSH window 10 MiB, 320 requests in flight, TCP_NODELAY".
+inline std::string describeNetworkTuning(const NetworkTuning &t) {
+    auto size = [](std::uint64_t v) {
+        if (v >= 1024 * 1024 && v % (1024 * 1024) == 0)
+            return std::to_string(v / (1024 * 1024)) + " MiB";
+        if (v >= 1024)
+            return std::to_string(v / 1024) + " KiB";
+        return std::to_string(v) + " B";
+    };
+    std::string out;
+    if (t.auto_tuned)
+        out = "RTT " + std::to_string(t.rtt_ms) + " ms, BDP " +
+              size(t.bdp_bytes) + ", ";
+    out += "socket buffers " + size(t.send_buffer) + " send / " +
+           size(t.recv_buffer) + " receive";
+    if (t.ssh_window > 0)
+        out += ", SSH window " + size(t.ssh_window);
+    if (t.pipeline_depth > 0)
+        out += ", " + std::to_string(t.pipeline_depth) + " requests in flight";
+    if (t.nodelay)
+        out += ", TCP_NODELAY";
+    return out;
+}
+
+// One-line summary, e.g. "DNS 3 ms, TCP 41 ms (2 attempts), KEX 88 ms, ...".
+inline std::string describeConnectTimings(const ConnectTimings &t) {
+    auto ms = [](std::uint32_t v) { return std::to_string(v) + " ms"; };
+    std::string out = "DNS " + ms(t.dns_ms) + ", TCP " + ms(t.tcp_ms);
+    if (t.tcp_attempts > 1)
+        out += " (" + std::to_string(t.tcp_attempts) + " attempts)";
+    if (t.tunnel_ms > 0)
+        out += ", tunnel " + ms(t.tunnel_ms);
+    out += ", KEX " + ms(t.kex_ms) + ", host key " + ms(t.host_key_ms) +
+           ", auth " + ms(t.auth_ms);
+    if (t.sftp_init_ms > 0)
+        out += ", SFTP " + ms(t.sftp_init_ms);
+    out += "; total " + ms(t.total_ms);
+    if (!t.peer.empty())
+        out += " via " + t.peer;
+    return out;
+}
+
 struct SessionOptions {
     Protocol protocol = Protocol::Sftp;
     ScpTransferMode scp_transfer_mode = ScpTransferMode::Auto;
@@ -318,9 +452,61 @@ struct SessionOptions {
     bool known_hosts_hash_names = true;
     // Visual preference: show fingerprint in HEX colon format (UI only)
     bool show_fp_hex = false;
+    // SSH algorithm preferences (SFTP/SCP): comma-separated names, most
+    // preferred first, as in ssh_config Ciphers/MACs. Empty keeps the
+    // built-in defaults. AEAD ciphers (chacha20-poly1305, aes*-gcm) carry
+    // their own integrity and ignore the MAC list.
+    std::string ssh_ciphers;
+    std::string ssh_macs;
+    // zlib compression of the SSH stream: helps text-heavy transfers on
+    // slow links, costs CPU (and throughput) on fast ones.
+    bool ssh_compression = false;
+    // SFTP only: connections cloned with newConnectionLike() open another
+    // SFTP channel on this session's transport (up to
+    // kMaxSftpChannelsPerTransport) instead of a new SSH connection, so
+    // parallel transfers cost one handshake and one jump tunnel. The
+    // channels take turns on the shared transport between chunks.
+    bool ssh_multiplex = false;
+    // Socket and SSH window sizes for links with a large bandwidth-delay
+    // product (SFTP/SCP), in bytes. Zero keeps the OS / libssh2 default.
+    // Socket buffers are set before connecting, so TCP window scaling is
+    // negotiated for them. With network_auto_tune, sizes left at zero are
+    // derived after login from the measured round trip and
+    // network_link_mbps, the bandwidth to plan for; they are only ever
+    // raised above what the OS already picked.
+    std::uint32_t tcp_send_buffer = 0;
+    std::uint32_t tcp_recv_buffer = 0;
+    bool tcp_nodelay = false;
+    std::uint32_t ssh_window_size = 0;
+    bool network_auto_tune = false;
+    std::uint32_t network_link_mbps = 1000;
     // Transfer integrity checks for resume and final content verification.
     TransferIntegrityPolicy transfer_integrity_policy =
         TransferIntegrityPolicy::Optional;
+    // SFTP downloads: check integrity per chunk (see ChunkDigest.hpp)
+    // instead of with one whole-file SHA-256. Chunks are hashed on every
+    // core and compared through a tree digest, and their digests are kept
+    // next to the .part so a resume re-fetches only the chunks that no
+    // longer match instead of starting over. Ignored when the policy is Off.
+    bool transfer_integrity_chunked = false;
+    // SFTP transfer pipelining: number of READ/WRITE requests kept in flight
+    // per transfer and the payload size of each request. Throughput on high-RTT
+    // links is roughly (depth * request size) / RTT. Zero selects the default.
+    std::uint32_t sftp_pipeline_depth = 64;
+    std::uint32_t sftp_request_size = 32 * 1024;
+    // SCP large-file strategy (SCP mode Auto only): downloads of at least
+    // this many bytes are moved over several SFTP range readers on separate
+    // channels of the same SSH session instead of the single SCP channel.
+    // Zero keeps every file on SCP.
+    std::uint64_t scp_large_file_threshold = 64ull * 1024 * 1024;
+    std::uint32_t scp_large_file_streams = 4;
+    // Local side of transfers (see LocalIoOptions): bytes per local I/O
+    // call (zero selects the default), whether to keep transferred data
+    // out of the OS page cache, and whether downloads leave zero blocks as
+    // holes.
+    std::size_t local_io_buffer_size = 256 * 1024;
+    bool local_io_bypass_cache = false;
+    bool local_io_sparse_files = true;
 
     // FTPS security
     bool ftps_verify_peer = true;
@@ -0,0 +1,91 @@
+// Persistent snapshot index for folder synchronization.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace openscp {
+
+// State of one file as it was last synchronized.
+struct SyncEntry {
+    std::string path;        // relative to the synced folder, '/'-separated
+    std::uint64_t size = 0;  // bytes
+    std::int64_t mtime = 0;  // epoch (seconds)
+    bool has_hash = false;   // `hash` holds a SHA-256 of the content
+    std::array<std::uint8_t, 32> hash{};
+};
+
+// Read-only view of a snapshot file. The file is memory-mapped and laid out
+// as a header followed by one array per attribute and a pool of path bytes,
+// sorted by path, so opening an index of a million files costs a single
+// map and a validation pass instead of per-entry parsing, and lookups are
+// binary searches. The layout uses host byte order; a file written on a
+// machine with another byte order is rejected as corrupt.
+class SyncIndex {
+    public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    SyncIndex() = default;
+    ~SyncIndex() { close(); }
+    SyncIndex(SyncIndex &&other) noexcept;
+    SyncIndex &operator=(SyncIndex &&other) noexcept;
+    SyncIndex(const SyncIndex &) = delete;
+    SyncIndex &operator=(const SyncIndex &) = delete;
+
+    // Map `file`. A missing file yields an empty index and returns true;
+    // a truncated or corrupt one returns false with err set.
+    bool open(const std::string &file, std::string &err);
+    void close();
+    // True when the index was loaded from an existing file.
+    bool loaded() const { return loaded_; }
+
+    std::size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    std::string_view path(std::size_t i) const {
+        const std::uint32_t begin = i ? nameEnd_[i - 1] : 0;
+        return std::string_view(pool_ + begin, nameEnd_[i] - begin);
+    }
+    std::uint64_t fileSize(std::size_t i) const { return size_[i]; }
+    std::int64_t mtime(std::size_t i) const { return mtime_[i]; }
+    bool hasHash(std::size_t i) const { return hashes_ && hashFlags_[i]; }
+    // 32 bytes; only meaningful when hasHash(i).
+    const std::uint8_t *hash(std::size_t i) const { return hashes_ + i * 32; }
+    SyncEntry at(std::size_t i) const;
+
+    // Index of `path`, or npos.
+    std::size_t find(std::string_view path) const;
+
+    // Write `entries` as a snapshot file, replacing `file` atomically.
+    // Entries are sorted here; for duplicate paths the last one wins.
+    static bool write(const std::string &file, std::vector<SyncEntry> entries,
+                      std::string &err);
+
+    private:
+    const char *base_ = nullptr; // mapping (or nullptr when empty)
+    std::size_t mappedBytes_ = 0;
+    bool loaded_ = false;
+    std::size_t count_ = 0;
+    const std::uint64_t *size_ = nullptr;
+    const std::int64_t *mtime_ = nullptr;
+    const std::uint32_t *nameEnd_ = nullptr;
+    const std::uint8_t *hashFlags_ = nullptr; // per entry, when hashes_
+    const std::uint8_t *hashes_ = nullptr;    // count_ * 32 bytes
+    const char *pool_ = nullptr;
+};
+
+// Outcome of comparing a fresh scan with the snapshot.
+struct SyncDiff {
+    std::vector<std::size_t> changed;   // scan entries that are new/modified
+    std::vector<std::size_t> unchanged; // scan entries matching the index
+    std::vector<std::size_t> removed;   // index entries absent from the scan
+};
+
+// Sort `scan` by path and merge it against `index`. An entry is unchanged
+// when size and mtime match, and the hash too when both sides carry one.
+SyncDiff diffSyncIndex(const SyncIndex &index, std::vector<SyncEntry> &scan);
+
+} // namespace openscp
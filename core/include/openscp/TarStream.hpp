@@ -0,0 +1,106 @@
+// Streaming tar archive writer/reader used by archive batch transfers.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace openscp {
+
+// One archive member. Paths are relative and '/'-separated.
+struct TarEntry {
+    std::string path;
+    bool is_dir = false;
+    std::uint64_t size = 0;  // file bytes (0 for directories)
+    std::uint32_t mode = 0;  // permission bits
+    std::uint64_t mtime = 0; // epoch (seconds)
+};
+
+// True for a relative '/'-separated path without empty, "." or ".."
+// components, i.e. one that cannot escape the directory it is joined to.
+bool isSafeArchivePath(const std::string &path);
+
+// Writes a POSIX ustar stream into a sink. Paths that do not fit the ustar
+// name/prefix fields and sizes beyond its 8 GiB limit are carried in pax
+// extended headers, which GNU tar, bsdtar and busybox all read.
+class TarWriter {
+    public:
+    // Receives archive bytes in order; return false to abort.
+    using Sink = std::function<bool(const char *data, std::size_t len)>;
+
+    static constexpr std::size_t kBlockSize = 512;
+
+    explicit TarWriter(Sink sink) : sink_(std::move(sink)) {}
+
+    // Start a member. A file must be followed by exactly entry.size bytes
+    // of writeData() and then endEntry().
+    bool beginEntry(const TarEntry &entry, std::string &err);
+    bool writeData(const char *data, std::size_t len, std::string &err);
+    // Pad the current member to the block size.
+    bool endEntry(std::string &err);
+    // Write the end-of-archive marker (two zero blocks).
+    bool finish(std::string &err);
+
+    private:
+    bool emit(const char *data, std::size_t len, std::string &err);
+    bool emitHeader(const std::string &name, char type, std::uint64_t size,
+                    std::uint32_t mode, std::uint64_t mtime,
+                    std::string &err);
+
+    Sink sink_;
+    bool inEntry_ = false;
+    std::uint64_t remaining_ = 0; // data bytes still owed by this member
+    std::uint64_t written_ = 0;   // data bytes written for this member
+};
+
+// Incremental tar parser: feed() accepts arbitrary chunks of an archive and
+// reports regular files and directories through callbacks. ustar prefixes,
+// GNU long names and pax path/size records are understood; links, devices
+// and other member types are skipped.
+class TarReader {
+    public:
+    struct Callbacks {
+        // A member starts; at most entry.size onData() calls follow.
+        std::function<bool(const TarEntry &entry)> onEntry;
+        std::function<bool(const char *data, std::size_t len)> onData;
+        // The current member (from onEntry) is complete.
+        std::function<bool()> onEntryEnd;
+    };
+
+    explicit TarReader(Callbacks cb) : cb_(std::move(cb)) {}
+
+    // Consume the next chunk of the archive. Returns false on a malformed
+    // archive or when a callback returned false (err stays empty then).
+    bool feed(const char *data, std::size_t len, std::string &err);
+    // True once the end-of-archive marker has been read.
+    bool finished() const { return state_ == State::Done; }
+    // True while a member's data is only partially read.
+    bool inEntry() const {
+        return state_ != State::Header && state_ != State::Done;
+    }
+
+    private:
+    enum class State { Header, Data, Meta, Skip, Padding, Done };
+
+    bool handleHeader(std::string &err);
+    bool handleMeta(std::string &err);
+    bool finishMember();
+
+    Callbacks cb_;
+    State state_ = State::Header;
+    std::array<char, 512> block_{};
+    std::size_t blockFill_ = 0;
+    char metaType_ = 0;           // 'L' or 'x' while State::Meta
+    std::string meta_;            // collected long name / pax records
+    std::string pendingPath_;     // path override for the next header
+    std::uint64_t pendingSize_ = 0;
+    bool havePendingSize_ = false;
+    bool deliver_ = false;        // current member goes to the callbacks
+    std::uint64_t remaining_ = 0; // member bytes left in this state
+    std::uint64_t padding_ = 0;   // zero bytes after the member data
+};
+
+} // namespace openscp
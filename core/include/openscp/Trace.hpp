@@ -0,0 +1,79 @@
+// Low-overhead tracing spans recorded into per-thread ring buffers.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace openscp {
+
+namespace detail {
+extern std::atomic<bool> g_traceEnabled;
+}
+
+// Events kept per thread; older ones are overwritten.
+inline constexpr std::size_t kTraceEventsPerThread = 16384;
+
+// Off unless OPENSCP_TRACE is set (or setTraceEnabled(true)). While off a
+// span costs one relaxed atomic load.
+inline bool traceEnabled() {
+    return detail::g_traceEnabled.load(std::memory_order_relaxed);
+}
+void setTraceEnabled(bool on);
+// Output path named by OPENSCP_TRACE; empty if unset.
+const std::string &traceOutputPath();
+
+// Label of the calling thread in the dump.
+void setTraceThreadName(const std::string &name);
+// Zero-length marker.
+void traceInstant(const char *name, const char *category);
+
+// Times the enclosing scope (or until end()). `name`, `category` and the
+// arg name must be string literals: only the pointers are stored.
+class TraceSpan {
+    public:
+    TraceSpan(const char *name, const char *category)
+        : name_(name), category_(category),
+          startUs_(traceEnabled() ? nowUs() : -1) {}
+    ~TraceSpan() { end(); }
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    // One numeric argument shown with the event (e.g. "bytes").
+    void setArg(const char *name, std::uint64_t value) {
+        argName_ = name;
+        arg_ = value;
+    }
+    void end() {
+        if (startUs_ >= 0)
+            record();
+        startUs_ = -1;
+    }
+
+    static std::int64_t nowUs();
+
+    private:
+    void record();
+
+    const char *name_;
+    const char *category_;
+    std::int64_t startUs_;
+    const char *argName_ = nullptr;
+    std::uint64_t arg_ = 0;
+};
+
+// Chrome trace_event JSON ("X" complete events plus thread names) of
+// everything still in the buffers; Perfetto's UI opens it as well.
+std::string chromeTraceJson();
+bool writeChromeTrace(const std::string &path, std::string &err);
+void clearTrace();
+
+} // namespace openscp
+
+#define OPENSCP_TRACE_CONCAT_(a, b) a##b
+#define OPENSCP_TRACE_CONCAT(a, b) OPENSCP_TRACE_CONCAT_(a, b)
+// Span over the rest of the enclosing scope.
+#define OPENSCP_TRACE_SPAN(name, category)                                     \
+    openscp::TraceSpan OPENSCP_TRACE_CONCAT(ocTraceSpan_, __LINE__)(name,     \
+                                                                    category)
@@ -0,0 +1,100 @@
+// Crash-safe journal of the transfer queue.
+#pragma once
+
+#include "TransferReadyQueue.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace openscp {
+
+// Persisted states; finished tasks are removed from the journal instead.
+enum class JournalTaskState : std::uint8_t { Queued, Paused, Error };
+
+// What is needed to put an unfinished task back into the queue.
+struct JournalTask {
+    std::uint64_t id = 0;
+    bool upload = true;
+    std::string session; // connection the task belongs to (user@host:port)
+    std::string src;
+    std::string dst;
+    JournalTaskState state = JournalTaskState::Queued;
+    TransferPriority priority = TransferPriority::Normal;
+    bool replaceExisting = false;
+    std::uint64_t sizeHint = 0;
+    // Archive batch: files relative to src/dst (null for single files)
+    std::shared_ptr<const std::vector<std::string>> batchFiles;
+    std::uint64_t batchTotalBytes = 0;
+};
+
+// Append-only log of queue transitions. Each record carries its length and
+// a CRC-32, so replay stops cleanly at a record torn by a crash and keeps
+// everything before it. Records are buffered and reach the file on flush()
+// (the owner flushes shortly after every change); a crash of the app loses
+// nothing already flushed, even without fsync.
+//
+// The log is compacted into a snapshot of the live tasks when it is opened
+// and whenever it has grown well past them (needsCompaction()). Snapshots
+// replace the log atomically and are fsync'ed. Host byte order, like
+// SyncIndex.
+//
+// An open journal holds an exclusive lock on `<file>.lock`, so a second
+// process (or a second journal object) cannot interleave records with it.
+//
+// Not thread-safe: the owner guards it with its queue lock.
+class TransferJournal {
+    public:
+    TransferJournal() = default;
+    ~TransferJournal();
+    TransferJournal(const TransferJournal &) = delete;
+    TransferJournal &operator=(const TransferJournal &) = delete;
+
+    // Replay `file` into `tasks` (in enqueue order) and compact it. A
+    // missing file starts an empty journal. A corrupt tail is dropped; a
+    // file that is not a journal at all returns false with err set. When
+    // another journal holds the lock, returns false with lockedElsewhere()
+    // set and the file untouched.
+    bool open(const std::string &file, std::vector<JournalTask> &tasks,
+              std::string &err);
+    void close();
+    bool isOpen() const { return f_ != nullptr; }
+    bool lockedElsewhere() const { return lockedElsewhere_; }
+
+    // Record a new task; once per id, later changes go through setState.
+    void put(const JournalTask &task);
+    void setState(std::uint64_t id, JournalTaskState state,
+                  TransferPriority priority);
+    void remove(std::uint64_t id);
+
+    bool hasPending() const { return !pending_.empty(); }
+    bool flush(std::string &err);
+
+    std::size_t liveCount() const { return live_; }
+    // True once the log holds many more records than live tasks.
+    bool needsCompaction() const;
+    // Rewrite the log as one record per task in `live`.
+    bool compact(const std::vector<JournalTask> &live, std::string &err);
+
+    private:
+    bool reopenForAppend(std::string &err);
+    bool lock(std::string &err);
+    void unlock();
+
+    std::string file_;
+    std::FILE *f_ = nullptr;
+#ifdef _WIN32
+    void *lockHandle_ = nullptr; // HANDLE of <file>.lock
+#else
+    int lockFd_ = -1; // of <file>.lock
+#endif
+    bool lockedElsewhere_ = false;
+    std::string pending_;     // encoded records not yet written
+    std::size_t live_ = 0;    // tasks put and not removed
+    std::size_t records_ = 0; // records in the log
+};
+
+} // namespace openscp
@@ -0,0 +1,148 @@
+// Transfer telemetry: per-phase latency histograms, byte and error counters.
+#pragma once
+#include "BandwidthScheduler.hpp"
+#include "SftpTypes.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace openscp {
+
+// Log-linear histogram in the HDR style: every power of two is split into
+// kSubBuckets equal buckets, so any recorded value is known to within
+// 1/kSubBuckets (about 6%) at a fixed 8 KiB of counters, from microseconds
+// to days.
+class LatencyHistogram {
+    public:
+    static constexpr std::size_t kSubBuckets = 16;
+    static constexpr std::size_t kBucketCount = 2 * kSubBuckets +
+                                                (64 - 5) * kSubBuckets;
+
+    void record(std::uint64_t value, std::uint64_t count = 1);
+    void merge(const LatencyHistogram &other);
+    void reset() { *this = LatencyHistogram{}; }
+
+    std::uint64_t count() const { return count_; }
+    std::uint64_t sum() const { return sum_; }
+    std::uint64_t min() const { return count_ ? min_ : 0; }
+    std::uint64_t max() const { return max_; }
+    // Upper bound of the bucket holding quantile `q` (0..1), clamped to
+    // max(); 0 when empty.
+    std::uint64_t valueAtQuantile(double q) const;
+
+    static std::size_t bucketIndex(std::uint64_t value);
+    // Largest value that falls into bucket `index`.
+    static std::uint64_t bucketUpperBound(std::size_t index);
+    std::uint64_t bucketCount(std::size_t index) const {
+        return buckets_[index];
+    }
+
+    private:
+    std::array<std::uint64_t, kBucketCount> buckets_{};
+    std::uint64_t count_ = 0;
+    std::uint64_t sum_ = 0;
+    std::uint64_t min_ = UINT64_MAX;
+    std::uint64_t max_ = 0;
+};
+
+// Steps of one transfer task, in order.
+enum class TransferPhase {
+    Connect,   // leasing or opening the worker session
+    Precheck,  // remote/local existence checks and conflict prompts
+    Open,      // transfer call until the first byte is reported
+    Transfer,  // first byte until the last byte
+    Integrity, // last byte until the call returned (checksums enabled)
+    Finalize,  // close, rename and metadata after the data
+};
+inline constexpr std::size_t kTransferPhaseCount = 6;
+
+enum class TransferErrorClass {
+    Network,
+    Auth,
+    Permission,
+    NotFound,
+    Space,
+    Integrity,
+    LocalIo,
+    Other,
+};
+
+const char *transferPhaseName(TransferPhase phase);
+const char *transferErrorClassName(TransferErrorClass cls);
+// Metric label of a backend ("sftp", "scp", ...).
+const char *protocolMetricLabel(Protocol protocol);
+// Best-effort class of a backend error message.
+TransferErrorClass classifyTransferError(const std::string &err);
+
+enum class MetricsFormat { Prometheus, JsonLines };
+
+// Thread-safe registry of transfer telemetry, labelled by backend. Latency
+// is recorded in microseconds.
+class TransferMetrics {
+    public:
+    // Extra `instance` label on every series (e.g. the workstation name),
+    // so exports of many machines can be merged; empty = none.
+    void setInstance(const std::string &instance);
+
+    void recordPhase(const std::string &backend, TransferPhase phase,
+                     std::chrono::microseconds elapsed);
+    void addBytes(const std::string &backend, TransferDirection dir,
+                  std::uint64_t bytes);
+    void recordError(const std::string &backend, TransferErrorClass cls);
+    void recordTask(const std::string &backend, bool ok);
+    void reset();
+
+    // Snapshot of one phase histogram (empty if nothing was recorded).
+    LatencyHistogram phase(const std::string &backend,
+                           TransferPhase phase) const;
+    std::uint64_t bytes(const std::string &backend,
+                        TransferDirection dir) const;
+    std::uint64_t errors(const std::string &backend,
+                         TransferErrorClass cls) const;
+
+    // Prometheus text exposition: histograms as cumulative `_bucket`
+    // series in seconds on fixed power-of-four bounds (16 us .. 19 h), so
+    // every export has the same series; counters as `_total`. Each bucket
+    // counts the samples <= its bound exactly.
+    static constexpr std::size_t kPromBoundCount = 17;
+    std::string exportPrometheus() const;
+    // One JSON object per series, each stamped with `timestampMs`.
+    // Histograms carry count/sum/min/max and p50..p999 in microseconds.
+    std::string exportJsonLines(std::int64_t timestampMs) const;
+
+    // Publish a snapshot to `target`, a file path or "unix:<socket path>".
+    // Prometheus files are replaced atomically (textfile collector style);
+    // JSON lines are appended, and a file past kJsonLinesMaxBytes is first
+    // renamed to `<target>.1` (replacing the previous one). A local socket
+    // receives the snapshot as one stream write per connection.
+    static constexpr std::uintmax_t kJsonLinesMaxBytes = 64ull << 20;
+    bool exportTo(const std::string &target, MetricsFormat format,
+                  std::int64_t timestampMs, std::string &err) const;
+
+    private:
+    struct Backend {
+        std::array<LatencyHistogram, kTransferPhaseCount> phases;
+        // Per phase, samples per Prometheus bound: [i] holds those above
+        // bound i - 1 and <= bound i, the last slot those above all bounds.
+        // Kept apart because the bounds fall inside histogram buckets.
+        std::array<std::array<std::uint64_t, kPromBoundCount + 1>,
+                   kTransferPhaseCount>
+            promBuckets{};
+        std::uint64_t bytes_up = 0;
+        std::uint64_t bytes_down = 0;
+        std::map<TransferErrorClass, std::uint64_t> errors;
+        std::uint64_t tasks_ok = 0;
+        std::uint64_t tasks_failed = 0;
+    };
+
+    mutable std::mutex m_;
+    std::string instance_;
+    std::map<std::string, Backend> backends_;
+};
+
+} // namespace openscp
@@ -0,0 +1,87 @@
+// Ready queue of a transfer scheduler: priority classes and size policies.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace openscp {
+
+enum class TransferPriority { Low, Normal, High };
+
+enum class SchedulingPolicy {
+    Fifo,           // priority class, then arrival order
+    ShortestFirst,  // priority class, then smallest known size
+    SmallFilesLane, // FIFO, but one worker is kept for small files
+};
+
+// Size used for tasks whose size is not known yet; they sort last.
+inline constexpr std::uint64_t kUnknownTransferSize = UINT64_MAX;
+
+// Tasks ready to run, ordered so that the next one is found in O(log n)
+// however long the queue grows. Higher priority classes always go first;
+// the policy orders tasks within a class.
+//
+// SmallFilesLane splits the queue at the small-file threshold. Large
+// tasks may occupy at most `slots - 1` workers, so one worker always stays
+// free for small files while the others work through large ones. It
+// behaves like Fifo with a single worker.
+//
+// Not thread-safe: the owner guards it with its queue lock.
+class TransferReadyQueue {
+    public:
+    void setPolicy(SchedulingPolicy policy);
+    SchedulingPolicy policy() const { return policy_; }
+    // Tasks up to this many bytes count as small (SmallFilesLane).
+    void setSmallFileThreshold(std::uint64_t bytes);
+    std::uint64_t smallFileThreshold() const { return smallThreshold_; }
+
+    // Add `id`, or move it to its new place if it is already queued.
+    void push(std::uint64_t id, TransferPriority priority,
+              std::uint64_t size = kUnknownTransferSize);
+    void remove(std::uint64_t id);
+    bool contains(std::uint64_t id) const { return entries_.count(id) > 0; }
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    void clear();
+
+    // Take the next task allowed to start while `slots` workers exist in
+    // total; nullopt if none is. A task taken from the large lane holds
+    // its lane slot until release().
+    std::optional<std::uint64_t> pop(int slots);
+    // The task taken by pop() has stopped running.
+    void release(std::uint64_t id) { runningLarge_.erase(id); }
+    std::size_t runningLarge() const { return runningLarge_.size(); }
+
+    private:
+    // (reversed priority, size or 0, arrival sequence, id)
+    using Key =
+        std::tuple<int, std::uint64_t, std::uint64_t, std::uint64_t>;
+    struct Entry {
+        TransferPriority priority;
+        std::uint64_t size;
+        std::uint64_t seq;
+        bool large;
+    };
+
+    Key keyFor(std::uint64_t id, const Entry &e) const;
+    bool isLarge(std::uint64_t size) const;
+    void insert(std::uint64_t id, Entry e);
+    void rebuild();
+
+    SchedulingPolicy policy_ = SchedulingPolicy::Fifo;
+    std::uint64_t smallThreshold_ = 1024 * 1024;
+    std::uint64_t nextSeq_ = 0;
+    std::set<Key> small_; // every task unless the policy is SmallFilesLane
+    std::set<Key> large_;
+    std::unordered_map<std::uint64_t, Entry> entries_;
+    std::unordered_set<std::uint64_t> runningLarge_;
+};
+
+const char *schedulingPolicyName(SchedulingPolicy policy);
+
+} // namespace openscp
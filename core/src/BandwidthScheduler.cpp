@@ -0,0 +1,106 @@
+// Shared token-bucket pacing for transfer streams.
+#include "openscp/BandwidthScheduler.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace openscp {
+
+using Clock = BandwidthScheduler::Clock;
+
+// Advance a virtual finish time by the cost of `bytes` at `bytesPerSec`.
+// Idle time older than the burst window is forfeited.
+static Clock::time_point advance_tat(Clock::time_point &tat, std::size_t bytes,
+                                     double bytesPerSec,
+                                     Clock::time_point now) {
+    const Clock::time_point floor = now - BandwidthScheduler::kBurst;
+    if (tat < floor)
+        tat = floor;
+    tat += std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(double(bytes) / bytesPerSec));
+    return tat;
+}
+
+BandwidthScheduler::Flow::~Flow() {
+    if (owner_)
+        owner_->closeFlow(*this);
+}
+
+void BandwidthScheduler::setRate(TransferDirection dir,
+                                 std::uint64_t bytesPerSec) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    Bucket &b = bucket(dir);
+    if (b.rate.load() == bytesPerSec)
+        return;
+    b.rate.store(bytesPerSec);
+    // Debt accrued under the old rate must not stall the new one.
+    b.tat = Clock::time_point{};
+}
+
+std::uint64_t BandwidthScheduler::rate(TransferDirection dir) const {
+    return bucket(dir).rate.load();
+}
+
+std::shared_ptr<BandwidthScheduler::Flow>
+BandwidthScheduler::openFlow(TransferDirection dir) {
+    std::shared_ptr<Flow> flow(new Flow(this, dir));
+    std::lock_guard<std::mutex> lk(mtx_);
+    ++bucket(dir).activeFlows;
+    return flow;
+}
+
+void BandwidthScheduler::closeFlow(Flow &flow) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    Bucket &b = bucket(flow.dir_);
+    if (b.activeFlows > 0)
+        --b.activeFlows;
+}
+
+Clock::time_point BandwidthScheduler::reserveLocked(Flow &flow,
+                                                    std::size_t bytes,
+                                                    Clock::time_point now) {
+    Clock::time_point deadline = now;
+    Bucket &b = bucket(flow.dir_);
+    const std::uint64_t shared = b.rate.load();
+    if (shared > 0) {
+        deadline = std::max(deadline,
+                            advance_tat(b.tat, bytes, double(shared), now));
+        if (b.activeFlows > 1) {
+            const double fair = double(shared) / double(b.activeFlows);
+            deadline = std::max(deadline,
+                                advance_tat(flow.fairTat_, bytes, fair, now));
+        }
+    }
+    const std::uint64_t cap = flow.rateLimit_.load();
+    if (cap > 0) {
+        deadline = std::max(deadline,
+                            advance_tat(flow.capTat_, bytes, double(cap), now));
+    }
+    return deadline;
+}
+
+bool BandwidthScheduler::acquire(Flow &flow, std::size_t bytes,
+                                 const std::function<bool()> &shouldCancel) {
+    if (bytes == 0)
+        return true;
+    if (bucket(flow.dir_).rate.load() == 0 && flow.rateLimit_.load() == 0)
+        return true;
+
+    Clock::time_point deadline;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        deadline = reserveLocked(flow, bytes, Clock::now());
+    }
+    // Sleep to the exact deadline, waking periodically for cancellation.
+    for (;;) {
+        const Clock::time_point now = Clock::now();
+        if (now >= deadline)
+            return true;
+        if (shouldCancel && shouldCancel())
+            return false;
+        std::this_thread::sleep_until(
+            std::min(deadline, now + kCancelPoll));
+    }
+}
+
+} // namespace openscp
@@ -0,0 +1,246 @@
+// SftpClient decorator that serves directory listings from a ListingCache.
+#include "openscp/CachingSftpClient.hpp"
+
+namespace openscp {
+
+CachingSftpClient::CachingSftpClient(std::unique_ptr<SftpClient> inner,
+                                     std::shared_ptr<ListingCache> cache)
+    : inner_(std::move(inner)), cache_(std::move(cache)) {
+    if (!cache_)
+        cache_ = std::make_shared<ListingCache>();
+}
+
+bool CachingSftpClient::connect(const SessionOptions &opt, std::string &err) {
+    return inner_->connect(opt, err);
+}
+
+bool CachingSftpClient::list(const std::string &remote_path,
+                             std::vector<FileInfo> &out, std::string &err) {
+    bool fresh = false;
+    if (cache_->lookup(remote_path, out, &fresh) && fresh)
+        return true;
+    out.clear();
+    if (!inner_->list(remote_path, out, err)) {
+        // A directory that vanished must not be served from the cache.
+        cache_->invalidate(remote_path);
+        return false;
+    }
+    cache_->store(remote_path, out);
+    return true;
+}
+
+bool CachingSftpClient::listStream(const std::string &remote_path,
+                                   const ListBatchCB &onBatch,
+                                   std::string &err) {
+    std::vector<FileInfo> cached;
+    bool fresh = false;
+    if (cache_->lookup(remote_path, cached, &fresh) && fresh) {
+        if (!cached.empty() && !onBatch(std::move(cached))) {
+            err = "Canceled by user";
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<FileInfo> copy;
+    bool cacheable = true;
+    const bool ok = inner_->listStream(
+        remote_path,
+        [&](std::vector<FileInfo> &&batch) {
+            if (cacheable &&
+                copy.size() + batch.size() > kMaxStreamedCacheEntries) {
+                cacheable = false;
+                std::vector<FileInfo>().swap(copy);
+            }
+            if (cacheable)
+                copy.insert(copy.end(), batch.begin(), batch.end());
+            return onBatch(std::move(batch));
+        },
+        err);
+    if (!ok || !cacheable) {
+        cache_->invalidate(remote_path);
+        return ok;
+    }
+    cache_->store(remote_path, std::move(copy));
+    return true;
+}
+
+bool CachingSftpClient::get(
+    const std::string &remote, const std::string &local, std::string &err,
+    std::function<void(std::size_t, std::size_t)> progress,
+    std::function<bool()> shouldCancel, bool resume) {
+    return inner_->get(remote, local, err, std::move(progress),
+                       std::move(shouldCancel), resume);
+}
+
+bool CachingSftpClient::put(
+    const std::string &local, const std::string &remote, std::string &err,
+    std::function<void(std::size_t, std::size_t)> progress,
+    std::function<bool()> shouldCancel, bool resume) {
+    const bool ok = inner_->put(local, remote, err, std::move(progress),
+                                std::move(shouldCancel), resume);
+    // Even a failed upload may leave a partial file behind.
+    cache_->invalidateParentOf(remote);
+    touched(remote);
+    return ok;
+}
+
+bool CachingSftpClient::writeStream(const std::string &remote, bool append,
+                                    const WriteSource &source,
+                                    std::string &err,
+                                    std::function<bool()> shouldCancel) {
+    const bool ok = inner_->writeStream(remote, append, source, err,
+                                        std::move(shouldCancel));
+    cache_->invalidateParentOf(remote);
+    touched(remote);
+    return ok;
+}
+
+bool CachingSftpClient::putDelta(
+    const std::string &local, const std::string &remote, std::string &err,
+    std::function<void(std::size_t, std::size_t)> progress,
+    std::function<bool()> shouldCancel) {
+    const bool ok = inner_->putDelta(local, remote, err, std::move(progress),
+                                     std::move(shouldCancel));
+    // A failed delta may leave the server-side .part copy behind.
+    cache_->invalidateParentOf(remote);
+    touched(remote);
+    return ok;
+}
+
+bool CachingSftpClient::putBatch(const std::string &local_root,
+                                 const std::vector<std::string> &relative_paths,
+                                 const std::string &remote_root,
+                                 std::string &err, const BatchFileCB &onFile,
+                                 std::function<bool()> shouldCancel) {
+    const bool ok = inner_->putBatch(local_root, relative_paths, remote_root,
+                                     err, onFile, std::move(shouldCancel));
+    // The archive may have created directories anywhere below the root.
+    cache_->invalidateParentOf(remote_root);
+    touched(remote_root);
+    cache_->invalidateTree(remote_root);
+    return ok;
+}
+
+bool CachingSftpClient::exists(const std::string &remote_path, bool &isDir,
+                               std::string &err) {
+    return inner_->exists(remote_path, isDir, err);
+}
+
+bool CachingSftpClient::stat(const std::string &remote_path, FileInfo &info,
+                             std::string &err) {
+    return inner_->stat(remote_path, info, err);
+}
+
+bool CachingSftpClient::chmod(const std::string &remote_path,
+                              std::uint32_t mode, std::string &err) {
+    const bool ok = inner_->chmod(remote_path, mode, err);
+    if (ok) {
+        cache_->invalidateParentOf(remote_path);
+        touched(remote_path);
+    }
+    return ok;
+}
+
+// A failed tree operation may have changed part of the tree, so the
+// directories are invalidated either way.
+bool CachingSftpClient::chmodTree(const std::string &remote_path,
+                                  std::uint32_t mode, std::string &err,
+                                  std::function<bool()> shouldCancel) {
+    const bool ok =
+        inner_->chmodTree(remote_path, mode, err, std::move(shouldCancel));
+    cache_->invalidateParentOf(remote_path);
+    touched(remote_path);
+    cache_->invalidateTree(remote_path);
+    return ok;
+}
+
+bool CachingSftpClient::chown(const std::string &remote_path,
+                              std::uint32_t uid, std::uint32_t gid,
+                              std::string &err) {
+    const bool ok = inner_->chown(remote_path, uid, gid, err);
+    if (ok) {
+        cache_->invalidateParentOf(remote_path);
+        touched(remote_path);
+    }
+    return ok;
+}
+
+bool CachingSftpClient::setTimes(const std::string &remote_path,
+                                 std::uint64_t atime, std::uint64_t mtime,
+                                 std::string &err) {
+    const bool ok = inner_->setTimes(remote_path, atime, mtime, err);
+    if (ok) {
+        cache_->invalidateParentOf(remote_path);
+        touched(remote_path);
+    }
+    return ok;
+}
+
+bool CachingSftpClient::mkdir(const std::string &remote_dir, std::string &err,
+                              unsigned int mode) {
+    const bool ok = inner_->mkdir(remote_dir, err, mode);
+    if (ok) {
+        cache_->invalidateParentOf(remote_dir);
+        touched(remote_dir);
+    }
+    return ok;
+}
+
+bool CachingSftpClient::removeFile(const std::string &remote_path,
+                                   std::string &err) {
+    const bool ok = inner_->removeFile(remote_path, err);
+    if (ok) {
+        cache_->invalidateParentOf(remote_path);
+        touched(remote_path);
+    }
+    return ok;
+}
+
+bool CachingSftpClient::removeDir(const std::string &remote_dir,
+                                  std::string &err) {
+    const bool ok = inner_->removeDir(remote_dir, err);
+    if (ok) {
+        cache_->invalidateParentOf(remote_dir);
+        touched(remote_dir);
+        cache_->invalidateTree(remote_dir);
+    }
+    return ok;
+}
+
+bool CachingSftpClient::rename(const std::string &from, const std::string &to,
+                               std::string &err, bool overwrite) {
+    const bool ok = inner_->rename(from, to, err, overwrite);
+    if (ok) {
+        cache_->invalidateParentOf(from);
+        touched(from);
+        cache_->invalidateParentOf(to);
+        touched(to);
+        cache_->invalidateTree(from);
+        cache_->invalidateTree(to);
+    }
+    return ok;
+}
+
+bool CachingSftpClient::copyRemote(const std::string &from,
+                                   const std::string &to, std::string &err,
+                                   bool overwrite,
+                                   std::function<bool()> shouldCancel) {
+    const bool ok =
+        inner_->copyRemote(from, to, err, overwrite, std::move(shouldCancel));
+    cache_->invalidateParentOf(to);
+    touched(to);
+    cache_->invalidateTree(to);
+    return ok;
+}
+
+std::unique_ptr<SftpClient>
+CachingSftpClient::newConnectionLike(const SessionOptions &opt,
+                                     std::string &err) {
+    std::unique_ptr<SftpClient> next = inner_->newConnectionLike(opt, err);
+    if (!next)
+        return nullptr;
+    return std::make_unique<CachingSftpClient>(std::move(next), cache_);
+}
+
+} // namespace openscp
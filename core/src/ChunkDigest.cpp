@@ -0,0 +1,349 @@
+// Chunked SHA-256 digests for verifying very large files.
+#include "openscp/ChunkDigest.hpp"
+#include "openscp/LocalFileIO.hpp"
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+namespace openscp {
+
+namespace {
+
+// Bytes read per call while hashing a chunk.
+constexpr std::size_t kHashReadSize = 1024 * 1024;
+constexpr const char *kSidecarMagic = "openscp-chunks 1";
+
+struct Sha256 {
+    Sha256() : ctx(EVP_MD_CTX_new()) { reset(); }
+    ~Sha256() {
+        if (ctx)
+            EVP_MD_CTX_free(ctx);
+    }
+    Sha256(const Sha256 &) = delete;
+    Sha256 &operator=(const Sha256 &) = delete;
+
+    void reset() {
+        ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) == 1;
+    }
+    void update(const void *data, std::size_t n) {
+        if (ok && n > 0 && EVP_DigestUpdate(ctx, data, n) != 1)
+            ok = false;
+    }
+    bool finish(ChunkDigest &out) {
+        unsigned int len = 0;
+        if (!ok || EVP_DigestFinal_ex(ctx, out.data(), &len) != 1 ||
+            len != out.size())
+            ok = false;
+        return ok;
+    }
+
+    EVP_MD_CTX *ctx = nullptr;
+    bool ok = false;
+};
+
+std::string toHex(const ChunkDigest &d) {
+    static const char digits[] = "0123456789abcdef";
+    std::string s(d.size() * 2, '0');
+    for (std::size_t i = 0; i < d.size(); ++i) {
+        s[2 * i] = digits[d[i] >> 4];
+        s[2 * i + 1] = digits[d[i] & 0x0f];
+    }
+    return s;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+bool fromHex(const std::string &s, ChunkDigest &out) {
+    if (s.size() != out.size() * 2)
+        return false;
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        const int hi = hexValue(s[2 * i]);
+        const int lo = hexValue(s[2 * i + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        out[i] = static_cast<unsigned char>((hi << 4) | lo);
+    }
+    return true;
+}
+
+} // namespace
+
+std::uint64_t integrityChunkSize(std::uint64_t fileSize) {
+    std::uint64_t chunk = kMinIntegrityChunkSize;
+    while (fileSize / chunk > kMaxIntegrityChunks)
+        chunk *= 2;
+    return chunk;
+}
+
+bool hashLocalChunks(const std::string &path, std::uint64_t length,
+                     std::uint64_t chunkSize, std::vector<ChunkDigest> &out,
+                     std::string &err, unsigned threads,
+                     const std::function<bool()> &shouldCancel) {
+    out.clear();
+    if (chunkSize == 0) {
+        err = "Invalid chunk size";
+        return false;
+    }
+    const std::uint64_t count = (length + chunkSize - 1) / chunkSize;
+    if (count == 0)
+        return true;
+    // Default options: no cache release, so read() is safe to share (the
+    // mapping or pread on one descriptor).
+    LocalFileReader file;
+    if (!file.open(path, LocalIoOptions{}, err))
+        return false;
+    if (file.size() < length) {
+        err = "Local file is shorter than the range to hash";
+        return false;
+    }
+    out.assign(static_cast<std::size_t>(count), ChunkDigest{});
+
+    std::atomic<std::uint64_t> next{0};
+    std::atomic<bool> stop{false};
+    std::mutex errMutex;
+    std::string firstErr;
+    auto fail = [&](const std::string &why) {
+        std::lock_guard<std::mutex> lk(errMutex);
+        if (firstErr.empty())
+            firstErr = why;
+        stop.store(true);
+    };
+    auto worker = [&](bool pollCancel) {
+        LocalIoBuffer buf(kHashReadSize);
+        Sha256 h;
+        while (!stop.load()) {
+            const std::uint64_t idx = next.fetch_add(1);
+            if (idx >= count)
+                return;
+            const std::uint64_t end =
+                std::min(length, (idx + 1) * chunkSize);
+            h.reset();
+            for (std::uint64_t pos = idx * chunkSize; pos < end;) {
+                if (stop.load())
+                    return;
+                if (pollCancel && shouldCancel && shouldCancel()) {
+                    fail("Canceled by user");
+                    return;
+                }
+                const char *data = nullptr;
+                std::size_t n = 0;
+                std::string why;
+                const std::size_t want =
+                    (std::size_t)std::min<std::uint64_t>(buf.size(), end - pos);
+                if (!file.read(pos, want, buf.data(), data, n, why) || n == 0) {
+                    fail(why.empty() ? "Insufficient local read while hashing"
+                                     : why);
+                    return;
+                }
+                h.update(data, n);
+                pos += n;
+            }
+            if (!h.finish(out[(std::size_t)idx])) {
+                fail("Could not hash local chunk");
+                return;
+            }
+        }
+    };
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t workers = (std::size_t)std::min<std::uint64_t>(
+        threads == 0 ? cores : threads, count);
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < workers; ++t)
+        pool.emplace_back(worker, false);
+    worker(true);
+    for (auto &t : pool)
+        t.join();
+    if (!firstErr.empty()) {
+        out.clear();
+        err = firstErr;
+        return false;
+    }
+    return true;
+}
+
+ChunkDigest chunkTreeRoot(const std::vector<ChunkDigest> &chunks) {
+    ChunkDigest root{};
+    Sha256 h;
+    if (chunks.empty()) {
+        h.finish(root);
+        return root;
+    }
+    std::vector<ChunkDigest> level = chunks;
+    const unsigned char node = 0x01;
+    while (level.size() > 1) {
+        std::vector<ChunkDigest> up;
+        up.reserve((level.size() + 1) / 2);
+        for (std::size_t i = 0; i + 1 < level.size(); i += 2) {
+            h.reset();
+            h.update(&node, 1);
+            h.update(level[i].data(), level[i].size());
+            h.update(level[i + 1].data(), level[i + 1].size());
+            ChunkDigest parent{};
+            h.finish(parent);
+            up.push_back(parent);
+        }
+        if (level.size() % 2 != 0)
+            up.push_back(level.back());
+        level.swap(up);
+    }
+    return level.front();
+}
+
+std::vector<std::size_t>
+mismatchedChunks(const std::vector<ChunkDigest> &have,
+                 const std::vector<ChunkDigest> &want) {
+    std::vector<std::size_t> bad;
+    for (std::size_t i = 0; i < have.size(); ++i) {
+        if (i >= want.size() || have[i] != want[i])
+            bad.push_back(i);
+    }
+    return bad;
+}
+
+struct ChunkHasher::State {
+    std::uint64_t chunkSize = 0;
+    std::uint64_t filled = 0; // bytes of the current chunk
+    std::function<void(const ChunkDigest &)> onChunk;
+    Sha256 h;
+
+    void emit() {
+        ChunkDigest d{};
+        if (h.finish(d) && onChunk)
+            onChunk(d);
+        const bool wasOk = h.ok;
+        h.reset();
+        h.ok = h.ok && wasOk;
+        filled = 0;
+    }
+};
+
+ChunkHasher::ChunkHasher(std::uint64_t chunkSize,
+                         std::function<void(const ChunkDigest &)> onChunk)
+    : s_(std::make_unique<State>()) {
+    s_->chunkSize = std::max<std::uint64_t>(1, chunkSize);
+    s_->onChunk = std::move(onChunk);
+}
+
+ChunkHasher::~ChunkHasher() = default;
+
+void ChunkHasher::update(const void *data, std::size_t n) {
+    const char *p = static_cast<const char *>(data);
+    while (n > 0) {
+        const std::size_t take = (std::size_t)std::min<std::uint64_t>(
+            n, s_->chunkSize - s_->filled);
+        s_->h.update(p, take);
+        s_->filled += take;
+        p += take;
+        n -= take;
+        if (s_->filled == s_->chunkSize)
+            s_->emit();
+    }
+}
+
+bool ChunkHasher::finish() {
+    if (s_->filled > 0)
+        s_->emit();
+    return s_->h.ok;
+}
+
+bool ChunkHasher::ok() const { return s_->h.ok; }
+
+std::string chunkSidecarPath(const std::string &partPath) {
+    return partPath + ".chunks";
+}
+
+bool saveChunkDigests(const std::string &path, const ChunkDigests &digests,
+                      std::string &err) {
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        err = "Could not write chunk digests: " + path;
+        return false;
+    }
+    bool ok = std::fprintf(f, "%s %llu\n", kSidecarMagic,
+                           (unsigned long long)digests.chunk_size) > 0;
+    for (const ChunkDigest &d : digests.chunks) {
+        if (!ok)
+            break;
+        ok = std::fprintf(f, "%s\n", toHex(d).c_str()) > 0;
+    }
+    if (std::fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        err = "Could not write chunk digests: " + path;
+    return ok;
+}
+
+bool appendChunkDigest(const std::string &path, const ChunkDigest &digest,
+                       std::string &err) {
+    std::FILE *f = std::fopen(path.c_str(), "ab");
+    if (!f) {
+        err = "Could not append chunk digest: " + path;
+        return false;
+    }
+    bool ok = std::fprintf(f, "%s\n", toHex(digest).c_str()) > 0;
+    if (std::fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        err = "Could not append chunk digest: " + path;
+    return ok;
+}
+
+bool loadChunkDigests(const std::string &path, ChunkDigests &out,
+                      std::string &err) {
+    out = ChunkDigests{};
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        err = "No chunk digests: " + path;
+        return false;
+    }
+    std::string text;
+    char buf[64 * 1024];
+    std::size_t n = 0;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+        text.append(buf, n);
+    std::fclose(f);
+
+    std::size_t pos = text.find('\n');
+    const std::string magic = kSidecarMagic;
+    if (pos == std::string::npos || text.compare(0, magic.size(), magic) != 0 ||
+        text.size() <= magic.size() || text[magic.size()] != ' ') {
+        err = "Unrecognized chunk digest file: " + path;
+        return false;
+    }
+    const std::string size =
+        text.substr(magic.size() + 1, pos - magic.size() - 1);
+    char *end = nullptr;
+    out.chunk_size = std::strtoull(size.c_str(), &end, 10);
+    if (size.empty() || *end != '\0' || out.chunk_size == 0) {
+        err = "Unrecognized chunk digest file: " + path;
+        out = ChunkDigests{};
+        return false;
+    }
+    for (++pos; pos < text.size();) {
+        const std::size_t nl = text.find('\n', pos);
+        if (nl == std::string::npos)
+            break;
+        ChunkDigest d{};
+        if (!fromHex(text.substr(pos, nl - pos), d))
+            break;
+        out.chunks.push_back(d);
+        pos = nl + 1;
+    }
+    return true;
+}
+
+} // namespace openscp
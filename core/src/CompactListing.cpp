@@ -0,0 +1,128 @@
+// Struct-of-arrays storage for large directory listings.
+#include "openscp/CompactListing.hpp"
+
+namespace openscp {
+
+void CompactListing::reserve(std::size_t entries, std::size_t nameBytes) {
+    pool_.reserve(nameBytes);
+    nameEnd_.reserve(entries);
+    size_.reserve(entries);
+    mtime_.reserve(entries);
+    mode_.reserve(entries);
+    uid_.reserve(entries);
+    gid_.reserve(entries);
+    flags_.reserve(entries);
+    if (!keyEnd_.empty())
+        keyEnd_.reserve(entries);
+}
+
+void CompactListing::clear() {
+    pool_.clear();
+    nameEnd_.clear();
+    size_.clear();
+    mtime_.clear();
+    mode_.clear();
+    uid_.clear();
+    gid_.clear();
+    flags_.clear();
+    keyPool_.clear();
+    keyEnd_.clear();
+}
+
+void CompactListing::shrinkToFit() {
+    pool_.shrink_to_fit();
+    nameEnd_.shrink_to_fit();
+    size_.shrink_to_fit();
+    mtime_.shrink_to_fit();
+    mode_.shrink_to_fit();
+    uid_.shrink_to_fit();
+    gid_.shrink_to_fit();
+    flags_.shrink_to_fit();
+    keyPool_.shrink_to_fit();
+    keyEnd_.shrink_to_fit();
+}
+
+void CompactListing::push_back(const FileInfo &f) {
+    pool_.append(f.name);
+    nameEnd_.push_back(pool_.size());
+    size_.push_back(f.size);
+    mtime_.push_back(f.mtime);
+    mode_.push_back(f.mode);
+    uid_.push_back(f.uid);
+    gid_.push_back(f.gid);
+    flags_.push_back(static_cast<std::uint8_t>((f.is_dir ? kDir : 0) |
+                                               (f.has_size ? kHasSize : 0)));
+}
+
+void CompactListing::push_back(const FileInfo &f, std::string_view sortKey) {
+    push_back(f);
+    keyPool_.append(sortKey);
+    keyEnd_.push_back(keyPool_.size());
+}
+
+void CompactListing::append(const std::vector<FileInfo> &entries) {
+    std::size_t nameBytes = pool_.size();
+    for (const auto &f : entries)
+        nameBytes += f.name.size();
+    reserve(size() + entries.size(), nameBytes);
+    for (const auto &f : entries)
+        push_back(f);
+}
+
+void CompactListing::append(const CompactListing &other) {
+    const std::uint64_t base = pool_.size();
+    pool_.append(other.pool_);
+    nameEnd_.reserve(nameEnd_.size() + other.nameEnd_.size());
+    for (std::uint64_t end : other.nameEnd_)
+        nameEnd_.push_back(base + end);
+    size_.insert(size_.end(), other.size_.begin(), other.size_.end());
+    mtime_.insert(mtime_.end(), other.mtime_.begin(), other.mtime_.end());
+    mode_.insert(mode_.end(), other.mode_.begin(), other.mode_.end());
+    uid_.insert(uid_.end(), other.uid_.begin(), other.uid_.end());
+    gid_.insert(gid_.end(), other.gid_.begin(), other.gid_.end());
+    flags_.insert(flags_.end(), other.flags_.begin(), other.flags_.end());
+    // Keys survive only if both sides have them.
+    if (other.keyEnd_.size() == other.nameEnd_.size() &&
+        keyEnd_.size() + other.keyEnd_.size() == nameEnd_.size()) {
+        const std::uint64_t keyBase = keyPool_.size();
+        keyPool_.append(other.keyPool_);
+        for (std::uint64_t end : other.keyEnd_)
+            keyEnd_.push_back(keyBase + end);
+    } else {
+        keyPool_.clear();
+        keyEnd_.clear();
+    }
+}
+
+FileInfo CompactListing::at(std::size_t i) const {
+    FileInfo f;
+    f.name = std::string(name(i));
+    f.is_dir = isDir(i);
+    f.size = size_[i];
+    f.has_size = hasSize(i);
+    f.mtime = mtime_[i];
+    f.mode = mode_[i];
+    f.uid = uid_[i];
+    f.gid = gid_[i];
+    return f;
+}
+
+bool CompactListing::sameEntry(std::size_t i, const CompactListing &other,
+                               std::size_t j) const {
+    return flags_[i] == other.flags_[j] && size_[i] == other.size_[j] &&
+           mtime_[i] == other.mtime_[j] && mode_[i] == other.mode_[j] &&
+           uid_[i] == other.uid_[j] && gid_[i] == other.gid_[j] &&
+           name(i) == other.name(j);
+}
+
+std::size_t CompactListing::memoryUsage() const {
+    return pool_.capacity() +
+           (nameEnd_.capacity() + size_.capacity() + mtime_.capacity()) *
+               sizeof(std::uint64_t) +
+           (mode_.capacity() + uid_.capacity() + gid_.capacity()) *
+               sizeof(std::uint32_t) +
+           flags_.capacity() + keyPool_.capacity() +
+           keyEnd_.capacity() * sizeof(std::uint64_t);
+}
+
+} // namespace openscp
@@ -0,0 +1,110 @@
+// AIMD controller for the number of concurrent transfers.
+#include "openscp/ConcurrencyController.hpp"
+
+#include <algorithm>
+
+namespace openscp {
+
+namespace {
+
+// Weight of the newest interval in the smoothed goodput and task time.
+constexpr double kSmoothing = 0.5;
+
+double smooth(double current, double sample) {
+    return current > 0.0 ? current + kSmoothing * (sample - current) : sample;
+}
+
+} // namespace
+
+ConcurrencyController::ConcurrencyController(int minLimit, int maxLimit,
+                                             int initial)
+    : min_(1), max_(1), limit_(1) {
+    setBounds(minLimit, maxLimit);
+    limit_ = std::clamp(initial, min_, max_);
+}
+
+void ConcurrencyController::setBounds(int minLimit, int maxLimit) {
+    min_ = std::max(1, minLimit);
+    max_ = std::max(min_, maxLimit);
+    limit_ = std::clamp(limit_, min_, max_);
+    if (probeFrom_ > 0)
+        probeFrom_ = std::clamp(probeFrom_, min_, max_);
+}
+
+void ConcurrencyController::decrease() {
+    const int cut = static_cast<int>(limit_ * kDecrease);
+    limit_ = std::max(min_, std::min(limit_ - 1, cut));
+    probeFrom_ = 0;
+    hold_ = kHoldIntervals;
+    // Measurements from the higher limit do not describe the new one.
+    rate_ = 0.0;
+    taskMs_ = 0.0;
+}
+
+int ConcurrencyController::update(const ConcurrencySample &s) {
+    const double seconds = s.interval.count() / 1000.0;
+    const double rate = seconds > 0.0 ? s.bytes / seconds : 0.0;
+
+    // Errors: at least one in ten finishing tasks hit the network.
+    if (s.failed > 0 && s.failed * 10 >= s.completed + s.failed) {
+        decrease();
+        return limit_;
+    }
+
+    bool queueing = false;
+    if (s.rtt.count() > 0) {
+        const double rttMs = static_cast<double>(s.rtt.count());
+        minRttMs_ = minRttMs_ > 0.0 ? std::min(minRttMs_, rttMs) : rttMs;
+        queueing = rttMs > minRttMs_ * kRttInflation &&
+                   rttMs - minRttMs_ >= kRttSlackMs;
+    }
+
+    const bool saturated = s.backlog && s.active >= limit_;
+    if (probeFrom_ > 0) {
+        if (!saturated) {
+            // The queue drained during the probe: nothing to learn.
+            probeFrom_ = 0;
+        } else if (--probeSettle_ > 0) {
+            return limit_;
+        } else if (rate < probeBaseRate_ * (1.0 + kProbeGain) || queueing) {
+            // The extra worker did not pay for itself, or only filled the
+            // link's buffers.
+            limit_ = probeFrom_;
+            probeFrom_ = 0;
+            hold_ = kHoldIntervals;
+            return limit_;
+        } else {
+            probeFrom_ = 0;
+            rate_ = 0.0;
+            taskMs_ = 0.0;
+        }
+    }
+
+    // Same goodput, but much slower tasks or round trips: the streams
+    // contend for the link.
+    const double taskMs = static_cast<double>(s.meanTaskTime.count());
+    const bool slowerTasks = s.completed > 0 && taskMs_ > 0.0 &&
+                             taskMs > taskMs_ * kTaskTimeInflation;
+    if ((slowerTasks || (queueing && rate_ > 0.0)) &&
+        rate <= rate_ * (1.0 + kProbeGain) && limit_ > min_) {
+        decrease();
+        return limit_;
+    }
+    rate_ = smooth(rate_, rate);
+    if (s.completed > 0)
+        taskMs_ = smooth(taskMs_, taskMs);
+
+    if (hold_ > 0) {
+        --hold_;
+        return limit_;
+    }
+    if (saturated && limit_ < max_ && !queueing) {
+        probeFrom_ = limit_;
+        probeBaseRate_ = rate_;
+        probeSettle_ = kProbeSettleIntervals;
+        ++limit_;
+    }
+    return limit_;
+}
+
+} // namespace openscp
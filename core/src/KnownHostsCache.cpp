@@ -0,0 +1,277 @@
+// Parsed known_hosts files shared by every connection of the process.
+#include "openscp/KnownHostsCache.hpp"
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace openscp {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+bool b64decode(const std::string &input, std::vector<unsigned char> &out) {
+    if (input.empty() || (input.size() % 4) != 0)
+        return false;
+    out.assign((input.size() / 4) * 3, 0);
+    int decoded =
+        EVP_DecodeBlock(out.data(),
+                        reinterpret_cast<const unsigned char *>(input.data()),
+                        static_cast<int>(input.size()));
+    if (decoded < 0)
+        return false;
+    int pad = 0;
+    if (input.back() == '=')
+        ++pad;
+    if (input.size() > 1 && input[input.size() - 2] == '=')
+        ++pad;
+    decoded -= pad;
+    if (decoded < 0)
+        return false;
+    out.resize(static_cast<std::size_t>(decoded));
+    return true;
+}
+
+// Bounds of the host-name field, past an optional @marker.
+bool hostField(const std::string &line, std::size_t &hostStart,
+               std::size_t &hostEnd) {
+    auto isSpace = [](unsigned char c) { return std::isspace(c) != 0; };
+    std::size_t i = 0;
+    while (i < line.size() && isSpace(static_cast<unsigned char>(line[i])))
+        ++i;
+    if (i >= line.size() || line[i] == '#')
+        return false;
+
+    auto readFieldEnd = [&](std::size_t from) {
+        std::size_t p = from;
+        while (p < line.size() && !isSpace(static_cast<unsigned char>(line[p])))
+            ++p;
+        return p;
+    };
+
+    hostStart = i;
+    hostEnd = readFieldEnd(i);
+    if (hostStart >= hostEnd)
+        return false;
+
+    if (line[hostStart] == '@') {
+        i = hostEnd;
+        while (i < line.size() && isSpace(static_cast<unsigned char>(line[i])))
+            ++i;
+        if (i >= line.size())
+            return false;
+        hostStart = i;
+        hostEnd = readFieldEnd(i);
+        if (hostStart >= hostEnd)
+            return false;
+    }
+    return true;
+}
+
+// Comma-separated names of the host field.
+std::vector<std::string> hostNames(const std::string &line) {
+    std::vector<std::string> names;
+    std::size_t hostStart = 0;
+    std::size_t hostEnd = 0;
+    if (!hostField(line, hostStart, hostEnd))
+        return names;
+    std::size_t pos = hostStart;
+    while (pos <= hostEnd) {
+        std::size_t comma = line.find(',', pos);
+        if (comma == std::string::npos || comma > hostEnd)
+            comma = hostEnd;
+        if (comma > pos)
+            names.push_back(line.substr(pos, comma - pos));
+        if (comma == hostEnd)
+            break;
+        pos = comma + 1;
+    }
+    return names;
+}
+
+struct HashedName {
+    std::vector<unsigned char> salt;
+    std::vector<unsigned char> mac;
+};
+
+bool parseHashedName(const std::string &name, HashedName &out) {
+    if (name.size() <= 4 || name[0] != '|' || name[1] != '1' || name[2] != '|')
+        return false;
+    const std::size_t sep = name.find('|', 3);
+    if (sep == std::string::npos || sep == 3 || sep + 1 >= name.size())
+        return false;
+    return b64decode(name.substr(3, sep - 3), out.salt) &&
+           b64decode(name.substr(sep + 1), out.mac) && !out.salt.empty() &&
+           !out.mac.empty();
+}
+
+bool hashedNameMatches(const HashedName &h, const std::string &host) {
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int macLen = 0;
+    if (!HMAC(EVP_sha1(), h.salt.data(), static_cast<int>(h.salt.size()),
+              reinterpret_cast<const unsigned char *>(host.data()),
+              host.size(), mac, &macLen)) {
+        return false;
+    }
+    return h.mac.size() == static_cast<std::size_t>(macLen) &&
+           std::equal(h.mac.begin(), h.mac.end(), mac);
+}
+
+// Names libssh2 checks for host:port: "[host]:port" first, then "host".
+std::vector<std::string> lookupNames(const std::string &host,
+                                     std::uint16_t port) {
+    return {"[" + host + "]:" + std::to_string(port), host};
+}
+
+} // namespace
+
+bool knownHostsLineMatches(const std::string &line,
+                           const std::vector<std::string> &tokens) {
+    for (const std::string &name : hostNames(line)) {
+        HashedName hashed;
+        const bool isHashed = parseHashedName(name, hashed);
+        for (const std::string &token : tokens) {
+            if (isHashed ? hashedNameMatches(hashed, token) : name == token)
+                return true;
+        }
+    }
+    return false;
+}
+
+struct KnownHostsCache::File {
+    std::uintmax_t size = 0;
+    fs::file_time_type mtime;
+    std::vector<std::string> lines; // entries only, without comments
+    std::unordered_map<std::string, std::vector<std::size_t>> plain;
+    std::vector<std::pair<HashedName, std::size_t>> hashed;
+
+    std::mutex memoMtx; // protects hashedMemo
+    std::unordered_map<std::string, std::vector<std::size_t>> hashedMemo;
+
+    const std::vector<std::size_t> &hashedLinesFor(const std::string &name) {
+        std::lock_guard<std::mutex> lk(memoMtx);
+        auto it = hashedMemo.find(name);
+        if (it != hashedMemo.end())
+            return it->second;
+        std::vector<std::size_t> found;
+        for (const auto &[h, idx] : hashed) {
+            if (hashedNameMatches(h, name))
+                found.push_back(idx);
+        }
+        return hashedMemo.emplace(name, std::move(found)).first->second;
+    }
+};
+
+KnownHostsCache &KnownHostsCache::shared() {
+    static KnownHostsCache cache;
+    return cache;
+}
+
+std::shared_ptr<KnownHostsCache::File>
+KnownHostsCache::snapshot(const std::string &path, std::string &err) {
+    std::error_code ec;
+    const auto size = fs::file_size(path, ec);
+    const auto mtime =
+        ec ? fs::file_time_type{} : fs::last_write_time(path, ec);
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (ec) {
+        files_.erase(path);
+        err = "Could not open known_hosts";
+        return nullptr;
+    }
+    auto it = files_.find(path);
+    if (it != files_.end() && it->second->size == size &&
+        it->second->mtime == mtime)
+        return it->second;
+
+    // Parsed under the lock, so concurrent connects read a changed file once.
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        files_.erase(path);
+        err = "Could not open known_hosts";
+        return nullptr;
+    }
+    const std::string content((std::istreambuf_iterator<char>(in)),
+                              std::istreambuf_iterator<char>());
+    if (in.bad()) {
+        files_.erase(path);
+        err = "Could not read known_hosts";
+        return nullptr;
+    }
+
+    auto file = std::make_shared<File>();
+    file->size = size;
+    file->mtime = mtime;
+    for (std::size_t pos = 0; pos < content.size();) {
+        std::size_t nl = content.find('\n', pos);
+        if (nl == std::string::npos)
+            nl = content.size();
+        std::string line = content.substr(pos, nl - pos);
+        pos = nl + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        const std::vector<std::string> names = hostNames(line);
+        if (names.empty())
+            continue;
+        const std::size_t idx = file->lines.size();
+        file->lines.push_back(std::move(line));
+        for (const std::string &name : names) {
+            HashedName hashed;
+            if (parseHashedName(name, hashed))
+                file->hashed.emplace_back(std::move(hashed), idx);
+            else
+                file->plain[name].push_back(idx);
+        }
+    }
+    ++loads_;
+    files_[path] = file;
+    return file;
+}
+
+bool KnownHostsCache::linesFor(const std::string &path,
+                               const std::string &host, std::uint16_t port,
+                               std::vector<std::string> &out,
+                               std::string &err) {
+    out.clear();
+    std::shared_ptr<File> file = snapshot(path, err);
+    if (!file)
+        return false;
+    std::vector<std::size_t> idxs;
+    for (const std::string &name : lookupNames(host, port)) {
+        auto it = file->plain.find(name);
+        if (it != file->plain.end())
+            idxs.insert(idxs.end(), it->second.begin(), it->second.end());
+        const auto &hashed = file->hashedLinesFor(name);
+        idxs.insert(idxs.end(), hashed.begin(), hashed.end());
+    }
+    std::sort(idxs.begin(), idxs.end());
+    idxs.erase(std::unique(idxs.begin(), idxs.end()), idxs.end());
+    out.reserve(idxs.size());
+    for (std::size_t idx : idxs)
+        out.push_back(file->lines[idx]);
+    return true;
+}
+
+void KnownHostsCache::invalidate(const std::string &path) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    files_.erase(path);
+}
+
+void KnownHostsCache::clear() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    files_.clear();
+}
+
+std::uint64_t KnownHostsCache::loads() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return loads_;
+}
+
+} // namespace openscp
@@ -0,0 +1,558 @@
+// Locked, incremental updates of known_hosts files.
+#include "openscp/KnownHostsUtils.hpp"
+#include "openscp/KnownHostsCache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unordered_set>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace openscp {
+
+namespace {
+
+#ifndef _WIN32
+std::string posixErr(const char *where) {
+    return std::string(where) + ": " + std::strerror(errno);
+}
+
+std::string parentDir(const std::string &path) {
+    const std::size_t p = path.find_last_of('/');
+    return p == std::string::npos ? std::string(".") : path.substr(0, p);
+}
+
+bool ensureParentDir0700(const std::string &path, std::string &err) {
+    const std::string dir = parentDir(path);
+    struct ::stat st{};
+    if (::stat(dir.c_str(), &st) != 0) {
+        if (::mkdir(dir.c_str(), 0700) != 0) {
+            err = posixErr("mkdir");
+            return false;
+        }
+    } else if (::chmod(dir.c_str(), 0700) != 0) {
+        err = posixErr("chmod(dir)");
+        return false;
+    }
+    return true;
+}
+
+bool fsyncParentDir(const std::string &path, std::string &err) {
+    const int dfd = ::open(parentDir(path).c_str(), O_RDONLY);
+    if (dfd < 0) {
+        err = posixErr("open(parent)");
+        return false;
+    }
+    if (::fsync(dfd) != 0) {
+        err = posixErr("fsync(parent)");
+        ::close(dfd);
+        return false;
+    }
+    if (::close(dfd) != 0) {
+        err = posixErr("close(parent)");
+        return false;
+    }
+    return true;
+}
+
+bool writeAll(int fd, const char *data, std::size_t len, std::string &err) {
+    std::size_t off = 0;
+    while (off < len) {
+        const ssize_t w = ::write(fd, data + off, len - off);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            err = posixErr("write");
+            return false;
+        }
+        off += (std::size_t)w;
+    }
+    return true;
+}
+#else
+std::string winErr(const char *where, DWORD code) {
+    std::ostringstream oss;
+    oss << where << " (GetLastError=" << (unsigned long)code << ")";
+    return oss.str();
+}
+#endif
+
+// Exclusive lock on "<khPath>.lock", held until destruction. A separate
+// file is locked because rewrites replace known_hosts itself by rename.
+class WriterLock {
+    public:
+    WriterLock() = default;
+    WriterLock(const WriterLock &) = delete;
+    WriterLock &operator=(const WriterLock &) = delete;
+    ~WriterLock() {
+#ifdef _WIN32
+        if (h_ != INVALID_HANDLE_VALUE) {
+            OVERLAPPED ov{};
+            (void)UnlockFileEx(h_, 0, MAXDWORD, MAXDWORD, &ov);
+            CloseHandle(h_);
+        }
+#else
+        if (fd_ >= 0) {
+            (void)::flock(fd_, LOCK_UN);
+            ::close(fd_);
+        }
+#endif
+    }
+
+    bool acquire(const std::string &khPath, std::string &err) {
+        const std::string lockPath = khPath + ".lock";
+#ifdef _WIN32
+        h_ = CreateFileA(lockPath.c_str(), GENERIC_READ | GENERIC_WRITE,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE |
+                             FILE_SHARE_DELETE,
+                         NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (h_ == INVALID_HANDLE_VALUE) {
+            err = winErr("CreateFile(lock)", GetLastError());
+            return false;
+        }
+        OVERLAPPED ov{};
+        if (!LockFileEx(h_, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD,
+                        &ov)) {
+            err = winErr("LockFileEx(lock)", GetLastError());
+            CloseHandle(h_);
+            h_ = INVALID_HANDLE_VALUE;
+            return false;
+        }
+#else
+        fd_ = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd_ < 0) {
+            err = posixErr("open(lock)");
+            return false;
+        }
+        while (::flock(fd_, LOCK_EX) != 0) {
+            if (errno == EINTR)
+                continue;
+            err = posixErr("flock(lock)");
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    private:
+#ifdef _WIN32
+    HANDLE h_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+};
+
+bool readFile(const std::string &path, std::string &content,
+              std::string &err) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        err = "Could not open known_hosts";
+        return false;
+    }
+    content.assign((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+    if (in.bad()) {
+        err = "Could not read known_hosts";
+        return false;
+    }
+    return true;
+}
+
+std::vector<std::string> splitLines(const std::string &content) {
+    std::vector<std::string> lines;
+    std::istringstream in(content);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+std::string joinLines(const std::vector<std::string> &lines,
+                      bool trailingLf) {
+    std::string out;
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+        if (i > 0)
+            out.push_back('\n');
+        out += lines[i];
+    }
+    if (trailingLf && !lines.empty())
+        out.push_back('\n');
+    return out;
+}
+
+// Whitespace-separated fields of an entry, without a leading @marker.
+std::vector<std::string> entryFields(const std::string &line) {
+    std::vector<std::string> fields;
+    std::istringstream in(line);
+    std::string f;
+    while (in >> f)
+        fields.push_back(f);
+    if (!fields.empty() && fields.front()[0] == '@')
+        fields.erase(fields.begin());
+    return fields;
+}
+
+std::vector<std::string> targetTokens(const KnownHostTarget &t) {
+    if (t.port == 22) {
+        // Support this uncommon notation if present in existing files.
+        return {t.host, "[" + t.host + "]:22"};
+    }
+    return {"[" + t.host + "]:" + std::to_string(t.port)};
+}
+
+// Replace `path` with `content` via a synced temporary file and rename.
+bool writeAtomic(const std::string &path, const std::string &content,
+                 std::string &err) {
+#ifndef _WIN32
+    std::string tmp = path + ".tmpXXXXXX";
+    std::vector<char> tmpl(tmp.begin(), tmp.end());
+    tmpl.push_back('\0');
+    const int fd = ::mkstemp(tmpl.data());
+    if (fd < 0) {
+        err = posixErr("mkstemp");
+        return false;
+    }
+    const std::string tmpPath(tmpl.data());
+    auto fail = [&](const std::string &why) {
+        err = why;
+        ::close(fd);
+        (void)::unlink(tmpPath.c_str());
+        return false;
+    };
+    if (!writeAll(fd, content.data(), content.size(), err))
+        return fail(err);
+    if (::fchmod(fd, 0600) != 0)
+        return fail(posixErr("fchmod(tmp)"));
+    if (::fsync(fd) != 0)
+        return fail(posixErr("fsync(tmp)"));
+    if (::close(fd) != 0) {
+        err = posixErr("close(tmp)");
+        (void)::unlink(tmpPath.c_str());
+        return false;
+    }
+    if (::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        err = posixErr("rename(tmp->known_hosts)");
+        (void)::unlink(tmpPath.c_str());
+        return false;
+    }
+    return fsyncParentDir(path, err);
+#else
+    const std::string tmpPath = path + ".tmp";
+    HANDLE h = CreateFileA(tmpPath.c_str(), GENERIC_WRITE, 0, NULL,
+                           CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        err = winErr("CreateFile(tmp)", GetLastError());
+        return false;
+    }
+    auto fail = [&](const char *where) {
+        const DWORD ec = GetLastError();
+        (void)CloseHandle(h);
+        (void)DeleteFileA(tmpPath.c_str());
+        err = winErr(where, ec);
+        return false;
+    };
+    const char *ptr = content.data();
+    std::size_t rem = content.size();
+    while (rem > 0) {
+        const DWORD chunk = rem > static_cast<std::size_t>(0xFFFFFFFFu)
+                                ? static_cast<DWORD>(0xFFFFFFFFu)
+                                : static_cast<DWORD>(rem);
+        DWORD written = 0;
+        if (!WriteFile(h, ptr, chunk, &written, NULL) || written != chunk)
+            return fail("WriteFile(tmp)");
+        ptr += written;
+        rem -= written;
+    }
+    if (!FlushFileBuffers(h))
+        return fail("FlushFileBuffers(tmp)");
+    if (!CloseHandle(h)) {
+        const DWORD ec = GetLastError();
+        (void)DeleteFileA(tmpPath.c_str());
+        err = winErr("CloseHandle(tmp)", ec);
+        return false;
+    }
+    if (!MoveFileExA(tmpPath.c_str(), path.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED)) {
+        const DWORD ec = GetLastError();
+        (void)DeleteFileA(tmpPath.c_str());
+        err = winErr("MoveFileEx(tmp->known_hosts)", ec);
+        return false;
+    }
+    return true;
+#endif
+}
+
+} // namespace
+
+bool AppendKnownHostLine(const std::string &khPath, const std::string &line,
+                         std::string &err) {
+    err.clear();
+    if (khPath.empty()) {
+        err = "known_hosts path is empty";
+        return false;
+    }
+    if (line.empty() || line.find('\n') != std::string::npos) {
+        err = "invalid known_hosts entry";
+        return false;
+    }
+#ifndef _WIN32
+    if (!ensureParentDir0700(khPath, err))
+        return false;
+#endif
+    WriterLock lock;
+    if (!lock.acquire(khPath, err))
+        return false;
+
+    std::string data;
+#ifndef _WIN32
+    const bool existed = ::access(khPath.c_str(), F_OK) == 0;
+    const int fd =
+        ::open(khPath.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        err = posixErr("open(known_hosts)");
+        return false;
+    }
+    struct ::stat st{};
+    char last = '\n';
+    if (::fstat(fd, &st) == 0 && st.st_size > 0 &&
+        ::pread(fd, &last, 1, st.st_size - 1) != 1) {
+        last = '\n';
+    }
+    // An unterminated last line would otherwise swallow the new entry.
+    if (last != '\n')
+        data.push_back('\n');
+    data += line;
+    data.push_back('\n');
+    bool ok = writeAll(fd, data.data(), data.size(), err);
+    if (ok && ::fsync(fd) != 0) {
+        err = posixErr("fsync(known_hosts)");
+        ok = false;
+    }
+    if (::close(fd) != 0 && ok) {
+        err = posixErr("close(known_hosts)");
+        ok = false;
+    }
+    if (ok && !existed)
+        ok = fsyncParentDir(khPath, err);
+#else
+    HANDLE h = CreateFileA(khPath.c_str(), GENERIC_READ | FILE_APPEND_DATA,
+                           FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        err = winErr("CreateFile(known_hosts)", GetLastError());
+        return false;
+    }
+    LARGE_INTEGER size{};
+    char last = '\n';
+    if (GetFileSizeEx(h, &size) && size.QuadPart > 0) {
+        LARGE_INTEGER at{};
+        at.QuadPart = size.QuadPart - 1;
+        DWORD got = 0;
+        if (!SetFilePointerEx(h, at, NULL, FILE_BEGIN) ||
+            !ReadFile(h, &last, 1, &got, NULL) || got != 1)
+            last = '\n';
+    }
+    if (last != '\n')
+        data.push_back('\n');
+    data += line;
+    data.push_back('\n');
+    DWORD written = 0;
+    bool ok = WriteFile(h, data.data(), static_cast<DWORD>(data.size()),
+                        &written, NULL) &&
+              written == data.size();
+    if (!ok)
+        err = winErr("WriteFile(known_hosts)", GetLastError());
+    if (ok && !FlushFileBuffers(h)) {
+        err = winErr("FlushFileBuffers(known_hosts)", GetLastError());
+        ok = false;
+    }
+    CloseHandle(h);
+#endif
+    KnownHostsCache::shared().invalidate(khPath);
+    return ok;
+}
+
+namespace {
+
+bool validTargets(const std::vector<KnownHostTarget> &targets,
+                  std::string &err) {
+    if (std::any_of(targets.begin(), targets.end(),
+                    [](const KnownHostTarget &t) { return t.host.empty(); })) {
+        err = "host is empty";
+        return false;
+    }
+    return true;
+}
+
+// Drop the entries of `targets` and, when `append` is not empty, add it as
+// the last line, in one atomic rewrite. The caller holds the WriterLock.
+bool rewriteEntriesLocked(const std::string &khPath,
+                          const std::vector<KnownHostTarget> &targets,
+                          const std::string &append, std::string &err,
+                          std::size_t *removed) {
+    std::string content;
+    if (!readFile(khPath, content, err))
+        return false;
+
+    std::vector<std::vector<std::string>> tokens;
+    tokens.reserve(targets.size());
+    for (const KnownHostTarget &t : targets)
+        tokens.push_back(targetTokens(t));
+
+    std::vector<std::string> kept;
+    std::size_t dropped = 0;
+    for (std::string &line : splitLines(content)) {
+        bool drop = false;
+        for (std::size_t i = 0; i < targets.size() && !drop; ++i) {
+            if (!knownHostsLineMatches(line, tokens[i]))
+                continue;
+            if (targets[i].key_type.empty()) {
+                drop = true;
+            } else {
+                const std::vector<std::string> fields = entryFields(line);
+                drop = fields.size() > 1 && fields[1] == targets[i].key_type;
+            }
+        }
+        if (drop)
+            ++dropped;
+        else
+            kept.push_back(std::move(line));
+    }
+    if (dropped == 0 && append.empty())
+        return true;
+    if (!append.empty())
+        kept.push_back(append);
+
+    const bool trailingLf = !append.empty() ||
+                            (!content.empty() && content.back() == '\n');
+    std::string why;
+    const bool ok = writeAtomic(khPath, joinLines(kept, trailingLf), why);
+    KnownHostsCache::shared().invalidate(khPath);
+    if (!ok) {
+        err = std::string("Could not write known_hosts: ") + why;
+        return false;
+    }
+    if (removed)
+        *removed = dropped;
+    return true;
+}
+
+} // namespace
+
+bool RemoveKnownHostEntries(const std::string &khPath,
+                            const std::vector<KnownHostTarget> &targets,
+                            std::string &err, std::size_t *removed) {
+    err.clear();
+    if (removed)
+        *removed = 0;
+    if (khPath.empty()) {
+        err = "known_hosts path is empty";
+        return false;
+    }
+    if (!validTargets(targets, err))
+        return false;
+    if (targets.empty())
+        return true;
+
+    WriterLock lock;
+    if (!lock.acquire(khPath, err))
+        return false;
+    return rewriteEntriesLocked(khPath, targets, std::string(), err, removed);
+}
+
+bool ReplaceKnownHostEntries(const std::string &khPath,
+                             const std::vector<KnownHostTarget> &targets,
+                             const std::string &line, std::string &err) {
+    err.clear();
+    if (khPath.empty()) {
+        err = "known_hosts path is empty";
+        return false;
+    }
+    if (line.empty() || line.find('\n') != std::string::npos) {
+        err = "invalid known_hosts entry";
+        return false;
+    }
+    if (!validTargets(targets, err))
+        return false;
+
+    WriterLock lock;
+    if (!lock.acquire(khPath, err))
+        return false;
+    return rewriteEntriesLocked(khPath, targets, line, err, nullptr);
+}
+
+bool RemoveKnownHostEntry(const std::string &khPath, const std::string &host,
+                          std::uint16_t port, std::string &err) {
+    return RemoveKnownHostEntries(khPath, {KnownHostTarget{host, port, {}}},
+                                  err);
+}
+
+bool CompactKnownHosts(const std::string &khPath, std::string &err,
+                       std::size_t *dropped) {
+    err.clear();
+    if (dropped)
+        *dropped = 0;
+    if (khPath.empty()) {
+        err = "known_hosts path is empty";
+        return false;
+    }
+    WriterLock lock;
+    if (!lock.acquire(khPath, err))
+        return false;
+    std::string content;
+    if (!readFile(khPath, content, err))
+        return false;
+
+    std::vector<std::string> kept;
+    std::unordered_set<std::string> seen;
+    std::size_t count = 0;
+    for (std::string &line : splitLines(content)) {
+        // Entries that differ only in spacing count as the same; markers
+        // such as @revoked stay part of the key.
+        std::istringstream in(line);
+        std::string field;
+        std::string key;
+        while (in >> field)
+            key += field + ' ';
+        const bool comment = !key.empty() && key[0] == '#';
+        if (key.empty() || (!comment && !seen.insert(key).second)) {
+            ++count;
+            continue;
+        }
+        kept.push_back(std::move(line));
+    }
+    if (count == 0)
+        return true;
+
+    std::string why;
+    const bool ok = writeAtomic(khPath, joinLines(kept, true), why);
+    KnownHostsCache::shared().invalidate(khPath);
+    if (!ok) {
+        err = std::string("Could not write known_hosts: ") + why;
+        return false;
+    }
+    if (dropped)
+        *dropped = count;
+    return true;
+}
+
+} // namespace openscp
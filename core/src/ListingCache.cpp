@@ -0,0 +1,105 @@
+// Per-session cache of remote directory listings.
+#include "openscp/ListingCache.hpp"
+
+#include <algorithm>
+
+namespace openscp {
+
+std::string ListingCache::normalizePath(const std::string &path) {
+    std::string out;
+    out.reserve(path.size() + 1);
+    out.push_back('/');
+    for (char c : path) {
+        if (c == '/' && out.back() == '/')
+            continue;
+        out.push_back(c);
+    }
+    if (out.size() > 1 && out.back() == '/')
+        out.pop_back();
+    return out;
+}
+
+std::string ListingCache::parentPath(const std::string &path) {
+    const std::string norm = normalizePath(path);
+    const std::size_t slash = norm.find_last_of('/');
+    if (slash == 0 || slash == std::string::npos)
+        return "/";
+    return norm.substr(0, slash);
+}
+
+bool ListingCache::lookup(const std::string &path, std::vector<FileInfo> &out,
+                          bool *fresh) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = entries_.find(normalizePath(path));
+    if (it == entries_.end())
+        return false;
+    out = it->second.items;
+    if (fresh)
+        *fresh = (Clock::now() - it->second.fetchedAt) < ttl_;
+    return true;
+}
+
+bool ListingCache::isFresh(const std::string &path) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = entries_.find(normalizePath(path));
+    return it != entries_.end() && (Clock::now() - it->second.fetchedAt) < ttl_;
+}
+
+void ListingCache::store(const std::string &path, std::vector<FileInfo> items) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const std::string key = normalizePath(path);
+    if (entries_.find(key) == entries_.end() &&
+        entries_.size() >= maxEntries_) {
+        evictOldestLocked();
+    }
+    Entry &e = entries_[key];
+    e.items = std::move(items);
+    e.fetchedAt = Clock::now();
+}
+
+void ListingCache::invalidate(const std::string &path) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    entries_.erase(normalizePath(path));
+}
+
+void ListingCache::invalidateParentOf(const std::string &path) {
+    invalidate(parentPath(path));
+}
+
+void ListingCache::invalidateTree(const std::string &path) {
+    const std::string root = normalizePath(path);
+    const std::string prefix = (root == "/") ? root : root + "/";
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->first == root || it->first.rfind(prefix, 0) == 0)
+            it = entries_.erase(it);
+        else
+            ++it;
+    }
+}
+
+void ListingCache::clear() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    entries_.clear();
+}
+
+void ListingCache::setTtl(Clock::duration ttl) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    ttl_ = ttl;
+}
+
+ListingCache::Clock::duration ListingCache::ttl() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return ttl_;
+}
+
+void ListingCache::evictOldestLocked() {
+    auto oldest = std::min_element(
+        entries_.begin(), entries_.end(), [](const auto &a, const auto &b) {
+            return a.second.fetchedAt < b.second.fetchedAt;
+        });
+    if (oldest != entries_.end())
+        entries_.erase(oldest);
+}
+
+} // namespace openscp
@@ -0,0 +1,193 @@
+// Background warming of a ListingCache with likely-next directories.
+#include "openscp/ListingPrefetcher.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+namespace openscp {
+
+// Shared with the worker thread, which may outlive the prefetcher.
+struct ListingPrefetcher::State {
+    std::shared_ptr<ListingCache> cache;
+    SessionFactory factory;
+    Budget budget;
+
+    std::mutex m; // protects queue, requestedAt, busy and session
+    std::condition_variable cv;
+    std::vector<std::string> queue;
+    Clock::time_point requestedAt{};
+    bool busy = false;
+    std::unique_ptr<SftpClient> session;
+    bool sessionFailed = false; // worker thread only
+    std::atomic<std::uint64_t> generation{0};
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> listed{0};
+
+    bool abandoned(std::uint64_t gen) const {
+        return stop.load() || generation.load() != gen;
+    }
+};
+
+ListingPrefetcher::ListingPrefetcher(std::shared_ptr<ListingCache> cache,
+                                     SessionFactory factory)
+    : ListingPrefetcher(std::move(cache), std::move(factory), Budget{}) {}
+
+ListingPrefetcher::ListingPrefetcher(std::shared_ptr<ListingCache> cache,
+                                     SessionFactory factory, Budget budget)
+    : st_(std::make_shared<State>()) {
+    st_->cache = std::move(cache);
+    st_->factory = std::move(factory);
+    st_->budget = budget;
+    std::thread([st = st_] { run(st); }).detach();
+}
+
+ListingPrefetcher::~ListingPrefetcher() {
+    {
+        std::lock_guard<std::mutex> lk(st_->m);
+        st_->stop.store(true);
+        ++st_->generation;
+        st_->queue.clear();
+        // Unblock a listing that is waiting on the server.
+        if (st_->session)
+            st_->session->interrupt();
+    }
+    st_->cv.notify_all();
+}
+
+void ListingPrefetcher::prefetch(std::vector<std::string> dirs) {
+    std::vector<std::string> unique;
+    unique.reserve(dirs.size());
+    for (const std::string &d : dirs) {
+        std::string norm = ListingCache::normalizePath(d);
+        if (std::find(unique.begin(), unique.end(), norm) == unique.end())
+            unique.push_back(std::move(norm));
+    }
+    {
+        std::lock_guard<std::mutex> lk(st_->m);
+        ++st_->generation;
+        st_->queue = std::move(unique);
+        st_->requestedAt = Clock::now();
+    }
+    st_->cv.notify_all();
+}
+
+void ListingPrefetcher::cancel() {
+    {
+        std::lock_guard<std::mutex> lk(st_->m);
+        ++st_->generation;
+        st_->queue.clear();
+    }
+    st_->cv.notify_all();
+}
+
+void ListingPrefetcher::waitIdle() {
+    std::unique_lock<std::mutex> lk(st_->m);
+    st_->cv.wait(lk, [&] { return st_->queue.empty() && !st_->busy; });
+}
+
+std::uint64_t ListingPrefetcher::listedCount() const {
+    return st_->listed.load();
+}
+
+void ListingPrefetcher::run(const std::shared_ptr<State> &st) {
+    std::unique_lock<std::mutex> lk(st->m);
+    for (;;) {
+        st->cv.wait(lk,
+                    [&] { return st->stop.load() || !st->queue.empty(); });
+        if (st->stop.load())
+            break;
+        // Debounce: a user clicking through folders only pays for the
+        // folder they stop at.
+        const Clock::time_point start =
+            st->requestedAt + st->budget.idle_delay;
+        if (Clock::now() < start) {
+            st->cv.wait_until(lk, start);
+            continue; // re-check: the request may have been replaced
+        }
+        std::vector<std::string> dirs;
+        dirs.swap(st->queue);
+        const std::uint64_t generation = st->generation.load();
+        st->busy = true;
+        lk.unlock();
+        runRequest(*st, dirs, generation);
+        lk.lock();
+        st->busy = false;
+        st->cv.notify_all();
+    }
+    std::unique_ptr<SftpClient> session = std::move(st->session);
+    lk.unlock();
+    if (session)
+        session->disconnect();
+}
+
+void ListingPrefetcher::runRequest(State &st,
+                                   const std::vector<std::string> &dirs,
+                                   std::uint64_t generation) {
+    std::size_t entries = 0;
+    std::size_t fetched = 0;
+    for (const std::string &dir : dirs) {
+        if (st.abandoned(generation) ||
+            fetched >= st.budget.max_directories ||
+            entries >= st.budget.max_entries)
+            return;
+        if (st.cache->isFresh(dir))
+            continue;
+
+        if (!st.session) {
+            if (st.sessionFailed || !st.factory)
+                return;
+            std::string err;
+            std::unique_ptr<SftpClient> session = st.factory(err);
+            if (!session) {
+                st.sessionFailed = true;
+                return;
+            }
+            std::lock_guard<std::mutex> lk(st.m);
+            st.session = std::move(session);
+        }
+
+        // Only complete listings are stored; one that would overrun the
+        // entry budget is abandoned instead of cached partially.
+        std::vector<FileInfo> items;
+        bool overBudget = false;
+        std::string err;
+        const bool ok = st.session->listStream(
+            dir,
+            [&](std::vector<FileInfo> &&batch) {
+                if (st.abandoned(generation))
+                    return false;
+                if (entries + items.size() + batch.size() >
+                    st.budget.max_entries) {
+                    overBudget = true;
+                    return false;
+                }
+                items.insert(items.end(),
+                             std::make_move_iterator(batch.begin()),
+                             std::make_move_iterator(batch.end()));
+                return true;
+            },
+            err);
+        ++fetched;
+        if (overBudget || st.abandoned(generation))
+            return;
+        if (!ok) {
+            // A dead session is dropped and reopened by the next request;
+            // an unreadable directory just costs its slot in the budget.
+            if (!st.session->isConnected()) {
+                std::lock_guard<std::mutex> lk(st.m);
+                st.session.reset();
+                return;
+            }
+            continue;
+        }
+        entries += items.size();
+        st.cache->store(dir, std::move(items));
+        ++st.listed;
+    }
+}
+
+} // namespace openscp
@@ -0,0 +1,354 @@
+// Parallel local copy/move engine using in-kernel copies where available.
+#include "openscp/LocalCopy.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+#ifdef __APPLE__
+#include <sys/clonefile.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace openscp {
+
+namespace {
+
+// Bytes per in-kernel copy call, and between progress reports.
+constexpr std::size_t kCopyChunk = 8 * 1024 * 1024;
+constexpr std::size_t kReadWriteBuffer = 1024 * 1024;
+
+#ifndef _WIN32
+std::string errnoText(const std::string &what) {
+    return what + ": " + std::strerror(errno);
+}
+
+// Errors meaning "this method does not apply here", not a failed copy.
+bool unsupported(int e) {
+    return e == ENOSYS || e == EXDEV || e == EINVAL || e == EOPNOTSUPP ||
+           e == ENOTTY || e == EBADF;
+}
+
+bool copyReadWrite(int in, int out, std::uint64_t &done,
+                   const std::function<bool(std::uint64_t)> &progress,
+                   std::string &err) {
+    std::vector<char> buf(kReadWriteBuffer);
+    std::uint64_t reported = done;
+    while (true) {
+        const ssize_t got = ::pread(in, buf.data(), buf.size(), (off_t)done);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0) {
+            err = errnoText("Local read failed");
+            return false;
+        }
+        if (got == 0)
+            return true;
+        std::size_t off = 0;
+        while (off < (std::size_t)got) {
+            const ssize_t w = ::pwrite(out, buf.data() + off, got - off,
+                                       (off_t)(done + off));
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w <= 0) {
+                err = errnoText("Local write failed");
+                return false;
+            }
+            off += (std::size_t)w;
+        }
+        done += (std::uint64_t)got;
+        if (done - reported >= kCopyChunk) {
+            reported = done;
+            if (progress && !progress(done)) {
+                err = "Canceled by user";
+                return false;
+            }
+        }
+    }
+}
+#endif
+
+} // namespace
+
+bool copyLocalFile(const std::string &src, const std::string &dst,
+                   const std::function<bool(std::uint64_t)> &progress,
+                   LocalCopyMethod *used, std::string &err) {
+    if (used)
+        *used = LocalCopyMethod::None;
+#ifdef _WIN32
+    // CopyFileEx already uses the fastest path (block cloning on ReFS).
+    std::error_code ec;
+    fs::copy_file(fs::path(src), fs::path(dst),
+                  fs::copy_options::overwrite_existing, ec);
+    if (ec) {
+        err = "Could not copy file " + src + ": " + ec.message();
+        return false;
+    }
+    if (used)
+        *used = LocalCopyMethod::ReadWrite;
+    if (progress)
+        progress(fs::file_size(fs::path(dst), ec));
+    return true;
+#else
+    const int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        err = errnoText("Could not open " + src);
+        return false;
+    }
+    struct stat st {};
+    if (::fstat(in, &st) != 0) {
+        err = errnoText("fstat(" + src + ")");
+        ::close(in);
+        return false;
+    }
+    // Replace rather than truncate: never write through a hard link.
+    ::unlink(dst.c_str());
+#ifdef __APPLE__
+    if (::clonefile(src.c_str(), dst.c_str(), 0) == 0) {
+        ::close(in);
+        if (used)
+            *used = LocalCopyMethod::Clone;
+        if (progress)
+            progress((std::uint64_t)st.st_size);
+        return true;
+    }
+#endif
+    const int out = ::open(dst.c_str(),
+                           O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                           st.st_mode & 0777);
+    if (out < 0) {
+        err = errnoText("Could not create " + dst);
+        ::close(in);
+        return false;
+    }
+    ::fchmod(out, st.st_mode & 07777);
+
+    bool ok = true;
+    bool finished = false;
+    std::uint64_t done = 0;
+    LocalCopyMethod method = LocalCopyMethod::ReadWrite;
+    const std::uint64_t size = (std::uint64_t)st.st_size;
+    auto report = [&]() {
+        if (progress && !progress(done)) {
+            err = "Canceled by user";
+            ok = false;
+        }
+        return ok;
+    };
+#ifdef __linux__
+    if (size > 0 && ::ioctl(out, FICLONE, in) == 0) {
+        method = LocalCopyMethod::Clone;
+        done = size;
+        finished = true;
+        report();
+    }
+    // copy_file_range, then sendfile, each continuing from `done`.
+    for (int pass = 0; ok && !finished && pass < 2; ++pass) {
+        const auto kind = (pass == 0) ? LocalCopyMethod::CopyFileRange
+                                      : LocalCopyMethod::Sendfile;
+        while (ok) {
+            off_t offIn = (off_t)done;
+            off_t offOut = (off_t)done;
+            const ssize_t n =
+                (pass == 0)
+                    ? ::copy_file_range(in, &offIn, out, &offOut, kCopyChunk,
+                                        0)
+                    : ((::lseek(out, offOut, SEEK_SET) < 0)
+                           ? -1
+                           : ::sendfile(out, in, &offIn, kCopyChunk));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0) {
+                if (!unsupported(errno)) {
+                    err = errnoText("Could not copy " + src);
+                    ok = false;
+                }
+                break; // try the next method from here
+            }
+            if (n == 0) {
+                finished = (done >= size);
+                break;
+            }
+            method = kind;
+            done += (std::uint64_t)n;
+            report();
+        }
+    }
+#endif
+    if (ok && !finished) {
+        std::uint64_t before = done;
+        ok = copyReadWrite(in, out, done, progress, err);
+        if (ok && done != before)
+            method = LocalCopyMethod::ReadWrite;
+        if (ok)
+            report();
+    }
+    ::close(in);
+    if (::close(out) != 0 && ok) {
+        err = errnoText("Could not write " + dst);
+        ok = false;
+    }
+    if (!ok) {
+        ::unlink(dst.c_str());
+        return false;
+    }
+    if (used)
+        *used = (size == 0) ? LocalCopyMethod::None : method;
+    return true;
+#endif
+}
+
+bool runLocalCopy(const std::vector<LocalCopyItem> &items,
+                  const LocalCopyOptions &opt,
+                  std::vector<LocalCopyOutcome> &outcomes) {
+    struct FileJob {
+        fs::path src;
+        fs::path dst;
+        std::uint64_t size = 0;
+        std::size_t item = 0;
+    };
+    outcomes.assign(items.size(), LocalCopyOutcome{true, {}});
+    std::vector<bool> renamed(items.size(), false);
+    std::mutex outcomeMutex;
+    auto fail = [&](std::size_t item, const std::string &why) {
+        std::lock_guard<std::mutex> lk(outcomeMutex);
+        if (outcomes[item].ok) {
+            outcomes[item].ok = false;
+            outcomes[item].error = why;
+        }
+    };
+    auto canceled = [&]() { return opt.shouldCancel && opt.shouldCancel(); };
+
+    // Plan: create the folders up front and list the files.
+    std::vector<FileJob> jobs;
+    for (std::size_t i = 0; i < items.size() && !canceled(); ++i) {
+        const fs::path src = fs::path(items[i].source);
+        const fs::path dst = fs::path(items[i].target);
+        std::error_code ec;
+        if (opt.move && !fs::exists(fs::symlink_status(dst, ec))) {
+            fs::create_directories(dst.parent_path(), ec);
+            fs::rename(src, dst, ec);
+            if (!ec) {
+                renamed[i] = true;
+                continue;
+            }
+        }
+        const fs::file_status st = fs::status(src, ec);
+        if (fs::is_regular_file(st)) {
+            fs::create_directories(dst.parent_path(), ec);
+            jobs.push_back({src, dst, fs::file_size(src, ec), i});
+        } else if (fs::is_directory(st)) {
+            if (!fs::create_directories(dst, ec) && ec) {
+                fail(i, "Could not create destination folder: " +
+                            items[i].target);
+                continue;
+            }
+            fs::recursive_directory_iterator it(src, ec), end;
+            for (; !ec && it != end; it.increment(ec)) {
+                const fs::path target =
+                    dst / it->path().lexically_relative(src);
+                std::error_code fec;
+                if (it->is_directory(fec)) {
+                    if (!fs::create_directories(target, fec) && fec) {
+                        fail(i, "Could not create destination subfolder: " +
+                                    target.string());
+                        break;
+                    }
+                } else if (it->is_regular_file(fec)) {
+                    jobs.push_back({it->path(), target, it->file_size(fec), i});
+                }
+            }
+            if (ec)
+                fail(i, "Could not list " + items[i].source + ": " +
+                            ec.message());
+        } else {
+            fail(i, "Source entry is neither file nor folder.");
+        }
+    }
+
+    // Largest first, so the run does not end on one long straggler.
+    std::stable_sort(jobs.begin(), jobs.end(),
+                     [](const FileJob &a, const FileJob &b) {
+                         return a.size > b.size;
+                     });
+    std::uint64_t total = 0;
+    for (const auto &j : jobs)
+        total += j.size;
+    std::atomic<std::uint64_t> done{0};
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> stop{false};
+
+    auto worker = [&]() {
+        while (!stop.load()) {
+            const std::size_t idx = next.fetch_add(1);
+            if (idx >= jobs.size())
+                return;
+            if (canceled()) {
+                stop.store(true);
+                return;
+            }
+            const FileJob &job = jobs[idx];
+            std::uint64_t reported = 0;
+            auto progress = [&](std::uint64_t copied) {
+                const std::uint64_t all =
+                    done.fetch_add(copied - reported) + (copied - reported);
+                reported = copied;
+                if (opt.progress)
+                    opt.progress(all, total);
+                return !canceled();
+            };
+            std::string err;
+            if (!copyLocalFile(job.src.string(), job.dst.string(),
+                               progress, nullptr, err))
+                fail(job.item, err);
+        }
+    };
+    const std::size_t threads = std::min<std::size_t>(
+        std::max(1, opt.threads), std::max<std::size_t>(1, jobs.size()));
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool)
+        t.join();
+
+    bool allOk = true;
+    const bool wasCanceled = canceled() || stop.load();
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        if (renamed[i])
+            continue;
+        if (wasCanceled)
+            fail(i, "Canceled by user");
+        if (!outcomes[i].ok) {
+            allOk = false;
+            continue;
+        }
+        if (opt.move) {
+            std::error_code ec;
+            fs::remove_all(fs::path(items[i].source), ec);
+            if (ec) {
+                fail(i, "Could not delete source: " + items[i].source);
+                allOk = false;
+            }
+        }
+    }
+    return allOk;
+}
+
+} // namespace openscp
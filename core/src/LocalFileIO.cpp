@@ -0,0 +1,591 @@
+// Local file I/O shared by the transfer loops of every backend.
+#include "openscp/LocalFileIO.hpp"
+#include "openscp/SftpTypes.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <new>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace openscp {
+
+namespace {
+
+constexpr std::size_t kLocalIoAlignment = 4096;
+// Bypass mode writes back / releases the cache in steps of this many bytes.
+constexpr std::uint64_t kCacheReleaseStep = 8 * 1024 * 1024;
+// Granularity of sparse detection: the smallest hole filesystems track.
+constexpr std::size_t kSparseBlock = 4096;
+
+std::string errnoText(const char *what) {
+    return std::string(what) + ": " + std::strerror(errno);
+}
+
+bool isAllZero(const char *p, std::size_t n) {
+    return n == 0 || (p[0] == 0 && std::memcmp(p, p + 1, n - 1) == 0);
+}
+
+} // namespace
+
+LocalIoOptions localIoOptionsFrom(const SessionOptions &opt) {
+    LocalIoOptions out;
+    if (opt.local_io_buffer_size)
+        out.buffer_size = std::clamp(opt.local_io_buffer_size,
+                                     kMinLocalIoBufferSize,
+                                     kMaxLocalIoBufferSize);
+    out.bypass_cache = opt.local_io_bypass_cache;
+    out.sparse_files = opt.local_io_sparse_files;
+    return out;
+}
+
+LocalIoBuffer::LocalIoBuffer(std::size_t size)
+    : data_(static_cast<char *>(
+          ::operator new(std::max<std::size_t>(size, 1),
+                         std::align_val_t(kLocalIoAlignment)))),
+      size_(size) {}
+
+void LocalIoBuffer::Free::operator()(char *p) const {
+    ::operator delete(p, std::align_val_t(kLocalIoAlignment));
+}
+
+// --- LocalFileReader -------------------------------------------------------
+
+bool LocalFileReader::isOpen() const {
+#ifdef _WIN32
+    return file_ != nullptr || map_ != nullptr;
+#else
+    return fd_ >= 0;
+#endif
+}
+
+bool LocalFileReader::open(const std::string &path, const LocalIoOptions &opt,
+                           std::string &err) {
+    close();
+    opt_ = opt;
+#ifdef _WIN32
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_) {
+        err = "Could not open local file for reading";
+        return false;
+    }
+    if (_fseeki64(file_, 0, SEEK_END) != 0) {
+        close();
+        err = "Could not determine local file size";
+        return false;
+    }
+    const __int64 end = _ftelli64(file_);
+    size_ = end > 0 ? (std::uint64_t)end : 0;
+    if (size_ > 0 && size_ <= std::numeric_limits<std::size_t>::max()) {
+        HANDLE fh = (HANDLE)_get_osfhandle(_fileno(file_));
+        HANDLE mh =
+            CreateFileMappingA(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mh) {
+            map_ = static_cast<const char *>(
+                MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mh);
+        }
+    }
+#else
+    int flags = O_RDONLY;
+#ifdef O_CLOEXEC
+    flags |= O_CLOEXEC;
+#endif
+    fd_ = ::open(path.c_str(), flags);
+    if (fd_ < 0) {
+        err = "Could not open local file for reading";
+        return false;
+    }
+    struct ::stat st{};
+    if (::fstat(fd_, &st) != 0) {
+        err = errnoText("fstat(local)");
+        close();
+        return false;
+    }
+    size_ = st.st_size > 0 ? (std::uint64_t)st.st_size : 0;
+#ifdef __APPLE__
+    if (opt_.bypass_cache)
+        (void)::fcntl(fd_, F_NOCACHE, 1);
+#endif
+    if (S_ISREG(st.st_mode) && size_ > 0 &&
+        size_ <= std::numeric_limits<std::size_t>::max()) {
+        void *view = ::mmap(nullptr, (std::size_t)size_, PROT_READ, MAP_SHARED,
+                            fd_, 0);
+        if (view != MAP_FAILED) {
+            map_ = static_cast<const char *>(view);
+            (void)::madvise(view, (std::size_t)size_, MADV_SEQUENTIAL);
+        }
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (!map_)
+        (void)::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+    return true;
+}
+
+void LocalFileReader::close() {
+#ifdef _WIN32
+    if (map_)
+        UnmapViewOfFile(map_);
+    if (file_)
+        std::fclose(file_);
+    file_ = nullptr;
+#else
+    if (map_)
+        ::munmap(const_cast<char *>(map_), (std::size_t)size_);
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+#endif
+    map_ = nullptr;
+    size_ = 0;
+    dropped_ = 0;
+}
+
+bool LocalFileReader::read(std::uint64_t offset, std::size_t max,
+                           char *scratch, const char *&data, std::size_t &n,
+                           std::string &err) {
+    data = scratch;
+    n = 0;
+    if (!isOpen()) {
+        err = "Local file is not open";
+        return false;
+    }
+    if (map_) {
+        if (offset >= size_)
+            return true;
+        n = (std::size_t)std::min<std::uint64_t>(max, size_ - offset);
+        if (mappingCovers(offset + n)) {
+            data = map_ + offset;
+            dropConsumed(offset);
+            return true;
+        }
+        n = 0; // the file shrank: continue with positioned reads
+    }
+#ifdef _WIN32
+    if (_fseeki64(file_, (__int64)offset, SEEK_SET) != 0) {
+        err = "Local seek failed";
+        return false;
+    }
+    n = std::fread(scratch, 1, max, file_);
+    if (n < max && std::ferror(file_)) {
+        err = "Local read failed";
+        return false;
+    }
+#else
+    while (n < max) {
+        const ssize_t got =
+            ::pread(fd_, scratch + n, max - n, (off_t)(offset + n));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0) {
+            err = errnoText("pread(local)");
+            return false;
+        }
+        if (got == 0)
+            break;
+        n += (std::size_t)got;
+    }
+    dropConsumed(offset);
+#endif
+    return true;
+}
+
+bool LocalFileReader::mappingCovers(std::uint64_t end) {
+#ifdef _WIN32
+    // A file with a mapped view cannot be truncated on Windows.
+    (void)end;
+    return true;
+#else
+    // Touching mapped pages past the current EOF raises SIGBUS, so every
+    // window is checked against the file as it is now. A truncated source
+    // drops the mapping for good; pread() then just sees the shorter file.
+    struct ::stat st{};
+    if (::fstat(fd_, &st) == 0 && st.st_size >= 0 &&
+        (std::uint64_t)st.st_size >= end)
+        return true;
+    ::munmap(const_cast<char *>(map_), (std::size_t)size_);
+    map_ = nullptr;
+    return false;
+#endif
+}
+
+void LocalFileReader::dropConsumed(std::uint64_t upTo) {
+    if (!opt_.bypass_cache || upTo < dropped_ + kCacheReleaseStep)
+        return;
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+    if (map_) {
+        // Page-aligned because the mapping starts at offset 0 and both ends
+        // are multiples of the release step.
+        const std::uint64_t end = upTo - upTo % kCacheReleaseStep;
+        (void)::madvise(const_cast<char *>(map_) + dropped_,
+                        (std::size_t)(end - dropped_), MADV_DONTNEED);
+        (void)::posix_fadvise(fd_, (off_t)dropped_, (off_t)(end - dropped_),
+                              POSIX_FADV_DONTNEED);
+        dropped_ = end;
+        return;
+    }
+    (void)::posix_fadvise(fd_, (off_t)dropped_, (off_t)(upTo - dropped_),
+                          POSIX_FADV_DONTNEED);
+#endif
+    dropped_ = upTo;
+}
+
+// --- LocalFileWriter -------------------------------------------------------
+
+LocalFileWriter::~LocalFileWriter() {
+    std::string ignored;
+    (void)close(ignored);
+}
+
+bool LocalFileWriter::isOpen() const {
+#ifdef _WIN32
+    return file_ != nullptr;
+#else
+    return fd_ >= 0;
+#endif
+}
+
+bool LocalFileWriter::open(const std::string &path, Mode mode,
+                           const LocalIoOptions &opt, std::string &err) {
+    std::string ignored;
+    (void)close(ignored);
+    opt_ = opt;
+    initialSize_ = 0;
+    unflushed_ = 0;
+    skippedHoles_ = false;
+    touchedBegin_ = touchedEnd_ = 0;
+#ifdef _WIN32
+    if (mode == Mode::Keep)
+        file_ = std::fopen(path.c_str(), "r+b");
+    if (!file_)
+        file_ = std::fopen(path.c_str(), "w+b");
+    if (!file_) {
+        err = "Could not open local file for writing";
+        return false;
+    }
+    if (_fseeki64(file_, 0, SEEK_END) == 0) {
+        const __int64 end = _ftelli64(file_);
+        initialSize_ = end > 0 ? (std::uint64_t)end : 0;
+    }
+#else
+    int flags = O_WRONLY | O_CREAT | (mode == Mode::Truncate ? O_TRUNC : 0);
+#ifdef O_CLOEXEC
+    flags |= O_CLOEXEC;
+#endif
+    fd_ = ::open(path.c_str(), flags, 0644);
+    if (fd_ < 0) {
+        err = "Could not open local file for writing";
+        return false;
+    }
+    struct ::stat st{};
+    if (::fstat(fd_, &st) == 0 && st.st_size > 0)
+        initialSize_ = (std::uint64_t)st.st_size;
+#ifdef __APPLE__
+    if (opt_.bypass_cache)
+        (void)::fcntl(fd_, F_NOCACHE, 1);
+#endif
+#endif
+    logicalEnd_ = allocEnd_ = initialSize_;
+    return true;
+}
+
+bool LocalFileWriter::preallocate(std::uint64_t total) {
+    if (!isOpen() || total <= initialSize_)
+        return false;
+    allocEnd_ = std::max(allocEnd_, total);
+#if defined(_WIN32)
+    FILE_ALLOCATION_INFO info{};
+    info.AllocationSize.QuadPart = (LONGLONG)total;
+    HANDLE fh = (HANDLE)_get_osfhandle(_fileno(file_));
+    return SetFileInformationByHandle(fh, FileAllocationInfo, &info,
+                                      sizeof(info)) != 0;
+#elif defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    // posix_fallocate() would move EOF, which breaks resume (the .part size
+    // is the resume offset); KEEP_SIZE reserves the extents only.
+    return ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, (off_t)initialSize_,
+                       (off_t)(total - initialSize_)) == 0;
+#elif defined(__APPLE__)
+    fstore_t store{};
+    store.fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_offset = 0;
+    store.fst_length = (off_t)(total - initialSize_);
+    if (::fcntl(fd_, F_PREALLOCATE, &store) == 0)
+        return true;
+    store.fst_flags = F_ALLOCATEALL; // contiguous space not available
+    return ::fcntl(fd_, F_PREALLOCATE, &store) == 0;
+#else
+    (void)total;
+    return false;
+#endif
+}
+
+bool LocalFileWriter::writeAt(std::uint64_t offset, const char *data,
+                              std::size_t len, std::string &err) {
+    if (!isOpen()) {
+        err = "Local file is not open";
+        return false;
+    }
+    logicalEnd_ = std::max(logicalEnd_, offset + len);
+    if (touchedEnd_ == touchedBegin_)
+        touchedBegin_ = offset;
+    touchedBegin_ = std::min(touchedBegin_, offset);
+    touchedEnd_ = std::max(touchedEnd_, offset + len);
+    if (!opt_.sparse_files)
+        return writeRaw(offset, data, len, err);
+
+    // Split into runs of data and of whole, aligned zero blocks; a zero run
+    // is only skipped where the file already reads as zeros.
+    std::size_t pos = 0;
+    while (pos < len) {
+        const std::uint64_t at = offset + pos;
+        std::size_t end =
+            pos + std::min<std::size_t>(len - pos,
+                                        kSparseBlock - at % kSparseBlock);
+        const bool zero =
+            end - pos == kSparseBlock && isAllZero(data + pos, kSparseBlock);
+        while (end < len) {
+            const std::size_t n = std::min(len - end, kSparseBlock);
+            if ((n == kSparseBlock && isAllZero(data + end, n)) != zero)
+                break;
+            end += n;
+        }
+        if (zero && regionIsHole(at, end - pos))
+            skippedHoles_ = true;
+        else if (!writeRaw(at, data + pos, end - pos, err))
+            return false;
+        pos = end;
+    }
+    return true;
+}
+
+bool LocalFileWriter::writeRaw(std::uint64_t offset, const char *data,
+                               std::size_t len, std::string &err) {
+#ifdef _WIN32
+    if (_fseeki64(file_, (__int64)offset, SEEK_SET) != 0 ||
+        std::fwrite(data, 1, len, file_) != len) {
+        err = "Local write failed";
+        return false;
+    }
+#else
+    std::size_t done = 0;
+    while (done < len) {
+        const ssize_t w =
+            ::pwrite(fd_, data + done, len - done, (off_t)(offset + done));
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0) {
+            err = (w < 0) ? errnoText("Local write failed")
+                          : std::string("Local write failed");
+            return false;
+        }
+        done += (std::size_t)w;
+    }
+#endif
+    writeBehind(len);
+    return true;
+}
+
+bool LocalFileWriter::regionIsHole(std::uint64_t offset,
+                                   std::size_t len) const {
+#if !defined(_WIN32) && defined(SEEK_DATA)
+    const off_t next = ::lseek(fd_, (off_t)offset, SEEK_DATA);
+    if (next < 0)
+        return errno == ENXIO; // no data at or after offset
+    return (std::uint64_t)next >= offset + len;
+#else
+    (void)offset;
+    (void)len;
+    return false;
+#endif
+}
+
+// Preallocated-but-unwritten extents report as holes, so walking the holes
+// of the reserved range finds exactly the blocks skipped zero runs left
+// reserved; punching them gives the space back. Done once the file covers
+// them, since filesystems ignore punches past EOF.
+void LocalFileWriter::releaseHoles() {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE) && defined(SEEK_HOLE)
+    // Only the span this writer wrote: other parts of a shared file (other
+    // segments) keep their reservation until they are downloaded.
+    const std::uint64_t end = std::min(allocEnd_, touchedEnd_);
+    std::uint64_t pos = touchedBegin_;
+    while (pos < end) {
+        const off_t hole = ::lseek(fd_, (off_t)pos, SEEK_HOLE);
+        if (hole < 0 || (std::uint64_t)hole >= end)
+            break;
+        off_t data = ::lseek(fd_, hole, SEEK_DATA);
+        if (data < 0 || (std::uint64_t)data > end)
+            data = (off_t)end;
+        (void)::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                          hole, data - hole);
+        pos = (std::uint64_t)data;
+    }
+#endif
+}
+
+// A skipped run at the end of the data leaves the file short; extend it
+// (as a hole) to the length that was written.
+bool LocalFileWriter::settleLength(std::string &err) {
+    if (!skippedHoles_)
+        return true;
+#ifndef _WIN32
+    struct ::stat st{};
+    if (::fstat(fd_, &st) != 0) {
+        err = errnoText("fstat(local)");
+        return false;
+    }
+    if ((std::uint64_t)st.st_size < logicalEnd_ &&
+        ::ftruncate(fd_, (off_t)logicalEnd_) != 0) {
+        err = errnoText("ftruncate(local)");
+        return false;
+    }
+    if (allocEnd_ > 0)
+        releaseHoles();
+#else
+    (void)err;
+#endif
+    skippedHoles_ = false;
+    return true;
+}
+
+void LocalFileWriter::writeBehind(std::size_t len) {
+    if (!opt_.bypass_cache)
+        return;
+    unflushed_ += len;
+    if (unflushed_ < kCacheReleaseStep)
+        return;
+    unflushed_ = 0;
+#if defined(__linux__) && defined(SYNC_FILE_RANGE_WRITE)
+    // Write the dirty pages back and drop them, so a long download does not
+    // fill the page cache. Positioned writes may land anywhere in the file,
+    // hence whole-file ranges; only dirty/cached pages cost anything.
+    (void)::sync_file_range(fd_, 0, 0,
+                            SYNC_FILE_RANGE_WAIT_BEFORE |
+                                SYNC_FILE_RANGE_WRITE |
+                                SYNC_FILE_RANGE_WAIT_AFTER);
+    (void)::posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+}
+
+bool LocalFileWriter::truncate(std::uint64_t size, std::string &err) {
+    if (!isOpen()) {
+        err = "Local file is not open";
+        return false;
+    }
+#ifdef _WIN32
+    if (std::fflush(file_) != 0 ||
+        _chsize_s(_fileno(file_), (__int64)size) != 0) {
+        err = "Could not truncate local file";
+        return false;
+    }
+#else
+    if (::ftruncate(fd_, (off_t)size) != 0) {
+        err = errnoText("ftruncate(local)");
+        return false;
+    }
+#endif
+    logicalEnd_ = size;
+    return true;
+}
+
+bool LocalFileWriter::sync(std::string &err) {
+    if (!isOpen()) {
+        err = "Local file is not open";
+        return false;
+    }
+    if (!settleLength(err))
+        return false;
+#ifdef _WIN32
+    if (std::fflush(file_) != 0 || _commit(_fileno(file_)) != 0) {
+        err = "commit(local) failed";
+        return false;
+    }
+#else
+    if (::fsync(fd_) != 0) {
+        err = errnoText("fsync(local)");
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool LocalFileWriter::close(std::string &err) {
+    if (!isOpen())
+        return true;
+    const bool settled = settleLength(err);
+#ifdef _WIN32
+    const bool ok = std::fclose(file_) == 0;
+    file_ = nullptr;
+#else
+    const bool ok = ::close(fd_) == 0;
+    fd_ = -1;
+#endif
+    if (!ok)
+        err = "Could not finalize local file";
+    return settled && ok;
+}
+
+// --- Finalizing -----------------------------------------------------------
+
+#ifndef _WIN32
+static bool syncParentDir(const std::string &path, std::string &err) {
+    std::string dir = path;
+    const std::size_t p = dir.find_last_of('/');
+    if (p == std::string::npos)
+        dir = ".";
+    else
+        dir.resize(p);
+    const int dfd = ::open(dir.c_str(), O_RDONLY);
+    if (dfd < 0) {
+        err = errnoText("open(parent)");
+        return false;
+    }
+    if (::fsync(dfd) != 0) {
+        err = errnoText("fsync(parent)");
+        ::close(dfd);
+        return false;
+    }
+    if (::close(dfd) != 0) {
+        err = errnoText("close(parent)");
+        return false;
+    }
+    return true;
+}
+#endif
+
+bool replaceLocalFileAtomic(const std::string &from, const std::string &to,
+                            std::string &err) {
+#ifndef _WIN32
+    if (::rename(from.c_str(), to.c_str()) != 0) {
+        err = errnoText("rename(.part->dest)");
+        return false;
+    }
+    return syncParentDir(to, err);
+#else
+    if (!MoveFileExA(from.c_str(), to.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED)) {
+        err = "MoveFileEx(.part->dest) failed (GetLastError=" +
+              std::to_string((unsigned long)GetLastError()) + ")";
+        return false;
+    }
+    return true;
+#endif
+}
+
+} // namespace openscp
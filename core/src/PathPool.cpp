@@ -0,0 +1,73 @@
+// Interned storage for many paths that share directories.
+#include "openscp/PathPool.hpp"
+
+#include <limits>
+
+namespace openscp {
+
+static constexpr std::size_t kMinCompactionBytes = 1 << 20;
+
+PathPool::Ref PathPool::intern(std::string_view path) {
+    static constexpr std::size_t kMaxLeafBytes =
+        std::numeric_limits<std::uint32_t>::max();
+    Ref r;
+    const std::size_t slash = path.find_last_of('/');
+    std::size_t split = (slash == std::string_view::npos) ? 0 : slash + 1;
+    // No real name is this long; the prefix takes what a Ref cannot.
+    if (path.size() - split > kMaxLeafBytes)
+        split = path.size() - kMaxLeafBytes;
+    if (split > 0)
+        r.dir = internDirectory(path.substr(0, split));
+    const std::string_view leaf = path.substr(split);
+    r.leafBegin = leaves_.size();
+    r.leafSize = static_cast<std::uint32_t>(leaf.size());
+    leaves_.append(leaf);
+    return r;
+}
+
+std::uint32_t PathPool::internDirectory(std::string_view dir) {
+    if (lastDir_ && dirs_[lastDir_ - 1] == dir)
+        return lastDir_;
+    auto it = dirIndex_.find(dir);
+    if (it == dirIndex_.end()) {
+        dirs_.emplace_back(dir);
+        const auto id = static_cast<std::uint32_t>(dirs_.size());
+        it = dirIndex_.emplace(std::string_view(dirs_.back()), id).first;
+    }
+    lastDir_ = it->second;
+    return lastDir_;
+}
+
+std::string PathPool::str(const Ref &r) const {
+    const std::string_view d = directory(r);
+    const std::string_view l = leaf(r);
+    std::string out;
+    out.reserve(d.size() + l.size());
+    out.append(d);
+    out.append(l);
+    return out;
+}
+
+bool PathPool::needsCompaction() const {
+    return garbage_ >= kMinCompactionBytes && garbage_ * 2 > leaves_.size();
+}
+
+void PathPool::clear() {
+    dirIndex_.clear();
+    dirs_.clear();
+    lastDir_ = 0;
+    leaves_.clear();
+    garbage_ = 0;
+}
+
+std::size_t PathPool::memoryUsage() const {
+    std::size_t bytes = leaves_.capacity();
+    for (const std::string &d : dirs_)
+        bytes += sizeof(std::string) + d.capacity();
+    bytes += dirIndex_.size() *
+             (sizeof(std::string_view) + sizeof(std::uint32_t) +
+              2 * sizeof(void *));
+    return bytes;
+}
+
+} // namespace openscp
@@ -0,0 +1,255 @@
+// Destination prechecks of queued transfers answered from listings.
+#include "openscp/PrecheckCache.hpp"
+
+#include "openscp/ListingCache.hpp"
+
+#include <iterator>
+#include <vector>
+
+namespace openscp {
+namespace {
+
+std::string baseName(const std::string &normalized) {
+    return normalized.substr(normalized.find_last_of('/') + 1);
+}
+
+} // namespace
+
+bool PrecheckCache::freshLocked(const Dir &d) const {
+    return d.ready && (Clock::now() - d.fetchedAt) < ttl_;
+}
+
+bool PrecheckCache::lookup(SftpClient &client, const std::string &path,
+                           bool &exists, FileInfo &info, std::string &err) {
+    const std::string norm = ListingCache::normalizePath(path);
+    info = FileInfo{};
+    if (norm == "/") {
+        exists = true;
+        info.name = "/";
+        info.is_dir = true;
+        return true;
+    }
+    const std::string dir = ListingCache::parentPath(norm);
+    const std::string name = baseName(norm);
+    auto answer = [&](const Dir &d) {
+        const auto it = d.entries.find(name);
+        exists = !d.missing && it != d.entries.end();
+        if (exists)
+            info = it->second;
+    };
+    // Paths of an oversized directory go to the server one by one.
+    auto askServer = [&]() {
+        bool isDir = false;
+        std::string existsErr;
+        exists = client.exists(norm, isDir, existsErr);
+        if (!existsErr.empty()) {
+            err = existsErr;
+            return false;
+        }
+        return !exists || client.stat(norm, info, err);
+    };
+
+    std::unique_lock<std::mutex> lk(mtx_);
+    for (;;) {
+        auto it = dirs_.find(dir);
+        if (it == dirs_.end())
+            break;
+        if (it->second.loading) {
+            loaded_.wait(lk);
+            continue;
+        }
+        if (freshLocked(it->second)) {
+            if (it->second.oversized) {
+                lk.unlock();
+                return askServer();
+            }
+            answer(it->second);
+            return true;
+        }
+        break;
+    }
+    if (dirs_.find(dir) == dirs_.end() && dirs_.size() >= maxDirectories_)
+        evictOldestLocked();
+    const std::uint64_t loadId = nextLoadId_++;
+    {
+        Dir &d = dirs_[dir];
+        d.loading = true;
+        d.dirty = false;
+        d.loadId = loadId;
+    }
+    lk.unlock();
+
+    std::vector<FileInfo> items;
+    std::string listErr;
+    bool oversized = false;
+    bool listed = client.listStream(
+        dir,
+        [&](std::vector<FileInfo> &&batch) {
+            if (items.size() + batch.size() > maxEntries_) {
+                oversized = true;
+                return false;
+            }
+            items.insert(items.end(), std::make_move_iterator(batch.begin()),
+                         std::make_move_iterator(batch.end()));
+            return true;
+        },
+        listErr);
+    if (oversized) {
+        listed = true;
+        std::vector<FileInfo>().swap(items);
+    }
+    bool missing = false;
+    if (!listed) {
+        bool isDir = false;
+        std::string existsErr;
+        missing = !client.exists(dir, isDir, existsErr) && existsErr.empty();
+    }
+    Dir fetched;
+    fetched.ready = listed || missing;
+    fetched.missing = missing;
+    fetched.oversized = oversized;
+    fetched.fetchedAt = Clock::now();
+    for (FileInfo &e : items) {
+        if (e.name.empty() || e.name == "." || e.name == "..")
+            continue;
+        std::string key = e.name;
+        fetched.entries.emplace(std::move(key), std::move(e));
+    }
+
+    lk.lock();
+    ++listings_;
+    auto it = dirs_.find(dir);
+    // clear() or an eviction may have replaced the entry meanwhile.
+    if (it != dirs_.end() && it->second.loadId == loadId) {
+        if (fetched.ready && !it->second.dirty)
+            it->second = fetched;
+        else
+            dirs_.erase(it);
+    }
+    loaded_.notify_all();
+    if (!fetched.ready) {
+        err = listErr.empty() ? "Could not list " + dir : listErr;
+        return false;
+    }
+    lk.unlock();
+    if (oversized)
+        return askServer();
+    answer(fetched);
+    return true;
+}
+
+bool PrecheckCache::knownDirectory(const std::string &dir) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const auto it = dirs_.find(ListingCache::normalizePath(dir));
+    return it != dirs_.end() && !it->second.loading &&
+           !it->second.missing && freshLocked(it->second);
+}
+
+void PrecheckCache::putEntryLocked(const std::string &dir, FileInfo info) {
+    auto it = dirs_.find(dir);
+    if (it == dirs_.end())
+        return; // listed from the server when first asked
+    Dir &d = it->second;
+    if (d.loading) {
+        d.dirty = true;
+        return;
+    }
+    if (d.missing) {
+        // Created by someone meanwhile; list it again when asked.
+        dirs_.erase(it);
+        return;
+    }
+    if (d.oversized)
+        return;
+    std::string key = info.name;
+    d.entries[std::move(key)] = std::move(info);
+}
+
+void PrecheckCache::noteDirectory(const std::string &dir) {
+    const std::string norm = ListingCache::normalizePath(dir);
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (norm != "/") {
+        FileInfo info;
+        info.name = baseName(norm);
+        info.is_dir = true;
+        putEntryLocked(ListingCache::parentPath(norm), std::move(info));
+    }
+    auto it = dirs_.find(norm);
+    if (it != dirs_.end() && it->second.loading) {
+        it->second.dirty = true;
+        return;
+    }
+    if (it != dirs_.end() && it->second.ready && !it->second.missing)
+        return;
+    if (it == dirs_.end() && dirs_.size() >= maxDirectories_)
+        evictOldestLocked();
+    Dir &d = dirs_[norm];
+    d = Dir{};
+    d.ready = true;
+    d.fetchedAt = Clock::now();
+}
+
+void PrecheckCache::noteFile(const std::string &path, std::uint64_t size,
+                             std::uint64_t mtime) {
+    const std::string norm = ListingCache::normalizePath(path);
+    if (norm == "/")
+        return;
+    FileInfo info;
+    info.name = baseName(norm);
+    info.size = size;
+    info.has_size = true;
+    info.mtime = mtime;
+    std::lock_guard<std::mutex> lk(mtx_);
+    putEntryLocked(ListingCache::parentPath(norm), std::move(info));
+}
+
+void PrecheckCache::invalidate(const std::string &path) {
+    const std::string root = ListingCache::normalizePath(path);
+    const std::string prefix = (root == "/") ? root : root + "/";
+    const std::string parent = ListingCache::parentPath(root);
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (auto it = dirs_.begin(); it != dirs_.end();) {
+        const bool hit = it->first == root || it->first == parent ||
+                         it->first.rfind(prefix, 0) == 0;
+        if (!hit) {
+            ++it;
+        } else if (it->second.loading) {
+            it->second.dirty = true;
+            ++it;
+        } else {
+            it = dirs_.erase(it);
+        }
+    }
+}
+
+void PrecheckCache::clear() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (auto it = dirs_.begin(); it != dirs_.end();) {
+        if (it->second.loading) {
+            it->second.dirty = true;
+            ++it;
+        } else {
+            it = dirs_.erase(it);
+        }
+    }
+}
+
+std::uint64_t PrecheckCache::listings() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return listings_;
+}
+
+void PrecheckCache::evictOldestLocked() {
+    auto oldest = dirs_.end();
+    for (auto it = dirs_.begin(); it != dirs_.end(); ++it) {
+        if (it->second.loading)
+            continue;
+        if (oldest == dirs_.end() ||
+            it->second.fetchedAt < oldest->second.fetchedAt)
+            oldest = it;
+    }
+    if (oldest != dirs_.end())
+        dirs_.erase(oldest);
+}
+
+} // namespace openscp
@@ -0,0 +1,33 @@
+// Permission checks of remote directories from their attributes alone.
+#include "openscp/RemoteAccess.hpp"
+
+namespace openscp {
+namespace {
+
+// Creating an entry needs both write and search permission.
+bool grants(std::uint32_t mode, unsigned shift) {
+    const std::uint32_t wx = 03u << shift;
+    return (mode & wx) == wx;
+}
+
+} // namespace
+
+AccessVerdict directoryWriteAccess(const FileInfo &dir,
+                                   std::optional<std::uint32_t> sessionUid) {
+    const std::uint32_t type = dir.mode & 0170000u;
+    if ((dir.mode & 07777u) == 0 || (type != 0 && type != 0040000u))
+        return AccessVerdict::Unknown;
+    // Without the uid (or as root) permission bits may not apply at all.
+    if (!sessionUid.has_value() || *sessionUid == 0)
+        return AccessVerdict::Unknown;
+    // Only the owner class applies to the owner, whatever the others say.
+    if (*sessionUid == dir.uid)
+        return grants(dir.mode, 6) ? AccessVerdict::Unknown
+                                   : AccessVerdict::ReadOnly;
+    // Group or other applies, depending on memberships we cannot see.
+    if (!grants(dir.mode, 3) && !grants(dir.mode, 0))
+        return AccessVerdict::ReadOnly;
+    return AccessVerdict::Unknown;
+}
+
+} // namespace openscp
@@ -0,0 +1,213 @@
+// Recursive permission changes of remote trees.
+#include "openscp/RemoteChmod.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+namespace openscp {
+namespace {
+
+struct Task {
+    std::string dir;                // change, then list, this directory
+    std::vector<std::string> paths; // else change these entries
+};
+
+bool isSymlink(const FileInfo &e) { return (e.mode & 0170000u) == 0120000u; }
+
+std::string joinPath(const std::string &dir, const std::string &name) {
+    if (!dir.empty() && dir.back() == '/')
+        return dir + name;
+    return dir + "/" + name;
+}
+
+// Shared by the workers; every field is guarded by `m`.
+struct ChmodWalk {
+    const RemoteChmodJob &job;
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Task> queue;
+    std::size_t active = 0;
+    bool canceled = false;
+    RemoteChmodProgress stats;
+    std::string firstError;
+    std::mutex progressMutex; // serializes job.progress
+
+    explicit ChmodWalk(const RemoteChmodJob &j) : job(j) {}
+
+    void failLocked(const std::string &why) {
+        ++stats.failures;
+        if (firstError.empty())
+            firstError = why;
+    }
+
+    void pushBatches(std::vector<std::string> &&paths) {
+        for (std::size_t i = 0; i < paths.size(); i += kRemoteChmodBatch) {
+            Task t;
+            const std::size_t end =
+                std::min(paths.size(), i + kRemoteChmodBatch);
+            t.paths.assign(std::make_move_iterator(paths.begin() + i),
+                           std::make_move_iterator(paths.begin() + end));
+            queue.push_back(std::move(t));
+        }
+    }
+
+    void reportProgress() {
+        if (!job.progress)
+            return;
+        RemoteChmodProgress snapshot;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            snapshot = stats;
+        }
+        std::lock_guard<std::mutex> lk(progressMutex);
+        job.progress(snapshot);
+    }
+};
+
+bool changeOne(ChmodWalk &w, SftpClient &client, const std::string &path) {
+    std::string err;
+    const bool ok = client.chmod(path, w.job.mode, err);
+    std::lock_guard<std::mutex> lk(w.m);
+    if (ok)
+        ++w.stats.changed;
+    else
+        w.failLocked(err.empty() ? "Could not change " + path : err);
+    return ok;
+}
+
+void walkDirectory(ChmodWalk &w, SftpClient &client, const std::string &dir) {
+    // Changed first: a mode that grants read access makes it listable.
+    changeOne(w, client, dir);
+    std::vector<FileInfo> entries;
+    std::string err;
+    if (!client.list(dir, entries, err)) {
+        std::lock_guard<std::mutex> lk(w.m);
+        w.failLocked(err.empty() ? "Could not list " + dir : err);
+        return;
+    }
+    std::vector<std::string> files;
+    std::lock_guard<std::mutex> lk(w.m);
+    ++w.stats.dirs_listed;
+    for (const FileInfo &e : entries) {
+        if (e.name.empty() || e.name == "." || e.name == ".." ||
+            isSymlink(e))
+            continue;
+        std::string path = joinPath(dir, e.name);
+        if (e.is_dir) {
+            Task t;
+            t.dir = std::move(path);
+            w.queue.push_back(std::move(t));
+        } else {
+            files.push_back(std::move(path));
+        }
+    }
+    w.pushBatches(std::move(files));
+    w.cv.notify_all();
+}
+
+void changeBatch(ChmodWalk &w, SftpClient &client, const Task &t,
+                 const std::function<bool()> &shouldCancel) {
+    for (const std::string &path : t.paths) {
+        if (shouldCancel && shouldCancel()) {
+            std::lock_guard<std::mutex> lk(w.m);
+            w.canceled = true;
+            w.cv.notify_all();
+            return;
+        }
+        changeOne(w, client, path);
+    }
+}
+
+void chmodWorker(ChmodWalk &w, SftpClient &client) {
+    const std::function<bool()> shouldCancel = w.job.shouldCancel;
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lk(w.m);
+            w.cv.wait(lk, [&] {
+                return w.canceled || !w.queue.empty() || w.active == 0;
+            });
+            if (!w.canceled && shouldCancel && shouldCancel())
+                w.canceled = true;
+            if (w.canceled || w.queue.empty()) {
+                w.cv.notify_all();
+                return;
+            }
+            task = std::move(w.queue.front());
+            w.queue.pop_front();
+            ++w.active;
+        }
+        if (!task.dir.empty())
+            walkDirectory(w, client, task.dir);
+        else
+            changeBatch(w, client, task, shouldCancel);
+        w.reportProgress();
+        std::lock_guard<std::mutex> lk(w.m);
+        --w.active;
+        w.cv.notify_all();
+    }
+}
+
+} // namespace
+
+bool runRemoteChmod(const std::vector<SftpClient *> &clients,
+                    const RemoteChmodJob &job, RemoteChmodProgress &stats,
+                    std::string &err) {
+    stats = RemoteChmodProgress{};
+    if (clients.empty()) {
+        err = "No session available for chmod";
+        return false;
+    }
+    ChmodWalk w(job);
+    std::vector<std::string> rootPaths;
+    for (const RemoteChmodRoot &root : job.roots) {
+        if (root.path.empty())
+            continue;
+        if (!root.is_dir) {
+            rootPaths.push_back(root.path);
+            continue;
+        }
+        if (job.server_side) {
+            if (job.shouldCancel && job.shouldCancel()) {
+                err = "Canceled by user";
+                return false;
+            }
+            std::string cmdErr;
+            if (clients[0]->chmodTree(root.path, job.mode, cmdErr,
+                                      job.shouldCancel)) {
+                ++w.stats.server_side;
+                w.reportProgress();
+                continue;
+            }
+        }
+        Task t;
+        t.dir = root.path;
+        w.queue.push_back(std::move(t));
+    }
+    w.pushBatches(std::move(rootPaths));
+
+    std::vector<std::thread> workers;
+    workers.reserve(clients.size() - 1);
+    for (std::size_t i = 1; i < clients.size(); ++i)
+        workers.emplace_back([&w, c = clients[i]] { chmodWorker(w, *c); });
+    chmodWorker(w, *clients[0]);
+    for (std::thread &t : workers)
+        t.join();
+
+    stats = w.stats;
+    if (w.canceled) {
+        err = "Canceled by user";
+        return false;
+    }
+    if (stats.failures > 0) {
+        err = w.firstError;
+        return false;
+    }
+    return true;
+}
+
+} // namespace openscp
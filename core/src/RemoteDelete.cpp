@@ -0,0 +1,272 @@
+// Recursive delete of remote trees over several sessions.
+#include "openscp/RemoteDelete.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+namespace openscp {
+namespace {
+
+constexpr std::size_t kNoNode = static_cast<std::size_t>(-1);
+
+struct DirNode {
+    std::string path;
+    std::size_t parent = kNoNode;
+    std::size_t pending = 1; // its listing plus unfinished child work
+    bool failed = false;     // something below it was left behind
+};
+
+struct Task {
+    std::size_t node = kNoNode; // directory owning the work
+    bool list = false;          // list `node`, else remove `files`
+    std::vector<std::string> files;
+};
+
+bool isSymlink(const FileInfo &e) { return (e.mode & 0170000u) == 0120000u; }
+
+std::string joinPath(const std::string &dir, const std::string &name) {
+    if (!dir.empty() && dir.back() == '/')
+        return dir + name;
+    return dir + "/" + name;
+}
+
+// Shared by the workers; every field is guarded by `m`.
+struct DeleteWalk {
+    const RemoteDeleteJob &job;
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<DirNode> nodes; // deque: references survive push_back
+    std::deque<Task> queue;
+    std::size_t active = 0;
+    bool canceled = false;
+    RemoteDeleteProgress stats;
+    std::string firstError;
+    std::mutex progressMutex; // serializes job.progress
+
+    explicit DeleteWalk(const RemoteDeleteJob &j) : job(j) {}
+
+    void failLocked(std::size_t node, const std::string &why) {
+        ++stats.failures;
+        if (firstError.empty())
+            firstError = why;
+        if (node != kNoNode)
+            nodes[node].failed = true;
+    }
+
+    void reportProgress() {
+        if (!job.progress)
+            return;
+        RemoteDeleteProgress snapshot;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            snapshot = stats;
+        }
+        std::lock_guard<std::mutex> lk(progressMutex);
+        job.progress(snapshot);
+    }
+};
+
+// True if `path` is gone, so a failed removal can be treated as done.
+bool vanished(SftpClient &client, const std::string &path) {
+    bool isDir = false;
+    std::string err;
+    return !client.exists(path, isDir, err) && err.empty();
+}
+
+// Drop one unit of pending work from `node`; a directory whose work is all
+// done is removed, which in turn releases its parent.
+void releaseNode(DeleteWalk &w, SftpClient &client, std::size_t node) {
+    while (node != kNoNode) {
+        std::string path;
+        bool failed = false;
+        {
+            std::lock_guard<std::mutex> lk(w.m);
+            DirNode &n = w.nodes[node];
+            if (--n.pending > 0)
+                return;
+            path = n.path;
+            failed = n.failed || w.canceled;
+        }
+        std::string err;
+        const bool removed =
+            !failed && (client.removeDir(path, err) || vanished(client, path));
+        std::size_t parent = kNoNode;
+        {
+            std::lock_guard<std::mutex> lk(w.m);
+            parent = w.nodes[node].parent;
+            if (removed) {
+                ++w.stats.dirs_removed;
+            } else if (!failed) {
+                w.failLocked(node, err.empty() ? "Could not remove " + path
+                                               : err);
+            }
+            if (!removed && parent != kNoNode)
+                w.nodes[parent].failed = true;
+        }
+        node = parent;
+    }
+}
+
+void listDirectory(DeleteWalk &w, SftpClient &client, std::size_t node) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lk(w.m);
+        path = w.nodes[node].path;
+    }
+    std::vector<FileInfo> entries;
+    std::string err;
+    if (!client.list(path, entries, err)) {
+        // A directory that is already gone is settled by releaseNode().
+        if (vanished(client, path))
+            return;
+        std::lock_guard<std::mutex> lk(w.m);
+        w.failLocked(node, err.empty() ? "Could not list " + path : err);
+        return;
+    }
+
+    std::vector<std::string> files;
+    std::vector<std::string> dirs;
+    for (const FileInfo &e : entries) {
+        if (e.name.empty() || e.name == "." || e.name == "..")
+            continue;
+        (e.is_dir && !isSymlink(e) ? dirs : files)
+            .push_back(joinPath(path, e.name));
+    }
+
+    std::lock_guard<std::mutex> lk(w.m);
+    ++w.stats.dirs_listed;
+    for (std::string &d : dirs) {
+        DirNode child;
+        child.path = std::move(d);
+        child.parent = node;
+        w.nodes.push_back(std::move(child));
+        Task t;
+        t.node = w.nodes.size() - 1;
+        t.list = true;
+        w.queue.push_back(std::move(t));
+        ++w.nodes[node].pending;
+    }
+    for (std::size_t i = 0; i < files.size(); i += kRemoteDeleteBatch) {
+        Task t;
+        t.node = node;
+        const std::size_t end = std::min(files.size(), i + kRemoteDeleteBatch);
+        t.files.assign(std::make_move_iterator(files.begin() + i),
+                       std::make_move_iterator(files.begin() + end));
+        w.queue.push_back(std::move(t));
+        ++w.nodes[node].pending;
+    }
+    w.cv.notify_all();
+}
+
+void removeFiles(DeleteWalk &w, SftpClient &client, const Task &t,
+                 const std::function<bool()> &shouldCancel) {
+    for (const std::string &file : t.files) {
+        if (shouldCancel && shouldCancel()) {
+            std::lock_guard<std::mutex> lk(w.m);
+            w.canceled = true;
+            w.cv.notify_all();
+            return;
+        }
+        std::string err;
+        const bool removed =
+            client.removeFile(file, err) || vanished(client, file);
+        std::lock_guard<std::mutex> lk(w.m);
+        if (removed)
+            ++w.stats.files_removed;
+        else
+            w.failLocked(t.node, err.empty() ? "Could not remove " + file
+                                             : err);
+    }
+}
+
+void deleteWorker(DeleteWalk &w, SftpClient &client) {
+    const std::function<bool()> shouldCancel = w.job.shouldCancel;
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lk(w.m);
+            w.cv.wait(lk, [&] {
+                return w.canceled || !w.queue.empty() || w.active == 0;
+            });
+            if (!w.canceled && shouldCancel && shouldCancel())
+                w.canceled = true;
+            if (w.canceled || w.queue.empty()) {
+                w.cv.notify_all();
+                return;
+            }
+            task = std::move(w.queue.front());
+            w.queue.pop_front();
+            ++w.active;
+        }
+        if (task.list)
+            listDirectory(w, client, task.node);
+        else
+            removeFiles(w, client, task, shouldCancel);
+        releaseNode(w, client, task.node);
+        w.reportProgress();
+        std::lock_guard<std::mutex> lk(w.m);
+        --w.active;
+        w.cv.notify_all();
+    }
+}
+
+} // namespace
+
+bool runRemoteDelete(const std::vector<SftpClient *> &clients,
+                     const RemoteDeleteJob &job, RemoteDeleteProgress &stats,
+                     std::string &err) {
+    stats = RemoteDeleteProgress{};
+    if (clients.empty()) {
+        err = "No session available for delete";
+        return false;
+    }
+    DeleteWalk w(job);
+    std::vector<std::string> rootFiles;
+    for (const RemoteDeleteRoot &root : job.roots) {
+        if (root.path.empty() || root.path == "/")
+            continue; // never empty the whole server by accident
+        if (!root.is_dir) {
+            rootFiles.push_back(root.path);
+            continue;
+        }
+        DirNode n;
+        n.path = root.path;
+        w.nodes.push_back(std::move(n));
+        Task t;
+        t.node = w.nodes.size() - 1;
+        t.list = true;
+        w.queue.push_back(std::move(t));
+    }
+    for (std::size_t i = 0; i < rootFiles.size(); i += kRemoteDeleteBatch) {
+        Task t;
+        const std::size_t end =
+            std::min(rootFiles.size(), i + kRemoteDeleteBatch);
+        t.files.assign(rootFiles.begin() + i, rootFiles.begin() + end);
+        w.queue.push_back(std::move(t));
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(clients.size() - 1);
+    for (std::size_t i = 1; i < clients.size(); ++i)
+        workers.emplace_back([&w, c = clients[i]] { deleteWorker(w, *c); });
+    deleteWorker(w, *clients[0]);
+    for (std::thread &t : workers)
+        t.join();
+
+    stats = w.stats;
+    if (w.canceled) {
+        err = "Canceled by user";
+        return false;
+    }
+    if (stats.failures > 0) {
+        err = w.firstError;
+        return false;
+    }
+    return true;
+}
+
+} // namespace openscp
@@ -0,0 +1,224 @@
+// Paged read access to a remote file without downloading it.
+#include "openscp/RemoteFileView.hpp"
+
+#include <algorithm>
+
+namespace openscp {
+
+RemoteFileView::RemoteFileView(SftpClient &client, std::string path,
+                               std::size_t blockSize, std::size_t cacheBytes)
+    : client_(client), path_(std::move(path)),
+      blockSize_(std::max<std::size_t>(1, blockSize)),
+      cacheBytes_(cacheBytes) {}
+
+bool RemoteFileView::refresh(std::string &err) {
+    bool replaced = false;
+    return restat(replaced, err);
+}
+
+bool RemoteFileView::restat(bool &replaced, std::string &err) {
+    replaced = false;
+    FileInfo info{};
+    std::string stErr;
+    if (!client_.stat(path_, info, stErr)) {
+        err = stErr.empty() ? "No such file: " + path_ : stErr;
+        return false;
+    }
+    if (info.is_dir) {
+        err = "Is a directory: " + path_;
+        return false;
+    }
+    if (!info.has_size) {
+        err = "The server does not report the size of " + path_;
+        return false;
+    }
+    if (statted_) {
+        // Growth with a later (or unknown) mtime is an append; anything else
+        // may have rewritten bytes the cache holds.
+        const bool shrank = info.size < size_;
+        const bool older = info.mtime != 0 && info.mtime < mtime_;
+        const bool rewritten =
+            info.size == size_ && info.mtime != 0 && info.mtime != mtime_;
+        replaced = shrank || older || rewritten;
+        if (replaced)
+            clear();
+    }
+    statted_ = true;
+    size_ = info.size;
+    mtime_ = info.mtime;
+    return true;
+}
+
+bool RemoteFileView::read(std::uint64_t offset, std::size_t length,
+                          std::string &out, std::string &err,
+                          const std::function<bool()> &shouldCancel) {
+    out.clear();
+    if (offset >= size_ || length == 0)
+        return true;
+    const std::uint64_t end =
+        std::min<std::uint64_t>(size_, offset + length);
+    out.reserve(static_cast<std::size_t>(end - offset));
+    const std::uint64_t last = (end - 1) / blockSize_;
+    std::uint64_t idx = offset / blockSize_;
+    // Append the part of [blockStart, blockStart + bytes.size()) that falls
+    // inside the requested range.
+    auto appendSlice = [&](std::uint64_t blockStart, const std::string &bytes) {
+        const std::uint64_t from = std::max(offset, blockStart);
+        const std::uint64_t to =
+            std::min<std::uint64_t>(end, blockStart + bytes.size());
+        if (to > from)
+            out.append(bytes, static_cast<std::size_t>(from - blockStart),
+                       static_cast<std::size_t>(to - from));
+    };
+    while (idx <= last) {
+        if (const Block *b = usableBlock(idx)) {
+            appendSlice(idx * blockSize_, b->data);
+            ++idx;
+            continue;
+        }
+        // One request for the whole run of missing blocks.
+        std::uint64_t runEnd = idx;
+        while (runEnd < last && !usableBlock(runEnd + 1))
+            ++runEnd;
+        const std::uint64_t runStart = idx * blockSize_;
+        const std::uint64_t runStop =
+            std::min<std::uint64_t>(size_, (runEnd + 1) * blockSize_);
+        std::string bytes;
+        const std::size_t want = static_cast<std::size_t>(runStop - runStart);
+        if (!fetchRange(runStart, want, bytes, err, shouldCancel))
+            return false;
+        appendSlice(runStart, bytes);
+        absorb(runStart, bytes);
+        if (bytes.size() < want) {
+            // The file shrank under us; what was read is all there is.
+            size_ = runStart + bytes.size();
+            break;
+        }
+        idx = runEnd + 1;
+    }
+    return true;
+}
+
+bool RemoteFileView::follow(std::string &appended, std::uint64_t &appendedAt,
+                            bool &truncated, std::string &err,
+                            std::size_t maxBytes,
+                            const std::function<bool()> &shouldCancel) {
+    appended.clear();
+    truncated = false;
+    const std::uint64_t old = size_;
+    appendedAt = old;
+    bool replaced = false;
+    if (!restat(replaced, err))
+        return false;
+    if (replaced) {
+        truncated = true;
+        appendedAt = 0;
+        return true;
+    }
+    if (size_ == old)
+        return true;
+    std::uint64_t from = old;
+    if (maxBytes > 0 && size_ - from > maxBytes)
+        from = size_ - maxBytes;
+    appendedAt = from;
+    const std::size_t want = static_cast<std::size_t>(size_ - from);
+    if (!fetchRange(from, want, appended, err, shouldCancel))
+        return false;
+    if (appended.size() < want)
+        size_ = from + appended.size();
+    absorb(from, appended);
+    return true;
+}
+
+void RemoteFileView::clear() {
+    blocks_.clear();
+    lru_.clear();
+    cached_ = 0;
+}
+
+std::size_t RemoteFileView::expectedBlockBytes(std::uint64_t index) const {
+    const std::uint64_t start = index * blockSize_;
+    if (start >= size_)
+        return 0;
+    return static_cast<std::size_t>(
+        std::min<std::uint64_t>(blockSize_, size_ - start));
+}
+
+const RemoteFileView::Block *RemoteFileView::usableBlock(std::uint64_t index) {
+    auto it = blocks_.find(index);
+    if (it == blocks_.end() ||
+        it->second.data.size() < expectedBlockBytes(index))
+        return nullptr; // a short block the file has since grown past
+    touch(it->second);
+    return &it->second;
+}
+
+bool RemoteFileView::fetchRange(std::uint64_t offset, std::size_t length,
+                                std::string &out, std::string &err,
+                                const std::function<bool()> &shouldCancel) {
+    out.clear();
+    if (length == 0)
+        return true;
+    out.reserve(length);
+    std::string readErr;
+    const bool ok = client_.readStream(
+        path_, offset,
+        [&](const char *data, std::size_t size) {
+            out.append(data, std::min(size, length - out.size()));
+            return out.size() < length; // stop once the range is complete
+        },
+        readErr, shouldCancel);
+    fetched_ += out.size();
+    // Stopping the stream early fails the call but is the expected end.
+    if (ok || out.size() >= length)
+        return true;
+    err = readErr.empty() ? "Remote read failed" : readErr;
+    return false;
+}
+
+void RemoteFileView::absorb(std::uint64_t offset, const std::string &data) {
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+        const std::uint64_t at = offset + pos;
+        const std::uint64_t index = at / blockSize_;
+        const std::size_t within = static_cast<std::size_t>(at % blockSize_);
+        const std::size_t take =
+            std::min(blockSize_ - within, data.size() - pos);
+        auto it = blocks_.find(index);
+        if (within == 0) {
+            if (it == blocks_.end()) {
+                lru_.push_front(index);
+                it = blocks_.emplace(index, Block{{}, lru_.begin()}).first;
+            } else {
+                cached_ -= it->second.data.size();
+                touch(it->second);
+            }
+            it->second.data.assign(data, pos, take);
+            cached_ += take;
+        } else if (it != blocks_.end() && it->second.data.size() == within) {
+            // Appended bytes continue the cached end of the file.
+            it->second.data.append(data, pos, take);
+            cached_ += take;
+            touch(it->second);
+        }
+        pos += take;
+    }
+    evict();
+}
+
+void RemoteFileView::touch(Block &b) {
+    lru_.splice(lru_.begin(), lru_, b.lru);
+}
+
+void RemoteFileView::evict() {
+    while (cached_ > cacheBytes_ && !lru_.empty()) {
+        auto it = blocks_.find(lru_.back());
+        lru_.pop_back();
+        if (it == blocks_.end())
+            continue;
+        cached_ -= it->second.data.size();
+        blocks_.erase(it);
+    }
+}
+
+} // namespace openscp
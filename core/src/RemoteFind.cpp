@@ -0,0 +1,340 @@
+// Recursive name search in remote trees.
+#include "openscp/RemoteFind.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace openscp {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Task {
+    std::string dir;      // absolute path to list
+    std::string relative; // the same path below job.root; empty for it
+};
+
+bool isSymlink(const FileInfo &e) { return (e.mode & 0170000u) == 0120000u; }
+
+std::string joinPath(const std::string &dir, const std::string &name) {
+    if (!dir.empty() && dir.back() == '/')
+        return dir + name;
+    return dir + "/" + name;
+}
+
+std::string baseName(const std::string &relative) {
+    const std::size_t slash = relative.rfind('/');
+    return slash == std::string::npos ? relative : relative.substr(slash + 1);
+}
+
+// Totals and not yet delivered matches, shared by the searching threads.
+// A flusher thread hands a partial batch over once its first match has
+// waited kRemoteFindFlushMs, so a sparse search still shows results early.
+class FindRun {
+    public:
+    explicit FindRun(const RemoteFindJob &job) : job_(job) {
+        if (job_.on_matches)
+            flusher_ = std::thread([this] { flushLoop(); });
+    }
+    ~FindRun() { finish(); }
+
+    // Counts one entry looked at and keeps it if job.match accepts it.
+    // Returns false once max_matches is reached.
+    bool offer(const std::string &relative, bool isDir) {
+        const bool wanted = !job_.match || job_.match(baseName(relative));
+        std::vector<RemoteFindMatch> batch;
+        bool more = true;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            ++stats_.scanned;
+            if (stats_.truncated)
+                return false;
+            if (!wanted)
+                return true;
+            ++stats_.matches;
+            if (job_.max_matches > 0 && stats_.matches >= job_.max_matches)
+                stats_.truncated = true;
+            more = !stats_.truncated;
+            if (!job_.on_matches)
+                return more;
+            if (pending_.empty()) {
+                pendingSince_ = Clock::now();
+                cv_.notify_all();
+            }
+            pending_.push_back({relative, isDir});
+            if (pending_.size() >= kRemoteFindBatch)
+                batch.swap(pending_);
+        }
+        deliver(std::move(batch));
+        return more;
+    }
+
+    void addListed() {
+        std::lock_guard<std::mutex> lk(m_);
+        ++stats_.dirs_listed;
+    }
+
+    void addFailure() {
+        std::lock_guard<std::mutex> lk(m_);
+        ++stats_.failures;
+    }
+
+    void setServerSide(bool on) {
+        std::lock_guard<std::mutex> lk(m_);
+        stats_.server_side = on;
+    }
+
+    RemoteFindProgress snapshot() {
+        std::lock_guard<std::mutex> lk(m_);
+        return stats_;
+    }
+
+    void reportProgress() {
+        if (!job_.progress)
+            return;
+        const RemoteFindProgress p = snapshot();
+        std::lock_guard<std::mutex> lk(callbackMutex_);
+        job_.progress(p);
+    }
+
+    // Stops the flusher and delivers what is left; idempotent.
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stopping_ = true;
+            cv_.notify_all();
+        }
+        if (flusher_.joinable())
+            flusher_.join();
+        std::vector<RemoteFindMatch> rest;
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            rest.swap(pending_);
+        }
+        deliver(std::move(rest));
+    }
+
+    private:
+    void deliver(std::vector<RemoteFindMatch> &&batch) {
+        if (batch.empty() || !job_.on_matches)
+            return;
+        std::lock_guard<std::mutex> lk(callbackMutex_);
+        job_.on_matches(std::move(batch));
+    }
+
+    void flushLoop() {
+        const auto delay = std::chrono::milliseconds(kRemoteFindFlushMs);
+        for (;;) {
+            std::vector<RemoteFindMatch> batch;
+            {
+                std::unique_lock<std::mutex> lk(m_);
+                if (pending_.empty()) {
+                    cv_.wait(lk,
+                             [&] { return stopping_ || !pending_.empty(); });
+                } else {
+                    cv_.wait_until(lk, pendingSince_ + delay,
+                                   [&] { return stopping_; });
+                }
+                if (stopping_)
+                    return;
+                if (pending_.empty() || Clock::now() < pendingSince_ + delay)
+                    continue;
+                batch.swap(pending_);
+            }
+            deliver(std::move(batch));
+        }
+    }
+
+    const RemoteFindJob &job_;
+    std::mutex m_; // guards everything below but callbackMutex_
+    std::condition_variable cv_;
+    RemoteFindProgress stats_;
+    std::vector<RemoteFindMatch> pending_;
+    Clock::time_point pendingSince_;
+    bool stopping_ = false;
+    std::thread flusher_;
+    std::mutex callbackMutex_; // serializes on_matches and progress
+};
+
+// One findEntries() call. `fallBack` is set when the server could not
+// search and nothing was reported yet.
+bool searchOnServer(FindRun &run, SftpClient &client, const RemoteFindJob &job,
+                    bool &fallBack, std::string &err) {
+    fallBack = false;
+    std::uint64_t seen = 0;
+    auto onEntry = [&](const std::string &relative, bool isDir) {
+        ++seen;
+        const bool more = run.offer(relative, isDir);
+        if (seen % kRemoteFindBatch == 0)
+            run.reportProgress();
+        return more;
+    };
+    bool partial = false;
+    std::string findErr;
+    const std::function<bool()> shouldCancel = job.shouldCancel;
+    if (client.findEntries(job.root, job.filter, onEntry, partial, findErr,
+                           shouldCancel)) {
+        run.setServerSide(true);
+        if (partial)
+            run.addFailure();
+        return true;
+    }
+    if (shouldCancel && shouldCancel()) {
+        err = "Canceled by user";
+        return false;
+    }
+    if (seen == 0) {
+        fallBack = true;
+        return false;
+    }
+    // Part of the tree was already reported; walking it again would
+    // deliver those matches twice.
+    run.setServerSide(true);
+    run.addFailure();
+    err = findErr.empty() ? "Could not search " + job.root : findErr;
+    return false;
+}
+
+// Shared by the walk workers; every field is guarded by `m`.
+struct FindWalk {
+    const RemoteFindJob &job;
+    FindRun &run;
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Task> queue;
+    std::size_t active = 0;
+    bool canceled = false;
+    bool stopped = false; // max_matches reached
+    bool rootFailed = false;
+    std::string rootError;
+
+    FindWalk(const RemoteFindJob &j, FindRun &r) : job(j), run(r) {}
+};
+
+void listDirectory(FindWalk &w, SftpClient &client, const Task &task) {
+    std::vector<FileInfo> entries;
+    std::string err;
+    if (!client.list(task.dir, entries, err)) {
+        if (task.relative.empty()) {
+            std::lock_guard<std::mutex> lk(w.m);
+            w.rootFailed = true;
+            w.rootError = err.empty() ? "Could not list " + task.dir : err;
+        }
+        w.run.addFailure();
+        return;
+    }
+    w.run.addListed();
+
+    std::vector<Task> subdirs;
+    bool more = true;
+    for (const FileInfo &e : entries) {
+        if (e.name.empty() || e.name == "." || e.name == "..")
+            continue;
+        if (!w.job.filter.include_hidden && e.name[0] == '.')
+            continue;
+        std::string relative =
+            task.relative.empty() ? e.name : task.relative + "/" + e.name;
+        const bool descend = e.is_dir && !isSymlink(e);
+        if (!w.run.offer(relative, e.is_dir)) {
+            more = false;
+            break;
+        }
+        if (descend)
+            subdirs.push_back(
+                {joinPath(task.dir, e.name), std::move(relative)});
+    }
+
+    std::lock_guard<std::mutex> lk(w.m);
+    if (!more)
+        w.stopped = true;
+    for (Task &t : subdirs)
+        w.queue.push_back(std::move(t));
+    w.cv.notify_all();
+}
+
+void findWorker(FindWalk &w, SftpClient &client) {
+    const std::function<bool()> shouldCancel = w.job.shouldCancel;
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lk(w.m);
+            w.cv.wait(lk, [&] {
+                return w.canceled || w.stopped || !w.queue.empty() ||
+                       w.active == 0;
+            });
+            if (!w.canceled && shouldCancel && shouldCancel())
+                w.canceled = true;
+            if (w.canceled || w.stopped || w.queue.empty()) {
+                w.cv.notify_all();
+                return;
+            }
+            task = std::move(w.queue.front());
+            w.queue.pop_front();
+            ++w.active;
+        }
+        listDirectory(w, client, task);
+        w.run.reportProgress();
+        std::lock_guard<std::mutex> lk(w.m);
+        --w.active;
+        w.cv.notify_all();
+    }
+}
+
+} // namespace
+
+bool runRemoteFind(const std::vector<SftpClient *> &clients,
+                   const RemoteFindJob &job, RemoteFindProgress &stats,
+                   std::string &err) {
+    stats = RemoteFindProgress{};
+    if (clients.empty()) {
+        err = "No session available for search";
+        return false;
+    }
+    if (job.root.empty()) {
+        err = "No folder to search";
+        return false;
+    }
+    FindRun run(job);
+
+    if (job.server_side) {
+        bool fallBack = false;
+        const bool ok = searchOnServer(run, *clients[0], job, fallBack, err);
+        if (!fallBack) {
+            run.finish();
+            stats = run.snapshot();
+            run.reportProgress();
+            return ok;
+        }
+    }
+
+    std::vector<SftpClient *> walkers = clients;
+    if (job.walk_sessions)
+        job.walk_sessions(walkers);
+    FindWalk w(job, run);
+    w.queue.push_back({job.root, std::string()});
+
+    std::vector<std::thread> workers;
+    workers.reserve(walkers.size() - 1);
+    for (std::size_t i = 1; i < walkers.size(); ++i)
+        workers.emplace_back([&w, c = walkers[i]] { findWorker(w, *c); });
+    findWorker(w, *walkers[0]);
+    for (std::thread &t : workers)
+        t.join();
+
+    run.finish();
+    stats = run.snapshot();
+    if (w.canceled) {
+        err = "Canceled by user";
+        return false;
+    }
+    if (w.rootFailed) {
+        err = w.rootError;
+        return false;
+    }
+    return true;
+}
+
+} // namespace openscp
@@ -0,0 +1,167 @@
+// Server-to-server copy of one file streamed through memory.
+#include "openscp/RemoteStream.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace openscp {
+
+ByteRing::ByteRing(std::size_t capacity)
+    : buf_(std::max<std::size_t>(1, capacity)) {}
+
+bool ByteRing::write(const char *data, std::size_t size) {
+    while (size > 0) {
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [&] { return closed_ || size_ < buf_.size(); });
+        if (closed_)
+            return false;
+        // Fill the free space up to the end of the buffer, then wrap.
+        const std::size_t tail = (head_ + size_) % buf_.size();
+        const std::size_t room = buf_.size() - size_;
+        const std::size_t n =
+            std::min({size, room, buf_.size() - tail});
+        std::memcpy(buf_.data() + tail, data, n);
+        size_ += n;
+        data += n;
+        size -= n;
+        lk.unlock();
+        cv_.notify_all();
+    }
+    return true;
+}
+
+void ByteRing::finish(bool ok) {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        finished_ = true;
+        failed_ = !ok;
+    }
+    cv_.notify_all();
+}
+
+std::ptrdiff_t ByteRing::read(char *out, std::size_t size) {
+    if (size == 0)
+        return 0;
+    std::unique_lock<std::mutex> lk(m_);
+    cv_.wait(lk, [&] { return size_ > 0 || finished_ || closed_; });
+    if (size_ == 0)
+        return (failed_ || closed_) ? -1 : 0;
+    const std::size_t n = std::min({size, size_, buf_.size() - head_});
+    std::memcpy(out, buf_.data() + head_, n);
+    head_ = (head_ + n) % buf_.size();
+    size_ -= n;
+    lk.unlock();
+    cv_.notify_all();
+    return static_cast<std::ptrdiff_t>(n);
+}
+
+void ByteRing::close() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
+
+bool streamRemoteFile(
+    SftpClient &src, const std::string &from, SftpClient &dst,
+    const std::string &to, std::string &err,
+    const std::function<void(std::size_t, std::size_t)> &progress,
+    const std::function<bool()> &shouldCancel, bool resume,
+    std::size_t bufferBytes) {
+    const ProtocolCapabilities srcCaps = src.capabilities();
+    const ProtocolCapabilities dstCaps = dst.capabilities();
+    if (!srcCaps.supports_streaming || !dstCaps.supports_streaming) {
+        err = "Streamed copies are not supported between these servers.";
+        return false;
+    }
+    FileInfo info{};
+    std::string stErr;
+    if (!src.stat(from, info, stErr)) {
+        err = stErr.empty() ? "No such file: " + from : stErr;
+        return false;
+    }
+    if (info.is_dir) {
+        err = "Is a directory: " + from;
+        return false;
+    }
+    const std::size_t total =
+        info.has_size ? static_cast<std::size_t>(info.size) : 0;
+
+    const std::string part = to + ".part";
+    std::uint64_t offset = 0;
+    if (resume && srcCaps.supports_resume && dstCaps.supports_resume) {
+        FileInfo pinfo{};
+        std::string pErr;
+        if (dst.stat(part, pinfo, pErr) && !pinfo.is_dir && pinfo.has_size &&
+            (!info.has_size || pinfo.size <= info.size))
+            offset = pinfo.size;
+    }
+
+    ByteRing ring(bufferBytes);
+    // Lets the reader stop at its next chunk once the writer gave up.
+    std::atomic<bool> writerDone{false};
+    bool readOk = false;
+    std::string readErr;
+    // The reader polls its own copy: a stateful callable is never shared
+    // between threads.
+    std::thread reader([&, cancelRead = shouldCancel] {
+        auto stopRead = [&] {
+            return writerDone.load() || (cancelRead && cancelRead());
+        };
+        readOk = src.readStream(
+            from, offset,
+            [&ring](const char *data, std::size_t size) {
+                return ring.write(data, size);
+            },
+            readErr, stopRead);
+        ring.finish(readOk);
+    });
+
+    std::uint64_t done = offset;
+    if (progress && done > 0)
+        progress(static_cast<std::size_t>(done), total);
+    bool sourceFailed = false;
+    std::string writeErr;
+    const bool wrote = dst.writeStream(
+        part, offset > 0,
+        [&](char *buf, std::size_t size) -> std::ptrdiff_t {
+            const std::ptrdiff_t n = ring.read(buf, size);
+            if (n < 0) {
+                sourceFailed = true;
+            } else if (n > 0) {
+                done += static_cast<std::uint64_t>(n);
+                if (progress)
+                    progress(static_cast<std::size_t>(done), total);
+            }
+            return n;
+        },
+        writeErr, shouldCancel);
+    writerDone.store(true);
+    ring.close();
+    reader.join();
+
+    if (!wrote || !readOk) {
+        if (shouldCancel && shouldCancel())
+            err = "Canceled by user";
+        else if (sourceFailed || wrote)
+            err = readErr.empty() ? "Remote read failed" : readErr;
+        else
+            err = writeErr.empty() ? "Remote write failed" : writeErr;
+        return false;
+    }
+    if (shouldCancel && shouldCancel()) {
+        err = "Canceled by user";
+        return false;
+    }
+    std::string rnErr;
+    if (!dst.rename(part, to, rnErr, true)) {
+        err = "Could not finalize copy (.part -> destination): " + rnErr;
+        return false;
+    }
+    return true;
+}
+
+} // namespace openscp
@@ -0,0 +1,70 @@
+// Versioned log of row changes that list views replay incrementally.
+#include "openscp/RowChangeLog.hpp"
+
+#include <algorithm>
+
+namespace openscp {
+
+void RowChangeLog::appended(int row) {
+    if (lastUnread()) {
+        RowChange &last = records_.back();
+        if (last.kind == RowChange::Kind::Appended &&
+            last.row + last.count == row) {
+            ++last.count;
+            return;
+        }
+    }
+    RowChange c;
+    c.kind = RowChange::Kind::Appended;
+    c.row = row;
+    c.count = 1;
+    push(c);
+}
+
+void RowChangeLog::removed(int row, int count) {
+    RowChange c;
+    c.kind = RowChange::Kind::Removed;
+    c.row = row;
+    c.count = count;
+    push(c);
+}
+
+void RowChangeLog::updated(std::uint64_t id) {
+    if (lastUnread()) {
+        const RowChange &last = records_.back();
+        if (last.kind == RowChange::Kind::Updated && last.id == id)
+            return;
+    }
+    RowChange c;
+    c.kind = RowChange::Kind::Updated;
+    c.id = id;
+    push(c);
+}
+
+std::uint64_t RowChangeLog::readVersion() const {
+    readUpTo_ = version();
+    return readUpTo_;
+}
+
+bool RowChangeLog::readSince(std::uint64_t &v,
+                             std::vector<RowChange> &out) const {
+    const std::uint64_t current = version();
+    if (v < base_ || v > current)
+        return false;
+    out.insert(out.end(),
+               records_.begin() + static_cast<std::ptrdiff_t>(v - base_),
+               records_.end());
+    v = current;
+    readUpTo_ = std::max(readUpTo_, current);
+    return true;
+}
+
+void RowChangeLog::push(const RowChange &c) {
+    records_.push_back(c);
+    if (records_.size() > maxRecords_) {
+        records_.pop_front();
+        ++base_;
+    }
+}
+
+} // namespace openscp
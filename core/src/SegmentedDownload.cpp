@@ -0,0 +1,295 @@
+// Segmented download of one large file over several sessions.
+#include "openscp/SegmentedDownload.hpp"
+#include "openscp/LocalFileIO.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace openscp {
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr const char *kSegmentStateMagic = "openscp-segments 1";
+// Segments per worker: smaller ranges balance uneven sessions and lose
+// less work when a run is interrupted.
+constexpr std::size_t kSegmentsPerWorker = 4;
+// Times a failed segment goes back to the queue before the download fails.
+constexpr unsigned kSegmentRetries = 1;
+constexpr std::size_t kNoSession = static_cast<std::size_t>(-1);
+
+} // namespace
+
+std::vector<TransferSegment>
+planTransferSegments(std::uint64_t total, std::size_t count,
+                     std::uint64_t minSegmentBytes) {
+    std::vector<TransferSegment> segments;
+    if (total == 0)
+        return segments;
+    std::uint64_t n = std::max<std::uint64_t>(1, count);
+    n = std::min<std::uint64_t>(
+        n, std::max<std::uint64_t>(
+               1, total / std::max<std::uint64_t>(1, minSegmentBytes)));
+    const std::uint64_t span = total / n;
+    segments.reserve(static_cast<std::size_t>(n));
+    for (std::uint64_t i = 0; i < n; ++i) {
+        TransferSegment seg;
+        seg.offset = i * span;
+        seg.length = (i + 1 == n) ? total - seg.offset : span;
+        segments.push_back(seg);
+    }
+    return segments;
+}
+
+std::string segmentedPartPath(const std::string &local) {
+    return local + ".part";
+}
+
+std::string segmentedStatePath(const std::string &local) {
+    return local + ".part.segments";
+}
+
+bool saveSegmentState(const std::string &path, std::uint64_t size,
+                      std::uint64_t mtime,
+                      const std::vector<TransferSegment> &segments,
+                      std::string &err) {
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            err = "Could not write segment state: " + tmp;
+            return false;
+        }
+        out << kSegmentStateMagic << '\n' << size << ' ' << mtime << '\n';
+        for (const auto &seg : segments)
+            out << seg.offset << ' ' << seg.length << ' '
+                << (seg.done ? 1 : 0) << '\n';
+        out.flush();
+        if (!out) {
+            err = "Could not write segment state: " + tmp;
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        err = "Could not replace segment state: " + ec.message();
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool loadSegmentState(const std::string &path, std::uint64_t size,
+                      std::uint64_t mtime,
+                      std::vector<TransferSegment> &segments) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    std::string magic;
+    if (!std::getline(in, magic) || magic != kSegmentStateMagic)
+        return false;
+    std::uint64_t savedSize = 0;
+    std::uint64_t savedMtime = 0;
+    if (!(in >> savedSize >> savedMtime) || savedSize != size ||
+        savedMtime != mtime) {
+        return false;
+    }
+    std::vector<TransferSegment> loaded;
+    std::uint64_t expectOffset = 0;
+    TransferSegment seg;
+    int done = 0;
+    while (in >> seg.offset >> seg.length >> done) {
+        // Segments must tile the file exactly.
+        if (seg.offset != expectOffset || seg.length == 0 ||
+            seg.length > size - seg.offset) {
+            return false;
+        }
+        seg.done = (done != 0);
+        expectOffset += seg.length;
+        loaded.push_back(seg);
+    }
+    if (loaded.empty() || expectOffset != size)
+        return false;
+    segments = std::move(loaded);
+    return true;
+}
+
+bool runSegmentedDownload(const std::vector<SftpClient *> &clients,
+                          const SegmentedDownloadJob &job, std::string &err) {
+    if (clients.empty() || job.size == 0) {
+        err = "Nothing to download in segments";
+        return false;
+    }
+    const std::string partPath = segmentedPartPath(job.local);
+    const std::string statePath = segmentedStatePath(job.local);
+
+    std::vector<TransferSegment> segments;
+    std::error_code ec;
+    const bool resumed =
+        job.resume && fs::exists(partPath, ec) &&
+        fs::file_size(partPath, ec) == job.size && !ec &&
+        loadSegmentState(statePath, job.size, job.mtime, segments);
+    if (!resumed) {
+        segments = planTransferSegments(
+            job.size, clients.size() * kSegmentsPerWorker, job.minSegmentBytes);
+        // Reserve the blocks and set the full size up front; each worker
+        // then writes its ranges in place (zero blocks stay holes).
+        LocalFileWriter part;
+        if (!part.open(partPath, LocalFileWriter::Mode::Truncate,
+                       LocalIoOptions{}, err)) {
+            err = "Could not create local file (.part)";
+            return false;
+        }
+        (void)part.preallocate(job.size);
+        std::string sizeErr;
+        if (!part.truncate(job.size, sizeErr) || !part.close(sizeErr)) {
+            err = "Could not preallocate local file (.part): " + sizeErr;
+            return false;
+        }
+        if (!saveSegmentState(statePath, job.size, job.mtime, segments, err))
+            return false;
+    }
+
+    // mtx protects segments, taken, failures, failedOn, inFlight, firstErr
+    // and progress; `requeued` wakes idle workers when a segment comes back.
+    std::mutex mtx;
+    std::condition_variable requeued;
+    std::vector<bool> taken(segments.size(), false);
+    std::vector<unsigned> failures(segments.size(), 0);
+    std::vector<std::size_t> failedOn(segments.size(), kNoSession);
+    std::vector<std::uint64_t> inFlight(clients.size(), 0);
+    std::uint64_t completedBytes = 0;
+    for (const auto &seg : segments) {
+        if (seg.done)
+            completedBytes += seg.length;
+    }
+    std::string firstErr;
+    std::atomic<bool> stop{false};
+
+    auto reportLocked = [&] {
+        if (!job.progress)
+            return;
+        std::uint64_t done = completedBytes;
+        for (std::uint64_t bytes : inFlight)
+            done += bytes;
+        job.progress(static_cast<std::size_t>(done),
+                     static_cast<std::size_t>(job.size));
+    };
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        reportLocked();
+    }
+
+    auto worker = [&](std::size_t w) {
+        std::function<bool()> cancel = job.shouldCancel;
+        auto shouldStop = [&] {
+            return stop.load() || (cancel && cancel());
+        };
+        // A failed segment is retried on another session; with a single
+        // session there is no other to hand it to.
+        auto mayTake = [&](std::size_t i) {
+            return !segments[i].done && !taken[i] &&
+                   (failedOn[i] != w || clients.size() == 1);
+        };
+        std::unique_lock<std::mutex> lk(mtx);
+        while (!shouldStop()) {
+            std::size_t next = segments.size();
+            for (std::size_t i = 0; i < segments.size(); ++i) {
+                if (mayTake(i)) {
+                    next = i;
+                    break;
+                }
+            }
+            if (next == segments.size()) {
+                // Nothing for this session; stay around while a running
+                // segment may still fail and be requeued.
+                if (std::none_of(taken.begin(), taken.end(),
+                                 [](bool b) { return b; })) {
+                    return;
+                }
+                requeued.wait(lk);
+                continue;
+            }
+            taken[next] = true;
+            const TransferSegment seg = segments[next];
+            lk.unlock();
+            std::string segErr;
+            const bool ok = clients[w]->getRange(
+                job.remote, partPath, seg.offset, seg.length, segErr,
+                [&, w](std::size_t done, std::size_t) {
+                    std::lock_guard<std::mutex> plk(mtx);
+                    inFlight[w] = done;
+                    reportLocked();
+                },
+                shouldStop);
+            lk.lock();
+            inFlight[w] = 0;
+            taken[next] = false;
+            if (!ok) {
+                if (!shouldStop() && failures[next] < kSegmentRetries) {
+                    ++failures[next];
+                    failedOn[next] = w;
+                    reportLocked();
+                    requeued.notify_all();
+                    continue;
+                }
+                if (firstErr.empty() && !shouldStop())
+                    firstErr = segErr;
+                stop.store(true);
+                requeued.notify_all();
+                return;
+            }
+            segments[next].done = true;
+            completedBytes += seg.length;
+            std::string saveErr;
+            (void)saveSegmentState(statePath, job.size, job.mtime, segments,
+                                   saveErr);
+            reportLocked();
+            requeued.notify_all();
+        }
+        requeued.notify_all();
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(clients.size() - 1);
+    for (std::size_t w = 1; w < clients.size(); ++w)
+        threads.emplace_back(worker, w);
+    worker(0);
+    for (auto &th : threads)
+        th.join();
+
+    const bool allDone =
+        std::all_of(segments.begin(), segments.end(),
+                    [](const TransferSegment &seg) { return seg.done; });
+    if (!allDone) {
+        // The .part and its state stay behind for a resumed attempt.
+        if (!firstErr.empty())
+            err = firstErr;
+        else
+            err = "Canceled by user";
+        return false;
+    }
+
+    // Each segment was synced by getRange(); sync once more so the size
+    // set up front is durable too, then rename and sync the directory.
+    std::string finalErr;
+    LocalFileWriter part;
+    if (!part.open(partPath, LocalFileWriter::Mode::Keep, LocalIoOptions{},
+                   finalErr) ||
+        !part.sync(finalErr) || !part.close(finalErr) ||
+        !replaceLocalFileAtomic(partPath, job.local, finalErr)) {
+        err = "Could not finalize segmented download: " + finalErr;
+        return false;
+    }
+    fs::remove(statePath, ec);
+    return true;
+}
+
+} // namespace openscp
@@ -0,0 +1,176 @@
+// Asynchronous remote operations queued on one session.
+#include "openscp/SessionExecutor.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace openscp {
+
+// Shared with the I/O thread, which may outlive the executor.
+struct SessionExecutor::State {
+    SessionFactory factory;
+
+    mutable std::mutex m; // protects every field below
+    std::condition_variable cv;
+    std::deque<Job> queue;
+    bool running = false;
+    bool stop = false;
+    std::unique_ptr<SftpClient> session;
+};
+
+SessionExecutor::SessionExecutor(SessionFactory factory)
+    : st_(std::make_shared<State>()) {
+    st_->factory = std::move(factory);
+    std::thread([st = st_] { loop(st); }).detach();
+}
+
+SessionExecutor::~SessionExecutor() {
+    {
+        std::lock_guard<std::mutex> lk(st_->m);
+        st_->stop = true;
+        // Unblock an operation that is waiting on the server.
+        if (st_->session)
+            st_->session->interrupt();
+    }
+    st_->cv.notify_all();
+}
+
+void SessionExecutor::enqueue(Job job) {
+    {
+        std::lock_guard<std::mutex> lk(st_->m);
+        st_->queue.push_back(std::move(job));
+    }
+    st_->cv.notify_all();
+}
+
+std::future<AsyncStatus>
+SessionExecutor::run(std::function<bool(SftpClient &, std::string &)> op) {
+    auto promise = std::make_shared<std::promise<AsyncStatus>>();
+    std::future<AsyncStatus> f = promise->get_future();
+    enqueue([op = std::move(op), promise](SftpClient *client,
+                                          const std::string &openErr) {
+        AsyncStatus s;
+        if (!client)
+            s.error = openErr;
+        else
+            s.ok = op(*client, s.error);
+        promise->set_value(std::move(s));
+    });
+    return f;
+}
+
+std::future<AsyncResult<FileInfo>>
+SessionExecutor::stat(const std::string &path) {
+    return submit<FileInfo>(
+        [path](SftpClient &c, FileInfo &info, std::string &err) {
+            return c.stat(path, info, err);
+        });
+}
+
+std::future<AsyncResult<std::vector<FileInfo>>>
+SessionExecutor::list(const std::string &path) {
+    return submit<std::vector<FileInfo>>(
+        [path](SftpClient &c, std::vector<FileInfo> &out, std::string &err) {
+            return c.list(path, out, err);
+        });
+}
+
+std::future<AsyncStatus> SessionExecutor::mkdir(const std::string &path,
+                                                unsigned int mode) {
+    return run([path, mode](SftpClient &c, std::string &err) {
+        return c.mkdir(path, err, mode);
+    });
+}
+
+std::future<AsyncStatus> SessionExecutor::rename(const std::string &from,
+                                                 const std::string &to,
+                                                 bool overwrite) {
+    return run([from, to, overwrite](SftpClient &c, std::string &err) {
+        return c.rename(from, to, err, overwrite);
+    });
+}
+
+std::future<AsyncStatus> SessionExecutor::chmod(const std::string &path,
+                                                std::uint32_t mode) {
+    return run([path, mode](SftpClient &c, std::string &err) {
+        return c.chmod(path, mode, err);
+    });
+}
+
+std::future<AsyncStatus>
+SessionExecutor::removeFile(const std::string &path) {
+    return run([path](SftpClient &c, std::string &err) {
+        return c.removeFile(path, err);
+    });
+}
+
+void SessionExecutor::cancelPending() {
+    std::deque<Job> dropped;
+    {
+        std::lock_guard<std::mutex> lk(st_->m);
+        dropped.swap(st_->queue);
+    }
+    st_->cv.notify_all();
+    for (Job &job : dropped)
+        job(nullptr, "Canceled");
+}
+
+std::size_t SessionExecutor::pending() const {
+    std::lock_guard<std::mutex> lk(st_->m);
+    return st_->queue.size() + (st_->running ? 1 : 0);
+}
+
+void SessionExecutor::loop(const std::shared_ptr<State> &st) {
+    std::unique_lock<std::mutex> lk(st->m);
+    for (;;) {
+        st->cv.wait(lk, [&] { return st->stop || !st->queue.empty(); });
+        if (st->stop)
+            break;
+        Job job = std::move(st->queue.front());
+        st->queue.pop_front();
+        st->running = true;
+        // A session the last operation left disconnected is replaced.
+        std::unique_ptr<SftpClient> dead;
+        if (st->session && !st->session->isConnected())
+            dead = std::move(st->session);
+        const bool open = st->session != nullptr;
+        lk.unlock();
+
+        if (dead)
+            dead->disconnect();
+        dead.reset();
+        SftpClient *client = nullptr;
+        std::string openErr;
+        if (open) {
+            client = st->session.get(); // only this thread replaces it
+        } else if (st->factory) {
+            std::unique_ptr<SftpClient> session = st->factory(openErr);
+            if (session) {
+                client = session.get();
+                lk.lock();
+                st->session = std::move(session);
+                lk.unlock();
+            } else if (openErr.empty()) {
+                openErr = "Could not open a session";
+            }
+        } else {
+            openErr = "No session available";
+        }
+        job(client, openErr);
+
+        lk.lock();
+        st->running = false;
+    }
+    std::deque<Job> rest;
+    rest.swap(st->queue);
+    std::unique_ptr<SftpClient> session = std::move(st->session);
+    lk.unlock();
+    for (Job &job : rest)
+        job(nullptr, "Session closed");
+    if (session)
+        session->disconnect();
+}
+
+} // namespace openscp
@@ -0,0 +1,346 @@
+// Persistent snapshot index for folder synchronization.
+#include "openscp/SyncIndex.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace openscp {
+
+namespace {
+
+constexpr char kMagic[8] = {'O', 'S', 'C', 'P', 'S', 'Y', 'N', 'C'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kByteOrderMark = 0x01020304u;
+constexpr std::uint32_t kFlagHashes = 1u << 0;
+
+// On-disk header; the arrays follow in this order: size[count] (u64),
+// mtime[count] (i64), nameEnd[count] (u32), then with kFlagHashes
+// hashFlag[count] (u8) and hash[count][32], and finally the path pool.
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint64_t count;
+    std::uint64_t poolBytes;
+    std::uint32_t byteOrder;
+    std::uint32_t reserved;
+};
+static_assert(sizeof(Header) == 40, "SyncIndex header must stay 40 bytes");
+
+// Bytes of the array section for `count` entries.
+std::uint64_t arrayBytes(std::uint64_t count, bool hashes) {
+    std::uint64_t bytes = count * (8 + 8 + 4);
+    if (hashes)
+        bytes += count * (1 + 32);
+    return bytes;
+}
+
+bool writeAll(std::FILE *f, const void *data, std::size_t len) {
+    return len == 0 || std::fwrite(data, 1, len, f) == len;
+}
+
+} // namespace
+
+SyncIndex::SyncIndex(SyncIndex &&other) noexcept { *this = std::move(other); }
+
+SyncIndex &SyncIndex::operator=(SyncIndex &&other) noexcept {
+    if (this == &other)
+        return *this;
+    close();
+    base_ = other.base_;
+    mappedBytes_ = other.mappedBytes_;
+    loaded_ = other.loaded_;
+    count_ = other.count_;
+    size_ = other.size_;
+    mtime_ = other.mtime_;
+    nameEnd_ = other.nameEnd_;
+    hashFlags_ = other.hashFlags_;
+    hashes_ = other.hashes_;
+    pool_ = other.pool_;
+    other.base_ = nullptr;
+    other.mappedBytes_ = 0;
+    other.close();
+    return *this;
+}
+
+void SyncIndex::close() {
+    if (base_) {
+#ifdef _WIN32
+        UnmapViewOfFile(base_);
+#else
+        ::munmap(const_cast<char *>(base_), mappedBytes_);
+#endif
+    }
+    base_ = nullptr;
+    mappedBytes_ = 0;
+    loaded_ = false;
+    count_ = 0;
+    size_ = nullptr;
+    mtime_ = nullptr;
+    nameEnd_ = nullptr;
+    hashFlags_ = nullptr;
+    hashes_ = nullptr;
+    pool_ = nullptr;
+}
+
+bool SyncIndex::open(const std::string &file, std::string &err) {
+    close();
+    std::error_code ec;
+    if (!std::filesystem::exists(file, ec))
+        return true;
+    const std::uint64_t bytes = std::filesystem::file_size(file, ec);
+    if (ec) {
+        err = "Could not read sync index: " + ec.message();
+        return false;
+    }
+    if (bytes < sizeof(Header) ||
+        bytes > std::numeric_limits<std::size_t>::max()) {
+        err = "Sync index is corrupt (bad size)";
+        return false;
+    }
+
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+    if (fh == INVALID_HANDLE_VALUE) {
+        err = "Could not open sync index";
+        return false;
+    }
+    HANDLE mh = CreateFileMappingA(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(fh);
+    if (!mh) {
+        err = "Could not map sync index";
+        return false;
+    }
+    void *view = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mh);
+    if (!view) {
+        err = "Could not map sync index";
+        return false;
+    }
+#else
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        err = "Could not open sync index";
+        return false;
+    }
+    void *view = ::mmap(nullptr, (std::size_t)bytes, PROT_READ, MAP_SHARED,
+                        fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        err = "Could not map sync index";
+        return false;
+    }
+#endif
+    base_ = static_cast<const char *>(view);
+    mappedBytes_ = (std::size_t)bytes;
+
+    auto corrupt = [&](const char *why) {
+        close();
+        err = std::string("Sync index is corrupt (") + why + ")";
+        return false;
+    };
+    Header h{};
+    std::memcpy(&h, base_, sizeof(h));
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0)
+        return corrupt("bad magic");
+    if (h.version != kVersion || h.byteOrder != kByteOrderMark)
+        return corrupt("unsupported version");
+    const bool hashes = (h.flags & kFlagHashes) != 0;
+    if (h.count > bytes ||
+        h.poolBytes > std::numeric_limits<std::uint32_t>::max() ||
+        sizeof(Header) + arrayBytes(h.count, hashes) + h.poolBytes != bytes)
+        return corrupt("bad size");
+
+    const std::size_t n = (std::size_t)h.count;
+    const char *p = base_ + sizeof(Header);
+    size_ = reinterpret_cast<const std::uint64_t *>(p);
+    p += n * 8;
+    mtime_ = reinterpret_cast<const std::int64_t *>(p);
+    p += n * 8;
+    nameEnd_ = reinterpret_cast<const std::uint32_t *>(p);
+    p += n * 4;
+    if (hashes) {
+        hashFlags_ = reinterpret_cast<const std::uint8_t *>(p);
+        p += n;
+        hashes_ = reinterpret_cast<const std::uint8_t *>(p);
+        p += n * 32;
+    }
+    pool_ = p;
+    count_ = n;
+
+    // Lookups rely on strictly ascending, non-empty paths inside the pool.
+    std::uint32_t prevEnd = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (nameEnd_[i] <= prevEnd || nameEnd_[i] > h.poolBytes)
+            return corrupt("bad path table");
+        if (i > 0 && !(path(i - 1) < path(i)))
+            return corrupt("unsorted paths");
+        prevEnd = nameEnd_[i];
+    }
+    if (prevEnd != h.poolBytes)
+        return corrupt("bad path table");
+    loaded_ = true;
+    return true;
+}
+
+SyncEntry SyncIndex::at(std::size_t i) const {
+    SyncEntry e;
+    e.path = std::string(path(i));
+    e.size = size_[i];
+    e.mtime = mtime_[i];
+    e.has_hash = hasHash(i);
+    if (e.has_hash)
+        std::memcpy(e.hash.data(), hash(i), e.hash.size());
+    return e;
+}
+
+std::size_t SyncIndex::find(std::string_view p) const {
+    std::size_t lo = 0;
+    std::size_t hi = count_;
+    while (lo < hi) {
+        const std::size_t mid = lo + (hi - lo) / 2;
+        const std::string_view cur = path(mid);
+        if (cur == p)
+            return mid;
+        if (cur < p)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return npos;
+}
+
+bool SyncIndex::write(const std::string &file, std::vector<SyncEntry> entries,
+                      std::string &err) {
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const SyncEntry &a, const SyncEntry &b) {
+                         return a.path < b.path;
+                     });
+    // Keep the last of each run of equal paths; drop empty paths.
+    std::vector<SyncEntry> unique;
+    unique.reserve(entries.size());
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].path.empty())
+            continue;
+        if (i + 1 < entries.size() && entries[i + 1].path == entries[i].path)
+            continue;
+        unique.push_back(std::move(entries[i]));
+    }
+
+    const std::size_t n = unique.size();
+    bool hashes = false;
+    std::vector<std::uint64_t> sizes(n);
+    std::vector<std::int64_t> mtimes(n);
+    std::vector<std::uint32_t> nameEnds(n);
+    std::uint64_t poolBytes = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        sizes[i] = unique[i].size;
+        mtimes[i] = unique[i].mtime;
+        poolBytes += unique[i].path.size();
+        if (poolBytes > std::numeric_limits<std::uint32_t>::max()) {
+            err = "Sync index is too large";
+            return false;
+        }
+        nameEnds[i] = (std::uint32_t)poolBytes;
+        hashes = hashes || unique[i].has_hash;
+    }
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.flags = hashes ? kFlagHashes : 0;
+    h.count = n;
+    h.poolBytes = poolBytes;
+    h.byteOrder = kByteOrderMark;
+
+    // Written to a sibling and renamed over the old snapshot, so readers
+    // see either the old or the new index. Not fsync'ed: a snapshot lost in
+    // a crash only costs a full comparison on the next run.
+    const std::string tmp = file + ".tmp";
+    std::FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        err = "Could not create sync index";
+        return false;
+    }
+    bool ok = writeAll(f, &h, sizeof(h)) &&
+              writeAll(f, sizes.data(), n * 8) &&
+              writeAll(f, mtimes.data(), n * 8) &&
+              writeAll(f, nameEnds.data(), n * 4);
+    if (ok && hashes) {
+        std::vector<std::uint8_t> flags(n);
+        for (std::size_t i = 0; i < n; ++i)
+            flags[i] = unique[i].has_hash ? 1 : 0;
+        ok = writeAll(f, flags.data(), n);
+        for (std::size_t i = 0; ok && i < n; ++i)
+            ok = writeAll(f, unique[i].hash.data(), unique[i].hash.size());
+    }
+    for (std::size_t i = 0; ok && i < n; ++i)
+        ok = writeAll(f, unique[i].path.data(), unique[i].path.size());
+    if (std::fclose(f) != 0)
+        ok = false;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        err = "Could not write sync index";
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, file, ec);
+    if (ec) {
+        std::remove(tmp.c_str());
+        err = "Could not replace sync index: " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+SyncDiff diffSyncIndex(const SyncIndex &index, std::vector<SyncEntry> &scan) {
+    std::sort(scan.begin(), scan.end(),
+              [](const SyncEntry &a, const SyncEntry &b) {
+                  return a.path < b.path;
+              });
+    SyncDiff diff;
+    std::size_t i = 0; // index position
+    std::size_t j = 0; // scan position
+    while (i < index.size() || j < scan.size()) {
+        const std::string_view cur = j < scan.size()
+                                         ? std::string_view(scan[j].path)
+                                         : std::string_view();
+        if (j == scan.size() || (i < index.size() && index.path(i) < cur)) {
+            diff.removed.push_back(i++);
+            continue;
+        }
+        if (i == index.size() || cur < index.path(i)) {
+            diff.changed.push_back(j++);
+            continue;
+        }
+        const SyncEntry &e = scan[j];
+        bool same = e.size == index.fileSize(i) && e.mtime == index.mtime(i);
+        if (same && e.has_hash && index.hasHash(i))
+            same =
+                std::memcmp(e.hash.data(), index.hash(i), e.hash.size()) == 0;
+        (same ? diff.unchanged : diff.changed).push_back(j);
+        ++i;
+        ++j;
+    }
+    return diff;
+}
+
+} // namespace openscp
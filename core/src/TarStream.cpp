@@ -0,0 +1,491 @@
+// Streaming tar archive writer/reader used by archive batch transfers.
+#include "openscp/TarStream.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+namespace openscp {
+namespace {
+
+constexpr std::size_t kBlock = TarWriter::kBlockSize;
+constexpr std::size_t kNameLen = 100;
+constexpr std::size_t kPrefixLen = 155;
+// Largest size an 11-digit octal field can carry.
+constexpr std::uint64_t kMaxOctalSize = 077777777777ull;
+// Long names and pax records are buffered whole; cap what a server may send.
+constexpr std::uint64_t kMaxMetaBytes = 1024 * 1024;
+
+// ustar header field offsets.
+constexpr std::size_t kOffMode = 100;
+constexpr std::size_t kOffUid = 108;
+constexpr std::size_t kOffGid = 116;
+constexpr std::size_t kOffSize = 124;
+constexpr std::size_t kOffMtime = 136;
+constexpr std::size_t kOffChecksum = 148;
+constexpr std::size_t kOffType = 156;
+constexpr std::size_t kOffMagic = 257;
+constexpr std::size_t kOffVersion = 263;
+constexpr std::size_t kOffPrefix = 345;
+
+std::uint64_t paddingFor(std::uint64_t size) {
+    return (kBlock - size % kBlock) % kBlock;
+}
+
+// Octal with a trailing NUL, or GNU base-256 when the value does not fit.
+void putNumeric(char *field, std::size_t width, std::uint64_t value) {
+    std::uint64_t limit = 1;
+    for (std::size_t i = 0; i + 1 < width; ++i)
+        limit *= 8;
+    if (value < limit) {
+        for (std::size_t i = width - 1; i-- > 0;) {
+            field[i] = static_cast<char>('0' + (value & 7));
+            value >>= 3;
+        }
+        field[width - 1] = '\0';
+        return;
+    }
+    std::memset(field, 0, width);
+    for (std::size_t i = width; i-- > 1;) {
+        field[i] = static_cast<char>(value & 0xff);
+        value >>= 8;
+    }
+    field[0] = static_cast<char>(0x80);
+}
+
+bool parseNumeric(const char *field, std::size_t width, std::uint64_t &out) {
+    out = 0;
+    if (static_cast<unsigned char>(field[0]) & 0x80) {
+        for (std::size_t i = 1; i < width; ++i)
+            out = (out << 8) | static_cast<unsigned char>(field[i]);
+        return true;
+    }
+    std::size_t i = 0;
+    while (i < width && field[i] == ' ')
+        ++i;
+    for (; i < width && field[i] != '\0' && field[i] != ' '; ++i) {
+        if (field[i] < '0' || field[i] > '7')
+            return false;
+        out = (out << 3) | static_cast<std::uint64_t>(field[i] - '0');
+    }
+    return true;
+}
+
+std::string fieldString(const char *field, std::size_t width) {
+    return std::string(field, strnlen(field, width));
+}
+
+void fillChecksum(char *block) {
+    std::memset(block + kOffChecksum, ' ', 8);
+    unsigned long sum = 0;
+    for (std::size_t i = 0; i < kBlock; ++i)
+        sum += static_cast<unsigned char>(block[i]);
+    std::snprintf(block + kOffChecksum, 8, "%06lo", sum);
+    block[kOffChecksum + 7] = ' ';
+}
+
+bool checksumMatches(const char *block) {
+    std::uint64_t stored = 0;
+    if (!parseNumeric(block + kOffChecksum, 8, stored))
+        return false;
+    unsigned long sum = 0;
+    long signedSum = 0;
+    for (std::size_t i = 0; i < kBlock; ++i) {
+        const bool inField = i >= kOffChecksum && i < kOffChecksum + 8;
+        const char c = inField ? ' ' : block[i];
+        sum += static_cast<unsigned char>(c);
+        signedSum += static_cast<signed char>(c);
+    }
+    // Some historic writers summed signed chars.
+    return stored == sum || static_cast<long>(stored) == signedSum;
+}
+
+// Split `name` over the ustar prefix/name fields at a '/'.
+bool splitUstarName(const std::string &name, std::string &prefix,
+                    std::string &base) {
+    if (name.size() <= kNameLen) {
+        prefix.clear();
+        base = name;
+        return true;
+    }
+    const std::size_t maxPos = std::min(kPrefixLen, name.size() - 1);
+    for (std::size_t pos = maxPos + 1; pos-- > 0;) {
+        if (name[pos] != '/')
+            continue;
+        if (name.size() - pos - 1 > kNameLen)
+            return false;
+        if (pos == 0)
+            return false;
+        prefix = name.substr(0, pos);
+        base = name.substr(pos + 1);
+        return !base.empty();
+    }
+    return false;
+}
+
+// "<len> key=value\n", where len counts the whole record.
+std::string paxRecord(const std::string &key, const std::string &value) {
+    const std::size_t body = key.size() + value.size() + 3; // ' ', '=', '\n'
+    std::size_t len = body + 1;
+    while (std::to_string(len).size() + body != len)
+        ++len;
+    return std::to_string(len) + " " + key + "=" + value + "\n";
+}
+
+// Archive paths as callers see them: no "./" prefix, no trailing '/'.
+std::string normalizeMemberPath(std::string path) {
+    while (path.size() >= 2 && path[0] == '.' && path[1] == '/')
+        path.erase(0, 2);
+    while (!path.empty() && path.back() == '/')
+        path.pop_back();
+    if (path == ".")
+        path.clear();
+    return path;
+}
+
+} // namespace
+
+bool isSafeArchivePath(const std::string &path) {
+    if (path.empty() || path.front() == '/' ||
+        path.find('\0') != std::string::npos)
+        return false;
+    std::size_t start = 0;
+    while (start <= path.size()) {
+        std::size_t end = path.find('/', start);
+        if (end == std::string::npos)
+            end = path.size();
+        const std::string_view part(path.data() + start, end - start);
+        if (part.empty() || part == "." || part == "..")
+            return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+bool TarWriter::emit(const char *data, std::size_t len, std::string &err) {
+    if (len == 0)
+        return true;
+    if (!sink_(data, len)) {
+        if (err.empty())
+            err = "Archive stream write failed";
+        return false;
+    }
+    return true;
+}
+
+bool TarWriter::emitHeader(const std::string &name, char type,
+                           std::uint64_t size, std::uint32_t mode,
+                           std::uint64_t mtime, std::string &err) {
+    char block[kBlock];
+    std::memset(block, 0, sizeof(block));
+    std::string prefix;
+    std::string base;
+    if (!splitUstarName(name, prefix, base)) {
+        // The real path travels in a pax record; keep a readable stub.
+        prefix.clear();
+        base = name.substr(0, kNameLen);
+    }
+    std::memcpy(block, base.data(), base.size());
+    std::memcpy(block + kOffPrefix, prefix.data(), prefix.size());
+    putNumeric(block + kOffMode, 8, mode & 07777);
+    putNumeric(block + kOffUid, 8, 0);
+    putNumeric(block + kOffGid, 8, 0);
+    putNumeric(block + kOffSize, 12, size);
+    putNumeric(block + kOffMtime, 12, mtime);
+    block[kOffType] = type;
+    std::memcpy(block + kOffMagic, "ustar", 6);
+    std::memcpy(block + kOffVersion, "00", 2);
+    fillChecksum(block);
+    return emit(block, sizeof(block), err);
+}
+
+bool TarWriter::beginEntry(const TarEntry &entry, std::string &err) {
+    if (inEntry_) {
+        err = "Previous archive entry was not finished";
+        return false;
+    }
+    if (entry.path.empty()) {
+        err = "Archive entry has an empty path";
+        return false;
+    }
+    std::string name = entry.path;
+    if (entry.is_dir && name.back() != '/')
+        name += '/';
+    const std::uint64_t size = entry.is_dir ? 0 : entry.size;
+    const std::uint32_t mode =
+        entry.mode ? entry.mode : (entry.is_dir ? 0755u : 0644u);
+
+    std::string prefix;
+    std::string base;
+    std::string pax;
+    if (!splitUstarName(name, prefix, base))
+        pax += paxRecord("path", name);
+    if (size > kMaxOctalSize)
+        pax += paxRecord("size", std::to_string(size));
+    if (!pax.empty()) {
+        const std::string paxName =
+            "PaxHeaders/" + name.substr(0, kNameLen - 11);
+        if (!emitHeader(paxName, 'x', pax.size(), 0644, entry.mtime, err) ||
+            !emit(pax.data(), pax.size(), err))
+            return false;
+        const std::string zeros(paddingFor(pax.size()), '\0');
+        if (!emit(zeros.data(), zeros.size(), err))
+            return false;
+    }
+    if (!emitHeader(name, entry.is_dir ? '5' : '0', size, mode, entry.mtime,
+                    err))
+        return false;
+    inEntry_ = true;
+    remaining_ = size;
+    written_ = 0;
+    return true;
+}
+
+bool TarWriter::writeData(const char *data, std::size_t len,
+                          std::string &err) {
+    if (!inEntry_ || len > remaining_) {
+        err = "Archive entry data exceeds its declared size";
+        return false;
+    }
+    if (!emit(data, len, err))
+        return false;
+    remaining_ -= len;
+    written_ += len;
+    return true;
+}
+
+bool TarWriter::endEntry(std::string &err) {
+    if (!inEntry_)
+        return true;
+    if (remaining_ != 0) {
+        err = "Archive entry is shorter than its declared size";
+        return false;
+    }
+    const std::string zeros(paddingFor(written_), '\0');
+    if (!emit(zeros.data(), zeros.size(), err))
+        return false;
+    inEntry_ = false;
+    return true;
+}
+
+bool TarWriter::finish(std::string &err) {
+    if (inEntry_) {
+        err = "Previous archive entry was not finished";
+        return false;
+    }
+    const std::string zeros(2 * kBlock, '\0');
+    return emit(zeros.data(), zeros.size(), err);
+}
+
+bool TarReader::feed(const char *data, std::size_t len, std::string &err) {
+    while (len > 0) {
+        switch (state_) {
+        case State::Done:
+            // Trailing zero blocks and record padding are not parsed.
+            return true;
+        case State::Header: {
+            const std::size_t n = std::min(len, kBlock - blockFill_);
+            std::memcpy(block_.data() + blockFill_, data, n);
+            blockFill_ += n;
+            data += n;
+            len -= n;
+            if (blockFill_ == kBlock) {
+                blockFill_ = 0;
+                if (!handleHeader(err))
+                    return false;
+            }
+            break;
+        }
+        case State::Data: {
+            const std::size_t n =
+                static_cast<std::size_t>(std::min<std::uint64_t>(
+                    len, remaining_));
+            if (deliver_ && cb_.onData && !cb_.onData(data, n))
+                return false;
+            data += n;
+            len -= n;
+            remaining_ -= n;
+            if (remaining_ == 0 && !finishMember())
+                return false;
+            break;
+        }
+        case State::Meta: {
+            const std::size_t n =
+                static_cast<std::size_t>(std::min<std::uint64_t>(
+                    len, remaining_));
+            meta_.append(data, n);
+            data += n;
+            len -= n;
+            remaining_ -= n;
+            if (remaining_ == 0 && !handleMeta(err))
+                return false;
+            break;
+        }
+        case State::Skip: {
+            const std::size_t n =
+                static_cast<std::size_t>(std::min<std::uint64_t>(
+                    len, remaining_));
+            data += n;
+            len -= n;
+            remaining_ -= n;
+            if (remaining_ == 0)
+                state_ = padding_ ? State::Padding : State::Header;
+            break;
+        }
+        case State::Padding: {
+            const std::size_t n =
+                static_cast<std::size_t>(std::min<std::uint64_t>(
+                    len, padding_));
+            data += n;
+            len -= n;
+            padding_ -= n;
+            if (padding_ == 0)
+                state_ = State::Header;
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+bool TarReader::handleHeader(std::string &err) {
+    const char *b = block_.data();
+    if (std::all_of(block_.begin(), block_.end(),
+                    [](char c) { return c == '\0'; })) {
+        state_ = State::Done;
+        return true;
+    }
+    if (!checksumMatches(b)) {
+        err = "Corrupt archive header (checksum mismatch)";
+        return false;
+    }
+    std::uint64_t size = 0;
+    if (!parseNumeric(b + kOffSize, 12, size)) {
+        err = "Corrupt archive header (size)";
+        return false;
+    }
+    const char type = b[kOffType];
+    if (type == 'L' || type == 'x') {
+        if (size > kMaxMetaBytes) {
+            err = "Archive metadata record is too large";
+            return false;
+        }
+        metaType_ = type;
+        meta_.clear();
+        remaining_ = size;
+        padding_ = paddingFor(size);
+        state_ = State::Meta;
+        return size != 0 || handleMeta(err);
+    }
+
+    std::string path = fieldString(b, kNameLen);
+    if (std::memcmp(b + kOffMagic, "ustar", 6) == 0 && b[kOffPrefix]) {
+        // POSIX ustar: the prefix field holds the leading directories.
+        path = fieldString(b + kOffPrefix, kPrefixLen) + "/" + path;
+    }
+    if (!pendingPath_.empty())
+        path = std::move(pendingPath_);
+    if (havePendingSize_)
+        size = pendingSize_;
+    pendingPath_.clear();
+    havePendingSize_ = false;
+
+    std::uint64_t mode = 0;
+    std::uint64_t mtime = 0;
+    (void)parseNumeric(b + kOffMode, 8, mode);
+    (void)parseNumeric(b + kOffMtime, 12, mtime);
+    TarEntry entry;
+    entry.path = normalizeMemberPath(std::move(path));
+    entry.size = size;
+    entry.mode = static_cast<std::uint32_t>(mode & 07777);
+    entry.mtime = mtime;
+    remaining_ = size;
+    padding_ = paddingFor(size);
+
+    const bool isFile = type == '0' || type == '\0' || type == '7';
+    if (type == '5') {
+        entry.is_dir = true;
+        entry.size = 0;
+        if (cb_.onEntry && !cb_.onEntry(entry))
+            return false;
+        if (cb_.onEntryEnd && !cb_.onEntryEnd())
+            return false;
+    }
+    if (!isFile) {
+        // Directories carry no data; links, devices and unknown types are
+        // stepped over.
+        deliver_ = false;
+        state_ = size ? State::Skip : State::Header;
+        return true;
+    }
+    deliver_ = true;
+    if (cb_.onEntry && !cb_.onEntry(entry))
+        return false;
+    state_ = State::Data;
+    return size != 0 || finishMember();
+}
+
+bool TarReader::handleMeta(std::string &err) {
+    if (metaType_ == 'L') {
+        pendingPath_ = meta_.substr(0, meta_.find('\0'));
+    } else {
+        std::size_t pos = 0;
+        while (pos < meta_.size()) {
+            const std::size_t sp = meta_.find(' ', pos);
+            if (sp == std::string::npos) {
+                err = "Corrupt pax header";
+                return false;
+            }
+            std::uint64_t recLen = 0;
+            for (std::size_t i = pos; i < sp; ++i) {
+                if (meta_[i] < '0' || meta_[i] > '9') {
+                    err = "Corrupt pax header";
+                    return false;
+                }
+                recLen = recLen * 10 +
+                         static_cast<std::uint64_t>(meta_[i] - '0');
+            }
+            if (recLen <= sp - pos + 1 || pos + recLen > meta_.size() ||
+                meta_[pos + recLen - 1] != '\n') {
+                err = "Corrupt pax header";
+                return false;
+            }
+            const std::string kv =
+                meta_.substr(sp + 1, pos + recLen - 1 - (sp + 1));
+            const std::size_t eq = kv.find('=');
+            if (eq != std::string::npos) {
+                const std::string key = kv.substr(0, eq);
+                const std::string value = kv.substr(eq + 1);
+                if (key == "path") {
+                    pendingPath_ = value;
+                } else if (key == "size") {
+                    std::uint64_t v = 0;
+                    for (char c : value) {
+                        if (c < '0' || c > '9') {
+                            err = "Corrupt pax header";
+                            return false;
+                        }
+                        v = v * 10 + static_cast<std::uint64_t>(c - '0');
+                    }
+                    pendingSize_ = v;
+                    havePendingSize_ = true;
+                }
+            }
+            pos += recLen;
+        }
+    }
+    meta_.clear();
+    state_ = padding_ ? State::Padding : State::Header;
+    return true;
+}
+
+bool TarReader::finishMember() {
+    if (deliver_ && cb_.onEntryEnd && !cb_.onEntryEnd())
+        return false;
+    deliver_ = false;
+    state_ = padding_ ? State::Padding : State::Header;
+    return true;
+}
+
+} // namespace openscp
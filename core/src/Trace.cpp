@@ -0,0 +1,266 @@
+// Per-thread trace rings and their Chrome trace_event export.
+#include "openscp/Trace.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace openscp {
+namespace detail {
+std::atomic<bool> g_traceEnabled{false};
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct TraceEvent {
+    const char *name = nullptr;
+    const char *category = nullptr;
+    const char *argName = nullptr;
+    std::int64_t ts = 0;  // us since the trace epoch
+    std::int64_t dur = 0; // -1 for instants
+    std::uint64_t arg = 0;
+};
+
+// One recording thread. Its own thread is the only writer; the mutex is
+// uncontended except while a dump copies the ring.
+struct ThreadTrace {
+    std::mutex m;
+    std::vector<TraceEvent> ring;
+    std::size_t next = 0;
+    bool wrapped = false;
+    std::uint32_t tid = 0;
+    std::string name;
+    bool retired = false; // its thread has exited
+};
+
+// Rings of exited threads kept for the dump; older ones are dropped.
+constexpr std::size_t kMaxRetiredThreads = 32;
+
+struct TraceRegistry {
+    std::mutex m;
+    std::vector<std::shared_ptr<ThreadTrace>> threads;
+    std::uint32_t nextTid = 1;
+    std::string outputPath;
+};
+
+const Clock::time_point g_traceEpoch = Clock::now();
+
+TraceRegistry &registry() {
+    static TraceRegistry *r = [] {
+        auto *reg = new TraceRegistry; // never destroyed: threads may outlive
+        if (const char *p = std::getenv("OPENSCP_TRACE"); p && *p) {
+            reg->outputPath = p;
+            detail::g_traceEnabled.store(true);
+        }
+        return reg;
+    }();
+    return *r;
+}
+
+// Evaluated at load time so OPENSCP_TRACE takes effect before any span.
+const bool g_traceEnvRead = (registry(), true);
+
+// Shared with the registry so the events survive the thread.
+struct ThreadTraceHandle {
+    std::shared_ptr<ThreadTrace> trace;
+    ~ThreadTraceHandle() {
+        std::lock_guard<std::mutex> lk(trace->m);
+        trace->retired = true;
+    }
+};
+
+std::shared_ptr<ThreadTrace> registerThread() {
+    auto t = std::make_shared<ThreadTrace>();
+    t->ring.resize(kTraceEventsPerThread);
+    TraceRegistry &r = registry();
+    std::lock_guard<std::mutex> lk(r.m);
+    t->tid = r.nextTid++;
+    std::size_t retired = 0;
+    for (const auto &other : r.threads) {
+        std::lock_guard<std::mutex> olk(other->m);
+        retired += other->retired ? 1 : 0;
+    }
+    for (auto it = r.threads.begin();
+         it != r.threads.end() && retired > kMaxRetiredThreads;) {
+        bool drop = false;
+        {
+            std::lock_guard<std::mutex> olk((*it)->m);
+            drop = (*it)->retired;
+        }
+        if (drop) {
+            it = r.threads.erase(it);
+            --retired;
+        } else {
+            ++it;
+        }
+    }
+    r.threads.push_back(t);
+    return t;
+}
+
+ThreadTrace &threadTrace() {
+    thread_local ThreadTraceHandle self{registerThread()};
+    return *self.trace;
+}
+
+void push(const TraceEvent &e) {
+    ThreadTrace &t = threadTrace();
+    std::lock_guard<std::mutex> lk(t.m);
+    t.ring[t.next] = e;
+    if (++t.next == t.ring.size()) {
+        t.next = 0;
+        t.wrapped = true;
+    }
+}
+
+void appendJsonString(std::ostringstream &out, const std::string &s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out << buf;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+void setTraceEnabled(bool on) {
+    (void)registry();
+    detail::g_traceEnabled.store(on);
+}
+
+const std::string &traceOutputPath() { return registry().outputPath; }
+
+void setTraceThreadName(const std::string &name) {
+    if (!traceEnabled())
+        return;
+    ThreadTrace &t = threadTrace();
+    std::lock_guard<std::mutex> lk(t.m);
+    t.name = name;
+}
+
+void traceInstant(const char *name, const char *category) {
+    if (!traceEnabled())
+        return;
+    TraceEvent e;
+    e.name = name;
+    e.category = category;
+    e.ts = TraceSpan::nowUs();
+    e.dur = -1;
+    push(e);
+}
+
+std::int64_t TraceSpan::nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               Clock::now() - g_traceEpoch)
+        .count();
+}
+
+void TraceSpan::record() {
+    TraceEvent e;
+    e.name = name_;
+    e.category = category_;
+    e.argName = argName_;
+    e.arg = arg_;
+    e.ts = startUs_;
+    e.dur = nowUs() - startUs_;
+    push(e);
+}
+
+std::string chromeTraceJson() {
+    std::vector<std::shared_ptr<ThreadTrace>> threads;
+    {
+        TraceRegistry &r = registry();
+        std::lock_guard<std::mutex> lk(r.m);
+        threads = r.threads;
+    }
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto sep = [&] {
+        if (!first)
+            out << ",\n";
+        first = false;
+    };
+    for (const auto &t : threads) {
+        std::vector<TraceEvent> events;
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lk(t->m);
+            if (t->wrapped)
+                events.assign(t->ring.begin() + t->next, t->ring.end());
+            events.insert(events.end(), t->ring.begin(),
+                          t->ring.begin() + t->next);
+            name = t->name;
+        }
+        if (!name.empty()) {
+            sep();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+                   "\"tid\":"
+                << t->tid << ",\"args\":{\"name\":";
+            appendJsonString(out, name);
+            out << "}}";
+        }
+        for (const TraceEvent &e : events) {
+            sep();
+            out << "{\"name\":";
+            appendJsonString(out, e.name ? e.name : "?");
+            out << ",\"cat\":";
+            appendJsonString(out, e.category ? e.category : "");
+            if (e.dur < 0)
+                out << ",\"ph\":\"i\",\"s\":\"t\"";
+            else
+                out << ",\"ph\":\"X\",\"dur\":" << e.dur;
+            out << ",\"ts\":" << e.ts << ",\"pid\":1,\"tid\":" << t->tid;
+            if (e.argName) {
+                out << ",\"args\":{";
+                appendJsonString(out, e.argName);
+                out << ':' << e.arg << '}';
+            }
+            out << '}';
+        }
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+bool writeChromeTrace(const std::string &path, std::string &err) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << chromeTraceJson();
+    out.close();
+    if (!out) {
+        err = "Could not write trace to " + path;
+        return false;
+    }
+    return true;
+}
+
+void clearTrace() {
+    std::vector<std::shared_ptr<ThreadTrace>> threads;
+    {
+        TraceRegistry &r = registry();
+        std::lock_guard<std::mutex> lk(r.m);
+        threads = r.threads;
+    }
+    for (const auto &t : threads) {
+        std::lock_guard<std::mutex> lk(t->m);
+        t->next = 0;
+        t->wrapped = false;
+    }
+}
+
+} // namespace openscp
@@ -0,0 +1,431 @@
+// Append-only transfer queue journal with compaction.
+#include "openscp/TransferJournal.hpp"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <io.h>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace openscp {
+
+namespace {
+
+constexpr char kMagic[8] = {'O', 'S', 'C', 'P', 'J', 'R', 'N', 'L'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kByteOrderMark = 0x01020304u;
+constexpr std::size_t kHeaderBytes = sizeof(kMagic) + 4 + 4;
+// Records larger than this are treated as corruption.
+constexpr std::uint32_t kMaxRecordBytes = 256u * 1024 * 1024;
+// Compact once the log holds this many records and 4x the live tasks.
+constexpr std::size_t kCompactMinRecords = 4096;
+
+enum class RecordKind : std::uint8_t { Put = 1, State = 2, Remove = 3 };
+
+constexpr std::array<std::uint32_t, 256> makeCrcTable() {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[i] = c;
+    }
+    return table;
+}
+constexpr auto kCrcTable = makeCrcTable();
+
+std::uint32_t crc32(const char *data, std::size_t len) {
+    std::uint32_t c = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < len; ++i)
+        c = kCrcTable[(c ^ static_cast<std::uint8_t>(data[i])) & 0xFF] ^
+            (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+template <typename T> void putRaw(std::string &out, T v) {
+    out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+void putString(std::string &out, const std::string &s) {
+    putRaw(out, static_cast<std::uint32_t>(s.size()));
+    out.append(s);
+}
+
+// Cursor over one record payload; any overrun marks it bad.
+struct Reader {
+    const char *p;
+    const char *end;
+    bool ok = true;
+
+    template <typename T> T raw() {
+        T v{};
+        if (static_cast<std::size_t>(end - p) < sizeof(T)) {
+            ok = false;
+            return v;
+        }
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+    std::string str() {
+        const auto n = raw<std::uint32_t>();
+        if (!ok || static_cast<std::size_t>(end - p) < n) {
+            ok = false;
+            return {};
+        }
+        std::string s(p, n);
+        p += n;
+        return s;
+    }
+};
+
+// Frame `payload` as a record: length, CRC-32, payload.
+void appendRecord(std::string &out, const std::string &payload) {
+    putRaw(out, static_cast<std::uint32_t>(payload.size()));
+    putRaw(out, crc32(payload.data(), payload.size()));
+    out.append(payload);
+}
+
+std::string encodePut(const JournalTask &t) {
+    std::string p;
+    putRaw(p, RecordKind::Put);
+    putRaw(p, t.id);
+    putRaw(p, static_cast<std::uint8_t>(t.upload));
+    putRaw(p, t.state);
+    putRaw(p, static_cast<std::uint8_t>(t.priority));
+    putRaw(p, static_cast<std::uint8_t>(t.replaceExisting));
+    putRaw(p, t.sizeHint);
+    putString(p, t.session);
+    putString(p, t.src);
+    putString(p, t.dst);
+    putRaw(p, static_cast<std::uint8_t>(t.batchFiles != nullptr));
+    if (t.batchFiles) {
+        putRaw(p, t.batchTotalBytes);
+        putRaw(p, static_cast<std::uint32_t>(t.batchFiles->size()));
+        for (const auto &f : *t.batchFiles)
+            putString(p, f);
+    }
+    return p;
+}
+
+bool decodePut(Reader &r, JournalTask &t) {
+    t.id = r.raw<std::uint64_t>();
+    t.upload = r.raw<std::uint8_t>() != 0;
+    t.state = static_cast<JournalTaskState>(r.raw<std::uint8_t>());
+    t.priority = static_cast<TransferPriority>(r.raw<std::uint8_t>());
+    t.replaceExisting = r.raw<std::uint8_t>() != 0;
+    t.sizeHint = r.raw<std::uint64_t>();
+    t.session = r.str();
+    t.src = r.str();
+    t.dst = r.str();
+    if (r.raw<std::uint8_t>() && r.ok) {
+        t.batchTotalBytes = r.raw<std::uint64_t>();
+        const auto n = r.raw<std::uint32_t>();
+        auto files = std::make_shared<std::vector<std::string>>();
+        for (std::uint32_t i = 0; r.ok && i < n; ++i)
+            files->push_back(r.str());
+        t.batchFiles = std::move(files);
+    }
+    return r.ok;
+}
+
+bool writeAll(std::FILE *f, const std::string &data) {
+    return data.empty() ||
+           std::fwrite(data.data(), 1, data.size(), f) == data.size();
+}
+
+bool syncFile(std::FILE *f) {
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return ::fsync(fileno(f)) == 0;
+#endif
+}
+
+} // namespace
+
+TransferJournal::~TransferJournal() { close(); }
+
+void TransferJournal::close() {
+    if (f_) {
+        std::string err;
+        (void)flush(err);
+        std::fclose(f_);
+        f_ = nullptr;
+    }
+    unlock();
+}
+
+bool TransferJournal::lock(std::string &err) {
+    const std::string lockPath = file_ + ".lock";
+#ifdef _WIN32
+    HANDLE h = CreateFileA(lockPath.c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE |
+                               FILE_SHARE_DELETE,
+                           NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        err = "Could not open transfer journal lock " + lockPath;
+        return false;
+    }
+    OVERLAPPED ov{};
+    if (!LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0,
+                    MAXDWORD, MAXDWORD, &ov)) {
+        lockedElsewhere_ = GetLastError() == ERROR_LOCK_VIOLATION;
+        CloseHandle(h);
+        err = lockedElsewhere_
+                  ? "Transfer journal is in use by another instance"
+                  : "Could not lock transfer journal " + file_;
+        return false;
+    }
+    lockHandle_ = h;
+#else
+    const int fd =
+        ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        err = "Could not open transfer journal lock " + lockPath;
+        return false;
+    }
+    int rc = 0;
+    while ((rc = ::flock(fd, LOCK_EX | LOCK_NB)) != 0 && errno == EINTR) {
+    }
+    if (rc != 0) {
+        lockedElsewhere_ = errno == EWOULDBLOCK;
+        ::close(fd);
+        err = lockedElsewhere_
+                  ? "Transfer journal is in use by another instance"
+                  : "Could not lock transfer journal " + file_;
+        return false;
+    }
+    lockFd_ = fd;
+#endif
+    return true;
+}
+
+void TransferJournal::unlock() {
+#ifdef _WIN32
+    if (lockHandle_) {
+        OVERLAPPED ov{};
+        (void)UnlockFileEx(lockHandle_, 0, MAXDWORD, MAXDWORD, &ov);
+        CloseHandle(lockHandle_);
+        lockHandle_ = nullptr;
+    }
+#else
+    if (lockFd_ >= 0) {
+        (void)::flock(lockFd_, LOCK_UN);
+        ::close(lockFd_);
+        lockFd_ = -1;
+    }
+#endif
+}
+
+bool TransferJournal::open(const std::string &file,
+                           std::vector<JournalTask> &tasks,
+                           std::string &err) {
+    close();
+    file_ = file;
+    tasks.clear();
+    pending_.clear();
+    live_ = 0;
+    records_ = 0;
+    lockedElsewhere_ = false;
+    if (!lock(err))
+        return false;
+
+    std::string data;
+    if (std::FILE *in = std::fopen(file.c_str(), "rb")) {
+        char buf[1 << 16];
+        std::size_t n = 0;
+        while ((n = std::fread(buf, 1, sizeof(buf), in)) > 0)
+            data.append(buf, n);
+        std::fclose(in);
+    }
+
+    if (!data.empty()) {
+        std::uint32_t version = 0, bom = 0;
+        if (data.size() >= kHeaderBytes) {
+            std::memcpy(&version, data.data() + sizeof(kMagic), 4);
+            std::memcpy(&bom, data.data() + sizeof(kMagic) + 4, 4);
+        }
+        if (data.size() < kHeaderBytes ||
+            std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0 ||
+            version != kVersion || bom != kByteOrderMark) {
+            err = "Transfer journal is corrupt (bad header)";
+            return false;
+        }
+
+        std::vector<JournalTask> order;
+        std::unordered_map<std::uint64_t, std::size_t> byId;
+        std::vector<bool> removed;
+        const char *p = data.data() + kHeaderBytes;
+        const char *end = data.data() + data.size();
+        std::size_t records = 0;
+        while (end - p >= 8) {
+            std::uint32_t len = 0, crc = 0;
+            std::memcpy(&len, p, 4);
+            std::memcpy(&crc, p + 4, 4);
+            if (len == 0 || len > kMaxRecordBytes ||
+                static_cast<std::size_t>(end - p - 8) < len ||
+                crc32(p + 8, len) != crc)
+                break; // torn or corrupt tail: keep what came before
+            Reader r{p + 8, p + 8 + len};
+            const auto kind = r.raw<RecordKind>();
+            if (kind == RecordKind::Put) {
+                JournalTask t;
+                if (!decodePut(r, t))
+                    break;
+                byId[t.id] = order.size();
+                order.push_back(std::move(t));
+                removed.push_back(false);
+            } else if (kind == RecordKind::State) {
+                const auto id = r.raw<std::uint64_t>();
+                const auto state = r.raw<JournalTaskState>();
+                const auto prio = r.raw<std::uint8_t>();
+                if (!r.ok)
+                    break;
+                auto it = byId.find(id);
+                if (it != byId.end()) {
+                    order[it->second].state = state;
+                    order[it->second].priority =
+                        static_cast<TransferPriority>(prio);
+                }
+            } else if (kind == RecordKind::Remove) {
+                const auto id = r.raw<std::uint64_t>();
+                if (!r.ok)
+                    break;
+                auto it = byId.find(id);
+                if (it != byId.end()) {
+                    removed[it->second] = true;
+                    byId.erase(it);
+                }
+            } else {
+                break;
+            }
+            ++records;
+            p += 8 + len;
+        }
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            if (!removed[i])
+                tasks.push_back(std::move(order[i]));
+        }
+        records_ = records;
+        live_ = tasks.size();
+        // A clean log of exactly the live tasks can be appended to as is.
+        if (p == end && records_ == live_)
+            return reopenForAppend(err);
+    }
+    return compact(tasks, err);
+}
+
+bool TransferJournal::reopenForAppend(std::string &err) {
+    f_ = std::fopen(file_.c_str(), "ab");
+    if (!f_) {
+        err = "Could not open transfer journal " + file_;
+        return false;
+    }
+    return true;
+}
+
+void TransferJournal::put(const JournalTask &task) {
+    appendRecord(pending_, encodePut(task));
+    ++records_;
+    ++live_;
+}
+
+void TransferJournal::setState(std::uint64_t id, JournalTaskState state,
+                               TransferPriority priority) {
+    std::string p;
+    putRaw(p, RecordKind::State);
+    putRaw(p, id);
+    putRaw(p, state);
+    putRaw(p, static_cast<std::uint8_t>(priority));
+    appendRecord(pending_, p);
+    ++records_;
+}
+
+void TransferJournal::remove(std::uint64_t id) {
+    std::string p;
+    putRaw(p, RecordKind::Remove);
+    putRaw(p, id);
+    appendRecord(pending_, p);
+    ++records_;
+    if (live_ > 0)
+        --live_;
+}
+
+bool TransferJournal::flush(std::string &err) {
+    if (pending_.empty())
+        return true;
+    if (!f_) {
+        err = "Transfer journal is not open";
+        return false;
+    }
+    const bool ok = writeAll(f_, pending_) && std::fflush(f_) == 0;
+    pending_.clear();
+    if (!ok) {
+        err = "Could not write transfer journal " + file_;
+        return false;
+    }
+    return true;
+}
+
+bool TransferJournal::needsCompaction() const {
+    return records_ >= kCompactMinRecords && records_ > 4 * live_;
+}
+
+bool TransferJournal::compact(const std::vector<JournalTask> &live,
+                              std::string &err) {
+    // Snapshot to a sibling, fsync, then rename over the log: a crash at
+    // any point leaves either the old log or the complete snapshot.
+    std::string data(kMagic, sizeof(kMagic));
+    putRaw(data, kVersion);
+    putRaw(data, kByteOrderMark);
+    for (const auto &t : live)
+        appendRecord(data, encodePut(t));
+
+    const std::string tmp = file_ + ".tmp";
+    std::FILE *out = std::fopen(tmp.c_str(), "wb");
+    if (!out) {
+        err = "Could not write transfer journal " + tmp;
+        return false;
+    }
+    bool ok = writeAll(out, data) && std::fflush(out) == 0 && syncFile(out);
+    ok = (std::fclose(out) == 0) && ok;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        err = "Could not write transfer journal " + tmp;
+        return false;
+    }
+
+    if (f_) {
+        std::fclose(f_);
+        f_ = nullptr;
+    }
+    pending_.clear();
+    std::error_code ec;
+    std::filesystem::rename(tmp, file_, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        std::string ignored;
+        (void)reopenForAppend(ignored);
+        err = "Could not replace transfer journal " + file_;
+        return false;
+    }
+    records_ = live.size();
+    live_ = live.size();
+    return reopenForAppend(err);
+}
+
+} // namespace openscp
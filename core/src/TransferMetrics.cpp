@@ -0,0 +1,533 @@
+// Transfer telemetry histograms and their Prometheus/JSON exports.
+#include "openscp/TransferMetrics.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <sstream>
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace openscp {
+namespace {
+
+constexpr std::size_t kLinearLimit = 2 * LatencyHistogram::kSubBuckets;
+// Prometheus buckets: 2^k microseconds for these k.
+constexpr int kPromFirstShift = 4;
+constexpr int kPromLastShift = 36;
+constexpr int kPromShiftStep = 2;
+static_assert((kPromLastShift - kPromFirstShift) / kPromShiftStep + 1 ==
+              TransferMetrics::kPromBoundCount);
+
+std::uint64_t promBound(std::size_t i) {
+    return std::uint64_t{1}
+           << (kPromFirstShift + static_cast<int>(i) * kPromShiftStep);
+}
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+constexpr const char *kQuantileKeys[] = {"p50", "p90", "p99", "p999"};
+
+int highestBit(std::uint64_t v) {
+    int bit = 0;
+    while (v >>= 1)
+        ++bit;
+    return bit;
+}
+
+bool containsAny(const std::string &haystack,
+                 std::initializer_list<const char *> needles) {
+    for (const char *n : needles) {
+        if (haystack.find(n) != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
+std::string escapeLabel(const std::string &v) {
+    std::string out;
+    out.reserve(v.size());
+    for (char c : v) {
+        if (c == '\\' || c == '"')
+            out += '\\';
+        if (c == '\n') {
+            out += "\\n";
+            continue;
+        }
+        out += c;
+    }
+    return out;
+}
+
+std::string escapeJson(const std::string &v) {
+    std::string out;
+    out.reserve(v.size());
+    for (char c : v) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out;
+}
+
+std::string formatSeconds(double seconds) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", seconds);
+    return buf;
+}
+
+#ifndef _WIN32
+bool sendToSocket(const std::string &path, const std::string &data,
+                  std::string &err) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        err = "Metrics socket path is too long: " + path;
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        err = std::string("Could not create metrics socket: ") +
+              std::strerror(errno);
+        return false;
+    }
+#if defined(SO_NOSIGPIPE)
+    const int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&addr),
+                  sizeof(addr)) != 0) {
+        err = "Could not connect to metrics socket " + path + ": " +
+              std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t n =
+            ::send(fd, data.data() + sent, data.size() - sent, flags);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            err = std::string("Metrics socket write failed: ") +
+                  std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    ::close(fd);
+    return true;
+}
+#endif
+
+} // namespace
+
+std::size_t LatencyHistogram::bucketIndex(std::uint64_t value) {
+    if (value < kLinearLimit)
+        return static_cast<std::size_t>(value);
+    const int msb = highestBit(value); // >= 5
+    const int shift = msb - 4;
+    const std::uint64_t mantissa = value >> shift; // kSubBuckets..2x-1
+    return kLinearLimit + static_cast<std::size_t>(msb - 5) * kSubBuckets +
+           static_cast<std::size_t>(mantissa - kSubBuckets);
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(std::size_t index) {
+    if (index < kLinearLimit)
+        return index;
+    const std::size_t j = index - kLinearLimit;
+    const int shift = static_cast<int>(j / kSubBuckets) + 1;
+    const std::uint64_t mantissa = kSubBuckets + j % kSubBuckets;
+    if (shift + 5 > 63 && mantissa + 1 == 2 * kSubBuckets)
+        return UINT64_MAX; // the top bucket ends at the end of the range
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t value, std::uint64_t count) {
+    if (count == 0)
+        return;
+    buckets_[bucketIndex(value)] += count;
+    count_ += count;
+    sum_ += value * count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    if (other.count_ == 0)
+        return;
+    for (std::size_t i = 0; i < kBucketCount; ++i)
+        buckets_[i] += other.buckets_[i];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+std::uint64_t LatencyHistogram::valueAtQuantile(double q) const {
+    if (count_ == 0)
+        return 0;
+    q = std::clamp(q, 0.0, 1.0);
+    const std::uint64_t rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::ceil(q * double(count_))));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank)
+            return std::min(bucketUpperBound(i), max_);
+    }
+    return max_;
+}
+
+const char *transferPhaseName(TransferPhase phase) {
+    switch (phase) {
+    case TransferPhase::Connect:
+        return "connect";
+    case TransferPhase::Precheck:
+        return "precheck";
+    case TransferPhase::Open:
+        return "open";
+    case TransferPhase::Transfer:
+        return "transfer";
+    case TransferPhase::Integrity:
+        return "integrity";
+    case TransferPhase::Finalize:
+        return "finalize";
+    }
+    return "unknown";
+}
+
+const char *transferErrorClassName(TransferErrorClass cls) {
+    switch (cls) {
+    case TransferErrorClass::Network:
+        return "network";
+    case TransferErrorClass::Auth:
+        return "auth";
+    case TransferErrorClass::Permission:
+        return "permission";
+    case TransferErrorClass::NotFound:
+        return "not_found";
+    case TransferErrorClass::Space:
+        return "space";
+    case TransferErrorClass::Integrity:
+        return "integrity";
+    case TransferErrorClass::LocalIo:
+        return "local_io";
+    case TransferErrorClass::Other:
+        return "other";
+    }
+    return "other";
+}
+
+const char *protocolMetricLabel(Protocol protocol) {
+    switch (protocol) {
+    case Protocol::Sftp:
+        return "sftp";
+    case Protocol::Scp:
+        return "scp";
+    case Protocol::Ftp:
+        return "ftp";
+    case Protocol::Ftps:
+        return "ftps";
+    case Protocol::WebDav:
+        return "webdav";
+    }
+    return "unknown";
+}
+
+TransferErrorClass classifyTransferError(const std::string &err) {
+    std::string lower = err;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    // Most specific first: "integrity" messages often also mention files.
+    if (containsAny(lower, {"checksum", "integrity", "prefix does not match"}))
+        return TransferErrorClass::Integrity;
+    if (containsAny(lower, {"auth", "password", "publickey", "host key",
+                            "login"}))
+        return TransferErrorClass::Auth;
+    if (containsAny(lower, {"permission", "denied", "not permitted",
+                            "read-only", "forbidden"}))
+        return TransferErrorClass::Permission;
+    if (containsAny(lower, {"no space", "quota", "disk full", "enospc"}))
+        return TransferErrorClass::Space;
+    if (containsAny(lower, {"no such", "not found", "does not exist",
+                            "missing"}))
+        return TransferErrorClass::NotFound;
+    if (containsAny(lower, {"local", "open local", "write local"}))
+        return TransferErrorClass::LocalIo;
+    if (containsAny(lower, {"connect", "connection", "timeout", "timed out",
+                            "socket", "network", "resolve", "eof",
+                            "disconnect", "interrupted", "channel"}))
+        return TransferErrorClass::Network;
+    return TransferErrorClass::Other;
+}
+
+void TransferMetrics::setInstance(const std::string &instance) {
+    std::lock_guard<std::mutex> lk(m_);
+    instance_ = instance;
+}
+
+void TransferMetrics::recordPhase(const std::string &backend,
+                                  TransferPhase phase,
+                                  std::chrono::microseconds elapsed) {
+    const auto us =
+        static_cast<std::uint64_t>(std::max<std::int64_t>(0, elapsed.count()));
+    std::size_t le = 0;
+    while (le < kPromBoundCount && us > promBound(le))
+        ++le;
+    std::lock_guard<std::mutex> lk(m_);
+    Backend &b = backends_[backend];
+    b.phases[static_cast<std::size_t>(phase)].record(us);
+    ++b.promBuckets[static_cast<std::size_t>(phase)][le];
+}
+
+void TransferMetrics::addBytes(const std::string &backend,
+                               TransferDirection dir, std::uint64_t bytes) {
+    std::lock_guard<std::mutex> lk(m_);
+    Backend &b = backends_[backend];
+    (dir == TransferDirection::Upload ? b.bytes_up : b.bytes_down) += bytes;
+}
+
+void TransferMetrics::recordError(const std::string &backend,
+                                  TransferErrorClass cls) {
+    std::lock_guard<std::mutex> lk(m_);
+    ++backends_[backend].errors[cls];
+}
+
+void TransferMetrics::recordTask(const std::string &backend, bool ok) {
+    std::lock_guard<std::mutex> lk(m_);
+    Backend &b = backends_[backend];
+    ++(ok ? b.tasks_ok : b.tasks_failed);
+}
+
+void TransferMetrics::reset() {
+    std::lock_guard<std::mutex> lk(m_);
+    backends_.clear();
+}
+
+LatencyHistogram TransferMetrics::phase(const std::string &backend,
+                                        TransferPhase phase) const {
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = backends_.find(backend);
+    if (it == backends_.end())
+        return {};
+    return it->second.phases[static_cast<std::size_t>(phase)];
+}
+
+std::uint64_t TransferMetrics::bytes(const std::string &backend,
+                                     TransferDirection dir) const {
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = backends_.find(backend);
+    if (it == backends_.end())
+        return 0;
+    return dir == TransferDirection::Upload ? it->second.bytes_up
+                                            : it->second.bytes_down;
+}
+
+std::uint64_t TransferMetrics::errors(const std::string &backend,
+                                      TransferErrorClass cls) const {
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = backends_.find(backend);
+    if (it == backends_.end())
+        return 0;
+    auto e = it->second.errors.find(cls);
+    return e == it->second.errors.end() ? 0 : e->second;
+}
+
+std::string TransferMetrics::exportPrometheus() const {
+    std::lock_guard<std::mutex> lk(m_);
+    const std::string inst =
+        instance_.empty() ? "" : ",instance=\"" + escapeLabel(instance_) + "\"";
+    std::ostringstream out;
+
+    out << "# HELP openscp_transfer_phase_seconds Duration of transfer task "
+           "phases.\n"
+        << "# TYPE openscp_transfer_phase_seconds histogram\n";
+    for (const auto &[name, b] : backends_) {
+        for (std::size_t p = 0; p < kTransferPhaseCount; ++p) {
+            const LatencyHistogram &h = b.phases[p];
+            if (h.count() == 0)
+                continue;
+            const std::string labels =
+                "backend=\"" + escapeLabel(name) + "\",phase=\"" +
+                transferPhaseName(static_cast<TransferPhase>(p)) + "\"" + inst;
+            std::uint64_t cumulative = 0;
+            for (std::size_t i = 0; i < kPromBoundCount; ++i) {
+                cumulative += b.promBuckets[p][i];
+                out << "openscp_transfer_phase_seconds_bucket{" << labels
+                    << ",le=\"" << formatSeconds(double(promBound(i)) / 1e6)
+                    << "\"} " << cumulative << "\n";
+            }
+            out << "openscp_transfer_phase_seconds_bucket{" << labels
+                << ",le=\"+Inf\"} " << h.count() << "\n"
+                << "openscp_transfer_phase_seconds_sum{" << labels << "} "
+                << formatSeconds(double(h.sum()) / 1e6) << "\n"
+                << "openscp_transfer_phase_seconds_count{" << labels << "} "
+                << h.count() << "\n";
+        }
+    }
+
+    out << "# HELP openscp_transfer_bytes_total Payload bytes moved.\n"
+        << "# TYPE openscp_transfer_bytes_total counter\n";
+    for (const auto &[name, b] : backends_) {
+        const std::string labels = "backend=\"" + escapeLabel(name) + "\"";
+        out << "openscp_transfer_bytes_total{" << labels
+            << ",direction=\"upload\"" << inst << "} " << b.bytes_up << "\n"
+            << "openscp_transfer_bytes_total{" << labels
+            << ",direction=\"download\"" << inst << "} " << b.bytes_down
+            << "\n";
+    }
+
+    out << "# HELP openscp_transfer_errors_total Failed transfer tasks by "
+           "error class.\n"
+        << "# TYPE openscp_transfer_errors_total counter\n";
+    for (const auto &[name, b] : backends_) {
+        for (const auto &[cls, n] : b.errors) {
+            out << "openscp_transfer_errors_total{backend=\""
+                << escapeLabel(name) << "\",class=\""
+                << transferErrorClassName(cls) << "\"" << inst << "} " << n
+                << "\n";
+        }
+    }
+
+    out << "# HELP openscp_transfer_tasks_total Finished transfer tasks.\n"
+        << "# TYPE openscp_transfer_tasks_total counter\n";
+    for (const auto &[name, b] : backends_) {
+        const std::string labels = "backend=\"" + escapeLabel(name) + "\"";
+        out << "openscp_transfer_tasks_total{" << labels
+            << ",result=\"ok\"" << inst << "} " << b.tasks_ok << "\n"
+            << "openscp_transfer_tasks_total{" << labels
+            << ",result=\"failed\"" << inst << "} " << b.tasks_failed
+            << "\n";
+    }
+    return out.str();
+}
+
+std::string TransferMetrics::exportJsonLines(std::int64_t timestampMs) const {
+    std::lock_guard<std::mutex> lk(m_);
+    std::ostringstream out;
+    const std::string inst =
+        instance_.empty() ? ""
+                          : ",\"instance\":\"" + escapeJson(instance_) + "\"";
+    for (const auto &[name, b] : backends_) {
+        const std::string head = "{\"ts\":" + std::to_string(timestampMs) +
+                                 inst + ",\"backend\":\"" + escapeJson(name) +
+                                 "\"";
+        for (std::size_t p = 0; p < kTransferPhaseCount; ++p) {
+            const LatencyHistogram &h = b.phases[p];
+            if (h.count() == 0)
+                continue;
+            out << head << ",\"metric\":\"phase_us\",\"phase\":\""
+                << transferPhaseName(static_cast<TransferPhase>(p))
+                << "\",\"count\":" << h.count() << ",\"sum\":" << h.sum()
+                << ",\"min\":" << h.min() << ",\"max\":" << h.max();
+            for (std::size_t q = 0; q < std::size(kQuantiles); ++q)
+                out << ",\"" << kQuantileKeys[q]
+                    << "\":" << h.valueAtQuantile(kQuantiles[q]);
+            out << "}\n";
+        }
+        out << head << ",\"metric\":\"bytes\",\"upload\":" << b.bytes_up
+            << ",\"download\":" << b.bytes_down << "}\n";
+        out << head << ",\"metric\":\"tasks\",\"ok\":" << b.tasks_ok
+            << ",\"failed\":" << b.tasks_failed << "}\n";
+        if (!b.errors.empty()) {
+            out << head << ",\"metric\":\"errors\"";
+            for (const auto &[cls, n] : b.errors)
+                out << ",\"" << transferErrorClassName(cls) << "\":" << n;
+            out << "}\n";
+        }
+    }
+    return out.str();
+}
+
+bool TransferMetrics::exportTo(const std::string &target, MetricsFormat format,
+                               std::int64_t timestampMs,
+                               std::string &err) const {
+    const std::string data = format == MetricsFormat::Prometheus
+                                 ? exportPrometheus()
+                                 : exportJsonLines(timestampMs);
+    static const std::string kUnixPrefix = "unix:";
+    if (target.compare(0, kUnixPrefix.size(), kUnixPrefix) == 0) {
+#ifndef _WIN32
+        return sendToSocket(target.substr(kUnixPrefix.size()), data, err);
+#else
+        err = "Metrics sockets are not supported on this platform";
+        return false;
+#endif
+    }
+    if (target.empty()) {
+        err = "No metrics export target";
+        return false;
+    }
+    if (format == MetricsFormat::JsonLines) {
+        std::error_code ec;
+        if (std::filesystem::file_size(target, ec) >= kJsonLinesMaxBytes &&
+            !ec) {
+            std::filesystem::rename(target, target + ".1", ec);
+            if (ec) {
+                err = "Could not rotate " + target;
+                return false;
+            }
+        }
+        std::ofstream out(target, std::ios::binary | std::ios::app);
+        out << data;
+        if (!out) {
+            err = "Could not append metrics to " + target;
+            return false;
+        }
+        return true;
+    }
+    // Write-then-rename, so a collector never reads half a snapshot.
+    const std::string tmp = target + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out << data;
+        out.close();
+        if (!out) {
+            err = "Could not write metrics to " + tmp;
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, target, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        err = "Could not replace " + target;
+        return false;
+    }
+    return true;
+}
+
+} // namespace openscp
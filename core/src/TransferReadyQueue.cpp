@@ -0,0 +1,98 @@
+// Priority-ordered ready queue for the transfer scheduler.
+#include "openscp/TransferReadyQueue.hpp"
+
+namespace openscp {
+
+const char *schedulingPolicyName(SchedulingPolicy policy) {
+    switch (policy) {
+    case SchedulingPolicy::Fifo:
+        return "fifo";
+    case SchedulingPolicy::ShortestFirst:
+        return "shortest-first";
+    case SchedulingPolicy::SmallFilesLane:
+        return "small-files-lane";
+    }
+    return "fifo";
+}
+
+void TransferReadyQueue::setPolicy(SchedulingPolicy policy) {
+    if (policy == policy_)
+        return;
+    policy_ = policy;
+    rebuild();
+}
+
+void TransferReadyQueue::setSmallFileThreshold(std::uint64_t bytes) {
+    if (bytes == smallThreshold_)
+        return;
+    smallThreshold_ = bytes;
+    rebuild();
+}
+
+TransferReadyQueue::Key TransferReadyQueue::keyFor(std::uint64_t id,
+                                                   const Entry &e) const {
+    // std::set is ascending: negate the priority so High comes first.
+    const int prio = -static_cast<int>(e.priority);
+    const std::uint64_t size =
+        (policy_ == SchedulingPolicy::ShortestFirst) ? e.size : 0;
+    return Key{prio, size, e.seq, id};
+}
+
+bool TransferReadyQueue::isLarge(std::uint64_t size) const {
+    return policy_ == SchedulingPolicy::SmallFilesLane &&
+           size > smallThreshold_;
+}
+
+void TransferReadyQueue::insert(std::uint64_t id, Entry e) {
+    e.large = isLarge(e.size);
+    (e.large ? large_ : small_).insert(keyFor(id, e));
+    entries_[id] = e;
+}
+
+void TransferReadyQueue::push(std::uint64_t id, TransferPriority priority,
+                              std::uint64_t size) {
+    remove(id);
+    insert(id, Entry{priority, size, nextSeq_++, false});
+}
+
+void TransferReadyQueue::remove(std::uint64_t id) {
+    auto it = entries_.find(id);
+    if (it == entries_.end())
+        return;
+    (it->second.large ? large_ : small_).erase(keyFor(id, it->second));
+    entries_.erase(it);
+}
+
+void TransferReadyQueue::clear() {
+    small_.clear();
+    large_.clear();
+    entries_.clear();
+}
+
+void TransferReadyQueue::rebuild() {
+    auto entries = std::move(entries_);
+    clear();
+    for (const auto &kv : entries)
+        insert(kv.first, kv.second);
+}
+
+std::optional<std::uint64_t> TransferReadyQueue::pop(int slots) {
+    const bool largeAllowed =
+        slots < 2 || runningLarge_.size() < static_cast<std::size_t>(slots - 1);
+    const std::set<Key> *from = nullptr;
+    if (!small_.empty())
+        from = &small_;
+    if (largeAllowed && !large_.empty() &&
+        (!from || *large_.begin() < *small_.begin()))
+        from = &large_;
+    if (!from)
+        return std::nullopt;
+
+    const std::uint64_t id = std::get<3>(*from->begin());
+    if (from == &large_)
+        runningLarge_.insert(id);
+    remove(id);
+    return id;
+}
+
+} // namespace openscp
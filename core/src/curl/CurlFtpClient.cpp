@@ -1,20 +1,26 @@
 // FTP/FTPS backend implementation based on libcurl.
 #include "openscp/CurlFtpClient.hpp"
 
+#include "CurlHandleCache.hpp"
+#include "openscp/LocalFileIO.hpp"
+
 #include <curl/curl.h>
 
 #include <algorithm>
 #include <cctype>
 #include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <filesystem>
+#include <iterator>
 #include <limits>
 #include <mutex>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace openscp {
 namespace {
@@ -324,18 +330,19 @@ size_t appendListingChunk(char *ptr, size_t size, size_t nmemb, void *userdata)
     return total;
 }
 
-bool runDirectoryListingCommand(const SessionOptions &opt,
+// Listing data goes to `sink` as it arrives.
+bool runDirectoryListingCommand(CurlHandleCache &handles,
+                                const SessionOptions &opt,
                                 const std::string &remotePath,
-                                const char *command, std::string &payload,
-                                std::string &err) {
-    payload.clear();
-    CURL *curl = curl_easy_init();
+                                const char *command, curl_write_callback sink,
+                                void *sinkData, std::string &err) {
+    CurlHandleCache::Lease lease(handles);
+    CURL *curl = lease.get();
     if (!curl) {
         err = "Could not create CURL handle.";
         return false;
     }
     if (!configureCommonCurlHandle(curl, opt, err)) {
-        curl_easy_cleanup(curl);
         return false;
     }
 
@@ -344,20 +351,17 @@ bool runDirectoryListingCommand(const SessionOptions &opt,
         (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) == CURLE_OK) &&
         (curl_easy_setopt(curl, CURLOPT_DIRLISTONLY, 0L) == CURLE_OK) &&
         (curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, command) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, appendListingChunk) ==
-         CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_WRITEDATA, &payload) == CURLE_OK);
+        (curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, sink) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_WRITEDATA, sinkData) == CURLE_OK);
     if (!configured) {
         err = std::string("Could not configure ") + protocolLabel(opt.protocol) +
               " listing command " + command + ".";
-        curl_easy_cleanup(curl);
         return false;
     }
 
-    const CURLcode rc = curl_easy_perform(curl);
+    const CURLcode rc = lease.perform();
     long responseCode = 0;
     (void)curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
-    curl_easy_cleanup(curl);
     if (rc != CURLE_OK) {
         err = std::string(protocolLabel(opt.protocol)) + " listing command " +
               command + " failed: " + curl_easy_strerror(rc);
@@ -462,24 +466,6 @@ bool parseMlsdLine(const std::string &raw, FileInfo &info, bool &emit) {
     return true;
 }
 
-bool parseMlsdListing(const std::string &payload, std::vector<FileInfo> &out) {
-    out.clear();
-    std::istringstream iss(payload);
-    std::string line;
-    while (std::getline(iss, line)) {
-        const std::string normalized = trimAscii(line);
-        if (normalized.empty())
-            continue;
-        FileInfo info{};
-        bool emit = false;
-        if (!parseMlsdLine(line, info, emit))
-            return false;
-        if (emit)
-            out.push_back(std::move(info));
-    }
-    return true;
-}
-
 bool parseUnixListLine(const std::string &line, FileInfo &info, bool &emit) {
     emit = false;
     std::istringstream iss(line);
@@ -552,62 +538,189 @@ bool parseDosListLine(const std::string &line, FileInfo &info, bool &emit) {
     return true;
 }
 
-bool parseListListing(const std::string &payload, std::vector<FileInfo> &out) {
-    out.clear();
-    std::istringstream iss(payload);
-    std::string line;
-    bool sawContent = false;
-    bool parsedAny = false;
-    bool sawUnparsedLine = false;
-    while (std::getline(iss, line)) {
-        const std::string normalized = trimAscii(line);
-        if (normalized.empty())
-            continue;
-        const std::string lowered = toLowerAscii(normalized);
-        if (lowered.rfind("total ", 0) == 0)
-            continue;
-        sawContent = true;
+// MLSD or LIST output parsed line by line while it downloads; entries are
+// handed to the caller every kListBatchSize lines.
+class FtpListingStream {
+    public:
+    FtpListingStream(bool mlsd, const SftpClient::ListBatchCB &onBatch)
+        : mlsd_(mlsd), onBatch_(onBatch) {}
+
+    // false stops the transfer (callback declined or unparsable MLSD).
+    bool feed(const char *data, std::size_t len) {
+        partial_.append(data, len);
+        std::size_t begin = 0;
+        for (;;) {
+            const std::size_t nl = partial_.find('\n', begin);
+            if (nl == std::string::npos)
+                break;
+            if (!line(partial_.substr(begin, nl - begin)))
+                return false;
+            begin = nl + 1;
+        }
+        partial_.erase(0, begin);
+        return true;
+    }
+
+    // Call after the transfer succeeded; true if the output was usable.
+    bool finish() {
+        if (!partial_.empty()) {
+            const std::string last = std::move(partial_);
+            partial_.clear();
+            if (!line(last))
+                return false;
+        }
+        if (!flush())
+            return false;
+        if (mlsd_ || !sawContent_)
+            return true;
+        return parsedAny_ || !sawUnparsedLine_;
+    }
+
+    bool stopped() const { return stopped_; }
+    // An MLSD line could not be parsed (the server did answer).
+    bool parseFailed() const { return parseFailed_; }
+    std::size_t emitted() const { return emitted_; }
 
+    private:
+    bool line(const std::string &raw) {
+        const std::string normalized = trimAscii(raw);
+        if (normalized.empty())
+            return true;
         FileInfo info{};
         bool emit = false;
-        bool ok = false;
-        if (normalized.front() == 'd' || normalized.front() == '-' ||
-            normalized.front() == 'l' || normalized.front() == 'c' ||
-            normalized.front() == 'b' || normalized.front() == 's' ||
-            normalized.front() == 'p') {
-            ok = parseUnixListLine(normalized, info, emit);
-        }
-        if (!ok)
-            ok = parseDosListLine(normalized, info, emit);
-        if (!ok) {
-            sawUnparsedLine = true;
-            continue;
-        }
-        if (emit) {
-            out.push_back(std::move(info));
-            parsedAny = true;
+        if (mlsd_) {
+            if (!parseMlsdLine(raw, info, emit)) {
+                parseFailed_ = true;
+                return false;
+            }
+        } else {
+            const std::string lowered = toLowerAscii(normalized);
+            if (lowered.rfind("total ", 0) == 0)
+                return true;
+            sawContent_ = true;
+            bool ok = false;
+            if (normalized.front() == 'd' || normalized.front() == '-' ||
+                normalized.front() == 'l' || normalized.front() == 'c' ||
+                normalized.front() == 'b' || normalized.front() == 's' ||
+                normalized.front() == 'p') {
+                ok = parseUnixListLine(normalized, info, emit);
+            }
+            if (!ok)
+                ok = parseDosListLine(normalized, info, emit);
+            if (!ok) {
+                sawUnparsedLine_ = true;
+                return true;
+            }
+            if (emit)
+                parsedAny_ = true;
         }
+        if (!emit)
+            return true;
+        batch_.push_back(std::move(info));
+        return batch_.size() < SftpClient::kListBatchSize || flush();
     }
-    if (!sawContent)
+
+    bool flush() {
+        if (batch_.empty())
+            return true;
+        emitted_ += batch_.size();
+        if (!onBatch_(std::move(batch_))) {
+            stopped_ = true;
+            return false;
+        }
+        batch_.clear();
         return true;
-    return parsedAny || !sawUnparsedLine;
+    }
+
+    bool mlsd_;
+    const SftpClient::ListBatchCB &onBatch_;
+    std::string partial_; // incomplete trailing line
+    std::vector<FileInfo> batch_;
+    std::size_t emitted_ = 0;
+    bool stopped_ = false;
+    bool parseFailed_ = false;
+    bool sawContent_ = false;
+    bool parsedAny_ = false;
+    bool sawUnparsedLine_ = false;
+};
+
+size_t streamListingChunk(char *ptr, size_t size, size_t nmemb,
+                          void *userdata) {
+    auto *stream = static_cast<FtpListingStream *>(userdata);
+    if (!stream)
+        return 0;
+    const size_t total = size * nmemb;
+    return stream->feed(ptr, total) ? total : 0;
 }
 
+// Position in the local file of a running download/upload, shared with the
+// curl data callbacks. Streamed transfers set sink/source instead of a file.
+struct LocalFileCursor {
+    LocalFileReader *reader = nullptr;
+    LocalFileWriter *writer = nullptr;
+    const SftpClient::ReadSink *sink = nullptr;
+    const SftpClient::WriteSource *source = nullptr;
+    std::uint64_t offset = 0;
+    std::string err;
+};
+
 // cppcheck-suppress constParameterCallback
 size_t writeFileCallback(char *ptr, size_t size, size_t nmemb, void *userdata) {
-    if (!userdata)
-        return 0;
-    std::FILE *file = static_cast<std::FILE *>(userdata);
+    auto *cursor = static_cast<LocalFileCursor *>(userdata);
     const size_t total = size * nmemb;
-    return std::fwrite(ptr, 1, total, file);
+    if (cursor && cursor->sink) {
+        if (!(*cursor->sink)(ptr, total)) {
+            cursor->err = "Stream consumer stopped";
+            return 0;
+        }
+        cursor->offset += total;
+        return total;
+    }
+    if (!cursor || !cursor->writer)
+        return 0;
+    if (!cursor->writer->writeAt(cursor->offset, ptr, total, cursor->err))
+        return 0;
+    cursor->offset += total;
+    return total;
 }
 
 size_t readFileCallback(char *ptr, size_t size, size_t nmemb, void *userdata) {
-    if (!userdata)
-        return 0;
-    std::FILE *file = static_cast<std::FILE *>(userdata);
-    const size_t total = size * nmemb;
-    return std::fread(ptr, 1, total, file);
+    auto *cursor = static_cast<LocalFileCursor *>(userdata);
+    if (cursor && cursor->source) {
+        const std::ptrdiff_t got = (*cursor->source)(ptr, size * nmemb);
+        if (got < 0) {
+            cursor->err = "Stream source failed";
+            return CURL_READFUNC_ABORT;
+        }
+        cursor->offset += static_cast<std::uint64_t>(got);
+        return static_cast<size_t>(got);
+    }
+    if (!cursor || !cursor->reader)
+        return CURL_READFUNC_ABORT;
+    const char *data = nullptr;
+    size_t n = 0;
+    if (!cursor->reader->read(cursor->offset, size * nmemb, ptr, data, n,
+                              cursor->err))
+        return CURL_READFUNC_ABORT;
+    if (data != ptr)
+        std::memcpy(ptr, data, n); // mapped file: one copy into curl's buffer
+    cursor->offset += n;
+    return n;
+}
+
+// Larger curl buffers for file transfers (best effort; curl caps them and
+// older releases lack the upload option).
+void applyTransferBufferSizes(CURL *curl, const LocalIoOptions &io) {
+    (void)curl_easy_setopt(
+        curl, CURLOPT_BUFFERSIZE,
+        static_cast<long>(std::min<std::size_t>(io.buffer_size,
+                                                CURL_MAX_READ_SIZE)));
+#if LIBCURL_VERSION_NUM >= 0x073e00
+    (void)curl_easy_setopt(
+        curl, CURLOPT_UPLOAD_BUFFERSIZE,
+        static_cast<long>(std::min<std::size_t>(io.buffer_size,
+                                                2 * 1024 * 1024)));
+#endif
 }
 
 struct ProgressContext {
@@ -639,9 +752,206 @@ int transferProgressCallback(void *userdata, curl_off_t dltotal, curl_off_t dlno
     return 0;
 }
 
+// FEAT reply: "211-Features:", one " NAME args" line each, "211 End".
+CurlFtpClient::Features parseFeatReply(const std::string &reply) {
+    CurlFtpClient::Features features{};
+    std::istringstream iss(reply);
+    std::string line;
+    bool inFeat = false;
+    while (std::getline(iss, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.rfind("211-", 0) == 0) {
+            inFeat = true;
+            features.known = true;
+            continue;
+        }
+        if (line.rfind("211 ", 0) == 0) {
+            features.known = true;
+            if (inFeat)
+                break;
+            continue;
+        }
+        if (!inFeat)
+            continue;
+        const std::string feature = toLowerAscii(trimAscii(line));
+        const std::string name = feature.substr(0, feature.find(' '));
+        if (name == "mlst")
+            features.mlst = true;
+        else if (name == "size")
+            features.size = true;
+        else if (name == "mdtm")
+            features.mdtm = true;
+    }
+    return features;
+}
+
+// MLST reply: the facts line is the one indented by a single space inside
+// the 250 block. The pathname there is the server's; `leaf` names the entry.
+bool parseMlstReply(const std::string &reply, const std::string &leaf,
+                    FileInfo &info) {
+    std::istringstream iss(reply);
+    std::string line;
+    while (std::getline(iss, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.size() < 2 || line.front() != ' ')
+            continue;
+        std::string facts = line.substr(1);
+        facts = facts.substr(0, facts.find(' '));
+        // MLST of a directory may describe it as the current directory.
+        const std::string lowered = toLowerAscii(facts);
+        const std::size_t typePos = lowered.find("type=");
+        if (typePos != std::string::npos &&
+            (lowered.compare(typePos + 5, 4, "cdir") == 0 ||
+             lowered.compare(typePos + 5, 4, "pdir") == 0)) {
+            facts.replace(typePos + 5, 4, "dir");
+        }
+        bool emit = false;
+        if (parseMlsdLine(facts + " " + leaf, info, emit) && emit)
+            return true;
+    }
+    return false;
+}
+
+bool isMissingPathCode(CURLcode rc) {
+    return rc == CURLE_REMOTE_FILE_NOT_FOUND ||
+           rc == CURLE_REMOTE_ACCESS_DENIED;
+}
+
+// Send one command on the control connection, without any data transfer,
+// and collect the server's replies.
+bool runControlCommand(CurlHandleCache &handles, const SessionOptions &opt,
+                       const std::string &command, std::string &reply,
+                       long &responseCode, std::string &err) {
+    reply.clear();
+    responseCode = 0;
+    CurlHandleCache::Lease lease(handles);
+    CURL *curl = lease.get();
+    if (!curl) {
+        err = "Could not create CURL handle.";
+        return false;
+    }
+    if (!configureCommonCurlHandle(curl, opt, err)) {
+        return false;
+    }
+
+    struct curl_slist *commands = curl_slist_append(nullptr, command.c_str());
+    const std::string url = buildFtpUrl(opt, "/");
+    const bool configured =
+        commands &&
+        (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_NOBODY, 1L) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_QUOTE, commands) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, appendListingChunk) ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_HEADERDATA, &reply) == CURLE_OK);
+    if (!configured) {
+        curl_slist_free_all(commands);
+        err = std::string("Could not configure ") +
+              protocolLabel(opt.protocol) + " command.";
+        return false;
+    }
+
+    const CURLcode rc = lease.perform();
+    (void)curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    curl_slist_free_all(commands);
+    if (rc != CURLE_OK) {
+        err = std::string(protocolLabel(opt.protocol)) + " command failed: " +
+              curl_easy_strerror(rc);
+        if (responseCode > 0)
+            err += " (server response " + std::to_string(responseCode) + ")";
+        return false;
+    }
+    return true;
+}
+
+// Header-only request for a file URL: libcurl sends SIZE (and MDTM when
+// `withTime`) and reports the answers. -1 means the server did not say.
+bool queryFileMetadata(CurlHandleCache &handles, const SessionOptions &opt,
+                       const std::string &remotePath, bool withTime,
+                       curl_off_t &sizeOut, curl_off_t &mtimeOut,
+                       CURLcode &rcOut, std::string &err) {
+    sizeOut = -1;
+    mtimeOut = -1;
+    rcOut = CURLE_OK;
+    CurlHandleCache::Lease lease(handles);
+    CURL *curl = lease.get();
+    if (!curl) {
+        err = "Could not create CURL handle.";
+        return false;
+    }
+    if (!configureCommonCurlHandle(curl, opt, err)) {
+        return false;
+    }
+
+    std::string sink;
+    const std::string url = buildFtpUrl(opt, remotePath);
+    const bool configured =
+        (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_NOBODY, 1L) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_FILETIME, withTime ? 1L : 0L) ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, appendListingChunk) ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, appendListingChunk) ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_HEADERDATA, &sink) == CURLE_OK);
+    if (!configured) {
+        err = std::string("Could not configure ") +
+              protocolLabel(opt.protocol) + " metadata query.";
+        return false;
+    }
+
+    rcOut = lease.perform();
+    if (rcOut != CURLE_OK) {
+        err = std::string(protocolLabel(opt.protocol)) +
+              " metadata query failed: " + curl_easy_strerror(rcOut);
+        return false;
+    }
+    (void)curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &sizeOut);
+    (void)curl_easy_getinfo(curl, CURLINFO_FILETIME_T, &mtimeOut);
+    return true;
+}
+
+// Header-only request for a directory URL: succeeds iff CWD does.
+bool probeDirectory(CurlHandleCache &handles, const SessionOptions &opt,
+                    const std::string &remotePath, CURLcode &rcOut,
+                    std::string &err) {
+    rcOut = CURLE_OK;
+    CurlHandleCache::Lease lease(handles);
+    CURL *curl = lease.get();
+    if (!curl) {
+        err = "Could not create CURL handle.";
+        return false;
+    }
+    if (!configureCommonCurlHandle(curl, opt, err)) {
+        return false;
+    }
+
+    const std::string url =
+        buildFtpUrl(opt, normalizeRemoteDirPath(remotePath));
+    if (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L) != CURLE_OK) {
+        err = std::string("Could not configure ") +
+              protocolLabel(opt.protocol) + " directory probe.";
+        return false;
+    }
+
+    rcOut = lease.perform();
+    if (rcOut != CURLE_OK) {
+        err = std::string(protocolLabel(opt.protocol)) +
+              " directory probe failed: " + curl_easy_strerror(rcOut);
+        return false;
+    }
+    return true;
+}
+
 } // namespace
 
-CurlFtpClient::CurlFtpClient(Protocol protocol) : protocol_(protocol) {
+CurlFtpClient::CurlFtpClient(Protocol protocol)
+    : protocol_(protocol), handles_(std::make_shared<CurlHandleCache>()) {
     if (!isFtpFamilyProtocol(protocol_))
         protocol_ = Protocol::Ftp;
     options_.protocol = protocol_;
@@ -677,19 +987,22 @@ bool CurlFtpClient::connect(const SessionOptions &opt, std::string &err) {
     if (normalized.port == 0)
         normalized.port = defaultPortForProtocol(protocol_);
 
-    CURL *curl = curl_easy_init();
+    CurlHandleCache::Lease lease(*handles_);
+    CURL *curl = lease.get();
     if (!curl) {
         err = "Could not create CURL handle.";
         return false;
     }
     if (!configureCommonCurlHandle(curl, normalized, err)) {
-        curl_easy_cleanup(curl);
         return false;
     }
 
     const std::string url = buildFtpUrl(normalized, "/");
     std::string sink;
-    if (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) != CURLE_OK ||
+    // FEAT rides along on the probe; "*" keeps servers without it working.
+    std::string replies;
+    struct curl_slist *feat = curl_slist_append(nullptr, "*FEAT");
+    if (!feat || curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) != CURLE_OK ||
         curl_easy_setopt(curl, CURLOPT_DIRLISTONLY, 1L) != CURLE_OK ||
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION,
                          +[](char *ptr, size_t size, size_t nmemb,
@@ -700,16 +1013,20 @@ bool CurlFtpClient::connect(const SessionOptions &opt, std::string &err) {
                              out->append(ptr, size * nmemb);
                              return size * nmemb;
                          }) != CURLE_OK ||
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink) != CURLE_OK) {
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &sink) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_QUOTE, feat) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, appendListingChunk) !=
+            CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &replies) != CURLE_OK) {
+        curl_slist_free_all(feat);
         err = "Could not configure FTP connection probe.";
-        curl_easy_cleanup(curl);
         return false;
     }
 
-    const CURLcode rc = curl_easy_perform(curl);
+    const CURLcode rc = lease.perform();
+    curl_slist_free_all(feat);
     long responseCode = 0;
     (void)curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
-    curl_easy_cleanup(curl);
     if (rc != CURLE_OK) {
         err = formatCurlProbeFailure(normalized.protocol, rc, responseCode);
         return false;
@@ -718,6 +1035,7 @@ bool CurlFtpClient::connect(const SessionOptions &opt, std::string &err) {
     {
         std::lock_guard<std::mutex> lk(stateMutex_);
         options_ = normalized;
+        features_ = parseFeatReply(replies);
         connected_ = true;
     }
     return true;
@@ -725,8 +1043,10 @@ bool CurlFtpClient::connect(const SessionOptions &opt, std::string &err) {
 
 void CurlFtpClient::disconnect() {
     interrupted_.store(false);
+    handles_->reset();
     std::lock_guard<std::mutex> lk(stateMutex_);
     connected_ = false;
+    features_ = Features{};
     options_ = SessionOptions{};
     options_.protocol = protocol_;
     options_.port = defaultPortForProtocol(protocol_);
@@ -739,10 +1059,27 @@ bool CurlFtpClient::isConnected() const {
     return connected_;
 }
 
+CurlFtpClient::Features CurlFtpClient::features() const {
+    std::lock_guard<std::mutex> lk(stateMutex_);
+    return features_;
+}
+
 bool CurlFtpClient::list(const std::string &remote_path,
                          std::vector<FileInfo> &out, std::string &err) {
-    err.clear();
     out.clear();
+    return listStream(
+        remote_path,
+        [&out](std::vector<FileInfo> &&batch) {
+            out.insert(out.end(), std::make_move_iterator(batch.begin()),
+                       std::make_move_iterator(batch.end()));
+            return true;
+        },
+        err);
+}
+
+bool CurlFtpClient::listStream(const std::string &remote_path,
+                               const ListBatchCB &onBatch, std::string &err) {
+    err.clear();
 
     SessionOptions opt;
     {
@@ -756,27 +1093,45 @@ bool CurlFtpClient::list(const std::string &remote_path,
     if (!ensureCurlInitialized(err))
         return false;
 
-    std::string mlsdPayload;
+    FtpListingStream mlsd(true, onBatch);
     std::string mlsdErr;
     const bool mlsdOk =
-        runDirectoryListingCommand(opt, remote_path, "MLSD", mlsdPayload, mlsdErr);
-    if (mlsdOk && parseMlsdListing(mlsdPayload, out))
+        runDirectoryListingCommand(*handles_, opt, remote_path, "MLSD",
+                                   streamListingChunk, &mlsd, mlsdErr);
+    if (mlsd.stopped()) {
+        err = "Canceled by user";
+        return false;
+    }
+    if (mlsdOk && mlsd.finish())
         return true;
+    const bool mlsdAnswered = mlsdOk || mlsd.parseFailed();
+    if (mlsd.emitted() > 0) {
+        // Entries were already delivered; a LIST retry would repeat them.
+        err = std::string(protocolLabel(opt.protocol)) +
+              " MLSD listing failed midway: " +
+              (mlsdAnswered ? std::string("unparsable entry") : mlsdErr);
+        return false;
+    }
 
-    std::string listPayload;
+    FtpListingStream listing(false, onBatch);
     std::string listErr;
     const bool listOk =
-        runDirectoryListingCommand(opt, remote_path, "LIST", listPayload, listErr);
-    if (listOk && parseListListing(listPayload, out))
+        runDirectoryListingCommand(*handles_, opt, remote_path, "LIST",
+                                   streamListingChunk, &listing, listErr);
+    if (listing.stopped()) {
+        err = "Canceled by user";
+        return false;
+    }
+    if (listOk && listing.finish())
         return true;
 
-    if (!mlsdOk && !listOk) {
+    if (!mlsdAnswered && !listOk) {
         err = std::string(protocolLabel(opt.protocol)) +
               " directory listing failed. MLSD: " + mlsdErr +
               " | LIST: " + listErr;
         return false;
     }
-    if (mlsdOk && !listOk) {
+    if (mlsdAnswered && !listOk) {
         err = std::string(protocolLabel(opt.protocol)) +
               " directory listing parse failed for MLSD output, and LIST "
               "fallback failed: " +
@@ -812,23 +1167,23 @@ bool CurlFtpClient::get(
     if (!ensureCurlInitialized(err))
         return false;
 
-    std::FILE *localFile = std::fopen(local.c_str(), "wb");
-    if (!localFile) {
+    const LocalIoOptions io = localIoOptionsFrom(opt);
+    LocalFileWriter localFile;
+    if (!localFile.open(local, LocalFileWriter::Mode::Truncate, io, err)) {
         err = "Could not open local file for writing.";
         return false;
     }
+    LocalFileCursor cursor;
+    cursor.writer = &localFile;
 
-    CURL *curl = curl_easy_init();
+    CurlHandleCache::Lease lease(*handles_);
+    CURL *curl = lease.get();
     if (!curl) {
-        std::fclose(localFile);
         err = "Could not create CURL handle.";
         return false;
     }
-    if (!configureCommonCurlHandle(curl, opt, err)) {
-        std::fclose(localFile);
-        curl_easy_cleanup(curl);
+    if (!configureCommonCurlHandle(curl, opt, err))
         return false;
-    }
 
     ProgressContext ctx{progress, shouldCancel, &interrupted_};
     const std::string url = buildFtpUrl(opt, remote);
@@ -836,21 +1191,16 @@ bool CurlFtpClient::get(
         (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) == CURLE_OK) &&
         (curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeFileCallback) ==
          CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_WRITEDATA, localFile) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION,
-                          transferProgressCallback) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &ctx) == CURLE_OK);
+        (curl_easy_setopt(curl, CURLOPT_WRITEDATA, &cursor) == CURLE_OK);
     if (!configured) {
-        std::fclose(localFile);
-        curl_easy_cleanup(curl);
         err = "Could not configure FTP download.";
         return false;
     }
+    applyTransferBufferSizes(curl, io);
 
-    const CURLcode rc = curl_easy_perform(curl);
-    std::fclose(localFile);
-    curl_easy_cleanup(curl);
+    const CURLcode rc = lease.perform(transferProgressCallback, &ctx);
+    std::string closeErr;
+    const bool closed = localFile.close(closeErr);
     if (rc == CURLE_ABORTED_BY_CALLBACK && (shouldCancel && shouldCancel())) {
         err = "Canceled by user";
         return false;
@@ -859,11 +1209,19 @@ bool CurlFtpClient::get(
         err = "Interrupted";
         return false;
     }
+    if (rc == CURLE_WRITE_ERROR && !cursor.err.empty()) {
+        err = cursor.err;
+        return false;
+    }
     if (rc != CURLE_OK) {
         err = std::string(protocolLabel(opt.protocol)) +
               " download failed: " + curl_easy_strerror(rc);
         return false;
     }
+    if (!closed) {
+        err = closeErr;
+        return false;
+    }
     return true;
 }
 
@@ -891,31 +1249,24 @@ bool CurlFtpClient::put(
     if (!ensureCurlInitialized(err))
         return false;
 
-    std::uint64_t total = 0;
-    try {
-        total = std::filesystem::file_size(local);
-    } catch (...) {
-        err = "Could not determine local file size.";
-        return false;
-    }
-
-    std::FILE *localFile = std::fopen(local.c_str(), "rb");
-    if (!localFile) {
+    const LocalIoOptions io = localIoOptionsFrom(opt);
+    LocalFileReader localFile;
+    if (!localFile.open(local, io, err)) {
         err = "Could not open local file for reading.";
         return false;
     }
+    const std::uint64_t total = localFile.size();
+    LocalFileCursor cursor;
+    cursor.reader = &localFile;
 
-    CURL *curl = curl_easy_init();
+    CurlHandleCache::Lease lease(*handles_);
+    CURL *curl = lease.get();
     if (!curl) {
-        std::fclose(localFile);
         err = "Could not create CURL handle.";
         return false;
     }
-    if (!configureCommonCurlHandle(curl, opt, err)) {
-        std::fclose(localFile);
-        curl_easy_cleanup(curl);
+    if (!configureCommonCurlHandle(curl, opt, err))
         return false;
-    }
 
     ProgressContext ctx{progress, shouldCancel, &interrupted_};
     const std::string url = buildFtpUrl(opt, remote);
@@ -924,25 +1275,19 @@ bool CurlFtpClient::put(
         (curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L) == CURLE_OK) &&
         (curl_easy_setopt(curl, CURLOPT_READFUNCTION, readFileCallback) ==
          CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_READDATA, localFile) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_READDATA, &cursor) == CURLE_OK) &&
         (curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE,
                           static_cast<curl_off_t>(total)) == CURLE_OK) &&
         (curl_easy_setopt(curl, CURLOPT_FTP_CREATE_MISSING_DIRS,
-                          CURLFTP_CREATE_DIR_RETRY) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION,
-                          transferProgressCallback) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &ctx) == CURLE_OK);
+                          CURLFTP_CREATE_DIR_RETRY) == CURLE_OK);
     if (!configured) {
-        std::fclose(localFile);
-        curl_easy_cleanup(curl);
         err = "Could not configure FTP upload.";
         return false;
     }
+    applyTransferBufferSizes(curl, io);
 
-    const CURLcode rc = curl_easy_perform(curl);
-    std::fclose(localFile);
-    curl_easy_cleanup(curl);
+    const CURLcode rc = lease.perform(transferProgressCallback, &ctx);
+    localFile.close();
     if (rc == CURLE_ABORTED_BY_CALLBACK && (shouldCancel && shouldCancel())) {
         err = "Canceled by user";
         return false;
@@ -951,6 +1296,145 @@ bool CurlFtpClient::put(
         err = "Interrupted";
         return false;
     }
+    if (rc == CURLE_ABORTED_BY_CALLBACK && !cursor.err.empty()) {
+        err = cursor.err;
+        return false;
+    }
+    if (rc != CURLE_OK) {
+        err = std::string(protocolLabel(opt.protocol)) +
+              " upload failed: " + curl_easy_strerror(rc);
+        return false;
+    }
+    return true;
+}
+
+bool CurlFtpClient::readStream(const std::string &remote,
+                               std::uint64_t offset, const ReadSink &sink,
+                               std::string &err,
+                               std::function<bool()> shouldCancel) {
+    err.clear();
+    SessionOptions opt;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_) {
+            err = "Not connected.";
+            return false;
+        }
+        opt = options_;
+    }
+    interrupted_.store(false);
+    if (!ensureCurlInitialized(err))
+        return false;
+
+    LocalFileCursor cursor;
+    cursor.sink = &sink;
+
+    CurlHandleCache::Lease lease(*handles_);
+    CURL *curl = lease.get();
+    if (!curl) {
+        err = "Could not create CURL handle.";
+        return false;
+    }
+    if (!configureCommonCurlHandle(curl, opt, err))
+        return false;
+
+    ProgressContext ctx{{}, shouldCancel, &interrupted_};
+    const std::string url = buildFtpUrl(opt, remote);
+    const bool configured =
+        (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeFileCallback) ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_WRITEDATA, &cursor) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE,
+                          static_cast<curl_off_t>(offset)) == CURLE_OK);
+    if (!configured) {
+        err = "Could not configure FTP download.";
+        return false;
+    }
+    applyTransferBufferSizes(curl, localIoOptionsFrom(opt));
+
+    const CURLcode rc = lease.perform(transferProgressCallback, &ctx);
+    if (rc == CURLE_ABORTED_BY_CALLBACK && (shouldCancel && shouldCancel())) {
+        err = "Canceled by user";
+        return false;
+    }
+    if (rc == CURLE_ABORTED_BY_CALLBACK && interrupted_.load()) {
+        err = "Interrupted";
+        return false;
+    }
+    if (rc == CURLE_WRITE_ERROR && !cursor.err.empty()) {
+        err = cursor.err;
+        return false;
+    }
+    if (rc != CURLE_OK) {
+        err = std::string(protocolLabel(opt.protocol)) +
+              " download failed: " + curl_easy_strerror(rc);
+        return false;
+    }
+    return true;
+}
+
+bool CurlFtpClient::writeStream(const std::string &remote, bool append,
+                                const WriteSource &source, std::string &err,
+                                std::function<bool()> shouldCancel) {
+    err.clear();
+    SessionOptions opt;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_) {
+            err = "Not connected.";
+            return false;
+        }
+        opt = options_;
+    }
+    interrupted_.store(false);
+    if (!ensureCurlInitialized(err))
+        return false;
+
+    LocalFileCursor cursor;
+    cursor.source = &source;
+
+    CurlHandleCache::Lease lease(*handles_);
+    CURL *curl = lease.get();
+    if (!curl) {
+        err = "Could not create CURL handle.";
+        return false;
+    }
+    if (!configureCommonCurlHandle(curl, opt, err))
+        return false;
+
+    // No INFILESIZE: the length is only known once the source ends.
+    ProgressContext ctx{{}, shouldCancel, &interrupted_};
+    const std::string url = buildFtpUrl(opt, remote);
+    const bool configured =
+        (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_APPEND, append ? 1L : 0L) ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_READFUNCTION, readFileCallback) ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_READDATA, &cursor) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_FTP_CREATE_MISSING_DIRS,
+                          CURLFTP_CREATE_DIR_RETRY) == CURLE_OK);
+    if (!configured) {
+        err = "Could not configure FTP upload.";
+        return false;
+    }
+    applyTransferBufferSizes(curl, localIoOptionsFrom(opt));
+
+    const CURLcode rc = lease.perform(transferProgressCallback, &ctx);
+    if (rc == CURLE_ABORTED_BY_CALLBACK && (shouldCancel && shouldCancel())) {
+        err = "Canceled by user";
+        return false;
+    }
+    if (rc == CURLE_ABORTED_BY_CALLBACK && interrupted_.load()) {
+        err = "Interrupted";
+        return false;
+    }
+    if (rc == CURLE_ABORTED_BY_CALLBACK && !cursor.err.empty()) {
+        err = cursor.err;
+        return false;
+    }
     if (rc != CURLE_OK) {
         err = std::string(protocolLabel(opt.protocol)) +
               " upload failed: " + curl_easy_strerror(rc);
@@ -961,16 +1445,101 @@ bool CurlFtpClient::put(
 
 bool CurlFtpClient::exists(const std::string &remote_path, bool &isDir,
                            std::string &err) {
-    (void)remote_path;
     isDir = false;
-    return unsupportedFtpOperation("path existence checks", err);
+    FileInfo info{};
+    if (!stat(remote_path, info, err))
+        return false; // err stays empty when the path does not exist
+    isDir = info.is_dir;
+    return true;
 }
 
 bool CurlFtpClient::stat(const std::string &remote_path, FileInfo &info,
                          std::string &err) {
-    (void)remote_path;
+    err.clear();
     info = FileInfo{};
-    return unsupportedFtpOperation("metadata stat", err);
+    SessionOptions opt;
+    Features features;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_) {
+            err = "Not connected.";
+            return false;
+        }
+        opt = options_;
+        features = features_;
+    }
+    if (!ensureCurlInitialized(err))
+        return false;
+
+    std::string target = normalizeRemotePath(remote_path);
+    while (target.size() > 1 && target.back() == '/')
+        target.pop_back();
+    if (target.find_first_of("\r\n") != std::string::npos) {
+        err = "Invalid remote path.";
+        return false;
+    }
+    const std::size_t slash = target.find_last_of('/');
+    const std::string leaf =
+        (target.size() > 1) ? target.substr(slash + 1) : target;
+
+    // One round trip with MLST; paths are relative to the login directory
+    // like the URLs the rest of the backend builds.
+    if (features.mlst) {
+        const std::string command =
+            (target.size() > 1) ? "MLST " + target.substr(1) : "MLST";
+        std::string reply;
+        long code = 0;
+        std::string mlstErr;
+        if (runControlCommand(*handles_, opt, command, reply, code, mlstErr)) {
+            if (parseMlstReply(reply, leaf, info))
+                return true;
+        } else if (code == 550 || code == 450) {
+            return false; // does not exist
+        } else if (code / 100 != 5) {
+            err = mlstErr;
+            return false;
+        }
+        // Unparsable or rejected MLST: fall back to SIZE/MDTM below.
+        info = FileInfo{};
+    }
+
+    curl_off_t size = -1;
+    curl_off_t mtime = -1;
+    CURLcode fileRc = CURLE_OK;
+    std::string fileErr;
+    const bool withTime = features.mdtm || !features.known;
+    const bool fileOk = queryFileMetadata(*handles_, opt, target, withTime,
+                                          size, mtime, fileRc, fileErr);
+    if (fileOk && size >= 0) {
+        info.name = leaf;
+        info.size = static_cast<std::uint64_t>(size);
+        info.has_size = true;
+        info.mtime = (mtime > 0) ? static_cast<std::uint64_t>(mtime) : 0;
+        info.mode = 0100000u;
+        return true;
+    }
+
+    // SIZE has no answer for directories (or for nothing at all).
+    CURLcode dirRc = CURLE_OK;
+    std::string dirErr;
+    if (probeDirectory(*handles_, opt, target, dirRc, dirErr)) {
+        info.name = leaf;
+        info.is_dir = true;
+        info.mtime = (mtime > 0) ? static_cast<std::uint64_t>(mtime) : 0;
+        info.mode = 0040000u;
+        return true;
+    }
+    if (fileOk && mtime >= 0) {
+        // MDTM answered but SIZE did not: a file of unknown size.
+        info.name = leaf;
+        info.mtime = static_cast<std::uint64_t>(mtime);
+        info.mode = 0100000u;
+        return true;
+    }
+    if ((fileOk || isMissingPathCode(fileRc)) && isMissingPathCode(dirRc))
+        return false; // does not exist
+    err = fileOk ? dirErr : fileErr;
+    return false;
 }
 
 bool CurlFtpClient::chmod(const std::string &remote_path, std::uint32_t mode,
@@ -1003,6 +1572,31 @@ bool CurlFtpClient::mkdir(const std::string &remote_dir, std::string &err,
     return unsupportedFtpOperation("mkdir", err);
 }
 
+bool CurlFtpClient::ping(std::uint32_t &rtt_ms, std::string &err) {
+    rtt_ms = 0;
+    err.clear();
+    SessionOptions opt;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_) {
+            err = "Not connected.";
+            return false;
+        }
+        opt = options_;
+    }
+    // NOOP on the pooled control connection.
+    std::string reply;
+    long code = 0;
+    const auto start = std::chrono::steady_clock::now();
+    if (!runControlCommand(*handles_, opt, "NOOP", reply, code, err))
+        return false;
+    rtt_ms = static_cast<std::uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    return true;
+}
+
 bool CurlFtpClient::removeFile(const std::string &remote_path,
                                std::string &err) {
     (void)remote_path;
@@ -1027,6 +1621,8 @@ CurlFtpClient::newConnectionLike(const SessionOptions &opt, std::string &err) {
     const Protocol nextProtocol =
         isFtpFamilyProtocol(opt.protocol) ? opt.protocol : protocol_;
     auto ptr = std::make_unique<CurlFtpClient>(nextProtocol);
+    // Clones resolve and resume TLS through this session's share handle.
+    ptr->handles_ = std::make_shared<CurlHandleCache>(handles_->share());
     if (!ptr->connect(opt, err))
         return nullptr;
     return ptr;
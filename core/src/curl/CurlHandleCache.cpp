@@ -0,0 +1,111 @@
+// Persistent libcurl state shared by the curl-based backends.
+#include "CurlHandleCache.hpp"
+
+namespace openscp {
+
+CurlShareState::CurlShareState() {
+    share_ = curl_share_init();
+    if (!share_)
+        return;
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &CurlShareState::lockCb);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &CurlShareState::unlockCb);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+CurlShareState::~CurlShareState() {
+    engine_.reset(); // stops transfers before the share goes away
+    if (share_)
+        curl_share_cleanup(share_);
+}
+
+CurlMultiEngine *CurlShareState::engine() {
+    std::call_once(engineOnce_, [this] {
+        auto engine = std::make_unique<CurlMultiEngine>();
+        if (engine->valid())
+            engine_ = std::move(engine);
+    });
+    return engine_.get();
+}
+
+void CurlShareState::lockCb(CURL *, curl_lock_data data, curl_lock_access,
+                            void *u) {
+    auto *self = static_cast<CurlShareState *>(u);
+    if (self && data >= 0 && data < CURL_LOCK_DATA_LAST)
+        self->locks_[data].lock();
+}
+
+void CurlShareState::unlockCb(CURL *, curl_lock_data data, void *u) {
+    auto *self = static_cast<CurlShareState *>(u);
+    if (self && data >= 0 && data < CURL_LOCK_DATA_LAST)
+        self->locks_[data].unlock();
+}
+
+CurlHandleCache::CurlHandleCache(std::shared_ptr<CurlShareState> share)
+    : share_(share ? std::move(share) : std::make_shared<CurlShareState>()) {}
+
+CurlHandleCache::~CurlHandleCache() { reset(); }
+
+void CurlHandleCache::reset() {
+    // The lease holding mtx_ sees this from its progress callback and ends
+    // its request, so the lock below is not held for a whole transfer.
+    ++resetting_;
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (easy_) {
+        curl_easy_cleanup(easy_);
+        easy_ = nullptr;
+    }
+    --resetting_;
+}
+
+CurlHandleCache::Lease::Lease(CurlHandleCache &cache)
+    : cache_(cache), lock_(cache.mtx_) {
+    if (!cache.easy_)
+        cache.easy_ = curl_easy_init();
+    else
+        curl_easy_reset(cache.easy_); // keeps live connections and caches
+    curl_ = cache.easy_;
+    if (curl_ && cache.share_ && cache.share_->handle())
+        curl_easy_setopt(curl_, CURLOPT_SHARE, cache.share_->handle());
+}
+
+// The caller's progress handler, behind a check for a pending reset().
+struct CurlHandleCache::Lease::Progress {
+    const CurlHandleCache *cache;
+    curl_xferinfo_callback xferinfo;
+    void *userdata;
+};
+
+int CurlHandleCache::Lease::progressCb(void *userdata, curl_off_t dltotal,
+                                       curl_off_t dlnow, curl_off_t ultotal,
+                                       curl_off_t ulnow) {
+    const auto *p = static_cast<const Progress *>(userdata);
+    if (p->cache->resetting_.load() > 0)
+        return 1;
+    return p->xferinfo ? p->xferinfo(p->userdata, dltotal, dlnow, ultotal,
+                                     ulnow)
+                       : 0;
+}
+
+CURLcode CurlHandleCache::Lease::perform(curl_xferinfo_callback xferinfo,
+                                         void *userdata) {
+    if (!curl_)
+        return CURLE_FAILED_INIT;
+    if (cache_.resetting_.load() > 0)
+        return CURLE_ABORTED_BY_CALLBACK;
+    Progress ctx{&cache_, xferinfo, userdata};
+    CurlMultiEngine *engine = cache_.share_ ? cache_.share_->engine() : nullptr;
+    if (!engine) {
+        curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl_, CURLOPT_XFERINFOFUNCTION, &Lease::progressCb);
+        curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, &ctx);
+        return curl_easy_perform(curl_);
+    }
+    return engine->perform(curl_, [&ctx](curl_off_t dltotal, curl_off_t dlnow,
+                                         curl_off_t ultotal, curl_off_t ulnow) {
+        return progressCb(&ctx, dltotal, dlnow, ultotal, ulnow);
+    });
+}
+
+} // namespace openscp
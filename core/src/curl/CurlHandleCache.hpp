@@ -0,0 +1,87 @@
+// Persistent libcurl state shared by the curl-based backends.
+#pragma once
+
+#include "CurlMultiEngine.hpp"
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace openscp {
+
+// DNS and TLS-session caches shared by every connection cloned from one
+// session, so worker connections resolve once and resume TLS sessions. The
+// session's multi engine lives here too, so clones share its connection pool.
+class CurlShareState {
+    public:
+    CurlShareState();
+    ~CurlShareState();
+    CurlShareState(const CurlShareState &) = delete;
+    CurlShareState &operator=(const CurlShareState &) = delete;
+
+    CURLSH *handle() const { return share_; }
+    // Created on first use; nullptr if libcurl could not start a multi handle.
+    CurlMultiEngine *engine();
+
+    private:
+    static void lockCb(CURL *, curl_lock_data data, curl_lock_access, void *u);
+    static void unlockCb(CURL *, curl_lock_data data, void *u);
+
+    CURLSH *share_ = nullptr;
+    std::mutex locks_[CURL_LOCK_DATA_LAST];
+    std::once_flag engineOnce_;
+    std::unique_ptr<CurlMultiEngine> engine_;
+};
+
+// One reusable easy handle per client. Requests run on the session's multi
+// engine, whose pool keeps control (FTP) and HTTP connections alive between
+// operations, so they skip the TCP connect and TLS handshake. Without an
+// engine the easy handle keeps its own connection across curl_easy_reset().
+class CurlHandleCache {
+    public:
+    explicit CurlHandleCache(std::shared_ptr<CurlShareState> share = {});
+    ~CurlHandleCache();
+    CurlHandleCache(const CurlHandleCache &) = delete;
+    CurlHandleCache &operator=(const CurlHandleCache &) = delete;
+
+    const std::shared_ptr<CurlShareState> &share() const { return share_; }
+    // Close the cached connection (the next lease reconnects). A request
+    // in flight on the handle is aborted (CURLE_ABORTED_BY_CALLBACK) rather
+    // than waited for.
+    void reset();
+
+    // Exclusive use of the handle for one operation, with all options reset
+    // to defaults; callers configure it from scratch.
+    class Lease {
+        public:
+        explicit Lease(CurlHandleCache &cache);
+        // Null when libcurl could not create the handle.
+        CURL *get() const { return curl_; }
+        explicit operator bool() const { return curl_ != nullptr; }
+        // Run the configured request. Progress goes through `xferinfo` (on
+        // the calling thread) instead of CURLOPT_XFERINFOFUNCTION.
+        CURLcode perform(curl_xferinfo_callback xferinfo = nullptr,
+                         void *userdata = nullptr);
+
+        private:
+        struct Progress;
+        static int progressCb(void *userdata, curl_off_t dltotal,
+                              curl_off_t dlnow, curl_off_t ultotal,
+                              curl_off_t ulnow);
+
+        CurlHandleCache &cache_;
+        std::unique_lock<std::mutex> lock_;
+        CURL *curl_ = nullptr;
+    };
+
+    private:
+    std::mutex mtx_; // serializes operations on easy_
+    CURL *easy_ = nullptr;
+    std::atomic<int> resetting_{0}; // reset() calls waiting for mtx_
+    std::shared_ptr<CurlShareState> share_;
+};
+
+} // namespace openscp
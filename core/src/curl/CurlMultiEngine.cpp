@@ -0,0 +1,194 @@
+// curl_multi event loop shared by the connections of one curl session.
+#include "CurlMultiEngine.hpp"
+
+#include <atomic>
+
+namespace openscp {
+
+struct CurlMultiEngine::Relay {
+    CURL *easy = nullptr;
+    std::atomic<curl_off_t> dltotal{0};
+    std::atomic<curl_off_t> dlnow{0};
+    std::atomic<curl_off_t> ultotal{0};
+    std::atomic<curl_off_t> ulnow{0};
+    std::atomic<bool> abort{false};
+    std::atomic<bool> hold{false};   // caller's handler is running
+    std::atomic<bool> paused{false}; // transfer paused for the handler
+    // perform() posted the resume; the engine clears both when it runs it.
+    std::atomic<bool> resumeQueued{false};
+};
+
+CurlMultiEngine::CurlMultiEngine() {
+    multi_ = curl_multi_init();
+    if (!multi_)
+        return;
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    thread_ = std::thread([this] { loop(); });
+}
+
+CurlMultiEngine::~CurlMultiEngine() {
+    if (!multi_)
+        return;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    curl_multi_wakeup(multi_);
+    if (thread_.joinable())
+        thread_.join();
+    curl_multi_cleanup(multi_);
+}
+
+void CurlMultiEngine::submit(CURL *easy, Completion done) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        pendingAdd_.emplace_back(easy, std::move(done));
+    }
+    curl_multi_wakeup(multi_);
+}
+
+void CurlMultiEngine::resume(Relay *relay) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        pendingResume_.emplace_back(relay->easy, relay);
+    }
+    curl_multi_wakeup(multi_);
+}
+
+int CurlMultiEngine::relayCallback(void *userdata, curl_off_t dltotal,
+                                   curl_off_t dlnow, curl_off_t ultotal,
+                                   curl_off_t ulnow) {
+    auto *relay = static_cast<Relay *>(userdata);
+    if (!relay)
+        return 0;
+    relay->dltotal.store(dltotal);
+    relay->dlnow.store(dlnow);
+    relay->ultotal.store(ultotal);
+    relay->ulnow.store(ulnow);
+    if (relay->abort.load())
+        return 1;
+    if (relay->hold.load() && !relay->paused.exchange(true))
+        curl_easy_pause(relay->easy, CURLPAUSE_ALL);
+    return 0;
+}
+
+CURLcode CurlMultiEngine::perform(CURL *easy, const XferInfo &xferinfo) {
+    Relay relay;
+    relay.easy = easy;
+    if (curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 0L) != CURLE_OK ||
+        curl_easy_setopt(easy, CURLOPT_XFERINFOFUNCTION,
+                         &CurlMultiEngine::relayCallback) != CURLE_OK ||
+        curl_easy_setopt(easy, CURLOPT_XFERINFODATA, &relay) != CURLE_OK) {
+        return CURLE_FAILED_INIT;
+    }
+    // Prefer waiting for a multiplexable connection over opening a new one.
+    (void)curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+    CURLcode result = CURLE_OK;
+    submit(easy, [&](CURLcode rc) {
+        std::lock_guard<std::mutex> lk(m);
+        result = rc;
+        done = true;
+        cv.notify_one();
+    });
+
+    auto relayOnce = [&]() {
+        if (!xferinfo)
+            return;
+        relay.hold.store(true);
+        const int rc = xferinfo(relay.dltotal.load(), relay.dlnow.load(),
+                                relay.ultotal.load(), relay.ulnow.load());
+        relay.hold.store(false);
+        if (rc != 0)
+            relay.abort.store(true);
+    };
+
+    std::unique_lock<std::mutex> lk(m);
+    while (!done) {
+        cv.wait_for(lk, kRelayInterval);
+        if (done)
+            break;
+        lk.unlock();
+        relayOnce();
+        // A paused transfer (also one that must now abort) only moves again
+        // once the loop unpauses it; post that once per pause.
+        if (relay.paused.load() && !relay.resumeQueued.exchange(true))
+            resume(&relay);
+        lk.lock();
+    }
+    lk.unlock();
+    relayOnce(); // final counters
+    return result;
+}
+
+void CurlMultiEngine::loop() {
+    for (;;) {
+        std::vector<std::pair<CURL *, Completion>> adds;
+        std::vector<std::pair<CURL *, Relay *>> resumes;
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            if (stop_)
+                break;
+            adds.swap(pendingAdd_);
+            resumes.swap(pendingResume_);
+        }
+        // Resumes first: one left over from a finished transfer must not
+        // reach a relay that is gone when its handle is submitted again.
+        for (auto &[easy, relay] : resumes) {
+            if (active_.count(easy) == 0)
+                continue;
+            relay->paused.store(false);
+            relay->resumeQueued.store(false);
+            curl_easy_pause(easy, CURLPAUSE_CONT);
+        }
+        for (auto &add : adds) {
+            const CURLMcode mc = curl_multi_add_handle(multi_, add.first);
+            if (mc != CURLM_OK) {
+                add.second(CURLE_FAILED_INIT);
+                continue;
+            }
+            active_.emplace(add.first, std::move(add.second));
+        }
+
+        int running = 0;
+        curl_multi_perform(multi_, &running);
+        int queued = 0;
+        while (CURLMsg *msg = curl_multi_info_read(multi_, &queued)) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+            CURL *easy = msg->easy_handle;
+            const CURLcode rc = msg->data.result;
+            curl_multi_remove_handle(multi_, easy);
+            auto it = active_.find(easy);
+            if (it == active_.end())
+                continue;
+            Completion done = std::move(it->second);
+            active_.erase(it);
+            if (done)
+                done(rc);
+        }
+        curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+    }
+
+    // Fail whatever is still in flight so blocked callers return.
+    for (auto &kv : active_) {
+        curl_multi_remove_handle(multi_, kv.first);
+        if (kv.second)
+            kv.second(CURLE_ABORTED_BY_CALLBACK);
+    }
+    active_.clear();
+    std::vector<std::pair<CURL *, Completion>> adds;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        adds.swap(pendingAdd_);
+    }
+    for (auto &add : adds) {
+        if (add.second)
+            add.second(CURLE_ABORTED_BY_CALLBACK);
+    }
+}
+
+} // namespace openscp
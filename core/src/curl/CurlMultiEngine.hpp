@@ -0,0 +1,65 @@
+// curl_multi event loop shared by the connections of one curl session.
+#pragma once
+
+#include <curl/curl.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace openscp {
+
+// Runs every transfer of a session on one thread through a single multi
+// handle. Connections live in the multi's pool, so they are reused across
+// all clones of the session, and HTTP/2 servers multiplex concurrent
+// WebDAV requests over one TCP connection.
+class CurlMultiEngine {
+    public:
+    using Completion = std::function<void(CURLcode)>;
+    // Same contract as CURLOPT_XFERINFOFUNCTION (non-zero aborts).
+    using XferInfo =
+        std::function<int(curl_off_t, curl_off_t, curl_off_t, curl_off_t)>;
+
+    CurlMultiEngine();
+    ~CurlMultiEngine();
+    CurlMultiEngine(const CurlMultiEngine &) = delete;
+    CurlMultiEngine &operator=(const CurlMultiEngine &) = delete;
+
+    bool valid() const { return multi_ != nullptr; }
+
+    // Start `easy` on the engine thread; `done` runs there once it ends.
+    // The handle and everything it points to must outlive the completion.
+    void submit(CURL *easy, Completion done);
+
+    // Blocking form of submit(). `xferinfo` (optional) runs on the calling
+    // thread every kRelayInterval with the latest counters, so slow progress
+    // handlers (throttling, cancellation checks taking locks) never stall
+    // other transfers: the transfer is paused while the handler runs.
+    CURLcode perform(CURL *easy, const XferInfo &xferinfo = {});
+
+    static constexpr std::chrono::milliseconds kRelayInterval{50};
+
+    private:
+    struct Relay;
+    static int relayCallback(void *userdata, curl_off_t dltotal,
+                             curl_off_t dlnow, curl_off_t ultotal,
+                             curl_off_t ulnow);
+    void resume(Relay *relay);
+    void loop();
+
+    CURLM *multi_ = nullptr;
+    std::mutex mtx_; // protects the queues below and stop_
+    std::vector<std::pair<CURL *, Completion>> pendingAdd_;
+    std::vector<std::pair<CURL *, Relay *>> pendingResume_;
+    bool stop_ = false;
+    // Only touched by the engine thread
+    std::unordered_map<CURL *, Completion> active_;
+    std::thread thread_;
+};
+
+} // namespace openscp
@@ -1,22 +1,29 @@
 // WebDAV backend implementation based on libcurl and tinyxml2.
 #include "openscp/CurlWebDavClient.hpp"
 
+#include "CurlHandleCache.hpp"
+#include "openscp/LocalFileIO.hpp"
+
 #include <curl/curl.h>
 #include <tinyxml2.h>
 
 #include <algorithm>
 #include <cctype>
 #include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <condition_variable>
 #include <cstring>
 #include <ctime>
-#include <filesystem>
+#include <deque>
+#include <iterator>
 #include <limits>
 #include <mutex>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 namespace openscp {
@@ -167,6 +174,9 @@ bool configureCommonCurlHandle(CURL *curl, const SessionOptions &opt,
         err = "Could not configure WebDAV client timeouts.";
         return false;
     }
+    // HTTP/2 where the server offers it, so the session's engine multiplexes
+    // concurrent transfers over one connection.
+    (void)curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
 
     if (!opt.username.empty()) {
         if (curl_easy_setopt(curl, CURLOPT_USERNAME, opt.username.c_str()) !=
@@ -268,16 +278,85 @@ size_t appendBodyChunk(char *ptr, size_t size, size_t nmemb, void *userdata) {
     return total;
 }
 
+// Position in the local file of a running download/upload, shared with the
+// curl data callbacks. Streamed transfers set sink/source instead of a file.
+struct LocalFileCursor {
+    LocalFileReader *reader = nullptr;
+    LocalFileWriter *writer = nullptr;
+    const SftpClient::ReadSink *sink = nullptr;
+    const SftpClient::WriteSource *source = nullptr;
+    // Ranged stream read: the reply must be 206, checked at the first byte.
+    CURL *rangeCheck = nullptr;
+    std::uint64_t offset = 0;
+    std::string err;
+};
+
 size_t writeFileCallback(char *ptr, size_t size, size_t nmemb, void *userdata) {
-    if (!userdata)
+    auto *cursor = static_cast<LocalFileCursor *>(userdata);
+    const size_t total = size * nmemb;
+    if (cursor && cursor->sink) {
+        if (cursor->rangeCheck) {
+            long status = 0;
+            (void)curl_easy_getinfo(cursor->rangeCheck, CURLINFO_RESPONSE_CODE,
+                                    &status);
+            cursor->rangeCheck = nullptr;
+            if (status != 206) {
+                cursor->err = "Server ignored the requested byte range";
+                return 0;
+            }
+        }
+        if (!(*cursor->sink)(ptr, total)) {
+            cursor->err = "Stream consumer stopped";
+            return 0;
+        }
+        cursor->offset += total;
+        return total;
+    }
+    if (!cursor || !cursor->writer)
+        return 0;
+    if (!cursor->writer->writeAt(cursor->offset, ptr, total, cursor->err))
         return 0;
-    return std::fwrite(ptr, size, nmemb, static_cast<std::FILE *>(userdata));
+    cursor->offset += total;
+    return total;
 }
 
 size_t readFileCallback(char *ptr, size_t size, size_t nmemb, void *userdata) {
-    if (!userdata)
-        return 0;
-    return std::fread(ptr, size, nmemb, static_cast<std::FILE *>(userdata));
+    auto *cursor = static_cast<LocalFileCursor *>(userdata);
+    if (cursor && cursor->source) {
+        const std::ptrdiff_t got = (*cursor->source)(ptr, size * nmemb);
+        if (got < 0) {
+            cursor->err = "Stream source failed";
+            return CURL_READFUNC_ABORT;
+        }
+        cursor->offset += static_cast<std::uint64_t>(got);
+        return static_cast<size_t>(got);
+    }
+    if (!cursor || !cursor->reader)
+        return CURL_READFUNC_ABORT;
+    const char *data = nullptr;
+    size_t n = 0;
+    if (!cursor->reader->read(cursor->offset, size * nmemb, ptr, data, n,
+                              cursor->err))
+        return CURL_READFUNC_ABORT;
+    if (data != ptr)
+        std::memcpy(ptr, data, n); // mapped file: one copy into curl's buffer
+    cursor->offset += n;
+    return n;
+}
+
+// Larger curl buffers for file transfers (best effort; curl caps them and
+// older releases lack the upload option).
+void applyTransferBufferSizes(CURL *curl, const LocalIoOptions &io) {
+    (void)curl_easy_setopt(
+        curl, CURLOPT_BUFFERSIZE,
+        static_cast<long>(std::min<std::size_t>(io.buffer_size,
+                                                CURL_MAX_READ_SIZE)));
+#if LIBCURL_VERSION_NUM >= 0x073e00
+    (void)curl_easy_setopt(
+        curl, CURLOPT_UPLOAD_BUFFERSIZE,
+        static_cast<long>(std::min<std::size_t>(io.buffer_size,
+                                                2 * 1024 * 1024)));
+#endif
 }
 
 int transferProgressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow,
@@ -305,19 +384,20 @@ int transferProgressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow
     return 0;
 }
 
-bool performTextRequest(const SessionOptions &opt, const std::string &method,
+bool performTextRequest(CurlHandleCache &handles, const SessionOptions &opt,
+                        const std::string &method,
                         const std::string &remotePath,
                         const std::string *requestBody,
                         const std::vector<std::string> &headers,
                         WebDavResponse &response, std::string &err) {
     response = WebDavResponse{};
-    CURL *curl = curl_easy_init();
+    CurlHandleCache::Lease lease(handles);
+    CURL *curl = lease.get();
     if (!curl) {
         err = "Could not create CURL handle.";
         return false;
     }
     if (!configureCommonCurlHandle(curl, opt, err)) {
-        curl_easy_cleanup(curl);
         return false;
     }
 
@@ -337,7 +417,6 @@ bool performTextRequest(const SessionOptions &opt, const std::string &method,
     if (!configured) {
         err = std::string("Could not configure WebDAV ") + method + " request.";
         curl_slist_free_all(headerList);
-        curl_easy_cleanup(curl);
         return false;
     }
 
@@ -349,15 +428,13 @@ bool performTextRequest(const SessionOptions &opt, const std::string &method,
             err = std::string("Could not configure WebDAV request body for ") +
                   method + ".";
             curl_slist_free_all(headerList);
-            curl_easy_cleanup(curl);
             return false;
         }
     }
 
-    const CURLcode rc = curl_easy_perform(curl);
+    const CURLcode rc = lease.perform();
     (void)curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.statusCode);
     curl_slist_free_all(headerList);
-    curl_easy_cleanup(curl);
 
     if (rc != CURLE_OK) {
         err = std::string("WebDAV ") + method +
@@ -367,41 +444,52 @@ bool performTextRequest(const SessionOptions &opt, const std::string &method,
     return true;
 }
 
-bool performDownloadRequest(const SessionOptions &opt, const std::string &remote,
-                            std::FILE *localFile, ProgressContext &ctx,
+// A non-zero `offset` asks for the bytes from there on (HTTP Range).
+bool performDownloadRequest(CurlHandleCache &handles,
+                            const SessionOptions &opt,
+                            const std::string &remote,
+                            LocalFileCursor &cursor, ProgressContext &ctx,
                             std::string &err, long &statusCodeOut,
-                            CURLcode &rcOut) {
+                            CURLcode &rcOut, std::uint64_t offset = 0) {
     statusCodeOut = 0;
     rcOut = CURLE_OK;
-    CURL *curl = curl_easy_init();
+    CurlHandleCache::Lease lease(handles);
+    CURL *curl = lease.get();
     if (!curl) {
         err = "Could not create CURL handle.";
         return false;
     }
     if (!configureCommonCurlHandle(curl, opt, err)) {
-        curl_easy_cleanup(curl);
         return false;
     }
     const std::string url = buildWebDavUrl(opt, remote);
-    const bool configured =
+    bool configured =
         (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) == CURLE_OK) &&
         (curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L) == CURLE_OK) &&
         (curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeFileCallback) ==
          CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_WRITEDATA, localFile) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, transferProgressCallback) ==
-         CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &ctx) == CURLE_OK);
+        (curl_easy_setopt(curl, CURLOPT_WRITEDATA, &cursor) == CURLE_OK) &&
+        // A stream sink must not receive an error page as file data.
+        (!cursor.sink ||
+         curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L) == CURLE_OK);
+    const std::string range = std::to_string(offset) + "-";
+    if (configured && offset > 0) {
+        configured =
+            curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str()) == CURLE_OK;
+        cursor.rangeCheck = curl;
+    }
     if (!configured) {
         err = "Could not configure WebDAV download.";
-        curl_easy_cleanup(curl);
         return false;
     }
-    const CURLcode rc = curl_easy_perform(curl);
+    applyTransferBufferSizes(curl, localIoOptionsFrom(opt));
+    const CURLcode rc = lease.perform(transferProgressCallback, &ctx);
     rcOut = rc;
     (void)curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &statusCodeOut);
-    curl_easy_cleanup(curl);
+    if (rc == CURLE_WRITE_ERROR && !cursor.err.empty()) {
+        err = cursor.err;
+        return false;
+    }
     if (rc != CURLE_OK) {
         err = std::string("WebDAV download failed: ") + curl_easy_strerror(rc);
         return false;
@@ -409,19 +497,20 @@ bool performDownloadRequest(const SessionOptions &opt, const std::string &remote
     return true;
 }
 
-bool performUploadRequest(const SessionOptions &opt, const std::string &remote,
-                          std::FILE *localFile, curl_off_t fileSize,
+bool performUploadRequest(CurlHandleCache &handles,
+                          const SessionOptions &opt, const std::string &remote,
+                          LocalFileCursor &cursor, curl_off_t fileSize,
                           ProgressContext &ctx, std::string &err,
                           long &statusCodeOut, CURLcode &rcOut) {
     statusCodeOut = 0;
     rcOut = CURLE_OK;
-    CURL *curl = curl_easy_init();
+    CurlHandleCache::Lease lease(handles);
+    CURL *curl = lease.get();
     if (!curl) {
         err = "Could not create CURL handle.";
         return false;
     }
     if (!configureCommonCurlHandle(curl, opt, err)) {
-        curl_easy_cleanup(curl);
         return false;
     }
     const std::string url = buildWebDavUrl(opt, remote);
@@ -431,21 +520,21 @@ bool performUploadRequest(const SessionOptions &opt, const std::string &remote,
         (curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT") == CURLE_OK) &&
         (curl_easy_setopt(curl, CURLOPT_READFUNCTION, readFileCallback) ==
          CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_READDATA, localFile) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, fileSize) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L) == CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, transferProgressCallback) ==
-         CURLE_OK) &&
-        (curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &ctx) == CURLE_OK);
+        (curl_easy_setopt(curl, CURLOPT_READDATA, &cursor) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE, fileSize) ==
+         CURLE_OK);
     if (!configured) {
         err = "Could not configure WebDAV upload.";
-        curl_easy_cleanup(curl);
         return false;
     }
-    const CURLcode rc = curl_easy_perform(curl);
+    applyTransferBufferSizes(curl, localIoOptionsFrom(opt));
+    const CURLcode rc = lease.perform(transferProgressCallback, &ctx);
     rcOut = rc;
     (void)curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &statusCodeOut);
-    curl_easy_cleanup(curl);
+    if (rc == CURLE_ABORTED_BY_CALLBACK && !cursor.err.empty()) {
+        err = cursor.err;
+        return false;
+    }
     if (rc != CURLE_OK) {
         err = std::string("WebDAV upload failed: ") + curl_easy_strerror(rc);
         return false;
@@ -554,6 +643,45 @@ void parsePropElement(const tinyxml2::XMLElement *prop, WebDavResource &out) {
     }
 }
 
+// One <response> element of a multistatus body; false if it has no href.
+bool parseResponseElement(const tinyxml2::XMLElement *elem,
+                          WebDavResource &parsed) {
+    const tinyxml2::XMLElement *hrefEl = firstChildByLocal(elem, "href");
+    const char *hrefTxt = hrefEl ? hrefEl->GetText() : nullptr;
+    if (!hrefTxt || !*hrefTxt)
+        return false;
+
+    const std::string hrefRaw(hrefTxt);
+    parsed = WebDavResource{};
+    parsed.path = normalizeRemotePath(
+        decodePercent(extractPathFromHref(hrefRaw)));
+    if (hrefRaw.back() == '/')
+        parsed.isDir = true;
+
+    bool consumedPropStat = false;
+    for (const tinyxml2::XMLElement *propStat = elem->FirstChildElement();
+         propStat; propStat = propStat->NextSiblingElement()) {
+        if (!xmlNameEquals(propStat, "propstat"))
+            continue;
+        const tinyxml2::XMLElement *statusEl =
+            firstChildByLocal(propStat, "status");
+        const char *statusText = statusEl ? statusEl->GetText() : nullptr;
+        const int statusCode =
+            statusText ? parseHttpStatusCode(statusText) : 0;
+        if (statusCode < 200 || statusCode >= 300)
+            continue;
+        const tinyxml2::XMLElement *prop = firstChildByLocal(propStat, "prop");
+        parsePropElement(prop, parsed);
+        consumedPropStat = true;
+    }
+
+    if (!consumedPropStat) {
+        const tinyxml2::XMLElement *prop = firstChildByLocal(elem, "prop");
+        parsePropElement(prop, parsed);
+    }
+    return true;
+}
+
 bool parsePropfindResponse(const std::string &xml,
                            std::vector<WebDavResource> &resources,
                            std::string &err) {
@@ -588,39 +716,9 @@ bool parsePropfindResponse(const std::string &xml,
         if (!xmlNameEquals(elem, "response"))
             continue;
 
-        const tinyxml2::XMLElement *hrefEl = firstChildByLocal(elem, "href");
-        const char *hrefTxt = hrefEl ? hrefEl->GetText() : nullptr;
-        if (!hrefTxt || !*hrefTxt)
-            continue;
-
-        const std::string hrefRaw(hrefTxt);
         WebDavResource parsed;
-        parsed.path = normalizeRemotePath(
-            decodePercent(extractPathFromHref(hrefRaw)));
-        if (hrefRaw.back() == '/')
-            parsed.isDir = true;
-
-        bool consumedPropStat = false;
-        for (const tinyxml2::XMLElement *propStat = elem->FirstChildElement();
-             propStat; propStat = propStat->NextSiblingElement()) {
-            if (!xmlNameEquals(propStat, "propstat"))
-                continue;
-            const tinyxml2::XMLElement *statusEl =
-                firstChildByLocal(propStat, "status");
-            const char *statusText = statusEl ? statusEl->GetText() : nullptr;
-            const int statusCode =
-                statusText ? parseHttpStatusCode(statusText) : 0;
-            if (statusCode < 200 || statusCode >= 300)
-                continue;
-            const tinyxml2::XMLElement *prop = firstChildByLocal(propStat, "prop");
-            parsePropElement(prop, parsed);
-            consumedPropStat = true;
-        }
-
-        if (!consumedPropStat) {
-            const tinyxml2::XMLElement *prop = firstChildByLocal(elem, "prop");
-            parsePropElement(prop, parsed);
-        }
+        if (!parseResponseElement(elem, parsed))
+            continue;
 
         auto it = std::find_if(resources.begin(), resources.end(),
                                [&parsed](const WebDavResource &r) {
@@ -668,6 +766,19 @@ bool isDirectChildPath(const std::string &parentPath, const std::string &path,
     return true;
 }
 
+FileInfo fileInfoFromResource(const WebDavResource &r, std::string name) {
+    FileInfo info{};
+    info.name = std::move(name);
+    info.is_dir = r.isDir;
+    if (r.hasSize) {
+        info.has_size = true;
+        info.size = r.size;
+    }
+    if (r.hasMtime)
+        info.mtime = r.mtime;
+    return info;
+}
+
 bool isSuccessStatus(long status) { return status >= 200 && status < 300; }
 
 bool isPathMissingStatus(long status) { return status == 404; }
@@ -681,17 +792,238 @@ const std::string &propfindBody() {
     return body;
 }
 
-bool performPropfind(const SessionOptions &opt, const std::string &remotePath,
+bool performPropfind(CurlHandleCache &handles, const SessionOptions &opt,
+                     const std::string &remotePath,
                      int depth, WebDavResponse &response, std::string &err) {
     const std::string body = propfindBody();
     std::vector<std::string> headers = {
         "Depth: " + std::to_string(depth),
         "Content-Type: application/xml; charset=utf-8",
     };
-    return performTextRequest(opt, "PROPFIND", remotePath, &body, headers,
-                              response, err);
+    return performTextRequest(handles, opt, "PROPFIND", remotePath, &body,
+                              headers, response, err);
+}
+
+// Incremental reader for PROPFIND multistatus bodies. It buffers at most one
+// <response> element and parses each one as soon as its end tag arrives, so
+// memory stays flat however many entries the server returns. tinyxml2 does
+// not resolve namespaces, so fragments parse without the root's xmlns.
+class PropfindStreamParser {
+    public:
+    using ResourceCB = std::function<bool(const WebDavResource &)>;
+
+    explicit PropfindStreamParser(ResourceCB onResource)
+        : onResource_(std::move(onResource)) {}
+
+    // false once the callback stopped the stream or an element was invalid.
+    bool feed(const char *data, std::size_t len) {
+        if (stopped_ || !error_.empty())
+            return false;
+        buf_.append(data, len);
+        for (;;) {
+            const std::size_t lt = buf_.find('<', scan_);
+            if (lt == std::string::npos) {
+                scan_ = buf_.size();
+                break;
+            }
+            const std::size_t gt = buf_.find('>', lt);
+            if (gt == std::string::npos) {
+                scan_ = lt; // tag continues in the next chunk
+                break;
+            }
+            scan_ = gt + 1;
+            std::size_t nameBegin = lt + 1;
+            const bool closing = nameBegin < gt && buf_[nameBegin] == '/';
+            if (closing)
+                ++nameBegin;
+            std::size_t nameEnd = nameBegin;
+            while (nameEnd < gt && buf_[nameEnd] != '/' &&
+                   std::isspace(static_cast<unsigned char>(buf_[nameEnd])) == 0)
+                ++nameEnd;
+            std::string_view name(buf_.data() + nameBegin, nameEnd - nameBegin);
+            const std::size_t colon = name.find(':');
+            if (colon != std::string_view::npos)
+                name.remove_prefix(colon + 1);
+            if (name != "response")
+                continue;
+            if (!closing) {
+                if (start_ == std::string::npos)
+                    start_ = lt;
+                continue;
+            }
+            if (start_ == std::string::npos)
+                continue;
+            if (!emitElement(start_, gt + 1))
+                return false;
+            buf_.erase(0, gt + 1);
+            scan_ = 0;
+            start_ = std::string::npos;
+        }
+        // Outside a <response> only an unfinished tag is worth keeping.
+        if (start_ == std::string::npos) {
+            buf_.erase(0, scan_);
+            scan_ = 0;
+        }
+        return true;
+    }
+
+    // Call after the last chunk.
+    bool finish(std::string &err) const {
+        if (!error_.empty()) {
+            err = error_;
+            return false;
+        }
+        if (start_ != std::string::npos) {
+            err = "WebDAV PROPFIND response ended inside a response element.";
+            return false;
+        }
+        if (resources_ == 0) {
+            err = "WebDAV PROPFIND response does not contain usable resources.";
+            return false;
+        }
+        return true;
+    }
+
+    bool stopped() const { return stopped_; }
+
+    private:
+    bool emitElement(std::size_t begin, std::size_t end) {
+        tinyxml2::XMLDocument doc;
+        const tinyxml2::XMLError parseErr =
+            doc.Parse(buf_.data() + begin, end - begin);
+        if (parseErr != tinyxml2::XML_SUCCESS) {
+            std::ostringstream out;
+            out << "Could not parse WebDAV PROPFIND response (XML error "
+                << static_cast<int>(parseErr) << ").";
+            error_ = out.str();
+            return false;
+        }
+        WebDavResource parsed;
+        if (!parseResponseElement(doc.RootElement(), parsed))
+            return true;
+        ++resources_;
+        if (onResource_ && !onResource_(parsed)) {
+            stopped_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    ResourceCB onResource_;
+    std::string buf_;
+    std::size_t scan_ = 0;                  // next byte to inspect
+    std::size_t start_ = std::string::npos; // open <response> in buf_
+    std::size_t resources_ = 0;
+    bool stopped_ = false;
+    std::string error_;
+};
+
+struct PropfindStreamContext {
+    CURL *curl = nullptr;
+    PropfindStreamParser *parser = nullptr;
+    long statusCode = 0;
+    std::string errorBody; // non-multistatus replies (bounded)
+};
+
+constexpr std::size_t kMaxPropfindErrorBody = 64 * 1024;
+
+size_t streamPropfindChunk(char *ptr, size_t size, size_t nmemb,
+                           void *userdata) {
+    auto *ctx = static_cast<PropfindStreamContext *>(userdata);
+    if (!ctx || !ctx->parser)
+        return 0;
+    const size_t total = size * nmemb;
+    if (ctx->statusCode == 0)
+        (void)curl_easy_getinfo(ctx->curl, CURLINFO_RESPONSE_CODE,
+                                &ctx->statusCode);
+    if (ctx->statusCode != 207) {
+        const size_t room = kMaxPropfindErrorBody - std::min(
+                                kMaxPropfindErrorBody, ctx->errorBody.size());
+        ctx->errorBody.append(ptr, std::min(total, room));
+        return total;
+    }
+    return ctx->parser->feed(ptr, total) ? total : 0;
 }
 
+// PROPFIND whose multistatus body is parsed while it downloads.
+bool performStreamingPropfind(CurlHandleCache &handles,
+                              const SessionOptions &opt,
+                              const std::string &remotePath, const char *depth,
+                              PropfindStreamParser &parser,
+                              const std::atomic<bool> *interrupted,
+                              long &statusCodeOut, std::string &err) {
+    statusCodeOut = 0;
+    CurlHandleCache::Lease lease(handles);
+    CURL *curl = lease.get();
+    if (!curl) {
+        err = "Could not create CURL handle.";
+        return false;
+    }
+    if (!configureCommonCurlHandle(curl, opt, err)) {
+        return false;
+    }
+
+    const std::string &body = propfindBody();
+    const std::string url = buildWebDavUrl(opt, remotePath);
+    struct curl_slist *headerList = nullptr;
+    headerList = curl_slist_append(headerList,
+                                   (std::string("Depth: ") + depth).c_str());
+    headerList = curl_slist_append(
+        headerList, "Content-Type: application/xml; charset=utf-8");
+
+    PropfindStreamContext ctx;
+    ctx.curl = curl;
+    ctx.parser = &parser;
+    const bool configured =
+        (curl_easy_setopt(curl, CURLOPT_URL, url.c_str()) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PROPFIND") ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, streamPropfindChunk) ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ctx) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str()) ==
+         CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE,
+                          static_cast<long>(body.size())) == CURLE_OK) &&
+        // Whole trees can stream for longer than the request timeout; give
+        // up on stalls instead.
+        (curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0L) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L) == CURLE_OK) &&
+        (curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L) == CURLE_OK);
+    if (!configured) {
+        err = "Could not configure WebDAV PROPFIND request.";
+        curl_slist_free_all(headerList);
+        return false;
+    }
+
+    ProgressContext progress{{}, {}, interrupted};
+    const CURLcode rc = lease.perform(transferProgressCallback, &progress);
+    (void)curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &statusCodeOut);
+    curl_slist_free_all(headerList);
+    if (rc != CURLE_OK) {
+        if (parser.stopped())
+            err = "Canceled by user";
+        else if (interrupted && interrupted->load())
+            err = "Interrupted";
+        else if (rc == CURLE_WRITE_ERROR)
+            (void)parser.finish(err);
+        else
+            err = std::string("WebDAV PROPFIND failed: ") +
+                  curl_easy_strerror(rc);
+        return false;
+    }
+    return true;
+}
+
+// Servers may refuse Depth: infinity (RFC 4918 propfind-finite-depth).
+bool isDepthInfinityRefused(long status) {
+    return status == 403 || status == 400 || status == 501;
+}
+
+// Depth: 1 requests in flight when walking a tree level by level.
+constexpr int kTreeWalkParallelism = 4;
+
 bool unsupportedWebDavOperation(const char *what, std::string &err) {
     err = std::string("WebDAV backend does not support ") + what + ".";
     return false;
@@ -699,6 +1031,9 @@ bool unsupportedWebDavOperation(const char *what, std::string &err) {
 
 } // namespace
 
+CurlWebDavClient::CurlWebDavClient()
+    : handles_(std::make_shared<CurlHandleCache>()) {}
+
 bool CurlWebDavClient::connect(const SessionOptions &opt, std::string &err) {
     err.clear();
     interrupted_.store(false);
@@ -724,7 +1059,7 @@ bool CurlWebDavClient::connect(const SessionOptions &opt, std::string &err) {
     normalized.protocol = Protocol::WebDav;
 
     WebDavResponse probe;
-    if (!performPropfind(normalized, "/", 0, probe, err))
+    if (!performPropfind(*handles_, normalized, "/", 0, probe, err))
         return false;
     if (!isSuccessStatus(probe.statusCode)) {
         err = formatHttpFailure("WebDAV connect probe", probe.statusCode);
@@ -741,6 +1076,7 @@ bool CurlWebDavClient::connect(const SessionOptions &opt, std::string &err) {
 
 void CurlWebDavClient::disconnect() {
     interrupted_.store(false);
+    handles_->reset();
     std::lock_guard<std::mutex> lk(stateMutex_);
     connected_ = false;
     options_ = SessionOptions{};
@@ -758,8 +1094,33 @@ bool CurlWebDavClient::isConnected() const {
 
 bool CurlWebDavClient::list(const std::string &remote_path,
                             std::vector<FileInfo> &out, std::string &err) {
-    err.clear();
     out.clear();
+    if (!listStream(
+            remote_path,
+            [&out](std::vector<FileInfo> &&batch) {
+                out.insert(out.end(), std::make_move_iterator(batch.begin()),
+                           std::make_move_iterator(batch.end()));
+                return true;
+            },
+            err)) {
+        return false;
+    }
+
+    std::sort(out.begin(), out.end(),
+              [](const FileInfo &a, const FileInfo &b) {
+                  const std::string al = toLowerAscii(a.name);
+                  const std::string bl = toLowerAscii(b.name);
+                  if (al == bl)
+                      return a.name < b.name;
+                  return al < bl;
+              });
+    return true;
+}
+
+bool CurlWebDavClient::listStream(const std::string &remote_path,
+                                  const ListBatchCB &onBatch,
+                                  std::string &err) {
+    err.clear();
     SessionOptions opt;
     {
         std::lock_guard<std::mutex> lk(stateMutex_);
@@ -774,46 +1135,173 @@ bool CurlWebDavClient::list(const std::string &remote_path,
         return false;
 
     const std::string basePath = normalizeRemotePath(remote_path);
-    WebDavResponse response;
-    if (!performPropfind(opt, basePath, 1, response, err))
+    std::vector<FileInfo> batch;
+    PropfindStreamParser parser([&](const WebDavResource &r) {
+        std::string childName;
+        if (!isDirectChildPath(basePath, r.path, childName))
+            return true;
+        batch.push_back(fileInfoFromResource(r, std::move(childName)));
+        if (batch.size() < kListBatchSize)
+            return true;
+        std::vector<FileInfo> full;
+        full.swap(batch);
+        return onBatch(std::move(full));
+    });
+    long status = 0;
+    if (!performStreamingPropfind(*handles_, opt, basePath, "1", parser,
+                                  &interrupted_, status, err))
         return false;
-    if (isPathMissingStatus(response.statusCode)) {
+    if (isPathMissingStatus(status)) {
         err.clear();
         return false;
     }
-    if (!isSuccessStatus(response.statusCode)) {
-        err = formatHttpFailure("WebDAV PROPFIND", response.statusCode);
+    if (status != 207) {
+        err = formatHttpFailure("WebDAV PROPFIND", status);
         return false;
     }
+    if (!parser.finish(err))
+        return false;
+    if (!batch.empty() && !onBatch(std::move(batch))) {
+        err = "Canceled by user";
+        return false;
+    }
+    return true;
+}
 
-    std::vector<WebDavResource> resources;
-    if (!parsePropfindResponse(response.body, resources, err))
+bool CurlWebDavClient::listTree(const std::string &remote_dir,
+                                const TreeEntryCB &onEntry, std::string &err) {
+    err.clear();
+    SessionOptions opt;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_) {
+            err = "Not connected.";
+            return false;
+        }
+        opt = options_;
+    }
+
+    if (!ensureCurlInitialized(err))
         return false;
 
-    for (const WebDavResource &r : resources) {
-        std::string childName;
-        if (!isDirectChildPath(basePath, r.path, childName))
-            continue;
-        FileInfo info{};
-        info.name = childName;
-        info.is_dir = r.isDir;
-        if (r.hasSize) {
-            info.has_size = true;
-            info.size = r.size;
+    const std::string root = normalizeRemotePath(remote_dir);
+    const std::string rootDir = normalizeRemoteDirPath(root);
+    std::mutex emitMtx; // onEntry runs on one thread at a time
+    auto emit = [&](const WebDavResource &r) {
+        if (r.path == root || r.path.rfind(rootDir, 0) != 0)
+            return true;
+        const std::size_t slash = r.path.find_last_of('/');
+        const std::string parent =
+            (slash == 0) ? std::string("/") : r.path.substr(0, slash);
+        const FileInfo info = fileInfoFromResource(r, r.path.substr(slash + 1));
+        std::lock_guard<std::mutex> lk(emitMtx);
+        return onEntry(parent, info);
+    };
+
+    // One request for the whole tree where the server allows it.
+    {
+        PropfindStreamParser parser(emit);
+        long status = 0;
+        if (!performStreamingPropfind(*handles_, opt, root, "infinity", parser,
+                                      &interrupted_, status, err))
+            return false;
+        if (isPathMissingStatus(status)) {
+            err.clear();
+            return false;
+        }
+        if (status == 207)
+            return parser.finish(err);
+        if (!isDepthInfinityRefused(status)) {
+            err = formatHttpFailure("WebDAV PROPFIND", status);
+            return false;
         }
-        if (r.hasMtime)
-            info.mtime = r.mtime;
-        out.push_back(std::move(info));
     }
 
-    std::sort(out.begin(), out.end(),
-              [](const FileInfo &a, const FileInfo &b) {
-                  const std::string al = toLowerAscii(a.name);
-                  const std::string bl = toLowerAscii(b.name);
-                  if (al == bl)
-                      return a.name < b.name;
-                  return al < bl;
-              });
+    // Otherwise walk level by level with a few Depth: 1 requests in flight;
+    // on HTTP/2 the session's engine multiplexes them over one connection.
+    struct WalkState {
+        std::mutex m;
+        std::condition_variable cv;
+        std::deque<std::string> frontier;
+        int inFlight = 0;
+        bool stop = false;
+        std::size_t failedDirs = 0;
+        std::string firstErr;
+    } st;
+    st.frontier.push_back(root);
+
+    auto walker = [&](CurlHandleCache &handles) {
+        for (;;) {
+            std::string dir;
+            {
+                std::unique_lock<std::mutex> lk(st.m);
+                st.cv.wait(lk, [&] {
+                    return st.stop || !st.frontier.empty() || st.inFlight == 0;
+                });
+                if (st.stop || st.frontier.empty())
+                    return;
+                dir = std::move(st.frontier.front());
+                st.frontier.pop_front();
+                ++st.inFlight;
+            }
+
+            std::vector<std::string> subdirs;
+            PropfindStreamParser parser([&](const WebDavResource &r) {
+                std::string childName;
+                if (!isDirectChildPath(dir, r.path, childName))
+                    return true;
+                if (r.isDir)
+                    subdirs.push_back(r.path);
+                return emit(r);
+            });
+            long status = 0;
+            std::string dirErr;
+            bool ok = performStreamingPropfind(handles, opt, dir, "1", parser,
+                                               &interrupted_, status, dirErr);
+            if (ok && status != 207) {
+                dirErr = formatHttpFailure("WebDAV PROPFIND", status);
+                ok = false;
+            }
+            ok = ok && parser.finish(dirErr);
+
+            std::lock_guard<std::mutex> lk(st.m);
+            --st.inFlight;
+            if (ok) {
+                for (std::string &d : subdirs)
+                    st.frontier.push_back(std::move(d));
+            } else if (parser.stopped() || interrupted_.load()) {
+                st.stop = true;
+                st.firstErr = dirErr;
+            } else {
+                ++st.failedDirs;
+                if (st.firstErr.empty())
+                    st.firstErr = dirErr;
+            }
+            st.cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<CurlHandleCache>> extraHandles;
+    for (int i = 1; i < kTreeWalkParallelism; ++i) {
+        extraHandles.push_back(
+            std::make_unique<CurlHandleCache>(handles_->share()));
+        CurlHandleCache *handles = extraHandles.back().get();
+        threads.emplace_back([&walker, handles] { walker(*handles); });
+    }
+    walker(*handles_);
+    for (auto &th : threads)
+        th.join();
+
+    if (st.stop) {
+        err = st.firstErr;
+        return false;
+    }
+    if (st.failedDirs > 0) {
+        err = std::to_string(st.failedDirs) +
+              " WebDAV folder(s) could not be listed: " + st.firstErr;
+        return false;
+    }
     return true;
 }
 
@@ -839,18 +1327,25 @@ bool CurlWebDavClient::get(
     if (!ensureCurlInitialized(err))
         return false;
 
-    std::FILE *localFile = std::fopen(local.c_str(), "wb");
-    if (!localFile) {
+    LocalFileWriter localFile;
+    if (!localFile.open(local, LocalFileWriter::Mode::Truncate,
+                        localIoOptionsFrom(opt), err)) {
         err = "Could not open local file for writing.";
         return false;
     }
+    LocalFileCursor cursor;
+    cursor.writer = &localFile;
 
     ProgressContext ctx{progress, shouldCancel, &interrupted_};
     long statusCode = 0;
     CURLcode rc = CURLE_OK;
-    const bool ok = performDownloadRequest(opt, remote, localFile, ctx, err,
-                                           statusCode, rc);
-    std::fclose(localFile);
+    bool ok = performDownloadRequest(*handles_, opt, remote, cursor, ctx, err,
+                                     statusCode, rc);
+    std::string closeErr;
+    if (!localFile.close(closeErr) && ok) {
+        err = closeErr;
+        ok = false;
+    }
     if (!ok) {
         if (rc == CURLE_ABORTED_BY_CALLBACK) {
             if (shouldCancel && shouldCancel())
@@ -889,27 +1384,112 @@ bool CurlWebDavClient::put(
     if (!ensureCurlInitialized(err))
         return false;
 
-    std::uint64_t total = 0;
-    try {
-        total = std::filesystem::file_size(local);
-    } catch (...) {
-        err = "Could not determine local file size.";
-        return false;
-    }
-
-    std::FILE *localFile = std::fopen(local.c_str(), "rb");
-    if (!localFile) {
+    LocalFileReader localFile;
+    if (!localFile.open(local, localIoOptionsFrom(opt), err)) {
         err = "Could not open local file for reading.";
         return false;
     }
+    const std::uint64_t total = localFile.size();
+    LocalFileCursor cursor;
+    cursor.reader = &localFile;
 
     ProgressContext ctx{progress, shouldCancel, &interrupted_};
     long statusCode = 0;
     CURLcode rc = CURLE_OK;
     const bool ok = performUploadRequest(
-        opt, remote, localFile, static_cast<curl_off_t>(total), ctx, err,
-        statusCode, rc);
-    std::fclose(localFile);
+        *handles_, opt, remote, cursor, static_cast<curl_off_t>(total), ctx,
+        err, statusCode, rc);
+    localFile.close();
+    if (!ok) {
+        if (rc == CURLE_ABORTED_BY_CALLBACK) {
+            if (shouldCancel && shouldCancel())
+                err = "Canceled by user";
+            else if (interrupted_.load())
+                err = "Interrupted";
+        }
+        return false;
+    }
+    if (!(statusCode == 200 || statusCode == 201 || statusCode == 204)) {
+        err = formatHttpFailure("WebDAV PUT", statusCode);
+        return false;
+    }
+    return true;
+}
+
+bool CurlWebDavClient::readStream(const std::string &remote,
+                                  std::uint64_t offset, const ReadSink &sink,
+                                  std::string &err,
+                                  std::function<bool()> shouldCancel) {
+    err.clear();
+    SessionOptions opt;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_) {
+            err = "Not connected.";
+            return false;
+        }
+        opt = options_;
+    }
+    interrupted_.store(false);
+    if (!ensureCurlInitialized(err))
+        return false;
+
+    LocalFileCursor cursor;
+    cursor.sink = &sink;
+
+    ProgressContext ctx{{}, shouldCancel, &interrupted_};
+    long statusCode = 0;
+    CURLcode rc = CURLE_OK;
+    const bool ok = performDownloadRequest(*handles_, opt, remote, cursor, ctx,
+                                           err, statusCode, rc, offset);
+    if (!ok) {
+        if (rc == CURLE_ABORTED_BY_CALLBACK) {
+            if (shouldCancel && shouldCancel())
+                err = "Canceled by user";
+            else if (interrupted_.load())
+                err = "Interrupted";
+        } else if (rc == CURLE_HTTP_RETURNED_ERROR) {
+            err = formatHttpFailure("WebDAV GET", statusCode);
+        }
+        return false;
+    }
+    if (!isSuccessStatus(statusCode)) {
+        err = formatHttpFailure("WebDAV GET", statusCode);
+        return false;
+    }
+    return true;
+}
+
+bool CurlWebDavClient::writeStream(const std::string &remote, bool append,
+                                   const WriteSource &source, std::string &err,
+                                   std::function<bool()> shouldCancel) {
+    err.clear();
+    if (append) {
+        err = "WebDAV backend does not support resume.";
+        return false;
+    }
+    SessionOptions opt;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_) {
+            err = "Not connected.";
+            return false;
+        }
+        opt = options_;
+    }
+    interrupted_.store(false);
+    if (!ensureCurlInitialized(err))
+        return false;
+
+    LocalFileCursor cursor;
+    cursor.source = &source;
+
+    // Unknown length: curl sends the body with chunked transfer encoding.
+    ProgressContext ctx{{}, shouldCancel, &interrupted_};
+    long statusCode = 0;
+    CURLcode rc = CURLE_OK;
+    const bool ok = performUploadRequest(*handles_, opt, remote, cursor, -1,
+                                         ctx, err, statusCode, rc);
     if (!ok) {
         if (rc == CURLE_ABORTED_BY_CALLBACK) {
             if (shouldCancel && shouldCancel())
@@ -961,7 +1541,7 @@ bool CurlWebDavClient::stat(const std::string &remote_path, FileInfo &info,
 
     const std::string target = normalizeRemotePath(remote_path);
     WebDavResponse response;
-    if (!performPropfind(opt, target, 0, response, err))
+    if (!performPropfind(*handles_, opt, target, 0, response, err))
         return false;
     if (isPathMissingStatus(response.statusCode)) {
         err.clear();
@@ -1040,7 +1620,8 @@ bool CurlWebDavClient::mkdir(const std::string &remote_dir, std::string &err,
         opt = options_;
     }
     WebDavResponse response;
-    if (!performTextRequest(opt, "MKCOL", remote_dir, nullptr, {}, response, err))
+    if (!performTextRequest(*handles_, opt, "MKCOL", remote_dir, nullptr, {},
+                            response, err))
         return false;
     if (response.statusCode == 200 || response.statusCode == 201 ||
         response.statusCode == 204 || response.statusCode == 405) {
@@ -1050,6 +1631,35 @@ bool CurlWebDavClient::mkdir(const std::string &remote_dir, std::string &err,
     return false;
 }
 
+bool CurlWebDavClient::ping(std::uint32_t &rtt_ms, std::string &err) {
+    rtt_ms = 0;
+    err.clear();
+    SessionOptions opt;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_) {
+            err = "Not connected.";
+            return false;
+        }
+        opt = options_;
+    }
+    // OPTIONS on the reused handle: no body and no file system access.
+    WebDavResponse response;
+    const auto start = std::chrono::steady_clock::now();
+    if (!performTextRequest(*handles_, opt, "OPTIONS", "/", nullptr, {},
+                            response, err))
+        return false;
+    if (!isSuccessStatus(response.statusCode)) {
+        err = formatHttpFailure("WebDAV OPTIONS", response.statusCode);
+        return false;
+    }
+    rtt_ms = static_cast<std::uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    return true;
+}
+
 bool CurlWebDavClient::removeFile(const std::string &remote_path,
                                   std::string &err) {
     err.clear();
@@ -1063,7 +1673,8 @@ bool CurlWebDavClient::removeFile(const std::string &remote_path,
         opt = options_;
     }
     WebDavResponse response;
-    if (!performTextRequest(opt, "DELETE", remote_path, nullptr, {}, response, err))
+    if (!performTextRequest(*handles_, opt, "DELETE", remote_path, nullptr, {},
+                            response, err))
         return false;
     if (response.statusCode == 200 || response.statusCode == 204)
         return true;
@@ -1092,9 +1703,11 @@ bool CurlWebDavClient::rename(const std::string &from, const std::string &to,
     std::vector<std::string> headers = {
         "Destination: " + destination,
         std::string("Overwrite: ") + (overwrite ? "T" : "F"),
+        "Depth: infinity",
     };
     WebDavResponse response;
-    if (!performTextRequest(opt, "MOVE", from, nullptr, headers, response, err))
+    if (!performTextRequest(*handles_, opt, "MOVE", from, nullptr, headers,
+                            response, err))
         return false;
     if (response.statusCode == 200 || response.statusCode == 201 ||
         response.statusCode == 204) {
@@ -1104,9 +1717,57 @@ bool CurlWebDavClient::rename(const std::string &from, const std::string &to,
     return false;
 }
 
+// COPY with Depth: infinity duplicates a whole collection in one request.
+bool CurlWebDavClient::copyRemote(const std::string &from,
+                                  const std::string &to, std::string &err,
+                                  bool overwrite,
+                                  std::function<bool()> shouldCancel) {
+    (void)shouldCancel;
+    err.clear();
+    SessionOptions opt;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_) {
+            err = "Not connected.";
+            return false;
+        }
+        opt = options_;
+    }
+    if (overwrite) {
+        // Overwrite: T would delete a destination collection first.
+        bool srcIsDir = false;
+        bool dstIsDir = false;
+        std::string probeErr;
+        if (exists(to, dstIsDir, probeErr) &&
+            (dstIsDir || (exists(from, srcIsDir, probeErr) && srcIsDir))) {
+            err = "Destination already exists";
+            return false;
+        }
+    }
+    const std::string destination = buildWebDavUrl(opt, to);
+    std::vector<std::string> headers = {
+        "Destination: " + destination,
+        std::string("Overwrite: ") + (overwrite ? "T" : "F"),
+        "Depth: infinity",
+    };
+    WebDavResponse response;
+    if (!performTextRequest(*handles_, opt, "COPY", from, nullptr, headers,
+                            response, err))
+        return false;
+    if (response.statusCode == 201 || response.statusCode == 204)
+        return true;
+    if (response.statusCode == 412)
+        err = "Destination already exists";
+    else
+        err = formatHttpFailure("WebDAV COPY", response.statusCode);
+    return false;
+}
+
 std::unique_ptr<SftpClient>
 CurlWebDavClient::newConnectionLike(const SessionOptions &opt, std::string &err) {
     auto ptr = std::make_unique<CurlWebDavClient>();
+    // Clones resolve and resume TLS through this session's share handle.
+    ptr->handles_ = std::make_shared<CurlHandleCache>(handles_->share());
     SessionOptions normalized = opt;
     normalized.protocol = Protocol::WebDav;
     if (!ptr->connect(normalized, err))
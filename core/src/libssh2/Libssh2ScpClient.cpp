@@ -1,19 +1,72 @@
 // SCP backend module using libssh2 scp_send/scp_recv channels for file
 // transfers over SSH.
 #include "openscp/Libssh2ScpClient.hpp"
+#include "openscp/LocalFileIO.hpp"
 #include <libssh2.h>
+#include <libssh2_sftp.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <cstdio>
-#include <filesystem>
 #include <thread>
 #include <utility>
 #include <vector>
 
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+
 namespace openscp {
 namespace {
 
-constexpr std::size_t kScpChunkSize = 64 * 1024;
+// Large-file SFTP range readers: never split below this much per stream.
+constexpr std::uint64_t kMinScpRangeBytes = 1024 * 1024;
+constexpr std::uint32_t kMaxScpRangeStreams = 16;
+// Same bound as the session timeout that blocking transfer loops run
+// under: the non-blocking range loop gives up after this long without
+// any reader receiving data.
+constexpr std::chrono::seconds kScpRangeStallTimeout{20};
+
+// One SFTP channel reading the byte range [offset, end) of the remote file.
+struct SftpRangeReader {
+    LIBSSH2_SFTP *sftp = nullptr;
+    LIBSSH2_SFTP_HANDLE *handle = nullptr;
+    std::uint64_t offset = 0;
+    std::uint64_t end = 0;
+    std::vector<char> buffer;
+};
+
+void closeRangeReaders(std::vector<SftpRangeReader> &readers) {
+    for (auto &r : readers) {
+        if (r.handle)
+            (void)libssh2_sftp_close(r.handle);
+        if (r.sftp)
+            (void)libssh2_sftp_shutdown(r.sftp);
+        r.handle = nullptr;
+        r.sftp = nullptr;
+    }
+}
+
+// Wait (bounded) until the socket is ready in the direction libssh2 is
+// blocked on, so a non-blocking read loop does not spin.
+void waitSessionSocket(_LIBSSH2_SESSION *session, int sock, int timeoutMs) {
+    const int dir = libssh2_session_block_directions(session);
+    fd_set readFds;
+    fd_set writeFds;
+    FD_ZERO(&readFds);
+    FD_ZERO(&writeFds);
+    if (dir & LIBSSH2_SESSION_BLOCK_INBOUND)
+        FD_SET(sock, &readFds);
+    if (dir & LIBSSH2_SESSION_BLOCK_OUTBOUND)
+        FD_SET(sock, &writeFds);
+    timeval tv{};
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    (void)::select(sock + 1, &readFds, &writeFds, nullptr, &tv);
+}
 
 bool unsupportedScpOperation(const char *what, std::string &err) {
     err = std::string("SCP backend does not support ") + what + ".";
@@ -122,23 +175,58 @@ bool Libssh2ScpClient::get(
         return false;
     }
 
-    std::FILE *localFile = std::fopen(local.c_str(), "wb");
-    if (!localFile) {
+    const std::uint64_t remoteSize =
+        (fileInfo.st_size > 0) ? static_cast<std::uint64_t>(fileInfo.st_size)
+                               : 0;
+    const std::uint64_t threshold =
+        sessionOptions_ ? sessionOptions_->scp_large_file_threshold : 0;
+    if (threshold > 0 && remoteSize >= threshold && sftpFallbackEnabled()) {
+        // Big file: the size is known now, so drop the SCP stream before it
+        // fills the window and fetch the file as parallel SFTP ranges.
+        closeScpChannel(channel, false);
+        std::string rangeErr;
+        if (getViaParallelSftpRanges(remote, local, remoteSize, rangeErr,
+                                     progress, shouldCancel)) {
+            return true;
+        }
+        if (shouldCancel && shouldCancel()) {
+            err = "Canceled by user";
+            return false;
+        }
+        // No usable SFTP subsystem (or it failed): stay on plain SCP.
+        channel = libssh2_scp_recv2(session, remote.c_str(), &fileInfo);
+        if (!channel) {
+            err = "Could not reopen remote file for SCP download after "
+                  "parallel SFTP download failed: " +
+                  rangeErr;
+            return false;
+        }
+    }
+
+    const LocalIoOptions io = localIoOptions();
+    LocalFileWriter localFile;
+    if (!localFile.open(local, LocalFileWriter::Mode::Truncate, io, err)) {
         err = "Could not open local file for writing";
         closeScpChannel(channel, false);
         return false;
     }
+    auto discardLocal = [&]() {
+        std::string ignored;
+        (void)localFile.close(ignored);
+        (void)std::remove(local.c_str());
+    };
 
     const std::size_t total =
         (fileInfo.st_size > 0) ? static_cast<std::size_t>(fileInfo.st_size) : 0;
-    std::vector<char> buffer(kScpChunkSize);
+    if (total > 0)
+        (void)localFile.preallocate(total);
+    LocalIoBuffer buffer(io.buffer_size);
     std::size_t done = 0;
 
     while (true) {
         if (shouldCancel && shouldCancel()) {
             err = "Canceled by user";
-            std::fclose(localFile);
-            (void)std::remove(local.c_str());
+            discardLocal();
             closeScpChannel(channel, false);
             return false;
         }
@@ -150,8 +238,7 @@ bool Libssh2ScpClient::get(
             continue;
         }
         if (n < 0) {
-            std::fclose(localFile);
-            (void)std::remove(local.c_str());
+            discardLocal();
             closeScpChannel(channel, false);
             std::string scpErr = "SCP read failed";
             appendSessionErrorDetail(session, scpErr);
@@ -180,11 +267,9 @@ bool Libssh2ScpClient::get(
             continue;
         }
 
-        if (std::fwrite(buffer.data(), 1, static_cast<size_t>(n), localFile) !=
-            static_cast<size_t>(n)) {
-            err = "Local write failed";
-            std::fclose(localFile);
-            (void)std::remove(local.c_str());
+        if (!localFile.writeAt(done, buffer.data(), static_cast<size_t>(n),
+                               err)) {
+            discardLocal();
             closeScpChannel(channel, false);
             return false;
         }
@@ -194,8 +279,7 @@ bool Libssh2ScpClient::get(
             progress(done, total);
     }
 
-    if (std::fclose(localFile) != 0) {
-        err = "Could not finalize local file";
+    if (!localFile.close(err)) {
         (void)std::remove(local.c_str());
         closeScpChannel(channel, false);
         return false;
@@ -224,19 +308,11 @@ bool Libssh2ScpClient::put(
         return false;
     }
 
-    std::uint64_t total = 0;
-    try {
-        total = std::filesystem::file_size(local);
-    } catch (...) {
-        err = "Could not determine local file size";
+    const LocalIoOptions io = localIoOptions();
+    LocalFileReader localFile;
+    if (!localFile.open(local, io, err))
         return false;
-    }
-
-    std::FILE *localFile = std::fopen(local.c_str(), "rb");
-    if (!localFile) {
-        err = "Could not open local file for reading";
-        return false;
-    }
+    const std::uint64_t total = localFile.size();
 
     LIBSSH2_CHANNEL *channel = libssh2_scp_send64(
         session, remote.c_str(), 0644, static_cast<libssh2_int64_t>(total), 0,
@@ -244,7 +320,7 @@ bool Libssh2ScpClient::put(
     if (!channel) {
         std::string scpErr = "Could not open remote file for SCP upload";
         appendSessionErrorDetail(session, scpErr);
-        std::fclose(localFile);
+        localFile.close();
         if (!sftpFallbackEnabled()) {
             scpErr +=
                 " (SFTP fallback is disabled by the selected SCP mode)";
@@ -265,27 +341,28 @@ bool Libssh2ScpClient::put(
         return false;
     }
 
-    std::vector<char> buffer(kScpChunkSize);
+    // Mapped files are written to the channel straight from the page
+    // cache; the scratch buffer is only used by the read() fallback.
+    LocalIoBuffer buffer(localFile.mapped() ? 0 : io.buffer_size);
     std::size_t done = 0;
-    while (true) {
-        const std::size_t nread =
-            std::fread(buffer.data(), 1, buffer.size(), localFile);
+    while (done < total) {
+        const char *ptr = nullptr;
+        std::size_t nread = 0;
+        if (!localFile.read(done, io.buffer_size, buffer.data(), ptr, nread,
+                            err)) {
+            closeScpChannel(channel, false);
+            return false;
+        }
         if (nread == 0) {
-            if (std::ferror(localFile)) {
-                err = "Local read failed";
-                std::fclose(localFile);
-                closeScpChannel(channel, false);
-                return false;
-            }
-            break; // EOF
+            err = "Local file shrank during upload";
+            closeScpChannel(channel, false);
+            return false;
         }
 
-        char *ptr = buffer.data();
         std::size_t remaining = nread;
         while (remaining > 0) {
             if (shouldCancel && shouldCancel()) {
                 err = "Canceled by user";
-                std::fclose(localFile);
                 closeScpChannel(channel, false);
                 return false;
             }
@@ -295,7 +372,7 @@ bool Libssh2ScpClient::put(
                 continue;
             }
             if (wr < 0) {
-                std::fclose(localFile);
+                localFile.close();
                 closeScpChannel(channel, false);
                 std::string scpErr = "SCP write failed";
                 appendSessionErrorDetail(session, scpErr);
@@ -325,17 +402,55 @@ bool Libssh2ScpClient::put(
         }
     }
 
-    if (std::fclose(localFile) != 0) {
-        err = "Could not close local file";
-        closeScpChannel(channel, false);
-        return false;
-    }
+    localFile.close();
     closeScpChannel(channel, true);
     if (progress && total)
         progress(done, static_cast<std::size_t>(total));
     return true;
 }
 
+// Archive batches only need an exec channel, which the SCP transport has;
+// the tar stream runs on the shared session.
+bool Libssh2ScpClient::putBatch(const std::string &local_root,
+                                const std::vector<std::string> &relative_paths,
+                                const std::string &remote_root,
+                                std::string &err, const BatchFileCB &onFile,
+                                std::function<bool()> shouldCancel) {
+    if (!delegate_.isConnected()) {
+        err = "Not connected";
+        return false;
+    }
+    return delegate_.putBatch(local_root, relative_paths, remote_root, err,
+                              onFile, std::move(shouldCancel));
+}
+
+bool Libssh2ScpClient::getBatch(const std::string &remote_root,
+                                const std::vector<std::string> &relative_paths,
+                                const std::string &local_root,
+                                std::string &err, const BatchFileCB &onFile,
+                                std::function<bool()> shouldCancel) {
+    if (!delegate_.isConnected()) {
+        err = "Not connected";
+        return false;
+    }
+    return delegate_.getBatch(remote_root, relative_paths, local_root, err,
+                              onFile, std::move(shouldCancel));
+}
+
+bool Libssh2ScpClient::findEntries(const std::string &remote_dir,
+                                   const FindOptions &filter,
+                                   const FindEntryCB &onEntry, bool &partial,
+                                   std::string &err,
+                                   std::function<bool()> shouldCancel) {
+    partial = false;
+    if (!delegate_.isConnected()) {
+        err = "Not connected";
+        return false;
+    }
+    return delegate_.findEntries(remote_dir, filter, onEntry, partial, err,
+                                 std::move(shouldCancel));
+}
+
 bool Libssh2ScpClient::exists(const std::string &remote_path, bool &isDir,
                               std::string &err) {
     (void)remote_path;
@@ -458,10 +573,147 @@ bool Libssh2ScpClient::transferViaSftpFallbackPut(
     return ok;
 }
 
+bool Libssh2ScpClient::getViaParallelSftpRanges(
+    const std::string &remote, const std::string &local, std::uint64_t total,
+    std::string &err,
+    const std::function<void(std::size_t, std::size_t)> &progress,
+    const std::function<bool()> &shouldCancel) {
+    _LIBSSH2_SESSION *session = delegate_.sessionHandle();
+    const int sock = delegate_.socketHandle();
+    if (!session || sock < 0 || !sessionOptions_.has_value() || total == 0) {
+        err = "Not connected";
+        return false;
+    }
+
+    const LocalIoOptions io = localIoOptions();
+    std::uint64_t streams = std::clamp<std::uint32_t>(
+        sessionOptions_->scp_large_file_streams, 1, kMaxScpRangeStreams);
+    streams = std::min<std::uint64_t>(
+        streams, std::max<std::uint64_t>(1, total / kMinScpRangeBytes));
+    const std::uint64_t span = total / streams;
+
+    // Each reader gets its own SFTP channel (and so its own SSH window). If
+    // the server caps channels per session, the last reader that did open
+    // takes over the rest of the file.
+    std::vector<SftpRangeReader> readers;
+    readers.reserve(static_cast<std::size_t>(streams));
+    for (std::uint64_t i = 0; i < streams; ++i) {
+        SftpRangeReader r;
+        r.offset = i * span;
+        r.end = (i + 1 == streams) ? total : r.offset + span;
+        r.sftp = libssh2_sftp_init(session);
+        if (r.sftp) {
+            r.handle = libssh2_sftp_open_ex(
+                r.sftp, remote.c_str(), static_cast<unsigned>(remote.size()),
+                LIBSSH2_FXF_READ, 0, LIBSSH2_SFTP_OPENFILE);
+        }
+        if (!r.handle) {
+            if (r.sftp)
+                (void)libssh2_sftp_shutdown(r.sftp);
+            if (readers.empty()) {
+                err = "Could not open remote file over SFTP";
+                appendSessionErrorDetail(session, err);
+                return false;
+            }
+            readers.back().end = total;
+            break;
+        }
+        libssh2_sftp_seek64(r.handle, r.offset);
+        r.buffer.resize(io.buffer_size);
+        readers.push_back(std::move(r));
+    }
+
+    // Ranges arrive interleaved; positioned writes into a preallocated file
+    // avoid both seeking and a fragmented layout.
+    LocalFileWriter localFile;
+    if (!localFile.open(local, LocalFileWriter::Mode::Truncate, io, err)) {
+        closeRangeReaders(readers);
+        err = "Could not open local file for writing";
+        return false;
+    }
+    (void)localFile.preallocate(total);
+
+    // One thread drives every channel: the session is switched to
+    // non-blocking mode and each reader is polled in turn.
+    libssh2_session_set_blocking(session, 0);
+    std::uint64_t done = 0;
+    bool ok = true;
+    auto lastData = std::chrono::steady_clock::now();
+    while (ok) {
+        if (shouldCancel && shouldCancel()) {
+            err = "Canceled by user";
+            ok = false;
+            break;
+        }
+        bool active = false;
+        bool progressed = false;
+        for (auto &r : readers) {
+            if (r.offset >= r.end)
+                continue;
+            active = true;
+            const std::size_t want = static_cast<std::size_t>(
+                std::min<std::uint64_t>(r.buffer.size(), r.end - r.offset));
+            const ssize_t n =
+                libssh2_sftp_read(r.handle, r.buffer.data(), want);
+            if (n == LIBSSH2_ERROR_EAGAIN)
+                continue;
+            if (n <= 0) {
+                err = (n == 0) ? "Remote file shrank during download"
+                               : "Remote read failed";
+                if (n < 0)
+                    appendSessionErrorDetail(session, err);
+                ok = false;
+                break;
+            }
+            if (!localFile.writeAt(r.offset, r.buffer.data(),
+                                   static_cast<std::size_t>(n), err)) {
+                ok = false;
+                break;
+            }
+            r.offset += static_cast<std::uint64_t>(n);
+            done += static_cast<std::uint64_t>(n);
+            progressed = true;
+        }
+        if (!ok || !active)
+            break;
+        if (progressed) {
+            lastData = std::chrono::steady_clock::now();
+            if (progress)
+                progress(static_cast<std::size_t>(done),
+                         static_cast<std::size_t>(total));
+        } else if (std::chrono::steady_clock::now() - lastData >=
+                   kScpRangeStallTimeout) {
+            err = "Remote read timed out: no data for " +
+                  std::to_string(kScpRangeStallTimeout.count()) + " s";
+            ok = false;
+        } else {
+            waitSessionSocket(session, sock, 100);
+        }
+    }
+    libssh2_session_set_blocking(session, 1);
+    closeRangeReaders(readers);
+
+    std::string closeErr;
+    if (!localFile.close(closeErr) && ok) {
+        err = closeErr;
+        ok = false;
+    }
+    if (!ok) {
+        (void)std::remove(local.c_str());
+        return false;
+    }
+    return true;
+}
+
 bool Libssh2ScpClient::sftpFallbackEnabled() const {
     if (!sessionOptions_.has_value())
         return true;
     return sessionOptions_->scp_transfer_mode == ScpTransferMode::Auto;
 }
 
+LocalIoOptions Libssh2ScpClient::localIoOptions() const {
+    return sessionOptions_ ? localIoOptionsFrom(*sessionOptions_)
+                           : LocalIoOptions{};
+}
+
 } // namespace openscp
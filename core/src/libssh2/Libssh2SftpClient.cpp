@@ -1,20 +1,32 @@
 // libssh2 backend: manages TCP socket, SSH session, and SFTP channel.
 // Includes keepalive, known_hosts validation, and resume support.
 #include "openscp/Libssh2SftpClient.hpp"
+#include "openscp/ChunkDigest.hpp"
+#include "openscp/KnownHostsCache.hpp"
 #include "openscp/RuntimeLogging.hpp"
+#include "openscp/TarStream.hpp"
+#include "openscp/Trace.hpp"
 #include <libssh2.h>
 #include <libssh2_sftp.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cerrno>
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <future>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 #ifndef _WIN32
 #include <fcntl.h>
@@ -28,6 +40,8 @@
 // OpenSSL RNG for hashed known_hosts hostnames fallback.
 #include <openssl/rand.h>
 #else
+#include <sys/stat.h>
+#include <sys/utime.h>
 #include <windows.h>
 #endif
 #include <array>
@@ -44,6 +58,8 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -173,70 +189,6 @@ static void auditLogHostKey(const std::string &host, uint16_t port,
 static std::string posix_err(const char *where) {
     return std::string(where) + ": " + std::strerror(errno);
 }
-
-static bool ensure_parent_dir_0700(const std::string &path, std::string *why) {
-    std::string dir = path;
-    std::size_t p = dir.find_last_of('/');
-    if (p == std::string::npos)
-        dir = ".";
-    else
-        dir.resize(p);
-    struct ::stat st{};
-    if (::stat(dir.c_str(), &st) != 0) {
-        if (::mkdir(dir.c_str(), 0700) != 0) {
-            if (why)
-                *why = posix_err("mkdir");
-            return false;
-        }
-    } else if (::chmod(dir.c_str(), 0700) != 0) {
-        if (why)
-            *why = posix_err("chmod(dir)");
-        return false;
-    }
-    return true;
-}
-
-static bool fsync_parent_dir(const std::string &path, std::string *why) {
-    std::string dir = path;
-    std::size_t p = dir.find_last_of('/');
-    if (p == std::string::npos)
-        dir = ".";
-    else
-        dir.resize(p);
-    int dfd = ::open(dir.c_str(), O_RDONLY);
-    if (dfd < 0) {
-        if (why)
-            *why = posix_err("open(parent)");
-        return false;
-    }
-    if (::fsync(dfd) != 0) {
-        if (why)
-            *why = posix_err("fsync(parent)");
-        ::close(dfd);
-        return false;
-    }
-    if (::close(dfd) != 0) {
-        if (why)
-            *why = posix_err("close(parent)");
-        return false;
-    }
-    return true;
-}
-
-static bool write_all(int fd, const char *data, std::size_t len,
-                      std::string *why) {
-    std::size_t off = 0;
-    while (off < len) {
-        ssize_t w = ::write(fd, data + off, len - off);
-        if (w < 0) {
-            if (why)
-                *why = posix_err("write");
-            return false;
-        }
-        off += (std::size_t)w;
-    }
-    return true;
-}
 #else
 static std::string win_err(const char *where, DWORD code) {
     std::ostringstream oss;
@@ -265,6 +217,18 @@ integrity_policy_from_env(TransferIntegrityPolicy fallback) {
     return fallback;
 }
 
+static bool chunked_integrity_from_env(bool fallback) {
+    const char *raw = std::getenv("OPENSCP_TRANSFER_INTEGRITY_CHUNKS");
+    if (!raw || !*raw)
+        return fallback;
+    const std::string v(raw);
+    if (v == "1" || v == "true" || v == "on")
+        return true;
+    if (v == "0" || v == "false" || v == "off")
+        return false;
+    return fallback;
+}
+
 // Protect transfer workers from indefinite kernel-level socket blocking when
 // the peer/network disappears without a clean TCP close.
 static void apply_transfer_socket_timeouts(int sock) {
@@ -285,6 +249,39 @@ static void apply_transfer_socket_timeouts(int sock) {
 #endif
 }
 
+// Pipelining limits. The upper bounds keep a misconfigured site from asking
+// for an unbounded in-flight window (memory is reserved per transfer).
+static constexpr std::size_t kSftpDefaultPipelineDepth = 64;
+static constexpr std::size_t kSftpDefaultRequestSize = 32 * 1024;
+static constexpr std::size_t kSftpMaxPipelineDepth = 1024;
+static constexpr std::size_t kSftpMaxRequestSize = 256 * 1024;
+static constexpr std::size_t kSftpMaxInFlightBytes = 64 * 1024 * 1024;
+
+static std::size_t clamp_pipeline_depth(std::uint32_t v) {
+    if (v == 0)
+        return kSftpDefaultPipelineDepth;
+    return std::min<std::size_t>(v, kSftpMaxPipelineDepth);
+}
+
+static std::size_t clamp_request_size(std::uint32_t v) {
+    if (v == 0)
+        return kSftpDefaultRequestSize;
+    return std::clamp<std::size_t>(v, 4 * 1024, kSftpMaxRequestSize);
+}
+
+// libssh2_sftp_read() is itself a pipelined reader: every call tops up the
+// handle's queue of outstanding READ requests (sequential offsets, split
+// into protocol-sized packets) to four times the caller's buffer, and hands
+// the replies back in file order as they arrive. Sizing the buffer from the
+// configured window therefore keeps `depth` requests of `requestSize` bytes
+// in flight instead of stalling on one round trip per 64 KiB chunk.
+static std::size_t sftp_read_buffer_size(std::size_t depth,
+                                         std::size_t requestSize) {
+    const std::size_t window =
+        std::min(depth * requestSize, kSftpMaxInFlightBytes);
+    return std::max(window / 4, requestSize);
+}
+
 static bool seek_local_file(FILE *f, std::uint64_t off, std::string *why) {
 #ifdef _WIN32
     if (_fseeki64(f, (__int64)off, SEEK_SET) != 0) {
@@ -334,52 +331,6 @@ static bool get_local_file_size(const std::string &path, std::uint64_t &out,
 #endif
 }
 
-static bool flush_local_file(FILE *f, std::string *why) {
-    if (std::fflush(f) != 0) {
-        if (why)
-            *why = "fflush(local) failed";
-        return false;
-    }
-#ifdef _WIN32
-    const int fd = _fileno(f);
-    if (fd >= 0 && _commit(fd) != 0) {
-        if (why)
-            *why = "commit(local) failed";
-        return false;
-    }
-#else
-    const int fd = fileno(f);
-    if (fd >= 0 && ::fsync(fd) != 0) {
-        if (why)
-            *why = posix_err("fsync(local)");
-        return false;
-    }
-#endif
-    return true;
-}
-
-static bool replace_local_file_atomic(const std::string &from,
-                                      const std::string &to, std::string *why) {
-#ifndef _WIN32
-    if (::rename(from.c_str(), to.c_str()) != 0) {
-        if (why)
-            *why = posix_err("rename(.part->dest)");
-        return false;
-    }
-    if (!fsync_parent_dir(to, why))
-        return false;
-    return true;
-#else
-    if (!MoveFileExA(from.c_str(), to.c_str(),
-                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED)) {
-        if (why)
-            *why = win_err("MoveFileEx(.part->dest)", GetLastError());
-        return false;
-    }
-    return true;
-#endif
-}
-
 static bool rename_remote_with_fallback(LIBSSH2_SFTP *sftp,
                                         const std::string &from,
                                         const std::string &to, bool overwrite,
@@ -470,11 +421,119 @@ static bool transfer_cancel_requested(
     return shouldCancel && *shouldCancel && (*shouldCancel)();
 }
 
-static bool hash_local_range(const std::string &path, std::uint64_t offset,
-                             std::uint64_t length, Sha256Digest &out,
+// Incremental SHA-256 fed with the bytes as they stream through a transfer
+// loop, so integrity checks do not need a second pass over the data.
+struct Sha256Stream {
+    Sha256Stream() : ctx(EVP_MD_CTX_new()) {
+        ok = ctx && EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) == 1;
+    }
+    ~Sha256Stream() {
+        if (ctx)
+            EVP_MD_CTX_free(ctx);
+    }
+    Sha256Stream(const Sha256Stream &) = delete;
+    Sha256Stream &operator=(const Sha256Stream &) = delete;
+
+    void update(const void *data, std::size_t n) {
+        if (ok && n > 0 && EVP_DigestUpdate(ctx, data, n) != 1)
+            ok = false;
+    }
+
+    bool finish(Sha256Digest &out) {
+        unsigned int outLen = 0;
+        if (!ok || EVP_DigestFinal_ex(ctx, out.data(), &outLen) != 1 ||
+            outLen != SHA256_DIGEST_LENGTH)
+            ok = false;
+        return ok;
+    }
+
+    EVP_MD_CTX *ctx = nullptr;
+    bool ok = false;
+};
+
+// Double-buffered local reader for uploads: while the caller pushes one
+// block to the server, the following block is prepared on a helper thread
+// so local I/O overlaps network round trips. Over a mapped file, preparing
+// a block means faulting its pages in, and blocks are handed out without
+// copying; otherwise they are read into two alternating buffers. When
+// `hash` is set the blocks are also digested on that thread, in file order.
+struct LocalReadAhead {
+    LocalReadAhead(LocalFileReader &file, std::uint64_t offset,
+                   std::size_t blockSize, Sha256Stream *hash)
+        : file(file), offset(offset), blockSize(blockSize),
+          bufA(file.mapped() ? 0 : blockSize),
+          bufB(file.mapped() ? 0 : blockSize), hash(hash) {
+        schedule();
+    }
+    ~LocalReadAhead() {
+        if (pending.valid())
+            pending.wait();
+    }
+    LocalReadAhead(const LocalReadAhead &) = delete;
+    LocalReadAhead &operator=(const LocalReadAhead &) = delete;
+
+    // Hands out the next block (n == 0 at EOF). The pointer stays valid until
+    // the following call. Returns false on a local read error.
+    bool next(const char *&data, std::size_t &n) {
+        const Block b = pending.get();
+        if (b.n == 0 && failed)
+            return false;
+        data = b.data;
+        n = b.n;
+        if (n > 0)
+            schedule();
+        return true;
+    }
+
+    private:
+    struct Block {
+        const char *data = nullptr;
+        std::size_t n = 0;
+    };
+
+    void schedule() {
+        char *scratch = useA ? bufA.data() : bufB.data();
+        useA = !useA;
+        pending = std::async(std::launch::async, [this, scratch] {
+            Block b;
+            std::string why;
+            if (!file.read(offset, blockSize, scratch, b.data, b.n, why)) {
+                failed = true;
+                return Block{};
+            }
+            offset += b.n;
+            if (hash) {
+                hash->update(b.data, b.n);
+            } else if (file.mapped()) {
+                volatile char sink = 0;
+                for (std::size_t i = 0; i < b.n; i += 4096)
+                    sink = sink + b.data[i];
+            }
+            return b;
+        });
+    }
+
+    LocalFileReader &file;
+    std::uint64_t offset;
+    std::size_t blockSize;
+    LocalIoBuffer bufA;
+    LocalIoBuffer bufB;
+    bool useA = true;
+    Sha256Stream *hash;
+    std::future<Block> pending;
+    bool failed = false;
+};
+
+// Feed [offset, offset + length) of a local file into `h`.
+static bool feed_local_range(const std::string &path, std::uint64_t offset,
+                             std::uint64_t length, Sha256Stream &h,
                              std::string *why,
-                             const std::function<bool()> *shouldCancel =
-                                 nullptr) {
+                             const std::function<bool()> *shouldCancel) {
+    if (!h.ok) {
+        if (why)
+            *why = "Could not initialize local hash context";
+        return false;
+    }
     FILE *f = ::fopen(path.c_str(), "rb");
     if (!f) {
         if (why)
@@ -485,27 +544,12 @@ static bool hash_local_range(const std::string &path, std::uint64_t offset,
         std::fclose(f);
         return false;
     }
-    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
-    if (!ctx) {
-        if (why)
-            *why = "Could not initialize local hash context";
-        std::fclose(f);
-        return false;
-    }
-    if (EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1) {
-        if (why)
-            *why = "EVP_DigestInit_ex(local) failed";
-        EVP_MD_CTX_free(ctx);
-        std::fclose(f);
-        return false;
-    }
     std::array<unsigned char, 64 * 1024> buf{};
     std::uint64_t remain = length;
     while (remain > 0) {
         if (transfer_cancel_requested(shouldCancel)) {
             if (why)
                 *why = "Canceled by user";
-            EVP_MD_CTX_free(ctx);
             std::fclose(f);
             return false;
         }
@@ -515,41 +559,37 @@ static bool hash_local_range(const std::string &path, std::uint64_t offset,
         if (n == 0) {
             if (why)
                 *why = "Insufficient local read while hashing";
-            EVP_MD_CTX_free(ctx);
             std::fclose(f);
             return false;
         }
-        if (EVP_DigestUpdate(ctx, buf.data(), n) != 1) {
+        h.update(buf.data(), n);
+        if (!h.ok) {
             if (why)
                 *why = "EVP_DigestUpdate(local) failed";
-            EVP_MD_CTX_free(ctx);
             std::fclose(f);
             return false;
         }
         remain -= (std::uint64_t)n;
     }
-    unsigned int outLen = 0;
-    if (EVP_DigestFinal_ex(ctx, out.data(), &outLen) != 1 ||
-        outLen != SHA256_DIGEST_LENGTH) {
-        if (why)
-            *why = "EVP_DigestFinal_ex(local) failed";
-        EVP_MD_CTX_free(ctx);
-        std::fclose(f);
-        return false;
-    }
-    EVP_MD_CTX_free(ctx);
     std::fclose(f);
     return true;
 }
 
-static bool hash_local_full(const std::string &path, Sha256Digest &out,
-                            std::string *why,
-                            const std::function<bool()> *shouldCancel =
-                                nullptr) {
-    std::uint64_t sz = 0;
-    if (!get_local_file_size(path, sz, why))
+static bool hash_local_range(const std::string &path, std::uint64_t offset,
+                             std::uint64_t length, Sha256Digest &out,
+                             std::string *why,
+                             const std::function<bool()> *shouldCancel =
+                                 nullptr) {
+    OPENSCP_TRACE_SPAN("hash.local", "hash");
+    Sha256Stream h;
+    if (!feed_local_range(path, offset, length, h, why, shouldCancel))
+        return false;
+    if (!h.finish(out)) {
+        if (why)
+            *why = "EVP_DigestFinal_ex(local) failed";
         return false;
-    return hash_local_range(path, 0, sz, out, why, shouldCancel);
+    }
+    return true;
 }
 
 static bool hash_remote_range(LIBSSH2_SFTP *sftp, const std::string &remote,
@@ -557,6 +597,7 @@ static bool hash_remote_range(LIBSSH2_SFTP *sftp, const std::string &remote,
                               Sha256Digest &out, std::string *why,
                               const std::function<bool()> *shouldCancel =
                                   nullptr) {
+    OPENSCP_TRACE_SPAN("hash.remote_range", "hash");
     LIBSSH2_SFTP_HANDLE *rh =
         libssh2_sftp_open_ex(sftp, remote.c_str(), (unsigned)remote.size(),
                              LIBSSH2_FXF_READ, 0, LIBSSH2_SFTP_OPENFILE);
@@ -628,6 +669,7 @@ static bool hash_remote_full(LIBSSH2_SFTP *sftp, const std::string &remote,
                              Sha256Digest &out, std::string *why,
                              const std::function<bool()> *shouldCancel =
                                  nullptr) {
+    OPENSCP_TRACE_SPAN("hash.remote_full", "hash");
     LIBSSH2_SFTP_HANDLE *rh =
         libssh2_sftp_open_ex(sftp, remote.c_str(), (unsigned)remote.size(),
                              LIBSSH2_FXF_READ, 0, LIBSSH2_SFTP_OPENFILE);
@@ -693,258 +735,499 @@ static bool hash_remote_full(LIBSSH2_SFTP *sftp, const std::string &remote,
     return true;
 }
 
-static bool persist_known_hosts_atomic(LIBSSH2_KNOWNHOSTS *nh,
-                                       const std::string &khPath,
-                                       std::string *why) {
-    if (!nh) {
-        if (why)
-            *why = "known_hosts not initialized";
-        return false;
+static std::string shell_single_quote(const std::string &s) {
+    std::string out = "'";
+    for (char c : s) {
+        if (c == '\'')
+            out += "'\\''";
+        else
+            out += c;
     }
-    if (khPath.empty()) {
-        if (why)
-            *why = "empty known_hosts path";
-        return false;
+    out += "'";
+    return out;
+}
+
+// Parse the leading hex digest of `sha256sum`/`shasum -a 256` output.
+static bool parse_sha256_hex(const std::string &text, Sha256Digest &out) {
+    std::size_t pos = 0;
+    // GNU coreutils prefixes the line with '\' when the name was escaped.
+    if (pos < text.size() && text[pos] == '\\')
+        ++pos;
+    if (text.size() < pos + out.size() * 2)
+        return false;
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        return -1;
+    };
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        const int hi = nibble(text[pos + i * 2]);
+        const int lo = nibble(text[pos + i * 2 + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        out[i] = static_cast<unsigned char>((hi << 4) | lo);
     }
+    const std::size_t after = pos + out.size() * 2;
+    return after == text.size() || text[after] == ' ' || text[after] == '\n';
+}
 
-#ifndef _WIN32
-    if (!ensure_parent_dir_0700(khPath, why))
-        return false;
-    std::string tmp = khPath + ".tmpXXXXXX";
-    std::vector<char> tmpl(tmp.begin(), tmp.end());
-    tmpl.push_back('\0');
-    int fd = ::mkstemp(tmpl.data());
-    if (fd < 0) {
+// Ask the server to hash the file on its side. libssh2 has no API for the
+// SFTP "check-file" extension, so this runs sha256sum (or shasum) over an
+// exec channel on the same SSH transport; only the digest crosses the wire.
+static bool hash_remote_exec(LIBSSH2_SESSION *session,
+                             const std::string &remote, Sha256Digest &out,
+                             std::string *why,
+                             const std::function<bool()> *shouldCancel) {
+    OPENSCP_TRACE_SPAN("hash.remote_exec", "hash");
+    LIBSSH2_CHANNEL *ch = libssh2_channel_open_session(session);
+    if (!ch) {
         if (why)
-            *why = posix_err("mkstemp");
+            *why = "Could not open exec channel for remote hashing";
         return false;
     }
-    const std::string tmpPath(tmpl.data());
-    if (::close(fd) != 0) {
+    const std::string q = shell_single_quote(remote);
+    const std::string cmd = "sha256sum -- " + q +
+                            " 2>/dev/null || shasum -a 256 -- " + q +
+                            " 2>/dev/null";
+    if (libssh2_channel_exec(ch, cmd.c_str()) != 0) {
         if (why)
-            *why = posix_err("close(tmp)");
-        (void)::unlink(tmpPath.c_str());
+            *why = "Server refused exec request for remote hashing";
+        (void)libssh2_channel_free(ch);
         return false;
     }
-
-    if (libssh2_knownhost_writefile(nh, tmpPath.c_str(),
-                                    LIBSSH2_KNOWNHOST_FILE_OPENSSH) != 0) {
+    // The command reads no input. Without EOF an account forced into a
+    // stdin-reading command (e.g. ForceCommand internal-sftp) would wait
+    // for input forever instead of exiting.
+    (void)libssh2_channel_send_eof(ch);
+    std::string output;
+    std::array<char, 512> buf{};
+    while (true) {
+        if (transfer_cancel_requested(shouldCancel)) {
+            if (why)
+                *why = "Canceled by user";
+            (void)libssh2_channel_free(ch);
+            return false;
+        }
+        const ssize_t n = libssh2_channel_read(ch, buf.data(), buf.size());
+        if (n == LIBSSH2_ERROR_EAGAIN) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        if (n < 0) {
+            if (why)
+                *why = "Remote hash command read failed";
+            (void)libssh2_channel_free(ch);
+            return false;
+        }
+        if (n == 0) {
+            if (libssh2_channel_eof(ch))
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        if (output.size() < 4096)
+            output.append(buf.data(), (std::size_t)n);
+    }
+    (void)libssh2_channel_close(ch);
+    (void)libssh2_channel_wait_closed(ch);
+    const int exitStatus = libssh2_channel_get_exit_status(ch);
+    (void)libssh2_channel_free(ch);
+    if (exitStatus != 0 || !parse_sha256_hex(output, out)) {
         if (why)
-            *why = "libssh2_knownhost_writefile failed";
-        (void)::unlink(tmpPath.c_str());
+            *why = "Server-side sha256 is not available";
         return false;
     }
+    return true;
+}
 
-    if (::chmod(tmpPath.c_str(), 0600) != 0) {
-        if (why)
-            *why = posix_err("chmod(tmp)");
-        (void)::unlink(tmpPath.c_str());
-        return false;
+// Remote digest for final integrity checks: prefer the server-side hash and
+// only re-read the file over SFTP when the server cannot compute it. The
+// first failed exec attempt is remembered for the rest of the session.
+static bool hash_remote_full_server_side(LIBSSH2_SESSION *session,
+                                         LIBSSH2_SFTP *sftp,
+                                         const std::string &remote,
+                                         bool &serverHashUnavailable,
+                                         Sha256Digest &out, std::string *why,
+                                         const std::function<bool()>
+                                             *shouldCancel) {
+    if (!serverHashUnavailable) {
+        std::string execWhy;
+        if (hash_remote_exec(session, remote, out, &execWhy, shouldCancel))
+            return true;
+        if (transfer_cancel_requested(shouldCancel)) {
+            if (why)
+                *why = "Canceled by user";
+            return false;
+        }
+        serverHashUnavailable = true;
+        core_logf(CoreLogLevel::Debug,
+                  "Server-side hashing unavailable (%s); falling back to "
+                  "SFTP re-read",
+                  execWhy.c_str());
     }
+    return hash_remote_full(sftp, remote, out, why, shouldCancel);
+}
 
-    int fdw = ::open(tmpPath.c_str(), O_WRONLY);
-    if (fdw < 0) {
-        if (why)
-            *why = posix_err("open(tmp)");
-        (void)::unlink(tmpPath.c_str());
-        return false;
-    }
-    if (::fchmod(fdw, 0600) != 0) {
-        if (why)
-            *why = posix_err("fchmod(tmp)");
-        ::close(fdw);
-        (void)::unlink(tmpPath.c_str());
-        return false;
+// Archive batch transfers: tar runs on the server while the archive is
+// produced or parsed here, streaming through one exec channel.
+static constexpr std::size_t kArchiveChunkSize = 64 * 1024;
+
+// Wait (bounded) until the socket is ready in the direction libssh2 is
+// blocked on, so the non-blocking exec pump does not spin.
+static void wait_session_socket(LIBSSH2_SESSION *session, int sock,
+                                int timeoutMs) {
+    const int dir = libssh2_session_block_directions(session);
+    fd_set readFds;
+    fd_set writeFds;
+    FD_ZERO(&readFds);
+    FD_ZERO(&writeFds);
+    if (dir & LIBSSH2_SESSION_BLOCK_INBOUND)
+        FD_SET(sock, &readFds);
+    if (dir & LIBSSH2_SESSION_BLOCK_OUTBOUND)
+        FD_SET(sock, &writeFds);
+    timeval tv{};
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    (void)::select(sock + 1, &readFds, &writeFds, nullptr, &tv);
+}
+
+// Run `cmd` on an exec channel, feeding its stdin from produce() while its
+// stdout goes to consume(). Both directions are pumped in one non-blocking
+// loop, so a command that writes before it has read all of its input
+// (tar -c -T -) cannot stall against a full SSH window. produce() appends
+// the next input bytes and sets `done` after the last ones; a false return
+// from either callback aborts the command. Returns true once the command
+// ran to completion, whatever its exit status.
+static bool run_exec_stream(
+    LIBSSH2_SESSION *session, int sock, const std::string &cmd,
+    const std::function<bool(std::string &, bool &)> &produce,
+    const std::function<bool(const char *, std::size_t)> &consume,
+    int &exitStatus, std::string &stderrText, std::string &why,
+    const std::function<bool()> &shouldCancel) {
+    LIBSSH2_CHANNEL *ch = libssh2_channel_open_session(session);
+    if (!ch) {
+        why = "Could not open exec channel for remote command";
+        return false;
+    }
+    if (libssh2_channel_exec(ch, cmd.c_str()) != 0) {
+        why = "Server refused exec request for remote command";
+        (void)libssh2_channel_free(ch);
+        return false;
+    }
+    libssh2_session_set_blocking(session, 0);
+    std::string pending;
+    std::size_t pendingOff = 0;
+    bool inputDone = false;
+    bool eofSent = false;
+    bool inputCut = false; // the command stopped reading before the end
+    std::vector<char> buf(kArchiveChunkSize);
+    bool ok = true;
+    while (ok) {
+        if (shouldCancel && shouldCancel()) {
+            why = "Canceled by user";
+            ok = false;
+            break;
+        }
+        bool busy = false;
+        if (!eofSent) {
+            if (pendingOff == pending.size() && !inputDone) {
+                pending.clear();
+                pendingOff = 0;
+                if (!produce(pending, inputDone)) {
+                    ok = false;
+                    break;
+                }
+            }
+            if (pendingOff < pending.size()) {
+                const ssize_t n =
+                    libssh2_channel_write(ch, pending.data() + pendingOff,
+                                          pending.size() - pendingOff);
+                if (n > 0) {
+                    pendingOff += (std::size_t)n;
+                    busy = true;
+                } else if (n != LIBSSH2_ERROR_EAGAIN) {
+                    if (!libssh2_channel_eof(ch)) {
+                        why = "Remote command stream write failed";
+                        ok = false;
+                        break;
+                    }
+                    // The command exited early; its status says why.
+                    eofSent = true;
+                    inputCut = true;
+                }
+            } else if (inputDone) {
+                const int rc = libssh2_channel_send_eof(ch);
+                if (rc == 0) {
+                    eofSent = true;
+                    busy = true;
+                } else if (rc != LIBSSH2_ERROR_EAGAIN) {
+                    why = "Remote command stream write failed";
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        const ssize_t n = libssh2_channel_read(ch, buf.data(), buf.size());
+        if (n > 0) {
+            busy = true;
+            if (!consume(buf.data(), (std::size_t)n)) {
+                ok = false;
+                break;
+            }
+        } else if (n < 0 && n != LIBSSH2_ERROR_EAGAIN) {
+            why = "Remote command stream read failed";
+            ok = false;
+            break;
+        }
+        const ssize_t e =
+            libssh2_channel_read_stderr(ch, buf.data(), buf.size());
+        if (e > 0) {
+            busy = true;
+            if (stderrText.size() < 4096)
+                stderrText.append(buf.data(), (std::size_t)e);
+        }
+        if (n == 0 && e <= 0 && libssh2_channel_eof(ch))
+            break;
+        if (!busy)
+            wait_session_socket(session, sock, 100);
     }
-    if (::fsync(fdw) != 0) {
-        if (why)
-            *why = posix_err("fsync(tmp)");
-        ::close(fdw);
-        (void)::unlink(tmpPath.c_str());
+    libssh2_session_set_blocking(session, 1);
+    if (!ok) {
+        (void)libssh2_channel_free(ch);
         return false;
     }
-    if (::close(fdw) != 0) {
-        if (why)
-            *why = posix_err("close(tmp)");
-        (void)::unlink(tmpPath.c_str());
+    (void)libssh2_channel_close(ch);
+    (void)libssh2_channel_wait_closed(ch);
+    exitStatus = libssh2_channel_get_exit_status(ch);
+    (void)libssh2_channel_free(ch);
+    if (inputCut && exitStatus == 0) {
+        why = "Remote command stopped reading its input early";
         return false;
     }
+    return true;
+}
 
-    if (::rename(tmpPath.c_str(), khPath.c_str()) != 0) {
-        if (why)
-            *why = posix_err("rename(tmp->known_hosts)");
-        (void)::unlink(tmpPath.c_str());
-        return false;
-    }
-    if (!fsync_parent_dir(khPath, why))
+// Error text for a remote tool that exited with a failure status.
+static std::string exec_exit_error(const char *tool, int exitStatus,
+                                   const std::string &stderrText) {
+    if (exitStatus == 127)
+        return std::string(tool) + " is not available on the server";
+    std::string detail = stderrText.substr(0, stderrText.find('\n'));
+    while (!detail.empty() &&
+           std::isspace(static_cast<unsigned char>(detail.back())))
+        detail.pop_back();
+    std::string msg = std::string("Remote ") + tool +
+                      " failed (exit status " + std::to_string(exitStatus) +
+                      ")";
+    if (!detail.empty())
+        msg += ": " + detail;
+    return msg;
+}
+
+static std::string join_local_path(const std::string &root,
+                                   const std::string &rel) {
+    if (root.empty())
+        return rel;
+    if (root.back() == '/')
+        return root + rel;
+    return root + "/" + rel;
+}
+
+// Size, permission bits and mtime (epoch seconds) of a local regular file.
+static bool stat_local_file(const std::string &path, std::uint64_t &size,
+                            std::uint32_t &mode, std::uint64_t &mtime) {
+#ifndef _WIN32
+    struct stat st{};
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
         return false;
-    return true;
 #else
-    std::string tmpPath = khPath + ".tmp";
-    if (libssh2_knownhost_writefile(nh, tmpPath.c_str(),
-                                    LIBSSH2_KNOWNHOST_FILE_OPENSSH) != 0) {
-        if (why)
-            *why = "libssh2_knownhost_writefile failed";
+    struct _stat64 st{};
+    if (_stat64(path.c_str(), &st) != 0 || !(st.st_mode & _S_IFREG))
         return false;
-    }
-    HANDLE h = CreateFileA(tmpPath.c_str(), GENERIC_READ | GENERIC_WRITE,
-                           FILE_SHARE_READ, NULL, OPEN_EXISTING,
-                           FILE_ATTRIBUTE_NORMAL, NULL);
-    if (h == INVALID_HANDLE_VALUE) {
-        DWORD ec = GetLastError();
-        (void)DeleteFileA(tmpPath.c_str());
-        if (why)
-            *why = win_err("CreateFile(tmp)", ec);
-        return false;
-    }
-    if (!FlushFileBuffers(h)) {
-        DWORD ec = GetLastError();
-        CloseHandle(h);
-        (void)DeleteFileA(tmpPath.c_str());
-        if (why)
-            *why = win_err("FlushFileBuffers(tmp)", ec);
-        return false;
-    }
-    if (!CloseHandle(h)) {
-        DWORD ec = GetLastError();
-        (void)DeleteFileA(tmpPath.c_str());
-        if (why)
-            *why = win_err("CloseHandle(tmp)", ec);
-        return false;
-    }
-    if (!MoveFileExA(tmpPath.c_str(), khPath.c_str(),
-                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED)) {
-        DWORD ec = GetLastError();
-        (void)DeleteFileA(tmpPath.c_str());
-        if (why)
-            *why = win_err("MoveFileEx(tmp->known_hosts)", ec);
-        return false;
-    }
-    return true;
 #endif
+    size = (std::uint64_t)st.st_size;
+    mode = (std::uint32_t)(st.st_mode & 0777);
+    mtime = st.st_mtime > 0 ? (std::uint64_t)st.st_mtime : 0;
+    return true;
 }
 
+static void set_local_mtime(const std::string &path, std::uint64_t mtime) {
 #ifndef _WIN32
-static bool persist_text_atomic(const std::string &path,
-                                const std::string &content, std::string *why) {
-    if (path.empty()) {
-        if (why)
-            *why = "empty destination path";
-        return false;
-    }
-    if (!ensure_parent_dir_0700(path, why))
-        return false;
+    struct timeval tv[2]{};
+    tv[0].tv_sec = tv[1].tv_sec = (time_t)mtime;
+    (void)::utimes(path.c_str(), tv);
+#else
+    struct __utimbuf64 ub{};
+    ub.actime = ub.modtime = (__time64_t)mtime;
+    (void)_utime64(path.c_str(), &ub);
+#endif
+}
 
-    std::string tmp = path + ".tmpXXXXXX";
-    std::vector<char> tmpl(tmp.begin(), tmp.end());
-    tmpl.push_back('\0');
-    int fd = ::mkstemp(tmpl.data());
-    if (fd < 0) {
-        if (why)
-            *why = posix_err("mkstemp");
-        return false;
-    }
-    const std::string tmpPath(tmpl.data());
+// Delta uploads compare fixed blocks of at least 1 MiB; larger files use
+// larger blocks so the remote digest list stays small.
+static constexpr std::uint64_t kDeltaMinBlockSize = 1024 * 1024;
+static constexpr std::uint64_t kDeltaMaxBlocks = 8192;
 
-    if (!write_all(fd, content.data(), content.size(), why)) {
-        ::close(fd);
-        (void)::unlink(tmpPath.c_str());
-        return false;
-    }
-    if (::fchmod(fd, 0600) != 0) {
-        if (why)
-            *why = posix_err("fchmod(tmp)");
-        ::close(fd);
-        (void)::unlink(tmpPath.c_str());
-        return false;
-    }
-    if (::fsync(fd) != 0) {
-        if (why)
-            *why = posix_err("fsync(tmp)");
-        ::close(fd);
-        (void)::unlink(tmpPath.c_str());
-        return false;
-    }
-    if (::close(fd) != 0) {
-        if (why)
-            *why = posix_err("close(tmp)");
-        (void)::unlink(tmpPath.c_str());
-        return false;
-    }
-    if (::rename(tmpPath.c_str(), path.c_str()) != 0) {
-        if (why)
-            *why = posix_err("rename(tmp->known_hosts)");
-        (void)::unlink(tmpPath.c_str());
-        return false;
-    }
-    if (!fsync_parent_dir(path, why))
-        return false;
-    return true;
+static std::uint64_t delta_block_size(std::uint64_t size) {
+    std::uint64_t block = kDeltaMinBlockSize;
+    while (size / block > kDeltaMaxBlocks)
+        block *= 2;
+    return block;
 }
-#else
-static bool persist_text_atomic(const std::string &path,
-                                const std::string &content, std::string *why) {
-    if (path.empty()) {
-        if (why)
-            *why = "empty destination path";
-        return false;
-    }
 
-    std::string tmpPath = path + ".tmp";
-    HANDLE h = CreateFileA(tmpPath.c_str(), GENERIC_WRITE, 0, NULL,
-                           CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (h == INVALID_HANDLE_VALUE) {
-        if (why)
-            *why = win_err("CreateFile(tmp)", GetLastError());
-        return false;
-    }
-
-    const char *ptr = content.data();
-    std::size_t rem = content.size();
-    while (rem > 0) {
-        const DWORD chunk =
-            rem > static_cast<std::size_t>(0xFFFFFFFFu)
-                ? static_cast<DWORD>(0xFFFFFFFFu)
-                : static_cast<DWORD>(rem);
-        DWORD written = 0;
-        if (!WriteFile(h, ptr, chunk, &written, NULL) || written != chunk) {
-            DWORD ec = GetLastError();
-            (void)CloseHandle(h);
-            (void)DeleteFileA(tmpPath.c_str());
+// Shell snippet printing one sha256 line per `block`-sized block of the
+// first `blocks` blocks of `remote`, in order. GNU split hashes every block
+// in a single read pass; elsewhere a dd loop (POSIX) reads one block per
+// process.
+static std::string delta_digest_command(const std::string &remote,
+                                        std::uint64_t block,
+                                        std::uint64_t blocks) {
+    const std::string q = shell_single_quote(remote);
+    const std::string b = std::to_string(block);
+    return "if split --version >/dev/null 2>&1; then head -c " +
+           std::to_string(block * blocks) + " -- " + q + " | split -b " + b +
+           " --filter=sha256sum; else n=0; while [ $n -lt " +
+           std::to_string(blocks) + " ]; do dd if=" + q + " bs=" + b +
+           " skip=$n count=1 2>/dev/null | { sha256sum 2>/dev/null || "
+           "shasum -a 256; }; n=$((n+1)); done; fi";
+}
+
+// Run a command without input and collect (a bounded amount of) its output.
+static bool run_exec_capture(LIBSSH2_SESSION *session, int sock,
+                             const std::string &cmd, std::size_t maxOutput,
+                             std::string &output, int &exitStatus,
+                             std::string &why,
+                             const std::function<bool()> &shouldCancel) {
+    std::string stderrText;
+    auto produce = [](std::string &, bool &done) {
+        done = true;
+        return true;
+    };
+    auto consume = [&](const char *data, std::size_t len) {
+        if (output.size() + len > maxOutput) {
+            why = "Remote command produced too much output";
+            return false;
+        }
+        output.append(data, len);
+        return true;
+    };
+    return run_exec_stream(session, sock, cmd, produce, consume, exitStatus,
+                           stderrText, why, shouldCancel);
+}
+
+// Run a command that takes no input and whose stdout is not needed; its
+// stderr is kept for error messages.
+static bool run_exec_quiet(LIBSSH2_SESSION *session, int sock,
+                           const std::string &cmd, int &exitStatus,
+                           std::string &stderrText, std::string &why,
+                           const std::function<bool()> &shouldCancel) {
+    auto produce = [](std::string &, bool &done) {
+        done = true;
+        return true;
+    };
+    auto consume = [](const char *, std::size_t) { return true; };
+    return run_exec_stream(session, sock, cmd, produce, consume, exitStatus,
+                           stderrText, why, shouldCancel);
+}
+
+// Digests of the `chunk`-sized pieces of the first `length` bytes of a
+// remote file (the last piece may be short). The server computes them when
+// it can run commands; otherwise, and for the rest of the session once that
+// failed, the range is read back over SFTP in one pass if `sftpFallback`.
+static bool hash_remote_chunks(LIBSSH2_SESSION *session, int sock,
+                               LIBSSH2_SFTP *sftp, const std::string &remote,
+                               std::uint64_t length, std::uint64_t chunk,
+                               bool &serverHashUnavailable, bool sftpFallback,
+                               std::vector<Sha256Digest> &out,
+                               std::string *why,
+                               const std::function<bool()> &shouldCancel) {
+    OPENSCP_TRACE_SPAN("hash.remote_chunks", "hash");
+    out.clear();
+    const std::uint64_t count = (length + chunk - 1) / chunk;
+    if (count == 0)
+        return true;
+    if (!serverHashUnavailable) {
+        std::string text;
+        int exitStatus = -1;
+        std::string execWhy;
+        if (run_exec_capture(session, sock,
+                             delta_digest_command(remote, chunk, count),
+                             (std::size_t)(count + 1) * 128, text, exitStatus,
+                             execWhy, shouldCancel) &&
+            exitStatus == 0) {
+            for (std::size_t pos = 0; pos < text.size();) {
+                std::size_t nl = text.find('\n', pos);
+                if (nl == std::string::npos)
+                    nl = text.size();
+                Sha256Digest d{};
+                if (!parse_sha256_hex(text.substr(pos, nl - pos), d))
+                    break;
+                out.push_back(d);
+                pos = nl + 1;
+            }
+            if (out.size() == count)
+                return true;
+        }
+        out.clear();
+        if (shouldCancel && shouldCancel()) {
             if (why)
-                *why = win_err("WriteFile(tmp)", ec);
+                *why = "Canceled by user";
             return false;
         }
-        ptr += written;
-        rem -= written;
+        serverHashUnavailable = true;
+        core_logf(CoreLogLevel::Debug,
+                  "Server-side chunk hashing unavailable (%s); falling back "
+                  "to SFTP re-read",
+                  execWhy.empty() ? "bad output" : execWhy.c_str());
     }
-
-    if (!FlushFileBuffers(h)) {
-        DWORD ec = GetLastError();
-        (void)CloseHandle(h);
-        (void)DeleteFileA(tmpPath.c_str());
+    if (!sftpFallback) {
         if (why)
-            *why = win_err("FlushFileBuffers(tmp)", ec);
+            *why = "Server-side chunk hashing is not available";
         return false;
     }
-    if (!CloseHandle(h)) {
-        DWORD ec = GetLastError();
-        (void)DeleteFileA(tmpPath.c_str());
+
+    LIBSSH2_SFTP_HANDLE *rh =
+        libssh2_sftp_open_ex(sftp, remote.c_str(), (unsigned)remote.size(),
+                             LIBSSH2_FXF_READ, 0, LIBSSH2_SFTP_OPENFILE);
+    if (!rh) {
         if (why)
-            *why = win_err("CloseHandle(tmp)", ec);
+            *why = "Could not open remote file for hashing";
         return false;
     }
-    if (!MoveFileExA(tmpPath.c_str(), path.c_str(),
-                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED)) {
-        DWORD ec = GetLastError();
-        (void)DeleteFileA(tmpPath.c_str());
+    ChunkHasher hasher(chunk,
+                       [&out](const ChunkDigest &d) { out.push_back(d); });
+    std::vector<char> buf(256 * 1024);
+    std::uint64_t remain = length;
+    while (remain > 0) {
+        if (shouldCancel && shouldCancel()) {
+            if (why)
+                *why = "Canceled by user";
+            libssh2_sftp_close(rh);
+            return false;
+        }
+        const std::size_t want =
+            (std::size_t)std::min<std::uint64_t>(remain, buf.size());
+        const ssize_t n = libssh2_sftp_read(rh, buf.data(), want);
+        if (n <= 0) {
+            if (why)
+                *why = "Insufficient remote read while hashing";
+            libssh2_sftp_close(rh);
+            return false;
+        }
+        hasher.update(buf.data(), (std::size_t)n);
+        remain -= (std::uint64_t)n;
+    }
+    libssh2_sftp_close(rh);
+    if (!hasher.finish() || out.size() != count) {
         if (why)
-            *why = win_err("MoveFileEx(tmp->known_hosts)", ec);
+            *why = "Could not hash remote chunks";
         return false;
     }
     return true;
 }
-#endif
 
 // Simple Base64 encoder (standard, with '=' padding)
 static std::string b64encode(const unsigned char *data, std::size_t len) {
@@ -977,121 +1260,6 @@ static std::string b64encode(const unsigned char *data, std::size_t len) {
     return out;
 }
 
-static bool b64decode(const std::string &input,
-                      std::vector<unsigned char> &out) {
-    if (input.empty() || (input.size() % 4) != 0)
-        return false;
-    out.assign((input.size() / 4) * 3, 0);
-    int decoded =
-        EVP_DecodeBlock(out.data(),
-                        reinterpret_cast<const unsigned char *>(input.data()),
-                        static_cast<int>(input.size()));
-    if (decoded < 0)
-        return false;
-    int pad = 0;
-    if (!input.empty() && input.back() == '=')
-        ++pad;
-    if (input.size() > 1 && input[input.size() - 2] == '=')
-        ++pad;
-    decoded -= pad;
-    if (decoded < 0)
-        return false;
-    out.resize(static_cast<std::size_t>(decoded));
-    return true;
-}
-
-static bool parse_known_hosts_host_field(const std::string &line,
-                                         std::size_t &hostStart,
-                                         std::size_t &hostEnd) {
-    auto isSpace = [](unsigned char c) { return std::isspace(c) != 0; };
-    std::size_t i = 0;
-    while (i < line.size() && isSpace(static_cast<unsigned char>(line[i])))
-        ++i;
-    if (i >= line.size() || line[i] == '#')
-        return false;
-
-    auto readFieldEnd = [&](std::size_t from) {
-        std::size_t p = from;
-        while (p < line.size() && !isSpace(static_cast<unsigned char>(line[p])))
-            ++p;
-        return p;
-    };
-
-    hostStart = i;
-    hostEnd = readFieldEnd(i);
-    if (hostStart >= hostEnd)
-        return false;
-
-    if (line[hostStart] == '@') {
-        i = hostEnd;
-        while (i < line.size() && isSpace(static_cast<unsigned char>(line[i])))
-            ++i;
-        if (i >= line.size())
-            return false;
-        hostStart = i;
-        hostEnd = readFieldEnd(i);
-        if (hostStart >= hostEnd)
-            return false;
-    }
-    return true;
-}
-
-static bool token_matches_hashed_host(const std::string &token,
-                                      const std::string &hostToken) {
-    if (token.size() <= 4 || token[0] != '|' || token[1] != '1' ||
-        token[2] != '|')
-        return false;
-    const std::size_t sep = token.find('|', 3);
-    if (sep == std::string::npos || sep == 3 || sep + 1 >= token.size())
-        return false;
-
-    std::vector<unsigned char> salt;
-    std::vector<unsigned char> expectedMac;
-    if (!b64decode(token.substr(3, sep - 3), salt) ||
-        !b64decode(token.substr(sep + 1), expectedMac) || salt.empty() ||
-        expectedMac.empty()) {
-        return false;
-    }
-
-    unsigned char mac[EVP_MAX_MD_SIZE];
-    unsigned int macLen = 0;
-    if (!HMAC(EVP_sha1(), salt.data(), static_cast<int>(salt.size()),
-              reinterpret_cast<const unsigned char *>(hostToken.data()),
-              static_cast<int>(hostToken.size()), mac, &macLen)) {
-        return false;
-    }
-    if (expectedMac.size() != static_cast<std::size_t>(macLen))
-        return false;
-    return std::equal(expectedMac.begin(), expectedMac.end(), mac);
-}
-
-static bool line_matches_site_host(const std::string &line,
-                                   const std::vector<std::string> &targets) {
-    std::size_t hostStart = 0;
-    std::size_t hostEnd = 0;
-    if (!parse_known_hosts_host_field(line, hostStart, hostEnd))
-        return false;
-
-    std::size_t pos = hostStart;
-    while (pos <= hostEnd) {
-        std::size_t comma = line.find(',', pos);
-        if (comma == std::string::npos || comma > hostEnd)
-            comma = hostEnd;
-        const std::string token = line.substr(pos, comma - pos);
-        if (std::any_of(targets.begin(), targets.end(),
-                        [&token](const std::string &target) {
-                            return token == target ||
-                                   token_matches_hashed_host(token, target);
-                        })) {
-            return true;
-        }
-        if (comma == hostEnd)
-            break;
-        pos = comma + 1;
-    }
-    return false;
-}
-
 // Preference: write hashed hostnames to known_hosts (OpenSSH style) unless
 // disabled via env
 static bool useHashedKnownHosts() {
@@ -1254,7 +1422,82 @@ kbint_password_callback(const char *name, int name_len, const char *instruction,
     }
 }
 
-Libssh2SftpClient::Libssh2SftpClient() {
+// Recursive FIFO lock: libssh2 lets several threads use one session only
+// one at a time, and first-come ordering keeps a busy download from
+// starving the other channels when it yields between chunks.
+class TransportLock {
+    public:
+    void lock() {
+        std::unique_lock<std::mutex> lk(m_);
+        const std::thread::id me = std::this_thread::get_id();
+        if (owner_ == me) {
+            ++depth_;
+            return;
+        }
+        const std::uint64_t ticket = next_++;
+        cv_.wait(lk, [&] { return serving_ == ticket; });
+        owner_ = me;
+        depth_ = 1;
+    }
+    // Like lock(), but gives up (returning false) once `abort` is set;
+    // wake() makes waiters look at it again.
+    bool lock(const std::atomic<bool> &abort) {
+        std::unique_lock<std::mutex> lk(m_);
+        const std::thread::id me = std::this_thread::get_id();
+        if (owner_ == me) {
+            ++depth_;
+            return true;
+        }
+        if (abort.load())
+            return false;
+        const std::uint64_t ticket = next_++;
+        cv_.wait(lk, [&] { return serving_ == ticket || abort.load(); });
+        if (serving_ != ticket) {
+            abandoned_.insert(ticket);
+            return false;
+        }
+        owner_ = me;
+        depth_ = 1;
+        return true;
+    }
+    void unlock() {
+        std::lock_guard<std::mutex> lk(m_);
+        if (--depth_ > 0)
+            return;
+        owner_ = std::thread::id();
+        ++serving_;
+        while (abandoned_.erase(serving_) > 0)
+            ++serving_;
+        cv_.notify_all();
+    }
+    void wake() {
+        std::lock_guard<std::mutex> lk(m_);
+        cv_.notify_all();
+    }
+    // Hand the transport to the next waiting thread, if any. Only the
+    // outermost holder yields; a nested one keeps it.
+    void yield() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (depth_ != 1 || next_ == serving_ + 1)
+                return;
+        }
+        unlock();
+        lock();
+    }
+
+    private:
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::thread::id owner_;
+    int depth_ = 0;
+    std::uint64_t next_ = 0;
+    std::uint64_t serving_ = 0;
+    std::unordered_set<std::uint64_t> abandoned_; // tickets given up
+};
+
+Libssh2SftpClient::Libssh2SftpClient()
+    : io_(std::make_unique<TransportLock>()) {
     if (!g_libssh2_inited) {
         int rc = libssh2_init(0);
         (void)rc;
@@ -1281,6 +1524,48 @@ static void configure_tcp_keepalive(int s) {
 #endif
 }
 
+// Integer socket option as the OS reports it; 0 when it cannot be read.
+static std::uint32_t socket_int_option(int s, int level, int name) {
+    int v = 0;
+#ifdef _WIN32
+    int len = sizeof(v);
+#else
+    socklen_t len = sizeof(v);
+#endif
+    if (::getsockopt(s, level, name, reinterpret_cast<char *>(&v), &len) != 0 ||
+        v < 0)
+        return 0;
+    return static_cast<std::uint32_t>(v);
+}
+
+// SO_SNDBUF / SO_RCVBUF (zero: leave the OS default) and TCP_NODELAY. With
+// `raiseOnly` a buffer the OS already made at least that large is kept.
+static void configure_socket_buffers(int s, std::uint32_t sendBuf,
+                                     std::uint32_t recvBuf, bool nodelay,
+                                     bool raiseOnly) {
+    auto apply = [&](int name, std::uint32_t want) {
+        if (want == 0)
+            return;
+        std::uint32_t current = socket_int_option(s, SOL_SOCKET, name);
+#ifdef __linux__
+        current /= 2; // reported doubled (bookkeeping overhead)
+#endif
+        if (raiseOnly && current >= want)
+            return;
+        const int v = static_cast<int>(
+            std::min<std::uint32_t>(want, std::numeric_limits<int>::max()));
+        (void)::setsockopt(s, SOL_SOCKET, name,
+                           reinterpret_cast<const char *>(&v), sizeof(v));
+    };
+    apply(SO_SNDBUF, sendBuf);
+    apply(SO_RCVBUF, recvBuf);
+    if (nodelay) {
+        const int on = 1;
+        (void)::setsockopt(s, IPPROTO_TCP, TCP_NODELAY,
+                           reinterpret_cast<const char *>(&on), sizeof(on));
+    }
+}
+
 static bool set_socket_timeout_ms(int sock, int timeoutMs) {
     if (sock < 0)
         return false;
@@ -1381,8 +1666,61 @@ static bool socket_recv_until(int sock, const std::string &delimiter,
     return true;
 }
 
+// Milliseconds elapsed since `since`, for ConnectTimings.
+static std::uint32_t elapsed_ms(std::chrono::steady_clock::time_point since) {
+    const auto d = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - since);
+    return static_cast<std::uint32_t>(std::max<long long>(0, d.count()));
+}
+
+// Happy eyeballs (RFC 8305): a new attempt starts every
+// kConnectAttemptDelayMs (or as soon as one fails) while earlier ones are
+// still pending, so a dead address family costs one delay instead of a full
+// TCP timeout.
+static constexpr int kConnectAttemptDelayMs = 250;
+static constexpr int kTcpConnectTimeoutMs = 20000;
+
+// Resolved addresses reordered to alternate families, starting with the
+// family the resolver preferred (RFC 8305 section 4).
+static std::vector<const struct addrinfo *>
+interleave_address_families(const struct addrinfo *res) {
+    std::vector<const struct addrinfo *> first;
+    std::vector<const struct addrinfo *> other;
+    for (auto rp = res; rp != nullptr; rp = rp->ai_next)
+        (rp->ai_family == res->ai_family ? first : other).push_back(rp);
+    std::vector<const struct addrinfo *> out;
+    out.reserve(first.size() + other.size());
+    for (std::size_t i = 0; i < std::max(first.size(), other.size()); ++i) {
+        if (i < first.size())
+            out.push_back(first[i]);
+        if (i < other.size())
+            out.push_back(other[i]);
+    }
+    return out;
+}
+
+static std::string format_socket_address(const struct addrinfo *ai) {
+    char host[NI_MAXHOST];
+    char serv[NI_MAXSERV];
+    if (getnameinfo(ai->ai_addr, ai->ai_addrlen, host, sizeof(host), serv,
+                    sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+        return {};
+    if (ai->ai_family == AF_INET6)
+        return std::string("[") + host + "]:" + serv;
+    return std::string(host) + ":" + serv;
+}
+
+static bool set_socket_nonblocking(int s, bool on) {
+    const int flags = ::fcntl(s, F_GETFL, 0);
+    if (flags < 0)
+        return false;
+    const int next = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return next == flags || ::fcntl(s, F_SETFL, next) == 0;
+}
+
 static bool connect_tcp_endpoint(const std::string &host, uint16_t port,
-                                 int &sockOut, std::string &err) {
+                                 const SessionOptions &opt, int &sockOut,
+                                 std::string &err, ConnectTimings &timings) {
     sockOut = -1;
     struct addrinfo hints{};
     memset(&hints, 0, sizeof(hints));
@@ -1392,26 +1730,117 @@ static bool connect_tcp_endpoint(const std::string &host, uint16_t port,
     char portStr[16];
     snprintf(portStr, sizeof(portStr), "%u", static_cast<unsigned>(port));
 
+    // One AF_UNSPEC lookup: the resolver asks for A and AAAA in parallel.
+    const auto dnsStart = std::chrono::steady_clock::now();
     struct addrinfo *res = nullptr;
     int gai = getaddrinfo(host.c_str(), portStr, &hints, &res);
+    timings.dns_ms = elapsed_ms(dnsStart);
     if (gai != 0) {
         err = std::string("getaddrinfo: ") + gai_strerror(gai);
         return false;
     }
 
+    struct Attempt {
+        int fd = -1;
+        const struct addrinfo *ai = nullptr;
+    };
+    const auto addrs = interleave_address_families(res);
+    const auto tcpStart = std::chrono::steady_clock::now();
+    const auto deadline =
+        tcpStart + std::chrono::milliseconds(kTcpConnectTimeoutMs);
+    std::vector<Attempt> pending;
+    std::size_t next = 0;
+    auto nextStart = tcpStart;
+    Attempt winner;
     std::string lastConnectErr;
-    for (auto rp = res; rp != nullptr; rp = rp->ai_next) {
-        int s = ::socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-        if (s == -1)
+    while (winner.fd < 0) {
+        const auto now = std::chrono::steady_clock::now();
+        if (next < addrs.size() && (pending.empty() || now >= nextStart)) {
+            const struct addrinfo *rp = addrs[next++];
+            ++timings.tcp_attempts;
+            nextStart = now + std::chrono::milliseconds(kConnectAttemptDelayMs);
+            int s = ::socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+            if (s == -1) {
+                lastConnectErr = std::strerror(errno);
+                nextStart = now;
+                continue;
+            }
+            configure_tcp_keepalive(s);
+            // Before connect(): the window scale is fixed by the SYN.
+            configure_socket_buffers(s, opt.tcp_send_buffer,
+                                     opt.tcp_recv_buffer, opt.tcp_nodelay,
+                                     false);
+            if (!set_socket_nonblocking(s, true)) {
+                lastConnectErr = std::strerror(errno);
+                ::close(s);
+                nextStart = now;
+                continue;
+            }
+            if (::connect(s, rp->ai_addr, rp->ai_addrlen) == 0) {
+                winner = {s, rp};
+                break;
+            }
+            if (errno != EINPROGRESS) {
+                lastConnectErr = std::strerror(errno);
+                ::close(s);
+                nextStart = now;
+                continue;
+            }
+            pending.push_back({s, rp});
             continue;
-        configure_tcp_keepalive(s);
-        if (::connect(s, rp->ai_addr, rp->ai_addrlen) == 0) {
-            sockOut = s;
-            freeaddrinfo(res);
-            return true;
         }
-        lastConnectErr = std::strerror(errno);
-        ::close(s);
+        if (pending.empty())
+            break; // every address failed
+        if (now >= deadline) {
+            lastConnectErr = std::strerror(ETIMEDOUT);
+            break;
+        }
+
+        auto wakeAt = deadline;
+        if (next < addrs.size())
+            wakeAt = std::min(wakeAt, nextStart);
+        const int waitMs = static_cast<int>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - now)
+                .count());
+        std::vector<struct pollfd> fds(pending.size());
+        for (std::size_t i = 0; i < pending.size(); ++i)
+            fds[i] = {pending[i].fd, POLLOUT, 0};
+        const int ready = ::poll(fds.data(), fds.size(), std::max(0, waitMs));
+        if (ready < 0 && errno != EINTR) {
+            lastConnectErr = std::strerror(errno);
+            break;
+        }
+        for (std::size_t i = fds.size(); ready > 0 && i-- > 0;) {
+            if (fds[i].revents == 0)
+                continue;
+            int soErr = 0;
+            socklen_t len = sizeof(soErr);
+            if (::getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &soErr, &len) !=
+                0)
+                soErr = errno;
+            if (soErr == 0 && winner.fd < 0) {
+                winner = pending[i];
+            } else {
+                if (soErr != 0)
+                    lastConnectErr = std::strerror(soErr);
+                ::close(pending[i].fd);
+                // A failure lets the next address start right away.
+                nextStart = std::chrono::steady_clock::now();
+            }
+            pending.erase(pending.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+    }
+    for (const Attempt &a : pending)
+        if (a.fd != winner.fd)
+            ::close(a.fd);
+    timings.tcp_ms = elapsed_ms(tcpStart);
+
+    if (winner.fd >= 0) {
+        (void)set_socket_nonblocking(winner.fd, false);
+        timings.peer = format_socket_address(winner.ai);
+        freeaddrinfo(res);
+        sockOut = winner.fd;
+        return true;
     }
     freeaddrinfo(res);
     err = "Could not connect to host/port";
@@ -1861,7 +2290,8 @@ static bool establish_http_connect_tunnel(int sock, const SessionOptions &opt,
 }
 
 bool Libssh2SftpClient::tcpConnect(const SessionOptions &opt,
-                                   std::string &err) {
+                                   std::string &err,
+                                   ConnectTimings &timings) {
     const bool useJump = opt.jump_host.has_value() && !opt.jump_host->empty();
     const bool useProxy = (opt.proxy_type != ProxyType::None);
     if (useJump && useProxy) {
@@ -1877,7 +2307,11 @@ bool Libssh2SftpClient::tcpConnect(const SessionOptions &opt,
         int jumpSock = -1;
         int jumpPid = -1;
         int jumpStderrFd = -1;
-        if (!spawn_ssh_jump_tunnel(opt, jumpSock, jumpPid, jumpStderrFd, err))
+        const auto tunnelStart = std::chrono::steady_clock::now();
+        const bool spawned =
+            spawn_ssh_jump_tunnel(opt, jumpSock, jumpPid, jumpStderrFd, err);
+        timings.tunnel_ms = elapsed_ms(tunnelStart);
+        if (!spawned)
             return false;
         {
             std::lock_guard<std::mutex> lk(stateMutex_);
@@ -1901,10 +2335,12 @@ bool Libssh2SftpClient::tcpConnect(const SessionOptions &opt,
     }
 
     int socketFd = -1;
-    if (!connect_tcp_endpoint(endpointHost, endpointPort, socketFd, err))
+    if (!connect_tcp_endpoint(endpointHost, endpointPort, opt, socketFd, err,
+                              timings))
         return false;
 
     if (useProxy) {
+        const auto tunnelStart = std::chrono::steady_clock::now();
         constexpr int kProxyHandshakeTimeoutMs = 20000;
         (void)set_socket_timeout_ms(socketFd, kProxyHandshakeTimeoutMs);
         bool ok = false;
@@ -1916,6 +2352,7 @@ bool Libssh2SftpClient::tcpConnect(const SessionOptions &opt,
             err = "Unsupported proxy type.";
         }
         (void)set_socket_timeout_ms(socketFd, 0);
+        timings.tunnel_ms = elapsed_ms(tunnelStart);
         if (!ok) {
             ::close(socketFd);
             return false;
@@ -1926,9 +2363,37 @@ bool Libssh2SftpClient::tcpConnect(const SessionOptions &opt,
     return true;
 }
 
+static constexpr const char *kDefaultSshCiphers =
+    "chacha20-poly1305@openssh.com,aes256-gcm@openssh.com,"
+    "aes128-gcm@openssh.com,aes256-ctr,aes128-ctr";
+static constexpr const char *kDefaultSshMacs = "hmac-sha2-512,hmac-sha2-256";
+
+// "aes128-gcm@openssh.com, aes256-ctr" -> "aes128-gcm@openssh.com,aes256-ctr"
+static std::string normalize_algorithm_list(const std::string &list) {
+    std::string out;
+    std::string item;
+    auto flush = [&]() {
+        if (item.empty())
+            return;
+        if (!out.empty())
+            out += ',';
+        out += item;
+        item.clear();
+    };
+    for (char c : list) {
+        if (c == ',')
+            flush();
+        else if (!std::isspace(static_cast<unsigned char>(c)))
+            item += c;
+    }
+    flush();
+    return out;
+}
+
 bool Libssh2SftpClient::sshHandshakeAuth(const SessionOptions &opt,
                                          std::string &err,
-                                         bool initializeSftpSubsystem) {
+                                         bool initializeSftpSubsystem,
+                                         ConnectTimings &timings) {
     session_ = libssh2_session_init();
     if (!session_) {
         err = "libssh2_session_init failed";
@@ -1950,33 +2415,59 @@ bool Libssh2SftpClient::sshHandshakeAuth(const SessionOptions &opt,
         session_, LIBSSH2_METHOD_KEX,
         "curve25519-sha256,ecdh-sha2-nistp256,diffie-hellman-group14-sha256");
 #endif
-#ifdef LIBSSH2_METHOD_CRYPT_CS
-    (void)libssh2_session_method_pref(
-        session_, LIBSSH2_METHOD_CRYPT_CS,
-        "chacha20-poly1305@openssh.com,aes256-gcm@openssh.com,aes128-gcm@"
-        "openssh.com,aes256-ctr,aes128-ctr");
-#endif
-#ifdef LIBSSH2_METHOD_CRYPT_SC
-    (void)libssh2_session_method_pref(
-        session_, LIBSSH2_METHOD_CRYPT_SC,
-        "chacha20-poly1305@openssh.com,aes256-gcm@openssh.com,aes128-gcm@"
-        "openssh.com,aes256-ctr,aes128-ctr");
-#endif
-#ifdef LIBSSH2_METHOD_MAC_CS
-    (void)libssh2_session_method_pref(session_, LIBSSH2_METHOD_MAC_CS,
-                                      "hmac-sha2-512,hmac-sha2-256");
-#endif
-#ifdef LIBSSH2_METHOD_MAC_SC
-    (void)libssh2_session_method_pref(session_, LIBSSH2_METHOD_MAC_SC,
-                                      "hmac-sha2-512,hmac-sha2-256");
-#endif
+    // Ciphers and MACs: the site's lists when set (a list none of whose
+    // entries libssh2 knows is an error, not a silent fallback), otherwise
+    // AEAD first, then CTR with SHA-2 MACs.
+    const std::string ciphers =
+        opt.ssh_ciphers.empty() ? std::string(kDefaultSshCiphers)
+                                : normalize_algorithm_list(opt.ssh_ciphers);
+    const std::string macs = opt.ssh_macs.empty()
+                                 ? std::string(kDefaultSshMacs)
+                                 : normalize_algorithm_list(opt.ssh_macs);
+    if (!opt.ssh_ciphers.empty() && ciphers.empty()) {
+        err = "SSH cipher list is empty";
+        return false;
+    }
+    if (!opt.ssh_macs.empty() && macs.empty()) {
+        err = "SSH MAC list is empty";
+        return false;
+    }
+    for (int method : {LIBSSH2_METHOD_CRYPT_CS, LIBSSH2_METHOD_CRYPT_SC}) {
+        if (libssh2_session_method_pref(session_, method, ciphers.c_str()) !=
+                0 &&
+            !opt.ssh_ciphers.empty()) {
+            err = "None of the configured SSH ciphers are supported: " +
+                  ciphers;
+            return false;
+        }
+    }
+    for (int method : {LIBSSH2_METHOD_MAC_CS, LIBSSH2_METHOD_MAC_SC}) {
+        if (libssh2_session_method_pref(session_, method, macs.c_str()) != 0 &&
+            !opt.ssh_macs.empty()) {
+            err = "None of the configured SSH MACs are supported: " + macs;
+            return false;
+        }
+    }
+    // Compression is only offered when asked for; "none" stays acceptable
+    // so servers that refuse zlib still connect. libssh2 built without zlib
+    // simply negotiates "none".
+    if (opt.ssh_compression) {
+        (void)libssh2_session_flag(session_, LIBSSH2_FLAG_COMPRESS, 1);
+        for (int method : {LIBSSH2_METHOD_COMP_CS, LIBSSH2_METHOD_COMP_SC})
+            (void)libssh2_session_method_pref(session_, method,
+                                              "zlib@openssh.com,zlib,none");
+    }
 
     // Ensure blocking mode and bounded waits before handshake/auth.
     libssh2_session_set_blocking(session_, 1);
 #ifdef LIBSSH2_SESSION_TIMEOUT
     libssh2_session_set_timeout(session_, 20000); // 20s
 #endif
-    if (libssh2_session_handshake(session_, sock_) != 0) {
+    const auto kexStart = std::chrono::steady_clock::now();
+    const int handshakeRc = libssh2_session_handshake(session_, sock_);
+    timings.kex_ms = elapsed_ms(kexStart);
+    const auto hostKeyStart = std::chrono::steady_clock::now();
+    if (handshakeRc != 0) {
 #ifndef _WIN32
         if (opt.jump_host.has_value() && !opt.jump_host->empty() &&
             describeJumpTunnelFailure(err)) {
@@ -1987,6 +2478,31 @@ bool Libssh2SftpClient::sshHandshakeAuth(const SessionOptions &opt,
         return false;
     }
 
+    {
+        auto method = [this](int type) {
+            const char *name = libssh2_session_methods(session_, type);
+            return std::string(name ? name : "");
+        };
+        SshAlgorithms algos;
+        algos.kex = method(LIBSSH2_METHOD_KEX);
+        algos.host_key = method(LIBSSH2_METHOD_HOSTKEY);
+        algos.cipher_cs = method(LIBSSH2_METHOD_CRYPT_CS);
+        algos.cipher_sc = method(LIBSSH2_METHOD_CRYPT_SC);
+        algos.mac_cs = method(LIBSSH2_METHOD_MAC_CS);
+        algos.mac_sc = method(LIBSSH2_METHOD_MAC_SC);
+        algos.compression_cs = method(LIBSSH2_METHOD_COMP_CS);
+        algos.compression_sc = method(LIBSSH2_METHOD_COMP_SC);
+        core_logf(CoreLogLevel::Debug,
+                  "SSH negotiated kex=%s hostkey=%s cipher=%s/%s mac=%s/%s "
+                  "comp=%s/%s",
+                  algos.kex.c_str(), algos.host_key.c_str(),
+                  algos.cipher_cs.c_str(), algos.cipher_sc.c_str(),
+                  algos.mac_cs.c_str(), algos.mac_sc.c_str(),
+                  algos.compression_cs.c_str(), algos.compression_sc.c_str());
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        negotiated_ = std::move(algos);
+    }
+
     // SSH keepalive: request libssh2 to send messages every 30s if the peer
     // allows it
     libssh2_keepalive_config(session_, 1, 30);
@@ -2014,11 +2530,18 @@ bool Libssh2SftpClient::sshHandshakeAuth(const SessionOptions &opt,
 #endif
         }
 
+        // Only this host's lines go into the collection; the shared cache
+        // spares re-parsing a large known_hosts on every connect.
         bool khLoaded = false;
         if (!khPath.empty()) {
-            khLoaded =
-                (libssh2_knownhost_readfile(
-                     nh, khPath.c_str(), LIBSSH2_KNOWNHOST_FILE_OPENSSH) >= 0);
+            std::vector<std::string> khLines;
+            std::string khErr;
+            khLoaded = KnownHostsCache::shared().linesFor(
+                khPath, opt.host, opt.port, khLines, khErr);
+            for (const std::string &ln : khLines) {
+                (void)libssh2_knownhost_readline(
+                    nh, ln.data(), ln.size(), LIBSSH2_KNOWNHOST_FILE_OPENSSH);
+            }
         }
         if (!khLoaded &&
             opt.known_hosts_policy == openscp::KnownHostsPolicy::Strict) {
@@ -2273,13 +2796,33 @@ bool Libssh2SftpClient::sshHandshakeAuth(const SessionOptions &opt,
                     hostForKnown = std::string("[") + opt.host +
                                    "]:" + std::to_string(opt.port);
 
-                // Add entry
+                // Add entry and append just its line; the rest of the
+                // file is left untouched.
+                struct libssh2_knownhost *added = nullptr;
                 if (alg != 0 &&
                     libssh2_knownhost_addc(nh, hostForKnown.c_str(), nullptr,
                                            hostkey, (size_t)keylen, nullptr, 0,
-                                           addMask, nullptr) == 0) {
-                    std::string persistErr;
-                    saved = persist_known_hosts_atomic(nh, khPath, &persistErr);
+                                           addMask, &added) == 0 &&
+                    added) {
+                    std::string line(8192, '\0');
+                    size_t lineLen = 0;
+                    int rc = libssh2_knownhost_writeline(
+                        nh, added, line.data(), line.size(), &lineLen,
+                        LIBSSH2_KNOWNHOST_FILE_OPENSSH);
+                    if (rc == LIBSSH2_ERROR_BUFFER_TOO_SMALL) {
+                        line.assign(lineLen + 1, '\0');
+                        rc = libssh2_knownhost_writeline(
+                            nh, added, line.data(), line.size(), &lineLen,
+                            LIBSSH2_KNOWNHOST_FILE_OPENSSH);
+                    }
+                    std::string persistErr = "could not format the entry";
+                    if (rc == 0) {
+                        line.resize(lineLen);
+                        while (!line.empty() &&
+                               (line.back() == '\n' || line.back() == '\0'))
+                            line.pop_back();
+                        saved = AppendKnownHostLine(khPath, line, persistErr);
+                    }
                     if (!saved && opt.hostkey_status_cb) {
                         opt.hostkey_status_cb(
                             std::string("Could not save known_hosts: ") +
@@ -2316,63 +2859,47 @@ bool Libssh2SftpClient::sshHandshakeAuth(const SessionOptions &opt,
                                   "OPENSCP_ENV=dev and "
                                   "OPENSCP_LOG_SENSITIVE=1 to include)");
                     }
-                    // Fallback: write OpenSSH line atomically (hashed or plain)
+                    // Fallback: append the OpenSSH line (hashed or plain)
 #ifndef _WIN32
-                    // Read existing
-                    std::string existing;
-                    int rfd = ::open(khPath.c_str(), O_RDONLY);
-                    if (rfd >= 0) {
-                        char buf[4096];
-                        ssize_t n;
-                        while ((n = ::read(rfd, buf, sizeof(buf))) > 0)
-                            existing.append(buf, buf + n);
-                        ::close(rfd);
-                    }
-                    // Build lines
-                    std::vector<std::string> lines;
-                    {
-                        std::string tmp;
-                        for (char c : existing) {
-                            if (c == '\r')
-                                continue;
-                            if (c == '\n') {
-                                lines.push_back(tmp);
-                                tmp.clear();
-                            } else
-                                tmp.push_back(c);
-                        }
-                        if (!existing.empty() && existing.back() != '\n')
-                            lines.push_back(tmp);
-                    }
-                    std::string b64 = b64encode(hostkeyBytes, (size_t)keylen);
-                    std::string hostToken;
+                    const std::string b64 =
+                        b64encode(hostkeyBytes, (size_t)keylen);
+                    std::string persistErr;
                     if (preferHashed) {
-                        hostToken = openssh_hash_hostname(hostForKnown);
                         // note: hashed entries won't be deduplicated (new salt)
-                        lines.push_back(hostToken + " ssh-ed25519 " + b64);
+                        saved = AppendKnownHostLine(
+                            khPath,
+                            openssh_hash_hostname(hostForKnown) +
+                                " ssh-ed25519 " + b64,
+                            persistErr);
                     } else {
-                        hostToken = hostForKnown;
-                        std::string prefix = hostToken + " ssh-ed25519 ";
-                        auto it = std::find_if(
-                            lines.begin(), lines.end(),
+                        const std::string prefix =
+                            hostForKnown + " ssh-ed25519 ";
+                        std::vector<std::string> current;
+                        std::string why;
+                        (void)KnownHostsCache::shared().linesFor(
+                            khPath, opt.host, opt.port, current, why);
+                        const bool same =
+                            std::find(current.begin(), current.end(),
+                                      prefix + b64) != current.end();
+                        const bool stale = std::any_of(
+                            current.begin(), current.end(),
                             [&prefix](const std::string &ln) {
                                 return ln.rfind(prefix, 0) == 0;
                             });
-                        if (it != lines.end()) {
-                            *it = prefix + b64;
-                        } else {
-                            lines.push_back(prefix + b64);
-                        }
+                        // A different key of this host is replaced, not
+                        // kept next to the new one.
+                        if (same)
+                            saved = true;
+                        else if (stale)
+                            saved = ReplaceKnownHostEntries(
+                                khPath,
+                                {KnownHostTarget{opt.host, opt.port,
+                                                 "ssh-ed25519"}},
+                                prefix + b64, persistErr);
+                        else
+                            saved = AppendKnownHostLine(khPath, prefix + b64,
+                                                        persistErr);
                     }
-                    std::string content;
-                    content.reserve(lines.size() * 64);
-                    for (const std::string &ln : lines) {
-                        if (!ln.empty())
-                            content.append(ln);
-                        content.push_back('\n');
-                    }
-                    std::string persistErr;
-                    saved = persist_text_atomic(khPath, content, &persistErr);
                     if (!saved && opt.hostkey_status_cb) {
                         opt.hostkey_status_cb(
                             std::string("Could not save known_hosts: ") +
@@ -2427,6 +2954,9 @@ bool Libssh2SftpClient::sshHandshakeAuth(const SessionOptions &opt,
         }
     }
 
+    timings.host_key_ms = elapsed_ms(hostKeyStart);
+    const auto authStart = std::chrono::steady_clock::now();
+
     // Authentication: prefer the method explicitly provided by the user.
     // 1) If a private key is specified: use it first.
     // 2) If a password is specified: try password first; if connection remains
@@ -2673,10 +3203,14 @@ bool Libssh2SftpClient::sshHandshakeAuth(const SessionOptions &opt,
         }
     }
 
+    timings.auth_ms = elapsed_ms(authStart);
+
     if (initializeSftpSubsystem) {
         // Initialize SFTP only for backends that require directory/metadata
         // operations. SCP may reuse this transport without SFTP.
+        const auto sftpStart = std::chrono::steady_clock::now();
         sftp_ = libssh2_sftp_init(session_);
+        timings.sftp_init_ms = elapsed_ms(sftpStart);
         if (!sftp_) {
             err = "Could not initialize SFTP";
             return false;
@@ -2686,34 +3220,219 @@ bool Libssh2SftpClient::sshHandshakeAuth(const SessionOptions &opt,
     return true;
 }
 
-bool Libssh2SftpClient::connectInternal(const SessionOptions &opt,
-                                        std::string &err,
-                                        bool initializeSftpSubsystem) {
-    if (connected_) {
-        err = "Already connected";
-        return false;
+// Close the socket, the jump tunnel and the SSH session of a transport.
+// The socket goes down first so libssh2 teardown calls fail fast instead of
+// waiting indefinitely on a peer that no longer responds.
+static void teardown_ssh_transport(LIBSSH2_SESSION *session, int sock,
+                                   int jumpPid, int jumpStderrFd,
+                                   LIBSSH2_SFTP *sftp, bool sendDisconnect) {
+    if (sock != -1) {
+#ifdef _WIN32
+        (void)::shutdown(sock, SD_BOTH);
+#else
+        (void)::shutdown(sock, SHUT_RDWR);
+#endif
+        ::close(sock);
     }
+#ifndef _WIN32
+    if (jumpStderrFd != -1)
+        ::close(jumpStderrFd);
+    if (jumpPid > 0)
+        stop_ssh_jump_tunnel(jumpPid);
+#else
+    (void)jumpPid;
+    (void)jumpStderrFd;
+#endif
 
-    transferIntegrityPolicy_ =
-        integrity_policy_from_env(opt.transfer_integrity_policy);
-
-    // Defensive: ensure no leftover state from any previous partial attempt.
-    disconnect();
-
-    if (!tcpConnect(opt, err))
-        return false;
-    if (!sshHandshakeAuth(opt, err, initializeSftpSubsystem)) {
-        disconnect();
-        return false;
+    if (session) {
+        libssh2_session_set_blocking(session, 0);
+#ifdef LIBSSH2_SESSION_TIMEOUT
+        libssh2_session_set_timeout(session, 2000);
+#endif
     }
 
-    connected_ = true;
-    return true;
+    if (sftp) {
+        (void)libssh2_sftp_shutdown(sftp);
+    }
+    if (session) {
+        // Only send SSH disconnect message for fully established sessions.
+        if (sendDisconnect) {
+            (void)libssh2_session_disconnect(session, "bye");
+        }
+        libssh2_session_free(session);
+    }
 }
 
-bool Libssh2SftpClient::connect(const SessionOptions &opt, std::string &err) {
-    return connectInternal(opt, err, true);
-}
+// Transport of a multiplexed session, shared by the SFTP channels of
+// several clients. The last client to let go tears it down.
+struct SharedSshTransport {
+    LIBSSH2_SESSION *session = nullptr;
+    int sock = -1;
+    int jumpPid = -1;
+    int jumpStderrFd = -1;
+    std::string endpoint; // clones for other endpoints get their own
+    SshAlgorithms negotiated;
+    TransportLock io;
+    std::atomic<int> channels{1};
+
+    ~SharedSshTransport() {
+        teardown_ssh_transport(session, sock, jumpPid, jumpStderrFd, nullptr,
+                               true);
+    }
+};
+
+// Holds the transport for one operation: the shared one of a multiplexed
+// session, else the client's own lock, which only matters when another
+// thread pings the client meanwhile.
+class ChannelTurn {
+    public:
+    ChannelTurn(const std::shared_ptr<SharedSshTransport> &t,
+                TransportLock &own)
+        : io_(t ? &t->io : &own) {
+        io_->lock();
+    }
+    // Refuses the turn once `interrupted` is set, also while waiting for
+    // it; check held().
+    ChannelTurn(const std::shared_ptr<SharedSshTransport> &t,
+                TransportLock &own, const std::atomic<bool> &interrupted)
+        : io_(t ? &t->io : &own) {
+        if (!io_->lock(interrupted))
+            io_ = nullptr;
+    }
+    explicit ChannelTurn(const std::shared_ptr<SharedSshTransport> &t)
+        : io_(t ? &t->io : nullptr) {
+        if (io_)
+            io_->lock();
+    }
+    ~ChannelTurn() {
+        if (io_)
+            io_->unlock();
+    }
+    ChannelTurn(const ChannelTurn &) = delete;
+    ChannelTurn &operator=(const ChannelTurn &) = delete;
+    // Between two chunks of a transfer: let the other channels run.
+    void yield() {
+        if (io_)
+            io_->yield();
+    }
+    bool held() const { return io_ != nullptr; }
+
+    private:
+    TransportLock *io_;
+};
+
+static constexpr const char *kInterruptedError = "Operation interrupted";
+
+// Cancel hook of an operation that also stops once the client is
+// interrupted, at the same points where the caller's hook is polled.
+static std::function<bool()>
+cancel_or_interrupt(const std::atomic<bool> &interrupted,
+                    std::function<bool()> shouldCancel) {
+    return [&interrupted, inner = std::move(shouldCancel)] {
+        return interrupted.load() || (inner && inner());
+    };
+}
+
+// Closes a remote file handle on every exit of a read loop. A close after
+// a cancel first drains the read-ahead still in flight; on an interrupted
+// session it fails at once.
+class RemoteHandleCloser {
+    public:
+    explicit RemoteHandleCloser(LIBSSH2_SFTP_HANDLE *h) : h_(h) {}
+    ~RemoteHandleCloser() {
+        if (h_)
+            (void)libssh2_sftp_close(h_);
+    }
+    RemoteHandleCloser(const RemoteHandleCloser &) = delete;
+    RemoteHandleCloser &operator=(const RemoteHandleCloser &) = delete;
+
+    private:
+    LIBSSH2_SFTP_HANDLE *h_;
+};
+
+static std::string multiplex_endpoint(const SessionOptions &opt) {
+    return opt.username + "@" + opt.host + ":" + std::to_string(opt.port) +
+           "|" + opt.jump_host.value_or("") + "|" + opt.proxy_host + ":" +
+           std::to_string(opt.proxy_port);
+}
+
+void Libssh2SftpClient::applyTuning(const SessionOptions &opt) {
+    transferIntegrityPolicy_ =
+        integrity_policy_from_env(opt.transfer_integrity_policy);
+    chunkedIntegrity_ =
+        chunked_integrity_from_env(opt.transfer_integrity_chunked);
+    sftpPipelineDepth_ = clamp_pipeline_depth(opt.sftp_pipeline_depth);
+    sftpRequestSize_ = clamp_request_size(opt.sftp_request_size);
+    localIo_ = localIoOptionsFrom(opt);
+    serverHashUnavailable_ = false;
+}
+
+bool Libssh2SftpClient::connectInternal(const SessionOptions &opt,
+                                        std::string &err,
+                                        bool initializeSftpSubsystem) {
+    OPENSCP_TRACE_SPAN("sftp.connect", "sftp");
+    if (connected_) {
+        err = "Already connected";
+        return false;
+    }
+
+    applyTuning(opt);
+
+    // Defensive: ensure no leftover state from any previous partial attempt.
+    disconnect();
+    interrupted_.store(false);
+
+    // Timings are kept for failed attempts too: those are the ones being
+    // diagnosed.
+    ConnectTimings timings;
+    const auto start = std::chrono::steady_clock::now();
+    auto publishTimings = [&] {
+        timings.total_ms = elapsed_ms(start);
+        core_logf(CoreLogLevel::Debug, "Connect timings: %s",
+                  describeConnectTimings(timings).c_str());
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        lastTimings_ = timings;
+    };
+    TraceSpan tcpSpan("sftp.tcp_connect", "sftp");
+    if (!tcpConnect(opt, err, timings)) {
+        publishTimings();
+        return false;
+    }
+    tcpSpan.end();
+    TraceSpan authSpan("sftp.handshake_auth", "sftp");
+    if (!sshHandshakeAuth(opt, err, initializeSftpSubsystem, timings)) {
+        disconnect();
+        publishTimings();
+        return false;
+    }
+    authSpan.end();
+    applyNetworkTuning(opt, timings);
+
+    if (opt.ssh_multiplex && initializeSftpSubsystem) {
+        // Hand the transport to a shared owner; this client keeps using it
+        // through its own SFTP channel like any later one.
+        auto mux = std::make_shared<SharedSshTransport>();
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        mux->session = session_;
+        mux->sock = sock_;
+#ifndef _WIN32
+        mux->jumpPid = jumpProxyPid_;
+        mux->jumpStderrFd = jumpProxyStderrFd_;
+        jumpProxyPid_ = -1;
+        jumpProxyStderrFd_ = -1;
+#endif
+        mux->endpoint = multiplex_endpoint(opt);
+        mux->negotiated = negotiated_;
+        mux_ = std::move(mux);
+    }
+    connected_ = true;
+    publishTimings();
+    return true;
+}
+
+bool Libssh2SftpClient::connect(const SessionOptions &opt, std::string &err) {
+    return connectInternal(opt, err, true);
+}
 
 bool Libssh2SftpClient::connectTransportOnly(const SessionOptions &opt,
                                              std::string &err) {
@@ -2725,20 +3444,22 @@ void Libssh2SftpClient::disconnect() {
     _LIBSSH2_SESSION *session = nullptr;
     bool wasConnected = false;
     int sock = -1;
-#ifndef _WIN32
     int jumpPid = -1;
     int jumpStderrFd = -1;
-#endif
+    std::shared_ptr<SharedSshTransport> mux;
     {
         std::lock_guard<std::mutex> lk(stateMutex_);
         wasConnected = connected_;
         connected_ = false;
+        negotiated_ = SshAlgorithms{};
+        networkTuning_.reset();
         sftp = sftp_;
         session = session_;
         sock = sock_;
         sftp_ = nullptr;
         session_ = nullptr;
         sock_ = -1;
+        mux = std::move(mux_);
 #ifndef _WIN32
         jumpPid = jumpProxyPid_;
         jumpProxyPid_ = -1;
@@ -2747,40 +3468,18 @@ void Libssh2SftpClient::disconnect() {
 #endif
     }
 
-    // Force the transport down first so libssh2 teardown calls fail fast
-    // instead of waiting indefinitely on a peer that no longer responds.
-    if (sock != -1) {
-#ifdef _WIN32
-        (void)::shutdown(sock, SD_BOTH);
-#else
-        (void)::shutdown(sock, SHUT_RDWR);
-#endif
-        ::close(sock);
-    }
-#ifndef _WIN32
-    if (jumpStderrFd != -1)
-        ::close(jumpStderrFd);
-    if (jumpPid > 0)
-        stop_ssh_jump_tunnel(jumpPid);
-#endif
-
-    if (session) {
-        libssh2_session_set_blocking(session, 0);
-#ifdef LIBSSH2_SESSION_TIMEOUT
-        libssh2_session_set_timeout(session, 2000);
-#endif
-    }
-
-    if (sftp) {
-        (void)libssh2_sftp_shutdown(sftp);
-    }
-    if (session) {
-        // Only send SSH disconnect message for fully established sessions.
-        if (wasConnected) {
-            (void)libssh2_session_disconnect(session, "bye");
+    if (mux) {
+        // Only this client's channel closes; the transport goes with the
+        // last channel (~SharedSshTransport).
+        if (sftp) {
+            ChannelTurn turn(mux);
+            (void)libssh2_sftp_shutdown(sftp);
         }
-        libssh2_session_free(session);
+        --mux->channels;
+        return;
     }
+    teardown_ssh_transport(session, sock, jumpPid, jumpStderrFd, sftp,
+                           wasConnected);
 }
 
 #ifndef _WIN32
@@ -2829,10 +3528,179 @@ bool Libssh2SftpClient::describeJumpTunnelFailure(std::string &err) {
 }
 #endif
 
+bool Libssh2SftpClient::negotiatedAlgorithms(SshAlgorithms &out) const {
+    std::lock_guard<std::mutex> lk(stateMutex_);
+    if (!connected_)
+        return false;
+    out = negotiated_;
+    return true;
+}
+
+bool Libssh2SftpClient::connectTimings(ConnectTimings &out) const {
+    std::lock_guard<std::mutex> lk(stateMutex_);
+    if (!lastTimings_)
+        return false;
+    out = *lastTimings_;
+    return true;
+}
+
+bool Libssh2SftpClient::networkTuning(NetworkTuning &out) const {
+    std::lock_guard<std::mutex> lk(stateMutex_);
+    if (!connected_ || !networkTuning_)
+        return false;
+    out = *networkTuning_;
+    return true;
+}
+
+// Size the socket buffers, the SFTP channel window and the request
+// pipeline for the link (see SessionOptions), then record what is in
+// effect. Auto-tuning times realpath(".") on the new channel, or takes the
+// TCP handshake when there is no SFTP channel (SCP) and no tunnel.
+void Libssh2SftpClient::applyNetworkTuning(const SessionOptions &opt,
+                                           const ConnectTimings &timings) {
+    NetworkTuning t;
+    if (opt.network_auto_tune) {
+        std::uint32_t rtt = 0;
+        if (sftp_) {
+            char resolved[1024];
+            for (int i = 0; i < 2; ++i) {
+                const auto start = std::chrono::steady_clock::now();
+                if (libssh2_sftp_realpath(sftp_, ".", resolved,
+                                          sizeof(resolved)) < 0)
+                    break;
+                const std::uint32_t ms = elapsed_ms(start);
+                rtt = (i == 0) ? ms : std::min(rtt, ms);
+            }
+        } else if (timings.tunnel_ms == 0 && timings.tcp_attempts == 1) {
+            rtt = timings.tcp_ms;
+        }
+        t.auto_tuned = true;
+        t.rtt_ms = rtt;
+        t.bdp_bytes = bandwidthDelayBytes(rtt, opt.network_link_mbps);
+    }
+    const std::uint32_t autoSize =
+        (std::uint32_t)std::min<std::uint64_t>(t.bdp_bytes, UINT32_MAX);
+
+#ifndef __linux__
+    // Explicit sizes were set before connecting; auto sizes can only be
+    // raised now. Linux is left alone: an explicit SO_RCVBUF turns off its
+    // receive autotuning and is capped by net.core.rmem_max, so setting one
+    // after the fact usually shrinks the window instead.
+    if (t.auto_tuned && sock_ >= 0)
+        configure_socket_buffers(sock_,
+                                 opt.tcp_send_buffer ? 0 : autoSize,
+                                 opt.tcp_recv_buffer ? 0 : autoSize, false,
+                                 true);
+#endif
+
+    const std::uint32_t window =
+        opt.ssh_window_size ? opt.ssh_window_size : autoSize;
+    if (sftp_) {
+        LIBSSH2_CHANNEL *ch = libssh2_sftp_get_channel(sftp_);
+        if (ch && window > 0) {
+            const unsigned long current =
+                libssh2_channel_window_read_ex(ch, nullptr, nullptr);
+            if (current < window)
+                (void)libssh2_channel_receive_window_adjust2(
+                    ch, window - current, 1, nullptr);
+        }
+        if (ch)
+            t.ssh_window = (std::uint32_t)std::min<unsigned long>(
+                libssh2_channel_window_read_ex(ch, nullptr, nullptr),
+                UINT32_MAX);
+        // Keep enough READ/WRITE requests in flight to cover the window.
+        if (t.auto_tuned) {
+            const std::size_t needed =
+                (std::size_t)((t.bdp_bytes + sftpRequestSize_ - 1) /
+                              sftpRequestSize_);
+            sftpPipelineDepth_ = std::min(
+                std::max(sftpPipelineDepth_, needed), kSftpMaxPipelineDepth);
+        }
+        t.pipeline_depth = (std::uint32_t)sftpPipelineDepth_;
+    }
+
+    if (sock_ >= 0) {
+        t.send_buffer = socket_int_option(sock_, SOL_SOCKET, SO_SNDBUF);
+        t.recv_buffer = socket_int_option(sock_, SOL_SOCKET, SO_RCVBUF);
+        t.nodelay = socket_int_option(sock_, IPPROTO_TCP, TCP_NODELAY) != 0;
+    }
+    core_logf(CoreLogLevel::Debug, "Network tuning: %s",
+              describeNetworkTuning(t).c_str());
+    std::lock_guard<std::mutex> lk(stateMutex_);
+    networkTuning_ = t;
+}
+
+bool Libssh2SftpClient::ping(std::uint32_t &rtt_ms, std::string &err) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    rtt_ms = 0;
+    if (!connected_ || !session_ || !sftp_) {
+        err = "Not connected";
+        return false;
+    }
+    // Runs without blocking, so interrupt() ends the wait without cutting
+    // a transport other channels share. An abandoned request leaves this
+    // channel unusable; interrupted clients are discarded by their owners.
+    const long timeoutMs = libssh2_session_get_timeout(session_);
+    libssh2_session_set_blocking(session_, 0);
+    // Sends keepalive@openssh.com when it is due, like the periodic
+    // keepalive (a full send buffer is not an error). libssh2 consumes the
+    // reply itself, so the round trip is timed on the SFTP channel with a
+    // realpath of "." instead.
+    int nextKeepaliveSecs = 0;
+    if (libssh2_keepalive_send(session_, &nextKeepaliveSecs) != 0) {
+        libssh2_session_set_blocking(session_, 1);
+        err = "SSH keepalive failed";
+        return false;
+    }
+    char resolved[1024];
+    const auto start = std::chrono::steady_clock::now();
+    int rc = LIBSSH2_ERROR_EAGAIN;
+    bool timedOut = false;
+    while (rc == LIBSSH2_ERROR_EAGAIN && !interrupted_.load() && !timedOut) {
+        rc = libssh2_sftp_realpath(sftp_, ".", resolved, sizeof(resolved));
+        if (rc == LIBSSH2_ERROR_EAGAIN) {
+            wait_session_socket(session_, sock_, 50);
+            timedOut = timeoutMs > 0 && elapsed_ms(start) >= timeoutMs;
+        }
+    }
+    libssh2_session_set_blocking(session_, 1);
+    if (rc == LIBSSH2_ERROR_EAGAIN) {
+        err = timedOut ? "Session ping timed out" : kInterruptedError;
+        return false;
+    }
+    if (rc < 0) {
+        char *emsgPtr = nullptr;
+        int emlen = 0;
+        (void)libssh2_session_last_error(session_, &emsgPtr, &emlen, 0);
+        err = std::string("Session ping failed") +
+              ((emsgPtr && emlen > 0) ? ": " + std::string(emsgPtr, emlen)
+                                      : std::string());
+        return false;
+    }
+    rtt_ms = elapsed_ms(start);
+    return true;
+}
+
 void Libssh2SftpClient::interrupt() {
+    // Every operation of this client stops at its next turn, cancel check
+    // or ping poll from now on.
+    interrupted_.store(true);
     int sock = -1;
     {
         std::lock_guard<std::mutex> lk(stateMutex_);
+        if (mux_) {
+            mux_->io.wake();
+            // A shared transport is not this client's to cut: the other
+            // channels would die with it.
+            if (mux_->channels.load() > 1)
+                return;
+        } else {
+            io_->wake();
+        }
         sock = sock_;
     }
     if (sock == -1)
@@ -2846,6 +3714,28 @@ void Libssh2SftpClient::interrupt() {
 
 bool Libssh2SftpClient::list(const std::string &remote_path,
                              std::vector<FileInfo> &out, std::string &err) {
+    out.clear();
+    out.reserve(64);
+    return listStream(
+        remote_path,
+        [&out](std::vector<FileInfo> &&batch) {
+            out.insert(out.end(), std::make_move_iterator(batch.begin()),
+                       std::make_move_iterator(batch.end()));
+            return true;
+        },
+        err);
+}
+
+// Directory entries are handed out every kListBatchSize READDIR answers.
+bool Libssh2SftpClient::listStream(const std::string &remote_path,
+                                   const ListBatchCB &onBatch,
+                                   std::string &err) {
+    OPENSCP_TRACE_SPAN("sftp.list", "sftp");
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -2859,17 +3749,17 @@ bool Libssh2SftpClient::list(const std::string &remote_path,
         return false;
     }
 
-    out.clear();
-    out.reserve(64);
+    std::vector<FileInfo> batch;
+    batch.reserve(64);
 
     char filename[512];
-    char longentry[1024];
     LIBSSH2_SFTP_ATTRIBUTES attrs;
 
     while (true) {
         memset(&attrs, 0, sizeof(attrs));
+        // The ls-style longentry is not used; skip copying it per entry.
         int rc = libssh2_sftp_readdir_ex(dir, filename, sizeof(filename),
-                                         longentry, sizeof(longentry), &attrs);
+                                         nullptr, 0, &attrs);
         if (rc > 0) {
             // rc = name length
             FileInfo fi{};
@@ -2892,7 +3782,16 @@ bool Libssh2SftpClient::list(const std::string &remote_path,
             }
             if (fi.name == "." || fi.name == "..")
                 continue;
-            out.push_back(std::move(fi));
+            batch.push_back(std::move(fi));
+            if (batch.size() >= kListBatchSize) {
+                if (interrupted_.load() || !onBatch(std::move(batch))) {
+                    err = "Canceled by user";
+                    libssh2_sftp_closedir(dir);
+                    return false;
+                }
+                batch.clear();
+                turn.yield();
+            }
         } else if (rc == 0) {
             // end of directory
             break;
@@ -2904,6 +3803,167 @@ bool Libssh2SftpClient::list(const std::string &remote_path,
     }
 
     libssh2_sftp_closedir(dir);
+    if (!batch.empty() && !onBatch(std::move(batch))) {
+        err = "Canceled by user";
+        return false;
+    }
+    return true;
+}
+
+// Chunked resume: hash the whole chunks of the .part on every core and
+// compare them with the server's digests of the same ranges, or, when the
+// server cannot compute those, with the digests saved while the chunks were
+// written (which still catch local damage). `refetch` lists the chunks to
+// download again; false when no comparison could be made.
+static bool plan_chunked_resume(LIBSSH2_SESSION *session, int sock,
+                                LIBSSH2_SFTP *sftp, const std::string &remote,
+                                const std::string &localPart,
+                                std::uint64_t partSize, std::uint64_t chunk,
+                                const ChunkDigests &saved,
+                                bool &serverHashUnavailable,
+                                std::vector<Sha256Digest> &digests,
+                                std::vector<std::size_t> &refetch,
+                                std::string &why,
+                                const std::function<bool()> &shouldCancel) {
+    OPENSCP_TRACE_SPAN("hash.resume_chunks", "hash");
+    const std::uint64_t keep = partSize / chunk * chunk;
+    if (!hashLocalChunks(localPart, keep, chunk, digests, why, 0,
+                         shouldCancel))
+        return false;
+    // Re-reading the prefix over SFTP costs as much as downloading it
+    // again; with saved digests at hand they are the better reference.
+    const bool haveSaved =
+        saved.chunk_size == chunk && saved.chunks.size() >= digests.size();
+    std::vector<Sha256Digest> reference;
+    if (!hash_remote_chunks(session, sock, sftp, remote, keep, chunk,
+                            serverHashUnavailable, !haveSaved, reference, &why,
+                            shouldCancel)) {
+        if (!haveSaved || (shouldCancel && shouldCancel()))
+            return false;
+        reference = saved.chunks;
+    }
+    refetch = mismatchedChunks(digests, reference);
+    return true;
+}
+
+// Download the listed chunks again into the .part and refresh their
+// digests.
+static bool refetch_chunks(LIBSSH2_SFTP_HANDLE *rh, LocalFileWriter &lf,
+                           const std::vector<std::size_t> &indexes,
+                           std::uint64_t chunk, std::uint64_t total,
+                           LocalIoBuffer &buf,
+                           std::vector<Sha256Digest> &digests,
+                           std::string &err, ChannelTurn &turn,
+                           const std::function<bool()> &shouldCancel) {
+    for (std::size_t index : indexes) {
+        const std::uint64_t start = (std::uint64_t)index * chunk;
+        const std::uint64_t end = std::min(total, start + chunk);
+        libssh2_sftp_seek64(rh, (libssh2_uint64_t)start);
+        Sha256Stream h;
+        for (std::uint64_t pos = start; pos < end;) {
+            if (shouldCancel && shouldCancel()) {
+                err = "Canceled by user";
+                return false;
+            }
+            turn.yield();
+            const std::size_t want =
+                (std::size_t)std::min<std::uint64_t>(buf.size(), end - pos);
+            const ssize_t n = libssh2_sftp_read(rh, buf.data(), want);
+            if (n <= 0) {
+                err = "Remote read failed";
+                return false;
+            }
+            if (!lf.writeAt(pos, buf.data(), (std::size_t)n, err))
+                return false;
+            h.update(buf.data(), (std::size_t)n);
+            pos += (std::uint64_t)n;
+        }
+        if (index >= digests.size() || !h.finish(digests[index])) {
+            err = "Could not hash downloaded data";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Final check of a chunked download: the tree digests of both sides must
+// match. Chunks that differ are downloaded once more and compared with the
+// server's digests again, so a damaged chunk costs a chunk, not the file.
+static bool verify_chunked_download(
+    LIBSSH2_SESSION *session, int sock, LIBSSH2_SFTP *sftp,
+    const std::string &remote, const std::string &localPart,
+    std::uint64_t chunk, std::uint64_t total, TransferIntegrityPolicy policy,
+    const LocalIoOptions &localIo, bool &serverHashUnavailable,
+    std::vector<Sha256Digest> &digests, bool localOk, LocalIoBuffer &buf,
+    std::string &err, ChannelTurn &turn,
+    const std::function<bool()> &shouldCancel) {
+    std::string herr = localOk ? "" : "Could not hash downloaded data";
+    std::vector<Sha256Digest> remoteDigests;
+    const bool rok =
+        localOk && hash_remote_chunks(session, sock, sftp, remote, total, chunk,
+                                      serverHashUnavailable, true,
+                                      remoteDigests, &herr, shouldCancel);
+    if (shouldCancel && shouldCancel()) {
+        err = "Canceled by user";
+        return false;
+    }
+    if (!localOk || !rok) {
+        if (policy == TransferIntegrityPolicy::Required) {
+            err = std::string("Could not verify final integrity (download): ") +
+                  herr;
+            return false;
+        }
+        return true;
+    }
+    if (chunkTreeRoot(digests) == chunkTreeRoot(remoteDigests))
+        return true;
+    if (digests.size() != remoteDigests.size()) {
+        err = "Final integrity check failed (download): the remote file "
+              "changed during the transfer";
+        return false;
+    }
+
+    const std::vector<std::size_t> bad =
+        mismatchedChunks(digests, remoteDigests);
+    LIBSSH2_SFTP_HANDLE *rh =
+        libssh2_sftp_open_ex(sftp, remote.c_str(), (unsigned)remote.size(),
+                             LIBSSH2_FXF_READ, 0, LIBSSH2_SFTP_OPENFILE);
+    if (!rh) {
+        err = "Could not open remote file for reading";
+        return false;
+    }
+    LocalFileWriter lf;
+    if (!lf.open(localPart, LocalFileWriter::Mode::Keep, localIo, err)) {
+        libssh2_sftp_close(rh);
+        err = "Could not open local file (.part) for writing";
+        return false;
+    }
+    const bool fetched = refetch_chunks(rh, lf, bad, chunk, total, buf,
+                                        digests, err, turn, shouldCancel);
+    if (!fetched && shouldCancel && shouldCancel())
+        return false;
+    libssh2_sftp_close(rh);
+    if (!fetched)
+        return false;
+    std::string syncErr;
+    if (!lf.sync(syncErr) || !lf.close(syncErr)) {
+        err = std::string("Could not sync local file (.part): ") + syncErr;
+        return false;
+    }
+    std::string sideErr;
+    (void)saveChunkDigests(chunkSidecarPath(localPart), {chunk, digests},
+                           sideErr);
+    const std::size_t still = mismatchedChunks(digests, remoteDigests).size();
+    if (still > 0) {
+        err = "Final integrity check failed (download): " +
+              std::to_string(still) + " of " +
+              std::to_string(remoteDigests.size()) +
+              " chunks differ from the remote file";
+        return false;
+    }
+    core_logf(CoreLogLevel::Debug,
+              "Chunked integrity: %s fetched %zu damaged chunks again",
+              remote.c_str(), bad.size());
     return true;
 }
 
@@ -2913,6 +3973,12 @@ bool Libssh2SftpClient::get(
     const std::string &remote, const std::string &local, std::string &err,
     std::function<void(std::size_t, std::size_t)> progress,
     std::function<bool()> shouldCancel, bool resume) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -2933,6 +3999,23 @@ bool Libssh2SftpClient::get(
     const bool hasTotal = (st.flags & LIBSSH2_SFTP_ATTR_SIZE) != 0;
     std::size_t total = hasTotal ? (std::size_t)st.filesize : 0;
 
+    // Chunked integrity picks its chunk size from the file size; a resume
+    // keeps the one its saved digests were made with.
+    const bool chunked = chunkedIntegrity_ &&
+                         policy != TransferIntegrityPolicy::Off && hasTotal;
+    const std::string sidecar = chunkSidecarPath(localPart);
+    ChunkDigests saved;
+    std::uint64_t chunk = 0;
+    if (chunked) {
+        std::string ignored;
+        chunk = (resume && loadChunkDigests(sidecar, saved, ignored))
+                    ? saved.chunk_size
+                    : integrityChunkSize(total);
+    }
+    // Digests of the .part's chunks so far, and kept chunks to fetch again.
+    std::vector<Sha256Digest> chunkDigests;
+    std::vector<std::size_t> refetch;
+
     // Open remote for reading
     LIBSSH2_SFTP_HANDLE *rh =
         libssh2_sftp_open_ex(sftp_, remote.c_str(), (unsigned)remote.size(),
@@ -2957,8 +4040,33 @@ bool Libssh2SftpClient::get(
             }
             offset = 0; // fallback: restart from scratch
         }
-        if (offset > 0 && hasTotal && offset < total &&
-            policy != TransferIntegrityPolicy::Off) {
+        if (offset > 0 && chunked) {
+            // Whole chunks are kept (and repaired where they differ); the
+            // partial one at the end is downloaded again.
+            std::string hErr;
+            if (plan_chunked_resume(session_, sock_, sftp_, remote, localPart,
+                                    offset, chunk, saved,
+                                    serverHashUnavailable_, chunkDigests,
+                                    refetch, hErr, shouldCancel)) {
+                offset = (std::size_t)(offset / chunk * chunk);
+            } else {
+                if (shouldCancel && shouldCancel()) {
+                    libssh2_sftp_close(rh);
+                    err = "Canceled by user";
+                    return false;
+                }
+                if (policy == TransferIntegrityPolicy::Required) {
+                    libssh2_sftp_close(rh);
+                    err = std::string("Could not validate resume integrity "
+                                      "(download): ") +
+                          hErr;
+                    return false;
+                }
+                offset = 0; // optional: restart
+                chunkDigests.clear();
+            }
+        } else if (offset > 0 && hasTotal && offset < total &&
+                   policy != TransferIntegrityPolicy::Off) {
             const std::uint64_t window =
                 std::min<std::uint64_t>(offset, 64 * 1024);
             const std::uint64_t start = (std::uint64_t)offset - window;
@@ -3000,34 +4108,85 @@ bool Libssh2SftpClient::get(
         libssh2_sftp_seek64(rh, (libssh2_uint64_t)offset);
     }
 
+    // The local digest is computed inline while the data streams to disk;
+    // on resume the prefix already present in the .part is hashed first.
+    Sha256Stream localHash;
+    if (policy != TransferIntegrityPolicy::Off && !chunked && offset > 0) {
+        std::string hErr;
+        if (!feed_local_range(localPart, 0, offset, localHash, &hErr,
+                              &shouldCancel)) {
+            if (shouldCancel && shouldCancel()) {
+                libssh2_sftp_close(rh);
+                err = "Canceled by user";
+                return false;
+            }
+            localHash.ok = false;
+        }
+    }
+
     // Open local .part for writing
-    FILE *lf = ::fopen(localPart.c_str(), offset > 0 ? "ab" : "wb");
-    if (!lf) {
+    LocalFileWriter lf;
+    std::string openErr;
+    if (!lf.open(localPart,
+                 offset > 0 ? LocalFileWriter::Mode::Keep
+                            : LocalFileWriter::Mode::Truncate,
+                 localIo_, openErr)) {
         libssh2_sftp_close(rh);
         err = "Could not open local file (.part) for writing";
         return false;
     }
+    // Reserve the whole file up front so it is laid out contiguously.
+    if (total > 0)
+        (void)lf.preallocate(total);
 
-    const std::size_t CHUNK = 64 * 1024;
-    std::vector<char> buf(CHUNK);
+    LocalIoBuffer buf(
+        sftp_read_buffer_size(sftpPipelineDepth_, sftpRequestSize_));
     std::size_t done = offset;
 
+    if (chunked) {
+        if (!refetch.empty()) {
+            if (!refetch_chunks(rh, lf, refetch, chunk, total, buf,
+                                chunkDigests, err, turn, shouldCancel)) {
+                if (!(shouldCancel && shouldCancel()))
+                    libssh2_sftp_close(rh);
+                return false;
+            }
+            core_logf(CoreLogLevel::Debug,
+                      "Chunked resume: %s fetched %zu of %zu kept chunks again",
+                      remote.c_str(), refetch.size(), chunkDigests.size());
+            libssh2_sftp_seek64(rh, (libssh2_uint64_t)offset);
+        }
+        std::string sideErr;
+        if (!saveChunkDigests(sidecar, {chunk, chunkDigests}, sideErr))
+            core_logf(CoreLogLevel::Debug, "%s", sideErr.c_str());
+    }
+    ChunkHasher chunkHasher(chunk, [&](const ChunkDigest &d) {
+        chunkDigests.push_back(d);
+        std::string sideErr;
+        (void)appendChunkDigest(sidecar, d, sideErr);
+    });
+
     while (true) {
         if (shouldCancel && shouldCancel()) {
             err = "Canceled by user";
-            std::fclose(lf);
             // Avoid a potentially blocking per-handle close on cancellation;
             // the worker session teardown will release pending handles.
             return false;
         }
+        turn.yield();
+        TraceSpan chunkSpan("sftp.read", "sftp");
         ssize_t n = libssh2_sftp_read(rh, buf.data(), (size_t)buf.size());
+        chunkSpan.setArg("bytes", n > 0 ? (std::uint64_t)n : 0);
+        chunkSpan.end();
         if (n > 0) {
-            if (std::fwrite(buf.data(), 1, (size_t)n, lf) != (size_t)n) {
-                err = "Local write failed";
-                std::fclose(lf);
+            if (!lf.writeAt(done, buf.data(), (size_t)n, err)) {
                 libssh2_sftp_close(rh);
                 return false;
             }
+            if (chunked)
+                chunkHasher.update(buf.data(), (std::size_t)n);
+            else if (policy != TransferIntegrityPolicy::Off)
+                localHash.update(buf.data(), (std::size_t)n);
             done = done + (std::size_t)n;
             if (progress && total)
                 progress(done, total);
@@ -3036,7 +4195,6 @@ bool Libssh2SftpClient::get(
         } else {
             const bool canceledNow = (shouldCancel && shouldCancel());
             err = canceledNow ? "Canceled by user" : "Remote read failed";
-            std::fclose(lf);
             if (!canceledNow) {
                 (void)libssh2_sftp_close(rh);
             }
@@ -3045,13 +4203,11 @@ bool Libssh2SftpClient::get(
     }
 
     std::string syncErr;
-    if (!flush_local_file(lf, &syncErr)) {
-        std::fclose(lf);
+    if (!lf.sync(syncErr) || !lf.close(syncErr)) {
         libssh2_sftp_close(rh);
         err = std::string("Could not sync local file (.part): ") + syncErr;
         return false;
     }
-    std::fclose(lf);
     libssh2_sftp_close(rh);
 
     if (shouldCancel && shouldCancel()) {
@@ -3059,12 +4215,23 @@ bool Libssh2SftpClient::get(
         return false;
     }
 
-    if (policy != TransferIntegrityPolicy::Off) {
+    if (chunked) {
+        const bool localOk = chunkHasher.finish();
+        if (!verify_chunked_download(session_, sock_, sftp_, remote, localPart,
+                                     chunk, total, policy, localIo_,
+                                     serverHashUnavailable_, chunkDigests,
+                                     localOk, buf, err, turn, shouldCancel))
+            return false;
+    } else if (policy != TransferIntegrityPolicy::Off) {
         Sha256Digest lsum{}, rsum{};
         std::string herr;
-        const bool lok = hash_local_full(localPart, lsum, &herr, &shouldCancel);
+        const bool lok = localHash.finish(lsum);
+        if (!lok)
+            herr = "Could not hash downloaded data";
         const bool rok =
-            lok && hash_remote_full(sftp_, remote, rsum, &herr, &shouldCancel);
+            lok && hash_remote_full_server_side(session_, sftp_, remote,
+                                                serverHashUnavailable_, rsum,
+                                                &herr, &shouldCancel);
         if (shouldCancel && shouldCancel()) {
             err = "Canceled by user";
             return false;
@@ -3089,19 +4256,29 @@ bool Libssh2SftpClient::get(
     }
 
     std::string replaceErr;
-    if (!replace_local_file_atomic(localPart, local, &replaceErr)) {
+    if (!replaceLocalFileAtomic(localPart, local, replaceErr)) {
         err = std::string("Could not finalize atomic download: ") + replaceErr;
         return false;
     }
+    if (chunked)
+        (void)std::remove(sidecar.c_str());
     return true;
 }
 
-// Upload a local file to remote (create/truncate). Reports progress and
-// supports cancellation.
-bool Libssh2SftpClient::put(
-    const std::string &local, const std::string &remote, std::string &err,
+// Fill one byte range of an existing local file (one segment of a segmented
+// download). The data is synced before returning so a caller that records
+// the range as complete can trust it after a crash.
+bool Libssh2SftpClient::getRange(
+    const std::string &remote, const std::string &local, std::uint64_t offset,
+    std::uint64_t length, std::string &err,
     std::function<void(std::size_t, std::size_t)> progress,
-    std::function<bool()> shouldCancel, bool resume) {
+    std::function<bool()> shouldCancel) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -3109,27 +4286,254 @@ bool Libssh2SftpClient::put(
 
     apply_transfer_socket_timeouts(sock_);
 
-    const TransferIntegrityPolicy policy = transferIntegrityPolicy_;
-    const std::string remotePart = remote + ".part";
-
-    // Open local for reading
-    FILE *lf = ::fopen(local.c_str(), "rb");
-    if (!lf) {
-        err = "Could not open local file for reading";
+    LIBSSH2_SFTP_HANDLE *rh =
+        libssh2_sftp_open_ex(sftp_, remote.c_str(), (unsigned)remote.size(),
+                             LIBSSH2_FXF_READ, 0, LIBSSH2_SFTP_OPENFILE);
+    if (!rh) {
+        err = "Could not open remote file for reading";
         return false;
     }
+    // Closed on every exit: the ranges run on pooled sessions.
+    RemoteHandleCloser closeRh(rh);
+    // Positioned writes: several ranges of the same file are written
+    // concurrently by other sessions.
+    LocalFileWriter lf;
+    std::string why;
+    if (!lf.open(local, LocalFileWriter::Mode::Keep, localIo_, why)) {
+        err = "Could not open local file for ranged write";
+        return false;
+    }
+    libssh2_sftp_seek64(rh, (libssh2_uint64_t)offset);
 
-    // Local size
-    std::fseek(lf, 0, SEEK_END);
-    long fsz = std::ftell(lf);
-    std::fseek(lf, 0, SEEK_SET);
-    std::size_t total = fsz > 0 ? (std::size_t)fsz : 0;
-
-    // Resume against remote .part (final destination is set via atomic rename).
-    long startOffset = 0;
-    if (resume) {
-        LIBSSH2_SFTP_ATTRIBUTES stR{};
-        if (libssh2_sftp_stat_ex(sftp_, remotePart.c_str(),
+    LocalIoBuffer buf(
+        sftp_read_buffer_size(sftpPipelineDepth_, sftpRequestSize_));
+    std::uint64_t done = 0;
+    while (done < length) {
+        if (shouldCancel && shouldCancel()) {
+            err = "Canceled by user";
+            return false;
+        }
+        turn.yield();
+        const std::size_t want = (std::size_t)std::min<std::uint64_t>(
+            buf.size(), length - done);
+        TraceSpan chunkSpan("sftp.read_range", "sftp");
+        ssize_t n = libssh2_sftp_read(rh, buf.data(), want);
+        chunkSpan.setArg("bytes", n > 0 ? (std::uint64_t)n : 0);
+        chunkSpan.end();
+        if (n > 0) {
+            if (!lf.writeAt(offset + done, buf.data(), (size_t)n, err))
+                return false;
+            done += (std::uint64_t)n;
+            if (progress)
+                progress((std::size_t)done, (std::size_t)length);
+        } else if (n == 0) {
+            err = "Remote file ended before the requested range";
+            return false;
+        } else {
+            err = (shouldCancel && shouldCancel()) ? "Canceled by user"
+                                                   : "Remote read failed";
+            return false;
+        }
+    }
+
+    if (!lf.sync(why) || !lf.close(why)) {
+        err = "Could not sync local file: " + why;
+        return false;
+    }
+    return true;
+}
+
+bool Libssh2SftpClient::readStream(const std::string &remote,
+                                   std::uint64_t offset, const ReadSink &sink,
+                                   std::string &err,
+                                   std::function<bool()> shouldCancel) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
+    if (!connected_ || !sftp_) {
+        err = "Not connected";
+        return false;
+    }
+
+    apply_transfer_socket_timeouts(sock_);
+
+    LIBSSH2_SFTP_HANDLE *rh =
+        libssh2_sftp_open_ex(sftp_, remote.c_str(), (unsigned)remote.size(),
+                             LIBSSH2_FXF_READ, 0, LIBSSH2_SFTP_OPENFILE);
+    if (!rh) {
+        err = "Could not open remote file for reading";
+        return false;
+    }
+    // Closed on every exit: remote copies return this session to the pool.
+    RemoteHandleCloser closeRh(rh);
+    if (offset > 0)
+        libssh2_sftp_seek64(rh, (libssh2_uint64_t)offset);
+
+    // libssh2 keeps read-ahead requests in flight for buffers of this size.
+    std::vector<char> buf(
+        sftp_read_buffer_size(sftpPipelineDepth_, sftpRequestSize_));
+    while (true) {
+        if (shouldCancel && shouldCancel()) {
+            err = "Canceled by user";
+            return false;
+        }
+        turn.yield();
+        TraceSpan chunkSpan("sftp.read_stream", "sftp");
+        ssize_t n = libssh2_sftp_read(rh, buf.data(), buf.size());
+        chunkSpan.setArg("bytes", n > 0 ? (std::uint64_t)n : 0);
+        chunkSpan.end();
+        if (n == 0)
+            break;
+        if (n < 0) {
+            err = (shouldCancel && shouldCancel()) ? "Canceled by user"
+                                                   : "Remote read failed";
+            return false;
+        }
+        if (!sink(buf.data(), (std::size_t)n)) {
+            err = "Canceled by user";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Libssh2SftpClient::writeStream(const std::string &remote, bool append,
+                                    const WriteSource &source,
+                                    std::string &err,
+                                    std::function<bool()> shouldCancel) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
+    if (!connected_ || !sftp_) {
+        err = "Not connected";
+        return false;
+    }
+
+    apply_transfer_socket_timeouts(sock_);
+
+    libssh2_uint64_t startOffset = 0;
+    if (append) {
+        LIBSSH2_SFTP_ATTRIBUTES st{};
+        if (libssh2_sftp_stat_ex(sftp_, remote.c_str(), (unsigned)remote.size(),
+                                 LIBSSH2_SFTP_STAT, &st) == 0 &&
+            (st.flags & LIBSSH2_SFTP_ATTR_SIZE))
+            startOffset = st.filesize;
+    }
+    unsigned long flags = LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT |
+                          (startOffset > 0 ? 0 : LIBSSH2_FXF_TRUNC);
+    LIBSSH2_SFTP_HANDLE *wh =
+        libssh2_sftp_open_ex(sftp_, remote.c_str(), (unsigned)remote.size(),
+                             flags, 0644, LIBSSH2_SFTP_OPENFILE);
+    if (!wh) {
+        err = "Could not open remote file for writing";
+        return false;
+    }
+    if (startOffset > 0)
+        libssh2_sftp_seek64(wh, startOffset);
+
+    // Same staging window as put(): fresh data is appended behind the
+    // unacknowledged tail so the WRITE pipeline never drains.
+    const std::size_t window = std::min(
+        sftpPipelineDepth_ * sftpRequestSize_, kSftpMaxInFlightBytes);
+    std::vector<char> staging(window);
+    std::size_t head = 0; // first unacknowledged byte in staging
+    std::size_t used = 0; // end of buffered data in staging
+    bool sourceEnd = false;
+    bool writeOk = true;
+    bool closeRemote = true;
+    while (true) {
+        if (head > 0 && (used == staging.size() || head >= window / 2)) {
+            std::memmove(staging.data(), staging.data() + head, used - head);
+            used -= head;
+            head = 0;
+        }
+        // Wait for the source only when nothing is left to send.
+        while (!sourceEnd && used < staging.size() &&
+               (head == used || used - head < sftpRequestSize_)) {
+            const std::ptrdiff_t got =
+                source(staging.data() + used, staging.size() - used);
+            if (got < 0) {
+                err = "Stream source failed";
+                writeOk = false;
+                break;
+            }
+            if (got == 0)
+                sourceEnd = true;
+            used += (std::size_t)got;
+        }
+        if (!writeOk || head == used)
+            break; // source failure, or everything sent and acknowledged
+        if (shouldCancel && shouldCancel()) {
+            err = "Canceled by user";
+            closeRemote = false;
+            writeOk = false;
+            break;
+        }
+        turn.yield();
+        TraceSpan chunkSpan("sftp.write_stream", "sftp");
+        ssize_t w = libssh2_sftp_write(wh, staging.data() + head, used - head);
+        chunkSpan.setArg("bytes", w > 0 ? (std::uint64_t)w : 0);
+        chunkSpan.end();
+        if (w < 0) {
+            const bool canceledNow = (shouldCancel && shouldCancel());
+            err = canceledNow ? "Canceled by user" : "Remote write failed";
+            closeRemote = !canceledNow;
+            writeOk = false;
+            break;
+        }
+        head += (std::size_t)w;
+    }
+    if (!writeOk) {
+        if (closeRemote)
+            (void)libssh2_sftp_close(wh);
+        return false;
+    }
+    if (libssh2_sftp_close(wh) != 0) {
+        err = "Could not close remote file";
+        return false;
+    }
+    return true;
+}
+
+// Upload a local file to remote (create/truncate). Reports progress and
+// supports cancellation.
+bool Libssh2SftpClient::put(
+    const std::string &local, const std::string &remote, std::string &err,
+    std::function<void(std::size_t, std::size_t)> progress,
+    std::function<bool()> shouldCancel, bool resume) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
+    if (!connected_ || !sftp_) {
+        err = "Not connected";
+        return false;
+    }
+
+    apply_transfer_socket_timeouts(sock_);
+
+    const TransferIntegrityPolicy policy = transferIntegrityPolicy_;
+    const std::string remotePart = remote + ".part";
+
+    // Open local for reading (memory-mapped when possible)
+    LocalFileReader lf;
+    if (!lf.open(local, localIo_, err))
+        return false;
+    const std::size_t total = (std::size_t)lf.size();
+
+    // Resume against remote .part (final destination is set via atomic rename).
+    long startOffset = 0;
+    if (resume) {
+        LIBSSH2_SFTP_ATTRIBUTES stR{};
+        if (libssh2_sftp_stat_ex(sftp_, remotePart.c_str(),
                                  (unsigned)remotePart.size(), LIBSSH2_SFTP_STAT,
                                  &stR) == 0) {
             if (stR.flags & LIBSSH2_SFTP_ATTR_SIZE)
@@ -3139,7 +4543,6 @@ bool Libssh2SftpClient::put(
 
     if (startOffset > 0 && (std::size_t)startOffset > total) {
         if (policy == TransferIntegrityPolicy::Required) {
-            std::fclose(lf);
             err = "Invalid resume: remote .part is larger than local file";
             return false;
         }
@@ -3159,13 +4562,11 @@ bool Libssh2SftpClient::put(
                                                   window, rsum, &herr,
                                                   &shouldCancel);
         if (shouldCancel && shouldCancel()) {
-            std::fclose(lf);
             err = "Canceled by user";
             return false;
         }
         if (!lok || !rok) {
             if (policy == TransferIntegrityPolicy::Required) {
-                std::fclose(lf);
                 err = std::string(
                           "Could not validate resume integrity (upload): ") +
                       herr;
@@ -3174,7 +4575,6 @@ bool Libssh2SftpClient::put(
             startOffset = 0;
         } else if (lsum != rsum) {
             if (policy == TransferIntegrityPolicy::Required) {
-                std::fclose(lf);
                 err = "Integrity check failed in resume (upload): local/remote "
                       "prefix does not match";
                 return false;
@@ -3189,69 +4589,120 @@ bool Libssh2SftpClient::put(
         sftp_, remotePart.c_str(), (unsigned)remotePart.size(), flags, 0644,
         LIBSSH2_SFTP_OPENFILE);
     if (!wh) {
-        std::fclose(lf);
         err = "Could not open remote (.part) for writing";
         return false;
     }
 
-    const std::size_t CHUNK = 64 * 1024;
-    std::vector<char> buf(CHUNK);
     std::size_t done = 0;
 
-    // If resuming, advance local and remote
+    // If resuming, advance the remote handle; the local reader starts at
+    // the same offset.
     if (resume && startOffset > 0 && (std::size_t)startOffset < total) {
         libssh2_sftp_seek64(wh, (libssh2_uint64_t)startOffset);
-        if (std::fseek(lf, startOffset, SEEK_SET) != 0) {
-            err = "Could not seek local file";
-            libssh2_sftp_close(wh);
-            std::fclose(lf);
-            return false;
-        }
         done = (std::size_t)startOffset;
     }
 
-    while (true) {
-        size_t n = std::fread(buf.data(), 1, buf.size(), lf);
-        if (n > 0) {
-            char *p = buf.data();
-            size_t remain = n;
-            while (remain > 0) {
-                if (shouldCancel && shouldCancel()) {
-                    err = "Canceled by user";
-                    std::fclose(lf);
-                    // Avoid a potentially blocking per-handle close on
-                    // cancellation; worker disconnect will release it.
-                    return false;
-                }
-                ssize_t w = libssh2_sftp_write(wh, p, remain);
-                if (w < 0) {
-                    const bool canceledNow = (shouldCancel && shouldCancel());
-                    err = canceledNow ? "Canceled by user" : "Remote write failed";
-                    if (!canceledNow) {
-                        (void)libssh2_sftp_close(wh);
+    // Digest the local data inline as it is read for upload; a resumed
+    // prefix is hashed up front.
+    Sha256Stream localHash;
+    const bool hashInline = policy != TransferIntegrityPolicy::Off;
+    if (hashInline && done > 0) {
+        std::string hErr;
+        if (!feed_local_range(local, 0, done, localHash, &hErr,
+                              &shouldCancel)) {
+            if (shouldCancel && shouldCancel()) {
+                libssh2_sftp_close(wh);
+                err = "Canceled by user";
+                return false;
+            }
+            localHash.ok = false;
+        }
+    }
+
+    // Pipelined upload. libssh2_sftp_write() sends every not-yet-sent part
+    // of the buffer it is given as separate WRITE requests and returns once
+    // the oldest ones are acknowledged; the next call must start at the first
+    // unacknowledged byte. Keeping a staging window of depth * request size
+    // and appending fresh data behind the in-flight tail as ACKs arrive keeps
+    // the pipe full instead of draining it after every chunk.
+    const std::size_t window = std::min(
+        sftpPipelineDepth_ * sftpRequestSize_, kSftpMaxInFlightBytes);
+    std::vector<char> staging(window);
+    std::size_t head = 0; // first unacknowledged byte in staging
+    std::size_t used = 0; // end of buffered data in staging
+    bool localEof = false;
+    bool writeOk = true;
+    bool closeRemote = true;
+    {
+        LocalReadAhead reader(
+            lf, done,
+            std::max({window / 2, sftpRequestSize_, localIo_.buffer_size}),
+            hashInline ? &localHash : nullptr);
+        const char *block = nullptr;
+        std::size_t blockLen = 0;
+        std::size_t blockOff = 0;
+        while (true) {
+            if (head > 0 && (used == staging.size() || head >= window / 2)) {
+                std::memmove(staging.data(), staging.data() + head,
+                             used - head);
+                used -= head;
+                head = 0;
+            }
+            while (!localEof && used < staging.size()) {
+                if (blockOff == blockLen) {
+                    if (!reader.next(block, blockLen)) {
+                        err = "Local read failed";
+                        writeOk = false;
+                        break;
+                    }
+                    blockOff = 0;
+                    if (blockLen == 0) {
+                        localEof = true;
+                        break;
                     }
-                    std::fclose(lf);
-                    return false;
                 }
-                remain = remain - (size_t)w;
-                p = p + w;
-                done = done + (size_t)w;
-                if (progress && total)
-                    progress(done, total);
+                const std::size_t take =
+                    std::min(blockLen - blockOff, staging.size() - used);
+                std::memcpy(staging.data() + used, block + blockOff, take);
+                used += take;
+                blockOff += take;
             }
-        } else {
-            if (std::ferror(lf)) {
-                err = "Local read failed";
-                libssh2_sftp_close(wh);
-                std::fclose(lf);
-                return false;
+            if (!writeOk || head == used)
+                break; // local failure, or everything sent and acknowledged
+            if (shouldCancel && shouldCancel()) {
+                err = "Canceled by user";
+                // Avoid a potentially blocking per-handle close on
+                // cancellation; worker disconnect will release it.
+                closeRemote = false;
+                writeOk = false;
+                break;
             }
-            break; // EOF
+            turn.yield();
+            TraceSpan chunkSpan("sftp.write", "sftp");
+            ssize_t w =
+                libssh2_sftp_write(wh, staging.data() + head, used - head);
+            chunkSpan.setArg("bytes", w > 0 ? (std::uint64_t)w : 0);
+            chunkSpan.end();
+            if (w < 0) {
+                const bool canceledNow = (shouldCancel && shouldCancel());
+                err = canceledNow ? "Canceled by user" : "Remote write failed";
+                closeRemote = !canceledNow;
+                writeOk = false;
+                break;
+            }
+            head += (std::size_t)w;
+            done = done + (std::size_t)w;
+            if (progress && total)
+                progress(done, total);
         }
     }
+    if (!writeOk) {
+        if (closeRemote)
+            (void)libssh2_sftp_close(wh);
+        return false;
+    }
 
     libssh2_sftp_close(wh);
-    std::fclose(lf);
 
     if (shouldCancel && shouldCancel()) {
         err = "Canceled by user";
@@ -3261,10 +4712,13 @@ bool Libssh2SftpClient::put(
     if (policy != TransferIntegrityPolicy::Off) {
         Sha256Digest lsum{}, rsum{};
         std::string herr;
-        const bool lok = hash_local_full(local, lsum, &herr, &shouldCancel);
+        const bool lok = localHash.finish(lsum);
+        if (!lok)
+            herr = "Could not hash uploaded data";
         const bool rok =
-            lok && hash_remote_full(sftp_, remotePart, rsum, &herr,
-                                    &shouldCancel);
+            lok && hash_remote_full_server_side(session_, sftp_, remotePart,
+                                                serverHashUnavailable_, rsum,
+                                                &herr, &shouldCancel);
         if (shouldCancel && shouldCancel()) {
             err = "Canceled by user";
             return false;
@@ -3298,9 +4752,513 @@ bool Libssh2SftpClient::put(
     return true;
 }
 
+// Re-upload only the blocks of `local` that differ from `remote`. See
+// SftpClient::putDelta.
+bool Libssh2SftpClient::putDelta(
+    const std::string &local, const std::string &remote, std::string &err,
+    std::function<void(std::size_t, std::size_t)> progress,
+    std::function<bool()> shouldCancel) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
+    if (!connected_ || !sftp_) {
+        err = "Not connected";
+        return false;
+    }
+
+    apply_transfer_socket_timeouts(sock_);
+
+    std::uint64_t localSize = 0;
+    std::uint32_t localMode = 0;
+    std::uint64_t localMtime = 0;
+    if (!stat_local_file(local, localSize, localMode, localMtime)) {
+        err = "Could not read local file";
+        return false;
+    }
+    LIBSSH2_SFTP_ATTRIBUTES rst{};
+    if (libssh2_sftp_stat_ex(sftp_, remote.c_str(), (unsigned)remote.size(),
+                             LIBSSH2_SFTP_STAT, &rst) != 0 ||
+        !(rst.flags & LIBSSH2_SFTP_ATTR_SIZE) ||
+        ((rst.flags & LIBSSH2_SFTP_ATTR_PERMISSIONS) &&
+         !LIBSSH2_SFTP_S_ISREG(rst.permissions))) {
+        err = "Delta upload needs an existing regular remote file";
+        return false;
+    }
+    const std::uint64_t remoteSize = rst.filesize;
+    const std::uint64_t block =
+        delta_block_size(std::max(localSize, remoteSize));
+    const std::uint64_t remoteBlocks = (remoteSize + block - 1) / block;
+
+    // 1) Block digests of the current remote file, computed by the server.
+    std::string out;
+    int exitStatus = -1;
+    std::string why;
+    if (!run_exec_capture(session_, sock_,
+                          delta_digest_command(remote, block, remoteBlocks),
+                          (std::size_t)(remoteBlocks + 1) * 128, out,
+                          exitStatus, why, shouldCancel)) {
+        err = why;
+        return false;
+    }
+    std::vector<Sha256Digest> remoteDigests;
+    remoteDigests.reserve((std::size_t)remoteBlocks);
+    for (std::size_t pos = 0; pos < out.size();) {
+        std::size_t nl = out.find('\n', pos);
+        if (nl == std::string::npos)
+            nl = out.size();
+        Sha256Digest d{};
+        if (!parse_sha256_hex(out.substr(pos, nl - pos), d))
+            break;
+        remoteDigests.push_back(d);
+        pos = nl + 1;
+    }
+    if (exitStatus != 0 || remoteDigests.size() != remoteBlocks) {
+        err = "Server cannot compute block checksums";
+        return false;
+    }
+
+    // 2) One local pass: block digests pick the blocks to send, the whole
+    // file digest verifies the result.
+    LocalFileReader lf;
+    if (!lf.open(local, localIo_, err))
+        return false;
+    std::vector<std::uint64_t> changed;
+    Sha256Stream localHash;
+    bool scanOk = true;
+    {
+        LocalReadAhead reader(lf, 0, (std::size_t)block, &localHash);
+        std::uint64_t index = 0;
+        while (true) {
+            if (shouldCancel && shouldCancel()) {
+                err = "Canceled by user";
+                scanOk = false;
+                break;
+            }
+            const char *data = nullptr;
+            std::size_t n = 0;
+            if (!reader.next(data, n)) {
+                err = "Local read failed";
+                scanOk = false;
+                break;
+            }
+            if (n == 0)
+                break;
+            bool same = false;
+            if (index < remoteDigests.size()) {
+                Sha256Stream blockHash;
+                blockHash.update(data, n);
+                Sha256Digest d{};
+                same = blockHash.finish(d) && d == remoteDigests[index];
+            }
+            if (!same)
+                changed.push_back(index);
+            ++index;
+        }
+    }
+    if (!scanOk)
+        return false;
+    Sha256Digest localSum{};
+    if (!localHash.finish(localSum)) {
+        err = "Could not hash local file";
+        return false;
+    }
+    if (changed.empty() && localSize == remoteSize) {
+        core_logf(CoreLogLevel::Debug, "Delta upload: %s is unchanged",
+                  remote.c_str());
+        return true;
+    }
+
+    // 3) Duplicate the remote file on the server and patch the copy. The
+    // copy gets its own name so a resumable "<remote>.part" of an earlier
+    // put() is left alone, and keeps the original's mode (cp -p).
+#ifdef _WIN32
+    const unsigned long pid = (unsigned long)GetCurrentProcessId();
+#else
+    const unsigned long pid = (unsigned long)::getpid();
+#endif
+    const std::string remoteCopy = remote + ".delta." + std::to_string(pid);
+    auto dropCopy = [&]() {
+        (void)libssh2_sftp_unlink_ex(sftp_, remoteCopy.c_str(),
+                                     (unsigned)remoteCopy.size());
+    };
+    out.clear();
+    why.clear();
+    const bool copied = run_exec_capture(
+        session_, sock_,
+        "cp -p -- " + shell_single_quote(remote) + " " +
+            shell_single_quote(remoteCopy),
+        4096, out, exitStatus, why, shouldCancel);
+    if (!copied || exitStatus != 0) {
+        dropCopy();
+        err = copied ? "Server-side copy failed" : why;
+        return false;
+    }
+    LIBSSH2_SFTP_HANDLE *wh = libssh2_sftp_open_ex(
+        sftp_, remoteCopy.c_str(), (unsigned)remoteCopy.size(),
+        LIBSSH2_FXF_WRITE, 0, LIBSSH2_SFTP_OPENFILE);
+    if (!wh) {
+        dropCopy();
+        err = "Could not open remote (delta copy) for writing";
+        return false;
+    }
+    std::uint64_t toSend = 0;
+    for (std::uint64_t index : changed)
+        toSend += std::min(block, localSize - index * block);
+    LocalIoBuffer buf(lf.mapped() ? 0 : (std::size_t)block);
+    std::uint64_t sent = 0;
+    bool writeOk = true;
+    for (std::uint64_t index : changed) {
+        if (shouldCancel && shouldCancel()) {
+            err = "Canceled by user";
+            writeOk = false;
+            break;
+        }
+        const std::uint64_t off = index * block;
+        const std::size_t n = (std::size_t)std::min(block, localSize - off);
+        const char *data = nullptr;
+        std::size_t got = 0;
+        if (!lf.read(off, n, buf.data(), data, got, why) || got != n) {
+            err = "Local read failed";
+            writeOk = false;
+            break;
+        }
+        libssh2_sftp_seek64(wh, (libssh2_uint64_t)off);
+        std::size_t written = 0;
+        while (written < n) {
+            OPENSCP_TRACE_SPAN("sftp.write_delta", "sftp");
+            const ssize_t w =
+                libssh2_sftp_write(wh, data + written, n - written);
+            if (w < 0) {
+                err = "Remote write failed";
+                writeOk = false;
+                break;
+            }
+            written += (std::size_t)w;
+            if (progress && toSend)
+                progress((std::size_t)(sent + written), (std::size_t)toSend);
+        }
+        if (!writeOk)
+            break;
+        sent += n;
+    }
+    if (writeOk && localSize < remoteSize) {
+        LIBSSH2_SFTP_ATTRIBUTES attrs{};
+        attrs.flags = LIBSSH2_SFTP_ATTR_SIZE;
+        attrs.filesize = localSize;
+        if (libssh2_sftp_fsetstat(wh, &attrs) != 0) {
+            err = "Could not truncate remote (delta copy)";
+            writeOk = false;
+        }
+    }
+    lf.close();
+    if (libssh2_sftp_close(wh) != 0 && writeOk) {
+        err = "Remote write failed";
+        writeOk = false;
+    }
+    if (!writeOk) {
+        dropCopy();
+        return false;
+    }
+
+    // 4) Blocks were matched by digest only; verify the patched copy as a
+    // whole before it replaces the original.
+    Sha256Digest remoteSum{};
+    why.clear();
+    if (!hash_remote_exec(session_, remoteCopy, remoteSum, &why,
+                          &shouldCancel)) {
+        dropCopy();
+        err = std::string("Could not verify delta upload: ") + why;
+        return false;
+    }
+    if (remoteSum != localSum) {
+        dropCopy();
+        err = "Delta upload integrity check failed: local/remote checksum "
+              "mismatch";
+        return false;
+    }
+
+    std::string rnErr;
+    if (!rename_remote_with_fallback(sftp_, remoteCopy, remote, true, &rnErr)) {
+        dropCopy();
+        err = std::string(
+                  "Could not finalize upload (delta copy -> destination): ") +
+              rnErr;
+        return false;
+    }
+    core_logf(CoreLogLevel::Debug,
+              "Delta upload: %s sent %llu of %llu bytes (%zu blocks)",
+              remote.c_str(), (unsigned long long)sent,
+              (unsigned long long)localSize, changed.size());
+    return true;
+}
+
+// Upload a batch of small files as one tar stream unpacked by the server.
+bool Libssh2SftpClient::putBatch(const std::string &local_root,
+                                 const std::vector<std::string> &relative_paths,
+                                 const std::string &remote_root,
+                                 std::string &err, const BatchFileCB &onFile,
+                                 std::function<bool()> shouldCancel) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
+    if (!connected_ || !session_) {
+        err = "Not connected";
+        return false;
+    }
+    for (const auto &rel : relative_paths) {
+        if (!isSafeArchivePath(rel)) {
+            err = "Unsafe path in archive batch: " + rel;
+            return false;
+        }
+    }
+    apply_transfer_socket_timeouts(sock_);
+
+    std::string *chunk = nullptr;
+    TarWriter writer([&chunk](const char *data, std::size_t len) {
+        chunk->append(data, len);
+        return true;
+    });
+    std::vector<char> readBuf(kArchiveChunkSize);
+    std::size_t next = 0;
+    FILE *cur = nullptr;
+    std::string curRel;
+    std::uint64_t curSize = 0;
+    std::uint64_t curLeft = 0;
+    std::string localErr;
+    auto produce = [&](std::string &out, bool &done) -> bool {
+        chunk = &out;
+        while (out.size() < kArchiveChunkSize) {
+            if (!cur) {
+                if (next == relative_paths.size()) {
+                    if (!writer.finish(localErr))
+                        return false;
+                    done = true;
+                    return true;
+                }
+                curRel = relative_paths[next++];
+                const std::string path = join_local_path(local_root, curRel);
+                std::uint64_t size = 0;
+                std::uint32_t mode = 0;
+                std::uint64_t mtime = 0;
+                if (!stat_local_file(path, size, mode, mtime)) {
+                    localErr = "Could not read local file: " + path;
+                    return false;
+                }
+                cur = ::fopen(path.c_str(), "rb");
+                if (!cur) {
+                    localErr = "Could not open local file: " + path;
+                    return false;
+                }
+                TarEntry entry;
+                entry.path = curRel;
+                entry.size = size;
+                entry.mode = mode;
+                entry.mtime = mtime;
+                if (!writer.beginEntry(entry, localErr))
+                    return false;
+                curSize = size;
+                curLeft = size;
+            }
+            if (curLeft > 0) {
+                const std::size_t want = (std::size_t)std::min<std::uint64_t>(
+                    readBuf.size(), curLeft);
+                const std::size_t n = std::fread(readBuf.data(), 1, want, cur);
+                if (n == 0) {
+                    localErr = "Local file changed while archiving: " + curRel;
+                    return false;
+                }
+                if (!writer.writeData(readBuf.data(), n, localErr))
+                    return false;
+                curLeft -= n;
+                continue;
+            }
+            std::fclose(cur);
+            cur = nullptr;
+            if (!writer.endEntry(localErr))
+                return false;
+            if (onFile)
+                onFile(curRel, curSize);
+        }
+        return true;
+    };
+    // tar -x stays silent on stdout; errors arrive on stderr.
+    auto consume = [](const char *, std::size_t) { return true; };
+
+    const std::string q = shell_single_quote(remote_root);
+    const std::string cmd = "mkdir -p -- " + q + " && tar -xf - -C " + q;
+    int exitStatus = -1;
+    std::string stderrText;
+    std::string why;
+    const bool ran = run_exec_stream(session_, sock_, cmd, produce, consume,
+                                     exitStatus, stderrText, why,
+                                     shouldCancel);
+    if (cur)
+        std::fclose(cur);
+    if (!ran) {
+        err = localErr.empty() ? why : localErr;
+        return false;
+    }
+    if (exitStatus != 0) {
+        err = exec_exit_error("tar", exitStatus, stderrText);
+        return false;
+    }
+    return true;
+}
+
+// Download a batch of small files from one tar stream packed by the server.
+bool Libssh2SftpClient::getBatch(const std::string &remote_root,
+                                 const std::vector<std::string> &relative_paths,
+                                 const std::string &local_root,
+                                 std::string &err, const BatchFileCB &onFile,
+                                 std::function<bool()> shouldCancel) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
+    if (!connected_ || !session_) {
+        err = "Not connected";
+        return false;
+    }
+    // Names travel to `tar -T -` one per line, and GNU tar unquotes
+    // backslashes there; such names must use per-file transfers.
+    for (const auto &rel : relative_paths) {
+        if (!isSafeArchivePath(rel) ||
+            rel.find_first_of("\n\\") != std::string::npos) {
+            err = "Path cannot be part of an archive batch: " + rel;
+            return false;
+        }
+    }
+    apply_transfer_socket_timeouts(sock_);
+
+    namespace fs = std::filesystem;
+    std::size_t nextName = 0;
+    auto produce = [&](std::string &out, bool &done) -> bool {
+        while (out.size() < kArchiveChunkSize &&
+               nextName < relative_paths.size()) {
+            // "./" keeps names that start with '-' from reading as options.
+            out += "./";
+            out += relative_paths[nextName++];
+            out += '\n';
+        }
+        done = nextName == relative_paths.size();
+        return true;
+    };
+
+    const std::unordered_set<std::string> wanted(relative_paths.begin(),
+                                                 relative_paths.end());
+    std::unordered_set<std::string> received;
+    FILE *cur = nullptr;
+    TarEntry curEntry;
+    std::string curLocal;
+    std::string curPart;
+    std::string localErr;
+    TarReader::Callbacks cb;
+    cb.onEntry = [&](const TarEntry &entry) -> bool {
+        // Only the requested files are written; anything else the server
+        // sends (directories, unexpected or unsafe names) is ignored.
+        if (entry.is_dir || !isSafeArchivePath(entry.path) ||
+            !wanted.count(entry.path))
+            return true;
+        curEntry = entry;
+        curLocal = join_local_path(local_root, entry.path);
+        curPart = curLocal + ".part";
+        std::error_code ec;
+        fs::create_directories(fs::path(curLocal).parent_path(), ec);
+        cur = ::fopen(curPart.c_str(), "wb");
+        if (!cur) {
+            localErr = "Could not open local file for writing: " + curLocal;
+            return false;
+        }
+        return true;
+    };
+    cb.onData = [&](const char *data, std::size_t len) -> bool {
+        if (!cur)
+            return true;
+        if (std::fwrite(data, 1, len, cur) != len) {
+            localErr = "Local write failed: " + curLocal;
+            return false;
+        }
+        return true;
+    };
+    cb.onEntryEnd = [&]() -> bool {
+        if (!cur)
+            return true;
+        const bool closed = std::fclose(cur) == 0;
+        cur = nullptr;
+        // No per-file fsync: that would cost what batching saves.
+        std::error_code ec;
+        if (closed)
+            fs::rename(curPart, curLocal, ec);
+        if (!closed || ec) {
+            fs::remove(curPart, ec);
+            localErr = "Could not finalize local file: " + curLocal;
+            return false;
+        }
+        if (curEntry.mtime > 0)
+            set_local_mtime(curLocal, curEntry.mtime);
+        received.insert(curEntry.path);
+        if (onFile)
+            onFile(curEntry.path, curEntry.size);
+        return true;
+    };
+    TarReader reader(std::move(cb));
+    std::string parseErr;
+    auto consume = [&](const char *data, std::size_t len) {
+        return reader.feed(data, len, parseErr);
+    };
+
+    const std::string cmd =
+        "cd -- " + shell_single_quote(remote_root) + " && tar -cf - -T -";
+    int exitStatus = -1;
+    std::string stderrText;
+    std::string why;
+    const bool ran = run_exec_stream(session_, sock_, cmd, produce, consume,
+                                     exitStatus, stderrText, why,
+                                     shouldCancel);
+    if (cur) {
+        std::fclose(cur);
+        std::error_code ec;
+        fs::remove(curPart, ec);
+    }
+    if (!ran) {
+        if (!parseErr.empty())
+            err = parseErr;
+        else
+            err = localErr.empty() ? why : localErr;
+        return false;
+    }
+    if (exitStatus != 0 && received.size() != wanted.size()) {
+        err = exec_exit_error("tar", exitStatus, stderrText);
+        return false;
+    }
+    if (!reader.finished() || reader.inEntry()) {
+        err = "Archive stream ended unexpectedly";
+        return false;
+    }
+    if (received.size() != wanted.size()) {
+        err = "Remote archive is missing " +
+              std::to_string(wanted.size() - received.size()) + " file(s)";
+        return false;
+    }
+    return true;
+}
+
 // Lightweight existence check using sftp_stat.
 bool Libssh2SftpClient::exists(const std::string &remote_path, bool &isDir,
                                std::string &err) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     isDir = false;
     if (!connected_ || !sftp_) {
         err = "Not connected";
@@ -3334,6 +5292,11 @@ bool Libssh2SftpClient::exists(const std::string &remote_path, bool &isDir,
 // exist.
 bool Libssh2SftpClient::stat(const std::string &remote_path, FileInfo &info,
                              std::string &err) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -3377,6 +5340,11 @@ bool Libssh2SftpClient::stat(const std::string &remote_path, FileInfo &info,
 
 bool Libssh2SftpClient::chmod(const std::string &remote_path,
                               std::uint32_t mode, std::string &err) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -3405,6 +5373,11 @@ bool Libssh2SftpClient::chmod(const std::string &remote_path,
 bool Libssh2SftpClient::setTimes(const std::string &remote_path,
                                  std::uint64_t atime, std::uint64_t mtime,
                                  std::string &err) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -3425,6 +5398,11 @@ bool Libssh2SftpClient::setTimes(const std::string &remote_path,
 
 bool Libssh2SftpClient::chown(const std::string &remote_path, std::uint32_t uid,
                               std::uint32_t gid, std::string &err) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -3455,6 +5433,11 @@ bool Libssh2SftpClient::chown(const std::string &remote_path, std::uint32_t uid,
 
 bool Libssh2SftpClient::mkdir(const std::string &remote_dir, std::string &err,
                               unsigned int mode) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -3469,6 +5452,11 @@ bool Libssh2SftpClient::mkdir(const std::string &remote_dir, std::string &err,
 
 bool Libssh2SftpClient::removeFile(const std::string &remote_path,
                                    std::string &err) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -3483,6 +5471,11 @@ bool Libssh2SftpClient::removeFile(const std::string &remote_path,
 
 bool Libssh2SftpClient::removeDir(const std::string &remote_dir,
                                   std::string &err) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -3497,6 +5490,11 @@ bool Libssh2SftpClient::removeDir(const std::string &remote_dir,
 
 bool Libssh2SftpClient::rename(const std::string &from, const std::string &to,
                                std::string &err, bool overwrite) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
     if (!connected_ || !sftp_) {
         err = "Not connected";
         return false;
@@ -3509,79 +5507,238 @@ bool Libssh2SftpClient::rename(const std::string &from, const std::string &to,
     return true;
 }
 
-bool RemoveKnownHostEntry(const std::string &khPath, const std::string &host,
-                          std::uint16_t port, std::string &err) {
-    err.clear();
-    if (khPath.empty()) {
-        err = "known_hosts path is empty";
+bool Libssh2SftpClient::copyRemote(const std::string &from,
+                                   const std::string &to, std::string &err,
+                                   bool overwrite,
+                                   std::function<bool()> shouldCancel) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
         return false;
     }
-    if (host.empty()) {
-        err = "host is empty";
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
+    if (!connected_ || !sftp_) {
+        err = "Not connected";
         return false;
     }
-
-    std::ifstream in(khPath, std::ios::binary);
-    if (!in.is_open()) {
-        err = "Could not open known_hosts";
+    bool srcIsDir = false;
+    if (!exists(from, srcIsDir, err)) {
+        if (err.empty())
+            err = "Source does not exist";
         return false;
     }
-
-    const std::string content((std::istreambuf_iterator<char>(in)),
-                              std::istreambuf_iterator<char>());
-    if (!in.good() && !in.eof()) {
-        err = "Could not read known_hosts";
+    bool dstIsDir = false;
+    std::string dstErr;
+    if (exists(to, dstIsDir, dstErr)) {
+        // cp would copy into an existing folder instead of replacing it.
+        if (!overwrite || srcIsDir || dstIsDir) {
+            err = "Destination already exists";
+            return false;
+        }
+    } else if (!dstErr.empty()) {
+        err = dstErr;
         return false;
     }
 
-    std::vector<std::string> hostTokens;
-    if (port == 22) {
-        hostTokens.push_back(host);
-        // Support this uncommon notation if present in existing files.
-        hostTokens.push_back("[" + host + "]:22");
-    } else {
-        hostTokens.push_back("[" + host + "]:" + std::to_string(port));
+    int exitStatus = -1;
+    std::string stderrText;
+    std::string why;
+    if (!run_exec_quiet(session_, sock_,
+                        "cp -Rp -- " + shell_single_quote(from) + " " +
+                            shell_single_quote(to),
+                        exitStatus, stderrText, why, shouldCancel)) {
+        err = why;
+        return false;
+    }
+    if (exitStatus != 0) {
+        err = exec_exit_error("cp", exitStatus, stderrText);
+        return false;
     }
+    return true;
+}
 
-    const bool hadTrailingLf = !content.empty() && content.back() == '\n';
-    std::istringstream inLines(content);
-    std::vector<std::string> keptLines;
-    std::string line;
-    bool removedAny = false;
+bool Libssh2SftpClient::chmodTree(const std::string &remote_path,
+                                  std::uint32_t mode, std::string &err,
+                                  std::function<bool()> shouldCancel) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
+    if (!connected_ || !sftp_) {
+        err = "Not connected";
+        return false;
+    }
+    char octal[16];
+    std::snprintf(octal, sizeof(octal), "%o", (unsigned)(mode & 07777u));
+    int exitStatus = -1;
+    std::string stderrText;
+    std::string why;
+    // chmod -R skips symlinks met during the walk (BSD and GNU alike).
+    if (!run_exec_quiet(session_, sock_,
+                        std::string("chmod -R ") + octal + " -- " +
+                            shell_single_quote(remote_path),
+                        exitStatus, stderrText, why, shouldCancel)) {
+        err = why;
+        return false;
+    }
+    if (exitStatus != 0) {
+        err = exec_exit_error("chmod", exitStatus, stderrText);
+        return false;
+    }
+    return true;
+}
 
-    while (std::getline(inLines, line)) {
-        if (!line.empty() && line.back() == '\r')
-            line.pop_back();
-        if (line_matches_site_host(line, hostTokens)) {
-            removedAny = true;
-            continue;
+bool Libssh2SftpClient::findEntries(const std::string &remote_dir,
+                                    const FindOptions &filter,
+                                    const FindEntryCB &onEntry, bool &partial,
+                                    std::string &err,
+                                    std::function<bool()> shouldCancel) {
+    ChannelTurn turn(mux_, *io_, interrupted_);
+    if (!turn.held()) {
+        err = kInterruptedError;
+        return false;
+    }
+    shouldCancel = cancel_or_interrupt(interrupted_, std::move(shouldCancel));
+    partial = false;
+    if (!connected_ || !sftp_) {
+        err = "Not connected";
+        return false;
+    }
+    // Paths are printed relative to the folder, each record being a type
+    // letter, the path and a NUL, so any file name survives the trip.
+    std::string expr = "find . -mindepth 1";
+    if (!filter.include_hidden)
+        expr += " -name '.*' -prune -o";
+    if (!filter.name_glob.empty()) {
+        expr += filter.case_insensitive ? " -iname " : " -name ";
+        expr += shell_single_quote(filter.name_glob);
+    }
+    const std::string head = "cd -- " + shell_single_quote(remote_dir) +
+                             " && " + expr;
+    // GNU find formats the records itself; elsewhere printf(1) does, once
+    // per batch of names.
+    const std::string commands[] = {
+        head + " \\( -type d -printf 'd%P\\0' -o -printf 'f%P\\0' \\)",
+        head + " \\( -type d -exec printf 'd%s\\0' {} + -o"
+               " -exec printf 'f%s\\0' {} + \\)"};
+
+    bool stopped = false;
+    std::uint64_t delivered = 0;
+    for (const std::string &cmd : commands) {
+        std::string record;
+        auto produce = [](std::string &, bool &done) {
+            done = true;
+            return true;
+        };
+        auto consume = [&](const char *data, std::size_t len) {
+            for (std::size_t i = 0; i < len; ++i) {
+                if (data[i] != '\0') {
+                    record.push_back(data[i]);
+                    continue;
+                }
+                std::string rel = record.substr(record.empty() ? 0 : 1);
+                if (rel.compare(0, 2, "./") == 0)
+                    rel.erase(0, 2);
+                const bool isDir = !record.empty() && record[0] == 'd';
+                record.clear();
+                if (rel.empty())
+                    continue;
+                ++delivered;
+                if (!onEntry(rel, isDir)) {
+                    stopped = true;
+                    return false;
+                }
+            }
+            return true;
+        };
+        int exitStatus = -1;
+        std::string stderrText;
+        std::string why;
+        if (!run_exec_stream(session_, sock_, cmd, produce, consume,
+                             exitStatus, stderrText, why, shouldCancel)) {
+            if (stopped)
+                return true;
+            err = why;
+            return false;
         }
-        keptLines.push_back(line);
+        if (exitStatus == 0)
+            return true;
+        if (delivered > 0) {
+            // Unreadable folders make find exit 1 after everything else.
+            partial = true;
+            return true;
+        }
+        err = exec_exit_error("find", exitStatus, stderrText);
     }
+    return false;
+}
 
-    if (!removedAny)
-        return true;
+std::unique_ptr<Libssh2SftpClient>
+Libssh2SftpClient::openMultiplexedChannel(const SessionOptions &opt,
+                                          std::string &err) {
+    std::shared_ptr<SharedSshTransport> mux;
+    {
+        std::lock_guard<std::mutex> lk(stateMutex_);
+        if (!connected_ || !mux_)
+            return nullptr;
+        mux = mux_;
+    }
+    if (mux->endpoint != multiplex_endpoint(opt))
+        return nullptr;
+    // Reserve the slot before opening, so racing clones cannot overfill it.
+    if (++mux->channels > kMaxSftpChannelsPerTransport) {
+        --mux->channels;
+        return nullptr;
+    }
 
-    std::string rewritten;
-    for (std::size_t i = 0; i < keptLines.size(); ++i) {
-        if (i > 0)
-            rewritten.push_back('\n');
-        rewritten += keptLines[i];
+    const auto start = std::chrono::steady_clock::now();
+    LIBSSH2_SFTP *sftp = nullptr;
+    {
+        ChannelTurn turn(mux);
+        libssh2_session_set_blocking(mux->session, 1);
+        sftp = libssh2_sftp_init(mux->session);
+    }
+    if (!sftp) {
+        --mux->channels;
+        err = "Could not open another SFTP channel";
+        return nullptr;
     }
-    if (hadTrailingLf && !keptLines.empty())
-        rewritten.push_back('\n');
 
-    std::string persistErr;
-    if (!persist_text_atomic(khPath, rewritten, &persistErr)) {
-        err = std::string("Could not write known_hosts: ") + persistErr;
-        return false;
+    auto ptr = std::make_unique<Libssh2SftpClient>();
+    ptr->applyTuning(opt);
+    ConnectTimings timings;
+    timings.sftp_init_ms = elapsed_ms(start);
+    timings.total_ms = timings.sftp_init_ms;
+    {
+        std::lock_guard<std::mutex> lk(ptr->stateMutex_);
+        ptr->session_ = mux->session;
+        ptr->sock_ = mux->sock;
+        ptr->sftp_ = sftp;
+        ptr->negotiated_ = mux->negotiated;
+        ptr->lastTimings_ = timings;
+        ptr->mux_ = std::move(mux);
+        ptr->connected_ = true;
     }
-    return true;
+    {
+        ChannelTurn turn(ptr->mux_);
+        ptr->applyNetworkTuning(opt, timings);
+    }
+    return ptr;
 }
 
 std::unique_ptr<SftpClient>
 Libssh2SftpClient::newConnectionLike(const SessionOptions &opt,
                                      std::string &err) {
+    if (opt.ssh_multiplex) {
+        std::string muxErr;
+        if (auto channel = openMultiplexedChannel(opt, muxErr))
+            return channel;
+        if (!muxErr.empty())
+            core_logf(CoreLogLevel::Debug, "SSH multiplexing: %s",
+                      muxErr.c_str());
+    }
     auto ptr = std::make_unique<Libssh2SftpClient>();
     if (!ptr->connect(opt, err))
         return nullptr;
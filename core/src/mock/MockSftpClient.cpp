@@ -1,61 +1,1311 @@
-// Mock implementation: maintains a map of predefined paths for listing.
+// Mock implementation: an in-memory file system behind a simulated link.
 #include "openscp/MockSftpClient.hpp"
+
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_set>
 
 namespace openscp {
+namespace {
 
-bool MockSftpClient::connect(const SessionOptions &opt, std::string &err) {
-    if (opt.host.empty() || opt.username.empty()) {
-        err = "Host and username are required";
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// mtime of entries that were never written (2023-11-14).
+constexpr std::uint64_t kMockMtime = 1700000000;
+constexpr std::uint32_t kTypeMask = 0170000;
+constexpr std::uint32_t kDirType = 0040000;
+constexpr std::uint32_t kFileType = 0100000;
+// putDelta() compares the files in blocks of this size.
+constexpr std::size_t kDeltaBlock = 64 * 1024;
+
+struct MockNode {
+    bool is_dir = false;
+    std::uint64_t size = 0;
+    std::uint64_t mtime = kMockMtime;
+    std::uint32_t mode = kFileType | 0644;
+    std::uint32_t uid = 1000;
+    std::uint32_t gid = 1000;
+    std::shared_ptr<const std::string> data; // null: the synthetic pattern
+};
+
+// Explicit children plus `synth_count` synthetic files that exist until
+// they are removed (synth_hidden) or replaced by an explicit child.
+struct MockDir {
+    std::map<std::string, MockNode> children;
+    std::uint64_t synth_count = 0;
+    std::uint64_t synth_size = 0;
+    std::uint32_t synth_mode = kFileType | 0644;
+    std::string synth_prefix;
+    std::size_t synth_width = 1;
+    std::unordered_set<std::uint64_t> synth_hidden;
+};
+
+char patternByte(std::uint64_t offset) {
+    return static_cast<char>((offset * 31u + 7u) % 251u);
+}
+
+void readNode(const MockNode &n, std::uint64_t offset, char *out,
+              std::size_t len) {
+    if (n.data) {
+        std::memcpy(out, n.data->data() + offset, len);
+        return;
+    }
+    for (std::size_t i = 0; i < len; ++i)
+        out[i] = patternByte(offset + i);
+}
+
+std::string nodeContents(const MockNode &n) {
+    std::string out(static_cast<std::size_t>(n.size), '\0');
+    readNode(n, 0, out.data(), out.size());
+    return out;
+}
+
+// "/a//b/./c/" -> "/a/b/c"; relative paths are taken from "/".
+std::string normalizePath(const std::string &path) {
+    std::string out;
+    std::size_t i = 0;
+    while (i <= path.size()) {
+        const std::size_t j = std::min(path.find('/', i), path.size());
+        const std::string seg = path.substr(i, j - i);
+        if (!seg.empty() && seg != ".")
+            out += "/" + seg;
+        i = j + 1;
+    }
+    return out.empty() ? "/" : out;
+}
+
+std::string parentOf(const std::string &path) {
+    const std::size_t slash = path.find_last_of('/');
+    return slash == 0 || slash == std::string::npos ? "/"
+                                                    : path.substr(0, slash);
+}
+
+std::string baseName(const std::string &path) {
+    return path.substr(path.find_last_of('/') + 1);
+}
+
+std::string joinPath(const std::string &dir, const std::string &name) {
+    return dir == "/" ? "/" + name : dir + "/" + name;
+}
+
+bool isInside(const std::string &path, const std::string &dir) {
+    return path.size() > dir.size() && path.compare(0, dir.size(), dir) == 0 &&
+           (dir == "/" || path[dir.size()] == '/');
+}
+
+FileInfo toInfo(const std::string &name, const MockNode &n) {
+    FileInfo fi;
+    fi.name = name;
+    fi.is_dir = n.is_dir;
+    fi.size = n.is_dir ? 0 : n.size;
+    fi.has_size = !n.is_dir;
+    fi.mtime = n.mtime;
+    fi.mode = n.mode;
+    fi.uid = n.uid;
+    fi.gid = n.gid;
+    return fi;
+}
+
+} // namespace
+
+struct MockFileSystem::Impl {
+    mutable std::mutex m; // guards everything below but the link and rng
+    MockNode root;
+    std::map<std::string, MockDir> dirs;
+    bool keepContents = true;
+    MockSftpProfile profile;
+    MockSftpStats stats;
+
+    std::mutex linkMutex;
+    Clock::time_point busyUntil{};
+    std::mutex rngMutex;
+    std::mt19937 rng{1};
+
+    Impl() {
+        root.is_dir = true;
+        root.mode = kDirType | 0755;
+        dirs["/"];
+    }
+
+    bool roll(double rate) {
+        if (rate <= 0.0)
+            return false;
+        std::lock_guard<std::mutex> lk(rngMutex);
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate;
+    }
+
+    // Wait for `bytes` to cross a link of `bytesPerSec` shared by every
+    // session.
+    void pace(std::size_t bytes, double bytesPerSec) {
+        if (bytesPerSec <= 0.0)
+            return;
+        Clock::time_point until;
+        {
+            std::lock_guard<std::mutex> lk(linkMutex);
+            const auto cost = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(bytes / bytesPerSec));
+            busyUntil = std::max(busyUntil, Clock::now()) + cost;
+            until = busyUntil;
+        }
+        std::this_thread::sleep_until(until);
+    }
+
+    // Everything below requires `m`.
+
+    MockDir *dir(const std::string &path) {
+        auto it = dirs.find(path);
+        return it == dirs.end() ? nullptr : &it->second;
+    }
+
+    std::string synthName(const MockDir &d, std::uint64_t index) const {
+        std::string digits = std::to_string(index);
+        if (digits.size() < d.synth_width)
+            digits.insert(0, d.synth_width - digits.size(), '0');
+        return d.synth_prefix + digits;
+    }
+
+    // Index of the visible synthetic file called `name`.
+    static bool synthIndex(const MockDir &d, const std::string &name,
+                           std::uint64_t &index) {
+        if (d.synth_count == 0 ||
+            name.size() != d.synth_prefix.size() + d.synth_width ||
+            name.compare(0, d.synth_prefix.size(), d.synth_prefix) != 0)
+            return false;
+        index = 0;
+        for (std::size_t i = d.synth_prefix.size(); i < name.size(); ++i) {
+            if (name[i] < '0' || name[i] > '9')
+                return false;
+            index = index * 10 + static_cast<std::uint64_t>(name[i] - '0');
+        }
+        return index < d.synth_count && d.synth_hidden.count(index) == 0;
+    }
+
+    MockNode synthNode(const MockDir &d) const {
+        MockNode n;
+        n.size = d.synth_size;
+        n.mode = d.synth_mode;
+        return n;
+    }
+
+    bool lookup(const std::string &path, MockNode &out) {
+        if (path == "/") {
+            out = root;
+            return true;
+        }
+        MockDir *d = dir(parentOf(path));
+        if (!d)
+            return false;
+        const std::string name = baseName(path);
+        auto it = d->children.find(name);
+        if (it != d->children.end()) {
+            out = it->second;
+            return true;
+        }
+        std::uint64_t index = 0;
+        if (!synthIndex(*d, name, index))
+            return false;
+        out = synthNode(*d);
+        return true;
+    }
+
+    // Explicit, writable node of `path` (a synthetic file becomes
+    // explicit); nullptr if it does not exist.
+    MockNode *materialize(const std::string &path) {
+        if (path == "/")
+            return &root;
+        MockDir *d = dir(parentOf(path));
+        if (!d)
+            return nullptr;
+        const std::string name = baseName(path);
+        auto it = d->children.find(name);
+        if (it != d->children.end())
+            return &it->second;
+        std::uint64_t index = 0;
+        if (!synthIndex(*d, name, index))
+            return nullptr;
+        d->synth_hidden.insert(index);
+        return &(d->children[name] = synthNode(*d));
+    }
+
+    // Store `n` as `path`, replacing a file (and hiding a synthetic one).
+    bool putNode(const std::string &path, const MockNode &n,
+                 std::string &err) {
+        MockDir *d = dir(parentOf(path));
+        if (!d) {
+            err = "No such directory: " + parentOf(path);
+            return false;
+        }
+        const std::string name = baseName(path);
+        std::uint64_t index = 0;
+        if (synthIndex(*d, name, index))
+            d->synth_hidden.insert(index);
+        d->children[name] = n;
+        return true;
+    }
+
+    // Remove `path` from its parent; the caller handles directory contents.
+    void unlink(const std::string &path) {
+        MockDir *d = dir(parentOf(path));
+        if (!d)
+            return;
+        const std::string name = baseName(path);
+        if (d->children.erase(name) > 0)
+            return;
+        std::uint64_t index = 0;
+        if (synthIndex(*d, name, index))
+            d->synth_hidden.insert(index);
+    }
+
+    bool makeDirs(const std::string &path, std::uint32_t mode,
+                  std::string &err) {
+        if (dir(path))
+            return true;
+        MockNode existing;
+        if (lookup(path, existing)) {
+            err = "Not a directory: " + path;
+            return false;
+        }
+        if (!makeDirs(parentOf(path), mode, err))
+            return false;
+        MockNode n;
+        n.is_dir = true;
+        n.mode = kDirType | (mode & 07777);
+        n.mtime = static_cast<std::uint64_t>(std::time(nullptr));
+        if (!putNode(path, n, err))
+            return false;
+        dirs[path];
+        return true;
+    }
+
+    static std::size_t visibleEntries(const MockDir &d) {
+        return d.children.size() +
+               static_cast<std::size_t>(d.synth_count - d.synth_hidden.size());
+    }
+
+    // `path` itself and every directory below it.
+    std::vector<std::string> subtreeDirs(const std::string &path) {
+        std::vector<std::string> out;
+        if (dirs.count(path))
+            out.push_back(path);
+        const std::string prefix = path == "/" ? "/" : path + "/";
+        for (auto it = dirs.lower_bound(prefix);
+             it != dirs.end() && it->first.compare(0, prefix.size(), prefix) ==
+                                     0;
+             ++it) {
+            if (it->first != path)
+                out.push_back(it->first);
+        }
+        return out;
+    }
+};
+
+MockFileSystem::MockFileSystem() : d_(std::make_unique<Impl>()) {}
+
+MockFileSystem::~MockFileSystem() = default;
+
+std::shared_ptr<MockFileSystem> MockFileSystem::demo() {
+    auto fs = std::make_shared<MockFileSystem>();
+    fs->addDirectory("/home/luis/proyectos");
+    fs->addDirectory("/home/guest");
+    fs->addDirectory("/var/log");
+    fs->addFile("/readme.txt", std::uint64_t{1280});
+    fs->addFile("/home/notes.md", std::uint64_t{2048});
+    fs->addFile("/home/luis/foto.jpg", std::uint64_t{34567});
+    return fs;
+}
+
+MockSftpProfile MockFileSystem::profile() const {
+    std::lock_guard<std::mutex> lk(d_->m);
+    return d_->profile;
+}
+
+void MockFileSystem::setProfile(const MockSftpProfile &profile) {
+    {
+        std::lock_guard<std::mutex> lk(d_->m);
+        d_->profile = profile;
+    }
+    std::lock_guard<std::mutex> lk(d_->rngMutex);
+    d_->rng.seed(profile.seed);
+}
+
+void MockFileSystem::setKeepContents(bool keep) {
+    std::lock_guard<std::mutex> lk(d_->m);
+    d_->keepContents = keep;
+}
+
+bool MockFileSystem::addDirectory(const std::string &path,
+                                  std::uint32_t mode) {
+    std::lock_guard<std::mutex> lk(d_->m);
+    std::string err;
+    return d_->makeDirs(normalizePath(path), mode, err);
+}
+
+bool MockFileSystem::addFile(const std::string &path, std::uint64_t size) {
+    const std::string p = normalizePath(path);
+    std::lock_guard<std::mutex> lk(d_->m);
+    std::string err;
+    MockNode n;
+    n.size = size;
+    return p != "/" && !d_->dir(p) && d_->makeDirs(parentOf(p), 0755, err) &&
+           d_->putNode(p, n, err);
+}
+
+bool MockFileSystem::addFile(const std::string &path, std::string contents) {
+    const std::string p = normalizePath(path);
+    std::lock_guard<std::mutex> lk(d_->m);
+    std::string err;
+    MockNode n;
+    n.size = contents.size();
+    n.data = std::make_shared<const std::string>(std::move(contents));
+    return p != "/" && !d_->dir(p) && d_->makeDirs(parentOf(p), 0755, err) &&
+           d_->putNode(p, n, err);
+}
+
+bool MockFileSystem::addSyntheticFiles(const std::string &dir,
+                                       std::uint64_t count,
+                                       std::uint64_t size,
+                                       const std::string &prefix) {
+    const std::string p = normalizePath(dir);
+    std::lock_guard<std::mutex> lk(d_->m);
+    std::string err;
+    if (!d_->makeDirs(p, 0755, err))
         return false;
+    MockDir &d = *d_->dir(p);
+    d.synth_count = count;
+    d.synth_size = size;
+    d.synth_prefix = prefix;
+    d.synth_width = count > 1 ? std::to_string(count - 1).size() : 1;
+    d.synth_hidden.clear();
+    // Explicit children keep precedence over synthetic namesakes.
+    for (const auto &child : d.children) {
+        std::uint64_t index = 0;
+        if (Impl::synthIndex(d, child.first, index))
+            d.synth_hidden.insert(index);
     }
-    connected_ = true;
-    lastOpt_ = opt;
     return true;
 }
 
-bool MockSftpClient::setTimes(const std::string &remote_path,
-                              std::uint64_t atime, std::uint64_t mtime,
-                              std::string &err) {
-    (void)remote_path;
-    (void)atime;
-    (void)mtime;
-    err.clear();
+std::uint64_t MockFileSystem::addSyntheticTree(const std::string &root,
+                                               int depth, std::uint32_t fanout,
+                                               std::uint64_t files,
+                                               std::uint64_t size) {
+    const std::string p = normalizePath(root);
+    if (!addSyntheticFiles(p, files, size))
+        return 0;
+    std::uint64_t created = files;
+    if (depth <= 0)
+        return created;
+    const std::size_t width =
+        fanout > 1 ? std::to_string(fanout - 1).size() : 1;
+    for (std::uint32_t i = 0; i < fanout; ++i) {
+        std::string digits = std::to_string(i);
+        digits.insert(0, width - digits.size(), '0');
+        const std::string child = joinPath(p, "dir_" + digits);
+        created += 1 + addSyntheticTree(child, depth - 1, fanout, files, size);
+    }
+    return created;
+}
+
+bool MockFileSystem::readFile(const std::string &path,
+                              std::string &out) const {
+    std::lock_guard<std::mutex> lk(d_->m);
+    MockNode n;
+    if (!d_->lookup(normalizePath(path), n) || n.is_dir)
+        return false;
+    out = nodeContents(n);
     return true;
 }
 
-std::unique_ptr<SftpClient>
-MockSftpClient::newConnectionLike(const SessionOptions &opt, std::string &err) {
-    auto p = std::make_unique<MockSftpClient>();
-    if (!p->connect(opt, err))
-        return nullptr;
-    return p;
+MockSftpStats MockFileSystem::stats() const {
+    std::lock_guard<std::mutex> lk(d_->m);
+    return d_->stats;
+}
+
+MockSftpClient::MockSftpClient() : fs_(MockFileSystem::demo()) {}
+
+MockSftpClient::MockSftpClient(std::shared_ptr<MockFileSystem> fs)
+    : fs_(std::move(fs)) {}
+
+bool MockSftpClient::connect(const SessionOptions &opt, std::string &err) {
+    if (opt.host.empty() || opt.username.empty()) {
+        err = "Host and username are required";
+        return false;
+    }
+    const MockSftpProfile p = fs_->profile();
+    if (p.connect_latency.count() > 0)
+        std::this_thread::sleep_for(p.connect_latency);
+    if (fs_->d_->roll(p.failure_rate)) {
+        std::lock_guard<std::mutex> lk(fs_->d_->m);
+        ++fs_->d_->stats.injected_failures;
+        err = "Injected failure";
+        return false;
+    }
+    connected_ = true;
+    lastOpt_ = opt;
+    return true;
 }
 
 void MockSftpClient::disconnect() { connected_ = false; }
 
-bool MockSftpClient::list(const std::string &remote_path,
-                          std::vector<FileInfo> &out, std::string &err) {
+bool MockSftpClient::beginRequest(std::string &err) {
     if (!connected_) {
         err = "Not connected";
         return false;
     }
-    std::string path = remote_path;
-    if (path.empty())
-        path = "/";
+    interrupted_ = false;
+    MockFileSystem::Impl &d = *fs_->d_;
+    MockSftpProfile p;
+    {
+        std::lock_guard<std::mutex> lk(d.m);
+        ++d.stats.requests;
+        p = d.profile;
+    }
+    if (p.rtt.count() > 0)
+        std::this_thread::sleep_for(p.rtt);
+    windowStart_ = Clock::now();
+    windowBytes_ = 0;
+    if (d.roll(p.failure_rate)) {
+        std::lock_guard<std::mutex> lk(d.m);
+        ++d.stats.injected_failures;
+        err = "Injected failure";
+        return false;
+    }
+    return true;
+}
 
-    auto it = fs_.find(path);
-    if (it == fs_.end()) {
-        err = "Mock remote path not found: " + path;
+bool MockSftpClient::transmit(std::size_t bytes, bool upload,
+                              const std::function<bool()> &shouldCancel,
+                              std::string &err) {
+    if (shouldCancel && shouldCancel()) {
+        err = "Canceled by user";
         return false;
     }
-    out = it->second;
-    std::sort(out.begin(), out.end(), [](const FileInfo &a, const FileInfo &b) {
+    if (interrupted_ || !connected_) {
+        err = interrupted_ ? "Interrupted" : "Connection lost";
+        return false;
+    }
+    MockFileSystem::Impl &d = *fs_->d_;
+    MockSftpProfile p;
+    {
+        std::lock_guard<std::mutex> lk(d.m);
+        p = d.profile;
+        (upload ? d.stats.bytes_uploaded : d.stats.bytes_downloaded) += bytes;
+    }
+    d.pace(bytes, p.bandwidth_bytes_per_sec);
+    if (d.roll(p.loss_rate) && p.rtt.count() > 0)
+        std::this_thread::sleep_for(p.rtt);
+    windowBytes_ += bytes;
+    if (p.window_bytes > 0 && windowBytes_ >= p.window_bytes) {
+        std::this_thread::sleep_until(windowStart_ + p.rtt);
+        windowStart_ = Clock::now();
+        windowBytes_ = 0;
+    }
+    if (d.roll(p.drop_rate)) {
+        connected_ = false;
+        std::lock_guard<std::mutex> lk(d.m);
+        ++d.stats.injected_failures;
+        err = "Connection lost";
+        return false;
+    }
+    return true;
+}
+
+bool MockSftpClient::list(const std::string &remote_path,
+                          std::vector<FileInfo> &out, std::string &err) {
+    std::vector<FileInfo> all;
+    const bool ok = listStream(
+        remote_path,
+        [&](std::vector<FileInfo> &&batch) {
+            all.insert(all.end(), std::make_move_iterator(batch.begin()),
+                       std::make_move_iterator(batch.end()));
+            return true;
+        },
+        err);
+    if (!ok)
+        return false;
+    std::sort(all.begin(), all.end(), [](const FileInfo &a, const FileInfo &b) {
         if (a.is_dir != b.is_dir)
             return a.is_dir > b.is_dir; // directories first
         return a.name < b.name;
     });
+    out = std::move(all);
+    return true;
+}
+
+bool MockSftpClient::listStream(const std::string &remote_path,
+                                const ListBatchCB &onBatch, std::string &err) {
+    if (!beginRequest(err))
+        return false;
+    const std::string path = normalizePath(remote_path);
+    MockFileSystem::Impl &d = *fs_->d_;
+    // Resumable cursor: explicit children by name, then synthetic indices.
+    std::string lastName;
+    bool started = false;
+    bool explicitDone = false;
+    std::uint64_t nextSynth = 0;
+    for (;;) {
+        std::vector<FileInfo> batch;
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> lk(d.m);
+            MockDir *dir = d.dir(path);
+            if (!dir) {
+                err = "No such directory: " + path;
+                return false;
+            }
+            if (!explicitDone) {
+                auto it = started ? dir->children.upper_bound(lastName)
+                                  : dir->children.begin();
+                for (; it != dir->children.end() &&
+                       batch.size() < kListBatchSize;
+                     ++it) {
+                    batch.push_back(toInfo(it->first, it->second));
+                    lastName = it->first;
+                }
+                started = true;
+                explicitDone = it == dir->children.end();
+            }
+            if (explicitDone) {
+                const MockNode synth = d.synthNode(*dir);
+                for (; nextSynth < dir->synth_count &&
+                       batch.size() < kListBatchSize;
+                     ++nextSynth) {
+                    if (dir->synth_hidden.count(nextSynth) == 0)
+                        batch.push_back(
+                            toInfo(d.synthName(*dir, nextSynth), synth));
+                }
+                done = nextSynth >= dir->synth_count;
+            }
+        }
+        if (!batch.empty() && !onBatch(std::move(batch))) {
+            err = "Canceled by user";
+            return false;
+        }
+        if (done)
+            return true;
+        // Every further batch is another READDIR round trip.
+        const MockSftpProfile p = fs_->profile();
+        if (p.rtt.count() > 0)
+            std::this_thread::sleep_for(p.rtt);
+        if (interrupted_ || !connected_) {
+            err = interrupted_ ? "Interrupted" : "Connection lost";
+            return false;
+        }
+    }
+}
+
+bool MockSftpClient::download(
+    const std::string &remote, const std::string &local, bool resume,
+    const std::function<void(std::size_t, std::size_t)> &progress,
+    const std::function<bool()> &shouldCancel, std::string &err) {
+    MockFileSystem::Impl &d = *fs_->d_;
+    MockNode n;
+    {
+        std::lock_guard<std::mutex> lk(d.m);
+        if (!d.lookup(normalizePath(remote), n)) {
+            err = "No such file: " + remote;
+            return false;
+        }
+    }
+    if (n.is_dir) {
+        err = "Is a directory: " + remote;
+        return false;
+    }
+    std::uint64_t done = 0;
+    if (resume) {
+        std::error_code ec;
+        const std::uint64_t have = fs::file_size(local, ec);
+        if (!ec && have <= n.size)
+            done = have;
+    }
+    std::ofstream out(local, std::ios::binary |
+                                 (done > 0 ? std::ios::app : std::ios::trunc));
+    if (!out) {
+        err = "Cannot open local file: " + local;
+        return false;
+    }
+    const std::size_t chunk =
+        std::max<std::size_t>(1, fs_->profile().chunk_size);
+    std::vector<char> buf(chunk);
+    while (done < n.size) {
+        const std::size_t len = static_cast<std::size_t>(
+            std::min<std::uint64_t>(chunk, n.size - done));
+        if (!transmit(len, false, shouldCancel, err))
+            return false;
+        readNode(n, done, buf.data(), len);
+        if (!out.write(buf.data(), static_cast<std::streamsize>(len))) {
+            err = "Local write failed: " + local;
+            return false;
+        }
+        done += len;
+        if (progress)
+            progress(static_cast<std::size_t>(done),
+                     static_cast<std::size_t>(n.size));
+    }
+    out.close();
+    if (!out) {
+        err = "Local write failed: " + local;
+        return false;
+    }
+    return true;
+}
+
+bool MockSftpClient::upload(
+    const std::string &local, const std::string &remote, bool resume,
+    const std::function<void(std::size_t, std::size_t)> &progress,
+    const std::function<bool()> &shouldCancel, std::string &err) {
+    MockFileSystem::Impl &d = *fs_->d_;
+    const std::string path = normalizePath(remote);
+    std::error_code ec;
+    const std::uint64_t total = fs::file_size(local, ec);
+    std::ifstream in(local, std::ios::binary);
+    if (ec || !in) {
+        err = "Cannot open local file: " + local;
+        return false;
+    }
+    MockNode n;
+    bool keep = true;
+    {
+        std::lock_guard<std::mutex> lk(d.m);
+        keep = d.keepContents;
+        MockNode existing;
+        if (d.lookup(path, existing)) {
+            if (existing.is_dir) {
+                err = "Is a directory: " + remote;
+                return false;
+            }
+            n = existing;
+            if (!resume || existing.size > total)
+                n.size = 0;
+        } else if (!d.dir(parentOf(path))) {
+            err = "No such directory: " + parentOf(path);
+            return false;
+        }
+    }
+    std::string data;
+    if (keep) {
+        if (n.size > 0)
+            data = nodeContents(n);
+        data.reserve(static_cast<std::size_t>(total));
+    }
+    std::uint64_t done = n.size;
+    in.seekg(static_cast<std::streamoff>(done));
+
+    const std::size_t chunk =
+        std::max<std::size_t>(1, fs_->profile().chunk_size);
+    std::vector<char> buf(chunk);
+    bool ok = true;
+    while (done < total) {
+        const std::size_t len = static_cast<std::size_t>(
+            std::min<std::uint64_t>(chunk, total - done));
+        if (!in.read(buf.data(), static_cast<std::streamsize>(len))) {
+            err = "Local read failed: " + local;
+            ok = false;
+            break;
+        }
+        if (!transmit(len, true, shouldCancel, err)) {
+            ok = false;
+            break;
+        }
+        if (keep)
+            data.append(buf.data(), len);
+        done += len;
+        if (progress)
+            progress(static_cast<std::size_t>(done),
+                     static_cast<std::size_t>(total));
+    }
+
+    // What arrived stays on the "server", like a real interrupted upload.
+    n.size = done;
+    n.mtime = static_cast<std::uint64_t>(std::time(nullptr));
+    n.data = keep ? std::make_shared<const std::string>(std::move(data))
+                  : nullptr;
+    std::lock_guard<std::mutex> lk(d.m);
+    std::string storeErr;
+    if (!d.putNode(path, n, storeErr)) {
+        if (ok)
+            err = storeErr;
+        return false;
+    }
+    return ok;
+}
+
+bool MockSftpClient::get(const std::string &remote, const std::string &local,
+                         std::string &err,
+                         std::function<void(std::size_t, std::size_t)> progress,
+                         std::function<bool()> shouldCancel, bool resume) {
+    return beginRequest(err) &&
+           download(remote, local, resume, progress, shouldCancel, err);
+}
+
+bool MockSftpClient::getRange(
+    const std::string &remote, const std::string &local, std::uint64_t offset,
+    std::uint64_t length, std::string &err,
+    std::function<void(std::size_t, std::size_t)> progress,
+    std::function<bool()> shouldCancel) {
+    if (!beginRequest(err))
+        return false;
+    MockFileSystem::Impl &d = *fs_->d_;
+    MockNode n;
+    {
+        std::lock_guard<std::mutex> lk(d.m);
+        if (!d.lookup(normalizePath(remote), n) || n.is_dir) {
+            err = "No such file: " + remote;
+            return false;
+        }
+    }
+    if (offset > n.size || length > n.size - offset) {
+        err = "Remote file ended before the requested range";
+        return false;
+    }
+    std::fstream out(local, std::ios::in | std::ios::out | std::ios::binary);
+    if (!out) {
+        err = "Cannot open local file: " + local;
+        return false;
+    }
+    out.seekp(static_cast<std::streamoff>(offset));
+    const std::size_t chunk =
+        std::max<std::size_t>(1, fs_->profile().chunk_size);
+    std::vector<char> buf(chunk);
+    std::uint64_t done = 0;
+    while (done < length) {
+        const std::size_t len = static_cast<std::size_t>(
+            std::min<std::uint64_t>(chunk, length - done));
+        if (!transmit(len, false, shouldCancel, err))
+            return false;
+        readNode(n, offset + done, buf.data(), len);
+        if (!out.write(buf.data(), static_cast<std::streamsize>(len))) {
+            err = "Local write failed: " + local;
+            return false;
+        }
+        done += len;
+        if (progress)
+            progress(static_cast<std::size_t>(done),
+                     static_cast<std::size_t>(length));
+    }
+    return true;
+}
+
+bool MockSftpClient::put(const std::string &local, const std::string &remote,
+                         std::string &err,
+                         std::function<void(std::size_t, std::size_t)> progress,
+                         std::function<bool()> shouldCancel, bool resume) {
+    return beginRequest(err) &&
+           upload(local, remote, resume, progress, shouldCancel, err);
+}
+
+bool MockSftpClient::putDelta(
+    const std::string &local, const std::string &remote, std::string &err,
+    std::function<void(std::size_t, std::size_t)> progress,
+    std::function<bool()> shouldCancel) {
+    if (!beginRequest(err))
+        return false;
+    MockFileSystem::Impl &d = *fs_->d_;
+    const std::string path = normalizePath(remote);
+    MockNode base;
+    bool keep = true;
+    {
+        std::lock_guard<std::mutex> lk(d.m);
+        keep = d.keepContents;
+        if (!d.lookup(path, base) || base.is_dir) {
+            err = "Remote file missing: " + remote;
+            return false;
+        }
+    }
+    std::error_code ec;
+    const std::uint64_t total = fs::file_size(local, ec);
+    std::ifstream in(local, std::ios::binary);
+    if (ec || !in) {
+        err = "Cannot open local file: " + local;
+        return false;
+    }
+    std::string data;
+    if (keep)
+        data.reserve(static_cast<std::size_t>(total));
+    // Compare first, then send only the changed blocks, so progress counts
+    // the bytes that cross the wire like the real client.
+    std::vector<char> mine(kDeltaBlock);
+    std::vector<char> theirs(kDeltaBlock);
+    std::vector<bool> changed;
+    std::uint64_t toSend = 0;
+    for (std::uint64_t done = 0; done < total;) {
+        const std::size_t len = static_cast<std::size_t>(
+            std::min<std::uint64_t>(kDeltaBlock, total - done));
+        if (!in.read(mine.data(), static_cast<std::streamsize>(len))) {
+            err = "Local read failed: " + local;
+            return false;
+        }
+        if (shouldCancel && shouldCancel()) {
+            err = "Canceled by user";
+            return false;
+        }
+        const std::size_t have =
+            done < base.size
+                ? static_cast<std::size_t>(
+                      std::min<std::uint64_t>(len, base.size - done))
+                : 0;
+        readNode(base, done, theirs.data(), have);
+        const bool same =
+            have == len && std::memcmp(mine.data(), theirs.data(), len) == 0;
+        changed.push_back(!same);
+        if (!same)
+            toSend += len;
+        if (keep)
+            data.append(mine.data(), len);
+        done += len;
+    }
+    std::uint64_t sent = 0;
+    for (std::size_t i = 0; i < changed.size(); ++i) {
+        if (!changed[i])
+            continue;
+        const std::size_t len = static_cast<std::size_t>(
+            std::min<std::uint64_t>(kDeltaBlock, total - i * kDeltaBlock));
+        if (!transmit(len, true, shouldCancel, err))
+            return false;
+        sent += len;
+        if (progress)
+            progress(static_cast<std::size_t>(sent),
+                     static_cast<std::size_t>(toSend));
+    }
+    base.size = total;
+    base.mtime = static_cast<std::uint64_t>(std::time(nullptr));
+    base.data =
+        keep ? std::make_shared<const std::string>(std::move(data)) : nullptr;
+    std::lock_guard<std::mutex> lk(d.m);
+    return d.putNode(path, base, err);
+}
+
+bool MockSftpClient::putBatch(const std::string &local_root,
+                              const std::vector<std::string> &relative_paths,
+                              const std::string &remote_root, std::string &err,
+                              const BatchFileCB &onFile,
+                              std::function<bool()> shouldCancel) {
+    if (!beginRequest(err))
+        return false;
+    MockFileSystem::Impl &d = *fs_->d_;
+    const std::string root = normalizePath(remote_root);
+    for (const std::string &rel : relative_paths) {
+        const std::string remote = normalizePath(root + "/" + rel);
+        {
+            std::lock_guard<std::mutex> lk(d.m);
+            if (!d.makeDirs(parentOf(remote), 0755, err))
+                return false;
+        }
+        const fs::path local = fs::path(local_root) / fs::path(rel);
+        if (!upload(local.string(), remote, false, {}, shouldCancel, err))
+            return false;
+        if (onFile) {
+            std::error_code ec;
+            onFile(rel, fs::file_size(local, ec));
+        }
+    }
+    return true;
+}
+
+bool MockSftpClient::getBatch(const std::string &remote_root,
+                              const std::vector<std::string> &relative_paths,
+                              const std::string &local_root, std::string &err,
+                              const BatchFileCB &onFile,
+                              std::function<bool()> shouldCancel) {
+    if (!beginRequest(err))
+        return false;
+    const std::string root = normalizePath(remote_root);
+    for (const std::string &rel : relative_paths) {
+        const fs::path local = fs::path(local_root) / fs::path(rel);
+        std::error_code ec;
+        fs::create_directories(local.parent_path(), ec);
+        if (ec) {
+            err = "Cannot create local folder: " + local.parent_path().string();
+            return false;
+        }
+        if (!download(root + "/" + rel, local.string(), false, {},
+                      shouldCancel, err))
+            return false;
+        if (onFile)
+            onFile(rel, fs::file_size(local, ec));
+    }
+    return true;
+}
+
+bool MockSftpClient::readStream(const std::string &remote,
+                                std::uint64_t offset, const ReadSink &sink,
+                                std::string &err,
+                                std::function<bool()> shouldCancel) {
+    if (!beginRequest(err))
+        return false;
+    MockFileSystem::Impl &d = *fs_->d_;
+    MockNode n;
+    {
+        std::lock_guard<std::mutex> lk(d.m);
+        if (!d.lookup(normalizePath(remote), n)) {
+            err = "No such file: " + remote;
+            return false;
+        }
+    }
+    if (n.is_dir) {
+        err = "Is a directory: " + remote;
+        return false;
+    }
+    if (offset > n.size) {
+        err = "Remote file ended before the requested range";
+        return false;
+    }
+    const std::size_t chunk =
+        std::max<std::size_t>(1, fs_->profile().chunk_size);
+    std::vector<char> buf(chunk);
+    std::uint64_t done = offset;
+    while (done < n.size) {
+        const std::size_t len = static_cast<std::size_t>(
+            std::min<std::uint64_t>(chunk, n.size - done));
+        if (!transmit(len, false, shouldCancel, err))
+            return false;
+        readNode(n, done, buf.data(), len);
+        if (!sink(buf.data(), len)) {
+            err = "Canceled by user";
+            return false;
+        }
+        done += len;
+    }
+    return true;
+}
+
+bool MockSftpClient::writeStream(const std::string &remote, bool append,
+                                 const WriteSource &source, std::string &err,
+                                 std::function<bool()> shouldCancel) {
+    if (!beginRequest(err))
+        return false;
+    MockFileSystem::Impl &d = *fs_->d_;
+    const std::string path = normalizePath(remote);
+    MockNode n;
+    bool keep = true;
+    {
+        std::lock_guard<std::mutex> lk(d.m);
+        keep = d.keepContents;
+        MockNode existing;
+        if (d.lookup(path, existing)) {
+            if (existing.is_dir) {
+                err = "Is a directory: " + remote;
+                return false;
+            }
+            n = existing;
+            if (!append)
+                n.size = 0;
+        } else if (!d.dir(parentOf(path))) {
+            err = "No such directory: " + parentOf(path);
+            return false;
+        }
+    }
+    std::string data;
+    if (keep && n.size > 0)
+        data = nodeContents(n);
+    std::uint64_t done = n.size;
+
+    const std::size_t chunk =
+        std::max<std::size_t>(1, fs_->profile().chunk_size);
+    std::vector<char> buf(chunk);
+    bool ok = true;
+    while (true) {
+        const std::ptrdiff_t got = source(buf.data(), buf.size());
+        if (got == 0)
+            break;
+        if (got < 0) {
+            err = "Stream source failed";
+            ok = false;
+            break;
+        }
+        const std::size_t len = static_cast<std::size_t>(got);
+        if (!transmit(len, true, shouldCancel, err)) {
+            ok = false;
+            break;
+        }
+        if (keep)
+            data.append(buf.data(), len);
+        done += len;
+    }
+
+    n.size = done;
+    n.mtime = static_cast<std::uint64_t>(std::time(nullptr));
+    n.data = keep ? std::make_shared<const std::string>(std::move(data))
+                  : nullptr;
+    std::lock_guard<std::mutex> lk(d.m);
+    std::string storeErr;
+    if (!d.putNode(path, n, storeErr)) {
+        if (ok)
+            err = storeErr;
+        return false;
+    }
+    return ok;
+}
+
+bool MockSftpClient::copyRemote(const std::string &from, const std::string &to,
+                                std::string &err, bool overwrite,
+                                std::function<bool()> shouldCancel) {
+    (void)shouldCancel; // server-side and instant
+    if (!beginRequest(err))
+        return false;
+    const std::string src = normalizePath(from);
+    const std::string dst = normalizePath(to);
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode n;
+    if (!d.lookup(src, n)) {
+        err = "No such file or directory: " + from;
+        return false;
+    }
+    if (dst == src || isInside(dst, src)) {
+        err = "Cannot copy a folder into itself";
+        return false;
+    }
+    MockNode existing;
+    if (d.lookup(dst, existing) &&
+        (!overwrite || n.is_dir || existing.is_dir)) {
+        err = "Destination already exists";
+        return false;
+    }
+    if (!n.is_dir)
+        return d.putNode(dst, n, err);
+    if (!d.putNode(dst, n, err))
+        return false;
+    for (const std::string &dirPath : d.subtreeDirs(src)) {
+        MockDir copy = d.dirs[dirPath];
+        d.dirs[dst + dirPath.substr(src.size())] = std::move(copy);
+    }
+    return true;
+}
+
+bool MockSftpClient::ping(std::uint32_t &rtt_ms, std::string &err) {
+    rtt_ms = 0;
+    const auto start = std::chrono::steady_clock::now();
+    if (!beginRequest(err))
+        return false;
+    err.clear();
+    rtt_ms = static_cast<std::uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    return true;
+}
+
+bool MockSftpClient::exists(const std::string &remote_path, bool &isDir,
+                            std::string &err) {
+    isDir = false;
+    if (!beginRequest(err))
+        return false;
+    err.clear();
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode n;
+    if (!d.lookup(normalizePath(remote_path), n))
+        return false;
+    isDir = n.is_dir;
     return true;
 }
 
+bool MockSftpClient::stat(const std::string &remote_path, FileInfo &info,
+                          std::string &err) {
+    if (!beginRequest(err))
+        return false;
+    const std::string path = normalizePath(remote_path);
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode n;
+    if (!d.lookup(path, n)) {
+        err = "No such file or directory: " + remote_path;
+        return false;
+    }
+    info = toInfo(path == "/" ? "/" : baseName(path), n);
+    return true;
+}
+
+bool MockSftpClient::chmod(const std::string &remote_path, std::uint32_t mode,
+                           std::string &err) {
+    if (!beginRequest(err))
+        return false;
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode *n = d.materialize(normalizePath(remote_path));
+    if (!n) {
+        err = "No such file or directory: " + remote_path;
+        return false;
+    }
+    n->mode = (n->mode & kTypeMask) | (mode & 07777);
+    return true;
+}
+
+bool MockSftpClient::chmodTree(const std::string &remote_path,
+                               std::uint32_t mode, std::string &err,
+                               std::function<bool()> shouldCancel) {
+    (void)shouldCancel; // server-side and instant
+    if (!beginRequest(err))
+        return false;
+    const std::string path = normalizePath(remote_path);
+    const std::uint32_t perms = mode & 07777;
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode *top = d.materialize(path);
+    if (!top) {
+        err = "No such file or directory: " + remote_path;
+        return false;
+    }
+    top->mode = (top->mode & kTypeMask) | perms;
+    for (const std::string &dirPath : d.subtreeDirs(path)) {
+        MockDir &dir = d.dirs[dirPath];
+        for (auto &child : dir.children)
+            child.second.mode = (child.second.mode & kTypeMask) | perms;
+        dir.synth_mode = (dir.synth_mode & kTypeMask) | perms;
+    }
+    return true;
+}
+
+bool MockSftpClient::chown(const std::string &remote_path, std::uint32_t uid,
+                           std::uint32_t gid, std::string &err) {
+    if (!beginRequest(err))
+        return false;
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode *n = d.materialize(normalizePath(remote_path));
+    if (!n) {
+        err = "No such file or directory: " + remote_path;
+        return false;
+    }
+    n->uid = uid;
+    n->gid = gid;
+    return true;
+}
+
+bool MockSftpClient::setTimes(const std::string &remote_path,
+                              std::uint64_t atime, std::uint64_t mtime,
+                              std::string &err) {
+    (void)atime; // not tracked
+    if (!beginRequest(err))
+        return false;
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode *n = d.materialize(normalizePath(remote_path));
+    if (!n) {
+        err = "No such file or directory: " + remote_path;
+        return false;
+    }
+    n->mtime = mtime;
+    return true;
+}
+
+bool MockSftpClient::mkdir(const std::string &remote_dir, std::string &err,
+                           unsigned int mode) {
+    if (!beginRequest(err))
+        return false;
+    const std::string path = normalizePath(remote_dir);
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode existing;
+    if (d.lookup(path, existing)) {
+        err = "Already exists: " + remote_dir;
+        return false;
+    }
+    if (!d.dir(parentOf(path))) {
+        err = "No such directory: " + parentOf(path);
+        return false;
+    }
+    return d.makeDirs(path, mode, err);
+}
+
+bool MockSftpClient::removeFile(const std::string &remote_path,
+                                std::string &err) {
+    if (!beginRequest(err))
+        return false;
+    const std::string path = normalizePath(remote_path);
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode n;
+    if (!d.lookup(path, n)) {
+        err = "No such file: " + remote_path;
+        return false;
+    }
+    if (n.is_dir) {
+        err = "Is a directory: " + remote_path;
+        return false;
+    }
+    d.unlink(path);
+    return true;
+}
+
+bool MockSftpClient::removeDir(const std::string &remote_dir,
+                               std::string &err) {
+    if (!beginRequest(err))
+        return false;
+    const std::string path = normalizePath(remote_dir);
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockDir *dir = d.dir(path);
+    if (!dir || path == "/") {
+        err = "No such directory: " + remote_dir;
+        return false;
+    }
+    if (MockFileSystem::Impl::visibleEntries(*dir) > 0) {
+        err = "Directory not empty: " + remote_dir;
+        return false;
+    }
+    d.unlink(path);
+    d.dirs.erase(path);
+    return true;
+}
+
+bool MockSftpClient::rename(const std::string &from, const std::string &to,
+                            std::string &err, bool overwrite) {
+    if (!beginRequest(err))
+        return false;
+    const std::string src = normalizePath(from);
+    const std::string dst = normalizePath(to);
+    MockFileSystem::Impl &d = *fs_->d_;
+    std::lock_guard<std::mutex> lk(d.m);
+    MockNode n;
+    if (src == "/" || !d.lookup(src, n)) {
+        err = "No such file or directory: " + from;
+        return false;
+    }
+    if (dst == src)
+        return true;
+    if (isInside(dst, src)) {
+        err = "Cannot move a folder into itself";
+        return false;
+    }
+    MockNode existing;
+    if (d.lookup(dst, existing)) {
+        if (!overwrite || existing.is_dir || n.is_dir) {
+            err = "Destination already exists";
+            return false;
+        }
+    }
+    if (!d.dir(parentOf(dst))) {
+        err = "No such directory: " + parentOf(dst);
+        return false;
+    }
+    d.unlink(src);
+    if (n.is_dir) {
+        for (const std::string &dirPath : d.subtreeDirs(src)) {
+            auto node = d.dirs.extract(dirPath);
+            node.key() = dst + dirPath.substr(src.size());
+            d.dirs.insert(std::move(node));
+        }
+    }
+    return d.putNode(dst, n, err);
+}
+
+std::unique_ptr<SftpClient>
+MockSftpClient::newConnectionLike(const SessionOptions &opt, std::string &err) {
+    auto p = std::make_unique<MockSftpClient>(fs_);
+    if (!p->connect(opt, err))
+        return nullptr;
+    return p;
+}
+
 } // namespace openscp
@@ -1,20 +1,57 @@
 // Core unit tests without external framework (run via CTest).
+#include "openscp/BandwidthScheduler.hpp"
+#include "openscp/CachingSftpClient.hpp"
+#include "openscp/ChunkDigest.hpp"
 #include "openscp/ClientFactory.hpp"
+#include "openscp/CompactListing.hpp"
+#include "openscp/ConcurrencyController.hpp"
+#include "openscp/KnownHostsCache.hpp"
 #include "openscp/Libssh2SftpClient.hpp"
+#include "openscp/LocalCopy.hpp"
+#include "openscp/ListingPrefetcher.hpp"
+#include "openscp/LocalFileIO.hpp"
 #include "openscp/MockSftpClient.hpp"
+#include "openscp/PathPool.hpp"
+#include "openscp/PrecheckCache.hpp"
+#include "openscp/RemoteAccess.hpp"
+#include "openscp/RemoteChmod.hpp"
+#include "openscp/RemoteDelete.hpp"
+#include "openscp/RemoteFind.hpp"
+#include "openscp/RemoteFileView.hpp"
+#include "openscp/RemoteStream.hpp"
+#include "openscp/RowChangeLog.hpp"
+#include "openscp/SegmentedDownload.hpp"
+#include "openscp/SessionExecutor.hpp"
+#include "openscp/SyncIndex.hpp"
+#include "openscp/TarStream.hpp"
+#include "openscp/Trace.hpp"
+#include "openscp/TransferJournal.hpp"
+#include "openscp/TransferMetrics.hpp"
+#include "openscp/TransferReadyQueue.hpp"
 #if OPENSCP_HAS_CURL_FTP
 #include "openscp/CurlFtpClient.hpp"
 #endif
 
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 namespace {
 
@@ -63,6 +100,193 @@ bool readTextFile(const fs::path &path, std::string &out) {
     return in.good() || in.eof();
 }
 
+// Serves getRange() from an in-memory "remote file".
+class RangeServingClient : public openscp::MockSftpClient {
+    public:
+    explicit RangeServingClient(const std::string &data) : data_(data) {}
+
+    bool getRange(const std::string &remote, const std::string &local,
+                  std::uint64_t offset, std::uint64_t length, std::string &err,
+                  std::function<void(std::size_t, std::size_t)> progress,
+                  std::function<bool()> shouldCancel) override {
+        (void)remote;
+        (void)shouldCancel;
+        ranges.fetch_add(1);
+        if (failures.load() > 0) {
+            failures.fetch_sub(1);
+            err = "range failed";
+            return false;
+        }
+        std::fstream out(local,
+                         std::ios::in | std::ios::out | std::ios::binary);
+        out.seekp(static_cast<std::streamoff>(offset));
+        out.write(data_.data() + offset, static_cast<std::streamsize>(length));
+        if (!out) {
+            err = "local write failed";
+            return false;
+        }
+        if (progress)
+            progress(length, length);
+        return true;
+    }
+
+    std::atomic<int> ranges{0};
+    std::atomic<int> failures{0}; // getRange() calls that fail first
+
+    private:
+    std::string data_;
+};
+
+// In-memory remote tree shared by several "sessions" (path -> is_dir).
+struct MemoryTree {
+    std::mutex m;
+    std::map<std::string, bool> entries;
+    std::string undeletable; // removeFile() of this path fails
+    std::map<std::string, std::uint32_t> modes;
+    std::string unchangeable; // chmod() of this path fails
+    bool serverChmod = false; // chmodTree() is available
+    int chmodCalls = 0;
+    bool serverFind = false; // findEntries() is available
+    int listCalls = 0;
+};
+
+class MemoryTreeClient : public openscp::MockSftpClient {
+    public:
+    explicit MemoryTreeClient(MemoryTree &tree) : tree_(tree) {}
+
+    bool list(const std::string &remote_path,
+              std::vector<openscp::FileInfo> &out, std::string &err) override {
+        std::lock_guard<std::mutex> lk(tree_.m);
+        ++tree_.listCalls;
+        if (tree_.entries.count(remote_path) == 0) {
+            err = "no such directory";
+            return false;
+        }
+        out.clear();
+        const std::string prefix = remote_path + "/";
+        for (const auto &[path, isDir] : tree_.entries) {
+            if (path.compare(0, prefix.size(), prefix) != 0 ||
+                path.find('/', prefix.size()) != std::string::npos)
+                continue;
+            openscp::FileInfo fi;
+            fi.name = path.substr(prefix.size());
+            fi.is_dir = isDir;
+            out.push_back(fi);
+        }
+        return true;
+    }
+    bool listStream(const std::string &remote_path, const ListBatchCB &onBatch,
+                    std::string &err) override {
+        return openscp::SftpClient::listStream(remote_path, onBatch, err);
+    }
+    bool exists(const std::string &remote_path, bool &isDir,
+                std::string &err) override {
+        std::lock_guard<std::mutex> lk(tree_.m);
+        err.clear();
+        const auto it = tree_.entries.find(remote_path);
+        isDir = it != tree_.entries.end() && it->second;
+        return it != tree_.entries.end();
+    }
+    bool stat(const std::string &remote_path, openscp::FileInfo &info,
+              std::string &err) override {
+        std::lock_guard<std::mutex> lk(tree_.m);
+        const auto it = tree_.entries.find(remote_path);
+        if (it == tree_.entries.end()) {
+            err = "no such file";
+            return false;
+        }
+        info = openscp::FileInfo{};
+        info.name = remote_path.substr(remote_path.find_last_of('/') + 1);
+        info.is_dir = it->second;
+        return true;
+    }
+    bool removeFile(const std::string &remote_path, std::string &err) override {
+        std::lock_guard<std::mutex> lk(tree_.m);
+        const auto it = tree_.entries.find(remote_path);
+        if (it == tree_.entries.end() || it->second ||
+            remote_path == tree_.undeletable) {
+            err = "permission denied";
+            return false;
+        }
+        tree_.entries.erase(it);
+        return true;
+    }
+    bool removeDir(const std::string &remote_dir, std::string &err) override {
+        std::lock_guard<std::mutex> lk(tree_.m);
+        const auto it = tree_.entries.find(remote_dir);
+        const auto next = it == tree_.entries.end() ? it : std::next(it);
+        if (it == tree_.entries.end() || !it->second ||
+            (next != tree_.entries.end() &&
+             next->first.compare(0, remote_dir.size() + 1,
+                                 remote_dir + "/") == 0)) {
+            err = "directory not empty";
+            return false;
+        }
+        tree_.entries.erase(it);
+        return true;
+    }
+    bool chmod(const std::string &remote_path, std::uint32_t mode,
+               std::string &err) override {
+        std::lock_guard<std::mutex> lk(tree_.m);
+        ++tree_.chmodCalls;
+        if (tree_.entries.count(remote_path) == 0 ||
+            remote_path == tree_.unchangeable) {
+            err = "permission denied";
+            return false;
+        }
+        tree_.modes[remote_path] = mode;
+        return true;
+    }
+    bool chmodTree(const std::string &remote_path, std::uint32_t mode,
+                   std::string &err, std::function<bool()>) override {
+        std::lock_guard<std::mutex> lk(tree_.m);
+        if (!tree_.serverChmod) {
+            err = "no shell";
+            return false;
+        }
+        for (const auto &[path, isDir] : tree_.entries) {
+            (void)isDir;
+            if (path == remote_path ||
+                path.compare(0, remote_path.size() + 1, remote_path + "/") ==
+                    0)
+                tree_.modes[path] = mode;
+        }
+        return true;
+    }
+    bool findEntries(const std::string &remote_dir,
+                     const openscp::FindOptions &filter,
+                     const FindEntryCB &onEntry, bool &partial,
+                     std::string &err, std::function<bool()>) override {
+        std::vector<std::pair<std::string, bool>> found;
+        {
+            std::lock_guard<std::mutex> lk(tree_.m);
+            partial = false;
+            if (!tree_.serverFind) {
+                err = "no shell";
+                return false;
+            }
+            const std::string prefix = remote_dir + "/";
+            for (const auto &[path, isDir] : tree_.entries) {
+                if (path.compare(0, prefix.size(), prefix) != 0)
+                    continue;
+                const std::string rel = path.substr(prefix.size());
+                if (!filter.include_hidden &&
+                    (rel[0] == '.' || rel.find("/.") != std::string::npos))
+                    continue;
+                found.emplace_back(rel, isDir);
+            }
+        }
+        for (const auto &[rel, isDir] : found) {
+            if (!onEntry(rel, isDir))
+                break;
+        }
+        return true;
+    }
+
+    private:
+    MemoryTree &tree_;
+};
+
 void test_session_defaults(TestContext &t) {
     openscp::SessionOptions o;
     t.check(o.protocol == openscp::Protocol::Sftp,
@@ -79,6 +303,39 @@ void test_session_defaults(TestContext &t) {
     t.check(o.transfer_integrity_policy ==
                 openscp::TransferIntegrityPolicy::Optional,
             "transfer_integrity_policy should default to Optional");
+    t.check(o.sftp_pipeline_depth > 1,
+            "sftp_pipeline_depth should default to a pipelined window");
+    t.check(o.sftp_request_size == 32 * 1024,
+            "sftp_request_size should default to 32 KiB");
+    t.check(o.scp_large_file_threshold > 0 && o.scp_large_file_streams > 1,
+            "large SCP downloads should default to parallel SFTP ranges");
+    t.check(o.local_io_buffer_size == 256 * 1024 && !o.local_io_bypass_cache,
+            "local I/O should default to 256 KiB cached reads/writes");
+    t.check(o.local_io_sparse_files,
+            "downloads should default to sparse-aware writes");
+    t.check(o.ssh_ciphers.empty() && o.ssh_macs.empty() && !o.ssh_compression,
+            "SSH algorithms should default to built-ins, uncompressed");
+    t.check(!o.ssh_multiplex,
+            "SSH multiplexing should be opt-in (one connection per session)");
+    t.check(o.tcp_send_buffer == 0 && o.tcp_recv_buffer == 0 &&
+                o.ssh_window_size == 0 && !o.tcp_nodelay &&
+                !o.network_auto_tune,
+            "socket and SSH window sizes should default to the OS/libssh2");
+    // 1 Gbit/s over 80 ms needs 10 MB in flight; tiny and huge products
+    // are clamped.
+    t.check(openscp::bandwidthDelayBytes(80, 1000) == 10000000 &&
+                openscp::bandwidthDelayBytes(0, 1000) == 256 * 1024 &&
+                openscp::bandwidthDelayBytes(5000, 100000) ==
+                    64 * 1024 * 1024,
+            "bandwidth-delay product should be derived and clamped");
+    openscp::NetworkTuning tuning;
+    tuning.auto_tuned = true;
+    tuning.rtt_ms = 80;
+    tuning.bdp_bytes = 16 * 1024 * 1024;
+    tuning.ssh_window = 16 * 1024 * 1024;
+    t.checkContains(openscp::describeNetworkTuning(tuning),
+                    "SSH window 16 MiB",
+                    "network tuning summary should show the SSH window");
     t.check(!o.password.has_value(), "password should be empty by default");
     t.check(!o.private_key_path.has_value(),
             "private_key_path should be empty by default");
@@ -155,6 +412,10 @@ void test_protocol_helpers(TestContext &t) {
     t.check(sftpCaps.implemented, "SFTP capabilities should be implemented");
     t.check(sftpCaps.supports_listing,
             "SFTP capabilities should include listing");
+    t.check(!sftpCaps.supports_tree_listing,
+            "SFTP capabilities should not advertise bulk tree listing");
+    t.check(sftpCaps.supports_delta_upload,
+            "SFTP capabilities should include delta uploads");
 
     const auto scpCaps =
         openscp::capabilitiesForProtocol(openscp::Protocol::Scp);
@@ -165,6 +426,8 @@ void test_protocol_helpers(TestContext &t) {
             "SCP capabilities should not include listing");
     t.check(!scpCaps.supports_resume,
             "SCP capabilities should not include resume");
+    t.check(!scpCaps.supports_delta_upload,
+            "SCP capabilities should not include delta uploads");
     t.check(!scpCaps.supports_permissions,
             "SCP capabilities should not include chmod/chown metadata edits");
     t.check(scpCaps.supports_known_hosts,
@@ -181,6 +444,8 @@ void test_protocol_helpers(TestContext &t) {
             "WebDAV capabilities should include file transfers");
     t.check(webdavCaps.supports_metadata,
             "WebDAV capabilities should include metadata");
+    t.check(webdavCaps.supports_tree_listing,
+            "WebDAV capabilities should include bulk tree listing");
     t.check(webdavCaps.supports_proxy,
             "WebDAV capabilities should include proxy support");
 #else
@@ -204,11 +469,15 @@ void test_protocol_helpers(TestContext &t) {
             "FTP capabilities should include file transfers");
     t.check(ftpCaps.supports_listing,
             "FTP capabilities should include directory listing support");
+    t.check(ftpCaps.supports_metadata,
+            "FTP capabilities should include stat/exists metadata");
     t.check(ftpsCaps.implemented, "FTPS capabilities should be implemented");
     t.check(ftpsCaps.supports_file_transfers,
             "FTPS capabilities should include file transfers");
     t.check(ftpsCaps.supports_listing,
             "FTPS capabilities should include directory listing support");
+    t.check(ftpsCaps.supports_metadata,
+            "FTPS capabilities should include stat/exists metadata");
 #else
     t.check(!ftpCaps.implemented,
             "FTP capabilities should report not implemented when backend is "
@@ -354,67 +623,191 @@ void test_missing_path_error(TestContext &t) {
     t.check(!err.empty(), "missing path should report non-empty error");
 }
 
-void test_unsupported_methods_report_error(TestContext &t) {
+void test_mock_file_operations(TestContext &t) {
     openscp::MockSftpClient c;
     std::string err;
     bool isDir = true;
     openscp::FileInfo info;
 
-    const bool ex = c.exists("/x", isDir, err);
-    t.check(!ex, "exists should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "exists should expose unsupported message");
-    t.check(!isDir, "exists should reset isDir to false in mock");
-
+    t.check(!c.stat("/readme.txt", info, err) && !err.empty(),
+            "requests should fail before connect");
     err.clear();
-    t.check(!c.stat("/x", info, err), "stat should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "stat should expose unsupported message");
+    t.check(c.connect(validOptions(), err), "mock connect should succeed");
 
+    t.check(!c.exists("/x", isDir, err) && err.empty() && !isDir,
+            "exists of a missing path should fail without an error");
+    t.check(c.stat("/readme.txt", info, err) && info.size == 1280 &&
+                !info.is_dir,
+            "stat should describe the demo file");
+    t.check(c.mkdir("/up", err) && c.exists("/up", isDir, err) && isDir,
+            "mkdir should create a folder");
+    t.check(!c.mkdir("/up", err) && !err.empty(),
+            "mkdir of an existing folder should fail");
     err.clear();
-    t.check(!c.mkdir("/x", err), "mkdir should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "mkdir should expose unsupported message");
+    t.check(!c.mkdir("/no/such/parent", err) && !err.empty(),
+            "mkdir should not create missing parents");
 
+    const fs::path local = makeTempFilePath("mock_put");
+    {
+        std::ofstream out(local, std::ios::binary);
+        out << "mock payload";
+    }
     err.clear();
-    t.check(!c.removeFile("/x", err),
-            "removeFile should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "removeFile should expose unsupported message");
+    std::string back;
+    t.check(c.put(local.string(), "/up/a.txt", err, {}, {}, false) &&
+                c.fileSystem()->readFile("/up/a.txt", back) &&
+                back == "mock payload",
+            "put should store the uploaded bytes");
+    const fs::path fetched = makeTempFilePath("mock_get");
+    t.check(c.get("/up/a.txt", fetched.string(), err, {}, {}, false) &&
+                readTextFile(fetched, back) && back == "mock payload",
+            "get should return what put stored");
 
-    err.clear();
-    t.check(!c.removeDir("/x", err), "removeDir should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "removeDir should expose unsupported message");
+    // A delta re-upload reports only the changed bytes it sends.
+    const fs::path deltaLocal = makeTempFilePath("mock_delta");
+    std::string payload(256 * 1024, 'd');
+    {
+        std::ofstream out(deltaLocal, std::ios::binary);
+        out << payload;
+    }
+    t.check(c.put(deltaLocal.string(), "/up/delta.bin", err, {}, {}, false),
+            "put should store the delta base");
+    payload[100 * 1024] = 'X';
+    {
+        std::ofstream out(deltaLocal, std::ios::binary | std::ios::trunc);
+        out << payload;
+    }
+    std::size_t lastDone = 0;
+    std::size_t lastTotal = 0;
+    t.check(c.putDelta(deltaLocal.string(), "/up/delta.bin", err,
+                       [&](std::size_t done, std::size_t total) {
+                           lastDone = done;
+                           lastTotal = total;
+                       },
+                       {}) &&
+                c.fileSystem()->readFile("/up/delta.bin", back) &&
+                back == payload,
+            "putDelta should patch the remote file");
+    t.check(lastTotal == 64 * 1024 && lastDone == lastTotal,
+            "putDelta progress should count only the changed block");
+    t.check(c.removeFile("/up/delta.bin", err), "delta file should go away");
+    fs::remove(deltaLocal);
 
-    err.clear();
-    t.check(!c.rename("/a", "/b", err, true),
-            "rename should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "rename should expose unsupported message");
+    t.check(c.rename("/up/a.txt", "/up/b.txt", err) &&
+                !c.exists("/up/a.txt", isDir, err) &&
+                c.exists("/up/b.txt", isDir, err),
+            "rename should move the file");
+    t.check(c.rename("/up", "/moved", err) &&
+                c.stat("/moved/b.txt", info, err),
+            "renaming a folder should carry its contents");
+    t.check(c.chmod("/moved/b.txt", 0600, err) &&
+                c.chown("/moved/b.txt", 7, 8, err) &&
+                c.setTimes("/moved/b.txt", 1, 42, err) &&
+                c.stat("/moved/b.txt", info, err) &&
+                (info.mode & 07777) == 0600 && info.uid == 7 &&
+                info.gid == 8 && info.mtime == 42,
+            "chmod, chown and setTimes should update the entry");
+    t.check(!c.removeDir("/moved", err) && !err.empty(),
+            "removeDir should refuse a non-empty folder");
+    t.check(c.removeFile("/moved/b.txt", err) && c.removeDir("/moved", err) &&
+                !c.exists("/moved", isDir, err),
+            "removeFile and removeDir should empty the tree");
 
     err.clear();
-    t.check(!c.chmod("/x", 0644, err), "chmod should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "chmod should expose unsupported message");
+    bool called = false;
+    openscp::SftpClient &base = c;
+    const bool treeListed = base.listTree(
+        "/",
+        [&](const std::string &, const openscp::FileInfo &) {
+            called = true;
+            return true;
+        },
+        err);
+    t.check(!treeListed, "listTree should default to unsupported");
+    t.check(!called && !err.empty(),
+            "default listTree should report an error without entries");
+}
 
-    err.clear();
-    t.check(!c.chown("/x", 1000, 1000, err),
-            "chown should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "chown should expose unsupported message");
+void test_mock_scale_and_faults(TestContext &t) {
+    auto mfs = std::make_shared<openscp::MockFileSystem>();
+    t.check(mfs->addSyntheticFiles("/big", 1000000, 10),
+            "a million-entry folder should be cheap to create");
+    openscp::MockSftpClient c(mfs);
+    std::string err;
+    t.check(c.connect(validOptions(), err), "mock connect should succeed");
 
+    std::size_t batches = 0;
+    std::size_t entries = 0;
+    const bool streamed = c.listStream(
+        "/big",
+        [&](std::vector<openscp::FileInfo> &&batch) {
+            ++batches;
+            entries += batch.size();
+            return true;
+        },
+        err);
+    t.check(streamed && entries == 1000000 &&
+                batches == (1000000 + openscp::SftpClient::kListBatchSize -
+                            1) / openscp::SftpClient::kListBatchSize,
+            "listStream should page a synthetic folder in batches");
+    openscp::FileInfo info;
+    t.check(c.stat("/big/file_123456", info, err) && info.size == 10,
+            "synthetic files should be addressable by name");
+    t.check(c.removeFile("/big/file_000000", err) &&
+                !c.stat("/big/file_000000", info, err),
+            "removing a synthetic file should hide it");
     err.clear();
-    t.check(!c.get("/remote", "/local", err, {}, {}, false),
-            "get should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "get should expose unsupported message");
+    t.check(c.chmodTree("/big", 0700, err, {}) &&
+                c.stat("/big/file_999999", info, err) &&
+                (info.mode & 07777) == 0700,
+            "chmodTree should reach synthetic files");
+
+    t.check(mfs->addSyntheticTree("/tree", 2, 3, 4, 1) == 3 + 9 + 13 * 4,
+            "addSyntheticTree should report the entries it created");
+    t.check(c.copyRemote("/tree", "/tree2", err, false, {}) &&
+                c.stat("/tree2/dir_2/dir_1/file_3", info, err),
+            "copyRemote should copy a whole folder");
+    t.check(!c.copyRemote("/tree", "/tree/dir_0/x", err, false, {}) &&
+                !err.empty(),
+            "copyRemote should refuse to copy a folder into itself");
 
+    openscp::MockSftpProfile profile;
+    profile.rtt = std::chrono::milliseconds(20);
+    mfs->setProfile(profile);
+    std::uint32_t rttMs = 0;
+    t.check(c.ping(rttMs, err) && rttMs >= 20,
+            "ping should measure one request's round trip");
+    profile.rtt = std::chrono::microseconds(0);
+    profile.failure_rate = 1.0;
+    mfs->setProfile(profile);
     err.clear();
-    t.check(!c.put("/local", "/remote", err, {}, {}, false),
-            "put should be unsupported in mock");
-    t.checkContains(err, "Mock no soporta",
-                    "put should expose unsupported message");
+    t.check(!c.stat("/tree", info, err) && err == "Injected failure",
+            "failure_rate should make requests fail");
+    t.check(mfs->stats().injected_failures >= 1,
+            "injected failures should be counted");
+
+    profile.failure_rate = 0.0;
+    profile.drop_rate = 0.5;
+    profile.chunk_size = 1024;
+    profile.seed = 7;
+    mfs->setProfile(profile);
+    mfs->addFile("/blob", std::uint64_t{64 * 1024});
+    const fs::path local = makeTempFilePath("mock_resume");
+    std::error_code ec;
+    fs::remove(local, ec);
+    bool complete = false;
+    int attempts = 0;
+    for (; attempts < 500 && !complete; ++attempts) {
+        err.clear();
+        if (!c.isConnected() && !c.connect(validOptions(), err))
+            continue;
+        complete = c.get("/blob", local.string(), err, {}, {}, true);
+    }
+    std::string want;
+    std::string got;
+    mfs->readFile("/blob", want);
+    t.check(complete && attempts > 1 && readTextFile(local, got) && got == want,
+            "drops should disconnect and resume should finish the download");
 }
 
 void test_new_connection_like(TestContext &t) {
@@ -495,6 +888,7 @@ void test_client_factory(TestContext &t) {
 void test_set_times(TestContext &t) {
     openscp::MockSftpClient c;
     std::string err;
+    c.connect(validOptions(), err);
     const bool ok = c.setTimes("/home/luis/foto.jpg", 10, 20, err);
     t.check(ok, "setTimes should be supported by mock client");
     t.check(err.empty(), "setTimes should not set an error in mock client");
@@ -517,6 +911,76 @@ void test_libssh2_rejects_conflicting_proxy_and_jump(TestContext &t) {
         "connect should explain proxy/jump mutual exclusion");
 }
 
+#ifndef _WIN32
+// Loopback IPv4 listener on an ephemeral port.
+int listenLoopback(std::uint16_t &port) {
+    const int s = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (s < 0 || ::bind(s, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+        ::listen(s, 4) != 0 ||
+        ::getsockname(s, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+        if (s >= 0)
+            ::close(s);
+        return -1;
+    }
+    port = ntohs(addr.sin_port);
+    return s;
+}
+
+void test_libssh2_connect_timings(TestContext &t) {
+    openscp::Libssh2SftpClient c;
+    openscp::ConnectTimings timings;
+    t.check(!c.connectTimings(timings),
+            "connect timings should be absent before any connect");
+
+    std::uint16_t port = 0;
+    int ls = listenLoopback(port);
+    t.check(ls >= 0, "loopback listener should open");
+    if (ls < 0)
+        return;
+    ::close(ls); // nothing listens there any more
+    openscp::SessionOptions opt = validOptions();
+    opt.host = "127.0.0.1";
+    opt.port = port;
+    std::string err;
+    t.check(!c.connect(opt, err) && c.connectTimings(timings) &&
+                timings.tcp_attempts == 1 && timings.peer.empty(),
+            "a refused connect should still report its timings");
+    t.checkContains(err, "Could not connect", "refused connect error");
+
+    // "localhost" may resolve to ::1 first; the server only listens on
+    // 127.0.0.1, so the race has to fall back to it. The server hangs up
+    // at once, so only DNS and TCP complete.
+    ls = listenLoopback(port);
+    if (ls < 0)
+        return;
+    std::thread server([ls] {
+        const int s = ::accept(ls, nullptr, nullptr);
+        if (s >= 0)
+            ::close(s);
+    });
+    opt.host = "localhost";
+    opt.port = port;
+    err.clear();
+    const auto start = std::chrono::steady_clock::now();
+    const bool connected = c.connect(opt, err);
+    server.join();
+    ::close(ls);
+    t.check(!connected && c.connectTimings(timings) &&
+                timings.peer == "127.0.0.1:" + std::to_string(port),
+            "the race should connect to the listening address family: " +
+                timings.peer);
+    t.check(std::chrono::steady_clock::now() - start <
+                std::chrono::seconds(5),
+            "a refused address family should not stall the connect");
+    t.checkContains(openscp::describeConnectTimings(timings), "via 127.0.0.1",
+                    "timing summary should name the peer");
+}
+#endif
+
 #ifdef _WIN32
 void test_libssh2_rejects_jump_on_windows(TestContext &t) {
     openscp::Libssh2SftpClient c;
@@ -532,6 +996,163 @@ void test_libssh2_rejects_jump_on_windows(TestContext &t) {
 }
 #endif
 
+void test_known_hosts_cache(TestContext &t) {
+    const std::string key =
+        "AAAAC3NzaC1lZDI1NTE5AAAAILZlz+tnMZZGpyX4/qwU9iIfMHkUqPnwGwGZRuQQ3v1d";
+    const std::string hashed =
+        "|1|ONUTBfXmPZryon7OlPHra65ZfXs=|lFM22IlwQQfIf9tvjwmXgUKqebE=";
+    const fs::path khPath = makeTempFilePath("openscp-knownhosts-cache");
+    {
+        std::ofstream out(khPath, std::ios::binary | std::ios::trunc);
+        t.check(out.is_open(), "known_hosts cache fixture should be writable");
+        if (!out.is_open())
+            return;
+        out << "# managed file\n";
+        out << "other.example ssh-ed25519 " << key << "\n";
+        out << "alias,example.com ssh-ed25519 " << key << "\r\n";
+        out << hashed << " ssh-ed25519 " << key << "\n";
+        out << "[example.com]:2222 ssh-ed25519 " << key << "\n";
+    }
+
+    openscp::KnownHostsCache cache;
+    std::vector<std::string> lines;
+    std::string err;
+    t.check(cache.linesFor(khPath.string(), "example.com", 22, lines, err),
+            std::string("known_hosts lookup should succeed: ") + err);
+    t.check(lines.size() == 2,
+            "port 22 lookup should return the plain and hashed entries");
+    t.check(lines.size() == 2 &&
+                lines[0] == "alias,example.com ssh-ed25519 " + key &&
+                lines[1].rfind(hashed, 0) == 0,
+            "matching lines should keep file order without CR");
+
+    t.check(cache.linesFor(khPath.string(), "example.com", 2222, lines, err),
+            "port lookup should succeed");
+    t.check(lines.size() == 3,
+            "non-default port should also see plain host entries");
+    t.check(cache.linesFor(khPath.string(), "missing.example", 22, lines,
+                           err) &&
+                lines.empty(),
+            "unknown host should have no lines");
+    t.check(cache.loads() == 1, "unchanged file should be parsed once");
+
+    {
+        std::ofstream out(khPath, std::ios::binary | std::ios::app);
+        out << "example.com ssh-rsa AAAAB3NzaC1yc2EAAAADAQABAAABAQ==\n";
+    }
+    t.check(cache.linesFor(khPath.string(), "example.com", 22, lines, err) &&
+                lines.size() == 3,
+            "grown file should be parsed again");
+    t.check(cache.loads() == 2, "size change should invalidate the cache");
+    cache.invalidate(khPath.string());
+    t.check(cache.linesFor(khPath.string(), "example.com", 22, lines, err) &&
+                cache.loads() == 3,
+            "explicit invalidation should force a re-parse");
+
+    t.check(openscp::knownHostsLineMatches(
+                hashed + " ssh-ed25519 " + key, {"example.com"}),
+            "hashed name should match its host");
+    t.check(!openscp::knownHostsLineMatches("# example.com ssh-ed25519 x",
+                                            {"example.com"}),
+            "comments should never match");
+
+    std::error_code ec;
+    fs::remove(khPath, ec);
+    fs::remove_all(khPath.parent_path(), ec);
+    t.check(!cache.linesFor(khPath.string(), "example.com", 22, lines, err),
+            "missing known_hosts should fail the lookup");
+}
+
+void test_known_hosts_incremental_updates(TestContext &t) {
+    const std::string key =
+        "AAAAC3NzaC1lZDI1NTE5AAAAILZlz+tnMZZGpyX4/qwU9iIfMHkUqPnwGwGZRuQQ3v1d";
+    const fs::path khPath = makeTempFilePath("openscp-knownhosts-append");
+    {
+        // No trailing newline: the append must not glue onto this entry.
+        std::ofstream out(khPath, std::ios::binary | std::ios::trunc);
+        t.check(out.is_open(), "known_hosts append fixture should be writable");
+        if (!out.is_open())
+            return;
+        out << "# managed\nother.example ssh-ed25519 " << key;
+    }
+
+    openscp::KnownHostsCache &cache = openscp::KnownHostsCache::shared();
+    std::vector<std::string> lines;
+    std::string err;
+    t.check(cache.linesFor(khPath.string(), "new.example", 22, lines, err) &&
+                lines.empty(),
+            "new host should start unknown");
+    t.check(openscp::AppendKnownHostLine(
+                khPath.string(), "new.example ssh-ed25519 " + key, err),
+            std::string("append should succeed: ") + err);
+    t.check(openscp::AppendKnownHostLine(
+                khPath.string(), "[new.example]:2222 ssh-ed25519 " + key, err),
+            std::string("second append should succeed: ") + err);
+    t.check(openscp::AppendKnownHostLine(
+                khPath.string(), "new.example ssh-ed25519 " + key, err),
+            "duplicate append should succeed");
+    t.check(!openscp::AppendKnownHostLine(khPath.string(), "a\nb", err),
+            "multi-line entries should be rejected");
+    t.check(cache.linesFor(khPath.string(), "new.example", 22, lines, err) &&
+                lines.size() == 2,
+            "appends should invalidate the shared cache");
+
+    std::string content;
+    t.check(readTextFile(khPath, content), "appended file should be readable");
+    t.check(content == "# managed\nother.example ssh-ed25519 " + key +
+                           "\nnew.example ssh-ed25519 " + key +
+                           "\n[new.example]:2222 ssh-ed25519 " + key +
+                           "\nnew.example ssh-ed25519 " + key + "\n",
+            "appends should only add terminated lines at the end");
+    std::error_code ec;
+    t.check(fs::exists(khPath.string() + ".lock", ec),
+            "writers should lock a sibling lock file");
+
+    std::size_t dropped = 0;
+    t.check(openscp::CompactKnownHosts(khPath.string(), err, &dropped) &&
+                dropped == 1,
+            "compaction should drop the repeated entry");
+    t.check(readTextFile(khPath, content) &&
+                content.find("# managed\n") == 0 &&
+                content.find("new.example ssh-ed25519") ==
+                    content.rfind("new.example ssh-ed25519"),
+            "compaction should keep comments and one copy of each entry");
+
+    std::size_t removed = 0;
+    t.check(openscp::RemoveKnownHostEntries(
+                khPath.string(),
+                {{"new.example", 22, "ssh-rsa"},
+                 {"new.example", 2222, {}},
+                 {"other.example", 22, "ssh-ed25519"}},
+                err, &removed),
+            std::string("batched removal should succeed: ") + err);
+    t.check(removed == 2, "batched removal should count every dropped line");
+    t.check(readTextFile(khPath, content) &&
+                content == "# managed\nnew.example ssh-ed25519 " + key + "\n",
+            "key type filter should keep entries of other types");
+    t.check(!openscp::RemoveKnownHostEntries(khPath.string(), {{"", 22, {}}},
+                                             err),
+            "empty host should be rejected");
+
+    t.check(openscp::ReplaceKnownHostEntries(
+                khPath.string(), {{"new.example", 22, "ssh-ed25519"}},
+                "new.example ssh-ed25519 AAAAnew", err),
+            std::string("replacement should succeed: ") + err);
+    t.check(readTextFile(khPath, content) &&
+                content == "# managed\nnew.example ssh-ed25519 AAAAnew\n",
+            "replacement should swap the old key for the new line");
+
+    const fs::path fresh = khPath.parent_path() / "sub" / "known_hosts";
+    t.check(openscp::AppendKnownHostLine(fresh.string(),
+                                         "new.example ssh-ed25519 " + key, err),
+            std::string("append should create a missing file: ") + err);
+    t.check(readTextFile(fresh, content) &&
+                content == "new.example ssh-ed25519 " + key + "\n",
+            "created known_hosts should hold just the entry");
+
+    fs::remove_all(khPath.parent_path(), ec);
+}
+
 void test_remove_known_hosts_entry_plain_and_hashed(TestContext &t) {
     const std::string key =
         "AAAAC3NzaC1lZDI1NTE5AAAAILZlz+tnMZZGpyX4/qwU9iIfMHkUqPnwGwGZRuQQ3v1d";
@@ -602,6 +1223,1834 @@ void test_remove_known_hosts_entry_non_default_port(TestContext &t) {
     fs::remove_all(khPath.parent_path(), ec);
 }
 
+void test_remote_file_view(TestContext &t) {
+    auto fs = std::make_shared<openscp::MockFileSystem>();
+    openscp::MockSftpProfile profile;
+    profile.chunk_size = 1000;
+    fs->setProfile(profile);
+    std::string log;
+    for (int i = 0; i < 20000; ++i)
+        log += "line " + std::to_string(i) + "\n";
+    fs->addFile("/var/log/app.log", log);
+    openscp::MockSftpClient c(fs);
+    std::string err;
+    t.check(c.connect(validOptions(), err), "mock connect should succeed");
+
+    openscp::RemoteFileView view(c, "/var/log/app.log", 4096, 64 * 1024);
+    t.check(view.refresh(err) && view.size() == log.size(),
+            "file view should take the remote size");
+
+    // A page in the middle fetches only the blocks it touches.
+    std::string page;
+    t.check(view.read(100000, 3000, page, err) &&
+                page == log.substr(100000, 3000),
+            "file view should return the requested range");
+    const std::uint64_t fetched = view.fetchedBytes();
+    t.check(fetched <= 2 * 4096, "file view should fetch only touched blocks");
+    t.check(view.read(100500, 1000, page, err) &&
+                page == log.substr(100500, 1000) &&
+                view.fetchedBytes() == fetched,
+            "file view should serve cached blocks without a request");
+    t.check(view.read(log.size() - 10, 100, page, err) &&
+                page == log.substr(log.size() - 10),
+            "file view should stop at the end of the file");
+
+    // The cache stays within its budget while paging through the file.
+    for (std::uint64_t off = 0; off < log.size(); off += 8192)
+        (void)view.read(off, 8192, page, err);
+    t.check(view.cachedBytes() <= 64 * 1024,
+            "file view should keep the cache within its budget");
+
+    // tail -f: only the appended bytes are read.
+    const std::string more = "appended 1\nappended 2\n";
+    fs->addFile("/var/log/app.log", log + more);
+    const std::uint64_t before = view.fetchedBytes();
+    std::string appended;
+    std::uint64_t at = 0;
+    bool truncated = false;
+    t.check(view.follow(appended, at, truncated, err) && appended == more &&
+                at == log.size() && !truncated,
+            "follow should return the appended bytes");
+    t.check(view.fetchedBytes() - before == more.size(),
+            "follow should fetch only the appended range");
+    t.check(view.read(log.size() - 5, 100, page, err) &&
+                page == (log + more).substr(log.size() - 5),
+            "file view should read across the old end after growth");
+    t.check(view.follow(appended, at, truncated, err) && appended.empty(),
+            "follow should return nothing when the file did not change");
+
+    fs->addFile("/var/log/app.log", std::string("rotated\n"));
+    t.check(view.follow(appended, at, truncated, err) && truncated &&
+                view.size() == 8 && view.read(0, 100, page, err) &&
+                page == "rotated\n",
+            "follow should report a truncated file and start over");
+
+    // Same size, new content: only the mtime tells.
+    t.check(c.setTimes("/var/log/app.log", 1000, 1000, err) &&
+                view.refresh(err),
+            "file view should take the mtime");
+    fs->addFile("/var/log/app.log", std::string("ROTATED\n"));
+    t.check(c.setTimes("/var/log/app.log", 2000, 2000, err) &&
+                view.follow(appended, at, truncated, err) && truncated &&
+                view.read(0, 100, page, err) && page == "ROTATED\n",
+            "follow should start over when the file changed in place");
+    // A longer file with an older mtime was replaced, not appended to.
+    fs->addFile("/var/log/app.log", std::string("older but longer\n"));
+    t.check(c.setTimes("/var/log/app.log", 1500, 1500, err) &&
+                view.follow(appended, at, truncated, err) && truncated &&
+                view.read(0, 100, page, err) && page == "older but longer\n",
+            "follow should start over when the mtime goes backwards");
+}
+
+void test_remote_stream_copy(TestContext &t) {
+    // Two servers; small chunks and a ring smaller than the file make the
+    // reader wait for the writer and the buffer wrap many times.
+    auto srcFs = std::make_shared<openscp::MockFileSystem>();
+    auto dstFs = std::make_shared<openscp::MockFileSystem>();
+    openscp::MockSftpProfile profile;
+    profile.chunk_size = 4096;
+    srcFs->setProfile(profile);
+    dstFs->setProfile(profile);
+    std::string payload(300 * 1024 + 17, '\0');
+    for (std::size_t i = 0; i < payload.size(); ++i)
+        payload[i] = static_cast<char>((i * 131u) % 256u);
+    srcFs->addFile("/data/file.bin", payload);
+    dstFs->addDirectory("/in");
+
+    openscp::MockSftpClient src(srcFs);
+    openscp::MockSftpClient dst(dstFs);
+    std::string err;
+    t.check(src.connect(validOptions(), err) &&
+                dst.connect(validOptions(), err),
+            "both mock sessions should connect");
+
+    std::size_t lastDone = 0;
+    std::size_t lastTotal = 0;
+    const bool ok = openscp::streamRemoteFile(
+        src, "/data/file.bin", dst, "/in/file.bin", err,
+        [&](std::size_t done, std::size_t total) {
+            lastDone = done;
+            lastTotal = total;
+        },
+        {}, false, 10000);
+    std::string copied;
+    openscp::FileInfo info;
+    t.check(ok && dstFs->readFile("/in/file.bin", copied) && copied == payload,
+            "streamed copy should reproduce the source file");
+    t.check(lastDone == payload.size() && lastTotal == payload.size(),
+            "streamed copy should report progress of the source size");
+    t.check(!dst.stat("/in/file.bin.part", info, err),
+            "streamed copy should rename its .part file");
+
+    // A .part left by an earlier attempt is continued, not restarted.
+    const std::size_t half = payload.size() / 2;
+    dstFs->addFile("/in/again.bin.part", payload.substr(0, half));
+    const std::uint64_t readBefore = srcFs->stats().bytes_downloaded;
+    t.check(openscp::streamRemoteFile(src, "/data/file.bin", dst,
+                                      "/in/again.bin", err, {}, {}, true,
+                                      10000) &&
+                dstFs->readFile("/in/again.bin", copied) && copied == payload,
+            "resumed streamed copy should complete the file");
+    t.check(srcFs->stats().bytes_downloaded - readBefore ==
+                payload.size() - half,
+            "resumed streamed copy should read only the missing tail");
+
+    // Canceling midway fails without publishing the destination. The
+    // cancel check also runs on the reader thread, hence the atomic.
+    std::atomic<std::size_t> seen{0};
+    const bool canceled = openscp::streamRemoteFile(
+        src, "/data/file.bin", dst, "/in/canceled.bin", err,
+        [&](std::size_t done, std::size_t) { seen = done; },
+        [&] { return seen.load() >= 64 * 1024; }, false, 10000);
+    t.check(!canceled && err == "Canceled by user" &&
+                !dst.stat("/in/canceled.bin", info, err),
+            "canceled streamed copy should not create the destination");
+
+    err.clear();
+    t.check(!openscp::streamRemoteFile(src, "/data/missing", dst, "/in/x",
+                                       err) &&
+                !err.empty(),
+            "streamed copy of a missing file should fail");
+
+    // The ring itself: a failed producer surfaces after its data drains.
+    openscp::ByteRing ring(8);
+    std::thread producer([&] {
+        ring.write("0123456789abcdef", 16);
+        ring.finish(false);
+    });
+    std::string drained;
+    char buf[5];
+    std::ptrdiff_t n = 0;
+    while ((n = ring.read(buf, sizeof(buf))) > 0)
+        drained.append(buf, static_cast<std::size_t>(n));
+    producer.join();
+    t.check(drained == "0123456789abcdef" && n < 0,
+            "ByteRing should deliver buffered bytes before a failure");
+}
+
+void test_path_pool(TestContext &t) {
+    openscp::PathPool pool;
+    const std::vector<std::string> paths = {
+        "/home/user/docs/a.txt", "/home/user/docs/b.txt", "relative.bin",
+        "/home/user/", "/", "C:/Users/x/file", "", "/home/user/docs/a.txt"};
+    std::vector<openscp::PathPool::Ref> refs;
+    for (const std::string &p : paths)
+        refs.push_back(pool.intern(p));
+    bool exact = true;
+    for (std::size_t i = 0; i < paths.size(); ++i)
+        exact = exact && pool.str(refs[i]) == paths[i];
+    t.check(exact, "interned paths should round-trip exactly");
+    t.check(refs[0].dir == refs[1].dir && refs[0].dir == refs[7].dir &&
+                pool.directory(refs[0]) == "/home/user/docs/" &&
+                pool.leaf(refs[1]) == "b.txt",
+            "siblings should share one directory prefix");
+    t.check(refs[2].dir == 0 && pool.leaf(refs[3]).empty(),
+            "paths without a slash or leaf should be kept as given");
+    t.check(pool.directories() == 4, "each directory should be stored once");
+
+    // Compaction is the owner's call once most leaf bytes are released.
+    openscp::PathPool big;
+    const std::string leaf(1000, 'x');
+    std::vector<openscp::PathPool::Ref> many;
+    for (int i = 0; i < 2000; ++i)
+        many.push_back(big.intern("/data/" + leaf + std::to_string(i)));
+    t.check(big.directories() == 1 && !big.needsCompaction(),
+            "a live pool should not ask for compaction");
+    for (int i = 0; i < 1500; ++i)
+        big.release(many[i]);
+    t.check(big.needsCompaction(),
+            "a pool that is mostly garbage should ask for compaction");
+    openscp::PathPool fresh;
+    bool moved = true;
+    for (int i = 1500; i < 2000; ++i) {
+        const openscp::PathPool::Ref r = fresh.intern(big.str(many[i]));
+        moved = moved && fresh.str(r) == "/data/" + leaf + std::to_string(i);
+    }
+    t.check(moved && fresh.memoryUsage() < big.memoryUsage(),
+            "rebuilding from live paths should shrink the pool");
+}
+
+void test_row_change_log(TestContext &t) {
+    using Kind = openscp::RowChange::Kind;
+    openscp::RowChangeLog log;
+    std::uint64_t version = log.readVersion();
+    std::vector<openscp::RowChange> out;
+
+    // One batch under the lock: three appends fold into one record.
+    for (int row = 0; row < 3; ++row)
+        log.appended(row);
+    t.check(log.readSince(version, out) && out.size() == 1 &&
+                out[0].kind == Kind::Appended && out[0].row == 0 &&
+                out[0].count == 3,
+            "unread adjacent appends should fold into one record");
+
+    // A second batch after the reader caught up must be its own record.
+    out.clear();
+    log.appended(3);
+    log.appended(4);
+    t.check(log.readSince(version, out) && out.size() == 1 &&
+                out[0].row == 3 && out[0].count == 2,
+            "appends after a read should reach the reader");
+
+    out.clear();
+    log.updated(7);
+    t.check(log.readSince(version, out) && out.size() == 1,
+            "an update should reach the reader");
+    out.clear();
+    log.updated(7);
+    log.updated(7);
+    t.check(log.readSince(version, out) && out.size() == 1 &&
+                out[0].kind == Kind::Updated && out[0].id == 7,
+            "a repeated update after a read should reach the reader once");
+
+    out.clear();
+    log.removed(1, 2);
+    t.check(log.readSince(version, out) && out.size() == 1 &&
+                out[0].kind == Kind::Removed && out[0].count == 2,
+            "removals should be logged");
+
+    // A reader older than the retained records must reload.
+    openscp::RowChangeLog small(2);
+    std::uint64_t stale = small.readVersion();
+    small.removed(0, 1);
+    small.removed(0, 1);
+    small.removed(0, 1);
+    out.clear();
+    t.check(!small.readSince(stale, out),
+            "a reader behind the dropped records should be told to reload");
+}
+
+void test_compact_listing(TestContext &t) {
+    openscp::MockSftpClient c;
+    std::string err;
+    std::vector<openscp::FileInfo> out;
+    t.check(c.connect(validOptions(), err) && c.list("/home", out, err),
+            "mock should list /home");
+
+    openscp::CompactListing compact;
+    compact.append(out);
+    t.check(compact.size() == out.size(),
+            "compact listing should keep every entry");
+    bool same = true;
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        const openscp::FileInfo f = compact.at(i);
+        same = same && compact.name(i) == out[i].name &&
+               f.is_dir == out[i].is_dir && f.size == out[i].size &&
+               f.has_size == out[i].has_size && f.mtime == out[i].mtime &&
+               f.mode == out[i].mode;
+    }
+    t.check(same, "compact listing should round-trip entry fields");
+
+    openscp::CompactListing twice = compact;
+    twice.append(compact);
+    t.check(twice.size() == 2 * out.size() &&
+                twice.name(out.size()) == compact.name(0) &&
+                twice.sameEntry(out.size(), compact, 0),
+            "appending a listing should rebase its name offsets");
+    t.check(!out.empty() && !compact.sameEntry(0, twice, 1),
+            "different entries should not compare equal");
+    t.check(!compact.hasSortKeys(), "keys are only kept when supplied");
+
+    openscp::CompactListing keyed;
+    for (const auto &f : out)
+        keyed.push_back(f, "k-" + f.name);
+    openscp::CompactListing keyedTwice = keyed;
+    keyedTwice.append(keyed);
+    t.check(keyedTwice.hasSortKeys() &&
+                keyedTwice.sortKey(out.size()) == "k-" + out[0].name,
+            "sort keys should follow appended entries");
+    keyedTwice.append(compact);
+    t.check(!keyedTwice.hasSortKeys(),
+            "mixing keyed and unkeyed listings should drop the keys");
+}
+
+void test_list_stream(TestContext &t) {
+    openscp::MockSftpClient c;
+    std::string err;
+    t.check(c.connect(validOptions(), err), "mock should connect");
+
+    std::vector<openscp::FileInfo> listed;
+    t.check(c.list("/home", listed, err), "list should succeed");
+    std::vector<openscp::FileInfo> streamed;
+    int batches = 0;
+    const bool ok = c.listStream(
+        "/home",
+        [&](std::vector<openscp::FileInfo> &&batch) {
+            ++batches;
+            streamed.insert(streamed.end(),
+                            std::make_move_iterator(batch.begin()),
+                            std::make_move_iterator(batch.end()));
+            return true;
+        },
+        err);
+    t.check(ok && batches == 1 && streamed.size() == listed.size(),
+            "default listStream should deliver list() as one batch");
+
+    const bool stopped = c.listStream(
+        "/home", [](std::vector<openscp::FileInfo> &&) { return false; }, err);
+    t.check(!stopped && err == "Canceled by user",
+            "listStream should report cancellation when the sink stops");
+
+    auto cache = std::make_shared<openscp::ListingCache>();
+    openscp::CachingSftpClient cached(
+        std::make_unique<openscp::MockSftpClient>(), cache);
+    t.check(cached.connect(validOptions(), err),
+            "caching client should connect through the backend");
+    std::size_t seen = 0;
+    t.check(cached.listStream(
+                "/home",
+                [&](std::vector<openscp::FileInfo> &&batch) {
+                    seen += batch.size();
+                    return true;
+                },
+                err) &&
+                seen == 3,
+            "caching client should stream through the backend");
+    std::vector<openscp::FileInfo> out;
+    t.check(cache->lookup("/home", out) && out.size() == 3,
+            "a completed stream should populate the listing cache");
+}
+
+void test_segmented_download(TestContext &t) {
+    const auto plan = openscp::planTransferSegments(1000, 4, 300);
+    t.check(plan.size() == 3 && plan.front().offset == 0 &&
+                plan.back().offset + plan.back().length == 1000,
+            "segments should tile the file and respect the minimum size");
+
+    std::string data;
+    for (int i = 0; data.size() < 10000; ++i)
+        data += std::to_string(i) + ',';
+    const fs::path local = makeTempFilePath("segmented");
+    RangeServingClient a(data), b(data), c(data);
+
+    openscp::SegmentedDownloadJob job;
+    job.remote = "/big.bin";
+    job.local = local.string();
+    job.size = data.size();
+    job.mtime = 42;
+    job.minSegmentBytes = 1000;
+    std::size_t lastDone = 0;
+    job.progress = [&](std::size_t done, std::size_t) { lastDone = done; };
+    std::string err;
+    const bool ok = openscp::runSegmentedDownload({&a, &b, &c}, job, err);
+    std::string got;
+    t.check(ok && readTextFile(local, got) && got == data,
+            std::string("segmented download should assemble the file: ") +
+                err);
+    t.check(lastDone == data.size(),
+            "segmented progress should reach the file size");
+    t.check(a.ranges + b.ranges + c.ranges > 3,
+            "segments should be shared between the sessions");
+    t.check(!fs::exists(openscp::segmentedStatePath(job.local)) &&
+                !fs::exists(openscp::segmentedPartPath(job.local)),
+            "a finished download should leave no .part or state file");
+
+    // Resume: only segments not yet recorded as done are fetched again.
+    auto segments = openscp::planTransferSegments(data.size(), 4, 1000);
+    segments[0].done = true;
+    segments[2].done = true;
+    const std::string part = openscp::segmentedPartPath(job.local);
+    {
+        std::ofstream out(part, std::ios::binary | std::ios::trunc);
+        std::string stale(data.size(), '?');
+        stale.replace(segments[0].offset, segments[0].length, data, 0,
+                      segments[0].length);
+        stale.replace(segments[2].offset, segments[2].length, data,
+                      segments[2].offset, segments[2].length);
+        out << stale;
+    }
+    t.check(openscp::saveSegmentState(openscp::segmentedStatePath(job.local),
+                                      job.size, job.mtime, segments, err),
+            "segment state should be written");
+    std::vector<openscp::TransferSegment> loaded;
+    t.check(!openscp::loadSegmentState(openscp::segmentedStatePath(job.local),
+                                       job.size, job.mtime + 1, loaded),
+            "state of another remote version should be rejected");
+    RangeServingClient single(data);
+    job.resume = true;
+    std::string resumeErr;
+    t.check(openscp::runSegmentedDownload({&single}, job, resumeErr) &&
+                readTextFile(local, got) && got == data,
+            std::string("resumed segmented download should complete: ") +
+                resumeErr);
+    t.check(single.ranges == 2,
+            "resume should fetch only the pending segments");
+
+    // A failed segment is requeued on another session.
+    RangeServingClient flaky(data), steady(data);
+    flaky.failures = 1;
+    job.resume = false;
+    std::string retryErr;
+    t.check(openscp::runSegmentedDownload({&flaky, &steady}, job,
+                                          retryErr) &&
+                readTextFile(local, got) && got == data,
+            std::string("a failed segment should be retried: ") + retryErr);
+
+    // ...but only once before the download fails.
+    RangeServingClient broken(data), alsoBroken(data);
+    broken.failures = 1000;
+    alsoBroken.failures = 1000;
+    std::string failErr;
+    t.check(!openscp::runSegmentedDownload({&broken, &alsoBroken}, job,
+                                           failErr) &&
+                failErr == "range failed",
+            "a segment failing twice should fail the download");
+    std::error_code ec;
+    fs::remove_all(local.parent_path(), ec);
+}
+
+void test_tar_stream(TestContext &t) {
+    std::string archive;
+    openscp::TarWriter writer([&](const char *data, std::size_t len) {
+        archive.append(data, len);
+        return true;
+    });
+    const std::string longPath =
+        std::string(120, 'd') + "/" + std::string(130, 'f') + ".txt";
+    std::string bigData;
+    for (int i = 0; bigData.size() < 1500; ++i)
+        bigData += std::to_string(i) + ';';
+    const std::vector<std::pair<std::string, std::string>> files = {
+        {"a.txt", "hello"}, {"sub/empty", ""}, {longPath, "long"},
+        {"sub/big.bin", bigData}};
+    std::string err;
+    bool ok = true;
+    openscp::TarEntry dir;
+    dir.path = "sub";
+    dir.is_dir = true;
+    ok = writer.beginEntry(dir, err) && writer.endEntry(err);
+    for (const auto &[path, body] : files) {
+        openscp::TarEntry e;
+        e.path = path;
+        e.size = body.size();
+        e.mode = 0640;
+        e.mtime = 1700000000;
+        ok = ok && writer.beginEntry(e, err) &&
+             writer.writeData(body.data(), body.size(), err) &&
+             writer.endEntry(err);
+    }
+    ok = ok && writer.finish(err);
+    t.check(ok, "tar writer should accept well-formed entries: " + err);
+    t.check(archive.size() % openscp::TarWriter::kBlockSize == 0,
+            "tar archive should be block aligned");
+
+    std::vector<openscp::TarEntry> seen;
+    std::vector<std::string> bodies;
+    openscp::TarReader reader({[&](const openscp::TarEntry &e) {
+                                   seen.push_back(e);
+                                   bodies.emplace_back();
+                                   return true;
+                               },
+                               [&](const char *data, std::size_t len) {
+                                   bodies.back().append(data, len);
+                                   return true;
+                               },
+                               [] { return true; }});
+    // Odd chunk sizes exercise headers and data split across feeds.
+    for (std::size_t off = 0; ok && off < archive.size(); off += 7)
+        ok = reader.feed(archive.data() + off,
+                         std::min<std::size_t>(7, archive.size() - off), err);
+    t.check(ok && reader.finished() && !reader.inEntry(),
+            "tar reader should parse the whole archive: " + err);
+    t.check(seen.size() == files.size() + 1 && seen[0].is_dir &&
+                seen[0].path == "sub",
+            "tar reader should report the directory entry");
+    for (std::size_t i = 0; i < files.size() && i + 1 < seen.size(); ++i) {
+        t.check(seen[i + 1].path == files[i].first &&
+                    bodies[i + 1] == files[i].second &&
+                    seen[i + 1].mode == 0640 &&
+                    seen[i + 1].mtime == 1700000000,
+                "tar reader should round-trip " + files[i].first.substr(0, 20));
+    }
+
+    {
+        std::string bad = archive;
+        bad[10] ^= 0x5a;
+        openscp::TarReader strict({});
+        std::string badErr;
+        t.check(!strict.feed(bad.data(), bad.size(), badErr) &&
+                    !badErr.empty(),
+                "tar reader should reject a corrupt header");
+    }
+    {
+        std::string shortErr;
+        openscp::TarWriter w([](const char *, std::size_t) { return true; });
+        openscp::TarEntry e;
+        e.path = "x";
+        e.size = 4;
+        t.check(w.beginEntry(e, shortErr) && !w.endEntry(shortErr),
+                "tar writer should refuse entries shorter than declared");
+    }
+    t.check(openscp::isSafeArchivePath("a/b.txt") &&
+                !openscp::isSafeArchivePath("../x") &&
+                !openscp::isSafeArchivePath("/etc/passwd") &&
+                !openscp::isSafeArchivePath("a//b") &&
+                !openscp::isSafeArchivePath("a/./b"),
+            "archive paths must stay below their root");
+}
+
+void test_sync_index(TestContext &t) {
+    const fs::path file = makeTempFilePath("sync-index");
+    std::string err;
+    openscp::SyncIndex index;
+    t.check(index.open(file.string(), err) && !index.loaded() &&
+                index.empty(),
+            "a missing sync index should open as empty");
+
+    auto entry = [](const std::string &path, std::uint64_t size,
+                    std::int64_t mtime) {
+        openscp::SyncEntry e;
+        e.path = path;
+        e.size = size;
+        e.mtime = mtime;
+        return e;
+    };
+    std::vector<openscp::SyncEntry> snapshot = {
+        entry("b/two.txt", 20, 200), entry("a.txt", 10, 100),
+        entry("c.bin", 30, 300), entry("a.txt", 11, 101)};
+    snapshot[2].has_hash = true;
+    snapshot[2].hash.fill(0xab);
+    t.check(openscp::SyncIndex::write(file.string(), snapshot, err),
+            std::string("sync index should be written: ") + err);
+    t.check(index.open(file.string(), err) && index.loaded() &&
+                index.size() == 3,
+            std::string("sync index should load (duplicates merged): ") +
+                err);
+    const std::size_t a = index.find("a.txt");
+    t.check(a != openscp::SyncIndex::npos && index.fileSize(a) == 11 &&
+                index.mtime(a) == 101,
+            "the last duplicate entry should win");
+    const std::size_t c = index.find("c.bin");
+    t.check(c != openscp::SyncIndex::npos && index.hasHash(c) &&
+                index.hash(c)[31] == 0xab && !index.hasHash(a),
+            "hashes should round-trip per entry");
+    t.check(index.find("b") == openscp::SyncIndex::npos,
+            "find should match whole paths only");
+
+    std::vector<openscp::SyncEntry> scan = {
+        entry("c.bin", 30, 300), entry("new.txt", 1, 1),
+        entry("a.txt", 11, 999), entry("b/two.txt", 20, 200)};
+    const openscp::SyncDiff diff = openscp::diffSyncIndex(index, scan);
+    std::vector<std::string> changed;
+    for (std::size_t i : diff.changed)
+        changed.push_back(scan[i].path);
+    t.check(changed == std::vector<std::string>{"a.txt", "new.txt"},
+            "diff should report new and modified files");
+    t.check(diff.unchanged.size() == 2 && diff.removed.empty(),
+            "diff should keep matching files unchanged");
+    scan = {entry("a.txt", 11, 101)};
+    const openscp::SyncDiff gone = openscp::diffSyncIndex(index, scan);
+    t.check(gone.removed.size() == 2 && gone.unchanged.size() == 1,
+            "diff should report files missing from the scan");
+
+    index.close();
+    fs::resize_file(file, fs::file_size(file) - 1);
+    err.clear();
+    t.check(!index.open(file.string(), err) && !err.empty(),
+            "a truncated sync index should be rejected");
+
+    std::error_code ec;
+    fs::remove_all(file.parent_path(), ec);
+}
+
+void test_local_file_io(TestContext &t) {
+    const fs::path file = makeTempFilePath("local-io");
+    openscp::SessionOptions so;
+    so.local_io_buffer_size = 1;
+    t.check(openscp::localIoOptionsFrom(so).buffer_size ==
+                openscp::kMinLocalIoBufferSize,
+            "tiny local I/O buffers should be clamped to the minimum");
+
+    openscp::LocalIoOptions opt;
+    opt.bypass_cache = true;
+    std::string err;
+    std::string expected(300 * 1024, '\0');
+    for (std::size_t i = 0; i < expected.size(); ++i)
+        expected[i] = static_cast<char>('a' + i % 26);
+    {
+        openscp::LocalFileWriter w;
+        t.check(w.open(file.string(), openscp::LocalFileWriter::Mode::Truncate,
+                       opt, err),
+                std::string("writer should create the file: ") + err);
+        (void)w.preallocate(expected.size()); // best effort
+        t.check(fs::file_size(file) == 0,
+                "preallocation should not change the visible size");
+        // Tail first, then head: positioned writes in any order.
+        const std::size_t half = expected.size() / 2;
+        t.check(w.writeAt(half, expected.data() + half,
+                          expected.size() - half, err) &&
+                    w.writeAt(0, expected.data(), half, err) && w.sync(err) &&
+                    w.close(err),
+                std::string("positioned writes should succeed: ") + err);
+    }
+    {
+        openscp::LocalFileWriter w;
+        t.check(w.open(file.string(), openscp::LocalFileWriter::Mode::Keep,
+                       opt, err) &&
+                    w.initialSize() == expected.size(),
+                "Keep mode should preserve the existing contents");
+    }
+
+    openscp::LocalFileReader r;
+    t.check(r.open(file.string(), opt, err) && r.size() == expected.size(),
+            std::string("reader should open the written file: ") + err);
+    openscp::LocalIoBuffer scratch(64 * 1024);
+    t.check((reinterpret_cast<std::uintptr_t>(scratch.data()) & 4095) == 0,
+            "local I/O buffers should be page aligned");
+    std::string got;
+    std::uint64_t off = 0;
+    while (true) {
+        const char *data = nullptr;
+        std::size_t n = 0;
+        if (!r.read(off, scratch.size(), scratch.data(), data, n, err) ||
+            n == 0)
+            break;
+        got.append(data, n);
+        off += n;
+    }
+    t.check(got == expected, "reader should return the file contents");
+    r.close();
+
+#ifndef _WIN32
+    // A source truncated mid-upload must read short, not fault on the
+    // now-unbacked pages of the mapping.
+    if (expected.size() > 2 * scratch.size()) {
+        t.check(r.open(file.string(), opt, err), "reader should reopen");
+        const char *data = nullptr;
+        std::size_t n = 0;
+        t.check(r.read(0, scratch.size(), scratch.data(), data, n, err) &&
+                    n == scratch.size(),
+                "first window should read before the truncation");
+        fs::resize_file(file, scratch.size());
+        t.check(r.read(scratch.size(), scratch.size(), scratch.data(), data,
+                       n, err) &&
+                    n == 0 && !r.mapped(),
+                "a truncated source should read as EOF without the mapping");
+        r.close();
+    }
+#endif
+
+    // Zero blocks (including a trailing run) are skipped as holes, but the
+    // file still reads back byte for byte at the full length.
+    std::string sparse(1024 * 1024, '\0');
+    sparse.replace(0, 5, "head!");
+    sparse.replace(512 * 1024 + 7, 4, "mid!");
+    {
+        openscp::LocalFileWriter w;
+        t.check(w.open(file.string(), openscp::LocalFileWriter::Mode::Truncate,
+                       opt, err) &&
+                    w.writeAt(0, sparse.data(), sparse.size(), err) &&
+                    w.close(err),
+                std::string("sparse write should succeed: ") + err);
+    }
+    t.check(fs::file_size(file) == sparse.size(),
+            "a trailing hole should still extend the file");
+    got.clear();
+    t.check(r.open(file.string(), opt, err), "sparse file should open");
+    for (std::uint64_t pos = 0;;) {
+        const char *data = nullptr;
+        std::size_t n = 0;
+        if (!r.read(pos, scratch.size(), scratch.data(), data, n, err) ||
+            n == 0)
+            break;
+        got.append(data, n);
+        pos += n;
+    }
+    t.check(got == sparse, "sparse file should read back unchanged");
+    r.close();
+
+    fs::remove(file);
+    t.check(!r.open(file.string(), opt, err),
+            "opening a missing file should fail");
+
+    std::error_code ec;
+    fs::remove_all(file.parent_path(), ec);
+}
+
+void test_chunk_digest(TestContext &t) {
+    t.check(openscp::integrityChunkSize(1) ==
+                    openscp::kMinIntegrityChunkSize &&
+                openscp::integrityChunkSize(1ull << 50) /
+                        openscp::kMinIntegrityChunkSize >
+                    1,
+            "huge files should get larger integrity chunks");
+
+    // Chunk digests are plain SHA-256, as sha256sum prints them.
+    const fs::path abc = makeTempFilePath("chunk-abc");
+    std::ofstream(abc, std::ios::binary) << "abc";
+    std::vector<openscp::ChunkDigest> one;
+    std::string err;
+    const openscp::ChunkDigest abcSum = {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40,
+        0xde, 0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17,
+        0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad};
+    t.check(openscp::hashLocalChunks(abc.string(), 3, 1024, one, err) &&
+                one.size() == 1 && one[0] == abcSum,
+            "a single chunk should hash to the SHA-256 of its bytes");
+    t.check(openscp::chunkTreeRoot(one) == abcSum,
+            "the tree root of one chunk should be that chunk's digest");
+
+    const fs::path file = makeTempFilePath("chunk-digest");
+    std::string data(1000 * 1000 + 123, '\0');
+    for (std::size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>((i * 131) % 251);
+    std::ofstream(file, std::ios::binary) << data;
+    const std::uint64_t chunk = 64 * 1024;
+    std::vector<openscp::ChunkDigest> serial, parallel;
+    t.check(openscp::hashLocalChunks(file.string(), data.size(), chunk, serial,
+                                     err, 1) &&
+                openscp::hashLocalChunks(file.string(), data.size(), chunk,
+                                         parallel, err, 4),
+            std::string("chunk hashing should succeed: ") + err);
+    t.check(serial.size() == (data.size() + chunk - 1) / chunk &&
+                serial == parallel,
+            "parallel chunk hashing should match the serial result");
+
+    // Streaming the same bytes in odd pieces gives the same chunks.
+    std::vector<openscp::ChunkDigest> streamed;
+    {
+        openscp::ChunkHasher h(chunk, [&](const openscp::ChunkDigest &d) {
+            streamed.push_back(d);
+        });
+        for (std::size_t pos = 0; pos < data.size(); pos += 10007)
+            h.update(data.data() + pos,
+                     std::min<std::size_t>(10007, data.size() - pos));
+        t.check(h.finish() && streamed == serial,
+                "ChunkHasher should emit the same digests as hashLocalChunks");
+    }
+
+    // Damage one chunk: only that chunk and the tree root change.
+    std::string damaged = data;
+    damaged[5 * chunk + 17] ^= 0x5a;
+    std::ofstream(file, std::ios::binary | std::ios::trunc) << damaged;
+    std::vector<openscp::ChunkDigest> after;
+    t.check(openscp::hashLocalChunks(file.string(), damaged.size(), chunk,
+                                     after, err),
+            "hashing the damaged file should succeed");
+    const auto bad = openscp::mismatchedChunks(after, serial);
+    t.check(bad.size() == 1 && bad[0] == 5,
+            "only the damaged chunk should mismatch");
+    t.check(openscp::chunkTreeRoot(after) != openscp::chunkTreeRoot(serial),
+            "a damaged chunk should change the tree root");
+    t.check(!openscp::hashLocalChunks(file.string(), damaged.size() + 1,
+                                      chunk, after, err),
+            "hashing past the end of the file should fail");
+
+    // Sidecar: saved, appended to, and read back; a torn line is dropped.
+    const std::string sidecar = openscp::chunkSidecarPath(file.string());
+    openscp::ChunkDigests saved{chunk, {serial[0], serial[1]}};
+    t.check(openscp::saveChunkDigests(sidecar, saved, err) &&
+                openscp::appendChunkDigest(sidecar, serial[2], err),
+            std::string("sidecar should be written: ") + err);
+    std::ofstream(sidecar, std::ios::binary | std::ios::app) << "ab12";
+    openscp::ChunkDigests loaded;
+    t.check(openscp::loadChunkDigests(sidecar, loaded, err) &&
+                loaded.chunk_size == chunk && loaded.chunks.size() == 3 &&
+                loaded.chunks[2] == serial[2],
+            "sidecar should round-trip the chunk size and digests");
+    std::ofstream(sidecar, std::ios::binary | std::ios::trunc) << "junk\n";
+    t.check(!openscp::loadChunkDigests(sidecar, loaded, err),
+            "a foreign file should not load as chunk digests");
+}
+
+void test_listing_cache(TestContext &t) {
+    using openscp::ListingCache;
+    t.check(ListingCache::normalizePath("//home//luis/") == "/home/luis",
+            "listing cache should normalize duplicate/trailing slashes");
+    t.check(ListingCache::parentPath("/home/luis") == "/home",
+            "parent of '/home/luis' should be '/home'");
+    t.check(ListingCache::parentPath("/home") == "/",
+            "parent of a top-level entry should be '/'");
+
+    auto cache = std::make_shared<ListingCache>();
+    openscp::CachingSftpClient c(std::make_unique<openscp::MockSftpClient>(),
+                                 cache);
+    std::string err;
+    t.check(c.connect(validOptions(), err),
+            "caching client should connect through the backend");
+
+    std::vector<openscp::FileInfo> out;
+    bool fresh = false;
+    t.check(c.list("/home", out, err) && out.size() == 3,
+            "caching client should list through the backend");
+    t.check(cache->lookup("/home/", out, &fresh) && fresh && out.size() == 3,
+            "listing should be cached under its normalized path");
+
+    cache->store("/home/luis", {});
+    cache->store("/home/luis/docs", {});
+    cache->store("/homer", {});
+    cache->invalidateTree("/home/luis");
+    t.check(!cache->lookup("/home/luis", out) &&
+                !cache->lookup("/home/luis/docs", out),
+            "invalidateTree should drop the directory and descendants");
+    t.check(cache->lookup("/homer", out) && cache->lookup("/home", out),
+            "invalidateTree should keep siblings sharing a name prefix");
+
+    cache->invalidateParentOf("/home/notes.md");
+    t.check(!cache->lookup("/home", out),
+            "invalidateParentOf should drop the containing directory");
+
+    cache->setTtl(std::chrono::seconds(0));
+    t.check(c.list("/home", out, err), "list should refill the cache");
+    t.check(cache->lookup("/home", out, &fresh) && !fresh,
+            "entries past the TTL should be reported as stale");
+
+    std::unique_ptr<openscp::SftpClient> clone =
+        c.newConnectionLike(validOptions(), err);
+    auto *cachingClone =
+        dynamic_cast<openscp::CachingSftpClient *>(clone.get());
+    t.check(cachingClone && cachingClone->cache() == cache,
+            "cloned connections should share the session cache");
+
+    std::vector<std::string> touched;
+    c.setMutationHook(
+        [&](const std::string &path) { touched.push_back(path); });
+    t.check(c.mkdir("/home/hooked", err) &&
+                c.rename("/home/hooked", "/home/moved", err) &&
+                cachingClone->mkdir("/home/clone", err),
+            "mutations should succeed through the caching clients");
+    t.check(touched == std::vector<std::string>{"/home/hooked", "/home/hooked",
+                                                "/home/moved"},
+            "the mutation hook should see the client's own changes only");
+}
+
+void test_listing_prefetcher(TestContext &t) {
+    using openscp::ListingPrefetcher;
+    auto cache = std::make_shared<openscp::ListingCache>();
+    int sessions = 0;
+    auto factory = [&sessions](std::string &err) {
+        ++sessions;
+        return openscp::MockSftpClient().newConnectionLike(validOptions(),
+                                                           err);
+    };
+
+    ListingPrefetcher::Budget budget;
+    budget.idle_delay = std::chrono::milliseconds(0);
+    {
+        ListingPrefetcher p(cache, factory, budget);
+        p.prefetch({"/home", "/var/", "/missing", "/home"});
+        p.waitIdle();
+        std::vector<openscp::FileInfo> out;
+        t.check(cache->isFresh("/home") && cache->isFresh("/var"),
+                "prefetch should warm the cache with requested directories");
+        t.check(p.listedCount() == 2,
+                "unreadable and duplicate directories should not be stored");
+        p.prefetch({"/home", "/home/luis"});
+        p.waitIdle();
+        t.check(p.listedCount() == 3 && sessions == 1,
+                "fresh entries are skipped and the session is reused");
+    }
+
+    cache->clear();
+    budget.max_directories = 1;
+    {
+        ListingPrefetcher p(cache, factory, budget);
+        p.prefetch({"/home", "/var"});
+        p.waitIdle();
+        t.check(cache->isFresh("/home") && !cache->isFresh("/var"),
+                "prefetch should stop at the directory budget");
+    }
+
+    cache->clear();
+    budget.max_directories = 24;
+    budget.idle_delay = std::chrono::hours(1);
+    {
+        ListingPrefetcher p(cache, factory, budget);
+        p.prefetch({"/home"});
+        p.cancel();
+        p.waitIdle();
+        t.check(p.listedCount() == 0 && !cache->isFresh("/home"),
+                "a canceled request should not list anything");
+    }
+}
+
+void test_remote_delete(TestContext &t) {
+    MemoryTree tree;
+    auto fill = [&tree] {
+        tree.entries = {{"/keep", true}, {"/keep/a", false}};
+        tree.entries["/build"] = true;
+        for (int d = 0; d < 5; ++d) {
+            const std::string dir = "/build/d" + std::to_string(d);
+            tree.entries[dir] = true;
+            tree.entries[dir + "/sub"] = true;
+            for (int f = 0; f < 300; ++f)
+                tree.entries[dir + "/f" + std::to_string(f)] = false;
+            tree.entries[dir + "/sub/x"] = false;
+        }
+        tree.entries["/loose.txt"] = false;
+    };
+    fill();
+    MemoryTreeClient a(tree), b(tree), c(tree);
+    std::vector<openscp::SftpClient *> clients = {&a, &b, &c};
+
+    openscp::RemoteDeleteJob job;
+    job.roots = {{"/build", true}, {"/loose.txt", false}, {"/gone", false}};
+    std::uint64_t lastFiles = 0;
+    bool monotonic = true;
+    job.progress = [&](const openscp::RemoteDeleteProgress &p) {
+        monotonic = monotonic && p.files_removed >= lastFiles;
+        lastFiles = p.files_removed;
+    };
+    openscp::RemoteDeleteProgress stats;
+    std::string err;
+    t.check(openscp::runRemoteDelete(clients, job, stats, err),
+            "parallel delete should succeed: " + err);
+    t.check(stats.files_removed == 5 * 301 + 2 && stats.dirs_removed == 11,
+            "delete should count every removed file and directory");
+    t.check(tree.entries.size() == 2 && tree.entries.count("/keep/a"),
+            "delete should remove the roots and nothing else");
+    t.check(monotonic && lastFiles == stats.files_removed,
+            "progress should report running totals");
+
+    fill();
+    tree.undeletable = "/build/d3/f7";
+    err.clear();
+    t.check(!openscp::runRemoteDelete(clients, job, stats, err) &&
+                stats.failures == 1,
+            "a file that cannot be removed should fail the delete");
+    t.check(tree.entries.count("/build/d3") && tree.entries.count("/build") &&
+                !tree.entries.count("/build/d2") &&
+                !tree.entries.count("/build/d3/f8"),
+            "a failure should only keep the ancestors of the failed entry");
+
+    fill();
+    job.shouldCancel = [] { return true; };
+    err.clear();
+    t.check(!openscp::runRemoteDelete(clients, job, stats, err) &&
+                err == "Canceled by user" && tree.entries.count("/build"),
+            "a canceled delete should stop and report it");
+}
+
+void test_remote_chmod(TestContext &t) {
+    MemoryTree tree;
+    tree.entries = {{"/www", true}, {"/www/index.html", false},
+                    {"/other", false}};
+    for (int d = 0; d < 4; ++d) {
+        const std::string dir = "/www/d" + std::to_string(d);
+        tree.entries[dir] = true;
+        for (int f = 0; f < 200; ++f)
+            tree.entries[dir + "/f" + std::to_string(f)] = false;
+    }
+    MemoryTreeClient a(tree), b(tree);
+    std::vector<openscp::SftpClient *> clients = {&a, &b};
+
+    openscp::RemoteChmodJob job;
+    job.roots = {{"/www", true}, {"/other", false}};
+    job.mode = 0750;
+    openscp::RemoteChmodProgress stats;
+    std::string err;
+    t.check(openscp::runRemoteChmod(clients, job, stats, err),
+            "walked chmod should succeed: " + err);
+    t.check(stats.changed == tree.entries.size() && stats.dirs_listed == 5 &&
+                stats.server_side == 0,
+            "walked chmod should change every entry once");
+    bool allSet = tree.modes.size() == tree.entries.size();
+    for (const auto &[path, mode] : tree.modes)
+        allSet = allSet && mode == 0750;
+    t.check(allSet, "walked chmod should apply the mode everywhere");
+
+    tree.modes.clear();
+    tree.chmodCalls = 0;
+    tree.serverChmod = true;
+    err.clear();
+    t.check(openscp::runRemoteChmod(clients, job, stats, err) &&
+                stats.server_side == 1 && stats.changed == 1 &&
+                tree.chmodCalls == 1 &&
+                tree.modes.size() == tree.entries.size(),
+            "a server-side chmod should replace the per-entry walk");
+
+    tree.serverChmod = false;
+    tree.unchangeable = "/www/d2/f9";
+    err.clear();
+    t.check(!openscp::runRemoteChmod(clients, job, stats, err) &&
+                stats.failures == 1 &&
+                stats.changed == tree.entries.size() - 1,
+            "one failing entry should not stop the rest of the walk");
+
+    std::string copyErr;
+    openscp::SftpClient &base = a;
+    t.check(!base.copyRemote("/other", "/copy", copyErr) && !copyErr.empty(),
+            "copyRemote of a missing path should fail");
+}
+
+void test_remote_find(TestContext &t) {
+    MemoryTree tree;
+    tree.entries = {{"/src", true},          {"/src/.git", true},
+                    {"/src/.git/main.c", false}, {"/src/link", false}};
+    for (int d = 0; d < 6; ++d) {
+        const std::string dir = "/src/d" + std::to_string(d);
+        tree.entries[dir] = true;
+        tree.entries[dir + "/main.c"] = false;
+        for (int f = 0; f < 100; ++f)
+            tree.entries[dir + "/f" + std::to_string(f) + ".o"] = false;
+    }
+    MemoryTreeClient a(tree), b(tree);
+    std::vector<openscp::SftpClient *> clients = {&a};
+
+    openscp::RemoteFindJob job;
+    job.root = "/src";
+    job.match = [](const std::string &name) { return name == "main.c"; };
+    int sessionRequests = 0;
+    job.walk_sessions = [&](std::vector<openscp::SftpClient *> &more) {
+        ++sessionRequests;
+        more.push_back(&b);
+    };
+    std::mutex seenMutex;
+    std::set<std::string> seen;
+    job.on_matches = [&](std::vector<openscp::RemoteFindMatch> &&batch) {
+        std::lock_guard<std::mutex> lk(seenMutex);
+        for (const openscp::RemoteFindMatch &m : batch)
+            seen.insert(m.relative);
+    };
+    openscp::RemoteFindProgress stats;
+    std::string err;
+    t.check(openscp::runRemoteFind(clients, job, stats, err),
+            "walked search should succeed: " + err);
+    t.check(!stats.server_side && sessionRequests == 1 &&
+                stats.dirs_listed == 7 && stats.matches == 6 &&
+                seen.size() == 6 && seen.count("d4/main.c") &&
+                !seen.count(".git/main.c"),
+            "the walk should list each visible folder once and find every "
+            "match");
+
+    tree.serverFind = true;
+    seen.clear();
+    sessionRequests = 0;
+    err.clear();
+    t.check(openscp::runRemoteFind(clients, job, stats, err) &&
+                stats.server_side && sessionRequests == 0 &&
+                stats.dirs_listed == 0 && seen.size() == 6,
+            "a server-side search should replace the walk");
+
+    job.filter.include_hidden = true;
+    job.max_matches = 3;
+    seen.clear();
+    err.clear();
+    t.check(openscp::runRemoteFind(clients, job, stats, err) &&
+                stats.truncated && stats.matches == 3 && seen.size() == 3,
+            "the search should stop at max_matches");
+
+    tree.serverFind = false;
+    job.root = "/missing";
+    err.clear();
+    t.check(!openscp::runRemoteFind(clients, job, stats, err) &&
+                !err.empty() && stats.failures == 1,
+            "a root that cannot be listed should fail the search");
+}
+
+void test_precheck_cache(TestContext &t) {
+    MemoryTree tree;
+    tree.entries = {{"/up", true}, {"/up/a.txt", false}};
+    MemoryTreeClient a(tree), b(tree);
+    openscp::PrecheckCache cache;
+
+    // Many workers checking siblings share one listing of their folder.
+    std::vector<std::thread> workers;
+    std::atomic<int> found{0};
+    for (int w = 0; w < 8; ++w) {
+        workers.emplace_back([&, w] {
+            openscp::SftpClient &client =
+                (w % 2) ? static_cast<openscp::SftpClient &>(a) : b;
+            for (int i = 0; i < 50; ++i) {
+                bool exists = false;
+                openscp::FileInfo info;
+                std::string err;
+                const std::string name =
+                    i == 0 ? "a.txt" : "f" + std::to_string(i);
+                if (cache.lookup(client, "/up/" + name, exists, info, err) &&
+                    exists)
+                    ++found;
+            }
+        });
+    }
+    for (std::thread &th : workers)
+        th.join();
+    t.check(tree.listCalls == 1 && cache.listings() == 1 && found == 8,
+            "sibling lookups should be answered from a single listing");
+
+    bool exists = false;
+    openscp::FileInfo info;
+    std::string err;
+    cache.noteFile("/up/f1", 42, 7);
+    t.check(cache.lookup(a, "/up/f1", exists, info, err) && exists &&
+                info.size == 42 && tree.listCalls == 1,
+            "a file written by a worker should be known without listing");
+
+    t.check(cache.lookup(a, "/up/new/x", exists, info, err) && !exists &&
+                !cache.knownDirectory("/up/new"),
+            "a path below a missing folder should be missing");
+    cache.noteDirectory("/up/new");
+    const int listsBefore = tree.listCalls;
+    t.check(cache.knownDirectory("/up/new") &&
+                cache.lookup(a, "/up/new", exists, info, err) && exists &&
+                info.is_dir &&
+                cache.lookup(a, "/up/new/x", exists, info, err) && !exists &&
+                tree.listCalls == listsBefore,
+            "a created folder should be known and empty");
+
+    cache.invalidate("/up/new");
+    t.check(!cache.knownDirectory("/up/new") &&
+                cache.lookup(a, "/up/a.txt", exists, info, err) && exists &&
+                tree.listCalls == listsBefore + 1,
+            "invalidate should drop the path's folder and its parent");
+
+    openscp::PrecheckCache expiring(std::chrono::seconds(0));
+    expiring.lookup(a, "/up/a.txt", exists, info, err);
+    expiring.lookup(a, "/up/a.txt", exists, info, err);
+    t.check(expiring.listings() == 2, "expired listings should be refetched");
+
+    // A folder over the entry cap is not held; its paths go to the server.
+    tree.entries["/big"] = true;
+    for (int i = 0; i < 5; ++i)
+        tree.entries["/big/f" + std::to_string(i)] = false;
+    openscp::PrecheckCache capped(
+        openscp::PrecheckCache::kDefaultTtl,
+        openscp::PrecheckCache::kDefaultMaxDirectories, 3);
+    const int bigLists = tree.listCalls;
+    t.check(capped.lookup(a, "/big/f4", exists, info, err) && exists &&
+                info.name == "f4" &&
+                capped.lookup(a, "/big/nope", exists, info, err) && !exists &&
+                tree.listCalls == bigLists + 1,
+            "an oversized folder should be listed once and then answered "
+            "per path");
+}
+
+void test_remote_access(TestContext &t) {
+    using openscp::AccessVerdict;
+    using openscp::directoryWriteAccess;
+    openscp::FileInfo dir;
+    dir.is_dir = true;
+    dir.uid = 1000;
+    dir.gid = 1000;
+
+    dir.mode = 040755;
+    t.check(directoryWriteAccess(dir, 1000u) == AccessVerdict::Unknown &&
+                directoryWriteAccess(dir, 0u) == AccessVerdict::Unknown,
+            "mode bits alone should never prove a folder writable");
+    t.check(directoryWriteAccess(dir, 1001u) == AccessVerdict::ReadOnly,
+            "others should not be able to write a 0755 folder");
+    t.check(directoryWriteAccess(dir, std::nullopt) == AccessVerdict::Unknown,
+            "without the session uid a 0755 folder is undecided");
+
+    dir.mode = 040575;
+    t.check(directoryWriteAccess(dir, 1000u) == AccessVerdict::ReadOnly,
+            "owner bits should apply to the owner even if others may write");
+    dir.mode = 040775;
+    t.check(directoryWriteAccess(dir, 1001u) == AccessVerdict::Unknown,
+            "group bits depend on memberships the client cannot see");
+    dir.mode = 041777;
+    t.check(directoryWriteAccess(dir, 1001u) == AccessVerdict::Unknown,
+            "a world-writable folder still needs a probe");
+    dir.mode = 040555;
+    t.check(directoryWriteAccess(dir, 0u) == AccessVerdict::Unknown,
+            "root may write regardless of the mode bits");
+    dir.mode = 0;
+    t.check(directoryWriteAccess(dir, 1000u) == AccessVerdict::Unknown,
+            "a folder without reported mode should be undecided");
+}
+
+void test_session_executor(TestContext &t) {
+    using openscp::AsyncResult;
+    using openscp::AsyncStatus;
+    using openscp::SessionExecutor;
+    using openscp::SftpClient;
+    auto fs = openscp::MockFileSystem::demo();
+    std::atomic<int> sessions{0};
+    std::atomic<bool> failOpen{false};
+    auto factory = [fs, &sessions, &failOpen](
+                       std::string &err) -> std::unique_ptr<SftpClient> {
+        if (failOpen.load()) {
+            err = "Server unreachable";
+            return nullptr;
+        }
+        auto c = std::make_unique<openscp::MockSftpClient>(fs);
+        if (!c->connect(validOptions(), err))
+            return nullptr;
+        ++sessions;
+        return c;
+    };
+
+    {
+        SessionExecutor ex(factory);
+        std::future<AsyncStatus> made = ex.mkdir("/async");
+        std::future<AsyncResult<openscp::FileInfo>> st = ex.stat("/async");
+        std::future<AsyncStatus> moved = ex.rename("/async", "/async2");
+        std::future<AsyncResult<std::vector<openscp::FileInfo>>> listed =
+            ex.list("/async2");
+        std::future<AsyncResult<openscp::FileInfo>> gone = ex.stat("/async");
+        const AsyncResult<openscp::FileInfo> info = st.get();
+        t.check(made.get().ok && info.ok && info.value.is_dir,
+                "queued operations should run in submission order");
+        t.check(moved.get().ok && listed.get().ok,
+                "later operations should see earlier results");
+        const AsyncResult<openscp::FileInfo> missing = gone.get();
+        t.check(!missing.ok && !missing.error.empty(),
+                "a failed call should carry its error");
+        t.check(sessions.load() == 1, "operations should share one session");
+
+        // Many callers, one I/O thread: each caller's order is kept.
+        std::mutex m;
+        std::vector<std::pair<int, int>> order;
+        std::set<std::thread::id> ioThreads;
+        std::vector<std::thread> callers;
+        std::vector<std::future<AsyncResult<bool>>> results[4];
+        for (int c = 0; c < 4; ++c) {
+            callers.emplace_back([&, c] {
+                for (int i = 0; i < 25; ++i) {
+                    results[c].push_back(ex.submit<bool>(
+                        [&, c, i](SftpClient &client, bool &isDir,
+                                  std::string &err) {
+                            std::lock_guard<std::mutex> lk(m);
+                            order.emplace_back(c, i);
+                            ioThreads.insert(std::this_thread::get_id());
+                            return client.exists("/home", isDir, err);
+                        }));
+                }
+            });
+        }
+        for (std::thread &c : callers)
+            c.join();
+        bool allOk = true;
+        for (auto &perCaller : results)
+            for (auto &f : perCaller) {
+                const AsyncResult<bool> r = f.get();
+                allOk = allOk && r.ok && r.value;
+            }
+        int last[4] = {-1, -1, -1, -1};
+        bool ordered = order.size() == 100;
+        for (const auto &[c, i] : order) {
+            ordered = ordered && i == last[c] + 1;
+            last[c] = i;
+        }
+        t.check(allOk && ordered && ioThreads.size() == 1 &&
+                    !ioThreads.count(std::this_thread::get_id()),
+                "concurrent submissions should run in order on one thread");
+
+        // A session left disconnected is reopened for the next operation.
+        std::future<AsyncResult<bool>> dropped = ex.submit<bool>(
+            [](SftpClient &client, bool &, std::string &err) {
+                client.disconnect();
+                err = "Connection lost";
+                return false;
+            });
+        t.check(!dropped.get().ok && ex.stat("/home").get().ok &&
+                    sessions.load() == 2,
+                "a dropped session should be replaced");
+
+        // A session that cannot be opened fails only the waiting operation.
+        std::future<AsyncResult<bool>> dropAgain = ex.submit<bool>(
+            [](SftpClient &client, bool &, std::string &) {
+                client.disconnect();
+                return false;
+            });
+        dropAgain.get();
+        failOpen = true;
+        const AsyncResult<openscp::FileInfo> unreachable =
+            ex.stat("/home").get();
+        failOpen = false;
+        t.check(!unreachable.ok && unreachable.error == "Server unreachable",
+                "a failed open should fail the operation with its error");
+        t.check(ex.stat("/home").get().ok && sessions.load() == 3,
+                "the next operation should open a session again");
+
+        // Completions run on the I/O thread; pending work can be canceled.
+        std::promise<void> release;
+        std::shared_future<void> gate = release.get_future().share();
+        std::promise<void> started;
+        std::future<void> running = started.get_future();
+        std::future<AsyncResult<bool>> blocker = ex.submit<bool>(
+            [gate, &started](SftpClient &, bool &, std::string &) {
+                started.set_value();
+                gate.wait();
+                return true;
+            });
+        std::promise<AsyncStatus> callbackResult;
+        ex.submit<bool>(
+            [](SftpClient &, bool &, std::string &) { return true; },
+            [&callbackResult](AsyncResult<bool> r) {
+                callbackResult.set_value(r);
+            });
+        running.wait();
+        t.check(ex.pending() == 2, "pending() should count running work");
+        ex.cancelPending();
+        release.set_value();
+        const AsyncStatus canceled = callbackResult.get_future().get();
+        t.check(blocker.get().ok && !canceled.ok &&
+                    canceled.error == "Canceled",
+                "cancelPending should fail queued operations only");
+    }
+
+    // Destroying the executor fails what is still queued.
+    {
+        std::promise<void> release;
+        std::shared_future<void> gate = release.get_future().share();
+        std::future<AsyncResult<bool>> blocker;
+        std::future<AsyncStatus> queued;
+        {
+            SessionExecutor ex(factory);
+            blocker = ex.submit<bool>(
+                [gate](SftpClient &, bool &, std::string &) {
+                    gate.wait();
+                    return true;
+                });
+            queued = ex.mkdir("/never");
+        }
+        release.set_value();
+        const AsyncStatus closed = queued.get();
+        blocker.get();
+        t.check(!closed.ok && closed.error == "Session closed",
+                "queued operations should fail once the executor is gone");
+        bool isDir = false;
+        std::string err;
+        openscp::MockSftpClient probe(fs);
+        probe.connect(validOptions(), err);
+        t.check(!probe.exists("/never", isDir, err),
+                "operations queued at destruction should not run");
+    }
+}
+
+void test_transfer_metrics(TestContext &t) {
+    using openscp::LatencyHistogram;
+    LatencyHistogram h;
+    for (std::uint64_t v = 1; v <= 10000; ++v)
+        h.record(v);
+    t.check(h.count() == 10000 && h.min() == 1 && h.max() == 10000,
+            "histogram should track count, min and max");
+    const std::uint64_t p50 = h.valueAtQuantile(0.5);
+    const std::uint64_t p99 = h.valueAtQuantile(0.99);
+    t.check(p50 >= 5000 && p50 <= 5000 + 5000 / 16 + 1,
+            "p50 should be within one sub-bucket of the true median");
+    t.check(p99 >= 9900 && p99 <= 10000, "p99 should be clamped to max");
+    bool bounded = true;
+    for (std::uint64_t v : {std::uint64_t{0}, std::uint64_t{31},
+                            std::uint64_t{32}, std::uint64_t{1} << 40,
+                            UINT64_MAX}) {
+        const std::size_t i = LatencyHistogram::bucketIndex(v);
+        bounded = bounded && i < LatencyHistogram::kBucketCount &&
+                  LatencyHistogram::bucketUpperBound(i) >= v &&
+                  (i == 0 || LatencyHistogram::bucketUpperBound(i - 1) < v);
+    }
+    t.check(bounded, "every value should land in the bucket covering it");
+
+    openscp::TransferMetrics m;
+    m.setInstance("ws-1");
+    m.recordPhase("sftp", openscp::TransferPhase::Transfer,
+                  std::chrono::milliseconds(250));
+    m.recordPhase("sftp", openscp::TransferPhase::Transfer,
+                  std::chrono::microseconds(10));
+    m.addBytes("sftp", openscp::TransferDirection::Upload, 4096);
+    m.recordError("sftp", openscp::classifyTransferError(
+                              "Checksum mismatch after upload"));
+    m.recordTask("sftp", false);
+    t.check(m.phase("sftp", openscp::TransferPhase::Transfer).count() == 2 &&
+                m.bytes("sftp", openscp::TransferDirection::Upload) == 4096 &&
+                m.errors("sftp", openscp::TransferErrorClass::Integrity) == 1,
+            "metrics should aggregate per backend");
+
+    const std::string prom = m.exportPrometheus();
+    t.checkContains(prom,
+                    "openscp_transfer_phase_seconds_bucket{backend=\"sftp\","
+                    "phase=\"transfer\",instance=\"ws-1\",le=\"+Inf\"} 2",
+                    "Prometheus export should close each histogram with +Inf");
+    t.checkContains(prom,
+                    "phase=\"transfer\",instance=\"ws-1\",le=\"1.6e-05\"} 1",
+                    "Prometheus buckets should be cumulative in seconds");
+    t.checkContains(prom,
+                    "openscp_transfer_errors_total{backend=\"sftp\","
+                    "class=\"integrity\",instance=\"ws-1\"} 1",
+                    "Prometheus export should count errors by class");
+    openscp::TransferMetrics edge;
+    edge.recordPhase("sftp", openscp::TransferPhase::Open,
+                     std::chrono::microseconds(64));
+    const std::string edgeProm = edge.exportPrometheus();
+    t.checkContains(edgeProm, "phase=\"open\",le=\"6.4e-05\"} 1",
+                    "a sample equal to a bound should count in its bucket");
+    t.checkContains(edgeProm, "phase=\"open\",le=\"1.6e-05\"} 0",
+                    "a sample above a bound should not count in its bucket");
+    const std::string json = m.exportJsonLines(1234);
+    t.checkContains(json,
+                    "{\"ts\":1234,\"instance\":\"ws-1\",\"backend\":"
+                    "\"sftp\",\"metric\":\"phase_us\"",
+                    "JSON lines should stamp every series");
+    t.checkContains(json, "\"upload\":4096", "JSON lines should carry bytes");
+
+    const fs::path file = makeTempFilePath("metrics");
+    std::string err;
+    std::string written;
+    t.check(m.exportTo(file.string(), openscp::MetricsFormat::Prometheus, 0,
+                       err) &&
+                readTextFile(file, written) && written == prom,
+            "exportTo should replace the Prometheus file");
+    std::error_code ec;
+    const fs::path lines = makeTempFilePath("metrics-jsonl");
+    t.check(m.exportTo(lines.string(), openscp::MetricsFormat::JsonLines, 1,
+                       err) &&
+                m.exportTo(lines.string(), openscp::MetricsFormat::JsonLines,
+                           2, err) &&
+                readTextFile(lines, written) &&
+                written.rfind("{\"ts\":1", 0) == 0 &&
+                written.find("{\"ts\":2") != std::string::npos,
+            "exportTo should append JSON lines");
+    fs::resize_file(lines, openscp::TransferMetrics::kJsonLinesMaxBytes, ec);
+    t.check(m.exportTo(lines.string(), openscp::MetricsFormat::JsonLines, 3,
+                       err) &&
+                fs::file_size(lines.string() + ".1", ec) ==
+                    openscp::TransferMetrics::kJsonLinesMaxBytes &&
+                readTextFile(lines, written) &&
+                written.rfind("{\"ts\":3", 0) == 0,
+            "exportTo should rotate a full JSON lines file");
+    fs::remove(lines, ec);
+    fs::remove(lines.string() + ".1", ec);
+    t.check(!m.exportTo("unix:" + (file.parent_path() / "none.sock").string(),
+                        openscp::MetricsFormat::JsonLines, 0, err) &&
+                !err.empty(),
+            "exportTo should report an unreachable socket");
+}
+
+void test_trace_spans(TestContext &t) {
+    openscp::setTraceEnabled(false);
+    openscp::clearTrace();
+    { OPENSCP_TRACE_SPAN("trace.disabled", "test"); }
+    t.check(openscp::chromeTraceJson().find("trace.disabled") ==
+                std::string::npos,
+            "spans should not be recorded while tracing is off");
+
+    openscp::setTraceEnabled(true);
+    {
+        openscp::TraceSpan span("trace.outer", "test");
+        span.setArg("bytes", 42);
+        std::thread worker([] {
+            openscp::setTraceThreadName("trace-worker");
+            OPENSCP_TRACE_SPAN("trace.worker", "test");
+        });
+        worker.join();
+        openscp::traceInstant("trace.mark", "test");
+    }
+    for (std::size_t i = 0; i < openscp::kTraceEventsPerThread + 10; ++i) {
+        OPENSCP_TRACE_SPAN("trace.flood", "test");
+    }
+    openscp::setTraceEnabled(false);
+
+    const std::string json = openscp::chromeTraceJson();
+    t.checkContains(json, "\"traceEvents\":[",
+                    "trace dump should be Chrome trace_event JSON");
+    t.checkContains(json, "\"name\":\"trace.worker\"",
+                    "spans of exited threads should be kept");
+    t.checkContains(json, "\"args\":{\"name\":\"trace-worker\"}",
+                    "thread names should be exported as metadata");
+    t.check(json.find("\"trace.outer\"") == std::string::npos,
+            "a full ring should overwrite its oldest events");
+    std::size_t floods = 0;
+    for (std::size_t pos = json.find("trace.flood"); pos != std::string::npos;
+         pos = json.find("trace.flood", pos + 1))
+        ++floods;
+    t.check(floods == openscp::kTraceEventsPerThread,
+            "a thread ring should hold kTraceEventsPerThread events");
+
+    openscp::clearTrace();
+    t.check(openscp::chromeTraceJson().find("trace.flood") ==
+                std::string::npos,
+            "clearTrace should drop recorded events");
+}
+
+void test_transfer_ready_queue(TestContext &t) {
+    using openscp::SchedulingPolicy;
+    using openscp::TransferPriority;
+    using openscp::TransferReadyQueue;
+    auto next = [](TransferReadyQueue &q, int slots) {
+        auto id = q.pop(slots);
+        return id ? static_cast<int>(*id) : -1;
+    };
+
+    TransferReadyQueue q;
+    q.push(1, TransferPriority::Normal, 500);
+    q.push(2, TransferPriority::Low, 1);
+    q.push(3, TransferPriority::Normal, 10);
+    q.push(4, TransferPriority::High);
+    t.check(next(q, 2) == 4, "higher priority classes should run first");
+    t.check(next(q, 2) == 1, "fifo should keep arrival order in a class");
+    t.check(next(q, 2) == 3 && next(q, 2) == 2 && next(q, 2) == -1,
+            "fifo should drain every class in order");
+
+    q.setPolicy(SchedulingPolicy::ShortestFirst);
+    q.push(1, TransferPriority::Normal, 50ull << 30);
+    q.push(2, TransferPriority::Normal);
+    q.push(3, TransferPriority::Normal, 4096);
+    q.push(4, TransferPriority::Normal, 100);
+    q.push(4, TransferPriority::Normal, 1 << 20); // re-push moves the task
+    t.check(q.size() == 4, "re-pushing a task should not duplicate it");
+    t.check(next(q, 2) == 3 && next(q, 2) == 4 && next(q, 2) == 1 &&
+                next(q, 2) == 2,
+            "shortest-first should order by size, unknown sizes last");
+
+    q.setPolicy(SchedulingPolicy::SmallFilesLane);
+    q.setSmallFileThreshold(1000);
+    q.push(10, TransferPriority::Normal, 1 << 30);
+    q.push(11, TransferPriority::Normal, 1 << 30);
+    q.push(12, TransferPriority::Normal, 1 << 30);
+    q.push(13, TransferPriority::Normal, 10);
+    t.check(next(q, 3) == 10 && next(q, 3) == 11,
+            "the lane policy should run large tasks in arrival order");
+    t.check(next(q, 3) == 13, "one worker should stay free for small files");
+    t.check(next(q, 3) == -1,
+            "large tasks should not take the small-file worker");
+    q.release(10);
+    t.check(next(q, 3) == 12, "a released large slot should be reused");
+    q.release(11);
+    q.release(12);
+    q.push(14, TransferPriority::Normal, 1 << 30);
+    t.check(next(q, 1) == 14, "a single worker should take any task");
+
+    q.push(20, TransferPriority::Normal, 10);
+    q.remove(20);
+    t.check(q.empty() && next(q, 3) == -1,
+            "removed tasks should not be scheduled");
+}
+
+void test_transfer_journal(TestContext &t) {
+    using openscp::JournalTask;
+    using openscp::JournalTaskState;
+    using openscp::TransferJournal;
+    const fs::path path = makeTempFilePath("journal");
+    auto task = [](std::uint64_t id) {
+        JournalTask jt;
+        jt.id = id;
+        jt.session = "alice@example.test:22";
+        jt.src = "/local/f" + std::to_string(id);
+        jt.dst = "/remote/f" + std::to_string(id);
+        jt.sizeHint = id * 100;
+        return jt;
+    };
+
+    std::vector<JournalTask> loaded;
+    std::string err;
+    {
+        TransferJournal j;
+        t.check(j.open(path.string(), loaded, err) && loaded.empty(),
+                "a missing journal should open empty: " + err);
+        for (std::uint64_t id = 1; id <= 4; ++id)
+            j.put(task(id));
+        JournalTask batch = task(5);
+        batch.upload = false;
+        batch.batchFiles = std::make_shared<std::vector<std::string>>(
+            std::vector<std::string>{"a/1", "a/2"});
+        batch.batchTotalBytes = 42;
+        j.put(batch);
+        j.setState(2, JournalTaskState::Paused,
+                   openscp::TransferPriority::High);
+        j.remove(3);
+        t.check(j.flush(err), "journal flush failed: " + err);
+    }
+    {
+        TransferJournal j;
+        t.check(j.open(path.string(), loaded, err) && loaded.size() == 4,
+                "replay should keep live tasks only: " + err);
+        TransferJournal other;
+        std::vector<JournalTask> otherLoaded;
+        std::string otherErr;
+        t.check(!other.open(path.string(), otherLoaded, otherErr) &&
+                    other.lockedElsewhere() && !other.isOpen(),
+                "a second journal on an open file should be refused");
+        j.put(task(6));
+        t.check(j.flush(err), "journal flush failed: " + err);
+    }
+    // Simulate a crash that tore the last record in half.
+    fs::resize_file(path, fs::file_size(path) - 3);
+
+    TransferJournal j;
+    t.check(j.open(path.string(), loaded, err),
+            "a torn tail should not fail the replay: " + err);
+    t.check(loaded.size() == 4 && loaded[0].id == 1 && loaded[1].id == 2 &&
+                loaded[2].id == 4 && loaded[3].id == 5,
+            "replay should drop the torn record and keep enqueue order");
+    t.check(loaded.size() == 4 &&
+                loaded[1].state == JournalTaskState::Paused &&
+                loaded[1].priority == openscp::TransferPriority::High &&
+                loaded[0].src == "/local/f1" && loaded[0].sizeHint == 100,
+            "replay should apply state records to their task");
+    t.check(loaded.size() == 4 && !loaded[3].upload &&
+                loaded[3].batchFiles && loaded[3].batchFiles->size() == 2 &&
+                loaded[3].batchTotalBytes == 42,
+            "batch tasks should round-trip their file list");
+
+    for (std::uint64_t id = 100; id < 5000; ++id) {
+        j.put(task(id));
+        j.remove(id);
+    }
+    t.check(j.needsCompaction(), "a log of dead records should compact");
+    t.check(j.compact(loaded, err) && !j.needsCompaction() &&
+                j.liveCount() == 4,
+            "compaction failed: " + err);
+    j.close();
+    t.check(fs::file_size(path) < 1024,
+            "compaction should drop the dead records");
+
+    {
+        std::ofstream bad(path, std::ios::binary | std::ios::trunc);
+        bad << "not a journal";
+    }
+    t.check(!j.open(path.string(), loaded, err),
+            "a foreign file should not be replayed");
+}
+
+void test_local_copy(TestContext &t) {
+    using openscp::LocalCopyItem;
+    using openscp::LocalCopyOptions;
+    using openscp::LocalCopyOutcome;
+    const fs::path root = makeTempFilePath("localcopy").parent_path();
+    const fs::path src = root / "src";
+    fs::create_directories(src / "sub" / "deep");
+    fs::create_directories(src / "empty");
+    auto write = [](const fs::path &p, const std::string &data) {
+        std::ofstream out(p, std::ios::binary | std::ios::trunc);
+        out << data;
+    };
+    const std::string big(3 * 1024 * 1024 + 17, 'x');
+    write(src / "a.txt", "alpha");
+    write(src / "sub" / "b.bin", big);
+    write(src / "sub" / "deep" / "c.txt", "");
+    write(root / "single.txt", "single");
+
+    std::uint64_t lastDone = 0, lastTotal = 0;
+    std::mutex progressMutex;
+    LocalCopyOptions opt;
+    opt.threads = 3;
+    opt.progress = [&](std::uint64_t done, std::uint64_t total) {
+        std::lock_guard<std::mutex> lk(progressMutex);
+        lastDone = std::max(lastDone, done);
+        lastTotal = total;
+    };
+    std::vector<LocalCopyOutcome> outcomes;
+    const fs::path dst = root / "dst";
+    write(root / "stale.txt", "stale content that is longer");
+    const bool ok = openscp::runLocalCopy(
+        {LocalCopyItem{src.string(), dst.string()},
+         LocalCopyItem{(root / "single.txt").string(),
+                       (root / "stale.txt").string()}},
+        opt, outcomes);
+    t.check(ok && outcomes.size() == 2 && outcomes[0].ok && outcomes[1].ok,
+            "local copy failed: " +
+                (outcomes.empty() ? std::string() : outcomes[0].error));
+    std::string text;
+    t.check(readTextFile(dst / "sub" / "b.bin", text) && text == big,
+            "copied tree should keep file contents");
+    t.check(readTextFile(dst / "a.txt", text) && text == "alpha" &&
+                fs::is_regular_file(dst / "sub" / "deep" / "c.txt") &&
+                fs::is_directory(dst / "empty"),
+            "copied tree should keep files and empty folders");
+    t.check(readTextFile(root / "stale.txt", text) && text == "single",
+            "an existing target should be replaced");
+    t.check(lastTotal == big.size() + 5 + 6 && lastDone == lastTotal,
+            "aggregate progress should reach the planned total");
+
+    LocalCopyOptions move;
+    move.move = true;
+    const fs::path moved = root / "moved";
+    t.check(openscp::runLocalCopy({LocalCopyItem{dst.string(),
+                                                  moved.string()}},
+                                  move, outcomes) &&
+                !fs::exists(dst) &&
+                readTextFile(moved / "a.txt", text) && text == "alpha",
+            "move should relocate the tree");
+
+    LocalCopyOptions cancel;
+    cancel.shouldCancel = [] { return true; };
+    t.check(!openscp::runLocalCopy({LocalCopyItem{src.string(),
+                                                   (root / "c").string()}},
+                                   cancel, outcomes) &&
+                !outcomes[0].ok,
+            "a canceled copy should report failure");
+    t.check(!openscp::runLocalCopy(
+                {LocalCopyItem{(root / "missing").string(),
+                               (root / "m2").string()}},
+                opt, outcomes) &&
+                !outcomes[0].error.empty(),
+            "a missing source should fail its item");
+    std::error_code ec;
+    fs::remove_all(root, ec);
+}
+
+void test_concurrency_controller(TestContext &t) {
+    using openscp::ConcurrencyController;
+    using openscp::ConcurrencySample;
+    // Simulated link: each stream moves 10 MB/s up to a 45 MB/s ceiling.
+    auto sample = [](int limit, std::uint32_t failed = 0) {
+        ConcurrencySample s;
+        s.interval = std::chrono::milliseconds(1000);
+        s.bytes = std::min<std::uint64_t>(limit * 10'000'000ull, 45'000'000);
+        s.completed = 20;
+        s.failed = failed;
+        s.meanTaskTime = std::chrono::milliseconds(100);
+        s.active = limit;
+        s.backlog = true;
+        return s;
+    };
+
+    ConcurrencyController c(1, 16, 2);
+    for (int i = 0; i < 60; ++i)
+        c.update(sample(c.limit()));
+    t.check(c.limit() == 5 || c.limit() == 6,
+            "the controller should settle at the link's knee, got " +
+                std::to_string(c.limit()));
+    int maxSeen = 0;
+    for (int i = 0; i < 60; ++i)
+        maxSeen = std::max(maxSeen, c.update(sample(c.limit())));
+    t.check(maxSeen <= 6, "failed probes should be undone");
+
+    const int before = c.limit();
+    c.update(sample(c.limit(), 5));
+    t.check(c.limit() < before,
+            "network errors should cut the limit multiplicatively");
+
+    ConcurrencySample idle = sample(2);
+    idle.backlog = false;
+    ConcurrencyController quiet(1, 16, 2);
+    for (int i = 0; i < 20; ++i)
+        quiet.update(idle);
+    t.check(quiet.limit() == 2,
+            "the limit should not grow without a backlog");
+
+    // Flat goodput while the round trip grows fivefold: queueing delay.
+    ConcurrencyController bloated(1, 16, 4);
+    ConcurrencySample calm = sample(4);
+    calm.backlog = false;
+    calm.rtt = std::chrono::milliseconds(20);
+    bloated.update(calm);
+    int bloatedMax = bloated.limit();
+    for (int i = 0; i < 10; ++i) {
+        ConcurrencySample slow = sample(bloated.limit());
+        slow.bytes = 40'000'000;
+        slow.rtt = std::chrono::milliseconds(100);
+        bloatedMax = std::max(bloatedMax, bloated.update(slow));
+    }
+    t.check(bloated.limit() < 4 && bloatedMax <= 4,
+            "an inflated round trip should stop probing and cut the limit");
+
+    ConcurrencyController bounded(2, 3, 8);
+    t.check(bounded.limit() == 3, "the initial limit should be clamped");
+    for (int i = 0; i < 10; ++i)
+        bounded.update(sample(bounded.limit(), 20));
+    t.check(bounded.limit() == 2, "decreases should respect the minimum");
+    bounded.setBounds(4, 8);
+    t.check(bounded.limit() == 4, "new bounds should clamp the limit");
+}
+
+void test_bandwidth_scheduler(TestContext &t) {
+    using openscp::BandwidthScheduler;
+    using openscp::TransferDirection;
+    using clock = std::chrono::steady_clock;
+
+    BandwidthScheduler sched;
+    {
+        auto flow = sched.openFlow(TransferDirection::Download);
+        const auto start = clock::now();
+        for (int i = 0; i < 64; ++i)
+            sched.acquire(*flow, 1024 * 1024);
+        t.check(clock::now() - start < std::chrono::milliseconds(50),
+                "unlimited scheduler should not delay transfers");
+    }
+
+    // Two workers share one 2 MiB/s upload budget: 512 KiB in total must
+    // take roughly 250 ms (minus the burst allowance), not half of it.
+    sched.setRate(TransferDirection::Upload, 2 * 1024 * 1024);
+    auto worker = [&sched] {
+        auto flow = sched.openFlow(TransferDirection::Upload);
+        for (int i = 0; i < 16; ++i)
+            sched.acquire(*flow, 16 * 1024);
+    };
+    const auto start = clock::now();
+    std::thread a(worker);
+    std::thread b(worker);
+    a.join();
+    b.join();
+    const auto elapsed = clock::now() - start;
+    t.check(elapsed >= std::chrono::milliseconds(180),
+            "shared budget should pace all upload workers together");
+    t.check(elapsed < std::chrono::milliseconds(600),
+            "shared budget should not over-throttle");
+
+    // Downloads keep their own (unlimited) budget.
+    {
+        auto flow = sched.openFlow(TransferDirection::Download);
+        const auto dlStart = clock::now();
+        sched.acquire(*flow, 8 * 1024 * 1024);
+        t.check(clock::now() - dlStart < std::chrono::milliseconds(50),
+                "download budget should be independent of uploads");
+    }
+
+    // Per-flow caps apply on top and waits honor cancellation.
+    {
+        auto flow = sched.openFlow(TransferDirection::Download);
+        flow->setRateLimit(1024);
+        const auto capStart = clock::now();
+        const bool ok =
+            sched.acquire(*flow, 1024 * 1024, [] { return true; });
+        t.check(!ok, "canceled wait should report false");
+        t.check(clock::now() - capStart < std::chrono::milliseconds(100),
+                "canceled wait should return promptly");
+    }
+}
+
 } // namespace
 
 int main() {
@@ -614,20 +3063,52 @@ int main() {
     test_list_sorting_and_known_path(t);
     test_list_root_and_empty_path(t);
     test_missing_path_error(t);
-    test_unsupported_methods_report_error(t);
+    test_mock_file_operations(t);
+    test_mock_scale_and_faults(t);
     test_new_connection_like(t);
     test_new_connection_like_validation(t);
     test_client_factory(t);
     test_set_times(t);
     test_libssh2_rejects_conflicting_proxy_and_jump(t);
+#ifndef _WIN32
+    test_libssh2_connect_timings(t);
+#endif
 #if OPENSCP_HAS_CURL_FTP
     test_curlftp_rejects_unsupported_proxy_type(t);
 #endif
 #ifdef _WIN32
     test_libssh2_rejects_jump_on_windows(t);
 #endif
+    test_known_hosts_cache(t);
+    test_known_hosts_incremental_updates(t);
     test_remove_known_hosts_entry_plain_and_hashed(t);
     test_remove_known_hosts_entry_non_default_port(t);
+    test_transfer_metrics(t);
+    test_trace_spans(t);
+    test_transfer_ready_queue(t);
+    test_transfer_journal(t);
+    test_concurrency_controller(t);
+    test_local_copy(t);
+    test_bandwidth_scheduler(t);
+    test_listing_cache(t);
+    test_listing_prefetcher(t);
+    test_remote_delete(t);
+    test_remote_chmod(t);
+    test_remote_find(t);
+    test_precheck_cache(t);
+    test_remote_access(t);
+    test_session_executor(t);
+    test_list_stream(t);
+    test_compact_listing(t);
+    test_path_pool(t);
+    test_row_change_log(t);
+    test_remote_stream_copy(t);
+    test_remote_file_view(t);
+    test_segmented_download(t);
+    test_tar_stream(t);
+    test_sync_index(t);
+    test_local_file_io(t);
+    test_chunk_digest(t);
 
     if (t.failures != 0) {
         std::cerr << "[FAILURES] " << t.failures << "\n";
@@ -187,6 +187,21 @@ int main() {
     t.check(listed != listing.end(),
             "FTP listing should include the uploaded file");
 
+    openscp::FileInfo remoteInfo{};
+    err.clear();
+    t.check(client->stat(remotePath, remoteInfo, err),
+            std::string("FTP stat should find the uploaded file: ") + err);
+    t.check(!remoteInfo.is_dir && remoteInfo.has_size &&
+                remoteInfo.size == payload.size(),
+            "FTP stat should report the uploaded file size");
+    bool isDir = false;
+    err.clear();
+    t.check(client->exists(*remoteBase, isDir, err) && isDir,
+            std::string("FTP exists should report the base directory: ") + err);
+    err.clear();
+    t.check(!client->exists(remotePath + ".missing", isDir, err) && err.empty(),
+            "FTP exists should report missing paths without an error");
+
     client->disconnect();
     std::error_code ec;
     fs::remove_all(tempDir, ec);
@@ -506,6 +506,114 @@ int main() {
                 std::string("upload mismatch should report integrity error: ") +
                     err);
     }
+    // Delta re-upload: change one block and shrink the file.
+    if (t.failures == 0) {
+        const fs::path deltaLocal = localTmpRoot / "delta.bin";
+        const std::string remoteDelta =
+            joinRemotePath(remoteSuiteDir, "delta.bin");
+        std::string content(3 * 1024 * 1024 + 1234, '\0');
+        for (std::size_t i = 0; i < content.size(); ++i)
+            content[i] = static_cast<char>((i * 131) & 0xff);
+        (void)writeFile(deltaLocal, content);
+        err.clear();
+        t.check(client.put(deltaLocal.string(), remoteDelta, err, {}, {},
+                           false),
+                std::string("delta base upload should succeed: ") + err);
+        content[1024 * 1024 + 10] ^= 0x5a;
+        content.resize(content.size() - 4096);
+        (void)writeFile(deltaLocal, content);
+        err.clear();
+        t.check(client.putDelta(deltaLocal.string(), remoteDelta, err, {}, {}),
+                std::string("putDelta should succeed: ") + err);
+        const fs::path deltaBack = localTmpRoot / "delta.back";
+        err.clear();
+        std::string got;
+        t.check(client.get(remoteDelta, deltaBack.string(), err, {}, {},
+                           false) &&
+                    readFile(deltaBack, got) && got == content,
+                std::string("delta upload should reproduce the file: ") +
+                    err);
+        std::string deltaErr;
+        (void)removeRemoteFileIfExists(client, remoteDelta, deltaErr);
+    }
+    // interrupt() on one channel of a multiplexed transport stops that
+    // channel only; its siblings keep working.
+    if (t.failures == 0) {
+        openscp::SessionOptions muxOpt = opt;
+        muxOpt.ssh_multiplex = true;
+        openscp::Libssh2SftpClient first;
+        err.clear();
+        t.check(first.connect(muxOpt, err),
+                std::string("multiplexed connect should succeed: ") + err);
+        std::unique_ptr<openscp::SftpClient> second =
+            first.newConnectionLike(muxOpt, err);
+        t.check(second != nullptr,
+                std::string("a second channel should open: ") + err);
+        if (second) {
+            second->interrupt();
+            std::uint32_t rtt = 0;
+            openscp::FileInfo info;
+            std::string stErr;
+            t.check(!second->stat(remoteBase, info, stErr) &&
+                        !second->ping(rtt, stErr),
+                    "an interrupted channel should refuse new operations");
+            stErr.clear();
+            t.check(first.stat(remoteBase, info, stErr) &&
+                        first.ping(rtt, stErr),
+                    std::string("the sibling channel should keep working: ") +
+                        stErr);
+            second->disconnect();
+        }
+        first.disconnect();
+    }
+    // Archive batch: upload a small tree as one tar stream, fetch it back.
+    if (t.failures == 0) {
+        const fs::path batchSrc = localTmpRoot / "batch-src";
+        const fs::path batchDst = localTmpRoot / "batch-dst";
+        const std::vector<std::string> batchFiles = {"a.txt", "sub/b.txt",
+                                                     "sub/-dash.txt"};
+        fs::create_directories(batchSrc / "sub", ec);
+        for (const auto &rel : batchFiles)
+            (void)writeFile(batchSrc / rel, payload + rel);
+        const std::string remoteBatch =
+            joinRemotePath(remoteSuiteDir, "batch");
+        std::vector<std::string> reported;
+        err.clear();
+        t.check(client.putBatch(
+                    batchSrc.string(), batchFiles, remoteBatch, err,
+                    [&](const std::string &rel, std::uint64_t) {
+                        reported.push_back(rel);
+                    },
+                    {}),
+                std::string("putBatch should succeed: ") + err);
+        t.check(reported == batchFiles,
+                "putBatch should report every file in order");
+        reported.clear();
+        err.clear();
+        t.check(client.getBatch(
+                    remoteBatch, batchFiles, batchDst.string(), err,
+                    [&](const std::string &rel, std::uint64_t) {
+                        reported.push_back(rel);
+                    },
+                    {}),
+                std::string("getBatch should succeed: ") + err);
+        t.check(reported.size() == batchFiles.size(),
+                "getBatch should report every file");
+        for (const auto &rel : batchFiles) {
+            std::string got;
+            t.check(readFile(batchDst / rel, got) && got == payload + rel,
+                    "batch round trip should preserve " + rel);
+        }
+        std::string batchErr;
+        for (const auto &rel : batchFiles) {
+            (void)removeRemoteFileIfExists(
+                client, joinRemotePath(remoteBatch, rel), batchErr);
+            batchErr.clear();
+        }
+        (void)client.removeDir(joinRemotePath(remoteBatch, "sub"), batchErr);
+        batchErr.clear();
+        (void)client.removeDir(remoteBatch, batchErr);
+    }
     if (t.failures == 0) {
         err.clear();
         t.check(client.rename(remoteSrc, remoteMoved, err, false),
@@ -206,6 +206,46 @@ int main() {
             "downloaded file should be readable");
     t.check(downloaded == payload, "downloaded content should match uploaded");
 
+    // Large-file path: force parallel SFTP range readers with a low cutover.
+    {
+        std::string big;
+        big.reserve(3 * 1024 * 1024 + 123);
+        for (std::size_t i = 0; big.size() < 3 * 1024 * 1024 + 123; ++i)
+            big += std::to_string(i) + '\n';
+        const fs::path localBig = tempDir / "big.bin";
+        const fs::path localBigDownload = tempDir / "big_download.bin";
+        const std::string remoteBig =
+            joinRemotePath(remoteBase, "openscp_scp_it_big_" + token + ".bin");
+        t.check(writeFile(localBig, big), "should write large local file");
+        err.clear();
+        t.check(client.put(localBig.string(), remoteBig, err, {}, {}, false),
+                std::string("SCP large upload should succeed: ") + err);
+
+        openscp::SessionOptions rangedOpt = opt;
+        rangedOpt.scp_large_file_threshold = 1;
+        rangedOpt.scp_large_file_streams = 3;
+        openscp::Libssh2ScpClient ranged;
+        err.clear();
+        t.check(ranged.connect(rangedOpt, err),
+                std::string("second SCP connect should succeed: ") + err);
+        std::size_t lastDone = 0;
+        err.clear();
+        t.check(ranged.get(remoteBig, localBigDownload.string(), err,
+                           [&](std::size_t done, std::size_t total) {
+                               (void)total;
+                               lastDone = done;
+                           },
+                           {}, false),
+                std::string("ranged large download should succeed: ") + err);
+        std::string bigDownloaded;
+        t.check(readFile(localBigDownload, bigDownloaded) &&
+                    bigDownloaded == big,
+                "ranged large download content should match");
+        t.check(lastDone == big.size(),
+                "ranged download progress should reach the file size");
+        ranged.disconnect();
+    }
+
     std::vector<openscp::FileInfo> listing;
     err.clear();
     t.check(!client.list(remoteBase, listing, err),
@@ -0,0 +1,672 @@
+// Transfer benchmark: drives backends through the SftpClient interface and
+// reports MB/s, files/s, connect latency and CPU time per GB.
+//
+// The "mock" backend is the MockFileSystem of the unit tests behind a
+// simulated link with configurable round-trip time, bandwidth and loss, so
+// scheduling and pooling changes can be compared without a network. Real
+// servers are benchmarked when the OPENSCP_IT_* variables of the
+// integration tests are set (e.g. against local sshd/vsftpd/WebDAV
+// containers).
+//
+// With --baseline the run is a regression check: it fails when a metric is
+// worse than the saved one by more than --tolerance. --write-baseline saves
+// the current results in the same format.
+#include "openscp/ClientFactory.hpp"
+#include "openscp/MockSftpClient.hpp"
+#include "openscp/SftpClient.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::optional<std::string> envValue(const char *key) {
+    const char *raw = std::getenv(key);
+    if (!raw || !*raw)
+        return std::nullopt;
+    return std::string(raw);
+}
+
+std::string uniqueToken() {
+    const auto now = Clock::now().time_since_epoch().count();
+    return std::to_string(static_cast<long long>(now));
+}
+
+std::string joinRemotePath(const std::string &base, const std::string &name) {
+    if (base.empty())
+        return std::string("/") + name;
+    if (base.back() == '/')
+        return base + name;
+    return base + "/" + name;
+}
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Process CPU time in seconds (all threads).
+double cpuSeconds() {
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+// ---------------------------------------------------------------------------
+// Link of the "mock" backend, in command-line units. It drives the
+// MockSftpProfile of a MockFileSystem, whose bandwidth is shared by every
+// session like a real uplink: parallel sessions split it instead of
+// multiplying it.
+
+struct LinkProfile {
+    double rtt_ms = 20.0;
+    double bandwidth_mib_s = 100.0;
+    double loss = 0.0; // chance that a chunk is retransmitted (one more RTT)
+    int handshake_round_trips = 4;
+    std::size_t chunk_size = 32 * 1024;
+    std::size_t window_chunks = 64; // chunks in flight before an ACK wait
+};
+
+openscp::MockSftpProfile mockProfile(const LinkProfile &l) {
+    const auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::duration<double, std::milli>(l.rtt_ms));
+    openscp::MockSftpProfile p;
+    p.rtt = rtt;
+    p.connect_latency = rtt * l.handshake_round_trips;
+    p.bandwidth_bytes_per_sec = l.bandwidth_mib_s * 1024.0 * 1024.0;
+    p.loss_rate = l.loss;
+    p.chunk_size = l.chunk_size;
+    p.window_bytes = l.chunk_size * l.window_chunks;
+    p.seed = 7;
+    return p;
+}
+
+// Contents of the local files uploaded by the scenarios.
+char patternByte(std::uint64_t offset) {
+    return static_cast<char>((offset * 31u + 7u) % 251u);
+}
+
+// ---------------------------------------------------------------------------
+// Backends and scenarios.
+
+struct BenchConfig {
+    std::uint64_t bulk_bytes = 64ull * 1024 * 1024;
+    std::size_t small_files = 200;
+    std::size_t small_file_bytes = 16 * 1024;
+    std::size_t sessions = 4;
+    int handshakes = 5;
+    LinkProfile link;
+};
+
+struct Backend {
+    std::string name;
+    openscp::SessionOptions opt;
+    std::string remote_base;
+    // Creates an unconnected client for `opt`.
+    std::function<std::unique_ptr<openscp::SftpClient>()> create;
+};
+
+struct Result {
+    std::string backend;
+    std::string scenario;
+    std::uint64_t bytes = 0;
+    std::size_t files = 0;
+    double seconds = 0.0;
+    double cpu_seconds = 0.0;
+    double handshake_ms = 0.0; // "handshake" scenario only
+
+    double mibPerSecond() const {
+        return seconds > 0.0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0;
+    }
+    double filesPerSecond() const {
+        return seconds > 0.0 ? files / seconds : 0.0;
+    }
+    double cpuSecondsPerGiB() const {
+        return bytes > 0 ? cpu_seconds / (bytes / (1024.0 * 1024.0 * 1024.0))
+                         : 0.0;
+    }
+};
+
+bool writeLocalFile(const fs::path &p, std::uint64_t size) {
+    std::ofstream out(p, std::ios::binary | std::ios::trunc);
+    std::vector<char> buf(256 * 1024);
+    std::uint64_t done = 0;
+    while (out && done < size) {
+        const std::size_t n = static_cast<std::size_t>(
+            std::min<std::uint64_t>(buf.size(), size - done));
+        for (std::size_t i = 0; i < n; ++i)
+            buf[i] = patternByte(done + i);
+        out.write(buf.data(), static_cast<std::streamsize>(n));
+        done += n;
+    }
+    return static_cast<bool>(out);
+}
+
+// Runs `work(client, index)` for indices [0, count) over `sessions` parallel
+// connections cloned from `primary`, like the transfer queue does.
+bool runParallel(openscp::SftpClient &primary, const Backend &b,
+                 std::size_t sessions, std::size_t count,
+                 const std::function<bool(openscp::SftpClient &, std::size_t,
+                                          std::string &)> &work,
+                 std::string &err) {
+    std::vector<std::unique_ptr<openscp::SftpClient>> extra;
+    for (std::size_t i = 1; i < sessions; ++i) {
+        std::string why;
+        auto c = primary.newConnectionLike(b.opt, why);
+        if (!c)
+            break; // run with the sessions that could be opened
+        extra.push_back(std::move(c));
+    }
+    std::vector<openscp::SftpClient *> clients{&primary};
+    for (auto &c : extra)
+        clients.push_back(c.get());
+
+    std::atomic<std::size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::mutex errMutex;
+    auto worker = [&](openscp::SftpClient *c) {
+        for (;;) {
+            const std::size_t i = next++;
+            if (i >= count || failed.load())
+                return;
+            std::string why;
+            if (!work(*c, i, why)) {
+                failed = true;
+                std::lock_guard<std::mutex> lk(errMutex);
+                if (err.empty())
+                    err = why;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < clients.size(); ++i)
+        threads.emplace_back(worker, clients[i]);
+    worker(clients[0]);
+    for (std::thread &t : threads)
+        t.join();
+    for (auto &c : extra)
+        c->disconnect();
+    return !failed.load();
+}
+
+class Bench {
+    public:
+    Bench(const BenchConfig &cfg, const fs::path &scratch)
+        : cfg_(cfg), scratch_(scratch) {}
+
+    // Runs every scenario against `b`; false when the backend failed.
+    bool run(const Backend &b, std::vector<Result> &out) {
+        const std::string token = uniqueToken();
+        const std::string remoteDir =
+            joinRemotePath(b.remote_base, "openscp_bench_" + token);
+        const fs::path localDir = scratch_ / (b.name + "_" + token);
+        fs::create_directories(localDir);
+
+        std::unique_ptr<openscp::SftpClient> client = b.create();
+        std::string err;
+        if (!client) {
+            std::cerr << "[FAIL] " << b.name << ": backend not available\n";
+            return false;
+        }
+        if (!handshake(*client, b, out, err) ||
+            !client->mkdir(remoteDir, err, 0755) ||
+            !bulk(*client, b, remoteDir, localDir, out, err) ||
+            !smallFiles(*client, b, remoteDir, localDir, out, err)) {
+            std::cerr << "[FAIL] " << b.name << ": " << err << "\n";
+            cleanup(*client, remoteDir);
+            client->disconnect();
+            return false;
+        }
+        cleanup(*client, remoteDir);
+        client->disconnect();
+        std::error_code ec;
+        fs::remove_all(localDir, ec);
+        return true;
+    }
+
+    private:
+    bool handshake(openscp::SftpClient &client, const Backend &b,
+                   std::vector<Result> &out, std::string &err) {
+        Result r{b.name, "handshake"};
+        Clock::time_point start = Clock::now();
+        if (!client.connect(b.opt, err))
+            return false;
+        double total = secondsSince(start);
+        for (int i = 1; i < cfg_.handshakes; ++i) {
+            start = Clock::now();
+            auto c = client.newConnectionLike(b.opt, err);
+            if (!c)
+                return false;
+            total += secondsSince(start);
+            c->disconnect();
+        }
+        r.handshake_ms = total * 1000.0 / std::max(1, cfg_.handshakes);
+        out.push_back(r);
+        return true;
+    }
+
+    bool bulk(openscp::SftpClient &client, const Backend &b,
+              const std::string &remoteDir, const fs::path &localDir,
+              std::vector<Result> &out, std::string &err) {
+        const fs::path up = localDir / "bulk.bin";
+        const fs::path down = localDir / "bulk.down";
+        const std::string remote = joinRemotePath(remoteDir, "bulk.bin");
+        if (!writeLocalFile(up, cfg_.bulk_bytes)) {
+            err = "Cannot create " + up.string();
+            return false;
+        }
+        Result upload{b.name, "bulk-upload", cfg_.bulk_bytes, 1};
+        if (!timed(upload, [&] {
+                return client.put(up.string(), remote, err, {}, {}, false);
+            }))
+            return false;
+        Result download{b.name, "bulk-download", cfg_.bulk_bytes, 1};
+        if (!timed(download, [&] {
+                return client.get(remote, down.string(), err, {}, {}, false);
+            }))
+            return false;
+        std::error_code ec;
+        if (fs::file_size(down, ec) != cfg_.bulk_bytes || ec) {
+            err = "Downloaded size does not match";
+            return false;
+        }
+        out.push_back(upload);
+        out.push_back(download);
+        return true;
+    }
+
+    bool smallFiles(openscp::SftpClient &client, const Backend &b,
+                    const std::string &remoteDir, const fs::path &localDir,
+                    std::vector<Result> &out, std::string &err) {
+        const fs::path src = localDir / "small.bin";
+        if (!writeLocalFile(src, cfg_.small_file_bytes)) {
+            err = "Cannot create " + src.string();
+            return false;
+        }
+        const std::uint64_t bytes =
+            static_cast<std::uint64_t>(cfg_.small_file_bytes) *
+            cfg_.small_files;
+        auto remoteName = [&](std::size_t i) {
+            return joinRemotePath(remoteDir,
+                                  "small_" + std::to_string(i) + ".bin");
+        };
+        Result upload{b.name, "small-upload", bytes, cfg_.small_files};
+        if (!timed(upload, [&] {
+                return runParallel(
+                    client, b, cfg_.sessions, cfg_.small_files,
+                    [&](openscp::SftpClient &c, std::size_t i,
+                        std::string &why) {
+                        return c.put(src.string(), remoteName(i), why, {}, {},
+                                     false);
+                    },
+                    err);
+            }))
+            return false;
+        Result download{b.name, "small-download", bytes, cfg_.small_files};
+        if (!timed(download, [&] {
+                return runParallel(
+                    client, b, cfg_.sessions, cfg_.small_files,
+                    [&](openscp::SftpClient &c, std::size_t i,
+                        std::string &why) {
+                        const fs::path dst =
+                            localDir / ("small_" + std::to_string(i));
+                        return c.get(remoteName(i), dst.string(), why, {}, {},
+                                     false);
+                    },
+                    err);
+            }))
+            return false;
+        out.push_back(upload);
+        out.push_back(download);
+        return true;
+    }
+
+    template <typename Fn> static bool timed(Result &r, Fn &&fn) {
+        const double cpu = cpuSeconds();
+        const Clock::time_point start = Clock::now();
+        const bool ok = fn();
+        r.seconds = secondsSince(start);
+        r.cpu_seconds = cpuSeconds() - cpu;
+        return ok;
+    }
+
+    void cleanup(openscp::SftpClient &client, const std::string &remoteDir) {
+        if (!client.isConnected())
+            return;
+        std::vector<openscp::FileInfo> entries;
+        std::string err;
+        if (client.list(remoteDir, entries, err)) {
+            for (const openscp::FileInfo &e : entries)
+                (void)client.removeFile(joinRemotePath(remoteDir, e.name),
+                                        err);
+        }
+        (void)client.removeDir(remoteDir, err);
+    }
+
+    BenchConfig cfg_;
+    fs::path scratch_;
+};
+
+// ---------------------------------------------------------------------------
+// Real servers, configured like the integration tests.
+
+bool parsePort(const std::optional<std::string> &raw, std::uint16_t fallback,
+               std::uint16_t &out) {
+    if (!raw.has_value()) {
+        out = fallback;
+        return true;
+    }
+    try {
+        const int n = std::stoi(*raw);
+        if (n < 1 || n > 65535)
+            return false;
+        out = static_cast<std::uint16_t>(n);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Adds the backend `name` when its OPENSCP_IT_<PREFIX>_HOST and remote base
+// are set; false when its variables are present but invalid.
+bool addRealBackend(const std::string &name, openscp::Protocol protocol,
+                    const std::string &prefix, const char *baseVar,
+                    std::vector<Backend> &out) {
+    auto var = [&](const char *suffix) {
+        return envValue(("OPENSCP_IT_" + prefix + "_" + suffix).c_str());
+    };
+    const auto host = var("HOST");
+    const auto base = envValue(baseVar);
+    if (!host.has_value() || !base.has_value())
+        return true;
+
+    Backend b;
+    b.name = name;
+    b.remote_base = *base;
+    b.opt.protocol = protocol;
+    b.opt.host = *host;
+    if (!parsePort(var("PORT"), openscp::defaultPortForProtocol(protocol),
+                   b.opt.port)) {
+        std::cerr << "[FAIL] OPENSCP_IT_" << prefix << "_PORT is invalid\n";
+        return false;
+    }
+    b.opt.username = var("USER").value_or(
+        protocol == openscp::Protocol::Ftp ||
+                protocol == openscp::Protocol::Ftps
+            ? "anonymous"
+            : "");
+    b.opt.password = var("PASS");
+    if (const auto key = var("KEY"))
+        b.opt.private_key_path = *key;
+    b.opt.private_key_passphrase = var("KEY_PASSPHRASE");
+    b.opt.known_hosts_policy = openscp::KnownHostsPolicy::Off;
+    if (protocol == openscp::Protocol::Ftps) {
+        b.opt.ftps_verify_peer = var("VERIFY_PEER").value_or("1") != "0";
+        b.opt.ftps_ca_cert_path = var("CA_CERT");
+    }
+    if (protocol == openscp::Protocol::WebDav) {
+        if (const auto scheme = var("SCHEME"))
+            b.opt.webdav_scheme = openscp::webDavSchemeFromStorageName(*scheme);
+        else if (b.opt.port == openscp::defaultPortForWebDavScheme(
+                                   openscp::WebDavScheme::Http))
+            b.opt.webdav_scheme = openscp::WebDavScheme::Http;
+        b.opt.webdav_verify_peer = var("VERIFY_PEER").value_or("1") != "0";
+        b.opt.webdav_ca_cert_path = var("CA_CERT");
+    }
+    b.create = [protocol] {
+        return openscp::CreateClientForProtocol(protocol);
+    };
+    out.push_back(std::move(b));
+    return true;
+}
+
+Backend mockBackend(const LinkProfile &link) {
+    Backend b;
+    b.name = "mock";
+    b.remote_base = "/";
+    b.opt.host = "bench.invalid";
+    b.opt.username = "bench";
+    auto server = std::make_shared<openscp::MockFileSystem>();
+    server->setProfile(mockProfile(link));
+    // Uploads only record their size; downloads read a synthetic pattern.
+    server->setKeepContents(false);
+    b.create = [server] {
+        return std::make_unique<openscp::MockSftpClient>(server);
+    };
+    return b;
+}
+
+// ---------------------------------------------------------------------------
+// Reporting and baselines.
+
+// "<backend> <scenario> <metric> <value>" lines; '#' starts a comment.
+using Baseline = std::map<std::string, double>;
+
+std::vector<std::pair<std::string, double>> metricsOf(const Result &r) {
+    const std::string key = r.backend + " " + r.scenario + " ";
+    if (r.scenario == "handshake")
+        return {{key + "handshake_ms", r.handshake_ms}};
+    return {{key + "mib_per_s", r.mibPerSecond()},
+            {key + "files_per_s", r.filesPerSecond()}};
+}
+
+bool loadBaseline(const std::string &path, Baseline &out) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream ls(line);
+        std::string backend, scenario, metric;
+        double value = 0.0;
+        if (ls >> backend >> scenario >> metric >> value)
+            out[backend + " " + scenario + " " + metric] = value;
+    }
+    return true;
+}
+
+bool writeBaseline(const std::string &path, const std::vector<Result> &rs) {
+    std::ofstream out(path, std::ios::trunc);
+    out << "# openscp_transfer_bench baseline: backend scenario metric "
+           "value\n";
+    for (const Result &r : rs)
+        for (const auto &[key, value] : metricsOf(r))
+            out << key << " " << value << "\n";
+    return static_cast<bool>(out);
+}
+
+// Lower is better only for latencies.
+int compareBaseline(const Baseline &base, const std::vector<Result> &rs,
+                    double tolerance) {
+    int regressions = 0;
+    for (const Result &r : rs) {
+        for (const auto &[key, value] : metricsOf(r)) {
+            auto it = base.find(key);
+            if (it == base.end() || it->second <= 0.0)
+                continue;
+            const bool lowerIsBetter =
+                key.size() >= 3 && key.compare(key.size() - 3, 3, "_ms") == 0;
+            const bool regressed =
+                lowerIsBetter ? value > it->second * (1.0 + tolerance)
+                              : value < it->second * (1.0 - tolerance);
+            if (regressed) {
+                ++regressions;
+                std::cerr << "[REGRESSION] " << key << ": " << value
+                          << " (baseline " << it->second << ")\n";
+            }
+        }
+    }
+    return regressions;
+}
+
+void printResults(const std::vector<Result> &rs) {
+    std::printf("%-8s %-15s %10s %10s %10s %12s\n", "backend", "scenario",
+                "MiB/s", "files/s", "CPU s/GiB", "connect ms");
+    for (const Result &r : rs) {
+        if (r.scenario == "handshake") {
+            std::printf("%-8s %-15s %10s %10s %10s %12.1f\n",
+                        r.backend.c_str(), r.scenario.c_str(), "-", "-", "-",
+                        r.handshake_ms);
+            continue;
+        }
+        std::printf("%-8s %-15s %10.2f %10.1f %10.2f %12s\n",
+                    r.backend.c_str(), r.scenario.c_str(), r.mibPerSecond(),
+                    r.filesPerSecond(), r.cpuSecondsPerGiB(), "-");
+    }
+}
+
+void printUsage() {
+    std::cout
+        << "Usage: openscp_transfer_bench [options]\n"
+           "  --backend NAME      mock, sftp, scp, ftp, ftps, webdav or all\n"
+           "                      (default: mock plus every configured "
+           "server)\n"
+           "  --quick             small sizes, for smoke runs\n"
+           "  --size-mib N        bulk file size (default 64)\n"
+           "  --files N           small files per direction (default 200)\n"
+           "  --file-kib N        small file size (default 16)\n"
+           "  --sessions N        parallel sessions for small files "
+           "(default 4)\n"
+           "  --rtt-ms X          mock link round-trip time (default 20)\n"
+           "  --bandwidth-mib X   mock link bandwidth in MiB/s (default "
+           "100)\n"
+           "  --loss X            mock chunk retransmit ratio 0..1 "
+           "(default 0)\n"
+           "  --baseline FILE     fail on regressions against FILE\n"
+           "  --tolerance X       allowed regression ratio (default 0.2)\n"
+           "  --write-baseline F  save the results as a baseline\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    BenchConfig cfg;
+    std::string backendFilter;
+    std::string baselinePath;
+    std::string writeBaselinePath;
+    double tolerance = 0.2;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        try {
+            if (arg == "--help" || arg == "-h") {
+                printUsage();
+                return EXIT_SUCCESS;
+            } else if (arg == "--quick") {
+                cfg.bulk_bytes = 8ull * 1024 * 1024;
+                cfg.small_files = 40;
+                cfg.handshakes = 2;
+            } else if (arg == "--backend" && hasValue) {
+                backendFilter = argv[++i];
+            } else if (arg == "--size-mib" && hasValue) {
+                cfg.bulk_bytes = std::stoull(argv[++i]) * 1024 * 1024;
+            } else if (arg == "--files" && hasValue) {
+                cfg.small_files = std::stoul(argv[++i]);
+            } else if (arg == "--file-kib" && hasValue) {
+                cfg.small_file_bytes = std::stoul(argv[++i]) * 1024;
+            } else if (arg == "--sessions" && hasValue) {
+                cfg.sessions = std::max<std::size_t>(1, std::stoul(argv[++i]));
+            } else if (arg == "--rtt-ms" && hasValue) {
+                cfg.link.rtt_ms = std::stod(argv[++i]);
+            } else if (arg == "--bandwidth-mib" && hasValue) {
+                cfg.link.bandwidth_mib_s = std::stod(argv[++i]);
+            } else if (arg == "--loss" && hasValue) {
+                cfg.link.loss = std::stod(argv[++i]);
+            } else if (arg == "--baseline" && hasValue) {
+                baselinePath = argv[++i];
+            } else if (arg == "--tolerance" && hasValue) {
+                tolerance = std::stod(argv[++i]);
+            } else if (arg == "--write-baseline" && hasValue) {
+                writeBaselinePath = argv[++i];
+            } else {
+                std::cerr << "Unknown or incomplete option: " << arg << "\n";
+                printUsage();
+                return EXIT_FAILURE;
+            }
+        } catch (...) {
+            std::cerr << "Invalid value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (cfg.link.bandwidth_mib_s <= 0.0 || cfg.link.rtt_ms < 0.0 ||
+        cfg.link.loss < 0.0 || cfg.link.loss > 1.0) {
+        std::cerr << "Invalid mock link profile\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Backend> backends{mockBackend(cfg.link)};
+    const bool ok =
+        addRealBackend("sftp", openscp::Protocol::Sftp, "SFTP",
+                       "OPENSCP_IT_REMOTE_BASE", backends) &&
+        addRealBackend("scp", openscp::Protocol::Scp, "SCP",
+                       "OPENSCP_IT_SCP_REMOTE_BASE", backends) &&
+        addRealBackend("ftp", openscp::Protocol::Ftp, "FTP",
+                       "OPENSCP_IT_FTP_REMOTE_BASE", backends) &&
+        addRealBackend("ftps", openscp::Protocol::Ftps, "FTPS",
+                       "OPENSCP_IT_FTPS_REMOTE_BASE", backends) &&
+        addRealBackend("webdav", openscp::Protocol::WebDav, "WEBDAV",
+                       "OPENSCP_IT_WEBDAV_REMOTE_BASE", backends);
+    if (!ok)
+        return EXIT_FAILURE;
+    if (!backendFilter.empty() && backendFilter != "all") {
+        backends.erase(std::remove_if(backends.begin(), backends.end(),
+                                      [&](const Backend &b) {
+                                          return b.name != backendFilter;
+                                      }),
+                       backends.end());
+        if (backends.empty()) {
+            std::cerr << "Backend '" << backendFilter
+                      << "' is unknown or not configured\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    const fs::path scratch =
+        fs::temp_directory_path() / ("openscp_bench_" + uniqueToken());
+    fs::create_directories(scratch);
+    Bench bench(cfg, scratch);
+    std::vector<Result> results;
+    int failures = 0;
+    for (const Backend &b : backends) {
+        if (!bench.run(b, results))
+            ++failures;
+    }
+    std::error_code ec;
+    fs::remove_all(scratch, ec);
+
+    printResults(results);
+    if (!writeBaselinePath.empty() &&
+        !writeBaseline(writeBaselinePath, results)) {
+        std::cerr << "[FAIL] could not write " << writeBaselinePath << "\n";
+        ++failures;
+    }
+    if (!baselinePath.empty()) {
+        Baseline base;
+        if (!loadBaseline(baselinePath, base)) {
+            std::cerr << "[FAIL] could not read " << baselinePath << "\n";
+            return EXIT_FAILURE;
+        }
+        failures += compareBaseline(base, results, tolerance);
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
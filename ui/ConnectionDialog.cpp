@@ -17,6 +17,7 @@
 #include <QTimer>
 #include <QToolButton>
 #include <QWidget>
+#include <algorithm>
 
 static void setFormRowVisible(QFormLayout *layout, QWidget *field,
                               bool visible) {
@@ -317,6 +318,57 @@ ConnectionDialog::ConnectionDialog(QWidget *parent) : QDialog(parent) {
         static_cast<int>(openscp::TransferIntegrityPolicy::Off));
     integrityPolicy_->setToolTip(tr(
         "Checksum verification for resume and final transfer validation."));
+    sshCiphers_ = new QLineEdit(this);
+    sshCiphers_->setPlaceholderText(tr("Default"));
+    sshCiphers_->setMinimumWidth(kInputMinWidth);
+    sshCiphers_->setToolTip(
+        tr("Comma-separated cipher names, most preferred first (e.g. "
+           "aes128-gcm@openssh.com,chacha20-poly1305@openssh.com)."));
+    sshMacs_ = new QLineEdit(this);
+    sshMacs_->setPlaceholderText(tr("Default"));
+    sshMacs_->setMinimumWidth(kInputMinWidth);
+    sshMacs_->setToolTip(tr("Comma-separated MAC names, most preferred first. "
+                            "Not used by AEAD ciphers (GCM, ChaCha20)."));
+    sshCompression_ = new QCheckBox(tr("Compress SSH traffic (zlib)"), this);
+    sshCompression_->setToolTip(
+        tr("Helps on slow links with compressible data; slows down fast "
+           "links."));
+    sshMultiplex_ =
+        new QCheckBox(tr("Share one SSH connection for parallel transfers"),
+                      this);
+    sshMultiplex_->setToolTip(
+        tr("Parallel transfers open extra SFTP channels on this connection "
+           "instead of logging in again. Saves handshakes and jump host "
+           "tunnels; the channels share its bandwidth."));
+    netAutoTune_ =
+        new QCheckBox(tr("Size buffers for the link automatically"), this);
+    netAutoTune_->setToolTip(
+        tr("Measures the round trip after login and sizes the SSH window, "
+           "the request pipeline and (where the OS does not tune them "
+           "itself) the socket buffers for the link speed below. Sizes "
+           "set explicitly are kept."));
+    netLinkMbps_ = new QSpinBox(this);
+    netLinkMbps_->setRange(1, 400000);
+    netLinkMbps_->setValue(1000);
+    netLinkMbps_->setSuffix(tr(" Mbit/s"));
+    netLinkMbps_->setToolTip(tr("Bandwidth to plan for when sizing buffers "
+                                "automatically."));
+    tcpBuffer_ = new QSpinBox(this);
+    tcpBuffer_->setRange(0, 1024 * 1024);
+    tcpBuffer_->setSingleStep(1024);
+    tcpBuffer_->setSuffix(tr(" KiB"));
+    tcpBuffer_->setSpecialValueText(tr("System default"));
+    tcpBuffer_->setToolTip(
+        tr("SO_SNDBUF / SO_RCVBUF. A single stream cannot move more than "
+           "this per round trip."));
+    sshWindow_ = new QSpinBox(this);
+    sshWindow_->setRange(0, 1024 * 1024);
+    sshWindow_->setSingleStep(1024);
+    sshWindow_->setSuffix(tr(" KiB"));
+    sshWindow_->setSpecialValueText(tr("Default"));
+    sshWindow_->setToolTip(tr("SFTP channel receive window."));
+    tcpNoDelay_ = new QCheckBox(
+        tr("Send small packets immediately (TCP_NODELAY)"), this);
     ftpsVerifyPeer_ =
         new QCheckBox(tr("Verify FTPS server certificate (recommended)"), this);
     ftpsCaPath_ = new QLineEdit(this);
@@ -399,6 +451,15 @@ ConnectionDialog::ConnectionDialog(QWidget *parent) : QDialog(parent) {
     lay->addRow(tr("known_hosts:"), khPathRow_);
     lay->addRow(tr("Policy:"), khPolicy_);
     lay->addRow(tr("Integrity:"), integrityPolicy_);
+    lay->addRow(tr("SSH ciphers:"), sshCiphers_);
+    lay->addRow(tr("SSH MACs:"), sshMacs_);
+    lay->addRow(QString(), sshCompression_);
+    lay->addRow(QString(), sshMultiplex_);
+    lay->addRow(QString(), netAutoTune_);
+    lay->addRow(tr("Link speed:"), netLinkMbps_);
+    lay->addRow(tr("Socket buffers:"), tcpBuffer_);
+    lay->addRow(tr("SSH window:"), sshWindow_);
+    lay->addRow(QString(), tcpNoDelay_);
     lay->addRow(QString(), ftpsVerifyPeer_);
     lay->addRow(tr("FTPS CA bundle:"), ftpsCaPathRow_);
     lay->addRow(tr("WebDAV scheme:"), webDavScheme_);
@@ -681,6 +742,30 @@ openscp::SessionOptions ConnectionDialog::options() const {
             static_cast<openscp::TransferIntegrityPolicy>(
                 integrityPolicy_->currentData().toInt());
     }
+    if (sshCiphers_)
+        o.ssh_ciphers = sshCiphers_->text().trimmed().toStdString();
+    if (sshMacs_)
+        o.ssh_macs = sshMacs_->text().trimmed().toStdString();
+    if (sshCompression_)
+        o.ssh_compression = sshCompression_->isChecked();
+    if (sshMultiplex_)
+        o.ssh_multiplex = sshMultiplex_->isChecked();
+    if (netAutoTune_)
+        o.network_auto_tune = netAutoTune_->isChecked();
+    if (netLinkMbps_)
+        o.network_link_mbps =
+            static_cast<std::uint32_t>(netLinkMbps_->value());
+    if (tcpBuffer_) {
+        // One size for both directions.
+        o.tcp_send_buffer =
+            static_cast<std::uint32_t>(tcpBuffer_->value()) * 1024;
+        o.tcp_recv_buffer = o.tcp_send_buffer;
+    }
+    if (sshWindow_)
+        o.ssh_window_size =
+            static_cast<std::uint32_t>(sshWindow_->value()) * 1024;
+    if (tcpNoDelay_)
+        o.tcp_nodelay = tcpNoDelay_->isChecked();
     if (ftpsVerifyPeer_) {
         o.ftps_verify_peer = ftpsVerifyPeer_->isChecked();
     }
@@ -794,6 +879,26 @@ void ConnectionDialog::setOptions(const openscp::SessionOptions &o) {
         if (i >= 0)
             integrityPolicy_->setCurrentIndex(i);
     }
+    if (sshCiphers_)
+        sshCiphers_->setText(QString::fromStdString(o.ssh_ciphers));
+    if (sshMacs_)
+        sshMacs_->setText(QString::fromStdString(o.ssh_macs));
+    if (sshCompression_)
+        sshCompression_->setChecked(o.ssh_compression);
+    if (sshMultiplex_)
+        sshMultiplex_->setChecked(o.ssh_multiplex);
+    if (netAutoTune_)
+        netAutoTune_->setChecked(o.network_auto_tune);
+    if (netLinkMbps_)
+        netLinkMbps_->setValue(static_cast<int>(
+            std::clamp<std::uint32_t>(o.network_link_mbps, 1, 400000)));
+    if (tcpBuffer_)
+        tcpBuffer_->setValue(static_cast<int>(
+            std::max(o.tcp_send_buffer, o.tcp_recv_buffer) / 1024));
+    if (sshWindow_)
+        sshWindow_->setValue(static_cast<int>(o.ssh_window_size / 1024));
+    if (tcpNoDelay_)
+        tcpNoDelay_->setChecked(o.tcp_nodelay);
     if (ftpsVerifyPeer_)
         ftpsVerifyPeer_->setChecked(o.ftps_verify_peer);
     if (ftpsCaPath_) {
@@ -937,6 +1042,25 @@ void ConnectionDialog::updateProtocolUi(openscp::Protocol protocol,
         setFormRowVisible(formLayout_, keyPathRow_, sshAuthSupported);
     if (formLayout_ && keyPassRow_)
         setFormRowVisible(formLayout_, keyPassRow_, sshAuthSupported);
+    if (formLayout_ && sshCiphers_)
+        setFormRowVisible(formLayout_, sshCiphers_, sshAuthSupported);
+    if (formLayout_ && sshMacs_)
+        setFormRowVisible(formLayout_, sshMacs_, sshAuthSupported);
+    if (formLayout_ && sshCompression_)
+        setFormRowVisible(formLayout_, sshCompression_, sshAuthSupported);
+    if (formLayout_ && sshMultiplex_)
+        setFormRowVisible(formLayout_, sshMultiplex_,
+                          protocol == openscp::Protocol::Sftp);
+    if (formLayout_ && netAutoTune_)
+        setFormRowVisible(formLayout_, netAutoTune_, sshAuthSupported);
+    if (formLayout_ && netLinkMbps_)
+        setFormRowVisible(formLayout_, netLinkMbps_, sshAuthSupported);
+    if (formLayout_ && tcpBuffer_)
+        setFormRowVisible(formLayout_, tcpBuffer_, sshAuthSupported);
+    if (formLayout_ && sshWindow_)
+        setFormRowVisible(formLayout_, sshWindow_, sshAuthSupported);
+    if (formLayout_ && tcpNoDelay_)
+        setFormRowVisible(formLayout_, tcpNoDelay_, sshAuthSupported);
 
     if (formLayout_ && khPathRow_)
         setFormRowVisible(formLayout_, khPathRow_, caps.supports_known_hosts);
@@ -51,6 +51,17 @@ class ConnectionDialog : public QDialog {
     QComboBox *khPolicy_ = nullptr;
     QComboBox *integrityPolicy_ = nullptr;
     QWidget *khPathRow_ = nullptr;
+    // SSH algorithm preferences
+    QLineEdit *sshCiphers_ = nullptr;
+    QLineEdit *sshMacs_ = nullptr;
+    QCheckBox *sshCompression_ = nullptr;
+    QCheckBox *sshMultiplex_ = nullptr;
+    // Socket / SSH window sizing for long fast links
+    QCheckBox *netAutoTune_ = nullptr;
+    QSpinBox *netLinkMbps_ = nullptr;
+    QSpinBox *tcpBuffer_ = nullptr; // KiB, send and receive
+    QSpinBox *sshWindow_ = nullptr; // KiB
+    QCheckBox *tcpNoDelay_ = nullptr;
     QCheckBox *ftpsVerifyPeer_ = nullptr;
     QLineEdit *ftpsCaPath_ = nullptr;
     QToolButton *ftpsCaBrowse_ = nullptr;
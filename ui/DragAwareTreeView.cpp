@@ -10,6 +10,7 @@
 #include <QDesktopServices>
 #include <QDir>
 #include <QDrag>
+#include <QEventLoop>
 #include <QFileInfo>
 #include <QKeySequence>
 #include <QLabel>
@@ -29,10 +30,74 @@
 #include <QTimer>
 #include <QUrl>
 #include <QVector>
+#include <algorithm>
+#include <limits>
+#include <mutex>
 Q_DECLARE_LOGGING_CATEGORY(ocEnum)
 
 Q_LOGGING_CATEGORY(ocDrag, "openscp.drag")
 
+static const char *kStagingBatchMime = "application/x-openscp-staging-batch";
+static const char *kRemoteItemsMime = "application/x-openscp-remote-items";
+static const char *kUriListMime = "text/uri-list";
+
+// Payload of a lazy remote drag-out: a file promise built on Qt's deferred
+// QMimeData retrieval. The drag starts with only the remote paths; local
+// copies are staged when the drop target first asks for file URLs, which
+// targets do on the drop. OpenSCP's own panels read kRemoteItemsMime and
+// queue the download themselves, so nothing is staged for them.
+class RemoteDragMimeData final : public QMimeData {
+    public:
+    // Stage the items; returns their local URLs and sets the batch folder.
+    using Resolver = std::function<QList<QUrl>(QString &batchDir)>;
+
+    RemoteDragMimeData(QStringList remotePaths, Resolver resolve)
+        : remotePaths_(std::move(remotePaths)), resolve_(std::move(resolve)) {}
+
+    QStringList formats() const override {
+        return {QString::fromLatin1(kUriListMime),
+                QString::fromLatin1(kRemoteItemsMime)};
+    }
+    bool hasFormat(const QString &mime) const override {
+        return formats().contains(mime);
+    }
+    bool resolved() const { return resolved_; }
+    QString batchDir() const { return batchDir_; }
+
+    protected:
+    QVariant retrieveData(const QString &mime,
+                          QMetaType type) const override {
+        if (mime == QLatin1String(kRemoteItemsMime))
+            return remotePaths_.join('\n').toUtf8();
+        if (mime == QLatin1String(kStagingBatchMime))
+            return batchDir_.toUtf8();
+        if (mime != QLatin1String(kUriListMime))
+            return {};
+        if (!resolved_) {
+            resolved_ = true;
+            urls_ = resolve_(batchDir_);
+        }
+        if (type.id() == QMetaType::QByteArray) {
+            QByteArray list;
+            for (const QUrl &u : urls_)
+                list += u.toEncoded() + "\r\n";
+            return list;
+        }
+        QVariantList list;
+        list.reserve(urls_.size());
+        for (const QUrl &u : urls_)
+            list.push_back(u);
+        return list;
+    }
+
+    private:
+    QStringList remotePaths_;
+    Resolver resolve_;
+    mutable bool resolved_ = false;
+    mutable QList<QUrl> urls_;
+    mutable QString batchDir_;
+};
+
 static QString stagingRootFromSettings() {
     QSettings s("OpenSCP", "OpenSCP");
     QString root = s.value("Advanced/stagingRoot").toString();
@@ -63,9 +128,13 @@ void DragAwareTreeView::startDrag(Qt::DropActions supportedActions) {
         }
         return;
     }
-    // If this is a remote model, run asynchronous staging flow
+    // If this is a remote model, stage on drop or (legacy) before the drag
     if (auto *rm = qobject_cast<RemoteModel *>(model())) {
-        startRemoteDragAsync(rm);
+        QSettings s("OpenSCP", "OpenSCP");
+        if (s.value("Advanced/lazyRemoteDrag", true).toBool())
+            startRemoteDragLazy(rm);
+        else
+            startRemoteDragAsync(rm);
         return;
     }
 
@@ -85,14 +154,18 @@ void DragAwareTreeView::startDrag(Qt::DropActions supportedActions) {
     const auto res = drag->exec(Qt::CopyAction);
 
     // Custom payload from RemoteModel when dragging out from remote
-    const QByteArray k =
-        QByteArrayLiteral("application/x-openscp-staging-batch");
-    if (!md->hasFormat(k))
+    if (!md->hasFormat(QString::fromLatin1(kStagingBatchMime)))
         return; // nothing to do
-    const QString batchDir = QString::fromUtf8(md->data(k));
+    const QString batchDir =
+        QString::fromUtf8(md->data(QString::fromLatin1(kStagingBatchMime)));
     if (batchDir.isEmpty())
         return;
+    finishStagedDrag(res, batchDir);
+}
 
+void DragAwareTreeView::finishStagedDrag(Qt::DropAction res,
+                                         const QString &batchDir,
+                                         int cleanupDelayMs) {
     QSettings s("OpenSCP", "OpenSCP");
     const bool autoClean = s.value("Advanced/autoCleanStaging", true).toBool();
 
@@ -108,7 +181,82 @@ void DragAwareTreeView::startDrag(Qt::DropActions supportedActions) {
     }
 
     // Success path: schedule retries to delete batch dir and maybe root
-    scheduleAutoCleanup(batchDir);
+    scheduleAutoCleanup(batchDir, cleanupDelayMs);
+}
+
+void DragAwareTreeView::startRemoteDragLazy(RemoteModel *rm) {
+    if (!rm || !transferMgr_) {
+        QTreeView::startDrag(Qt::CopyAction);
+        return;
+    }
+    auto sel = selectionModel();
+    const QModelIndexList rows =
+        sel ? sel->selectedRows(0) : QModelIndexList{};
+    if (rows.isEmpty()) {
+        // Selection not row-based yet: let the staging flow infer rows.
+        startRemoteDragAsync(rm);
+        return;
+    }
+    const QString base = rm->rootPath();
+    QStringList remotePaths;
+    remotePaths.reserve(rows.size());
+    for (const QModelIndex &idx : rows) {
+        const QString name = rm->nameAt(idx);
+        remotePaths << (base.endsWith('/') ? base + name : base + '/' + name);
+    }
+
+    QPointer<DragAwareTreeView> self(this);
+    QPointer<RemoteModel> model(rm);
+    auto *md = new RemoteDragMimeData(
+        remotePaths, [self, model](QString &batchDir) -> QList<QUrl> {
+            if (!self || !model)
+                return {};
+            return self->stageForDrop(model, batchDir);
+        });
+    auto *drag = new QDrag(this);
+    drag->setMimeData(md);
+    const auto res = drag->exec(Qt::CopyAction);
+    if (!self || !md->resolved() || md->batchDir().isEmpty())
+        return; // dropped on one of our panels, or never asked for files
+    // Internal drops may still be copying staged files in the target panel.
+    const QWidget *target = qobject_cast<const QWidget *>(drag->target());
+    const bool droppedInsideThisWindow =
+        target && target->window() == window();
+    finishStagedDrag(res, md->batchDir(),
+                     droppedInsideThisWindow ? 10000 : 500);
+}
+
+QList<QUrl> DragAwareTreeView::stageForDrop(RemoteModel *rm,
+                                            QString &batchDir) {
+    if (dragInProgress_)
+        return {};
+    QPointer<DragAwareTreeView> self(this);
+    QList<QUrl> urls;
+    bool finished = false;
+    QEventLoop loop;
+    startRemoteDragAsync(
+        rm, [&](const QList<QUrl> &staged, const QString &dir) {
+            urls = staged;
+            batchDir = dir;
+            finished = true;
+            loop.quit();
+        });
+    // The drop target waits for the URLs; keep the UI (and the overlay
+    // with its Cancel button) alive meanwhile.
+    if (!finished && dragInProgress_)
+        loop.exec();
+    if (self)
+        onStaged_ = nullptr; // returned early without calling back
+    return urls;
+}
+
+void DragAwareTreeView::notifyStaged(const QList<QUrl> &urls,
+                                     const QString &batchDir) {
+    if (!onStaged_)
+        return;
+    auto done = std::move(onStaged_);
+    onStaged_ = nullptr;
+    done(urls, batchDir);
 }
 
 void DragAwareTreeView::showKeepMessage(const QString &batchDir) {
@@ -252,14 +400,18 @@ void DragAwareTreeView::updateOverlayGeometry() {
     }
 }
 
-void DragAwareTreeView::startRemoteDragAsync(RemoteModel *rm) {
+void DragAwareTreeView::startRemoteDragAsync(RemoteModel *rm,
+                                             StagedCallback onStaged) {
     if (!rm || !transferMgr_) {
-        QTreeView::startDrag(Qt::CopyAction);
+        if (!onStaged)
+            QTreeView::startDrag(Qt::CopyAction);
         return;
     }
     if (dragInProgress_)
         return;
     dragInProgress_ = true;
+    // With a callback the drop already happened: stage, report, no drag.
+    onStaged_ = std::move(onStaged);
 
     // Collect selected rows (name column only)
     auto sel = selectionModel();
@@ -377,6 +529,31 @@ void DragAwareTreeView::startRemoteDragAsync(RemoteModel *rm) {
             opt.skipSymlinks =
                 true; // per requirements: skip symlinks by default
             opt.cancel = enumCancelFlag_.get();
+            // Extra listing sessions come from, and go back to, the transfer
+            // pool. Sessions are returned under the oldest generation seen,
+            // so none outlives a pool drain that happened mid-walk.
+            struct PoolGeneration {
+                std::mutex m;
+                quint64 oldest = std::numeric_limits<quint64>::max();
+            };
+            TransferManager *tm = transferMgr_;
+            auto poolGen = std::make_shared<PoolGeneration>();
+            opt.leaseSession = [tm, poolGen] {
+                quint64 generation = 0;
+                auto session = tm->takeIdleSession(generation);
+                std::lock_guard<std::mutex> lk(poolGen->m);
+                poolGen->oldest = std::min(poolGen->oldest, generation);
+                return session;
+            };
+            opt.releaseSession =
+                [tm, poolGen](std::shared_ptr<openscp::SftpClient> session) {
+                    quint64 generation = 0;
+                    {
+                        std::lock_guard<std::mutex> lk(poolGen->m);
+                        generation = poolGen->oldest;
+                    }
+                    tm->returnSession(std::move(session), generation);
+                };
             bool partial = false;
             bool someUnknown = false;
             quint64 dirCount = 0;
@@ -467,6 +644,8 @@ void DragAwareTreeView::startRemoteDragAsync(RemoteModel *rm) {
                   << ((tooMany || tooBig) ? "yes" : "no") << "symlinkSkipped"
                   << QLocale().toString((qulonglong)enumSymlinksSkipped_)
                   << "denied" << QLocale().toString((qulonglong)enumDenied_);
+    // Lazy drops ask as well: the drop target waits for the answer, and
+    // canceling here hands it no URLs before anything is staged.
     if (tooMany || tooBig) {
         auto *mw = qobject_cast<QMainWindow *>(window());
         QWidget *parent =
@@ -604,7 +783,8 @@ void DragAwareTreeView::startRemoteDragAsync(RemoteModel *rm) {
             cancelCurrentBatch(QStringLiteral("dialog"));
         }
     });
-    waitTimer_->start();
+    if (!onStaged_)
+        waitTimer_->start();
 
     // Connect to tasksChanged to monitor our batch
     stagingConn_ = QObject::connect(
@@ -674,6 +854,7 @@ void DragAwareTreeView::startRemoteDragAsync(RemoteModel *rm) {
                     currentBatchDir_.clear();
                     currentBatchId_.clear();
                     currentBatchTotal_ = 0;
+                    notifyStaged({}, QString());
                     return;
                 }
 
@@ -682,10 +863,33 @@ void DragAwareTreeView::startRemoteDragAsync(RemoteModel *rm) {
                 urls.reserve(targets.size());
                 for (const auto &p : targets)
                     urls << QUrl::fromLocalFile(p.local);
+                if (onStaged_) {
+                    // Lazy drag: the drop target is waiting for these.
+                    const QString batchDir = currentBatchDir_;
+                    const qint64 stagingMs =
+                        stagingTimer_.isValid() ? stagingTimer_.elapsed() : -1;
+                    logBatchResult(
+                        currentBatchId_, total, 0,
+                        QString("result=staged-on-drop enumDirs=%1 files=%2 "
+                                "enumMs=%3 stagingMs=%4")
+                            .arg(QLocale().toString((qulonglong)totalDirs))
+                            .arg(QLocale().toString((qulonglong)totalItems))
+                            .arg(enumMs_)
+                            .arg(stagingMs));
+                    dragInProgress_ = false;
+                    currentBatchDir_.clear();
+                    currentBatchId_.clear();
+                    currentBatchTotal_ = 0;
+                    if (quitConn_) {
+                        QObject::disconnect(quitConn_);
+                        quitConn_ = QMetaObject::Connection();
+                    }
+                    notifyStaged(urls, batchDir);
+                    return;
+                }
                 auto *md = new QMimeData();
                 md->setUrls(urls);
-                md->setData("application/x-openscp-staging-batch",
-                            currentBatchDir_.toUtf8());
+                md->setData(kStagingBatchMime, currentBatchDir_.toUtf8());
 
                 auto *drag = new QDrag(self);
                 drag->setMimeData(md);
@@ -795,6 +999,7 @@ void DragAwareTreeView::cancelCurrentBatch(const QString &reason) {
     if (currentBatchDir_.isEmpty()) {
         hidePrepOverlay();
         dragInProgress_ = false;
+        notifyStaged({}, QString());
         return;
     }
     if (stagingConn_) {
@@ -837,6 +1042,7 @@ void DragAwareTreeView::cancelCurrentBatch(const QString &reason) {
         QObject::disconnect(quitConn_);
         quitConn_ = QMetaObject::Connection();
     }
+    notifyStaged({}, QString());
 }
 
 void DragAwareTreeView::logBatchResult(const QString &batchId, int totalItems,
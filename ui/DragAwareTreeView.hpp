@@ -2,8 +2,11 @@
 #pragma once
 #include <QElapsedTimer>
 #include <QMetaObject>
+#include <QList>
 #include <QTreeView>
+#include <QUrl>
 #include <atomic>
+#include <functional>
 #include <memory>
 
 class DragAwareTreeView : public QTreeView {
@@ -25,8 +28,21 @@ class DragAwareTreeView : public QTreeView {
     void showKeepMessageWithPrefix(const QString &prefix,
                                    const QString &batchDir);
     void scheduleAutoCleanup(const QString &batchDir, int initialDelayMs = 500);
-    // Remote -> system drag-out: prepare asynchronously using TransferManager
-    void startRemoteDragAsync(class RemoteModel *rm);
+    // Cleanup or keep message for a finished drag of a staging batch.
+    void finishStagedDrag(Qt::DropAction res, const QString &batchDir,
+                          int cleanupDelayMs = 500);
+    // Staged URLs (empty when canceled or failed) and their batch folder.
+    using StagedCallback =
+        std::function<void(const QList<QUrl> &urls, const QString &batchDir)>;
+    // Remote -> system drag-out: prepare asynchronously using TransferManager,
+    // then start the drag, or hand the staged URLs to `onStaged` instead.
+    void startRemoteDragAsync(class RemoteModel *rm,
+                              StagedCallback onStaged = {});
+    // Remote drag-out that starts at once and stages only on drop.
+    void startRemoteDragLazy(class RemoteModel *rm);
+    // Stage the selection for a drop target, waiting until it is ready.
+    QList<QUrl> stageForDrop(class RemoteModel *rm, QString &batchDir);
+    void notifyStaged(const QList<QUrl> &urls, const QString &batchDir);
 
     // Lightweight overlay while preparing staging
     void showPrepOverlay(const QString &text);
@@ -53,6 +69,7 @@ class DragAwareTreeView : public QTreeView {
 
     // Drag state
     bool dragInProgress_ = false;
+    StagedCallback onStaged_; // set while staging for a lazy drop
     QString currentBatchDir_;
     QString currentBatchId_;
     int currentBatchTotal_ = 0;
@@ -11,6 +11,7 @@
 #include "SiteManagerDialog.hpp"
 #include "TransferManager.hpp"
 #include "TransferQueueDialog.hpp"
+#include "openscp/SessionExecutor.hpp"
 #include <QAbstractButton>
 #include <QApplication>
 #include <QCheckBox>
@@ -300,6 +301,26 @@ static QRegularExpression compilePanelSearchRegex(const QString &rawPattern,
     return regex;
 }
 
+// Server-side prefilter for a recursive remote search: a shell pattern
+// accepting at least every name the panel regex accepts. Real regexes are
+// only tested locally, so every entry is sent back.
+static openscp::FindOptions
+remoteFindOptionsForPattern(const QString &rawPattern, bool includeHidden) {
+    openscp::FindOptions filter;
+    filter.include_hidden = includeHidden;
+    filter.case_insensitive = true;
+    const QString pattern = rawPattern.trimmed();
+    if (pattern.isEmpty() || hasRegexMetaBeyondWildcards(pattern))
+        return filter;
+    if (pattern.contains(QLatin1Char('*')) ||
+        pattern.contains(QLatin1Char('?')))
+        filter.name_glob = pattern.toStdString();
+    else
+        filter.name_glob = (QLatin1Char('*') + pattern + QLatin1Char('*'))
+                               .toStdString();
+    return filter;
+}
+
 struct PanelSearchPromptResult {
     QString pattern;
     bool recursive = false;
@@ -439,7 +460,10 @@ static void showRecursiveSearchResultsDialog(
     dlg.exec();
 }
 
-MainWindow::~MainWindow() = default; // define the destructor here
+MainWindow::~MainWindow() {
+    // The ping thread uses sftp_, which dies with the window.
+    finishRemoteSessionPing();
+}
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     // Models
@@ -1115,11 +1139,9 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 
     // Transfer queue
     transferMgr_ = new TransferManager(this);
+    transferMgr_->taskCount(m_transferChangeVersion_);
     connect(transferMgr_, &TransferManager::tasksChanged, this,
-            [this] {
-                maybeRefreshRemoteAfterCompletedUploads();
-                maybeNotifyCompletedTransfers();
-            });
+            &MainWindow::onTransferTasksChanged);
     // Provide transfer manager to views (for async remote drag-out staging)
     if (auto *lv = qobject_cast<DragAwareTreeView *>(leftView_))
         lv->setTransferManager(transferMgr_);
@@ -1253,14 +1275,30 @@ void MainWindow::startConnectionSessionIndicators(
     m_connectionStartedAtMs_ = QDateTime::currentMSecsSinceEpoch();
     if (m_connectionElapsedTimer_)
         m_connectionElapsedTimer_->start();
+    // Where the connect time went, for diagnosing slow session setup.
+    openscp::ConnectTimings timings;
+    if (m_connectionTypeLabel_ && sftp_ && sftp_->connectTimings(timings)) {
+        QString tip = tr("Active connection method for this session") + "\n" +
+                      tr("Connect: %1").arg(QString::fromStdString(
+                          openscp::describeConnectTimings(timings)));
+        openscp::NetworkTuning tuning;
+        if (sftp_->networkTuning(tuning))
+            tip += "\n" + tr("Network: %1").arg(QString::fromStdString(
+                              openscp::describeNetworkTuning(tuning)));
+        m_connectionTypeLabel_->setToolTip(tip);
+    }
     updateConnectionSessionIndicators();
 }
 
 void MainWindow::resetConnectionSessionIndicators() {
     m_activeConnectionType_.clear();
     m_connectionStartedAtMs_ = 0;
+    m_remoteSessionRttMs_ = -1;
     if (m_connectionElapsedTimer_)
         m_connectionElapsedTimer_->stop();
+    if (m_connectionTypeLabel_)
+        m_connectionTypeLabel_->setToolTip(
+            tr("Active connection method for this session"));
     updateConnectionSessionIndicators();
 }
 
@@ -1280,9 +1318,11 @@ void MainWindow::updateConnectionSessionIndicators() {
                 qMax<qint64>(0, (QDateTime::currentMSecsSinceEpoch() -
                                  m_connectionStartedAtMs_) /
                                     1000);
-            m_connectionElapsedLabel_->setText(
-                tr("Session: %1")
-                    .arg(formatConnectionElapsed(elapsedSeconds)));
+            QString text = tr("Session: %1")
+                               .arg(formatConnectionElapsed(elapsedSeconds));
+            if (m_remoteSessionRttMs_ >= 0)
+                text += tr(" · RTT %1 ms").arg(m_remoteSessionRttMs_);
+            m_connectionElapsedLabel_->setText(text);
         }
     }
 }
@@ -1613,6 +1653,22 @@ void MainWindow::searchItemsInCurrentFolder(QTreeView *view,
         return;
     }
 
+    if (view == rightView_ && rightIsRemote_) {
+        if (!rightRemoteModel_ || !sftp_) {
+            QMessageBox::warning(this, tr("Remote"),
+                                 tr("No active remote session."));
+            return;
+        }
+        QString baseRemote = rightRemoteModel_->rootPath().trimmed();
+        if (baseRemote.isEmpty())
+            baseRemote = QStringLiteral("/");
+        startRemoteSearchJob(panelLabel,
+                             normalizeRemotePathForMatch(baseRemote), regex,
+                             remoteFindOptionsForPattern(req.pattern,
+                                                         prefShowHidden_));
+        return;
+    }
+
     static constexpr int kRecursiveSearchMaxMatches = 5000;
     static constexpr int kRecursiveSearchPumpEvery = 128;
     QVector<QPair<QString, bool>> recursiveMatches; // path, isDir
@@ -1620,177 +1676,69 @@ void MainWindow::searchItemsInCurrentFolder(QTreeView *view,
     bool canceled = false;
     bool truncated = false;
 
-    if (view == rightView_ && rightIsRemote_ && (!rightRemoteModel_ || !sftp_)) {
-        QMessageBox::warning(this, tr("Remote"),
-                             tr("No active remote session."));
+    QString basePathForSummary;
+    QString baseLocal =
+        (view == leftView_) ? (leftPath_ ? leftPath_->text() : QString())
+                            : (rightPath_ ? rightPath_->text() : QString());
+    baseLocal = QDir::cleanPath(baseLocal.trimmed());
+    if (baseLocal.isEmpty() || !QDir(baseLocal).exists()) {
+        QMessageBox::warning(this, tr("Invalid folder"),
+                             tr("The current folder does not exist."));
         return;
     }
+    basePathForSummary = baseLocal;
+    QDir baseDir(baseLocal);
+
+    QDir::Filters filters =
+        QDir::AllEntries | QDir::NoDotAndDotDot | QDir::System;
+    if (prefShowHidden_)
+        filters |= QDir::Hidden;
+
+    QProgressDialog progress(
+        tr("Searching recursively in %1...").arg(panelLabel), tr("Cancel"),
+        0, 0, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(0);
+
+    QDirIterator it(baseLocal, filters, QDirIterator::Subdirectories);
+    qint64 pumped = 0;
+    while (it.hasNext()) {
+        if (progress.wasCanceled()) {
+            canceled = true;
+            break;
+        }
 
-    const bool isRemotePanelSearch =
-        (view == rightView_ && rightIsRemote_ && rightRemoteModel_ && sftp_);
-    QString basePathForSummary;
-
-    if (isRemotePanelSearch) {
-        QString baseRemote = rightRemoteModel_->rootPath().trimmed();
-        if (baseRemote.isEmpty())
-            baseRemote = QStringLiteral("/");
-        baseRemote = normalizeRemotePathForMatch(baseRemote);
-        basePathForSummary = baseRemote;
-
-        QProgressDialog progress(
-            tr("Searching recursively in %1...").arg(panelLabel), tr("Cancel"),
-            0, 0, this);
-        progress.setWindowModality(Qt::WindowModal);
-        progress.setMinimumDuration(0);
-
-        QSet<QString> visited;
-        QVector<QString> stack;
-        stack.push_back(baseRemote);
-        qint64 pumped = 0;
+        const QString absPath = it.next();
+        const QFileInfo fi = it.fileInfo();
+        const QString name = fi.fileName();
+        if (name.isEmpty() || name == QStringLiteral(".") ||
+            name == QStringLiteral("..")) {
+            continue;
+        }
 
-        while (!stack.isEmpty()) {
-            if (progress.wasCanceled()) {
-                canceled = true;
+        if (regex.match(name).hasMatch()) {
+            QString rel = QDir::fromNativeSeparators(
+                baseDir.relativeFilePath(absPath));
+            if (rel.isEmpty())
+                rel = name;
+            recursiveMatches.push_back({rel, fi.isDir()});
+            if (recursiveMatches.size() >= kRecursiveSearchMaxMatches) {
+                truncated = true;
                 break;
             }
+        }
 
-            const QString current = stack.back();
-            stack.pop_back();
-            const QString currentNorm = normalizeRemotePathForMatch(current);
-            if (visited.contains(currentNorm))
-                continue;
-            visited.insert(currentNorm);
-
-            progress.setLabelText(tr("Scanning %1").arg(currentNorm));
+        ++pumped;
+        if ((pumped % kRecursiveSearchPumpEvery) == 0) {
+            progress.setLabelText(tr("Scanning %1")
+                                      .arg(QDir::fromNativeSeparators(
+                                          baseDir.relativeFilePath(
+                                              fi.absoluteFilePath()))));
             QCoreApplication::processEvents();
             if (progress.wasCanceled()) {
                 canceled = true;
                 break;
             }
-
-            std::vector<openscp::FileInfo> out;
-            std::string err;
-            if (!sftp_->list(currentNorm.toStdString(), out, err)) {
-                ++scanErrors;
-                continue;
-            }
-
-            for (const auto &entry : out) {
-                const QString name = QString::fromStdString(entry.name);
-                if (name.isEmpty() || name == QStringLiteral(".") ||
-                    name == QStringLiteral("..")) {
-                    continue;
-                }
-                if (!prefShowHidden_ && name.startsWith('.'))
-                    continue;
-
-                const bool isSymlink = (entry.mode & 0120000u) == 0120000u;
-                const bool isDir = entry.is_dir;
-                const QString child =
-                    (currentNorm == QStringLiteral("/")
-                         ? (QStringLiteral("/") + name)
-                         : (currentNorm + QStringLiteral("/") + name));
-                const QString childNorm = normalizeRemotePathForMatch(child);
-
-                QString rel;
-                if (baseRemote == QStringLiteral("/")) {
-                    rel = childNorm.mid(1);
-                } else if (childNorm.startsWith(baseRemote + QStringLiteral("/"))) {
-                    rel = childNorm.mid(baseRemote.size() + 1);
-                } else {
-                    rel = childNorm;
-                }
-                if (rel.isEmpty())
-                    rel = name;
-
-                if (regex.match(name).hasMatch()) {
-                    recursiveMatches.push_back({rel, isDir});
-                    if (recursiveMatches.size() >= kRecursiveSearchMaxMatches) {
-                        truncated = true;
-                        break;
-                    }
-                }
-
-                if (isDir && !isSymlink)
-                    stack.push_back(childNorm);
-
-                ++pumped;
-                if ((pumped % kRecursiveSearchPumpEvery) == 0) {
-                    QCoreApplication::processEvents();
-                    if (progress.wasCanceled()) {
-                        canceled = true;
-                        break;
-                    }
-                }
-            }
-
-            if (canceled || truncated)
-                break;
-        }
-    } else {
-        QString baseLocal =
-            (view == leftView_) ? (leftPath_ ? leftPath_->text() : QString())
-                                : (rightPath_ ? rightPath_->text() : QString());
-        baseLocal = QDir::cleanPath(baseLocal.trimmed());
-        if (baseLocal.isEmpty() || !QDir(baseLocal).exists()) {
-            QMessageBox::warning(this, tr("Invalid folder"),
-                                 tr("The current folder does not exist."));
-            return;
-        }
-        basePathForSummary = baseLocal;
-        QDir baseDir(baseLocal);
-
-        QDir::Filters filters =
-            QDir::AllEntries | QDir::NoDotAndDotDot | QDir::System;
-        if (prefShowHidden_)
-            filters |= QDir::Hidden;
-
-        QProgressDialog progress(
-            tr("Searching recursively in %1...").arg(panelLabel), tr("Cancel"),
-            0, 0, this);
-        progress.setWindowModality(Qt::WindowModal);
-        progress.setMinimumDuration(0);
-
-        QDirIterator it(baseLocal, filters, QDirIterator::Subdirectories);
-        qint64 pumped = 0;
-        while (it.hasNext()) {
-            if (progress.wasCanceled()) {
-                canceled = true;
-                break;
-            }
-
-            const QString absPath = it.next();
-            const QFileInfo fi = it.fileInfo();
-            const QString name = fi.fileName();
-            if (name.isEmpty() || name == QStringLiteral(".") ||
-                name == QStringLiteral("..")) {
-                continue;
-            }
-
-            if (regex.match(name).hasMatch()) {
-                QString rel = QDir::fromNativeSeparators(
-                    baseDir.relativeFilePath(absPath));
-                if (rel.isEmpty())
-                    rel = name;
-                recursiveMatches.push_back({rel, fi.isDir()});
-                if (recursiveMatches.size() >= kRecursiveSearchMaxMatches) {
-                    truncated = true;
-                    break;
-                }
-            }
-
-            ++pumped;
-            if ((pumped % kRecursiveSearchPumpEvery) == 0) {
-                progress.setLabelText(tr("Scanning %1")
-                                          .arg(QDir::fromNativeSeparators(
-                                              baseDir.relativeFilePath(
-                                                  fi.absoluteFilePath()))));
-                QCoreApplication::processEvents();
-                if (progress.wasCanceled()) {
-                    canceled = true;
-                    break;
-                }
-            }
         }
     }
 
@@ -1827,46 +1775,65 @@ void MainWindow::searchItemsInCurrentFolder(QTreeView *view,
     statusBar()->showMessage(msg, 6000);
 }
 
-void MainWindow::maybeRefreshRemoteAfterCompletedUploads() {
-    if (!transferMgr_) {
-        m_seenCompletedUploadTaskIds_.clear();
-        m_pendingRemoteRefreshFromUpload_ = false;
+void MainWindow::onTransferTasksChanged() {
+    if (!transferMgr_)
+        return;
+    std::vector<TransferTaskChange> changes;
+    if (!transferMgr_->changesSince(m_transferChangeVersion_, changes)) {
+        // Too far behind to replay: skip to now rather than rescan.
+        transferMgr_->taskCount(m_transferChangeVersion_);
         return;
     }
 
-    const auto tasks = transferMgr_->tasksSnapshot();
-    QSet<quint64> activeUploadIds;
-    activeUploadIds.reserve(tasks.size());
+    QVector<TransferTask> completed;
+    bool removed = false;
+    for (const TransferTaskChange &c : changes) {
+        if (c.kind == TransferTaskChange::Kind::Removed) {
+            removed = true;
+            continue;
+        }
+        if (c.kind != TransferTaskChange::Kind::Updated ||
+            m_seenCompletedTaskIds_.contains(c.id))
+            continue;
+        TransferTask t;
+        if (!transferMgr_->taskAt(c.row, t) ||
+            t.status != TransferTask::Status::Done)
+            continue;
+        m_seenCompletedTaskIds_.insert(t.id);
+        completed.push_back(t);
+    }
+    // Forget tasks that left the queue (clears are rare; this is cheap).
+    if (removed) {
+        for (auto it = m_seenCompletedTaskIds_.begin();
+             it != m_seenCompletedTaskIds_.end();) {
+            if (transferMgr_->rowOf(*it) < 0)
+                it = m_seenCompletedTaskIds_.erase(it);
+            else
+                ++it;
+        }
+    }
+    if (completed.isEmpty())
+        return;
+    maybeRefreshRemoteAfterCompletedUploads(completed);
+    maybeNotifyCompletedTransfers(completed);
+}
 
+void MainWindow::maybeRefreshRemoteAfterCompletedUploads(
+    const QVector<TransferTask> &completed) {
     bool shouldRefresh = false;
     const QString currentRoot =
         rightRemoteModel_ ? rightRemoteModel_->rootPath() : QString();
 
-    for (const auto &t : tasks) {
+    for (const auto &t : completed) {
         if (t.type != TransferTask::Type::Upload)
             continue;
-
-        activeUploadIds.insert(t.id);
-        if (t.status != TransferTask::Status::Done)
-            continue;
-        if (m_seenCompletedUploadTaskIds_.contains(t.id))
-            continue;
-
-        m_seenCompletedUploadTaskIds_.insert(t.id);
         if (rightIsRemote_ && rightRemoteModel_ &&
             remotePathIsInsideRoot(t.dst, currentRoot)) {
             shouldRefresh = true;
+            break;
         }
     }
 
-    for (auto it = m_seenCompletedUploadTaskIds_.begin();
-         it != m_seenCompletedUploadTaskIds_.end();) {
-        if (!activeUploadIds.contains(*it))
-            it = m_seenCompletedUploadTaskIds_.erase(it);
-        else
-            ++it;
-    }
-
     if (!shouldRefresh || m_pendingRemoteRefreshFromUpload_ || !rightIsRemote_ ||
         !rightRemoteModel_) {
         return;
@@ -1883,50 +1850,33 @@ void MainWindow::maybeRefreshRemoteAfterCompletedUploads() {
     });
 }
 
-void MainWindow::maybeNotifyCompletedTransfers() {
-    if (!transferMgr_) {
-        m_seenCompletedTransferNoticeTaskIds_.clear();
-        return;
-    }
-
-    const auto tasks = transferMgr_->tasksSnapshot();
-    QSet<quint64> activeTaskIds;
-    activeTaskIds.reserve(tasks.size());
-
+void MainWindow::maybeNotifyCompletedTransfers(
+    const QVector<TransferTask> &completed) {
     QString message;
-    int newlyCompleted = 0;
-    for (const auto &t : tasks) {
-        activeTaskIds.insert(t.id);
-        if (t.status != TransferTask::Status::Done)
-            continue;
-        if (m_seenCompletedTransferNoticeTaskIds_.contains(t.id))
-            continue;
-
-        m_seenCompletedTransferNoticeTaskIds_.insert(t.id);
-        ++newlyCompleted;
-        if (newlyCompleted == 1) {
-            const bool upload = (t.type == TransferTask::Type::Upload);
-            const QString path = upload ? t.src : t.dst;
-            QString name = QFileInfo(path).fileName();
-            if (name.isEmpty())
-                name = path;
-            message = upload ? tr("Upload completed: %1").arg(name)
-                             : tr("Download completed: %1").arg(name);
+    if (completed.size() > 1) {
+        message = tr("%1 transfers completed").arg(completed.size());
+    } else {
+        const TransferTask &t = completed.front();
+        const bool upload = (t.type == TransferTask::Type::Upload);
+        const QString path = upload ? t.src : t.dst;
+        QString name = QFileInfo(path).fileName();
+        if (name.isEmpty())
+            name = path;
+        switch (t.type) {
+        case TransferTask::Type::Upload:
+            message = tr("Upload completed: %1").arg(name);
+            break;
+        case TransferTask::Type::Download:
+            message = tr("Download completed: %1").arg(name);
+            break;
+        case TransferTask::Type::LocalCopy:
+            message = tr("Local copy completed: %1").arg(name);
+            break;
+        case TransferTask::Type::RemoteCopy:
+            message = tr("Remote copy completed: %1").arg(name);
+            break;
         }
     }
-
-    for (auto it = m_seenCompletedTransferNoticeTaskIds_.begin();
-         it != m_seenCompletedTransferNoticeTaskIds_.end();) {
-        if (!activeTaskIds.contains(*it))
-            it = m_seenCompletedTransferNoticeTaskIds_.erase(it);
-        else
-            ++it;
-    }
-
-    if (newlyCompleted == 0)
-        return;
-    if (newlyCompleted > 1)
-        message = tr("%1 transfers completed").arg(newlyCompleted);
     statusBar()->showMessage(message, 5000);
 }
 
@@ -1938,6 +1888,17 @@ bool MainWindow::isScpTransferMode() const {
     return caps.supports_file_transfers && !caps.supports_listing;
 }
 
+bool MainWindow::archiveBatchModeEnabled() const {
+    if (!rightIsRemote_ || !m_activeSessionOptions_.has_value())
+        return false;
+    const openscp::ProtocolCapabilities caps =
+        openscp::capabilitiesForProtocol(m_activeSessionOptions_->protocol);
+    if (!caps.supports_batch_archive)
+        return false;
+    QSettings s("OpenSCP", "OpenSCP");
+    return s.value("Transfer/archiveBatchMode", false).toBool();
+}
+
 void MainWindow::activateScpTransferModeUi(bool enabled) {
     if (!rightContentStack_ || !rightView_)
         return;
@@ -2069,10 +2030,26 @@ void MainWindow::applyTransferPreferences() {
         return;
     QSettings s("OpenSCP", "OpenSCP");
     const int maxConcurrent =
-        qBound(1, s.value("Transfer/maxConcurrent", 2).toInt(), 8);
+        qBound(1, s.value("Transfer/maxConcurrent", 2).toInt(), 32);
+    const bool adaptive =
+        s.value("Transfer/adaptiveConcurrency", false).toBool();
+    const int minConcurrent = qBound(
+        1, s.value("Transfer/minConcurrent", 1).toInt(), maxConcurrent);
     const int globalSpeed =
         qMax(0, s.value("Transfer/globalSpeedKBps", 0).toInt());
-    transferMgr_->setMaxConcurrent(maxConcurrent);
+    if (adaptive) {
+        transferMgr_->setAdaptiveConcurrency(true, minConcurrent,
+                                             maxConcurrent);
+    } else {
+        transferMgr_->setAdaptiveConcurrency(false, 0, 0);
+        transferMgr_->setMaxConcurrent(maxConcurrent);
+    }
+    const int policy = qBound(
+        static_cast<int>(openscp::SchedulingPolicy::Fifo),
+        s.value("Transfer/schedulingPolicy", 0).toInt(),
+        static_cast<int>(openscp::SchedulingPolicy::SmallFilesLane));
+    transferMgr_->setSchedulingPolicy(
+        static_cast<openscp::SchedulingPolicy>(policy));
     transferMgr_->setGlobalSpeedLimitKBps(globalSpeed);
     if (transferDlg_)
         QMetaObject::invokeMethod(transferDlg_, "refresh",
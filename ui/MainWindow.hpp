@@ -16,6 +16,8 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <thread>
+#include <vector>
 
 class RemoteModel; // fwd
 class QModelIndex; // fwd for slot signatures
@@ -29,9 +31,13 @@ class QStackedWidget; // fwd
 class QTimer;      // fwd
 class QSplitter;   // fwd
 class QPushButton; // fwd
+class QRegularExpression; // fwd
+struct TransferTask; // fwd
 namespace openscp {
+class SessionExecutor;
 class SftpClient;
 struct SessionOptions;
+struct SyncEntry;
 } // namespace openscp
 
 class MainWindow : public QMainWindow {
@@ -80,12 +86,17 @@ class MainWindow : public QMainWindow {
     leftItemActivated(const QModelIndex &idx); // double click on local (left)
     void downloadRightToLeft();                // remote -> local
     void uploadViaDialog(); // local -> remote (dialog: files or folder)
+    void syncLeftToRight(); // upload changes since the last sync
+    void syncRightToLeft(); // download changes since the last sync
     void newDirRight();
     void newFileRight();
     void renameRightSelected();
     void deleteRightSelected();
     void showRightContextMenu(const QPoint &pos);
     void changeRemotePermissions();
+    void duplicateRemoteSelected(); // server-side copy next to the original
+    void copyRemoteToServer(); // stream the selection to a saved site
+    void viewRemoteSelected(); // paged viewer, no download
     void showLeftContextMenu(const QPoint &pos);
     void newDirLeft();
     void newFileLeft();
@@ -103,6 +114,11 @@ class MainWindow : public QMainWindow {
 
     void updateDeleteShortcutEnables();
     bool isScpTransferMode() const;
+    // Folder transfers may go out as tar-stream archive batches: opt-in
+    // setting and a session protocol that supports them.
+    bool archiveBatchModeEnabled() const;
+    // Smaller folders keep per-file tasks (own progress and prompts).
+    static constexpr int kArchiveBatchMinFiles = 16;
     void activateScpTransferModeUi(bool enabled);
     void applyPreferences();
     // Remote state (a single active session)
@@ -244,13 +260,36 @@ class MainWindow : public QMainWindow {
                              bool deleteSource, int skippedCount = 0);
     struct RemoteDownloadSeed {
         QString remotePath;
-        QString localPath;
+        QString localPath; // with `peer`: the path on that server
         bool isDir = false;
     };
-    void runRemoteDownloadPrescan(const QVector<RemoteDownloadSeed> &seeds,
-                                  int initialSkipped, bool dragAndDrop);
+    // Queue downloads of the seeds, walking remote folders off the UI
+    // thread. With `peer` the files are copied to that server instead
+    // (TransferTask::Type::RemoteCopy).
+    void runRemoteDownloadPrescan(
+        const QVector<RemoteDownloadSeed> &seeds, int initialSkipped,
+        bool dragAndDrop,
+        std::shared_ptr<const openscp::SessionOptions> peer = {});
+    // Upload dropped local files and folders to `remoteBase`; the folders
+    // are walked off the UI thread and queued batch by batch.
+    void runLocalUploadPrescan(const QStringList &paths,
+                               const QString &remoteBase);
+    // Folder sync between the left (local) and right (remote) folders:
+    // scan off the UI thread, diff against the pair's snapshot index and
+    // queue only new or changed files (MainWindowSync.cpp).
+    void runFolderSync(bool upload);
+    void startFolderSyncTransfers(bool upload, const QString &localRoot,
+                                  const QString &remoteRoot,
+                                  const QString &indexPath,
+                                  std::vector<openscp::SyncEntry> settled,
+                                  std::vector<openscp::SyncEntry> changed);
     void searchItemsInCurrentFolder(QTreeView *view,
                                     const QString &panelLabel);
+    // Recursive remote search below `base` in the background; matches
+    // stream into a non-modal results window (MainWindowRemoteOps.cpp).
+    void startRemoteSearchJob(const QString &panelLabel, const QString &base,
+                              const QRegularExpression &regex,
+                              const openscp::FindOptions &filter);
     void refreshLeftBreadcrumbs();
     void refreshRightBreadcrumbs();
     void rebuildLocalBreadcrumbs(QToolBar *bar, const QString &path,
@@ -260,8 +299,10 @@ class MainWindow : public QMainWindow {
     void saveMainWindowUiState() const;
     void saveRightHeaderState(bool remoteMode) const;
     bool restoreRightHeaderState(bool remoteMode);
-    void maybeRefreshRemoteAfterCompletedUploads();
-    void maybeNotifyCompletedTransfers();
+    void onTransferTasksChanged();
+    void maybeRefreshRemoteAfterCompletedUploads(
+        const QVector<TransferTask> &completed);
+    void maybeNotifyCompletedTransfers(const QVector<TransferTask> &completed);
     bool isLikelyRemoteTransportError(const QString &rawError) const;
     bool reconnectActiveRemoteSession(QString *errorOut = nullptr);
     bool maybeRecoverRemoteSession(const QString &operationLabel,
@@ -271,11 +312,27 @@ class MainWindow : public QMainWindow {
         const std::function<bool(openscp::SftpClient *, std::string &)>
             &operation,
         std::string &err);
+    // Run `operation` on the remote I/O executor instead of blocking the
+    // UI; `done` runs on the UI thread unless the session changed
+    // meanwhile. Falls back to executeCriticalRemoteOperation() when no
+    // second session can be opened.
+    void runRemoteOperationAsync(
+        const QString &operationLabel,
+        std::function<bool(openscp::SftpClient *, std::string &)> operation,
+        std::function<void(bool ok, const std::string &err)> done);
+    void resetRemoteExecutor();
     void ensureRemoteSessionHealthMonitoring();
     void startRemoteSessionHealthMonitoring();
     void stopRemoteSessionHealthMonitoring();
     void runRemoteSessionHealthCheck(const QString &reason,
                                      bool force = false);
+    // Health check by stat() on the UI thread, through the recovery path.
+    void checkRemoteSessionWithStat(const QString &reason, bool force);
+    // Health check by SftpClient::ping() on a helper thread; feeds the RTT
+    // to the status bar and the transfer queue.
+    void startRemoteSessionPing(const QString &reason, bool force);
+    // Wait for a ping in flight, cutting it short; before sftp_ goes away.
+    void finishRemoteSessionPing();
     QString preferredLocalHomePath() const;
 
     // Writable state of the current remote directory
@@ -284,21 +341,33 @@ class MainWindow : public QMainWindow {
         bool writable = false;
         qint64 checkedAtMs = 0;
     };
-    // Recompute if the current remote directory is writable (create/remove a
-    // temporary folder)
+    // Recompute if the current remote directory is writable: from its mode
+    // bits when they decide it, else by creating/removing a temporary
+    // folder. Runs on an idle pooled transfer session when there is one.
     void updateRemoteWriteability();
     void applyRemoteWriteabilityActions();
     void cacheCurrentRemoteWriteability(bool writable);
     void invalidateRemoteWriteabilityFromError(const QString &rawError);
+    // Recursive chmod of `path` in the background.
+    void startRemoteChmodJob(const QString &path, unsigned int mode);
+    // Ask for and apply new permissions once the item's mode is known.
+    void applyRemotePermissions(const QString &base, const QString &path,
+                                const openscp::FileInfo &st);
+    void refreshRemoteFolderAfterChange(const QString &base);
     QHash<QString, RemoteWriteabilityCacheEntry> m_remoteWriteabilityCache_;
     int m_remoteWriteabilityTtlMs_ = 15000;
     std::atomic<quint64> m_remoteWriteabilityProbeSeq_{0};
+    // Uid the server runs this session as, learned from the owner of a
+    // probe folder; lets later checks decide from mode bits alone.
+    std::optional<std::uint32_t> m_remoteSessionUid_;
 
     bool firstShow_ = true;
     bool m_restoredWindowGeometry_ = false;
     bool m_pendingRemoteRefreshFromUpload_ = false;
-    QSet<quint64> m_seenCompletedUploadTaskIds_;
-    QSet<quint64> m_seenCompletedTransferNoticeTaskIds_;
+    // Queue change-log position and tasks already seen finished, so a
+    // completion is handled once without scanning the whole queue.
+    quint64 m_transferChangeVersion_ = 0;
+    QSet<quint64> m_seenCompletedTaskIds_;
 
     // User preferences
     bool prefShowHidden_ = false;
@@ -330,7 +399,17 @@ class MainWindow : public QMainWindow {
     QString m_activeConnectionType_;
     qint64 m_lastAppInactiveAtMs_ = 0;
     std::atomic<bool> m_remoteSessionHealthProbeInFlight_{false};
+    std::thread m_remoteSessionPingThread_;
+    std::atomic<bool> m_remoteSessionPingRunning_{false};
+    int m_remoteSessionRttMs_ = -1; // last measured; -1 = unknown
     std::atomic<bool> m_remoteSessionReconnectInFlight_{false};
+    // Serves runRemoteOperationAsync(); reset with the session.
+    std::unique_ptr<openscp::SessionExecutor> m_remoteExecutor_;
+    quint64 m_remoteExecutorSeq_ = 0;
+    // Bumped on every connect and disconnect; background scans drop their
+    // results once it moves on.
+    quint64 m_remoteSessionSeq_ = 0;
+    bool m_remoteExecutorUnavailable_ = false; // its session failed to open
     int m_remoteSessionHealthIntervalMs_ = 10 * 60 * 1000;
     // Connection progress dialog (non-modal), to avoid blocking TOFU
     QPointer<class QProgressDialog> m_connectProgress_;
@@ -4,10 +4,13 @@
 #include "RemoteModel.hpp"
 #include "SecretStore.hpp"
 #include "SiteManagerDialog.hpp"
+#include "SiteStore.hpp"
 #include "TransferManager.hpp"
 #include "UiAlerts.hpp"
+#include "openscp/CachingSftpClient.hpp"
 #include "openscp/ClientFactory.hpp"
 #include "openscp/RuntimeLogging.hpp"
+#include "openscp/SessionExecutor.hpp"
 
 #include <QAbstractButton>
 #include <QApplication>
@@ -22,7 +25,6 @@
 #include <QLocale>
 #include <QMessageBox>
 #include <QProgressDialog>
-#include <QSet>
 #include <QSettings>
 #include <QStringList>
 #include <QStandardPaths>
@@ -36,6 +38,9 @@
 #include <memory>
 #include <thread>
 
+// Health check cadence for sessions that support SftpClient::ping().
+static constexpr int kRemoteSessionPingIntervalMs = 30000;
+
 // Best-effort memory scrubbing helpers for sensitive data
 static inline void secureClear(QString &s) {
     for (int i = 0, n = s.size(); i < n; ++i)
@@ -52,6 +57,17 @@ static inline void secureClear(QByteArray &b) {
     b.squeeze();
 }
 
+// Report what a panel-side client changes to the transfer workers'
+// destination prechecks; their own changes they note themselves.
+static void followPanelChanges(openscp::SftpClient *client,
+                               std::shared_ptr<openscp::PrecheckCache> cache) {
+    auto *caching = dynamic_cast<openscp::CachingSftpClient *>(client);
+    if (!caching || !cache)
+        return;
+    caching->setMutationHook(
+        [cache](const std::string &path) { cache->invalidate(path); });
+}
+
 static QString shortRemoteError(const QString &raw, const QString &fallback) {
     QString msg = raw.trimmed();
     if (msg.isEmpty())
@@ -130,18 +146,6 @@ static openscp::ScpTransferMode normalizedIdentityScpMode(
     return opt.scp_transfer_mode;
 }
 
-static openscp::ScpTransferMode
-loadDefaultScpTransferModeFromSettings(const QSettings &s) {
-    return openscp::scpTransferModeFromStorageName(
-        s.value("Protocol/scpTransferModeDefault",
-                QString::fromLatin1(openscp::scpTransferModeStorageName(
-                    openscp::ScpTransferMode::Auto)))
-            .toString()
-            .trimmed()
-            .toLower()
-            .toStdString());
-}
-
 static QString normalizedIdentityProxyHost(const std::string &host) {
     return QString::fromStdString(host).trimmed().toLower();
 }
@@ -167,12 +171,6 @@ static QString normalizedIdentityJumpUser(
     return QString::fromStdString(*user).trimmed();
 }
 
-static std::uint16_t defaultJumpPort() { return 22; }
-
-static std::uint16_t defaultProxyPort(openscp::ProxyType type) {
-    return openscp::defaultPortForProxyType(type);
-}
-
 static QString protocolDisplayLabel(openscp::Protocol protocol) {
     return QString::fromLatin1(openscp::protocolDisplayName(protocol));
 }
@@ -249,200 +247,6 @@ static QString quickSiteSecretKey(const SiteEntry &e, const QString &item) {
     return QString("site:%1:%2").arg(e.name, item);
 }
 
-static QVector<SiteEntry> loadSavedSitesForQuickConnect(bool *needsSave) {
-    QVector<SiteEntry> sites;
-    bool shouldSave = false;
-    QSettings s("OpenSCP", "OpenSCP");
-    const auto defaultScpMode = loadDefaultScpTransferModeFromSettings(s);
-    const bool defaultFtpsVerifyPeer =
-        s.value("Security/ftpsVerifyPeerDefault", true).toBool();
-    const QString defaultFtpsCaPath =
-        s.value("Security/ftpsCaCertPathDefault", QString())
-            .toString()
-            .trimmed();
-    const int n = s.beginReadArray("sites");
-    QSet<QString> usedIds;
-    for (int i = 0; i < n; ++i) {
-        s.setArrayIndex(i);
-        SiteEntry e;
-        e.id = s.value("id").toString().trimmed();
-        if (e.id.isEmpty() || usedIds.contains(e.id)) {
-            e.id = newQuickSiteId();
-            shouldSave = true;
-        }
-        usedIds.insert(e.id);
-        e.name = s.value("name").toString().trimmed();
-        e.opt.protocol = openscp::protocolFromStorageName(
-            s.value("protocol",
-                    QString::fromLatin1(
-                        openscp::protocolStorageName(openscp::Protocol::Sftp)))
-                .toString()
-                .trimmed()
-                .toLower()
-                .toStdString());
-        const bool hasScpTransferModeKey = s.contains("scpTransferMode");
-        e.opt.scp_transfer_mode = openscp::scpTransferModeFromStorageName(
-            s.value("scpTransferMode",
-                    QString::fromLatin1(openscp::scpTransferModeStorageName(
-                        defaultScpMode)))
-                .toString()
-                .trimmed()
-                .toLower()
-                .toStdString());
-        if (!hasScpTransferModeKey)
-            shouldSave = true;
-        e.opt.host = s.value("host").toString().toStdString();
-        e.opt.port = static_cast<std::uint16_t>(
-            s.value("port",
-                    static_cast<int>(
-                        openscp::defaultPortForProtocol(e.opt.protocol)))
-                .toUInt());
-        const bool hasWebDavSchemeKey = s.contains("webdavScheme");
-        if (hasWebDavSchemeKey) {
-            e.opt.webdav_scheme = openscp::webDavSchemeFromStorageName(
-                s.value("webdavScheme",
-                        QString::fromLatin1(openscp::webDavSchemeStorageName(
-                            openscp::WebDavScheme::Https)))
-                    .toString()
-                    .trimmed()
-                    .toLower()
-                    .toStdString());
-        } else if (e.opt.protocol == openscp::Protocol::WebDav &&
-                   e.opt.port ==
-                       openscp::defaultPortForWebDavScheme(
-                           openscp::WebDavScheme::Http)) {
-            e.opt.webdav_scheme = openscp::WebDavScheme::Http;
-            shouldSave = true;
-        }
-        e.opt.username = s.value("user").toString().toStdString();
-        const QString kp = s.value("keyPath").toString();
-        if (!kp.isEmpty())
-            e.opt.private_key_path = kp.toStdString();
-        e.opt.proxy_type = openscp::proxyTypeFromStorageValue(
-            s.value("proxyType", static_cast<int>(openscp::ProxyType::None))
-                .toInt());
-        e.opt.proxy_host = s.value("proxyHost").toString().trimmed().toStdString();
-        e.opt.proxy_port = static_cast<std::uint16_t>(
-            s.value("proxyPort", static_cast<int>(defaultProxyPort(e.opt.proxy_type)))
-                .toUInt());
-        const QString proxyUser = s.value("proxyUser").toString().trimmed();
-        if (!proxyUser.isEmpty())
-            e.opt.proxy_username = proxyUser.toStdString();
-        const QString jumpHost = s.value("jumpHost").toString().trimmed();
-        if (!jumpHost.isEmpty())
-            e.opt.jump_host = jumpHost.toStdString();
-        e.opt.jump_port = static_cast<std::uint16_t>(
-            s.value("jumpPort", static_cast<int>(defaultJumpPort())).toUInt());
-        const QString jumpUser = s.value("jumpUser").toString().trimmed();
-        if (!jumpUser.isEmpty())
-            e.opt.jump_username = jumpUser.toStdString();
-        const QString jumpKeyPath = s.value("jumpKeyPath").toString();
-        if (!jumpKeyPath.isEmpty())
-            e.opt.jump_private_key_path = jumpKeyPath.toStdString();
-        const QString kh = s.value("knownHosts").toString();
-        if (!kh.isEmpty())
-            e.opt.known_hosts_path = kh.toStdString();
-        e.opt.known_hosts_policy = static_cast<openscp::KnownHostsPolicy>(
-            s.value("khPolicy",
-                    static_cast<int>(openscp::KnownHostsPolicy::Strict))
-                .toInt());
-        e.opt.transfer_integrity_policy =
-            static_cast<openscp::TransferIntegrityPolicy>(
-                s.value("integrityPolicy",
-                        static_cast<int>(
-                            openscp::TransferIntegrityPolicy::Optional))
-                    .toInt());
-        e.opt.ftps_verify_peer =
-            s.value("ftpsVerifyPeer", defaultFtpsVerifyPeer).toBool();
-        const QString ftpsCaPath =
-            s.value("ftpsCaCertPath", defaultFtpsCaPath).toString().trimmed();
-        if (!ftpsCaPath.isEmpty())
-            e.opt.ftps_ca_cert_path = ftpsCaPath.toStdString();
-        e.opt.webdav_verify_peer =
-            s.value("webdavVerifyPeer", true).toBool();
-        const QString webDavCaPath =
-            s.value("webdavCaCertPath", QString()).toString().trimmed();
-        if (!webDavCaPath.isEmpty())
-            e.opt.webdav_ca_cert_path = webDavCaPath.toStdString();
-        if (e.opt.protocol == openscp::Protocol::WebDav &&
-            e.opt.webdav_scheme == openscp::WebDavScheme::Http) {
-            e.opt.webdav_verify_peer = false;
-            e.opt.webdav_ca_cert_path.reset();
-        }
-        sites.push_back(e);
-    }
-    s.endArray();
-    if (needsSave)
-        *needsSave = shouldSave;
-    return sites;
-}
-
-static void saveSavedSitesForQuickConnect(const QVector<SiteEntry> &sites) {
-    QSettings s("OpenSCP", "OpenSCP");
-    s.remove("sites");
-    s.beginWriteArray("sites");
-    for (int i = 0; i < sites.size(); ++i) {
-        s.setArrayIndex(i);
-        const SiteEntry &e = sites[i];
-        s.setValue("id", e.id);
-        s.setValue("name", e.name);
-        s.setValue("protocol",
-                   QString::fromLatin1(
-                       openscp::protocolStorageName(e.opt.protocol)));
-        s.setValue("scpTransferMode",
-                   QString::fromLatin1(openscp::scpTransferModeStorageName(
-                       e.opt.scp_transfer_mode)));
-        s.setValue("host", QString::fromStdString(e.opt.host));
-        s.setValue("port", static_cast<int>(e.opt.port));
-        s.setValue("webdavScheme",
-                   QString::fromLatin1(openscp::webDavSchemeStorageName(
-                       e.opt.webdav_scheme)));
-        s.setValue("user", QString::fromStdString(e.opt.username));
-        s.setValue("keyPath",
-                   e.opt.private_key_path
-                       ? QString::fromStdString(*e.opt.private_key_path)
-                       : QString());
-        s.setValue("proxyType", static_cast<int>(e.opt.proxy_type));
-        s.setValue("proxyHost", QString::fromStdString(e.opt.proxy_host));
-        s.setValue("proxyPort", static_cast<int>(e.opt.proxy_port));
-        s.setValue("proxyUser",
-                   e.opt.proxy_username
-                       ? QString::fromStdString(*e.opt.proxy_username)
-                       : QString());
-        s.setValue("jumpHost",
-                   e.opt.jump_host ? QString::fromStdString(*e.opt.jump_host)
-                                   : QString());
-        s.setValue("jumpPort", static_cast<int>(e.opt.jump_port));
-        s.setValue("jumpUser",
-                   e.opt.jump_username
-                       ? QString::fromStdString(*e.opt.jump_username)
-                       : QString());
-        s.setValue("jumpKeyPath",
-                   e.opt.jump_private_key_path
-                       ? QString::fromStdString(*e.opt.jump_private_key_path)
-                       : QString());
-        s.setValue("knownHosts",
-                   e.opt.known_hosts_path
-                       ? QString::fromStdString(*e.opt.known_hosts_path)
-                       : QString());
-        s.setValue("khPolicy", static_cast<int>(e.opt.known_hosts_policy));
-        s.setValue("integrityPolicy",
-                   static_cast<int>(e.opt.transfer_integrity_policy));
-        s.setValue("ftpsVerifyPeer", e.opt.ftps_verify_peer);
-        s.setValue("ftpsCaCertPath",
-                   e.opt.ftps_ca_cert_path
-                       ? QString::fromStdString(*e.opt.ftps_ca_cert_path)
-                       : QString());
-        s.setValue("webdavVerifyPeer", e.opt.webdav_verify_peer);
-        s.setValue("webdavCaCertPath",
-                   e.opt.webdav_ca_cert_path
-                       ? QString::fromStdString(*e.opt.webdav_ca_cert_path)
-                       : QString());
-    }
-    s.endArray();
-    s.sync();
-}
-
 static QString defaultQuickSiteName(const openscp::SessionOptions &opt) {
     const QString user = normalizedIdentityUser(opt.username);
     const QString host = normalizedIdentityHost(opt.host);
@@ -586,6 +390,7 @@ bool MainWindow::reconnectActiveRemoteSession(QString *errorOut) {
         return false;
     }
 
+    finishRemoteSessionPing();
     sftp_->disconnect();
     sftp_ = std::move(replacement);
     applyRemoteConnectedUI(*m_activeSessionOptions_);
@@ -669,6 +474,95 @@ bool MainWindow::executeCriticalRemoteOperation(
     return operation(sftp_.get(), err);
 }
 
+void MainWindow::runRemoteOperationAsync(
+    const QString &operationLabel,
+    std::function<bool(openscp::SftpClient *, std::string &)> operation,
+    std::function<void(bool ok, const std::string &err)> done) {
+    if (!rightIsRemote_ || !sftp_ || !m_activeSessionOptions_.has_value() ||
+        m_remoteExecutorUnavailable_) {
+        std::string err;
+        const bool ok =
+            executeCriticalRemoteOperation(operationLabel, operation, err);
+        if (done)
+            done(ok, err);
+        return;
+    }
+    if (!m_remoteExecutor_) {
+        // Shares the panel's listing cache, so what it changes is listed
+        // fresh; it must not depend on sftp_, which a reconnect replaces.
+        std::shared_ptr<openscp::ListingCache> cache;
+        if (auto *caching =
+                dynamic_cast<openscp::CachingSftpClient *>(sftp_.get()))
+            cache = caching->cache();
+        std::shared_ptr<openscp::PrecheckCache> precheck =
+            transferMgr_ ? transferMgr_->precheckCache() : nullptr;
+        const openscp::SessionOptions opt = *m_activeSessionOptions_;
+        m_remoteExecutor_ = std::make_unique<openscp::SessionExecutor>(
+            [opt, cache, precheck](
+                std::string &err) -> std::unique_ptr<openscp::SftpClient> {
+                auto client = openscp::CreateConnectedClient(opt, err);
+                if (!client || !cache)
+                    return client;
+                auto caching = std::make_unique<openscp::CachingSftpClient>(
+                    std::move(client), cache);
+                followPanelChanges(caching.get(), precheck);
+                return caching;
+            });
+    }
+
+    QPointer<MainWindow> self(this);
+    const quint64 seq = m_remoteExecutorSeq_;
+    // Written and read on the executor thread only.
+    auto started = std::make_shared<bool>(false);
+    m_remoteExecutor_->submit<bool>(
+        [operation, started](openscp::SftpClient &client, bool &,
+                             std::string &err) {
+            *started = true;
+            return operation(&client, err);
+        },
+        [self, seq, started, operationLabel, operation,
+         done = std::move(done)](openscp::AsyncResult<bool> r) mutable {
+            QObject *app = QCoreApplication::instance();
+            if (!app)
+                return;
+            const bool ran = *started;
+            QMetaObject::invokeMethod(
+                app,
+                [self, seq, ran, r = std::move(r), operationLabel,
+                 operation = std::move(operation),
+                 done = std::move(done)]() {
+                    if (!self || seq != self->m_remoteExecutorSeq_)
+                        return;
+                    if (!ran) {
+                        // No second session for this server (e.g. it
+                        // limits sessions); use the panel's from now on.
+                        self->m_remoteExecutorUnavailable_ = true;
+                        self->m_remoteExecutor_.reset();
+                        std::string err;
+                        const bool ok = self->executeCriticalRemoteOperation(
+                            operationLabel, operation, err);
+                        if (done)
+                            done(ok, err);
+                        return;
+                    }
+                    if (!r.ok && self->isLikelyRemoteTransportError(
+                                     QString::fromStdString(r.error)))
+                        self->runRemoteSessionHealthCheck(QString(), false);
+                    if (done)
+                        done(r.ok, r.error);
+                },
+                Qt::QueuedConnection);
+        });
+}
+
+void MainWindow::resetRemoteExecutor() {
+    // Queued operations complete with "Session closed"; the sequence drops
+    // their results.
+    m_remoteExecutor_.reset();
+    m_remoteExecutorUnavailable_ = false;
+    ++m_remoteExecutorSeq_;
+}
+
 void MainWindow::ensureRemoteSessionHealthMonitoring() {
     if (m_remoteSessionHealthTimer_)
         return;
@@ -713,7 +607,12 @@ void MainWindow::startRemoteSessionHealthMonitoring() {
         return;
     if (m_remoteSessionHealthIntervalMs_ < 60000)
         m_remoteSessionHealthIntervalMs_ = 60000;
-    m_remoteSessionHealthTimer_->setInterval(m_remoteSessionHealthIntervalMs_);
+    // A ping is one short round trip; checking more often keeps the RTT
+    // seen by the status bar and the transfer queue current.
+    int intervalMs = m_remoteSessionHealthIntervalMs_;
+    if (sftp_->capabilities().supports_ping)
+        intervalMs = qMin(intervalMs, kRemoteSessionPingIntervalMs);
+    m_remoteSessionHealthTimer_->setInterval(intervalMs);
     m_remoteSessionHealthProbeInFlight_.store(false);
     m_lastAppInactiveAtMs_ = 0;
     if (!m_remoteSessionHealthTimer_->isActive())
@@ -738,7 +637,15 @@ void MainWindow::runRemoteSessionHealthCheck(const QString &reason, bool force)
                                                                      true)) {
         return;
     }
+    if (sftp_->capabilities().supports_ping) {
+        startRemoteSessionPing(reason, force);
+        return;
+    }
+    checkRemoteSessionWithStat(reason, force);
+}
 
+void MainWindow::checkRemoteSessionWithStat(const QString &reason,
+                                            bool force) {
     const QString probePath =
         (rightRemoteModel_ && !rightRemoteModel_->rootPath().isEmpty())
             ? rightRemoteModel_->rootPath()
@@ -779,6 +686,64 @@ void MainWindow::runRemoteSessionHealthCheck(const QString &reason, bool force)
     disconnectSftp();
 }
 
+void MainWindow::startRemoteSessionPing(const QString &reason, bool force) {
+    if (m_remoteSessionPingThread_.joinable())
+        m_remoteSessionPingThread_.join();
+    // ping() may run while the UI thread uses the client; it waits for the
+    // running operation instead of queueing a stat behind it.
+    openscp::SftpClient *client = sftp_.get();
+    QPointer<MainWindow> self(this);
+    m_remoteSessionPingRunning_.store(true);
+    // `this` outlives the thread: finishRemoteSessionPing() joins it.
+    m_remoteSessionPingThread_ = std::thread([this, self, client, reason,
+                                              force]() {
+        std::uint32_t rttMs = 0;
+        std::string err;
+        const bool ok = client->ping(rttMs, err);
+        m_remoteSessionPingRunning_.store(false);
+        QObject *app = QCoreApplication::instance();
+        if (!app)
+            return;
+        QMetaObject::invokeMethod(
+            app,
+            [self, client, reason, force, ok, rttMs]() {
+                if (!self)
+                    return;
+                if (self->sftp_.get() != client || !self->rightIsRemote_ ||
+                    self->m_isDisconnecting) {
+                    self->m_remoteSessionHealthProbeInFlight_.store(false);
+                    return;
+                }
+                if (!ok) {
+                    // Confirm with the full check, which can reconnect.
+                    self->checkRemoteSessionWithStat(reason, force);
+                    return;
+                }
+                self->m_remoteSessionHealthProbeInFlight_.store(false);
+                self->m_remoteSessionRttMs_ = static_cast<int>(rttMs);
+                self->updateConnectionSessionIndicators();
+                if (self->transferMgr_)
+                    self->transferMgr_->noteRoundTrip(rttMs);
+                if (force && !reason.isEmpty()) {
+                    self->statusBar()->showMessage(
+                        tr("Remote session validated (%1)").arg(reason), 2500);
+                }
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::finishRemoteSessionPing() {
+    if (!m_remoteSessionPingThread_.joinable())
+        return;
+    // A ping waiting on a dead link would hold the UI here. interrupt()
+    // ends it within one poll slice, also on a multiplexed transport where
+    // the socket itself is left alone.
+    if (m_remoteSessionPingRunning_.load() && sftp_)
+        sftp_->interrupt();
+    m_remoteSessionPingThread_.join();
+}
+
 void MainWindow::openConnectDialogWithPreset(
     const std::optional<openscp::SessionOptions> &preset) {
     ConnectionDialog dlg(this);
@@ -877,8 +842,7 @@ void MainWindow::disconnectSftp() {
     rightIsRemote_ = false;
     activateScpTransferModeUi(false);
     m_pendingRemoteRefreshFromUpload_ = false;
-    m_seenCompletedUploadTaskIds_.clear();
-    m_seenCompletedTransferNoticeTaskIds_.clear();
+    m_seenCompletedTaskIds_.clear();
     restoreRightHeaderState(false);
     if (QDir(rightPath_->text()).exists()) {
         setRightRoot(rightPath_->text());
@@ -888,6 +852,9 @@ void MainWindow::disconnectSftp() {
     rightRemoteWritable_ = false;
     m_remoteWriteabilityCache_.clear();
     ++m_remoteWriteabilityProbeSeq_;
+    m_remoteSessionUid_.reset();
+    resetRemoteExecutor();
+    ++m_remoteSessionSeq_;
     m_activeSessionOptions_.reset();
     m_sessionNoHostVerification_ = false;
     updateHostPolicyRiskBanner();
@@ -985,6 +952,7 @@ void MainWindow::disconnectSftp() {
 void MainWindow::completeDisconnectSftp(quint64 disconnectSeq, bool forced) {
     if (!m_isDisconnecting || disconnectSeq != m_disconnectSeq_)
         return;
+    finishRemoteSessionPing();
     if (sftp_)
         sftp_->disconnect();
     sftp_.reset();
@@ -1672,7 +1640,9 @@ void MainWindow::finalizeSftpConnect(
 
     m_sessionNoHostVerification_ =
         (uiOpt.known_hosts_policy == openscp::KnownHostsPolicy::Off);
-    sftp_ = std::move(guard);
+    // Every connection cloned from this session shares one listing cache.
+    sftp_ = std::make_unique<openscp::CachingSftpClient>(
+        std::move(guard), std::make_shared<openscp::ListingCache>());
     applyRemoteConnectedUI(uiOpt);
     if (rightIsRemote_ && saveRequest.has_value()) {
         maybePersistQuickConnectSite(uiOpt, *saveRequest, true);
@@ -1682,8 +1652,7 @@ void MainWindow::finalizeSftpConnect(
 void MainWindow::maybePersistQuickConnectSite(
     const openscp::SessionOptions &opt, const PendingSiteSaveRequest &req,
     bool connectionEstablished) {
-    bool regeneratedIds = false;
-    QVector<SiteEntry> sites = loadSavedSitesForQuickConnect(&regeneratedIds);
+    QVector<SiteEntry> sites = SiteStore::sites();
 
     int matchIndex = -1;
     for (int i = 0; i < sites.size(); ++i) {
@@ -1709,8 +1678,8 @@ void MainWindow::maybePersistQuickConnectSite(
         created = true;
     }
 
-    if (created || regeneratedIds) {
-        saveSavedSitesForQuickConnect(sites);
+    if (created) {
+        SiteStore::save(sites);
         refreshOpenSiteManagerWidget(m_siteManager);
     }
 
@@ -1802,6 +1771,8 @@ void MainWindow::maybePersistQuickConnectSite(
 // Switch UI into remote mode and wire models/actions for the right pane.
 void MainWindow::applyRemoteConnectedUI(const openscp::SessionOptions &opt) {
     saveRightHeaderState(rightIsRemote_);
+    resetRemoteExecutor();
+    ++m_remoteSessionSeq_;
     if (rightRemoteModel_) {
         rightView_->setModel(rightLocalModel_);
         delete rightRemoteModel_;
@@ -1815,6 +1786,9 @@ void MainWindow::applyRemoteConnectedUI(const openscp::SessionOptions &opt) {
     if (!transferOnlyMode) {
         rightRemoteModel_ = new RemoteModel(sftp_.get(), this);
         rightRemoteModel_->setSessionOptions(opt);
+        if (auto *caching =
+                dynamic_cast<openscp::CachingSftpClient *>(sftp_.get()))
+            rightRemoteModel_->setListingCache(caching->cache());
         rightRemoteModel_->setShowHidden(prefShowHidden_);
         connect(rightRemoteModel_, &RemoteModel::rootPathLoaded, this,
                 [this](const QString &path, bool ok, const QString &error) {
@@ -1924,14 +1898,14 @@ void MainWindow::applyRemoteConnectedUI(const openscp::SessionOptions &opt) {
         rightPath_->setText(rightRemoteModel_->rootPath());
         rightIsRemote_ = true;
         m_pendingRemoteRefreshFromUpload_ = false;
-        m_seenCompletedUploadTaskIds_.clear();
-        m_seenCompletedTransferNoticeTaskIds_.clear();
+        m_seenCompletedTaskIds_.clear();
         refreshRightBreadcrumbs();
         m_activeSessionOptions_ = opt;
         m_remoteWriteabilityCache_.clear();
         if (transferMgr_) {
             transferMgr_->setClient(sftp_.get());
             transferMgr_->setSessionOptions(opt);
+            followPanelChanges(sftp_.get(), transferMgr_->precheckCache());
         }
         if (actConnect_)
             actConnect_->setEnabled(false);
@@ -1966,10 +1940,18 @@ void MainWindow::applyRemoteConnectedUI(const openscp::SessionOptions &opt) {
         }
         const QString activeProtocol = protocolDisplayLabel(opt.protocol);
         startConnectionSessionIndicators(activeProtocol);
-        statusBar()->showMessage(
+        QString connectedMessage =
             tr("Connected (%1) to %2")
-                .arg(activeProtocol, QString::fromStdString(opt.host)),
-            4000);
+                .arg(activeProtocol, QString::fromStdString(opt.host));
+        openscp::SshAlgorithms algos;
+        if (sftp_ && sftp_->negotiatedAlgorithms(algos)) {
+            connectedMessage +=
+                tr(" — %1, %2, compression %3")
+                    .arg(QString::fromStdString(algos.cipher_cs),
+                         QString::fromStdString(algos.mac_cs),
+                         QString::fromStdString(algos.compression_cs));
+        }
+        statusBar()->showMessage(connectedMessage, 4000);
         addRecentServer(opt);
         setWindowTitle(tr("OpenSCP — local/remote (%1)").arg(activeProtocol));
         updateHostPolicyRiskBanner();
@@ -1985,12 +1967,12 @@ void MainWindow::applyRemoteConnectedUI(const openscp::SessionOptions &opt) {
     rightIsRemote_ = true;
     activateScpTransferModeUi(true);
     m_pendingRemoteRefreshFromUpload_ = false;
-    m_seenCompletedUploadTaskIds_.clear();
-    m_seenCompletedTransferNoticeTaskIds_.clear();
+    m_seenCompletedTaskIds_.clear();
     refreshRightBreadcrumbs();
     m_activeSessionOptions_ = opt;
     m_remoteWriteabilityCache_.clear();
     ++m_remoteWriteabilityProbeSeq_;
+    m_remoteSessionUid_.reset();
     rightRemoteWritable_ = false;
     if (transferMgr_) {
         transferMgr_->setClient(sftp_.get());
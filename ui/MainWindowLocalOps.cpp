@@ -24,78 +24,10 @@
 #include <QUrl>
 
 #include <memory>
-#include <thread>
+#include <vector>
 
 static constexpr int NAME_COL = 0;
 
-static bool copyEntryRecursively(const QString &srcPath, const QString &dstPath,
-                                 QString &error) {
-    QFileInfo srcInfo(srcPath);
-
-    if (srcInfo.isFile()) {
-        // Ensure destination directory
-        QDir().mkpath(QFileInfo(dstPath).dir().absolutePath());
-        if (QFile::exists(dstPath))
-            QFile::remove(dstPath);
-        if (!QFile::copy(srcPath, dstPath)) {
-            error = QString(QCoreApplication::translate(
-                                "MainWindow", "Could not copy file: %1"))
-                        .arg(srcPath);
-            return false;
-        }
-        return true;
-    }
-
-    if (srcInfo.isDir()) {
-        // Create destination directory
-        if (!QDir().mkpath(dstPath)) {
-            error = QString(QCoreApplication::translate(
-                                "MainWindow",
-                                "Could not create destination folder: %1"))
-                        .arg(dstPath);
-            return false;
-        }
-        // Iterate recursively
-        QDirIterator it(srcPath, QDir::NoDotAndDotDot | QDir::AllEntries,
-                        QDirIterator::Subdirectories);
-        while (it.hasNext()) {
-            it.next();
-            const QFileInfo fi = it.fileInfo();
-            const QString rel =
-                QDir(srcPath).relativeFilePath(fi.absoluteFilePath());
-            const QString target = QDir(dstPath).filePath(rel);
-
-            if (fi.isDir()) {
-                if (!QDir().mkpath(target)) {
-                    error =
-                        QString(
-                            QCoreApplication::translate(
-                                "MainWindow",
-                                "Could not create destination subfolder: %1"))
-                            .arg(target);
-                    return false;
-                }
-            } else {
-                // Ensure parent directory exists
-                QDir().mkpath(QFileInfo(target).dir().absolutePath());
-                if (QFile::exists(target))
-                    QFile::remove(target);
-                if (!QFile::copy(fi.absoluteFilePath(), target)) {
-                    error = QString(QCoreApplication::translate(
-                                        "MainWindow", "Failed to copy: %1"))
-                                .arg(fi.absoluteFilePath());
-                    return false;
-                }
-            }
-        }
-        return true;
-    }
-
-    error = QCoreApplication::translate(
-        "MainWindow", "Source entry is neither file nor folder.");
-    return false;
-}
-
 static void revealInFolder(const QString &filePath) {
 #if defined(Q_OS_MAC)
     // macOS: use 'open -R' to reveal in Finder
@@ -254,92 +186,63 @@ void MainWindow::runLocalFsOperation(const QVector<LocalFsPair> &pairs,
                      : tr("Copying selected items..."),
         1500);
 
+    // Copied by the transfer manager in parallel (reflink or in-kernel
+    // copies where possible) so the run shows its progress in the queue.
+    std::vector<openscp::LocalCopyItem> items;
+    items.reserve(static_cast<std::size_t>(pairs.size()));
+    for (const auto &pair : pairs)
+        items.push_back({pair.sourcePath.toStdString(),
+                         pair.targetPath.toStdString()});
+
     QPointer<MainWindow> self(this);
-    std::thread([self, pairs, deleteSource, skippedCount]() {
-        int ok = 0;
-        int fail = 0;
-        QString lastError;
-
-        for (const auto &pair : pairs) {
-            QString err;
-            if (copyEntryRecursively(pair.sourcePath, pair.targetPath, err)) {
-                if (deleteSource) {
-                    const QFileInfo srcInfo(pair.sourcePath);
-                    const bool removed =
-                        srcInfo.isDir()
-                            ? QDir(pair.sourcePath).removeRecursively()
-                            : QFile::remove(pair.sourcePath);
-                    if (removed || !QFileInfo::exists(pair.sourcePath)) {
-                        ++ok;
-                    } else {
-                        ++fail;
-                        lastError =
-                            QString(QCoreApplication::translate(
-                                        "MainWindow",
-                                        "Could not delete source: %1"))
-                                .arg(pair.sourcePath);
-                    }
-                } else {
+    transferMgr_->startLocalCopy(
+        std::move(items), deleteSource,
+        [self, skippedCount,
+         deleteSource](const std::vector<openscp::LocalCopyOutcome> &out) {
+            if (!self)
+                return;
+
+            --self->m_localFsJobsInFlight_;
+
+            int ok = 0;
+            int fail = 0;
+            QString lastError;
+            for (const auto &outcome : out) {
+                if (outcome.ok) {
                     ++ok;
+                } else {
+                    ++fail;
+                    lastError = QString::fromStdString(outcome.error);
                 }
-            } else {
-                ++fail;
-                lastError = err;
             }
-        }
 
-        QObject *const app = QCoreApplication::instance();
-        if (!app)
-            return;
-        QMetaObject::invokeMethod(
-            app, [self, ok, fail, skippedCount, lastError, deleteSource]() {
-                if (!self)
-                    return;
-
-                --self->m_localFsJobsInFlight_;
-
-                QString msg;
-                if (deleteSource) {
-                    msg = QString(
-                              QCoreApplication::translate(
-                                  "MainWindow",
-                                  "Moved OK: %1  |  Failed: %2  |  "
-                                  "Skipped: %3"))
-                              .arg(ok)
-                              .arg(fail)
-                              .arg(skippedCount);
-                } else if (skippedCount > 0) {
-                    msg = QString(
-                              QCoreApplication::translate(
-                                  "MainWindow",
-                                  "Copied: %1  |  Failed: %2  |  "
-                                  "Skipped: %3"))
-                              .arg(ok)
-                              .arg(fail)
-                              .arg(skippedCount);
-                } else {
-                    msg = QString(QCoreApplication::translate(
-                                      "MainWindow",
-                                      "Copied: %1  |  Failed: %2"))
-                              .arg(ok)
-                              .arg(fail);
-                }
-                if (fail > 0 && !lastError.isEmpty()) {
-                    msg += "\n" +
-                           QCoreApplication::translate("MainWindow",
-                                                       "Last error: ") +
-                           lastError;
-                }
-                self->statusBar()->showMessage(msg, 6000);
+            QString msg;
+            if (deleteSource) {
+                msg = QString(tr("Moved OK: %1  |  Failed: %2  |  "
+                                 "Skipped: %3"))
+                          .arg(ok)
+                          .arg(fail)
+                          .arg(skippedCount);
+            } else if (skippedCount > 0) {
+                msg = QString(tr("Copied: %1  |  Failed: %2  |  Skipped: %3"))
+                          .arg(ok)
+                          .arg(fail)
+                          .arg(skippedCount);
+            } else {
+                msg = QString(tr("Copied: %1  |  Failed: %2"))
+                          .arg(ok)
+                          .arg(fail);
+            }
+            if (fail > 0 && !lastError.isEmpty())
+                msg += "\n" + tr("Last error: ") + lastError;
+            self->statusBar()->showMessage(msg, 6000);
 
-                self->setLeftRoot(self->leftPath_->text());
-                if (!self->rightIsRemote_) {
-                    self->setRightRoot(self->rightPath_->text());
-                }
-                self->updateDeleteShortcutEnables();
-            },
-            Qt::QueuedConnection);
-    }).detach();
+            self->setLeftRoot(self->leftPath_->text());
+            if (!self->rightIsRemote_) {
+                self->setRightRoot(self->rightPath_->text());
+            }
+            self->updateDeleteShortcutEnables();
+        });
 }
 
 void MainWindow::copyLeftToRight() {
@@ -382,12 +285,18 @@ void MainWindow::copyLeftToRight() {
         for (const QModelIndex &idx : rows) {
             const QFileInfo fi = leftModel_->fileInfo(idx);
             if (fi.isDir()) {
-                if (scpMode) {
+                // The archive batch creates remote folders itself, so it
+                // also covers folders in transfer-only (SCP) mode.
+                const bool batchMode = archiveBatchModeEnabled();
+                if (scpMode && !batchMode) {
                     ++skippedDirs;
                     continue;
                 }
                 const QString remoteDirBase =
                     joinRemotePath(remoteBase, fi.fileName());
+                QVector<QPair<QString, QString>> files; // local, relative
+                QVector<TransferRequest> requests;
+                quint64 totalBytes = 0;
                 QDirIterator it(fi.absoluteFilePath(),
                                 QDir::NoDotAndDotDot | QDir::AllEntries,
                                 QDirIterator::Subdirectories);
@@ -399,11 +308,30 @@ void MainWindow::copyLeftToRight() {
                     const QString rel =
                         QDir(fi.absoluteFilePath())
                             .relativeFilePath(sfi.absoluteFilePath());
-                    const QString rTarget = joinRemotePath(remoteDirBase, rel);
-                    transferMgr_->enqueueUpload(sfi.absoluteFilePath(),
-                                                rTarget);
-                    ++enq;
+                    files.push_back({sfi.absoluteFilePath(), rel});
+                    totalBytes += static_cast<quint64>(sfi.size());
+                    TransferRequest r;
+                    r.type = TransferTask::Type::Upload;
+                    r.src = sfi.absoluteFilePath();
+                    r.dst = joinRemotePath(remoteDirBase, rel);
+                    r.sizeHint = static_cast<quint64>(sfi.size());
+                    requests.push_back(std::move(r));
+                }
+                if (batchMode && !files.isEmpty() &&
+                    (scpMode || files.size() >= kArchiveBatchMinFiles)) {
+                    std::vector<std::string> rels;
+                    rels.reserve(files.size());
+                    for (const auto &f : files)
+                        rels.push_back(f.second.toStdString());
+                    transferMgr_->enqueueUploadBatch(fi.absoluteFilePath(),
+                                                     std::move(rels),
+                                                     remoteDirBase,
+                                                     totalBytes);
+                    enq += static_cast<int>(files.size());
+                    continue;
                 }
+                transferMgr_->enqueueMany(requests);
+                enq += static_cast<int>(requests.size());
             } else {
                 const QString rTarget =
                     joinRemotePath(remoteBase, fi.fileName());
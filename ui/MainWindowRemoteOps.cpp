@@ -1,38 +1,61 @@
 // MainWindow remote-side operations and writeability state.
 #include "MainWindow.hpp"
 #include "PermissionsDialog.hpp"
+#include "RemoteFileViewerDialog.hpp"
 #include "RemoteModel.hpp"
+#include "SiteManagerDialog.hpp"
 #include "TransferManager.hpp"
 #include "UiAlerts.hpp"
 #include "openscp/ClientFactory.hpp"
+#include "openscp/RemoteAccess.hpp"
+#include "openscp/RemoteChmod.hpp"
+#include "openscp/RemoteDelete.hpp"
+#include "openscp/RemoteFind.hpp"
 
 #include <QCoreApplication>
 #include <QDateTime>
+#include <QDialog>
+#include <QDialogButtonBox>
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFrame>
 #include <QInputDialog>
+#include <QLabel>
 #include <QLineEdit>
 #include <QListView>
+#include <QListWidget>
 #include <QMenu>
 #include <QMessageBox>
 #include <QPointer>
 #include <QProcess>
+#include <QProgressDialog>
+#include <QPushButton>
+#include <QRegularExpression>
 #include <QSet>
 #include <QSettings>
 #include <QStandardPaths>
 #include <QStatusBar>
 #include <QTemporaryFile>
 #include <QTreeView>
+#include <QVBoxLayout>
 
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <string>
 #include <thread>
 #include <vector>
 
 static constexpr int NAME_COL = 0;
+// Sessions used by one recursive remote delete, permission change or
+// search walk.
+static constexpr int kRemoteTreeJobSessions = 4;
+// Matches one recursive remote search keeps before it stops.
+static constexpr std::size_t kRemoteSearchMaxMatches = 100000;
 
 static QString tempDownloadPathFor(const QString &remoteName) {
     QString base =
@@ -852,6 +875,8 @@ void MainWindow::refreshRightRemotePanel() {
         return;
     }
 
+    // An explicit refresh always asks the server.
+    rightRemoteModel_->invalidateCachedListing(rightRemoteModel_->rootPath());
     QString e;
     if (!rightRemoteModel_->setRootPath(rightRemoteModel_->rootPath(), &e,
                                         true)) {
@@ -1056,6 +1081,9 @@ void MainWindow::downloadRightToLeft() {
         rpath += name;
         const QString lpath = dst.filePath(name);
         if (rightRemoteModel_->isDir(idx)) {
+            QVector<QPair<QString, QString>> files; // remote, local
+            std::vector<std::string> rels;
+            quint64 totalBytes = 0;
             QVector<QPair<QString, QString>> stack;
             stack.push_back({rpath, lpath});
             while (!stack.isEmpty()) {
@@ -1079,14 +1107,34 @@ void MainWindow::downloadRightToLeft() {
                         (curR.endsWith('/') ? curR + ename
                                             : curR + "/" + ename);
                     const QString childL = QDir(curL).filePath(ename);
-                    if (e.is_dir)
+                    if (e.is_dir) {
                         stack.push_back({childR, childL});
-                    else {
-                        transferMgr_->enqueueDownload(childR, childL);
-                        ++enq;
+                    } else {
+                        files.push_back({childR, childL});
+                        rels.push_back(
+                            childR.mid(rpath.size() + 1).toStdString());
+                        totalBytes += e.size;
                     }
                 }
             }
+            if (files.size() >= kArchiveBatchMinFiles &&
+                archiveBatchModeEnabled()) {
+                transferMgr_->enqueueDownloadBatch(rpath, std::move(rels),
+                                                   lpath, totalBytes);
+                enq += static_cast<int>(files.size());
+            } else {
+                QVector<TransferRequest> requests;
+                requests.reserve(files.size());
+                for (const auto &f : files) {
+                    TransferRequest r;
+                    r.type = TransferTask::Type::Download;
+                    r.src = f.first;
+                    r.dst = f.second;
+                    requests.push_back(std::move(r));
+                }
+                transferMgr_->enqueueMany(requests);
+                enq += static_cast<int>(requests.size());
+            }
         } else {
             transferMgr_->enqueueDownload(rpath, lpath);
             ++enq;
@@ -1317,10 +1365,17 @@ void MainWindow::moveRightToLeft() {
             pairs.push_back({rpath, lpath});
         }
     }
+    QVector<TransferRequest> requests;
+    requests.reserve(pairs.size());
     for (const auto &p : pairs) {
-        transferMgr_->enqueueDownload(p.first, p.second);
-        ++enq;
-    }
+        TransferRequest r;
+        r.type = TransferTask::Type::Download;
+        r.src = p.first;
+        r.dst = p.second;
+        requests.push_back(std::move(r));
+    }
+    transferMgr_->enqueueMany(requests);
+    enq += static_cast<int>(requests.size());
     if (enq > 0) {
         QString msg = QString(tr("Queued: %1 downloads (move)")).arg(enq);
         if (bad > 0)
@@ -1591,26 +1646,25 @@ void MainWindow::newDirRight() {
     if (rightIsRemote_) {
         if (!sftp_ || !rightRemoteModel_)
             return;
-        const QString path =
-            joinRemotePath(rightRemoteModel_->rootPath(), name);
-        std::string err;
-        const bool okMkdir = executeCriticalRemoteOperation(
+        const QString base = rightRemoteModel_->rootPath();
+        const QString path = joinRemotePath(base, name);
+        runRemoteOperationAsync(
             tr("create a remote folder"),
             [path](openscp::SftpClient *client, std::string &opErr) {
                 return client->mkdir(path.toStdString(), opErr, 0755);
             },
-            err);
-        if (!okMkdir) {
-            invalidateRemoteWriteabilityFromError(QString::fromStdString(err));
-            UiAlerts::critical(
-                this, tr("Remote"),
-                tr("Could not create the remote folder.\n%1")
-                    .arg(shortRemoteError(err, tr("Remote error"))));
-            return;
-        }
-        QString dummy;
-        rightRemoteModel_->setRootPath(rightRemoteModel_->rootPath(), &dummy);
-        cacheCurrentRemoteWriteability(true);
+            [this, base](bool okMkdir, const std::string &err) {
+                if (!okMkdir) {
+                    invalidateRemoteWriteabilityFromError(
+                        QString::fromStdString(err));
+                    UiAlerts::critical(
+                        this, tr("Remote"),
+                        tr("Could not create the remote folder.\n%1")
+                            .arg(shortRemoteError(err, tr("Remote error"))));
+                    return;
+                }
+                refreshRemoteFolderAfterChange(base);
+            });
     } else {
         QDir base(rightPath_->text());
         if (!base.mkpath(base.filePath(name))) {
@@ -1743,25 +1797,24 @@ void MainWindow::renameRightSelected() {
         const QString base = rightRemoteModel_->rootPath();
         const QString from = joinRemotePath(base, oldName);
         const QString to = joinRemotePath(base, newName);
-        std::string err;
-        const bool okRename = executeCriticalRemoteOperation(
+        runRemoteOperationAsync(
             tr("rename a remote item"),
             [from, to](openscp::SftpClient *client, std::string &opErr) {
                 return client->rename(from.toStdString(), to.toStdString(),
                                       opErr, false);
             },
-            err);
-        if (!okRename) {
-            invalidateRemoteWriteabilityFromError(QString::fromStdString(err));
-            UiAlerts::critical(
-                this, tr("Remote"),
-                tr("Could not rename the remote item.\n%1")
-                    .arg(shortRemoteError(err, tr("Remote error"))));
-            return;
-        }
-        QString dummy;
-        rightRemoteModel_->setRootPath(base, &dummy);
-        cacheCurrentRemoteWriteability(true);
+            [this, base](bool okRename, const std::string &err) {
+                if (!okRename) {
+                    invalidateRemoteWriteabilityFromError(
+                        QString::fromStdString(err));
+                    UiAlerts::critical(
+                        this, tr("Remote"),
+                        tr("Could not rename the remote item.\n%1")
+                            .arg(shortRemoteError(err, tr("Remote error"))));
+                    return;
+                }
+                refreshRemoteFolderAfterChange(base);
+            });
     } else {
         const QModelIndex idx = rows.first();
         const QFileInfo fi = rightLocalModel_->fileInfo(idx);
@@ -1794,7 +1847,7 @@ void MainWindow::deleteRightSelected() {
         return;
     }
     if (rightIsRemote_) {
-        if (!sftp_ || !rightRemoteModel_)
+        if (!sftp_ || !rightRemoteModel_ || !m_activeSessionOptions_)
             return;
         if (UiAlerts::warning(this, tr("Confirm delete"),
                                  tr("This will permanently delete items on the "
@@ -1802,100 +1855,154 @@ void MainWindow::deleteRightSelected() {
                                  QMessageBox::Yes | QMessageBox::No) !=
             QMessageBox::Yes)
             return;
-        int ok = 0, fail = 0;
-        QString lastErr;
+        if (m_remoteScanInProgress_.exchange(true)) {
+            statusBar()->showMessage(
+                tr("Another remote operation is in progress"), 3000);
+            return;
+        }
         const QString base = rightRemoteModel_->rootPath();
-        QStringList names;
-        names.reserve(rows.size());
-        for (const QModelIndex &idx : rows)
-            names.push_back(rightRemoteModel_->nameAt(idx));
-        std::function<bool(const QString &)> delRec = [&](const QString &p) {
-            // Determine if path is a directory or a file using stat/exists
-            bool isDir = false;
-            bool exists = false;
-            std::string xerr;
-            const bool existsOk = executeCriticalRemoteOperation(
-                tr("delete remote items"),
-                [p, &isDir,
-                 &exists](openscp::SftpClient *client, std::string &opErr) {
-                    exists = client->exists(p.toStdString(), isDir, opErr);
-                    if (exists)
-                        return true;
-                    // Not found is not an error in delete flow.
-                    return opErr.empty();
-                },
-                xerr);
-            if (!existsOk) {
-                lastErr = QString::fromStdString(xerr);
-                return false;
+        std::vector<openscp::RemoteDeleteRoot> roots;
+        roots.reserve(rows.size());
+        bool anyDir = false;
+        for (const QModelIndex &idx : rows) {
+            openscp::RemoteDeleteRoot root;
+            root.path =
+                joinRemotePath(base, rightRemoteModel_->nameAt(idx))
+                    .toStdString();
+            root.is_dir = rightRemoteModel_->isDir(idx);
+            anyDir = anyDir || root.is_dir;
+            roots.push_back(std::move(root));
+        }
+
+        // The job runs on its own sessions (clones of this one, sharing its
+        // listing cache), so the panel stays usable meanwhile.
+        const openscp::SessionOptions opt = *m_activeSessionOptions_;
+        std::string connErr;
+        auto first = sftp_->newConnectionLike(opt, connErr);
+        if (!first) {
+            m_remoteScanInProgress_ = false;
+            UiAlerts::warning(this, tr("Delete"),
+                              tr("Could not start remote delete.\n%1")
+                                  .arg(QString::fromStdString(connErr)));
+            return;
+        }
+
+        auto cancelRequested = std::make_shared<std::atomic<bool>>(false);
+        m_remoteScanCancelRequested_ = cancelRequested;
+        auto *progressDlg = new QProgressDialog(
+            tr("Deleting remote items..."), tr("Cancel"), 0, 0, this);
+        progressDlg->setWindowTitle(tr("Delete"));
+        progressDlg->setWindowModality(Qt::NonModal);
+        progressDlg->setAutoClose(false);
+        progressDlg->setAutoReset(false);
+        progressDlg->setMinimumDuration(0);
+        connect(progressDlg, &QProgressDialog::canceled, this,
+                [cancelRequested] { cancelRequested->store(true); });
+        m_remoteScanProgress_ = progressDlg;
+        progressDlg->show();
+
+        QPointer<MainWindow> self(this);
+        std::thread([self, base, opt, anyDir, cancelRequested,
+                     roots = std::move(roots),
+                     first = std::move(first)]() mutable {
+            // Single files need no walk; folders get the extra sessions.
+            std::vector<std::unique_ptr<openscp::SftpClient>> extra;
+            std::vector<openscp::SftpClient *> clients{first.get()};
+            for (int i = 1; anyDir && i < kRemoteTreeJobSessions &&
+                            !cancelRequested->load();
+                 ++i) {
+                std::string extraErr;
+                auto c = first->newConnectionLike(opt, extraErr);
+                if (!c)
+                    break; // keep going with the sessions we have
+                clients.push_back(c.get());
+                extra.push_back(std::move(c));
             }
-            if (!exists)
-                return true;
-            if (!isDir) {
-                std::string ferr;
-                const bool removed = executeCriticalRemoteOperation(
-                    tr("delete remote items"),
-                    [p](openscp::SftpClient *client, std::string &opErr) {
-                        return client->removeFile(p.toStdString(), opErr);
+
+            openscp::RemoteDeleteJob job;
+            job.roots = std::move(roots);
+            job.shouldCancel = [cancelRequested] {
+                return cancelRequested->load();
+            };
+            auto lastPost = std::chrono::steady_clock::time_point{};
+            job.progress = [&](const openscp::RemoteDeleteProgress &p) {
+                const auto now = std::chrono::steady_clock::now();
+                if (now - lastPost < std::chrono::milliseconds(100))
+                    return;
+                lastPost = now;
+                QObject *app = QCoreApplication::instance();
+                if (!app)
+                    return;
+                const quint64 files = p.files_removed;
+                const quint64 dirs = p.dirs_removed;
+                QMetaObject::invokeMethod(
+                    app,
+                    [self, files, dirs] {
+                        if (!self || !self->m_remoteScanProgress_)
+                            return;
+                        self->m_remoteScanProgress_->setLabelText(
+                            QCoreApplication::translate(
+                                "MainWindow", "Deleting remote items... %1 "
+                                              "files, %2 folders removed")
+                                .arg(files)
+                                .arg(dirs));
                     },
-                    ferr);
-                if (!removed) {
-                    lastErr = QString::fromStdString(ferr);
-                    return false;
-                }
-                return true;
-            }
-            // Directory: list and remove children first (depth-first)
-            std::vector<openscp::FileInfo> out;
-            std::string lerr;
-            const bool listed = executeCriticalRemoteOperation(
-                tr("delete remote items"),
-                [p, &out](openscp::SftpClient *client, std::string &opErr) {
-                    out.clear();
-                    return client->list(p.toStdString(), out, opErr);
-                },
-                lerr);
-            if (!listed) {
-                lastErr = QString::fromStdString(lerr);
-                return false;
-            }
-            for (const auto &e : out) {
-                const QString child =
-                    joinRemotePath(p, QString::fromStdString(e.name));
-                if (!delRec(child))
-                    return false;
-            }
-            std::string derr;
-            const bool removedDir = executeCriticalRemoteOperation(
-                tr("delete remote items"),
-                [p](openscp::SftpClient *client, std::string &opErr) {
-                    return client->removeDir(p.toStdString(), opErr);
+                    Qt::QueuedConnection);
+            };
+            openscp::RemoteDeleteProgress stats;
+            std::string err;
+            const bool ok = openscp::runRemoteDelete(clients, job, stats, err);
+            for (auto &c : extra)
+                c->disconnect();
+            first->disconnect();
+            const bool canceled = cancelRequested->load();
+
+            QObject *app = QCoreApplication::instance();
+            if (!app)
+                return;
+            QMetaObject::invokeMethod(
+                app,
+                [self, base, ok, canceled, stats,
+                 lastErr = QString::fromStdString(err)] {
+                    if (!self)
+                        return;
+                    self->m_remoteScanInProgress_ = false;
+                    self->m_remoteScanCancelRequested_.reset();
+                    if (self->m_remoteScanProgress_) {
+                        self->m_remoteScanProgress_->hide();
+                        self->m_remoteScanProgress_->deleteLater();
+                        self->m_remoteScanProgress_.clear();
+                    }
+                    QString msg =
+                        QCoreApplication::translate(
+                            "MainWindow",
+                            "Deleted: %1 files, %2 folders  |  Failed: %3")
+                            .arg(stats.files_removed)
+                            .arg(stats.dirs_removed)
+                            .arg(stats.failures);
+                    if (canceled) {
+                        msg.prepend(QCoreApplication::translate(
+                                        "MainWindow", "Delete canceled. "));
+                    } else if (!ok && !lastErr.isEmpty()) {
+                        msg += "\n" +
+                               QCoreApplication::translate("MainWindow",
+                                                           "Last error: ") +
+                               lastErr;
+                    }
+                    self->statusBar()->showMessage(msg, 6000);
+                    if (!self->rightIsRemote_ || !self->rightRemoteModel_)
+                        return;
+                    if (stats.failures > 0)
+                        self->invalidateRemoteWriteabilityFromError(lastErr);
+                    if (ok && stats.files_removed + stats.dirs_removed > 0)
+                        self->cacheCurrentRemoteWriteability(true);
+                    if (self->rightRemoteModel_->rootPath() == base) {
+                        QString dummy;
+                        self->rightRemoteModel_->setRootPath(base, &dummy);
+                    }
                 },
-                derr);
-            if (!removedDir) {
-                lastErr = QString::fromStdString(derr);
-                return false;
-            }
-            return true;
-        };
-        for (const QString &name : names) {
-            const QString path = joinRemotePath(base, name);
-            if (delRec(path))
-                ++ok;
-            else
-                ++fail;
-        }
-        QString msg =
-            QString(tr("Deleted OK: %1  |  Failed: %2")).arg(ok).arg(fail);
-        if (fail > 0 && !lastErr.isEmpty())
-            msg += "\n" + tr("Last error: ") + lastErr;
-        statusBar()->showMessage(msg, 6000);
-        if (fail > 0)
-            invalidateRemoteWriteabilityFromError(lastErr);
-        if (fail == 0 && ok > 0)
-            cacheCurrentRemoteWriteability(true);
-        QString dummy;
-        rightRemoteModel_->setRootPath(base, &dummy);
+                Qt::QueuedConnection);
+        }).detach();
     } else {
         if (UiAlerts::warning(
                 this, tr("Confirm delete"),
@@ -1919,6 +2026,197 @@ void MainWindow::deleteRightSelected() {
     }
 }
 
+// Open the selected remote file in a read-only viewer on its own session.
+void MainWindow::viewRemoteSelected() {
+    if (!rightIsRemote_ || !rightRemoteModel_ || !m_activeSessionOptions_)
+        return;
+    auto sel = rightView_->selectionModel();
+    const auto rows =
+        sel ? sel->selectedRows(NAME_COL) : QModelIndexList{};
+    if (rows.size() != 1 || rightRemoteModel_->isDir(rows.first())) {
+        UiAlerts::information(this, tr("View"), tr("Select one file."));
+        return;
+    }
+    const QString path =
+        joinRemotePath(rightRemoteModel_->rootPath(),
+                       rightRemoteModel_->nameAt(rows.first()));
+    auto *dlg =
+        new RemoteFileViewerDialog(*m_activeSessionOptions_, path, this);
+    dlg->setAttribute(Qt::WA_DeleteOnClose);
+    dlg->show();
+}
+
+// Queue a streamed copy of the selection to a folder on another server.
+void MainWindow::copyRemoteToServer() {
+    if (!rightIsRemote_ || !sftp_ || !rightRemoteModel_ ||
+        !m_activeSessionOptions_)
+        return;
+    auto sel = rightView_->selectionModel();
+    const auto rows =
+        sel ? sel->selectedRows(NAME_COL) : QModelIndexList{};
+    if (rows.isEmpty()) {
+        UiAlerts::information(this, tr("Copy"), tr("Nothing selected."));
+        return;
+    }
+    SiteManagerDialog dlg(this);
+    dlg.setWindowTitle(tr("Copy to another server"));
+    if (dlg.exec() != QDialog::Accepted)
+        return;
+    auto peer = std::make_shared<openscp::SessionOptions>();
+    if (!dlg.selectedOptions(*peer))
+        return;
+    if (!openscp::capabilitiesForProtocol(peer->protocol).supports_streaming) {
+        UiAlerts::warning(this, tr("Copy"),
+                          tr("Files cannot be copied to a server of this "
+                             "type."));
+        return;
+    }
+    bool ok = false;
+    const QString target = QInputDialog::getText(
+        this, tr("Copy to another server"),
+        tr("Destination folder on %1:")
+            .arg(QString::fromStdString(peer->host)),
+        QLineEdit::Normal, rightRemoteModel_->rootPath(), &ok);
+    if (!ok || target.isEmpty())
+        return;
+
+    int bad = 0;
+    QVector<RemoteDownloadSeed> seeds;
+    seeds.reserve(rows.size());
+    const QString remoteBase = rightRemoteModel_->rootPath();
+    for (const QModelIndex &idx : rows) {
+        const QString name = rightRemoteModel_->nameAt(idx);
+        QString why;
+        if (!isValidEntryName(name, &why)) {
+            ++bad;
+            continue;
+        }
+        seeds.push_back({joinRemotePath(remoteBase, name),
+                         joinRemotePath(target, name),
+                         rightRemoteModel_->isDir(idx)});
+    }
+    runRemoteDownloadPrescan(seeds, bad, false, std::move(peer));
+}
+
+// Duplicate the selected remote entry inside the server (server-side copy),
+// on a session of its own so large folders do not block the panel.
+void MainWindow::duplicateRemoteSelected() {
+    if (!rightIsRemote_ || !sftp_ || !rightRemoteModel_ ||
+        !m_activeSessionOptions_)
+        return;
+    auto sel = rightView_->selectionModel();
+    if (!sel)
+        return;
+    const auto rows = sel->selectedRows();
+    if (rows.size() != 1) {
+        UiAlerts::information(this, tr("Duplicate"),
+                              tr("Select exactly one item."));
+        return;
+    }
+    const QModelIndex idx = rows.first();
+    const QString oldName = rightRemoteModel_->nameAt(idx);
+    QString suggested = oldName + tr(" copy");
+    const int dot = oldName.lastIndexOf('.');
+    if (!rightRemoteModel_->isDir(idx) && dot > 0)
+        suggested = oldName.left(dot) + tr(" copy") + oldName.mid(dot);
+    bool ok = false;
+    const QString newName =
+        QInputDialog::getText(this, tr("Duplicate"), tr("Name of the copy:"),
+                              QLineEdit::Normal, suggested, &ok);
+    if (!ok || newName.isEmpty() || newName == oldName)
+        return;
+    {
+        QString why;
+        if (!isValidEntryName(newName, &why)) {
+            UiAlerts::warning(this, tr("Invalid name"), why);
+            return;
+        }
+    }
+    if (m_remoteScanInProgress_.exchange(true)) {
+        statusBar()->showMessage(
+            tr("Another remote operation is in progress"), 3000);
+        return;
+    }
+    const QString base = rightRemoteModel_->rootPath();
+    const std::string from = joinRemotePath(base, oldName).toStdString();
+    const std::string to = joinRemotePath(base, newName).toStdString();
+    std::string connErr;
+    auto session =
+        sftp_->newConnectionLike(*m_activeSessionOptions_, connErr);
+    if (!session) {
+        m_remoteScanInProgress_ = false;
+        UiAlerts::warning(this, tr("Duplicate"),
+                          tr("Could not start the copy.\n%1")
+                              .arg(QString::fromStdString(connErr)));
+        return;
+    }
+
+    auto cancelRequested = std::make_shared<std::atomic<bool>>(false);
+    m_remoteScanCancelRequested_ = cancelRequested;
+    auto *progressDlg = new QProgressDialog(
+        tr("Copying \"%1\" on the server...").arg(oldName), tr("Cancel"), 0,
+        0, this);
+    progressDlg->setWindowTitle(tr("Duplicate"));
+    progressDlg->setWindowModality(Qt::NonModal);
+    progressDlg->setAutoClose(false);
+    progressDlg->setAutoReset(false);
+    progressDlg->setMinimumDuration(0);
+    connect(progressDlg, &QProgressDialog::canceled, this,
+            [cancelRequested] { cancelRequested->store(true); });
+    m_remoteScanProgress_ = progressDlg;
+    progressDlg->show();
+
+    QPointer<MainWindow> self(this);
+    std::thread([self, base, from, to, newName, cancelRequested,
+                 session = std::move(session)]() mutable {
+        std::string err;
+        const bool copied =
+            session->copyRemote(from, to, err, false, [cancelRequested] {
+                return cancelRequested->load();
+            });
+        session->disconnect();
+        QObject *app = QCoreApplication::instance();
+        if (!app)
+            return;
+        QMetaObject::invokeMethod(
+            app,
+            [self, base, newName, copied,
+             lastErr = QString::fromStdString(err)] {
+                if (!self)
+                    return;
+                self->m_remoteScanInProgress_ = false;
+                self->m_remoteScanCancelRequested_.reset();
+                if (self->m_remoteScanProgress_) {
+                    self->m_remoteScanProgress_->hide();
+                    self->m_remoteScanProgress_->deleteLater();
+                    self->m_remoteScanProgress_.clear();
+                }
+                if (self->rightIsRemote_ && self->rightRemoteModel_ &&
+                    self->rightRemoteModel_->rootPath() == base) {
+                    QString dummy;
+                    self->rightRemoteModel_->setRootPath(base, &dummy);
+                }
+                if (!copied) {
+                    self->invalidateRemoteWriteabilityFromError(lastErr);
+                    UiAlerts::critical(
+                        self, QCoreApplication::translate("MainWindow",
+                                                          "Duplicate"),
+                        QCoreApplication::translate(
+                            "MainWindow", "Could not copy on the server.\n%1")
+                            .arg(shortRemoteError(
+                                lastErr, QCoreApplication::translate(
+                                             "MainWindow", "Remote error"))));
+                    return;
+                }
+                self->statusBar()->showMessage(
+                    QCoreApplication::translate("MainWindow", "Created: %1")
+                        .arg(newName),
+                    4000);
+            },
+            Qt::QueuedConnection);
+    }).detach();
+}
+
 // Show context menu for the right pane based on current state.
 void MainWindow::showRightContextMenu(const QPoint &pos) {
     if (!rightContextMenu_)
@@ -1962,6 +2260,14 @@ void MainWindow::showRightContextMenu(const QPoint &pos) {
             m_activeSessionOptions_.has_value() &&
             openscp::capabilitiesForProtocol(m_activeSessionOptions_->protocol)
                 .supports_permissions;
+        const bool supportsServerCopy =
+            m_activeSessionOptions_.has_value() &&
+            openscp::capabilitiesForProtocol(m_activeSessionOptions_->protocol)
+                .supports_server_copy;
+        const bool supportsStreaming =
+            m_activeSessionOptions_.has_value() &&
+            openscp::capabilitiesForProtocol(m_activeSessionOptions_->protocol)
+                .supports_streaming;
         // Up option (if applicable)
         if (canGoUp && actUpRight_)
             rightContextMenu_->addAction(actUpRight_);
@@ -1969,6 +2275,13 @@ void MainWindow::showRightContextMenu(const QPoint &pos) {
         // Always show "Download" on remote, regardless of selection
         if (actDownloadF7_)
             rightContextMenu_->addAction(actDownloadF7_);
+        QMenu *syncMenu =
+            rightContextMenu_->addMenu(tr("Synchronize folders"));
+        if (rightRemoteWritable_)
+            syncMenu->addAction(tr("Upload changes from the left panel"),
+                                this, &MainWindow::syncLeftToRight);
+        syncMenu->addAction(tr("Download changes to the left panel"), this,
+                            &MainWindow::syncRightToLeft);
 
         if (!hasSel) {
             // No selection: creation and navigation
@@ -1980,8 +2293,15 @@ void MainWindow::showRightContextMenu(const QPoint &pos) {
             }
         } else {
             // With selection on remote
+            if (supportsStreaming)
+                rightContextMenu_->addAction(tr("View…"), this,
+                                             &MainWindow::viewRemoteSelected);
             if (actCopyRight_)
                 rightContextMenu_->addAction(actCopyRight_);
+            if (supportsStreaming)
+                rightContextMenu_->addAction(
+                    tr("Copy to another server…"), this,
+                    &MainWindow::copyRemoteToServer);
             if (rightRemoteWritable_) {
                 rightContextMenu_->addSeparator();
                 if (actUploadRight_)
@@ -1992,6 +2312,10 @@ void MainWindow::showRightContextMenu(const QPoint &pos) {
                     rightContextMenu_->addAction(actNewDirRight_);
                 if (actRenameRight_)
                     rightContextMenu_->addAction(actRenameRight_);
+                if (supportsServerCopy)
+                    rightContextMenu_->addAction(
+                        tr("Duplicate on server…"), this,
+                        &MainWindow::duplicateRemoteSelected);
                 if (actDeleteRight_)
                     rightContextMenu_->addAction(actDeleteRight_);
                 if (actMoveRight_)
@@ -2059,93 +2383,430 @@ void MainWindow::changeRemotePermissions() {
     const QString name = rightRemoteModel_->nameAt(idx);
     const QString base = rightRemoteModel_->rootPath();
     const QString path = joinRemotePath(base, name);
-    openscp::FileInfo st{};
-    std::string err;
-    const bool statOk = executeCriticalRemoteOperation(
+    auto st = std::make_shared<openscp::FileInfo>();
+    runRemoteOperationAsync(
         tr("read remote permissions"),
-        [path, &st](openscp::SftpClient *client, std::string &opErr) {
-            return client->stat(path.toStdString(), st, opErr);
+        [path, st](openscp::SftpClient *client, std::string &opErr) {
+            return client->stat(path.toStdString(), *st, opErr);
         },
-        err);
-    if (!statOk) {
-        UiAlerts::warning(
-            this, tr("Permissions"),
-            tr("Could not read permissions.\n%1")
-                .arg(shortRemoteError(
-                    err, tr("Error reading remote information."))));
-        return;
-    }
+        [this, base, path, st](bool statOk, const std::string &err) {
+            if (!statOk) {
+                UiAlerts::warning(
+                    this, tr("Permissions"),
+                    tr("Could not read permissions.\n%1")
+                        .arg(shortRemoteError(
+                            err, tr("Error reading remote information."))));
+                return;
+            }
+            applyRemotePermissions(base, path, *st);
+        });
+}
+
+// Second half of changeRemotePermissions(), once the item's mode is known.
+void MainWindow::applyRemotePermissions(const QString &base,
+                                        const QString &path,
+                                        const openscp::FileInfo &st) {
     PermissionsDialog dlg(this);
     dlg.setMode(st.mode & 0777);
     if (dlg.exec() != QDialog::Accepted)
         return;
-    unsigned int newMode = (st.mode & ~0777u) | (dlg.mode() & 0777u);
-    auto applyOne = [&](const QString &p) -> bool {
-        std::string cerrs;
-        const bool chmodOk = executeCriticalRemoteOperation(
-            tr("change remote permissions"),
-            [p, newMode](openscp::SftpClient *client, std::string &opErr) {
-                return client->chmod(p.toStdString(), newMode, opErr);
-            },
-            cerrs);
-        if (!chmodOk) {
-            invalidateRemoteWriteabilityFromError(
-                QString::fromStdString(cerrs));
-            const QString item =
-                QFileInfo(p).fileName().isEmpty() ? p : QFileInfo(p).fileName();
-            UiAlerts::critical(
-                this, tr("Permissions"),
-                tr("Could not apply permissions to \"%1\".\n%2")
-                    .arg(item, shortRemoteError(
-                                   cerrs, tr("Error applying changes."))));
-            return false;
-        }
-        return true;
-    };
-    bool ok = true;
+    if (!rightIsRemote_ || !sftp_)
+        return;
+    const unsigned int newMode = (st.mode & ~0777u) | (dlg.mode() & 0777u);
     if (dlg.recursive() && st.is_dir) {
-        QVector<QString> stack;
-        stack.push_back(path);
-        while (!stack.isEmpty() && ok) {
-            const QString cur = stack.back();
-            stack.pop_back();
-            if (!applyOne(cur)) {
-                ok = false;
-                break;
+        startRemoteChmodJob(path, newMode & 07777u);
+        return;
+    }
+    runRemoteOperationAsync(
+        tr("change remote permissions"),
+        [path, newMode](openscp::SftpClient *client, std::string &opErr) {
+            return client->chmod(path.toStdString(), newMode, opErr);
+        },
+        [this, base, path](bool chmodOk, const std::string &cerrs) {
+            if (!chmodOk) {
+                invalidateRemoteWriteabilityFromError(
+                    QString::fromStdString(cerrs));
+                const QString item = QFileInfo(path).fileName().isEmpty()
+                                         ? path
+                                         : QFileInfo(path).fileName();
+                UiAlerts::critical(
+                    this, tr("Permissions"),
+                    tr("Could not apply permissions to \"%1\".\n%2")
+                        .arg(item, shortRemoteError(
+                                       cerrs, tr("Error applying changes."))));
+                return;
             }
-            std::vector<openscp::FileInfo> out;
-            std::string lerr;
-            const bool listed = executeCriticalRemoteOperation(
-                tr("read remote permissions"),
-                [cur, &out](openscp::SftpClient *client, std::string &opErr) {
-                    out.clear();
-                    return client->list(cur.toStdString(), out, opErr);
+            refreshRemoteFolderAfterChange(base);
+            statusBar()->showMessage(tr("Permissions updated"), 3000);
+        });
+}
+
+// Relist `base` after a change made there, if the panel still shows it.
+void MainWindow::refreshRemoteFolderAfterChange(const QString &base) {
+    if (!rightIsRemote_ || !rightRemoteModel_)
+        return;
+    if (rightRemoteModel_->rootPath() != base)
+        return;
+    QString dummy;
+    rightRemoteModel_->setRootPath(base, &dummy);
+    cacheCurrentRemoteWriteability(true);
+}
+
+// Recursive permission change as a background job: one chmod -R when the
+// server has a shell, otherwise a walk spread over several sessions.
+void MainWindow::startRemoteChmodJob(const QString &path, unsigned int mode) {
+    if (!sftp_ || !rightRemoteModel_ || !m_activeSessionOptions_)
+        return;
+    if (m_remoteScanInProgress_.exchange(true)) {
+        statusBar()->showMessage(
+            tr("Another remote operation is in progress"), 3000);
+        return;
+    }
+    const QString base = rightRemoteModel_->rootPath();
+    const openscp::SessionOptions opt = *m_activeSessionOptions_;
+    std::string connErr;
+    auto first = sftp_->newConnectionLike(opt, connErr);
+    if (!first) {
+        m_remoteScanInProgress_ = false;
+        UiAlerts::warning(this, tr("Permissions"),
+                          tr("Could not start the permission change.\n%1")
+                              .arg(QString::fromStdString(connErr)));
+        return;
+    }
+
+    auto cancelRequested = std::make_shared<std::atomic<bool>>(false);
+    m_remoteScanCancelRequested_ = cancelRequested;
+    auto *progressDlg = new QProgressDialog(
+        tr("Applying permissions..."), tr("Cancel"), 0, 0, this);
+    progressDlg->setWindowTitle(tr("Permissions"));
+    progressDlg->setWindowModality(Qt::NonModal);
+    progressDlg->setAutoClose(false);
+    progressDlg->setAutoReset(false);
+    progressDlg->setMinimumDuration(0);
+    connect(progressDlg, &QProgressDialog::canceled, this,
+            [cancelRequested] { cancelRequested->store(true); });
+    m_remoteScanProgress_ = progressDlg;
+    progressDlg->show();
+
+    QPointer<MainWindow> self(this);
+    std::thread([self, base, opt, mode, cancelRequested,
+                 root = path.toStdString(),
+                 first = std::move(first)]() mutable {
+        openscp::RemoteChmodJob job;
+        job.roots = {{root, true}};
+        job.mode = mode;
+        job.shouldCancel = [cancelRequested] {
+            return cancelRequested->load();
+        };
+        auto lastPost = std::chrono::steady_clock::time_point{};
+        job.progress = [&](const openscp::RemoteChmodProgress &p) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now - lastPost < std::chrono::milliseconds(100))
+                return;
+            lastPost = now;
+            QObject *app = QCoreApplication::instance();
+            if (!app)
+                return;
+            const quint64 changed = p.changed;
+            QMetaObject::invokeMethod(
+                app,
+                [self, changed] {
+                    if (!self || !self->m_remoteScanProgress_)
+                        return;
+                    self->m_remoteScanProgress_->setLabelText(
+                        QCoreApplication::translate(
+                            "MainWindow",
+                            "Applying permissions... %1 items changed")
+                            .arg(changed));
                 },
-                lerr);
-            if (!listed)
-                continue;
-            for (const auto &e : out) {
-                const QString child =
-                    joinRemotePath(cur, QString::fromStdString(e.name));
-                if (e.is_dir)
-                    stack.push_back(child);
-                else {
-                    if (!applyOne(child)) {
-                        ok = false;
-                        break;
-                    }
-                }
+                Qt::QueuedConnection);
+        };
+
+        // Try the single server-side command first; only a walk needs the
+        // extra sessions.
+        openscp::RemoteChmodProgress stats;
+        std::string err;
+        bool ok = first->chmodTree(root, mode, err, job.shouldCancel);
+        if (ok)
+            stats.server_side = 1;
+        std::vector<std::unique_ptr<openscp::SftpClient>> extra;
+        if (!ok && !cancelRequested->load()) {
+            std::vector<openscp::SftpClient *> clients{first.get()};
+            for (int i = 1; i < kRemoteTreeJobSessions; ++i) {
+                std::string extraErr;
+                auto c = first->newConnectionLike(opt, extraErr);
+                if (!c)
+                    break; // keep going with the sessions we have
+                clients.push_back(c.get());
+                extra.push_back(std::move(c));
             }
+            job.server_side = false;
+            err.clear();
+            ok = openscp::runRemoteChmod(clients, job, stats, err);
         }
-    } else {
-        ok = applyOne(path);
+        for (auto &c : extra)
+            c->disconnect();
+        first->disconnect();
+        const bool canceled = cancelRequested->load();
+
+        QObject *app = QCoreApplication::instance();
+        if (!app)
+            return;
+        QMetaObject::invokeMethod(
+            app,
+            [self, base, ok, canceled, stats,
+             lastErr = QString::fromStdString(err)] {
+                if (!self)
+                    return;
+                self->m_remoteScanInProgress_ = false;
+                self->m_remoteScanCancelRequested_.reset();
+                if (self->m_remoteScanProgress_) {
+                    self->m_remoteScanProgress_->hide();
+                    self->m_remoteScanProgress_->deleteLater();
+                    self->m_remoteScanProgress_.clear();
+                }
+                QString msg;
+                if (stats.server_side > 0) {
+                    msg = QCoreApplication::translate("MainWindow",
+                                                      "Permissions updated");
+                } else {
+                    msg = QCoreApplication::translate(
+                              "MainWindow",
+                              "Permissions updated: %1 items  |  Failed: %2")
+                              .arg(stats.changed)
+                              .arg(stats.failures);
+                }
+                if (canceled) {
+                    msg = QCoreApplication::translate(
+                              "MainWindow",
+                              "Permission change canceled after %1 items.")
+                              .arg(stats.changed);
+                } else if (!ok && !lastErr.isEmpty()) {
+                    msg += "\n" +
+                           QCoreApplication::translate("MainWindow",
+                                                       "Last error: ") +
+                           lastErr;
+                }
+                self->statusBar()->showMessage(msg, 6000);
+                if (!self->rightIsRemote_ || !self->rightRemoteModel_)
+                    return;
+                if (stats.failures > 0)
+                    self->invalidateRemoteWriteabilityFromError(lastErr);
+                if (ok)
+                    self->cacheCurrentRemoteWriteability(true);
+                if (self->rightRemoteModel_->rootPath() == base) {
+                    QString dummy;
+                    self->rightRemoteModel_->setRootPath(base, &dummy);
+                }
+            },
+            Qt::QueuedConnection);
+    }).detach();
+}
+
+void MainWindow::startRemoteSearchJob(const QString &panelLabel,
+                                      const QString &base,
+                                      const QRegularExpression &regex,
+                                      const openscp::FindOptions &filter) {
+    if (!sftp_ || !m_activeSessionOptions_)
+        return;
+    if (m_remoteScanInProgress_.exchange(true)) {
+        statusBar()->showMessage(
+            tr("Another remote operation is in progress"), 3000);
+        return;
     }
-    if (!ok)
+    const openscp::SessionOptions opt = *m_activeSessionOptions_;
+    std::string connErr;
+    auto first = sftp_->newConnectionLike(opt, connErr);
+    if (!first) {
+        m_remoteScanInProgress_ = false;
+        UiAlerts::warning(this, tr("Search"),
+                          tr("Could not start the remote search.\n%1")
+                              .arg(QString::fromStdString(connErr)));
         return;
-    QString dummy;
-    rightRemoteModel_->setRootPath(base, &dummy);
-    cacheCurrentRemoteWriteability(true);
-    statusBar()->showMessage(tr("Permissions updated"), 3000);
+    }
+
+    auto cancelRequested = std::make_shared<std::atomic<bool>>(false);
+    m_remoteScanCancelRequested_ = cancelRequested;
+
+    // Results arrive while the search runs; closing the window stops it.
+    auto *dlg = new QDialog(this);
+    dlg->setAttribute(Qt::WA_DeleteOnClose);
+    dlg->setWindowTitle(tr("Search results (%1)").arg(panelLabel));
+    auto *layout = new QVBoxLayout(dlg);
+    layout->setContentsMargins(12, 12, 12, 12);
+    layout->setSpacing(8);
+    auto *summary = new QLabel(tr("Base: %1\nSearching...").arg(base), dlg);
+    summary->setWordWrap(true);
+    summary->setFrameStyle(QFrame::StyledPanel | QFrame::Plain);
+    summary->setMargin(8);
+    layout->addWidget(summary);
+    auto *list = new QListWidget(dlg);
+    list->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    list->setSelectionBehavior(QAbstractItemView::SelectRows);
+    list->setAlternatingRowColors(true);
+    list->setUniformItemSizes(true);
+    list->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+    layout->addWidget(list, 1);
+    auto *box = new QDialogButtonBox(QDialogButtonBox::Close, dlg);
+    QPushButton *stopBtn =
+        box->addButton(tr("Stop"), QDialogButtonBox::ActionRole);
+    connect(stopBtn, &QPushButton::clicked, dlg,
+            [cancelRequested] { cancelRequested->store(true); });
+    connect(box, &QDialogButtonBox::rejected, dlg, &QDialog::reject);
+    connect(dlg, &QDialog::finished, this,
+            [cancelRequested] { cancelRequested->store(true); });
+    layout->addWidget(box);
+    dlg->resize(560, 420);
+    dlg->show();
+
+    QPointer<MainWindow> self(this);
+    QPointer<QLabel> summaryPtr(summary);
+    QPointer<QListWidget> listPtr(list);
+    QPointer<QPushButton> stopPtr(stopBtn);
+    std::thread([self, summaryPtr, listPtr, stopPtr, panelLabel,
+                 base, regex, filter, opt, cancelRequested,
+                 first = std::move(first)]() mutable {
+        std::vector<std::unique_ptr<openscp::SftpClient>> extra;
+        openscp::RemoteFindJob job;
+        job.root = base.toStdString();
+        job.filter = filter;
+        job.match = [regex](const std::string &name) {
+            return regex.match(QString::fromStdString(name)).hasMatch();
+        };
+        job.max_matches = kRemoteSearchMaxMatches;
+        job.shouldCancel = [cancelRequested] {
+            return cancelRequested->load();
+        };
+        // Only a walk needs more sessions than the one running find.
+        job.walk_sessions = [&](std::vector<openscp::SftpClient *> &more) {
+            for (int i = 1; i < kRemoteTreeJobSessions &&
+                            !cancelRequested->load();
+                 ++i) {
+                std::string extraErr;
+                auto c = first->newConnectionLike(opt, extraErr);
+                if (!c)
+                    break; // keep going with the sessions we have
+                more.push_back(c.get());
+                extra.push_back(std::move(c));
+            }
+        };
+        job.on_matches = [listPtr](std::vector<openscp::RemoteFindMatch> &&b) {
+            QStringList labels;
+            labels.reserve(static_cast<int>(b.size()));
+            for (const openscp::RemoteFindMatch &m : b) {
+                QString label = QString::fromStdString(m.relative);
+                if (m.is_dir)
+                    label += QLatin1Char('/');
+                labels.push_back(label);
+            }
+            QObject *app = QCoreApplication::instance();
+            if (!app)
+                return;
+            QMetaObject::invokeMethod(
+                app,
+                [listPtr, labels] {
+                    if (listPtr)
+                        listPtr->addItems(labels);
+                },
+                Qt::QueuedConnection);
+        };
+        auto lastPost = std::chrono::steady_clock::time_point{};
+        job.progress = [&](const openscp::RemoteFindProgress &p) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now - lastPost < std::chrono::milliseconds(100))
+                return;
+            lastPost = now;
+            QObject *app = QCoreApplication::instance();
+            if (!app)
+                return;
+            const quint64 matches = p.matches;
+            const quint64 scanned = p.scanned;
+            QMetaObject::invokeMethod(
+                app,
+                [summaryPtr, base, matches, scanned] {
+                    if (!summaryPtr)
+                        return;
+                    summaryPtr->setText(
+                        QCoreApplication::translate(
+                            "MainWindow",
+                            "Base: %1\nSearching... %2 matches, %3 "
+                            "entries scanned")
+                            .arg(base)
+                            .arg(matches)
+                            .arg(scanned));
+                },
+                Qt::QueuedConnection);
+        };
+
+        openscp::RemoteFindProgress stats;
+        std::string err;
+        const bool ok =
+            openscp::runRemoteFind({first.get()}, job, stats, err);
+        for (auto &c : extra)
+            c->disconnect();
+        first->disconnect();
+        const bool canceled = cancelRequested->load();
+
+        QObject *app = QCoreApplication::instance();
+        if (!app)
+            return;
+        QMetaObject::invokeMethod(
+            app,
+            [self, summaryPtr, stopPtr, panelLabel, base, ok,
+             canceled, stats, lastErr = QString::fromStdString(err)] {
+                if (!self)
+                    return;
+                self->m_remoteScanInProgress_ = false;
+                self->m_remoteScanCancelRequested_.reset();
+                QString text = QCoreApplication::translate(
+                                   "MainWindow", "Base: %1\nMatches: %2")
+                                   .arg(base)
+                                   .arg(stats.matches);
+                if (stats.failures > 0) {
+                    text += QStringLiteral("\n") +
+                               QCoreApplication::translate(
+                                   "MainWindow", "Scan errors: %1")
+                                   .arg(stats.failures);
+                }
+                if (canceled) {
+                    text += QStringLiteral("\n") +
+                               QCoreApplication::translate(
+                                   "MainWindow", "Search canceled by user.");
+                } else if (!ok && !lastErr.isEmpty()) {
+                    text += QStringLiteral("\n") +
+                               QCoreApplication::translate("MainWindow",
+                                                           "Last error: ") +
+                               lastErr;
+                }
+                if (stats.truncated) {
+                    text += QStringLiteral("\n") +
+                               QCoreApplication::translate(
+                                   "MainWindow",
+                                   "Results truncated to safety limit.");
+                }
+                if (summaryPtr)
+                    summaryPtr->setText(text);
+                if (stopPtr)
+                    stopPtr->setEnabled(false);
+
+                QString msg =
+                    QCoreApplication::translate(
+                        "MainWindow", "Found %1 recursive match(es) in %2.")
+                        .arg(QString::number(stats.matches), panelLabel);
+                if (stats.server_side) {
+                    msg += QStringLiteral("  ") +
+                           QCoreApplication::translate(
+                               "MainWindow", "(Searched on the server)");
+                }
+                if (canceled) {
+                    msg += QStringLiteral("  ") +
+                           QCoreApplication::translate("MainWindow",
+                                                       "(Canceled)");
+                }
+                self->statusBar()->showMessage(msg, 6000);
+            },
+            Qt::QueuedConnection);
+    }).detach();
 }
 
 void MainWindow::applyRemoteWriteabilityActions() {
@@ -2226,31 +2887,72 @@ void MainWindow::updateRemoteWriteability() {
 
     const quint64 reqId = ++m_remoteWriteabilityProbeSeq_;
     const openscp::SessionOptions opt = *m_activeSessionOptions_;
+    const std::optional<std::uint32_t> knownUid = m_remoteSessionUid_;
+    // Borrow an idle transfer session rather than opening one per folder;
+    // one opened here is donated to the pool afterwards.
+    quint64 poolGeneration = 0;
+    std::shared_ptr<openscp::SftpClient> leased =
+        transferMgr_ ? transferMgr_->takeIdleSession(poolGeneration)
+                     : nullptr;
     QPointer<MainWindow> self(this);
-    std::thread([self, reqId, base, opt]() mutable {
+    std::thread([self, reqId, base, opt, knownUid, poolGeneration,
+                 probe = std::move(leased)]() mutable {
         bool probeFinished = false;
         bool writable = false;
+        std::optional<std::uint32_t> learnedUid;
+        const std::string path = base.toStdString();
 
-        std::string connErr;
-        auto probe = openscp::CreateConnectedClient(opt, connErr);
+        openscp::FileInfo info{};
+        bool haveInfo = false;
+        if (probe) {
+            std::string statErr;
+            haveInfo = probe->stat(path, info, statErr);
+            if (!haveInfo) {
+                // Possibly dropped while idle; do not trust it further.
+                probe->disconnect();
+                probe.reset();
+            }
+        }
+        if (!probe) {
+            std::string connErr;
+            probe = openscp::CreateConnectedClient(opt, connErr);
+            if (probe) {
+                std::string statErr;
+                haveInfo = probe->stat(path, info, statErr);
+            }
+        }
         if (probe) {
             probeFinished = true;
-            const qint64 ts = QDateTime::currentMSecsSinceEpoch();
-            const QString testName =
-                ".openscp-write-test-" + QString::number(ts);
-            const QString testPath =
-                base.endsWith('/') ? base + testName : base + "/" + testName;
-            std::string err;
-            const bool created =
-                probe->mkdir(testPath.toStdString(), err, 0755);
-            if (created) {
-                std::string derr;
-                (void)probe->removeDir(testPath.toStdString(), derr);
-                writable = true;
-            } else {
+            const openscp::AccessVerdict verdict =
+                haveInfo ? openscp::directoryWriteAccess(info, knownUid)
+                         : openscp::AccessVerdict::Unknown;
+            if (verdict == openscp::AccessVerdict::ReadOnly) {
                 writable = false;
+            } else {
+                const qint64 ts = QDateTime::currentMSecsSinceEpoch();
+                const QString testName =
+                    ".openscp-write-test-" + QString::number(ts);
+                const QString testPath = base.endsWith('/')
+                                             ? base + testName
+                                             : base + "/" + testName;
+                std::string err;
+                const bool created =
+                    probe->mkdir(testPath.toStdString(), err, 0755);
+                if (created) {
+                    openscp::FileInfo made{};
+                    std::string serr;
+                    // Some servers report every owner as 0; an actual root
+                    // session just keeps probing.
+                    if (probe->stat(testPath.toStdString(), made, serr) &&
+                        made.mode != 0 && made.uid != 0)
+                        learnedUid = made.uid;
+                    std::string derr;
+                    (void)probe->removeDir(testPath.toStdString(), derr);
+                    writable = true;
+                } else {
+                    writable = false;
+                }
             }
-            probe->disconnect();
         }
 
         QObject *app = QCoreApplication::instance();
@@ -2258,13 +2960,19 @@ void MainWindow::updateRemoteWriteability() {
             return;
         QMetaObject::invokeMethod(
             app,
-            [self, reqId, base, probeFinished, writable]() {
+            [self, reqId, base, probeFinished, writable, learnedUid,
+             poolGeneration, probe = std::move(probe)]() mutable {
                 if (!self || !probeFinished)
                     return;
+                if (self->transferMgr_)
+                    self->transferMgr_->returnSession(std::move(probe),
+                                                      poolGeneration);
                 if (reqId != self->m_remoteWriteabilityProbeSeq_.load())
                     return;
                 if (!self->rightIsRemote_ || !self->rightRemoteModel_)
                     return;
+                if (learnedUid.has_value())
+                    self->m_remoteSessionUid_ = learnedUid;
                 if (self->rightRemoteModel_->rootPath() != base)
                     return;
 
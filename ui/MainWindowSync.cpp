@@ -0,0 +1,475 @@
+// MainWindow folder synchronization backed by a persisted snapshot index.
+#include "MainWindow.hpp"
+#include "RemoteModel.hpp"
+#include "TransferManager.hpp"
+#include "UiAlerts.hpp"
+#include "openscp/SftpClient.hpp"
+#include "openscp/SyncIndex.hpp"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QProgressDialog>
+#include <QStandardPaths>
+#include <QStatusBar>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+Q_LOGGING_CATEGORY(ocSync, "openscp.sync")
+
+static QString joinRemotePath(const QString &base, const QString &name) {
+    if (base == "/")
+        return "/" + name;
+    return base.endsWith('/') ? base + name : base + "/" + name;
+}
+
+// Names the transfer queue can address on both sides.
+static bool isSyncableName(const QString &name) {
+    if (name.isEmpty() || name == "." || name == ".." || name.contains('/') ||
+        name.contains('\\'))
+        return false;
+    for (const QChar &ch : name) {
+        const ushort u = ch.unicode();
+        if (u < 0x20u || u == 0x7Fu)
+            return false;
+    }
+    return true;
+}
+
+// One snapshot per direction, site and folder pair, under the app data dir.
+static QString syncIndexPath(const openscp::SessionOptions &opt,
+                             const QString &localRoot,
+                             const QString &remoteRoot, bool upload) {
+    const QString key =
+        QString(upload ? "upload" : "download") + '\n' +
+        QString::fromStdString(opt.username) + '@' +
+        QString::fromStdString(opt.host) + ':' + QString::number(opt.port) +
+        '\n' + QDir::cleanPath(localRoot) + '\n' + remoteRoot;
+    const QByteArray digest =
+        QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1)
+            .toHex();
+    const QString dir =
+        QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+        "/sync";
+    return dir + '/' + QString::fromLatin1(digest) + ".idx";
+}
+
+// How far apart two mtimes of the same file content may be: FTP LIST
+// listings only carry minutes, FAT volumes round to two seconds.
+static std::int64_t mtimeToleranceSecs(openscp::Protocol protocol) {
+    return (protocol == openscp::Protocol::Ftp ||
+            protocol == openscp::Protocol::Ftps)
+               ? 60
+               : 2;
+}
+
+// A destination file counts as synchronized without a snapshot only when
+// its size and its (known) mtime match the source.
+static bool sameFileState(const openscp::SyncEntry &src, std::uint64_t size,
+                          std::int64_t mtime, std::int64_t tolerance) {
+    if (size != src.size || src.mtime <= 0 || mtime <= 0)
+        return false;
+    const std::int64_t delta =
+        (mtime > src.mtime) ? mtime - src.mtime : src.mtime - mtime;
+    return delta <= tolerance;
+}
+
+static openscp::SyncEntry syncEntry(std::string path, std::uint64_t size,
+                                    std::int64_t mtime) {
+    openscp::SyncEntry e;
+    e.path = std::move(path);
+    e.size = size;
+    e.mtime = mtime;
+    return e;
+}
+
+// Regular files below `root` (symlinks are not followed).
+static void scanLocalFiles(const QString &root,
+                           const std::atomic<bool> &cancel,
+                           std::vector<openscp::SyncEntry> &out) {
+    const QDir base(root);
+    QDirIterator it(root,
+                    QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot |
+                        QDir::NoSymLinks,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext() && !cancel.load()) {
+        it.next();
+        const QFileInfo fi = it.fileInfo();
+        const QString rel = base.relativeFilePath(fi.absoluteFilePath());
+        bool valid = !rel.isEmpty();
+        for (const QString &part : rel.split('/'))
+            valid = valid && isSyncableName(part);
+        if (!valid)
+            continue;
+        out.push_back(syncEntry(rel.toStdString(), (std::uint64_t)fi.size(),
+                                fi.lastModified().toSecsSinceEpoch()));
+    }
+}
+
+// Files below `root` on the server, through the shared breadth-first
+// walk (several sessions, or the backend's bulk tree listing).
+static void scanRemoteFiles(openscp::SftpClient &client,
+                            const openscp::SessionOptions &opt,
+                            const QString &root, std::atomic<bool> &cancel,
+                            std::vector<openscp::SyncEntry> &out,
+                            int &listFailures) {
+    RemoteModel::EnumOptions walk;
+    walk.skipSymlinks = false;
+    walk.maxDepth = 0; // Advanced/maxFolderDepth
+    walk.cancel = &cancel;
+    const QString prefix = (root == "/") ? root : root + '/';
+    walk.onBatch = [&](std::vector<RemoteModel::EnumeratedFile> &&batch) {
+        for (const auto &f : batch) {
+            if (!f.remotePath.startsWith(prefix))
+                continue;
+            // Judge the names as the server has them, not sanitized.
+            const QString rel = f.remotePath.mid(prefix.size());
+            bool valid = !rel.isEmpty();
+            for (const QString &part : rel.split('/'))
+                valid = valid && isSyncableName(part);
+            if (valid)
+                out.push_back(syncEntry(rel.toStdString(), f.size,
+                                        (std::int64_t)f.mtime));
+        }
+    };
+    std::vector<RemoteModel::EnumeratedFile> unused;
+    bool partial = false;
+    bool someSizeUnknown = false;
+    quint64 denied = 0;
+    (void)RemoteModel::enumerateTree(&client, opt, true, root, unused, walk,
+                                     &partial, &someSizeUnknown, nullptr,
+                                     nullptr, &denied);
+    listFailures += static_cast<int>(denied);
+}
+
+void MainWindow::syncLeftToRight() { runFolderSync(true); }
+
+void MainWindow::syncRightToLeft() { runFolderSync(false); }
+
+void MainWindow::runFolderSync(bool upload) {
+    if (!rightIsRemote_ || !sftp_ || !rightRemoteModel_ || !transferMgr_ ||
+        !m_activeSessionOptions_.has_value()) {
+        UiAlerts::warning(this, tr("Synchronize"),
+                          tr("No active remote session."));
+        return;
+    }
+    if (!openscp::capabilitiesForProtocol(m_activeSessionOptions_->protocol)
+             .supports_listing ||
+        isScpTransferMode()) {
+        UiAlerts::warning(this, tr("Synchronize"),
+                          tr("This session cannot list remote folders."));
+        return;
+    }
+    const QString localRoot =
+        QDir::cleanPath(leftPath_ ? leftPath_->text() : QString());
+    const QString remoteRoot = rightRemoteModel_->rootPath();
+    if (localRoot.isEmpty() || !QDir(localRoot).exists()) {
+        UiAlerts::warning(this, tr("Synchronize"),
+                          tr("The left panel folder does not exist."));
+        return;
+    }
+    const QString question =
+        upload ? tr("Upload new and changed files from\n%1\nto\n%2?\n\n"
+                    "Nothing is deleted on either side.")
+                     .arg(localRoot, remoteRoot)
+               : tr("Download new and changed files from\n%1\nto\n%2?\n\n"
+                    "Nothing is deleted on either side.")
+                     .arg(remoteRoot, localRoot);
+    if (UiAlerts::question(this, tr("Synchronize folders"), question) !=
+        QMessageBox::Yes)
+        return;
+    if (m_remoteScanInProgress_.exchange(true)) {
+        statusBar()->showMessage(tr("A remote scan is already in progress"),
+                                 3000);
+        return;
+    }
+
+    std::string connErr;
+    auto scanClient =
+        sftp_->newConnectionLike(*m_activeSessionOptions_, connErr);
+    if (!scanClient) {
+        m_remoteScanInProgress_ = false;
+        UiAlerts::warning(this, tr("Synchronize"),
+                          tr("Could not start remote scan.\n%1")
+                              .arg(QString::fromStdString(connErr)));
+        return;
+    }
+
+    auto cancelRequested = std::make_shared<std::atomic<bool>>(false);
+    m_remoteScanCancelRequested_ = cancelRequested;
+    auto *scanProgress = new QProgressDialog(
+        tr("Comparing folders with the last synchronization..."),
+        tr("Cancel"), 0, 0, this);
+    scanProgress->setWindowTitle(tr("Synchronize folders"));
+    scanProgress->setWindowModality(Qt::NonModal);
+    scanProgress->setAutoClose(false);
+    scanProgress->setAutoReset(false);
+    scanProgress->setMinimumDuration(0);
+    connect(scanProgress, &QProgressDialog::canceled, this,
+            [cancelRequested] { cancelRequested->store(true); });
+    m_remoteScanProgress_ = scanProgress;
+    scanProgress->show();
+
+    const QString indexPath = syncIndexPath(*m_activeSessionOptions_,
+                                            localRoot, remoteRoot, upload);
+    QPointer<MainWindow> self(this);
+    const openscp::SessionOptions scanOpt = *m_activeSessionOptions_;
+    std::thread([self, upload, localRoot, remoteRoot, indexPath,
+                 cancelRequested, scanOpt,
+                 scanClient = std::move(scanClient)]() mutable {
+        // The snapshot describes the source side as it was last transferred.
+        // Uploads therefore only rescan the local tree; the server is walked
+        // once to seed a first run. Downloads walk the server and trust the
+        // snapshot for the local side.
+        openscp::SyncIndex index;
+        std::string indexErr;
+        if (!index.open(indexPath.toStdString(), indexErr))
+            qCWarning(ocSync) << "Ignoring sync index:"
+                              << QString::fromStdString(indexErr);
+        std::vector<openscp::SyncEntry> scan;
+        int listFailures = 0;
+        if (upload)
+            scanLocalFiles(localRoot, *cancelRequested, scan);
+        else
+            scanRemoteFiles(*scanClient, scanOpt, remoteRoot,
+                            *cancelRequested, scan, listFailures);
+        openscp::SyncDiff diff = openscp::diffSyncIndex(index, scan);
+
+        // Without a snapshot, files already on the destination with the
+        // same size and mtime (within the server's precision) count as
+        // synchronized; a size match alone could hide an edit.
+        if (!index.loaded() && !diff.changed.empty() &&
+            !cancelRequested->load()) {
+            const std::int64_t tolerance =
+                mtimeToleranceSecs(scanOpt.protocol);
+            std::unordered_map<std::string, openscp::SyncEntry> dest;
+            if (upload) {
+                std::vector<openscp::SyncEntry> remote;
+                scanRemoteFiles(*scanClient, scanOpt, remoteRoot,
+                                *cancelRequested, remote, listFailures);
+                for (auto &e : remote) {
+                    std::string key = e.path;
+                    dest.emplace(std::move(key), std::move(e));
+                }
+            }
+            std::vector<std::size_t> stillChanged;
+            for (std::size_t i : diff.changed) {
+                const auto &e = scan[i];
+                bool present = false;
+                if (upload) {
+                    const auto it = dest.find(e.path);
+                    present = it != dest.end() &&
+                              sameFileState(e, it->second.size,
+                                            it->second.mtime, tolerance);
+                } else {
+                    const QFileInfo lfi(QDir(localRoot).filePath(
+                        QString::fromStdString(e.path)));
+                    present =
+                        lfi.isFile() &&
+                        sameFileState(e, (std::uint64_t)lfi.size(),
+                                      lfi.lastModified().toSecsSinceEpoch(),
+                                      tolerance);
+                }
+                (present ? diff.unchanged : stillChanged).push_back(i);
+            }
+            diff.changed = std::move(stillChanged);
+        }
+        const std::size_t removed = diff.removed.size();
+        scanClient->disconnect();
+
+        std::vector<openscp::SyncEntry> settled;
+        settled.reserve(diff.unchanged.size());
+        for (std::size_t i : diff.unchanged)
+            settled.push_back(std::move(scan[i]));
+        std::vector<openscp::SyncEntry> changed;
+        changed.reserve(diff.changed.size());
+        for (std::size_t i : diff.changed)
+            changed.push_back(std::move(scan[i]));
+        const bool canceled = cancelRequested->load();
+        const int changedCount = static_cast<int>(changed.size());
+        const int settledCount = static_cast<int>(settled.size());
+
+        QObject *app = QCoreApplication::instance();
+        if (!app)
+            return;
+        QMetaObject::invokeMethod(
+            app,
+            [self, upload, localRoot, remoteRoot, indexPath, canceled,
+             changedCount, settledCount, removed, listFailures,
+             settled = std::move(settled),
+             changed = std::move(changed)]() mutable {
+                if (!self)
+                    return;
+                self->m_remoteScanInProgress_ = false;
+                self->m_remoteScanCancelRequested_.reset();
+                if (self->m_remoteScanProgress_) {
+                    self->m_remoteScanProgress_->hide();
+                    self->m_remoteScanProgress_->deleteLater();
+                    self->m_remoteScanProgress_.clear();
+                }
+                if (canceled) {
+                    self->statusBar()->showMessage(
+                        QCoreApplication::translate(
+                            "MainWindow", "Synchronization canceled"),
+                        4000);
+                    return;
+                }
+                if (!self->rightIsRemote_ || !self->transferMgr_) {
+                    self->statusBar()->showMessage(
+                        QCoreApplication::translate(
+                            "MainWindow",
+                            "Synchronization scan finished, but the session "
+                            "is no longer active"),
+                        5000);
+                    return;
+                }
+                self->startFolderSyncTransfers(
+                    upload, localRoot, remoteRoot, indexPath,
+                    std::move(settled), std::move(changed));
+
+                QString msg =
+                    QCoreApplication::translate(
+                        "MainWindow", "Synchronize: %1 changed, %2 unchanged")
+                        .arg(changedCount)
+                        .arg(settledCount);
+                if (removed > 0)
+                    msg += QString("  |  ") +
+                           QCoreApplication::translate(
+                               "MainWindow", "Missing at source (kept): %1")
+                               .arg(removed);
+                if (listFailures > 0)
+                    msg += QString("  |  ") +
+                           QCoreApplication::translate(
+                               "MainWindow", "Folders not listed: %1")
+                               .arg(listFailures);
+                self->statusBar()->showMessage(msg, 6000);
+            },
+            Qt::QueuedConnection);
+    }).detach();
+}
+
+void MainWindow::startFolderSyncTransfers(
+    bool upload, const QString &localRoot, const QString &remoteRoot,
+    const QString &indexPath, std::vector<openscp::SyncEntry> settled,
+    std::vector<openscp::SyncEntry> changed) {
+    // Entries join the new snapshot once their transfer is done; failed or
+    // removed tasks leave their files out, so the next run retries them.
+    struct SyncRunState {
+        QString indexPath;
+        std::vector<openscp::SyncEntry> settled;
+        std::unordered_map<quint64, std::vector<openscp::SyncEntry>> pending;
+        bool checkScheduled = false;
+    };
+    auto state = std::make_shared<SyncRunState>();
+    state->indexPath = indexPath;
+    state->settled = std::move(settled);
+
+    if (!changed.empty() && archiveBatchModeEnabled() &&
+        changed.size() >= (std::size_t)kArchiveBatchMinFiles) {
+        std::vector<std::string> files;
+        quint64 totalBytes = 0;
+        files.reserve(changed.size());
+        for (const auto &e : changed) {
+            files.push_back(e.path);
+            totalBytes += e.size;
+        }
+        const quint64 id =
+            upload ? transferMgr_->enqueueUploadBatch(
+                         localRoot, std::move(files), remoteRoot, totalBytes)
+                   : transferMgr_->enqueueDownloadBatch(
+                         remoteRoot, std::move(files), localRoot, totalBytes);
+        state->pending.emplace(id, std::move(changed));
+    } else {
+        const QDir local(localRoot);
+        QVector<TransferRequest> requests;
+        requests.reserve(static_cast<int>(changed.size()));
+        for (const auto &e : changed) {
+            const QString rel = QString::fromStdString(e.path);
+            const QString lpath = local.filePath(rel);
+            const QString rpath = joinRemotePath(remoteRoot, rel);
+            TransferRequest r;
+            r.type = upload ? TransferTask::Type::Upload
+                            : TransferTask::Type::Download;
+            r.src = upload ? lpath : rpath;
+            r.dst = upload ? rpath : lpath;
+            r.replaceExisting = true;
+            if (upload)
+                r.sizeHint = e.size;
+            requests.push_back(std::move(r));
+        }
+        // enqueueMany() hands out consecutive ids in request order.
+        const quint64 firstId = transferMgr_->enqueueMany(requests);
+        for (std::size_t i = 0; i < changed.size(); ++i)
+            state->pending[firstId + i].push_back(std::move(changed[i]));
+    }
+    if (!state->pending.empty())
+        maybeShowTransferQueue();
+
+    auto writeSnapshot = [state]() {
+        QDir().mkpath(QFileInfo(state->indexPath).absolutePath());
+        std::thread([state]() {
+            std::string err;
+            if (!openscp::SyncIndex::write(state->indexPath.toStdString(),
+                                           std::move(state->settled), err))
+                qCWarning(ocSync) << "Could not save sync index:"
+                                  << QString::fromStdString(err);
+        }).detach();
+    };
+    if (state->pending.empty()) {
+        writeSnapshot();
+        return;
+    }
+
+    auto connPtr = std::make_shared<QMetaObject::Connection>();
+    auto check = [this, state, connPtr, writeSnapshot]() {
+        state->checkScheduled = false;
+        if (state->pending.empty() || !transferMgr_)
+            return;
+        QVector<quint64> ids;
+        ids.reserve(static_cast<int>(state->pending.size()));
+        for (const auto &kv : state->pending)
+            ids.push_back(kv.first);
+        const auto tasks = transferMgr_->tasksSnapshot(ids);
+        std::unordered_map<quint64, TransferTask::Status> statusById;
+        for (const auto &t : tasks)
+            statusById.emplace(t.id, t.status);
+        for (auto it = state->pending.begin(); it != state->pending.end();) {
+            const auto st = statusById.find(it->first);
+            if (st == statusById.end() ||
+                st->second == TransferTask::Status::Error ||
+                st->second == TransferTask::Status::Canceled) {
+                it = state->pending.erase(it);
+                continue;
+            }
+            if (st->second == TransferTask::Status::Done) {
+                for (auto &e : it->second)
+                    state->settled.push_back(std::move(e));
+                it = state->pending.erase(it);
+                continue;
+            }
+            ++it;
+        }
+        if (state->pending.empty()) {
+            QObject::disconnect(*connPtr);
+            writeSnapshot();
+        }
+    };
+    // Enqueueing and progress emit tasksChanged at a high rate; coalesce
+    // the status checks.
+    *connPtr = connect(transferMgr_, &TransferManager::tasksChanged, this,
+                       [this, state, check]() {
+                           if (state->checkScheduled)
+                               return;
+                           state->checkScheduled = true;
+                           QTimer::singleShot(250, this, check);
+                       });
+    check();
+}
@@ -1,6 +1,7 @@
 // MainWindow transfer queue UI, remote prescan, and drag-and-drop handling.
 #include "MainWindow.hpp"
 #include "RemoteModel.hpp"
+#include "TransferManager.hpp"
 #include "TransferQueueDialog.hpp"
 #include "UiAlerts.hpp"
 
@@ -23,12 +24,18 @@
 #include <QTimer>
 
 #include <atomic>
+#include <chrono>
 #include <memory>
 #include <thread>
 
 static constexpr int NAME_COL = 0;
+// Prescans hand files to the transfer queue in batches of this size, or
+// sooner once a batch has been collecting for this long.
+static constexpr int kPrescanBatchFiles = 256;
+static constexpr auto kPrescanBatchInterval = std::chrono::milliseconds(200);
 static const char *kStagingBatchMime =
     "application/x-openscp-staging-batch";
+static const char *kRemoteItemsMime = "application/x-openscp-remote-items";
 
 static bool isValidEntryName(const QString &name, QString *why = nullptr) {
     if (name == "." || name == "..") {
@@ -109,7 +116,7 @@ static QRect centeredQueueRect(QWidget *dialog, QWidget *mainWindow) {
 
 void MainWindow::runRemoteDownloadPrescan(
     const QVector<RemoteDownloadSeed> &seeds, int initialSkipped,
-    bool dragAndDrop) {
+    bool dragAndDrop, std::shared_ptr<const openscp::SessionOptions> peer) {
     if (!rightIsRemote_ || !sftp_ || !rightRemoteModel_ || !transferMgr_) {
         UiAlerts::warning(this, tr("Remote"),
                           tr("No active remote session."));
@@ -162,24 +169,64 @@ void MainWindow::runRemoteDownloadPrescan(
     scanProgress->show();
 
     QPointer<MainWindow> self(this);
-    std::thread([self, seeds, initialSkipped, dragAndDrop, cancelRequested,
+    // Only touched on the UI thread: tasks handed to the queue so far.
+    auto queued = std::make_shared<int>(0);
+    const quint64 sessionSeq = m_remoteSessionSeq_;
+    std::thread([self, seeds, initialSkipped, dragAndDrop, peer,
+                 cancelRequested, queued, sessionSeq,
                  scanClient = std::move(scanClient)]() mutable {
-        QVector<QPair<QString, QString>> queuedPairs;
+        QVector<TransferRequest> batch;
         QVector<QPair<QString, QString>> stack;
         int skipped = initialSkipped;
         int scannedDirs = 0;
+        int found = 0;
         int listFailures = 0;
         QString lastError;
+        auto lastFlush = std::chrono::steady_clock::now();
 
-        for (const auto &seed : seeds) {
-            if (cancelRequested->load())
-                break;
-            if (seed.isDir) {
-                stack.push_back({seed.remotePath, seed.localPath});
-            } else {
-                queuedPairs.push_back({seed.remotePath, seed.localPath});
-            }
-        }
+        // Hand the files found so far to the queue, whose workers start on
+        // them while the scan goes on.
+        auto flushBatch = [&] {
+            lastFlush = std::chrono::steady_clock::now();
+            QObject *app = QCoreApplication::instance();
+            if (batch.isEmpty() || !app)
+                return;
+            QMetaObject::invokeMethod(
+                app,
+                [self, cancelRequested, queued, sessionSeq,
+                 part = std::move(batch)] {
+                    if (!self || cancelRequested->load())
+                        return;
+                    // A reconnect, even to the same server, ends the scan.
+                    if (!self->rightIsRemote_ || !self->sftp_ ||
+                        !self->transferMgr_ ||
+                        sessionSeq != self->m_remoteSessionSeq_) {
+                        cancelRequested->store(true);
+                        return;
+                    }
+                    const bool first = *queued == 0;
+                    self->transferMgr_->enqueueMany(part);
+                    *queued += static_cast<int>(part.size());
+                    if (first)
+                        self->maybeShowTransferQueue();
+                },
+                Qt::QueuedConnection);
+            batch.clear();
+        };
+        auto addFile = [&](const QString &remote, const QString &local) {
+            TransferRequest r;
+            r.type = peer ? TransferTask::Type::RemoteCopy
+                          : TransferTask::Type::Download;
+            r.src = remote;
+            r.dst = local;
+            r.peer = peer;
+            batch.push_back(std::move(r));
+            ++found;
+            if (batch.size() >= kPrescanBatchFiles ||
+                std::chrono::steady_clock::now() - lastFlush >=
+                    kPrescanBatchInterval)
+                flushBatch();
+        };
 
         auto postProgress = [&](int dirs, int files) {
             QObject *app = QCoreApplication::instance();
@@ -201,15 +248,27 @@ void MainWindow::runRemoteDownloadPrescan(
                 Qt::QueuedConnection);
         };
 
+        for (const auto &seed : seeds) {
+            if (cancelRequested->load())
+                break;
+            if (seed.isDir) {
+                stack.push_back({seed.remotePath, seed.localPath});
+            } else {
+                addFile(seed.remotePath, seed.localPath);
+            }
+        }
+
         while (!stack.isEmpty() && !cancelRequested->load()) {
             const auto pair = stack.back();
             stack.pop_back();
             const QString curR = pair.first;
             const QString curL = pair.second;
-            QDir().mkpath(curL);
+            // Server copies create their folders when they start.
+            if (!peer)
+                QDir().mkpath(curL);
             ++scannedDirs;
             if ((scannedDirs % 25) == 0)
-                postProgress(scannedDirs, queuedPairs.size());
+                postProgress(scannedDirs, found);
 
             std::vector<openscp::FileInfo> out;
             std::string lerr;
@@ -231,15 +290,18 @@ void MainWindow::runRemoteDownloadPrescan(
                 }
                 const QString childR =
                     (curR.endsWith('/') ? curR + ename : curR + "/" + ename);
-                const QString childL = QDir(curL).filePath(ename);
+                const QString childL = peer ? joinRemotePath(curL, ename)
+                                            : QDir(curL).filePath(ename);
                 if (e.is_dir) {
                     stack.push_back({childR, childL});
                 } else {
-                    queuedPairs.push_back({childR, childL});
+                    addFile(childR, childL);
                 }
             }
         }
 
+        if (!cancelRequested->load())
+            flushBatch();
         const bool canceled = cancelRequested->load();
         if (scanClient)
             scanClient->disconnect();
@@ -247,10 +309,11 @@ void MainWindow::runRemoteDownloadPrescan(
         QObject *app = QCoreApplication::instance();
         if (!app)
             return;
+        // Posted after the last batch, so `queued` is final when it runs.
         QMetaObject::invokeMethod(
             app,
-            [self, queuedPairs = std::move(queuedPairs), skipped, canceled,
-             dragAndDrop, listFailures, lastError]() mutable {
+            [self, queued, skipped, canceled, dragAndDrop, listFailures,
+             lastError, serverCopy = static_cast<bool>(peer)]() {
                 if (!self)
                     return;
 
@@ -262,16 +325,21 @@ void MainWindow::runRemoteDownloadPrescan(
                     self->m_remoteScanProgress_.clear();
                 }
 
+                const int enq = *queued;
                 if (canceled) {
-                    self->statusBar()->showMessage(
-                        QCoreApplication::translate("MainWindow",
-                                                    "Remote scan canceled"),
-                        4000);
+                    QString msg = QCoreApplication::translate(
+                        "MainWindow", "Remote scan canceled");
+                    if (enq > 0)
+                        msg += QString("  |  ") +
+                               QCoreApplication::translate(
+                                   "MainWindow", "Already queued: %1")
+                                   .arg(enq);
+                    self->statusBar()->showMessage(msg, 4000);
                     return;
                 }
 
-                if (!self->rightIsRemote_ || !self->sftp_ ||
-                    !self->transferMgr_) {
+                if (enq == 0 && (!self->rightIsRemote_ || !self->sftp_ ||
+                                 !self->transferMgr_)) {
                     self->statusBar()->showMessage(
                         QCoreApplication::translate(
                             "MainWindow",
@@ -281,14 +349,12 @@ void MainWindow::runRemoteDownloadPrescan(
                     return;
                 }
 
-                int enq = 0;
-                for (const auto &p : queuedPairs) {
-                    self->transferMgr_->enqueueDownload(p.first, p.second);
-                    ++enq;
-                }
-
                 QString msg =
-                    dragAndDrop
+                    serverCopy
+                        ? QCoreApplication::translate(
+                              "MainWindow",
+                              "Queued: %1 server-to-server copies")
+                    : dragAndDrop
                         ? QCoreApplication::translate(
                               "MainWindow", "Queued: %1 downloads (DND)")
                         : QCoreApplication::translate("MainWindow",
@@ -310,8 +376,92 @@ void MainWindow::runRemoteDownloadPrescan(
                                                        "Last error: ") +
                            lastError;
                 self->statusBar()->showMessage(msg, 6000);
-                if (enq > 0)
-                    self->maybeShowTransferQueue();
+            },
+            Qt::QueuedConnection);
+    }).detach();
+}
+
+void MainWindow::runLocalUploadPrescan(const QStringList &paths,
+                                       const QString &remoteBase) {
+    if (!transferMgr_ || paths.isEmpty())
+        return;
+    // Stops the scan once the session it uploads to is gone.
+    auto stop = std::make_shared<std::atomic<bool>>(false);
+    auto queued = std::make_shared<int>(0);
+    QPointer<MainWindow> self(this);
+    const quint64 sessionSeq = m_remoteSessionSeq_;
+    std::thread([self, paths, remoteBase, stop, queued, sessionSeq]() {
+        QVector<TransferRequest> batch;
+        auto lastFlush = std::chrono::steady_clock::now();
+        auto flushBatch = [&] {
+            lastFlush = std::chrono::steady_clock::now();
+            QObject *app = QCoreApplication::instance();
+            if (batch.isEmpty() || !app)
+                return;
+            QMetaObject::invokeMethod(
+                app,
+                [self, stop, queued, sessionSeq, part = std::move(batch)] {
+                    if (!self || !self->rightIsRemote_ || !self->sftp_ ||
+                        !self->transferMgr_ ||
+                        sessionSeq != self->m_remoteSessionSeq_) {
+                        stop->store(true);
+                        return;
+                    }
+                    const bool first = *queued == 0;
+                    self->transferMgr_->enqueueMany(part);
+                    *queued += static_cast<int>(part.size());
+                    if (first)
+                        self->maybeShowTransferQueue();
+                },
+                Qt::QueuedConnection);
+            batch.clear();
+        };
+        auto addFile = [&](const QFileInfo &fi, const QString &rel) {
+            TransferRequest r;
+            r.type = TransferTask::Type::Upload;
+            r.src = fi.filePath();
+            r.dst = joinRemotePath(remoteBase, rel);
+            r.sizeHint = static_cast<quint64>(fi.size());
+            batch.push_back(std::move(r));
+            if (batch.size() >= kPrescanBatchFiles ||
+                std::chrono::steady_clock::now() - lastFlush >=
+                    kPrescanBatchInterval)
+                flushBatch();
+        };
+
+        for (const QString &p : paths) {
+            if (stop->load())
+                break;
+            const QFileInfo fi(p);
+            if (fi.isDir()) {
+                const QDir root(p);
+                QDirIterator it(p, QDir::NoDotAndDotDot | QDir::AllEntries,
+                                QDirIterator::Subdirectories);
+                while (it.hasNext() && !stop->load()) {
+                    it.next();
+                    const QFileInfo sfi = it.fileInfo();
+                    if (sfi.isFile())
+                        addFile(sfi, root.relativeFilePath(sfi.filePath()));
+                }
+            } else if (fi.isFile()) {
+                addFile(fi, fi.fileName());
+            }
+        }
+        flushBatch();
+
+        QObject *app = QCoreApplication::instance();
+        if (!app)
+            return;
+        QMetaObject::invokeMethod(
+            app,
+            [self, queued] {
+                if (!self || *queued == 0)
+                    return;
+                self->statusBar()->showMessage(
+                    QCoreApplication::translate("MainWindow",
+                                                "Queued: %1 uploads (DND)")
+                        .arg(*queued),
+                    4000);
             },
             Qt::QueuedConnection);
     }).detach();
@@ -440,6 +590,16 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *ev) {
             return true;
         } else if (ev->type() == QEvent::Drop) {
             auto *dd = static_cast<QDropEvent *>(ev);
+            // A lazy remote drag would stage its files if asked for URLs.
+            if (dd->mimeData() &&
+                dd->mimeData()->hasFormat(kRemoteItemsMime)) {
+                statusBar()->showMessage(
+                    tr("Drop ignored: remote-origin drag cannot be dropped "
+                       "back into the same remote panel"),
+                    5000);
+                dd->ignore();
+                return true;
+            }
             const QString stagingBatchDir =
                 extractStagingBatchDir(dd->mimeData());
             const auto urls =
@@ -470,41 +630,15 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *ev) {
                     dd->acceptProposedAction();
                     return true;
                 }
-                const QString remoteBase = rightRemoteModel_->rootPath();
-                int enq = 0;
+                // Scanned in the background; uploads start with the first
+                // batch of files found.
+                QStringList paths;
                 for (const QUrl &u : urls) {
                     const QString p = u.toLocalFile();
-                    if (p.isEmpty())
-                        continue;
-                    QFileInfo fi(p);
-                    if (fi.isDir()) {
-                        QDirIterator it(p,
-                                        QDir::NoDotAndDotDot | QDir::AllEntries,
-                                        QDirIterator::Subdirectories);
-                        while (it.hasNext()) {
-                            it.next();
-                            if (!it.fileInfo().isFile())
-                                continue;
-                            const QString rel =
-                                QDir(p).relativeFilePath(it.filePath());
-                            const QString rTarget =
-                                joinRemotePath(remoteBase, rel);
-                            transferMgr_->enqueueUpload(it.filePath(), rTarget);
-                            ++enq;
-                        }
-                    } else if (fi.isFile()) {
-                        const QString rTarget =
-                            joinRemotePath(remoteBase, fi.fileName());
-                        transferMgr_->enqueueUpload(fi.absoluteFilePath(),
-                                                    rTarget);
-                        ++enq;
-                    }
-                }
-                if (enq > 0) {
-                    statusBar()->showMessage(
-                        QString(tr("Queued: %1 uploads (DND)")).arg(enq), 4000);
-                    maybeShowTransferQueue();
+                    if (!p.isEmpty())
+                        paths.push_back(p);
                 }
+                runLocalUploadPrescan(paths, rightRemoteModel_->rootPath());
                 dd->acceptProposedAction();
                 return true;
             } else {
@@ -549,8 +683,13 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *ev) {
             auto *dd = static_cast<QDropEvent *>(ev);
             const QString stagingBatchDir =
                 extractStagingBatchDir(dd->mimeData());
-            const auto urls =
-                dd->mimeData() ? dd->mimeData()->urls() : QList<QUrl>{};
+            // A lazy remote drag from the right panel: download the
+            // selection through the queue instead of staging it first.
+            const bool remoteDrag = dd->mimeData() &&
+                                    dd->mimeData()->hasFormat(kRemoteItemsMime);
+            const auto urls = (dd->mimeData() && !remoteDrag)
+                                  ? dd->mimeData()->urls()
+                                  : QList<QUrl>{};
             if (!urls.isEmpty()) {
                 // Local copy towards the left panel
                 QDir dst(leftPath_->text());
@@ -0,0 +1,276 @@
+// Paged remote file viewer with a tail -f mode.
+#include "RemoteFileViewerDialog.hpp"
+#include "openscp/ClientFactory.hpp"
+#include "openscp/RemoteFileView.hpp"
+#include <QCheckBox>
+#include <QCoreApplication>
+#include <QDialogButtonBox>
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLocale>
+#include <QMetaObject>
+#include <QPlainTextEdit>
+#include <QPointer>
+#include <QScrollBar>
+#include <QSignalBlocker>
+#include <QTextCursor>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+static constexpr quint64 kPageBytes = 256 * 1024;
+static constexpr int kFollowIntervalMs = 2000;
+// Lines kept while following; older ones scroll out of the editor.
+static constexpr int kMaxFollowLines = 200000;
+
+// The connection and block cache, used by one background request at a time
+// and released by whichever side lets go last.
+struct RemoteFileViewerDialog::Session {
+    std::mutex m;
+    openscp::SessionOptions opt;
+    std::string path;
+    std::unique_ptr<openscp::SftpClient> client;
+    std::unique_ptr<openscp::RemoteFileView> view;
+    std::atomic<bool> closing{false};
+
+    // Connect on first use. Caller holds m.
+    bool ensureOpen(std::string &err) {
+        if (view)
+            return true;
+        client = openscp::CreateConnectedClient(opt, err);
+        if (!client)
+            return false;
+        view = std::make_unique<openscp::RemoteFileView>(*client, path);
+        if (!view->refresh(err)) {
+            view.reset();
+            return false;
+        }
+        return true;
+    }
+    ~Session() {
+        if (client)
+            client->disconnect();
+    }
+};
+
+RemoteFileViewerDialog::RemoteFileViewerDialog(
+    const openscp::SessionOptions &opt, const QString &remotePath,
+    QWidget *parent)
+    : QDialog(parent), session_(std::make_shared<Session>()) {
+    session_->opt = opt;
+    session_->path = remotePath.toStdString();
+    setWindowTitle(tr("View %1").arg(remotePath));
+    resize(900, 600);
+
+    auto *lay = new QVBoxLayout(this);
+    auto *row = new QHBoxLayout();
+    text_ = new QPlainTextEdit(this);
+    text_->setReadOnly(true);
+    text_->setLineWrapMode(QPlainTextEdit::NoWrap);
+    text_->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    row->addWidget(text_, 1);
+    // Position in the file, one step per page.
+    pager_ = new QScrollBar(Qt::Vertical, this);
+    pager_->setRange(0, 0);
+    pager_->setPageStep(1);
+    row->addWidget(pager_);
+    lay->addLayout(row, 1);
+
+    auto *bottom = new QHBoxLayout();
+    status_ = new QLabel(tr("Opening…"), this);
+    bottom->addWidget(status_, 1);
+    follow_ = new QCheckBox(tr("Follow (tail -f)"), this);
+    bottom->addWidget(follow_);
+    auto *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    bottom->addWidget(buttons);
+    lay->addLayout(bottom);
+
+    followTimer_ = new QTimer(this);
+    followTimer_->setInterval(kFollowIntervalMs);
+    connect(followTimer_, &QTimer::timeout, this,
+            &RemoteFileViewerDialog::pollTail);
+    connect(pager_, &QScrollBar::valueChanged, this, [this](int v) {
+        // Paging back stops following the end.
+        if (follow_->isChecked() && static_cast<quint64>(v) + 1 < pageCount())
+            follow_->setChecked(false);
+        loadPage(static_cast<quint64>(v));
+    });
+    connect(follow_, &QCheckBox::toggled, this,
+            &RemoteFileViewerDialog::setFollowing);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    loadPage(0);
+}
+
+RemoteFileViewerDialog::~RemoteFileViewerDialog() {
+    // A running request stops at its next chunk; the session goes away
+    // with it.
+    session_->closing.store(true);
+}
+
+quint64 RemoteFileViewerDialog::pageCount() const {
+    return size_ == 0 ? 1 : (size_ + kPageBytes - 1) / kPageBytes;
+}
+
+void RemoteFileViewerDialog::loadPage(quint64 page) {
+    if (busy_) {
+        pendingPage_ = static_cast<qint64>(page);
+        return;
+    }
+    busy_ = true;
+    QPointer<RemoteFileViewerDialog> self(this);
+    std::thread([self, s = session_, page] {
+        QByteArray bytes;
+        quint64 size = 0;
+        QString error;
+        {
+            std::lock_guard<std::mutex> lk(s->m);
+            std::string err;
+            std::string out;
+            if (s->ensureOpen(err) &&
+                s->view->read(page * kPageBytes, kPageBytes, out, err,
+                              [s] { return s->closing.load(); })) {
+                bytes = QByteArray(out.data(), static_cast<int>(out.size()));
+            } else {
+                error = QString::fromStdString(err);
+            }
+            if (s->view)
+                size = s->view->size();
+        }
+        QObject *app = QCoreApplication::instance();
+        if (!app)
+            return;
+        QMetaObject::invokeMethod(
+            app,
+            [self, page, bytes, size, error] {
+                if (self)
+                    self->showPage(page, bytes, size, error);
+            },
+            Qt::QueuedConnection);
+    }).detach();
+}
+
+void RemoteFileViewerDialog::showPage(quint64 page, const QByteArray &bytes,
+                                      quint64 size, const QString &error) {
+    busy_ = false;
+    size_ = size;
+    if (!error.isEmpty()) {
+        status_->setText(tr("Could not read the file: %1").arg(error));
+    } else {
+        page_ = page;
+        // Pages are cut at byte offsets; a character split at the edge
+        // shows as a replacement mark.
+        text_->setPlainText(QString::fromUtf8(bytes));
+        if (follow_->isChecked())
+            text_->moveCursor(QTextCursor::End);
+        updateStatus();
+    }
+    {
+        QSignalBlocker block(pager_);
+        pager_->setRange(0, static_cast<int>(pageCount() - 1));
+        pager_->setValue(static_cast<int>(page_));
+    }
+    if (pendingPage_ >= 0) {
+        const quint64 next = static_cast<quint64>(pendingPage_);
+        pendingPage_ = -1;
+        if (next != page_)
+            loadPage(next);
+    }
+}
+
+void RemoteFileViewerDialog::setFollowing(bool on) {
+    text_->setMaximumBlockCount(on ? kMaxFollowLines : 0);
+    if (!on) {
+        followTimer_->stop();
+        return;
+    }
+    // Start from the last page; the timer appends from there on.
+    loadPage(pageCount() - 1);
+    followTimer_->start();
+}
+
+void RemoteFileViewerDialog::pollTail() {
+    if (busy_)
+        return;
+    busy_ = true;
+    QPointer<RemoteFileViewerDialog> self(this);
+    std::thread([self, s = session_] {
+        QByteArray bytes;
+        quint64 size = 0;
+        bool truncated = false;
+        QString error;
+        {
+            std::lock_guard<std::mutex> lk(s->m);
+            std::string err;
+            std::string appended;
+            std::uint64_t at = 0;
+            if (s->ensureOpen(err) &&
+                s->view->follow(appended, at, truncated, err, kPageBytes,
+                                [s] { return s->closing.load(); })) {
+                bytes = QByteArray(appended.data(),
+                                   static_cast<int>(appended.size()));
+            } else {
+                error = QString::fromStdString(err);
+            }
+            if (s->view)
+                size = s->view->size();
+        }
+        QObject *app = QCoreApplication::instance();
+        if (!app)
+            return;
+        QMetaObject::invokeMethod(
+            app,
+            [self, bytes, size, truncated, error] {
+                if (self)
+                    self->showAppended(bytes, size, truncated, error);
+            },
+            Qt::QueuedConnection);
+    }).detach();
+}
+
+void RemoteFileViewerDialog::showAppended(const QByteArray &bytes,
+                                          quint64 size, bool truncated,
+                                          const QString &error) {
+    busy_ = false;
+    if (!error.isEmpty()) {
+        status_->setText(tr("Could not read the file: %1").arg(error));
+        return;
+    }
+    size_ = size;
+    if (truncated) {
+        // Rotated or truncated: show the new end of the file.
+        text_->clear();
+        loadPage(pageCount() - 1);
+        return;
+    }
+    if (!bytes.isEmpty()) {
+        text_->moveCursor(QTextCursor::End);
+        text_->insertPlainText(QString::fromUtf8(bytes));
+        text_->moveCursor(QTextCursor::End);
+    }
+    page_ = pageCount() - 1;
+    {
+        QSignalBlocker block(pager_);
+        pager_->setRange(0, static_cast<int>(pageCount() - 1));
+        pager_->setValue(static_cast<int>(page_));
+    }
+    updateStatus();
+    if (pendingPage_ >= 0) {
+        const quint64 next = static_cast<quint64>(pendingPage_);
+        pendingPage_ = -1;
+        loadPage(next);
+    }
+}
+
+void RemoteFileViewerDialog::updateStatus() {
+    const QLocale loc;
+    const quint64 from = page_ * kPageBytes;
+    status_->setText(tr("Page %1 of %2  |  from byte %3 of %4")
+                         .arg(page_ + 1)
+                         .arg(pageCount())
+                         .arg(loc.toString(static_cast<qulonglong>(from)))
+                         .arg(loc.toString(static_cast<qulonglong>(size_))));
+}
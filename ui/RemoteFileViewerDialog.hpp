@@ -0,0 +1,49 @@
+// Read-only viewer for large remote text files such as logs.
+#pragma once
+#include "openscp/SftpTypes.hpp"
+#include <QDialog>
+#include <QString>
+#include <memory>
+
+class QCheckBox;
+class QLabel;
+class QPlainTextEdit;
+class QScrollBar;
+class QTimer;
+
+// Shows one page of a remote file at a time, fetched on demand through
+// openscp::RemoteFileView over its own connection, so multi-GB files open
+// without a download. "Follow" tails the file like `tail -f`, polling its
+// size and appending only the new bytes.
+class RemoteFileViewerDialog : public QDialog {
+    Q_OBJECT
+    public:
+    RemoteFileViewerDialog(const openscp::SessionOptions &opt,
+                           const QString &remotePath,
+                           QWidget *parent = nullptr);
+    ~RemoteFileViewerDialog() override;
+
+    private:
+    struct Session;
+
+    void loadPage(quint64 page);
+    void showPage(quint64 page, const QByteArray &bytes, quint64 size,
+                  const QString &error);
+    void setFollowing(bool on);
+    void pollTail();
+    void showAppended(const QByteArray &bytes, quint64 size, bool truncated,
+                      const QString &error);
+    void updateStatus();
+    quint64 pageCount() const;
+
+    std::shared_ptr<Session> session_;
+    QPlainTextEdit *text_ = nullptr;
+    QScrollBar *pager_ = nullptr;
+    QLabel *status_ = nullptr;
+    QCheckBox *follow_ = nullptr;
+    QTimer *followTimer_ = nullptr;
+    quint64 size_ = 0;
+    quint64 page_ = 0;
+    bool busy_ = false; // a request is running on the session
+    qint64 pendingPage_ = -1; // page asked for while busy
+};
@@ -1,7 +1,11 @@
 // Remote model implementation (table: Name, Size, Date, Permissions).
 #include "RemoteModel.hpp"
 #include "TimeUtils.hpp"
+#include "openscp/ClientFactory.hpp"
+#include "openscp/ListingCache.hpp"
+#include "openscp/ListingPrefetcher.hpp"
 #include "openscp/RuntimeLogging.hpp"
+#include <QAnyStringView>
 #include <QApplication>
 #include <QCoreApplication>
 #include <QDateTime>
@@ -17,10 +21,21 @@
 #include <QStyle>
 #include <QVariant>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <iterator>
+#include <mutex>
+#include <numeric>
 #include <thread>
 
 Q_LOGGING_CATEGORY(ocEnum, "openscp.enum")
+
+// Minimum spacing between streamed listing batches posted to the UI thread.
+static constexpr std::chrono::milliseconds kListStreamInterval{100};
+// Subfolders of the loaded folder queued for prefetching, in view order.
+static constexpr std::size_t kPrefetchMaxSubfolders = 16;
 #include <QDir>
 #include <QLocale>
 #include <QMimeData>
@@ -31,10 +46,12 @@ Q_LOGGING_CATEGORY(ocEnum, "openscp.enum")
 RemoteModel::RemoteModel(openscp::SftpClient *client, QObject *parent)
     : QAbstractTableModel(parent), client_(client) {}
 
+RemoteModel::~RemoteModel() = default;
+
 int RemoteModel::rowCount(const QModelIndex &parent) const {
     if (parent.isValid())
         return 0;
-    return static_cast<int>(items_.size());
+    return static_cast<int>(rows_.size());
 }
 
 static QIcon remoteFolderIcon() {
@@ -137,14 +154,22 @@ static QIcon iconForRemoteEntry(const QString &name, bool isDir, bool isLink) {
     return icon;
 }
 
+static QString utf8Name(const openscp::CompactListing &listing,
+                        std::size_t i) {
+    const std::string_view name = listing.name(i);
+    return QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size()));
+}
+
 QVariant RemoteModel::data(const QModelIndex &index, int role) const {
     if (!index.isValid() || index.row() < 0 ||
-        index.row() >= (int)items_.size())
+        index.row() >= (int)rows_.size())
         return {};
-    const auto &it = items_[index.row()];
-    const bool isLnk = (it.mode & 0120000u) == 0120000u; // S_IFLNK
+    const std::uint32_t i = rows_[index.row()];
+    const bool itIsDir = listing_.isDir(i);
+    const quint32 itMode = listing_.mode(i);
+    const bool isLnk = (itMode & 0120000u) == 0120000u; // S_IFLNK
     if (role == Qt::DecorationRole && index.column() == 0) {
-        return iconForRemoteEntry(it.name, it.isDir, isLnk);
+        return iconForRemoteEntry(utf8Name(listing_, i), itIsDir, isLnk);
     }
     if (role == Qt::DisplayRole) {
         switch (index.column()) {
@@ -152,29 +177,29 @@ QVariant RemoteModel::data(const QModelIndex &index, int role) const {
             QString suffix;
             if (isLnk)
                 suffix = "@";
-            else if (it.isDir)
+            else if (itIsDir)
                 suffix = "/";
-            return it.name + suffix;
+            return utf8Name(listing_, i) + suffix;
         }
         case 1:
-            if (it.isDir)
+            if (itIsDir)
                 return QVariant();
-            if (!it.hasSize)
+            if (!listing_.hasSize(i))
                 return QStringLiteral("—");
-            return QLocale().formattedDataSize((qint64)it.size, 1,
-                                               QLocale::DataSizeIecFormat);
+            return QLocale().formattedDataSize((qint64)listing_.fileSize(i),
+                                               1, QLocale::DataSizeIecFormat);
         case 2:
-            if (it.mtime > 0)
-                return openscpui::localShortTime(it.mtime);
+            if (listing_.mtime(i) > 0)
+                return openscpui::localShortTime(listing_.mtime(i));
             else
                 return QVariant();
         case 3: {
             // Permissions in rwxr-xr-x style
             QString s(10, '-');
-            const quint32 m = it.mode;
+            const quint32 m = itMode;
             // file type
             bool isLnk = (m & 0120000u) == 0120000u;
-            s[0] = isLnk ? 'l' : (it.isDir ? 'd' : '-');
+            s[0] = isLnk ? 'l' : (itIsDir ? 'd' : '-');
             auto bit = [&](int pos, quint32 mask, QChar ch) {
                 if (m & mask)
                     s[pos] = ch;
@@ -193,19 +218,19 @@ QVariant RemoteModel::data(const QModelIndex &index, int role) const {
         }
     }
     if (role == Qt::ToolTipRole) {
-        const auto &it = items_[index.row()];
-        if (it.isDir)
+        if (itIsDir)
             return tr("Folder");
-        if (!it.hasSize) {
+        if (!listing_.hasSize(i)) {
             return tr("Size: unknown (not provided by the server)");
         }
+        const quint64 size = listing_.fileSize(i);
         QString tip = tr("File");
         const QString human = QLocale().formattedDataSize(
-            (qint64)it.size, 1, QLocale::DataSizeIecFormat);
-        const QString bytes = QLocale().toString((qulonglong)it.size);
+            (qint64)size, 1, QLocale::DataSizeIecFormat);
+        const QString bytes = QLocale().toString((qulonglong)size);
         tip += QString(" • %1 (%2 bytes)").arg(human, bytes);
-        if (it.mtime > 0)
-            tip += " • " + openscpui::localShortTime(it.mtime);
+        if (listing_.mtime(i) > 0)
+            tip += " • " + openscpui::localShortTime(listing_.mtime(i));
         return tip;
     }
     return {};
@@ -217,6 +242,60 @@ Qt::ItemFlags RemoteModel::flags(const QModelIndex &index) const {
     return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
 }
 
+std::string RemoteModel::collationKey(std::string_view name) {
+    // Plain ASCII (the common case) folds without leaving UTF-8.
+    std::string key(name);
+    bool ascii = true;
+    for (char &c : key) {
+        const unsigned char u = static_cast<unsigned char>(c);
+        if (u >= 0x80) {
+            ascii = false;
+            break;
+        }
+        if (u >= 'A' && u <= 'Z')
+            c = static_cast<char>(u - 'A' + 'a');
+    }
+    if (ascii)
+        return key;
+    const QByteArray folded =
+        QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size()))
+            .toCaseFolded()
+            .toUtf8();
+    return std::string(folded.constData(),
+                       static_cast<std::size_t>(folded.size()));
+}
+
+openscp::CompactListing
+RemoteModel::compactFromListing(const std::vector<openscp::FileInfo> &listing,
+                                bool showHidden) {
+    openscp::CompactListing compact;
+    compact.reserve(listing.size());
+    for (const auto &f : listing) {
+        if (!showHidden && !f.name.empty() && f.name.front() == '.')
+            continue;
+        compact.push_back(f, collationKey(f.name));
+    }
+    return compact;
+}
+
+bool RemoteModel::sameRows(const openscp::CompactListing &a,
+                           const std::vector<std::uint32_t> &aRows,
+                           const openscp::CompactListing &b,
+                           const std::vector<std::uint32_t> &bRows) {
+    if (aRows.size() != bRows.size())
+        return false;
+    for (std::size_t i = 0; i < aRows.size(); ++i) {
+        if (!a.sameEntry(aRows[i], b, bRows[i]))
+            return false;
+    }
+    return true;
+}
+
+void RemoteModel::invalidateCachedListing(const QString &path) {
+    if (listingCache_)
+        listingCache_->invalidate(path.toStdString());
+}
+
 bool RemoteModel::setRootPath(const QString &path, QString *errorOut,
                               bool async) {
     if (!client_) {
@@ -234,6 +313,9 @@ bool RemoteModel::setRootPath(const QString &path, QString *errorOut,
         normalized.chop(1);
 
     const quint64 reqId = ++listRequestSeq_;
+    stashed_.reset();
+    if (prefetcher_)
+        prefetcher_->cancel();
     const bool showHiddenNow = showHidden_;
     const int sortColNow = sortColumn_;
     const Qt::SortOrder sortOrdNow = sortOrder_;
@@ -248,17 +330,11 @@ bool RemoteModel::setRootPath(const QString &path, QString *errorOut,
             return false;
         }
 
-        std::vector<Item> nextItems;
-        nextItems.reserve(out.size());
-        for (const auto &f : out) {
-            const QString name = QString::fromStdString(f.name);
-            if (!showHiddenNow && name.startsWith('.'))
-                continue;
-            nextItems.push_back({name, f.is_dir, f.size, f.has_size, f.mtime,
-                                 f.mode, f.uid, f.gid});
-        }
-        sortItemsVector(nextItems, sortColNow, sortOrdNow);
-        replaceItems(std::move(nextItems), normalized);
+        openscp::CompactListing next = compactFromListing(out, showHiddenNow);
+        std::vector<std::uint32_t> rows =
+            sortedRows(next, sortColNow, sortOrdNow);
+        replaceListing(std::move(next), std::move(rows), normalized);
+        schedulePrefetch(reqId);
         return true;
     }
 
@@ -268,16 +344,72 @@ bool RemoteModel::setRootPath(const QString &path, QString *errorOut,
         return false;
     }
 
+    QPointer<RemoteModel> self(this);
+    // A cached listing renders immediately; a stale one is then revalidated
+    // in the background and only repainted if the server's answer differs.
+    bool revalidating = false;
+    if (listingCache_) {
+        std::vector<openscp::FileInfo> cached;
+        bool fresh = false;
+        if (listingCache_->lookup(normalized.toStdString(), cached, &fresh)) {
+            openscp::CompactListing next =
+                compactFromListing(cached, showHiddenNow);
+            std::vector<std::uint32_t> rows =
+                sortedRows(next, sortColNow, sortOrdNow);
+            replaceListing(std::move(next), std::move(rows), normalized);
+            QMetaObject::invokeMethod(
+                this,
+                [self, reqId, normalized] {
+                    if (self && reqId == self->listRequestSeq_.load())
+                        emit self->rootPathLoaded(normalized, true, QString());
+                },
+                Qt::QueuedConnection);
+            if (fresh) {
+                schedulePrefetch(reqId);
+                return true;
+            }
+            revalidating = true;
+        }
+    }
+
     openscp::SftpClient *baseClient = client_;
     const openscp::SessionOptions optNow = *sessionOpt_;
-    QPointer<RemoteModel> self(this);
-    std::thread([self, reqId, normalized, showHiddenNow, sortColNow,
-                 sortOrdNow, baseClient, optNow]() mutable {
+    std::thread([self, reqId, normalized, showHiddenNow, baseClient, optNow,
+                 revalidating]() mutable {
         std::vector<openscp::FileInfo> out;
         std::string err;
         bool ok = false;
         QString qerr;
 
+        bool streamed = false; // rows already handed to the model
+        auto postStreamBatch = [&](const std::vector<openscp::FileInfo> &batch,
+                                   bool first) {
+            QObject *app = QCoreApplication::instance();
+            if (!app)
+                return;
+            // Pack the batch here so the UI thread only merges indexes.
+            openscp::CompactListing compact =
+                compactFromListing(batch, showHiddenNow);
+            QMetaObject::invokeMethod(
+                app,
+                [self, reqId, normalized, first,
+                 compact = std::move(compact)]() mutable {
+                    if (!self || reqId != self->listRequestSeq_.load())
+                        return;
+                    if (!first) {
+                        self->mergeListingBatch(std::move(compact));
+                        return;
+                    }
+                    std::vector<std::uint32_t> rows = sortedRows(
+                        compact, self->sortColumn_, self->sortOrder_);
+                    self->stashListing(reqId);
+                    self->replaceListing(std::move(compact), std::move(rows),
+                                         normalized);
+                    emit self->rootPathLoaded(normalized, true, QString());
+                },
+                Qt::QueuedConnection);
+        };
+
         std::unique_ptr<openscp::SftpClient> listClient;
         std::string connErr;
         if (!self || !baseClient) {
@@ -288,10 +420,33 @@ bool RemoteModel::setRootPath(const QString &path, QString *errorOut,
                 qerr = connErr.empty()
                            ? QStringLiteral("Could not start remote listing")
                            : QString::fromStdString(connErr);
-            } else {
+            } else if (revalidating) {
                 ok = listClient->list(normalized.toStdString(), out, err);
                 if (!ok)
                     qerr = QString::fromStdString(err);
+            } else {
+                // Rows stream in while the directory is read. The first
+                // batch paints at once; later ones are coalesced so the UI
+                // thread merges a few large runs instead of many small ones.
+                auto lastPost = std::chrono::steady_clock::now();
+                ok = listClient->listStream(
+                    normalized.toStdString(),
+                    [&](std::vector<openscp::FileInfo> &&batch) {
+                        out.insert(out.end(),
+                                   std::make_move_iterator(batch.begin()),
+                                   std::make_move_iterator(batch.end()));
+                        const auto now = std::chrono::steady_clock::now();
+                        if (streamed && now - lastPost < kListStreamInterval)
+                            return true;
+                        postStreamBatch(out, !streamed);
+                        out.clear();
+                        streamed = true;
+                        lastPost = now;
+                        return true;
+                    },
+                    err);
+                if (!ok)
+                    qerr = QString::fromStdString(err);
             }
         }
         if (listClient)
@@ -304,102 +459,263 @@ bool RemoteModel::setRootPath(const QString &path, QString *errorOut,
             return;
         QMetaObject::invokeMethod(
             app,
-            [self, reqId, normalized, ok, qerr, out = std::move(out),
-             showHiddenNow, sortColNow, sortOrdNow]() mutable {
+            [self, reqId, normalized, ok, qerr,
+             next = compactFromListing(out, showHiddenNow), revalidating,
+             streamed]() mutable {
                 if (!self)
                     return;
                 if (reqId != self->listRequestSeq_.load())
                     return;
                 if (!ok) {
+                    if (revalidating) {
+                        // Keep showing the cached rows; the next navigation
+                        // retries the server.
+                        qWarning(ocEnum) << "listing revalidation failed";
+                        return;
+                    }
+                    // A stream that broke after its first batch must not
+                    // leave a partial folder on screen as if complete.
+                    if (streamed && self->restoreStashedListing(reqId))
+                        emit self->rootPathLoaded(self->currentPath_, true,
+                                                  QString());
                     emit self->rootPathLoaded(normalized, false, qerr);
                     return;
                 }
-                std::vector<Item> nextItems;
-                nextItems.reserve(out.size());
-                for (const auto &f : out) {
-                    const QString name = QString::fromStdString(f.name);
-                    if (!showHiddenNow && name.startsWith('.'))
-                        continue;
-                    nextItems.push_back(
-                        {name, f.is_dir, f.size, f.has_size, f.mtime, f.mode,
-                         f.uid, f.gid});
+                self->stashed_.reset();
+                if (streamed) {
+                    // Batches never prefetch; the finished folder does, once.
+                    self->mergeListingBatch(std::move(next));
+                    self->schedulePrefetch(reqId);
+                    return;
                 }
-                self->sortItemsVector(nextItems, sortColNow, sortOrdNow);
-                self->replaceItems(std::move(nextItems), normalized);
+                std::vector<std::uint32_t> rows =
+                    sortedRows(next, self->sortColumn_, self->sortOrder_);
+                if (revalidating) {
+                    if (!RemoteModel::sameRows(next, rows, self->listing_,
+                                               self->rows_)) {
+                        self->replaceListing(std::move(next), std::move(rows),
+                                             normalized);
+                    }
+                    self->schedulePrefetch(reqId);
+                    return;
+                }
+                self->replaceListing(std::move(next), std::move(rows),
+                                     normalized);
                 emit self->rootPathLoaded(normalized, true, QString());
+                self->schedulePrefetch(reqId);
             },
             Qt::QueuedConnection);
     }).detach();
     return true;
 }
 
-void RemoteModel::replaceItems(std::vector<Item> &&nextItems,
-                               const QString &path) {
-    const int oldCount = static_cast<int>(items_.size());
+void RemoteModel::schedulePrefetch(quint64 reqId) {
+    if (!listingCache_ || !sessionOpt_.has_value() || !client_ ||
+        reqId == prefetchedReqId_)
+        return;
+    prefetchedReqId_ = reqId;
+    if (!prefetcher_) {
+        // A plain backend session: the prefetcher fills the cache itself,
+        // and must not depend on client_, which a reconnect may replace
+        // before this model is destroyed.
+        const openscp::SessionOptions optNow = *sessionOpt_;
+        prefetcher_ = std::make_unique<openscp::ListingPrefetcher>(
+            listingCache_, [optNow](std::string &err) {
+                return openscp::CreateConnectedClient(optNow, err);
+            });
+    }
+
+    const std::string current = currentPath_.toStdString();
+    std::vector<std::string> dirs;
+    if (current != "/")
+        dirs.push_back(openscp::ListingCache::parentPath(current));
+    const std::string prefix = (current == "/") ? current : current + "/";
+    std::size_t subfolders = 0;
+    for (std::uint32_t row : rows_) {
+        if (subfolders >= kPrefetchMaxSubfolders)
+            break;
+        if (!listing_.isDir(row))
+            continue;
+        dirs.push_back(prefix + std::string(listing_.name(row)));
+        ++subfolders;
+    }
+    prefetcher_->prefetch(std::move(dirs));
+}
+
+void RemoteModel::replaceListing(openscp::CompactListing &&listing,
+                                 std::vector<std::uint32_t> &&rows,
+                                 const QString &path) {
+    const int oldCount = static_cast<int>(rows_.size());
     if (oldCount > 0) {
         beginRemoveRows(QModelIndex(), 0, oldCount - 1);
-        items_.clear();
+        rows_.clear();
+        listing_.clear();
         endRemoveRows();
     } else {
-        items_.clear();
+        rows_.clear();
     }
-    const int newCount = static_cast<int>(nextItems.size());
+    listing_ = std::move(listing);
+    listing_.shrinkToFit();
+    const int newCount = static_cast<int>(rows.size());
     if (newCount > 0) {
         beginInsertRows(QModelIndex(), 0, newCount - 1);
-        items_ = std::move(nextItems);
+        rows_ = std::move(rows);
         endInsertRows();
     }
     currentPath_ = path;
 }
 
-void RemoteModel::sortItemsVector(std::vector<Item> &items, int column,
-                                  Qt::SortOrder order) const {
+void RemoteModel::stashListing(quint64 reqId) {
+    StashedListing stash;
+    stash.reqId = reqId;
+    stash.path = currentPath_;
+    const int oldCount = static_cast<int>(rows_.size());
+    if (oldCount > 0)
+        beginRemoveRows(QModelIndex(), 0, oldCount - 1);
+    stash.listing = std::move(listing_);
+    stash.rows = std::move(rows_);
+    listing_ = openscp::CompactListing();
+    rows_.clear();
+    if (oldCount > 0)
+        endRemoveRows();
+    stashed_ = std::move(stash);
+}
+
+bool RemoteModel::restoreStashedListing(quint64 reqId) {
+    if (!stashed_ || stashed_->reqId != reqId || stashed_->path.isEmpty()) {
+        stashed_.reset();
+        return false;
+    }
+    StashedListing stash = std::move(*stashed_);
+    stashed_.reset();
+    // The sort may have changed while the stream ran.
+    std::vector<std::uint32_t> rows =
+        sortedRows(stash.listing, sortColumn_, sortOrder_);
+    replaceListing(std::move(stash.listing), std::move(rows), stash.path);
+    return true;
+}
+
+bool RemoteModel::rowLess(const openscp::CompactListing &listing,
+                          std::uint32_t a, std::uint32_t b, int column,
+                          Qt::SortOrder order) {
     const bool asc = (order == Qt::AscendingOrder);
-    auto lessStr = [&](const QString &a, const QString &b) {
-        int cmp = QString::compare(a, b, Qt::CaseInsensitive);
+    auto lessName = [&] {
+        int cmp = 0;
+        if (listing.hasSortKeys()) {
+            // Keys were folded once when the listing landed; ties fall back
+            // to the raw bytes so the order stays deterministic.
+            cmp = listing.sortKey(a).compare(listing.sortKey(b));
+            if (cmp == 0)
+                cmp = listing.name(a).compare(listing.name(b));
+            return asc ? (cmp < 0) : (cmp > 0);
+        }
+        const std::string_view x = listing.name(a);
+        const std::string_view y = listing.name(b);
+        cmp = QAnyStringView::compare(
+            QUtf8StringView(x.data(), static_cast<qsizetype>(x.size())),
+            QUtf8StringView(y.data(), static_cast<qsizetype>(y.size())),
+            Qt::CaseInsensitive);
         return asc ? (cmp < 0) : (cmp > 0);
     };
-    auto less = [&](const Item &a, const Item &b) {
-        if (a.isDir != b.isDir)
-            return a.isDir && !b.isDir;
-        switch (column) {
-        case 0:
-            return lessStr(a.name, b.name);
-        case 1:
-            return asc ? (a.size < b.size) : (a.size > b.size);
-        case 2:
-            return asc ? (a.mtime < b.mtime) : (a.mtime > b.mtime);
-        case 3:
-            return asc ? (a.mode < b.mode) : (a.mode > b.mode);
-        default:
-            return lessStr(a.name, b.name);
-        }
+    const bool aDir = listing.isDir(a);
+    if (aDir != listing.isDir(b))
+        return aDir;
+    switch (column) {
+    case 0:
+        return lessName();
+    case 1:
+        return asc ? (listing.fileSize(a) < listing.fileSize(b))
+                   : (listing.fileSize(a) > listing.fileSize(b));
+    case 2:
+        return asc ? (listing.mtime(a) < listing.mtime(b))
+                   : (listing.mtime(a) > listing.mtime(b));
+    case 3:
+        return asc ? (listing.mode(a) < listing.mode(b))
+                   : (listing.mode(a) > listing.mode(b));
+    default:
+        return lessName();
+    }
+}
+
+std::vector<std::uint32_t>
+RemoteModel::sortedRows(const openscp::CompactListing &listing, int column,
+                        Qt::SortOrder order) {
+    std::vector<std::uint32_t> rows(listing.size());
+    std::iota(rows.begin(), rows.end(), 0u);
+    std::sort(rows.begin(), rows.end(),
+              [&](std::uint32_t a, std::uint32_t b) {
+                  return rowLess(listing, a, b, column, order);
+              });
+    return rows;
+}
+
+void RemoteModel::mergeListingBatch(openscp::CompactListing &&batch) {
+    if (batch.empty())
+        return;
+    const std::uint32_t base = static_cast<std::uint32_t>(listing_.size());
+    std::vector<std::uint32_t> added =
+        sortedRows(batch, sortColumn_, sortOrder_);
+    for (std::uint32_t &row : added)
+        row += base;
+    listing_.append(batch);
+
+    const int oldCount = static_cast<int>(rows_.size());
+    beginInsertRows(QModelIndex(), oldCount,
+                    oldCount + static_cast<int>(added.size()) - 1);
+    rows_.insert(rows_.end(), added.begin(), added.end());
+    endInsertRows();
+
+    auto less = [this](std::uint32_t a, std::uint32_t b) {
+        return rowLess(listing_, a, b, sortColumn_, sortOrder_);
     };
-    std::sort(items.begin(), items.end(), less);
+    if (oldCount == 0 || !less(rows_[oldCount], rows_[oldCount - 1]))
+        return; // the new rows already sort after the existing ones
+
+    // Merge the appended run into place (linear) as one layout change.
+    // Only the index permutation moves; the listing itself stays put.
+    emit layoutAboutToBeChanged();
+    const QModelIndexList persistent = persistentIndexList();
+    std::vector<std::uint32_t> persistentEntries;
+    persistentEntries.reserve(persistent.size());
+    for (const QModelIndex &idx : persistent)
+        persistentEntries.push_back(idx.isValid() ? rows_[idx.row()] : 0u);
+    std::inplace_merge(rows_.begin(), rows_.begin() + oldCount, rows_.end(),
+                       less);
+    std::vector<int> rowOf(listing_.size());
+    for (int r = 0; r < static_cast<int>(rows_.size()); ++r)
+        rowOf[rows_[r]] = r;
+    for (int k = 0; k < persistent.size(); ++k) {
+        const QModelIndex &idx = persistent[k];
+        if (idx.isValid()) {
+            changePersistentIndex(
+                idx, index(rowOf[persistentEntries[k]], idx.column()));
+        }
+    }
+    emit layoutChanged();
 }
 
 bool RemoteModel::isDir(const QModelIndex &idx) const {
     if (!idx.isValid())
         return false;
-    return items_[idx.row()].isDir;
+    return listing_.isDir(rows_[idx.row()]);
 }
 
 QString RemoteModel::nameAt(const QModelIndex &idx) const {
     if (!idx.isValid())
         return {};
-    return items_[idx.row()].name;
+    return utf8Name(listing_, rows_[idx.row()]);
 }
 
 bool RemoteModel::hasSize(const QModelIndex &idx) const {
     if (!idx.isValid())
         return false;
-    return items_[idx.row()].hasSize;
+    return listing_.hasSize(rows_[idx.row()]);
 }
 
 quint64 RemoteModel::sizeAt(const QModelIndex &idx) const {
     if (!idx.isValid())
         return 0;
-    return items_[idx.row()].size;
+    return listing_.fileSize(rows_[idx.row()]);
 }
 
 QVariant RemoteModel::headerData(int section, Qt::Orientation orientation,
@@ -478,11 +794,24 @@ bool RemoteModel::enumerateFilesUnderEx(
     const EnumOptions &opt, bool *partialErrorOut, bool *someSizeUnknownOut,
     quint64 *dirCountOut, quint64 *symlinkSkippedOut, quint64 *deniedCountOut,
     quint64 *unknownSizeCountOut) const {
+    return enumerateTree(client_, sessionOpt_, showHidden_, baseRemote, out,
+                         opt, partialErrorOut, someSizeUnknownOut,
+                         dirCountOut, symlinkSkippedOut, deniedCountOut,
+                         unknownSizeCountOut);
+}
+
+bool RemoteModel::enumerateTree(
+    openscp::SftpClient *client,
+    const std::optional<openscp::SessionOptions> &sessionOpt, bool showHidden,
+    const QString &baseRemote, std::vector<EnumeratedFile> &out,
+    const EnumOptions &opt, bool *partialErrorOut, bool *someSizeUnknownOut,
+    quint64 *dirCountOut, quint64 *symlinkSkippedOut, quint64 *deniedCountOut,
+    quint64 *unknownSizeCountOut) {
     if (partialErrorOut)
         *partialErrorOut = false;
     if (someSizeUnknownOut)
         *someSizeUnknownOut = false;
-    if (!client_) {
+    if (!client) {
         return false;
     }
 
@@ -492,7 +821,6 @@ bool RemoteModel::enumerateFilesUnderEx(
         return base.endsWith('/') ? base + name : base + "/" + name;
     };
     const QString base = normalizeRemotePath(baseRemote);
-    QSet<QString> visited;
     // Resolve max depth from settings if not provided or invalid
     int configuredMaxDepth = opt.maxDepth;
     if (configuredMaxDepth <= 0) {
@@ -501,77 +829,301 @@ bool RemoteModel::enumerateFilesUnderEx(
         if (configuredMaxDepth < 1)
             configuredMaxDepth = 32;
     }
+    // Extra sessions need the options to clone the model's connection.
+    const int maxSessions =
+        sessionOpt.has_value() ? std::clamp(opt.maxSessions, 1, 16) : 1;
+        auto canceled = [&opt] {
+        return opt.cancel && opt.cancel->load(std::memory_order_relaxed);
+    };
 
-    std::function<void(const QString &, const QString &, int)> walk;
-    walk = [&](const QString &cur, const QString &rel, int depth) {
-        if (opt.cancel && opt.cancel->load(std::memory_order_relaxed))
-            return;
+    // Breadth-first frontier shared by the listing threads. The calling
+    // thread only spawns listers, merges their results and delivers batches.
+    struct DirWork {
+        QString path;
+        QString rel;
+        int depth = 0;
+    };
+    struct WalkState {
+        std::mutex m;
+        std::condition_variable cv;
+        std::deque<DirWork> frontier;
+        QSet<QString> visited;
+        std::vector<EnumeratedFile> pending;
+        int inFlight = 0;   // directories being listed
+        int listers = 0;    // running lister threads
+        bool noMoreSessions = false;
+        bool stop = false;
+        bool partial = false;
+        bool someSizeUnknown = false;
+        quint64 dirs = 0, symlinks = 0, denied = 0, unknownSizes = 0;
+    } st;
+
+    // Queue a directory once (prevents cycles); called with st.m held.
+    auto pushDirLocked = [&](const QString &path, const QString &rel,
+                             int depth) {
         if (depth > configuredMaxDepth) {
             if (openscp::sensitiveLoggingEnabled()) {
-                qWarning(ocEnum) << "max depth reached at" << cur;
+                qWarning(ocEnum) << "max depth reached at" << path;
             } else {
                 qWarning(ocEnum)
                     << "max depth reached during remote enumeration";
             }
             return;
         }
-        const QString normCur = normalizeRemotePath(cur);
-        if (visited.contains(normCur))
-            return; // prevent cycles
-        visited.insert(normCur);
-        if (dirCountOut)
-            (*dirCountOut)++;
-
-        std::vector<openscp::FileInfo> children;
+        const QString norm = normalizeRemotePath(path);
+        if (st.visited.contains(norm))
+            return;
+        st.visited.insert(norm);
+        ++st.dirs;
+        st.frontier.push_back(DirWork{norm, rel, depth});
+    };
+
+    auto listerLoop = [&](openscp::SftpClient *client) {
+        for (;;) {
+            DirWork work;
+            {
+                std::unique_lock<std::mutex> lk(st.m);
+                st.cv.wait(lk, [&] {
+                    return st.stop || !st.frontier.empty() ||
+                           st.inFlight == 0;
+                });
+                if (st.stop || st.frontier.empty())
+                    break;
+                work = std::move(st.frontier.front());
+                st.frontier.pop_front();
+                ++st.inFlight;
+            }
+
+            std::vector<openscp::FileInfo> children;
+            std::string err;
+            const bool listed =
+                !canceled() && client->list(work.path.toStdString(), children,
+                                            err);
+            std::vector<EnumeratedFile> files;
+            std::vector<std::pair<QString, QString>> subdirs;
+            quint64 symlinks = 0, unknownSizes = 0;
+            if (listed) {
+                for (const auto &e : children) {
+                    const QString name = QString::fromStdString(e.name);
+                    if (!showHidden && name.startsWith('.'))
+                        continue;
+                    bool isSymlink = (e.mode & 0120000u) == 0120000u;
+                    if (isSymlink && opt.skipSymlinks) {
+                        ++symlinks;
+                        continue;
+                    }
+                    const QString childRemote = joinRemote(work.path, name);
+                    const QString childRel0 =
+                        work.rel.isEmpty() ? name : (work.rel + "/" + name);
+                    const QString childRel = sanitizeRelative(childRel0);
+                    if (childRel.isEmpty())
+                        continue;
+                    if (e.is_dir) {
+                        subdirs.emplace_back(childRemote, childRel);
+                    } else {
+                        if (!e.has_size)
+                            ++unknownSizes;
+                        files.push_back(EnumeratedFile{
+                            childRemote, childRel, (quint64)e.size,
+                            e.has_size, (quint64)e.mtime});
+                    }
+                }
+            } else if (!canceled()) {
+                if (openscp::sensitiveLoggingEnabled()) {
+                    qWarning(ocEnum)
+                        << "enumeration error at" << work.path << ":"
+                        << QString::fromStdString(err);
+                } else {
+                    qWarning(ocEnum)
+                        << "enumeration error during remote listing";
+                }
+            }
+
+            std::lock_guard<std::mutex> lk(st.m);
+            --st.inFlight;
+            if (!listed && !canceled()) {
+                st.partial = true;
+                ++st.denied;
+            }
+            st.symlinks += symlinks;
+            st.unknownSizes += unknownSizes;
+            if (unknownSizes > 0)
+                st.someSizeUnknown = true;
+            for (const auto &d : subdirs)
+                pushDirLocked(d.first, d.second, work.depth + 1);
+            for (auto &f : files)
+                st.pending.push_back(std::move(f));
+            st.cv.notify_all();
+        }
+        std::lock_guard<std::mutex> lk(st.m);
+        --st.listers;
+        st.cv.notify_all();
+    };
+
+    std::vector<std::thread> threads;
+    auto spawnListerLocked = [&](bool ownSession) {
+        ++st.listers;
+        if (!ownSession) {
+            threads.emplace_back([&] { listerLoop(client); });
+            return;
+        }
+        const openscp::SessionOptions optNow = *sessionOpt;
+        threads.emplace_back([&, optNow] {
+            std::shared_ptr<openscp::SftpClient> session;
+            if (opt.leaseSession)
+                session = opt.leaseSession();
+            if (!session) {
+                std::string connErr;
+                session = client->newConnectionLike(optNow, connErr);
+            }
+            if (!session) {
+                // Keep walking with the sessions we already have.
+                std::lock_guard<std::mutex> lk(st.m);
+                st.noMoreSessions = true;
+                --st.listers;
+                st.cv.notify_all();
+                return;
+            }
+            listerLoop(session.get());
+            if (opt.releaseSession && session->isConnected())
+                opt.releaseSession(std::move(session));
+            else
+                session->disconnect();
+        });
+    };
+
+    // Backends that enumerate a whole tree in bulk replace the walk; entries
+    // are filtered the same way the walk filters each directory.
+    const bool treeListing = client->capabilities().supports_tree_listing;
+    auto treeLister = [&] {
+        const QString basePrefix = (base == "/") ? base : base + "/";
         std::string err;
-        if (!client_->list(normCur.toStdString(), children, err)) {
+        const bool ok = client->listTree(
+            base.toStdString(),
+            [&](const std::string &parentStd, const openscp::FileInfo &e) {
+                if (canceled())
+                    return false;
+                const QString parent =
+                    normalizeRemotePath(QString::fromStdString(parentStd));
+                QString parentRel;
+                if (parent != base) {
+                    if (!parent.startsWith(basePrefix))
+                        return true;
+                    parentRel = parent.mid(basePrefix.size());
+                }
+                const QString name = QString::fromStdString(e.name);
+                const QString childRel0 =
+                    parentRel.isEmpty() ? name : (parentRel + "/" + name);
+                if (!showHidden) {
+                    // A hidden folder hides everything below it.
+                    const QStringList parts =
+                        childRel0.split('/', Qt::SkipEmptyParts);
+                    for (const QString &part : parts) {
+                        if (part.startsWith('.'))
+                            return true;
+                    }
+                }
+                const QString childRel = sanitizeRelative(childRel0);
+                if (childRel.isEmpty() ||
+                    int(childRel.count('/')) > configuredMaxDepth)
+                    return true;
+                const bool isSymlink = (e.mode & 0120000u) == 0120000u;
+                std::lock_guard<std::mutex> lk(st.m);
+                if (isSymlink && opt.skipSymlinks) {
+                    ++st.symlinks;
+                    return true;
+                }
+                if (e.is_dir) {
+                    ++st.dirs;
+                    return true;
+                }
+                if (!e.has_size) {
+                    ++st.unknownSizes;
+                    st.someSizeUnknown = true;
+                }
+                st.pending.push_back(EnumeratedFile{
+                    joinRemote(parent, name), childRel, (quint64)e.size,
+                    e.has_size, (quint64)e.mtime});
+                st.cv.notify_all();
+                return true;
+            },
+            err);
+        std::lock_guard<std::mutex> lk(st.m);
+        if (!ok && !canceled()) {
+            st.partial = true;
+            ++st.denied;
             if (openscp::sensitiveLoggingEnabled()) {
-                qWarning(ocEnum) << "enumeration error at" << normCur << ":"
+                qWarning(ocEnum) << "tree enumeration error at" << base << ":"
                                  << QString::fromStdString(err);
             } else {
                 qWarning(ocEnum) << "enumeration error during remote listing";
             }
-            if (partialErrorOut)
-                *partialErrorOut = true;
-            if (deniedCountOut)
-                (*deniedCountOut)++;
+        }
+        --st.listers;
+        st.cv.notify_all();
+    };
+
+    auto deliver = [&](std::vector<EnumeratedFile> &&batch) {
+        if (batch.empty())
+            return;
+        if (opt.onBatch) {
+            opt.onBatch(std::move(batch));
             return;
         }
-        for (const auto &e : children) {
-            if (opt.cancel && opt.cancel->load(std::memory_order_relaxed))
-                return;
-            const QString name = QString::fromStdString(e.name);
-            if (!showHidden_ && name.startsWith('.'))
-                continue;
-            bool isSymlink = (e.mode & 0120000u) == 0120000u;
-            if (isSymlink && opt.skipSymlinks) {
-                if (symlinkSkippedOut)
-                    (*symlinkSkippedOut)++;
-                continue;
+        out.insert(out.end(), std::make_move_iterator(batch.begin()),
+                   std::make_move_iterator(batch.end()));
+    };
+
+    {
+        std::unique_lock<std::mutex> lk(st.m);
+        pushDirLocked(base, QString(), 0);
+        if (treeListing) {
+            st.frontier.clear(); // the backend walks from the base itself
+            st.noMoreSessions = true;
+            ++st.listers;
+            threads.emplace_back(treeLister);
+        } else {
+            spawnListerLocked(false);
+        }
+        for (;;) {
+            // Open another session only while there is unclaimed work.
+            if (!st.stop && !st.noMoreSessions && st.listers < maxSessions &&
+                int(threads.size()) < maxSessions &&
+                int(st.frontier.size()) > st.listers - st.inFlight) {
+                spawnListerLocked(true);
             }
-            const QString childRemote = joinRemote(normCur, name);
-            const QString childRel0 = rel.isEmpty() ? name : (rel + "/" + name);
-            const QString childRel = sanitizeRelative(childRel0);
-            if (childRel.isEmpty())
+            if (!st.pending.empty()) {
+                std::vector<EnumeratedFile> batch;
+                batch.swap(st.pending);
+                lk.unlock();
+                deliver(std::move(batch));
+                lk.lock();
                 continue;
-            if (e.is_dir) {
-                walk(childRemote, childRel, depth + 1);
-                if (opt.cancel && opt.cancel->load(std::memory_order_relaxed))
-                    return;
-            } else {
-                quint64 sz = (quint64)e.size;
-                const bool hsz = e.has_size;
-                if (!hsz) {
-                    if (someSizeUnknownOut)
-                        *someSizeUnknownOut = true;
-                    if (unknownSizeCountOut)
-                        (*unknownSizeCountOut)++;
-                }
-                out.push_back(EnumeratedFile{childRemote, childRel, sz, hsz});
             }
+            if (st.listers == 0)
+                break;
+            if (!st.stop && canceled()) {
+                st.stop = true;
+                st.cv.notify_all();
+            }
+            st.cv.wait_for(lk, std::chrono::milliseconds(50));
         }
-    };
-    walk(base, QString(), 0);
+    }
+    for (auto &th : threads)
+        th.join();
+
+    if (partialErrorOut && st.partial)
+        *partialErrorOut = true;
+    if (someSizeUnknownOut && st.someSizeUnknown)
+        *someSizeUnknownOut = true;
+    if (dirCountOut)
+        *dirCountOut += st.dirs;
+    if (symlinkSkippedOut)
+        *symlinkSkippedOut += st.symlinks;
+    if (deniedCountOut)
+        *deniedCountOut += st.denied;
+    if (unknownSizeCountOut)
+        *unknownSizeCountOut += st.unknownSizes;
     return true;
 }
 
@@ -589,11 +1141,25 @@ bool RemoteModel::enumerateFilesUnder(const QString &baseRemote,
 }
 
 void RemoteModel::sort(int column, Qt::SortOrder order) {
+    const bool flipOnly = (column == sortColumn_ && order != sortOrder_);
     sortColumn_ = column;
     sortOrder_ = order;
-    if (items_.empty())
+    if (rows_.empty())
         return;
     emit layoutAboutToBeChanged();
-    sortItemsVector(items_, sortColumn_, sortOrder_);
+    if (flipOnly) {
+        // Same column, other direction: folders stay first, so reversing
+        // each group gives the new order without comparing anything.
+        auto firstFile = std::partition_point(
+            rows_.begin(), rows_.end(),
+            [this](std::uint32_t r) { return listing_.isDir(r); });
+        std::reverse(rows_.begin(), firstFile);
+        std::reverse(firstFile, rows_.end());
+    } else {
+        std::sort(rows_.begin(), rows_.end(),
+                  [this](std::uint32_t a, std::uint32_t b) {
+                      return rowLess(listing_, a, b, sortColumn_, sortOrder_);
+                  });
+    }
     emit layoutChanged();
 }
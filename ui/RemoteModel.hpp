@@ -1,17 +1,28 @@
 // Read-only model to list remote entries via SftpClient.
 #pragma once
+#include "openscp/CompactListing.hpp"
 #include "openscp/SftpClient.hpp"
 #include <QAbstractTableModel>
 #include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
+namespace openscp {
+class ListingCache;
+class ListingPrefetcher;
+}
+
 class RemoteModel : public QAbstractTableModel {
     Q_OBJECT
     public:
     explicit RemoteModel(openscp::SftpClient *client,
                          QObject *parent = nullptr);
+    ~RemoteModel() override;
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override {
@@ -37,6 +48,13 @@ class RemoteModel : public QAbstractTableModel {
     void setSessionOptions(const openscp::SessionOptions &opt) {
         sessionOpt_ = opt;
     }
+    // Per-session listing cache shared with the client (optional). Cached
+    // folders render instantly; stale ones are revalidated in background.
+    void setListingCache(std::shared_ptr<openscp::ListingCache> cache) {
+        listingCache_ = std::move(cache);
+    }
+    // Forget the cached listing of `path` so the next load hits the server.
+    void invalidateCachedListing(const QString &path);
 
     bool isDir(const QModelIndex &idx) const;
     QString nameAt(const QModelIndex &idx) const;
@@ -51,15 +69,32 @@ class RemoteModel : public QAbstractTableModel {
         QString relativePath; // relative to the enumerated base ("sub/file")
         quint64 size = 0;     // bytes
         bool hasSize = false; // true if size is known
+        quint64 mtime = 0;    // seconds since the epoch; 0 if unknown
     };
     struct EnumOptions {
         bool skipSymlinks = true;           // skip symlinks by default
         std::atomic_bool *cancel = nullptr; // cooperative cancel flag
         int maxDepth = 32;                  // maximum recursion depth
+        // Sessions listing directories concurrently (the model's client plus
+        // extra sessions taken on demand); 1 = serial walk.
+        int maxSessions = 4;
+        // Extra sessions are borrowed from leaseSession (e.g. the transfer
+        // pool's idle sessions) before a new one is opened with
+        // newConnectionLike(), which rides the multiplexed transport when
+        // the site enables it. Healthy sessions, borrowed or opened, go to
+        // releaseSession when the walk ends; without it they are closed.
+        std::function<std::shared_ptr<openscp::SftpClient>()> leaseSession;
+        std::function<void(std::shared_ptr<openscp::SftpClient>)>
+            releaseSession;
+        // If set, files are streamed here in batches (on the calling thread)
+        // as directories complete instead of being appended to `out`.
+        std::function<void(std::vector<EnumeratedFile> &&)> onBatch;
     };
-    // Recursively enumerate files under `baseRemote` (directories only).
-    // Returns true if finished without fatal error. partialErrorOut is set to
-    // true if some branches failed.
+    // Recursively enumerate files under `baseRemote` (directories only),
+    // breadth-first with up to opt.maxSessions listings in flight (or with
+    // the backend's bulk listTree() where it has one). Returns
+    // true if finished without fatal error. partialErrorOut is set to true if
+    // some branches failed. File order is not deterministic.
     bool enumerateFilesUnderEx(const QString &baseRemote,
                                std::vector<EnumeratedFile> &out,
                                const EnumOptions &opt, bool *partialErrorOut,
@@ -68,6 +103,18 @@ class RemoteModel : public QAbstractTableModel {
                                quint64 *symlinkSkippedOut = nullptr,
                                quint64 *deniedCountOut = nullptr,
                                quint64 *unknownSizeCountOut = nullptr) const;
+    // The same walk on an explicit session, for callers off the UI thread:
+    // `client` lists and, given `sessionOpt`, is cloned for the extra
+    // sessions; `showHidden` stands in for the view's setting.
+    static bool enumerateTree(
+        openscp::SftpClient *client,
+        const std::optional<openscp::SessionOptions> &sessionOpt,
+        bool showHidden, const QString &baseRemote,
+        std::vector<EnumeratedFile> &out, const EnumOptions &opt,
+        bool *partialErrorOut, bool *someSizeUnknownOut,
+        quint64 *dirCountOut = nullptr, quint64 *symlinkSkippedOut = nullptr,
+        quint64 *deniedCountOut = nullptr,
+        quint64 *unknownSizeCountOut = nullptr);
     // Backward-compatible simple enumeration (no cancel/skip control)
     bool enumerateFilesUnder(const QString &baseRemote,
                              std::vector<EnumeratedFile> &out,
@@ -79,24 +126,54 @@ class RemoteModel : public QAbstractTableModel {
     private:
     openscp::SftpClient *client_ = nullptr; // no owned
     QString currentPath_;
-    struct Item {
-        QString name;
-        bool isDir;
-        quint64 size;
-        bool hasSize;
-        quint64 mtime;
-        quint32 mode;
-        quint32 uid;
-        quint32 gid;
-    };
-    std::vector<Item> items_;
+    // Entries of currentPath_, plus the view order (row -> listing index).
+    // Names stay UTF-8 in the listing pool and become QString in data().
+    openscp::CompactListing listing_;
+    std::vector<std::uint32_t> rows_;
     bool showHidden_ = false; // hide names starting with '.' if false
     int sortColumn_ = 0;
     Qt::SortOrder sortOrder_ = Qt::AscendingOrder;
     std::optional<openscp::SessionOptions> sessionOpt_;
     std::atomic<quint64> listRequestSeq_{0};
+    std::shared_ptr<openscp::ListingCache> listingCache_;
+    // Warms the cache with the parent and subfolders of the loaded folder
+    // on its own session; created on first use.
+    std::unique_ptr<openscp::ListingPrefetcher> prefetcher_;
+    quint64 prefetchedReqId_ = 0; // listing request last prefetched for
+    // The folder shown before a streamed load replaced it with its first
+    // batch; put back if that stream fails before the end.
+    struct StashedListing {
+        quint64 reqId = 0;
+        QString path;
+        openscp::CompactListing listing;
+        std::vector<std::uint32_t> rows;
+    };
+    std::optional<StashedListing> stashed_;
 
-    void replaceItems(std::vector<Item> &&nextItems, const QString &path);
-    void sortItemsVector(std::vector<Item> &items, int column,
-                         Qt::SortOrder order) const;
+    // Case-folded UTF-8 name; byte order of keys = case-insensitive order.
+    static std::string collationKey(std::string_view name);
+    static openscp::CompactListing
+    compactFromListing(const std::vector<openscp::FileInfo> &listing,
+                       bool showHidden);
+    static std::vector<std::uint32_t>
+    sortedRows(const openscp::CompactListing &listing, int column,
+               Qt::SortOrder order);
+    static bool rowLess(const openscp::CompactListing &listing,
+                        std::uint32_t a, std::uint32_t b, int column,
+                        Qt::SortOrder order);
+    static bool sameRows(const openscp::CompactListing &a,
+                         const std::vector<std::uint32_t> &aRows,
+                         const openscp::CompactListing &b,
+                         const std::vector<std::uint32_t> &bRows);
+    void replaceListing(openscp::CompactListing &&listing,
+                        std::vector<std::uint32_t> &&rows, const QString &path);
+    // Move the shown folder into stashed_, leaving the model empty.
+    void stashListing(quint64 reqId);
+    // Show the stashed folder of request `reqId` again; false if none.
+    bool restoreStashedListing(quint64 reqId);
+    // Append a batch to the listing and merge its rows into the view order.
+    void mergeListingBatch(openscp::CompactListing &&batch);
+    // Queue the likely-next folders of currentPath_ for prefetching, once
+    // per listing request and only after the listing is complete.
+    void schedulePrefetch(quint64 reqId);
 };
@@ -1,6 +1,8 @@
 // Implementation of OpenSCP settings dialog.
 #include "SettingsDialog.hpp"
+#include "SiteStore.hpp"
 #include "UiAlerts.hpp"
+#include "openscp/KnownHostsUtils.hpp"
 #include "openscp/SftpTypes.hpp"
 #include <QCheckBox>
 #include <QComboBox>
@@ -39,6 +41,10 @@ constexpr int kQueueAutoClearOff = 0;
 constexpr int kQueueAutoClearCompleted = 1;
 constexpr int kQueueAutoClearFailedCanceled = 2;
 constexpr int kQueueAutoClearFinished = 3;
+// Stored values of openscp::SchedulingPolicy
+constexpr int kSchedulingFifo = 0;
+constexpr int kSchedulingShortestFirst = 1;
+constexpr int kSchedulingSmallFilesLane = 2;
 constexpr const char *kShortcutTransfersKey = "Shortcuts/openTransfers";
 constexpr const char *kShortcutHistoryKey = "Shortcuts/openHistory";
 
@@ -346,13 +352,42 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
     QWidget *transfersPage = createFormPage(tr("Transfers"), transfersForm);
     transfersForm->setVerticalSpacing(10);
     maxConcurrentSpin_ = new QSpinBox(transfersPage);
-    maxConcurrentSpin_->setRange(1, 8);
+    maxConcurrentSpin_->setRange(1, 32);
     maxConcurrentSpin_->setValue(2);
     maxConcurrentSpin_->setMinimumWidth(90);
     maxConcurrentSpin_->setToolTip(
         tr("Maximum number of concurrent transfers."));
     addLabeledRow(transfersForm, transfersPage, tr("Parallel tasks:"),
                   maxConcurrentSpin_);
+    adaptiveConcurrency_ = addCheckRow(
+        transfersForm, transfersPage,
+        tr("Adjust parallel tasks automatically from measured throughput."));
+    adaptiveConcurrency_->setToolTip(
+        tr("Adds transfers while they raise throughput and removes them on "
+           "network errors or contention, between the minimum below and "
+           "\"Parallel tasks\"."));
+    minConcurrentSpin_ = new QSpinBox(transfersPage);
+    minConcurrentSpin_->setRange(1, 32);
+    minConcurrentSpin_->setValue(1);
+    minConcurrentSpin_->setMinimumWidth(90);
+    addLabeledRow(transfersForm, transfersPage, tr("Minimum parallel tasks:"),
+                  minConcurrentSpin_);
+    minConcurrentSpin_->setEnabled(false);
+    connect(adaptiveConcurrency_, &QCheckBox::toggled, minConcurrentSpin_,
+            &QWidget::setEnabled);
+    schedulingPolicy_ = new QComboBox(transfersPage);
+    schedulingPolicy_->setMinimumWidth(kFieldMinWidth);
+    schedulingPolicy_->setMaximumWidth(kFieldMaxWidth);
+    schedulingPolicy_->addItem(tr("In queue order"), kSchedulingFifo);
+    schedulingPolicy_->addItem(tr("Smallest first"), kSchedulingShortestFirst);
+    schedulingPolicy_->addItem(tr("Keep one task for small files"),
+                               kSchedulingSmallFilesLane);
+    schedulingPolicy_->setToolTip(
+        tr("Higher-priority transfers always start first. \"Keep one task "
+           "for small files\" lets small files pass large ones when "
+           "running more than one task."));
+    addLabeledRow(transfersForm, transfersPage, tr("Start order:"),
+                  schedulingPolicy_);
     globalSpeedDefaultSpin_ = new QSpinBox(transfersPage);
     globalSpeedDefaultSpin_->setRange(0, 1'000'000);
     globalSpeedDefaultSpin_->setValue(0);
@@ -361,6 +396,12 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
     globalSpeedDefaultSpin_->setToolTip(tr("0 = no global speed limit."));
     addLabeledRow(transfersForm, transfersPage, tr("Default global limit:"),
                   globalSpeedDefaultSpin_);
+    archiveBatchMode_ = addCheckRow(
+        transfersForm, transfersPage,
+        tr("Transfer folders of many small files as one archive stream "
+           "(SFTP/SCP; requires tar on the server)."));
+    archiveBatchMode_->setToolTip(
+        tr("Existing files in the destination are replaced without asking."));
     queueAutoClearModeDefault_ = new QComboBox(transfersPage);
     queueAutoClearModeDefault_->setMinimumWidth(kFieldMinWidth);
     queueAutoClearModeDefault_->setMaximumWidth(kFieldMaxWidth);
@@ -509,6 +550,45 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
     securityForm->addRow(QString(), fpHex_);
     securityForm->addRow(QString(), terminalForceInteractiveLogin_);
     securityForm->addRow(QString(), terminalEnableSftpCliFallback_);
+    {
+        compactKnownHostsBtn_ =
+            new QPushButton(tr("Remove duplicate entries"), securityPage);
+        addLabeledRow(securityForm, securityPage, tr("known_hosts:"),
+                      compactKnownHostsBtn_);
+        connect(compactKnownHostsBtn_, &QPushButton::clicked, this, [this] {
+            // The default file plus any file a saved site points to.
+            QStringList paths{QDir::homePath() + "/.ssh/known_hosts"};
+            for (const SiteEntry &e : SiteStore::sites()) {
+                if (e.opt.known_hosts_path && !e.opt.known_hosts_path->empty())
+                    paths << QString::fromStdString(*e.opt.known_hosts_path);
+            }
+            paths.removeDuplicates();
+            std::size_t total = 0;
+            QStringList failures;
+            for (const QString &path : paths) {
+                if (!QFileInfo(path).isFile())
+                    continue;
+                std::string err;
+                std::size_t dropped = 0;
+                if (openscp::CompactKnownHosts(path.toStdString(), err,
+                                               &dropped))
+                    total += dropped;
+                else
+                    failures << QString("%1: %2").arg(
+                        path, QString::fromStdString(err));
+            }
+            if (!failures.isEmpty()) {
+                UiAlerts::warning(this, tr("known_hosts"),
+                                  tr("Some files could not be cleaned up.\n%1")
+                                      .arg(failures.join('\n')));
+                return;
+            }
+            UiAlerts::information(
+                this, tr("known_hosts"),
+                tr("%n duplicate entries removed.", "",
+                   static_cast<int>(total)));
+        });
+    }
 #if defined(Q_OS_MAC) || defined(Q_OS_MACOS) || defined(__APPLE__)
     macKeychainRestrictive_ = new QCheckBox(
         tr("Use stricter Keychain accessibility (this device only)."),
@@ -594,6 +674,16 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
         stagingPage);
     trackWrappedCheck(autoCleanStaging_);
     stagingForm->addRow(QString(), autoCleanStaging_);
+    lazyRemoteDrag_ = new QCheckBox(
+        tr("Start remote drag-out at once and download only on drop."),
+        stagingPage);
+    lazyRemoteDrag_->setToolTip(
+        tr("Files are listed and downloaded once the drop target asks for "
+           "them. Drops on the local panel download through the transfer "
+           "queue without staging. Turn off to stage everything before the "
+           "drag starts."));
+    trackWrappedCheck(lazyRemoteDrag_);
+    stagingForm->addRow(QString(), lazyRemoteDrag_);
     stagingRetentionDaysSpin_ = new QSpinBox(stagingPage);
     stagingRetentionDaysSpin_->setRange(1, 365);
     stagingRetentionDaysSpin_->setValue(7);
@@ -818,9 +908,23 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
     if (maxConcurrentSpin_)
         maxConcurrentSpin_->setValue(
             s.value("Transfer/maxConcurrent", 2).toInt());
+    if (adaptiveConcurrency_)
+        adaptiveConcurrency_->setChecked(
+            s.value("Transfer/adaptiveConcurrency", false).toBool());
+    if (minConcurrentSpin_)
+        minConcurrentSpin_->setValue(
+            s.value("Transfer/minConcurrent", 1).toInt());
+    if (schedulingPolicy_) {
+        const int idx = schedulingPolicy_->findData(
+            s.value("Transfer/schedulingPolicy", kSchedulingFifo).toInt());
+        schedulingPolicy_->setCurrentIndex(idx >= 0 ? idx : 0);
+    }
     if (globalSpeedDefaultSpin_)
         globalSpeedDefaultSpin_->setValue(
             s.value("Transfer/globalSpeedKBps", 0).toInt());
+    if (archiveBatchMode_)
+        archiveBatchMode_->setChecked(
+            s.value("Transfer/archiveBatchMode", false).toBool());
     if (queueAutoClearModeDefault_) {
         int queueMode = s.value("Transfer/defaultQueueAutoClearMode",
                                 kQueueAutoClearOff)
@@ -857,6 +961,9 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
     if (autoCleanStaging_)
         autoCleanStaging_->setChecked(
             s.value("Advanced/autoCleanStaging", true).toBool());
+    if (lazyRemoteDrag_)
+        lazyRemoteDrag_->setChecked(
+            s.value("Advanced/lazyRemoteDrag", true).toBool());
     if (stagingRetentionDaysSpin_)
         stagingRetentionDaysSpin_->setValue(
             qBound(1, s.value("Advanced/stagingRetentionDays", 7).toInt(),
@@ -920,8 +1027,13 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
     bindDirtyFlag(noHostVerifyTtlMinSpin_,
                   qOverload<int>(&QSpinBox::valueChanged));
     bindDirtyFlag(maxConcurrentSpin_, qOverload<int>(&QSpinBox::valueChanged));
+    bindDirtyFlag(adaptiveConcurrency_, &QCheckBox::toggled);
+    bindDirtyFlag(minConcurrentSpin_, qOverload<int>(&QSpinBox::valueChanged));
+    bindDirtyFlag(schedulingPolicy_,
+                  qOverload<int>(&QComboBox::currentIndexChanged));
     bindDirtyFlag(globalSpeedDefaultSpin_,
                   qOverload<int>(&QSpinBox::valueChanged));
+    bindDirtyFlag(archiveBatchMode_, &QCheckBox::toggled);
     bindDirtyFlag(queueAutoClearModeDefault_,
                   qOverload<int>(&QComboBox::currentIndexChanged));
     bindDirtyFlag(queueAutoClearMinutesDefaultSpin_,
@@ -932,6 +1044,7 @@ SettingsDialog::SettingsDialog(QWidget *parent) : QDialog(parent) {
                   qOverload<int>(&QSpinBox::valueChanged));
     bindDirtyFlag(stagingRootEdit_, &QLineEdit::textChanged);
     bindDirtyFlag(autoCleanStaging_, &QCheckBox::toggled);
+    bindDirtyFlag(lazyRemoteDrag_, &QCheckBox::toggled);
     bindDirtyFlag(stagingRetentionDaysSpin_,
                   qOverload<int>(&QSpinBox::valueChanged));
     bindDirtyFlag(stagingPrepTimeoutMsSpin_,
@@ -1090,9 +1203,20 @@ void SettingsDialog::onApply() {
                    insecureFallback_->isChecked());
     if (maxConcurrentSpin_)
         s.setValue("Transfer/maxConcurrent", maxConcurrentSpin_->value());
+    if (adaptiveConcurrency_)
+        s.setValue("Transfer/adaptiveConcurrency",
+                   adaptiveConcurrency_->isChecked());
+    if (minConcurrentSpin_)
+        s.setValue("Transfer/minConcurrent", minConcurrentSpin_->value());
+    if (schedulingPolicy_)
+        s.setValue("Transfer/schedulingPolicy",
+                   schedulingPolicy_->currentData().toInt());
     if (globalSpeedDefaultSpin_)
         s.setValue("Transfer/globalSpeedKBps",
                    globalSpeedDefaultSpin_->value());
+    if (archiveBatchMode_)
+        s.setValue("Transfer/archiveBatchMode",
+                   archiveBatchMode_->isChecked());
     if (queueAutoClearModeDefault_) {
         s.setValue("Transfer/defaultQueueAutoClearMode",
                    queueAutoClearModeDefault_->currentData().toInt());
@@ -1113,6 +1237,8 @@ void SettingsDialog::onApply() {
         s.setValue("Advanced/stagingRoot", stagingRootEdit_->text());
     if (autoCleanStaging_)
         s.setValue("Advanced/autoCleanStaging", autoCleanStaging_->isChecked());
+    if (lazyRemoteDrag_)
+        s.setValue("Advanced/lazyRemoteDrag", lazyRemoteDrag_->isChecked());
     if (stagingRetentionDaysSpin_) {
         s.setValue("Advanced/stagingRetentionDays",
                    stagingRetentionDaysSpin_->value());
@@ -1129,6 +1255,8 @@ void SettingsDialog::onApply() {
     if (maxDepthSpin_)
         s.setValue("Advanced/maxFolderDepth", maxDepthSpin_->value());
     s.sync();
+    // Cached sites carry the FTPS and SCP defaults they were decoded with.
+    SiteStore::invalidate();
 
     // Only notify if language actually changed
     if (prevLang != chosenLang) {
@@ -1223,8 +1351,15 @@ void SettingsDialog::updateApplyFromControls() {
         s.value("Security/enableInsecureSecretFallback", false).toBool();
 #endif
     const int maxConcurrent = s.value("Transfer/maxConcurrent", 2).toInt();
+    const bool adaptiveConcurrency =
+        s.value("Transfer/adaptiveConcurrency", false).toBool();
+    const int minConcurrent = s.value("Transfer/minConcurrent", 1).toInt();
+    const int schedulingPolicy =
+        s.value("Transfer/schedulingPolicy", kSchedulingFifo).toInt();
     const int globalSpeedDefault =
         s.value("Transfer/globalSpeedKBps", 0).toInt();
+    const bool archiveBatchMode =
+        s.value("Transfer/archiveBatchMode", false).toBool();
     const int queueAutoClearModeDefault =
         qBound(kQueueAutoClearOff,
                s.value("Transfer/defaultQueueAutoClearMode", kQueueAutoClearOff)
@@ -1243,6 +1378,7 @@ void SettingsDialog::updateApplyFromControls() {
             .toString();
     const bool autoCleanSt =
         s.value("Advanced/autoCleanStaging", true).toBool();
+    const bool lazyDrag = s.value("Advanced/lazyRemoteDrag", true).toBool();
     const int stagingRetentionDays = qBound(
         1, s.value("Advanced/stagingRetentionDays", 7).toInt(), 365);
     const int stagingPrepTimeoutMs =
@@ -1329,9 +1465,18 @@ void SettingsDialog::updateApplyFromControls() {
 #endif
     const int curMaxConcurrent =
         maxConcurrentSpin_ ? maxConcurrentSpin_->value() : maxConcurrent;
+    const bool curAdaptiveConcurrency =
+        adaptiveConcurrency_ && adaptiveConcurrency_->isChecked();
+    const int curMinConcurrent =
+        minConcurrentSpin_ ? minConcurrentSpin_->value() : minConcurrent;
+    const int curSchedulingPolicy =
+        schedulingPolicy_ ? schedulingPolicy_->currentData().toInt()
+                          : schedulingPolicy;
     const int curGlobalSpeedDefault = globalSpeedDefaultSpin_
                                           ? globalSpeedDefaultSpin_->value()
                                           : globalSpeedDefault;
+    const bool curArchiveBatchMode =
+        archiveBatchMode_ && archiveBatchMode_->isChecked();
     const int curQueueAutoClearModeDefault =
         queueAutoClearModeDefault_
             ? queueAutoClearModeDefault_->currentData().toInt()
@@ -1352,6 +1497,7 @@ void SettingsDialog::updateApplyFromControls() {
         stagingRootEdit_ ? stagingRootEdit_->text() : stagingRoot;
     const bool curAutoCleanSt =
         autoCleanStaging_ && autoCleanStaging_->isChecked();
+    const bool curLazyDrag = lazyRemoteDrag_ && lazyRemoteDrag_->isChecked();
     const int curStagingRetentionDays =
         stagingRetentionDaysSpin_ ? stagingRetentionDaysSpin_->value()
                                   : stagingRetentionDays;
@@ -1391,12 +1537,17 @@ void SettingsDialog::updateApplyFromControls() {
         || (curInsecureFb != insecureFb)
 #endif
         || (curMaxConcurrent != maxConcurrent) ||
+        (curAdaptiveConcurrency != adaptiveConcurrency) ||
+        (curMinConcurrent != minConcurrent) ||
+        (curSchedulingPolicy != schedulingPolicy) ||
         (curGlobalSpeedDefault != globalSpeedDefault) ||
+        (curArchiveBatchMode != archiveBatchMode) ||
         (curQueueAutoClearModeDefault != queueAutoClearModeDefault) ||
         (curQueueAutoClearMinutesDefault != queueAutoClearMinutesDefault) ||
         (curSessionHealthIntervalSec != sessionHealthIntervalSec) ||
         (curRemoteWriteabilityTtlMs != remoteWriteabilityTtlMs) ||
         (curStagingRoot != stagingRoot) || (curAutoCleanSt != autoCleanSt) ||
+        (curLazyDrag != lazyDrag) ||
         (curStagingRetentionDays != stagingRetentionDays) ||
         (curStagingPrepTimeoutMs != stagingPrepTimeoutMs) ||
         (curStagingConfirmItems != stagingConfirmItems) ||
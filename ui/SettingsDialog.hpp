@@ -60,6 +60,8 @@ class SettingsDialog : public QDialog {
 #endif
     QCheckBox *knownHostsHashed_ =
         nullptr; // save hostnames hashed in known_hosts (recommended)
+    class QPushButton *compactKnownHostsBtn_ =
+        nullptr; // drop repeated entries from the known_hosts files in use
     QCheckBox *fpHex_ =
         nullptr; // show fingerprints in HEX colon format (visual only)
     QCheckBox *terminalForceInteractiveLogin_ =
@@ -80,8 +82,16 @@ class SettingsDialog : public QDialog {
     QCheckBox *insecureFallback_ =
         nullptr; // allow insecure secret fallback (not recommended)
     class QSpinBox *maxConcurrentSpin_ = nullptr; // transfer worker concurrency
+    QCheckBox *adaptiveConcurrency_ =
+        nullptr; // tune concurrency from observed throughput
+    class QSpinBox *minConcurrentSpin_ =
+        nullptr; // lower bound of the adaptive concurrency
+    QComboBox *schedulingPolicy_ =
+        nullptr; // order in which queued transfers start
     class QSpinBox *globalSpeedDefaultSpin_ =
         nullptr; // default global speed limit KB/s (0 = unlimited)
+    QCheckBox *archiveBatchMode_ =
+        nullptr; // folder transfers as one tar stream (SFTP/SCP)
     QComboBox *queueAutoClearModeDefault_ =
         nullptr; // default auto-clear mode for the transfer queue
     class QSpinBox *queueAutoClearMinutesDefaultSpin_ =
@@ -90,6 +100,7 @@ class SettingsDialog : public QDialog {
     class QPushButton *stagingBrowseBtn_ = nullptr;
     QCheckBox *autoCleanStaging_ =
         nullptr; // Auto-clean staging after successful drag-out
+    QCheckBox *lazyRemoteDrag_ = nullptr; // Stage remote drag-out on drop
     class QSpinBox *stagingRetentionDaysSpin_ =
         nullptr; // startup cleanup retention for old staging batches
     class QSpinBox *stagingPrepTimeoutMsSpin_ =
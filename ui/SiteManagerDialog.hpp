@@ -1,6 +1,6 @@
 // Site manager: list, add/edit/remove, and select to connect.
 #pragma once
-#include "openscp/SftpTypes.hpp"
+#include "SiteStore.hpp"
 #include <QDialog>
 #include <QString>
 #include <QVector>
@@ -8,12 +8,6 @@
 class QTableWidget;
 class QPushButton;
 
-struct SiteEntry {
-    QString id;
-    QString name;
-    openscp::SessionOptions opt;
-};
-
 class SiteManagerDialog : public QDialog {
     Q_OBJECT
     public:
@@ -0,0 +1,274 @@
+// Saved sites cached in memory, read from QSettings on first use.
+#include "SiteStore.hpp"
+#include <QSet>
+#include <QSettings>
+#include <QUuid>
+#include <optional>
+
+static std::uint16_t defaultProxyPort(openscp::ProxyType type) {
+    return openscp::defaultPortForProxyType(type);
+}
+
+static std::uint16_t defaultJumpPort() { return 22; }
+
+static openscp::ScpTransferMode
+loadDefaultScpTransferModeFromSettings(const QSettings &s) {
+    return openscp::scpTransferModeFromStorageName(
+        s.value("Protocol/scpTransferModeDefault",
+                QString::fromLatin1(openscp::scpTransferModeStorageName(
+                    openscp::ScpTransferMode::Auto)))
+            .toString()
+            .trimmed()
+            .toLower()
+            .toStdString());
+}
+
+static std::optional<QVector<SiteEntry>> &cachedSites() {
+    static std::optional<QVector<SiteEntry>> cache;
+    return cache;
+}
+
+// Decode the "sites" array. Sets needsSave when entries were normalized
+// (missing or duplicate ids, legacy defaults) and should be written back.
+static QVector<SiteEntry> readSites(bool &needsSave) {
+    QVector<SiteEntry> sites;
+    needsSave = false;
+    QSettings s("OpenSCP", "OpenSCP");
+    const auto defaultScpMode = loadDefaultScpTransferModeFromSettings(s);
+    const bool defaultFtpsVerifyPeer =
+        s.value("Security/ftpsVerifyPeerDefault", true).toBool();
+    const QString defaultFtpsCaPath =
+        s.value("Security/ftpsCaCertPathDefault", QString())
+            .toString()
+            .trimmed();
+    int n = s.beginReadArray("sites");
+    QSet<QString> usedIds;
+    for (int i = 0; i < n; ++i) {
+        s.setArrayIndex(i);
+        SiteEntry e;
+        e.id = s.value("id").toString().trimmed();
+        if (e.id.isEmpty() || usedIds.contains(e.id)) {
+            e.id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+            needsSave = true;
+        }
+        usedIds.insert(e.id);
+        e.name = s.value("name").toString().trimmed();
+        e.opt.protocol = openscp::protocolFromStorageName(
+            s.value("protocol",
+                    QString::fromLatin1(
+                        openscp::protocolStorageName(openscp::Protocol::Sftp)))
+                .toString()
+                .trimmed()
+                .toLower()
+                .toStdString());
+        const bool hasScpTransferModeKey = s.contains("scpTransferMode");
+        e.opt.scp_transfer_mode = openscp::scpTransferModeFromStorageName(
+            s.value("scpTransferMode",
+                    QString::fromLatin1(openscp::scpTransferModeStorageName(
+                        defaultScpMode)))
+                .toString()
+                .trimmed()
+                .toLower()
+                .toStdString());
+        if (!hasScpTransferModeKey)
+            needsSave = true;
+        e.opt.host = s.value("host").toString().toStdString();
+        e.opt.port = static_cast<std::uint16_t>(
+            s.value("port",
+                    static_cast<int>(
+                        openscp::defaultPortForProtocol(e.opt.protocol)))
+                .toUInt());
+        const bool hasWebDavSchemeKey = s.contains("webdavScheme");
+        if (hasWebDavSchemeKey) {
+            e.opt.webdav_scheme = openscp::webDavSchemeFromStorageName(
+                s.value("webdavScheme",
+                        QString::fromLatin1(openscp::webDavSchemeStorageName(
+                            openscp::WebDavScheme::Https)))
+                    .toString()
+                    .trimmed()
+                    .toLower()
+                    .toStdString());
+        } else if (e.opt.protocol == openscp::Protocol::WebDav &&
+                   e.opt.port ==
+                       openscp::defaultPortForWebDavScheme(
+                           openscp::WebDavScheme::Http)) {
+            e.opt.webdav_scheme = openscp::WebDavScheme::Http;
+            needsSave = true;
+        }
+        e.opt.username = s.value("user").toString().toStdString();
+        // Password and passphrase are no longer read from QSettings; they will
+        // be fetched from SecretStore when connecting
+        const QString kp = s.value("keyPath").toString();
+        if (!kp.isEmpty())
+            e.opt.private_key_path = kp.toStdString();
+        // keyPass will be retrieved dynamically
+        e.opt.proxy_type = openscp::proxyTypeFromStorageValue(
+            s.value("proxyType", static_cast<int>(openscp::ProxyType::None))
+                .toInt());
+        e.opt.proxy_host =
+            s.value("proxyHost").toString().trimmed().toStdString();
+        e.opt.proxy_port = static_cast<std::uint16_t>(
+            s.value("proxyPort",
+                    static_cast<int>(defaultProxyPort(e.opt.proxy_type)))
+                .toUInt());
+        const QString proxyUser = s.value("proxyUser").toString().trimmed();
+        if (!proxyUser.isEmpty())
+            e.opt.proxy_username = proxyUser.toStdString();
+        const QString jumpHost = s.value("jumpHost").toString().trimmed();
+        if (!jumpHost.isEmpty())
+            e.opt.jump_host = jumpHost.toStdString();
+        e.opt.jump_port = static_cast<std::uint16_t>(
+            s.value("jumpPort", static_cast<int>(defaultJumpPort())).toUInt());
+        const QString jumpUser = s.value("jumpUser").toString().trimmed();
+        if (!jumpUser.isEmpty())
+            e.opt.jump_username = jumpUser.toStdString();
+        const QString jumpKeyPath = s.value("jumpKeyPath").toString();
+        if (!jumpKeyPath.isEmpty())
+            e.opt.jump_private_key_path = jumpKeyPath.toStdString();
+        const QString kh = s.value("knownHosts").toString();
+        if (!kh.isEmpty())
+            e.opt.known_hosts_path = kh.toStdString();
+        e.opt.known_hosts_policy =
+            (openscp::KnownHostsPolicy)s
+                .value("khPolicy", (int)openscp::KnownHostsPolicy::Strict)
+                .toInt();
+        e.opt.transfer_integrity_policy =
+            (openscp::TransferIntegrityPolicy)s
+                .value("integrityPolicy",
+                       (int)openscp::TransferIntegrityPolicy::Optional)
+                .toInt();
+        e.opt.ssh_ciphers =
+            s.value("sshCiphers", QString()).toString().trimmed().toStdString();
+        e.opt.ssh_macs =
+            s.value("sshMacs", QString()).toString().trimmed().toStdString();
+        e.opt.ssh_compression = s.value("sshCompression", false).toBool();
+        e.opt.ssh_multiplex = s.value("sshMultiplex", false).toBool();
+        e.opt.tcp_send_buffer = s.value("tcpSendBuffer", 0u).toUInt();
+        e.opt.tcp_recv_buffer = s.value("tcpRecvBuffer", 0u).toUInt();
+        e.opt.tcp_nodelay = s.value("tcpNoDelay", false).toBool();
+        e.opt.ssh_window_size = s.value("sshWindowSize", 0u).toUInt();
+        e.opt.network_auto_tune = s.value("networkAutoTune", false).toBool();
+        e.opt.network_link_mbps =
+            s.value("networkLinkMbps", 1000u).toUInt();
+        e.opt.ftps_verify_peer =
+            s.value("ftpsVerifyPeer", defaultFtpsVerifyPeer).toBool();
+        const QString ftpsCaPath =
+            s.value("ftpsCaCertPath", defaultFtpsCaPath).toString().trimmed();
+        if (!ftpsCaPath.isEmpty())
+            e.opt.ftps_ca_cert_path = ftpsCaPath.toStdString();
+        e.opt.webdav_verify_peer =
+            s.value("webdavVerifyPeer", true).toBool();
+        const QString webDavCaPath =
+            s.value("webdavCaCertPath", QString()).toString().trimmed();
+        if (!webDavCaPath.isEmpty())
+            e.opt.webdav_ca_cert_path = webDavCaPath.toStdString();
+        if (e.opt.protocol == openscp::Protocol::WebDav &&
+            e.opt.webdav_scheme == openscp::WebDavScheme::Http) {
+            e.opt.webdav_verify_peer = false;
+            e.opt.webdav_ca_cert_path.reset();
+        }
+        sites.push_back(e);
+    }
+    s.endArray();
+    return sites;
+}
+
+static void writeSites(const QVector<SiteEntry> &sites) {
+    QSettings s("OpenSCP", "OpenSCP");
+    // Clear previous array to avoid stale entries after deletions
+    s.remove("sites");
+    s.beginWriteArray("sites");
+    for (int i = 0; i < sites.size(); ++i) {
+        s.setArrayIndex(i);
+        const auto &e = sites[i];
+        s.setValue("id", e.id);
+        s.setValue("name", e.name);
+        s.setValue("protocol",
+                   QString::fromLatin1(
+                       openscp::protocolStorageName(e.opt.protocol)));
+        s.setValue("scpTransferMode",
+                   QString::fromLatin1(openscp::scpTransferModeStorageName(
+                       e.opt.scp_transfer_mode)));
+        s.setValue("host", QString::fromStdString(e.opt.host));
+        s.setValue("port", (int)e.opt.port);
+        s.setValue("webdavScheme",
+                   QString::fromLatin1(openscp::webDavSchemeStorageName(
+                       e.opt.webdav_scheme)));
+        s.setValue("user", QString::fromStdString(e.opt.username));
+        // Password and passphrase are stored in SecretStore under keys derived
+        // from stable site UUID.
+        s.setValue("keyPath",
+                   e.opt.private_key_path
+                       ? QString::fromStdString(*e.opt.private_key_path)
+                       : QString());
+        s.setValue("proxyType", static_cast<int>(e.opt.proxy_type));
+        s.setValue("proxyHost", QString::fromStdString(e.opt.proxy_host));
+        s.setValue("proxyPort", static_cast<int>(e.opt.proxy_port));
+        s.setValue("proxyUser",
+                   e.opt.proxy_username
+                       ? QString::fromStdString(*e.opt.proxy_username)
+                       : QString());
+        s.setValue("jumpHost",
+                   e.opt.jump_host ? QString::fromStdString(*e.opt.jump_host)
+                                   : QString());
+        s.setValue("jumpPort", static_cast<int>(e.opt.jump_port));
+        s.setValue("jumpUser",
+                   e.opt.jump_username
+                       ? QString::fromStdString(*e.opt.jump_username)
+                       : QString());
+        s.setValue("jumpKeyPath",
+                   e.opt.jump_private_key_path
+                       ? QString::fromStdString(*e.opt.jump_private_key_path)
+                       : QString());
+        s.setValue("knownHosts",
+                   e.opt.known_hosts_path
+                       ? QString::fromStdString(*e.opt.known_hosts_path)
+                       : QString());
+        s.setValue("khPolicy", (int)e.opt.known_hosts_policy);
+        s.setValue("integrityPolicy", (int)e.opt.transfer_integrity_policy);
+        s.setValue("sshCiphers", QString::fromStdString(e.opt.ssh_ciphers));
+        s.setValue("sshMacs", QString::fromStdString(e.opt.ssh_macs));
+        s.setValue("sshCompression", e.opt.ssh_compression);
+        s.setValue("sshMultiplex", e.opt.ssh_multiplex);
+        s.setValue("tcpSendBuffer", e.opt.tcp_send_buffer);
+        s.setValue("tcpRecvBuffer", e.opt.tcp_recv_buffer);
+        s.setValue("tcpNoDelay", e.opt.tcp_nodelay);
+        s.setValue("sshWindowSize", e.opt.ssh_window_size);
+        s.setValue("networkAutoTune", e.opt.network_auto_tune);
+        s.setValue("networkLinkMbps", e.opt.network_link_mbps);
+        s.setValue("ftpsVerifyPeer", e.opt.ftps_verify_peer);
+        s.setValue("ftpsCaCertPath",
+                   e.opt.ftps_ca_cert_path
+                       ? QString::fromStdString(*e.opt.ftps_ca_cert_path)
+                       : QString());
+        s.setValue("webdavVerifyPeer", e.opt.webdav_verify_peer);
+        s.setValue("webdavCaCertPath",
+                   e.opt.webdav_ca_cert_path
+                       ? QString::fromStdString(*e.opt.webdav_ca_cert_path)
+                       : QString());
+    }
+    s.endArray();
+    s.sync();
+}
+
+namespace SiteStore {
+
+const QVector<SiteEntry> &sites() {
+    auto &cache = cachedSites();
+    if (!cache) {
+        bool needsSave = false;
+        cache = readSites(needsSave);
+        if (needsSave)
+            writeSites(*cache);
+    }
+    return *cache;
+}
+
+void save(const QVector<SiteEntry> &sites) {
+    writeSites(sites);
+    cachedSites() = sites;
+}
+
+void invalidate() { cachedSites().reset(); }
+
+} // namespace SiteStore
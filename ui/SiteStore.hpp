@@ -0,0 +1,25 @@
+// Saved sites cached in memory, read from QSettings on first use.
+#pragma once
+#include "openscp/SftpTypes.hpp"
+#include <QString>
+#include <QVector>
+
+struct SiteEntry {
+    QString id;
+    QString name;
+    openscp::SessionOptions opt;
+};
+
+// One parsed copy of the "sites" array shared by the site manager and
+// quick-connect bookkeeping, so hundreds of sites are decoded once per
+// process instead of on every dialog and connection. Secrets are not part
+// of it; they are fetched from SecretStore only when a site is edited or
+// connected. GUI thread only.
+namespace SiteStore {
+// Read the sites on first call; later calls return the cached list.
+const QVector<SiteEntry> &sites();
+// Write `sites` to QSettings and make it the cached list.
+void save(const QVector<SiteEntry> &sites);
+// Forget the cached list; the next sites() reads QSettings again.
+void invalidate();
+} // namespace SiteStore
@@ -1,10 +1,14 @@
-// Queue implementation: schedules concurrent worker transfers with isolated
-// SFTP sessions.
+// Queue implementation: schedules concurrent worker transfers over isolated,
+// pooled SFTP sessions.
 #include "TransferManager.hpp"
 #include "TimeUtils.hpp"
 #include "UiAlerts.hpp"
+#include "openscp/ClientFactory.hpp"
+#include "openscp/RemoteStream.hpp"
 #include "openscp/RuntimeLogging.hpp"
+#include "openscp/SegmentedDownload.hpp"
 #include "openscp/SftpClient.hpp"
+#include "openscp/Trace.hpp"
 #include <QAbstractButton>
 #include <QApplication>
 #include <QCoreApplication>
@@ -18,10 +22,16 @@
 #include <QMessageBox>
 #include <QMetaObject>
 #include <QPushButton>
+#include <QStandardPaths>
+#include <QSysInfo>
 #include <QThread>
+#include <QTimer>
 #include <QTimeZone>
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
 #include <thread>
 #include <vector>
 Q_LOGGING_CATEGORY(ocXfer, "openscp.transfer")
@@ -44,6 +54,77 @@ static const char *transferStatusName(TransferTask::Status st) {
     return "Unknown";
 }
 
+static std::int64_t steadyNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Steady-clock marks (us) of one running task; 0 = not reached. Progress
+// may be reported from several segment threads, hence the atomics.
+struct TaskPhaseMarks {
+    std::int64_t transferStartUs = 0;
+    std::atomic<std::int64_t> firstByteUs{0};
+    std::atomic<std::int64_t> lastByteUs{0};
+    std::atomic<std::int64_t> returnedUs{0};
+};
+
+// Split the transfer call into open / transfer / integrity / finalize.
+// Without any byte reported the whole call counts as "open".
+static void recordTransferPhases(openscp::TransferMetrics &metrics,
+                                 const std::string &backend,
+                                 const TaskPhaseMarks &marks,
+                                 bool integrityChecked) {
+    using openscp::TransferPhase;
+    using us = std::chrono::microseconds;
+    const std::int64_t start = marks.transferStartUs;
+    const std::int64_t first = marks.firstByteUs.load();
+    const std::int64_t last = marks.lastByteUs.load();
+    const std::int64_t returned = marks.returnedUs.load();
+    const std::int64_t done = steadyNowUs();
+    if (start <= 0 || returned <= 0)
+        return;
+    if (first <= 0) {
+        metrics.recordPhase(backend, TransferPhase::Open, us(returned - start));
+        return;
+    }
+    metrics.recordPhase(backend, TransferPhase::Open, us(first - start));
+    if (last <= 0) {
+        metrics.recordPhase(backend, TransferPhase::Transfer,
+                            us(returned - first));
+        return;
+    }
+    metrics.recordPhase(backend, TransferPhase::Transfer, us(last - first));
+    if (integrityChecked) {
+        metrics.recordPhase(backend, TransferPhase::Integrity,
+                            us(returned - last));
+        metrics.recordPhase(backend, TransferPhase::Finalize,
+                            us(done - returned));
+    } else {
+        metrics.recordPhase(backend, TransferPhase::Finalize,
+                            us(done - last));
+    }
+}
+
+// Identity of a connection, recorded with journaled tasks so they are only
+// restored for the server they were queued on.
+static QString journalSessionKey(const openscp::SessionOptions &opt) {
+    return QString::fromLatin1(openscp::protocolMetricLabel(opt.protocol)) +
+           "://" + QString::fromStdString(opt.username) + '@' +
+           QString::fromStdString(opt.host) + ':' + QString::number(opt.port);
+}
+
+static openscp::JournalTaskState journalStateFor(TransferTask::Status s) {
+    switch (s) {
+    case TransferTask::Status::Paused:
+        return openscp::JournalTaskState::Paused;
+    case TransferTask::Status::Error:
+        return openscp::JournalTaskState::Error;
+    default:
+        return openscp::JournalTaskState::Queued;
+    }
+}
+
 static QString transferErrorForUi(const std::string &rawError) {
     const QString msg = QString::fromStdString(rawError).trimmed();
     if (msg.isEmpty())
@@ -156,36 +237,89 @@ static int askOverwriteConflictOnUi(QObject *uiContext, const QString &name,
     return state->choice;
 }
 
-TransferManager::TransferManager(QObject *parent) : QObject(parent) {}
+// Upper bound for progress repaints (20 Hz) regardless of chunk rate.
+static constexpr int kProgressFlushIntervalMs = 50;
+// Journal records are written in batches at most this old.
+static constexpr int kJournalFlushIntervalMs = 200;
+// Control interval of the adaptive concurrency and its starting limit.
+static constexpr int kAdaptiveIntervalMs = 2000;
+static constexpr int kAdaptiveInitialWorkers = 2;
+// Files a local copy run copies at the same time.
+static constexpr int kLocalCopyThreads = 4;
+
+// Downloads at least this large are split into byte ranges over several
+// sessions (backends with SftpClient::getRange() only).
+static constexpr quint64 kSegmentedDownloadMinBytes = 1024ull * 1024 * 1024;
+// Sessions per segmented download, including the task's own.
+static constexpr int kSegmentedDownloadSessions = 4;
+// Overwriting a remote file at least this large first tries a delta upload
+// that only sends the blocks which changed (SftpClient::putDelta()).
+static constexpr quint64 kDeltaUploadMinBytes = 64ull * 1024 * 1024;
+
+TransferManager::TransferManager(QObject *parent) : QObject(parent) {
+    progressFlushTimer_ = new QTimer(this);
+    progressFlushTimer_->setSingleShot(true);
+    progressFlushTimer_->setInterval(kProgressFlushIntervalMs);
+    connect(progressFlushTimer_, &QTimer::timeout, this,
+            &TransferManager::flushDirtyProgress);
+    // OPENSCP_METRICS_EXPORT=<file>|unix:<socket>,
+    // OPENSCP_METRICS_FORMAT=prometheus|json
+    if (const char *target = std::getenv("OPENSCP_METRICS_EXPORT"))
+        metricsTarget_ = target;
+    if (const char *fmt = std::getenv("OPENSCP_METRICS_FORMAT")) {
+        const QString f = QString::fromLatin1(fmt).trimmed().toLower();
+        if (f == "json" || f == "jsonl")
+            metricsFormat_ = openscp::MetricsFormat::JsonLines;
+    }
+    metrics_.setInstance(QSysInfo::machineHostName().toStdString());
+    journalFlushTimer_ = new QTimer(this);
+    journalFlushTimer_->setSingleShot(true);
+    journalFlushTimer_->setInterval(kJournalFlushIntervalMs);
+    connect(journalFlushTimer_, &QTimer::timeout, this,
+            &TransferManager::flushJournal);
+    openJournal();
+}
 
 TransferManager::~TransferManager() {
     paused_ = true;
     const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
     {
         std::lock_guard<std::mutex> lk(mtx_);
+        // Unfinished tasks stay journaled for the next start.
+        journalSuspended_ = true;
         resumeRequestedTasks_.clear();
         for (auto &t : tasks_) {
             canceledTasks_.insert(t.id);
             if (t.status == TransferTask::Status::Queued ||
                 t.status == TransferTask::Status::Running ||
                 t.status == TransferTask::Status::Paused) {
-                t.status = TransferTask::Status::Canceled;
+                setStatusLocked(t, TransferTask::Status::Canceled);
                 t.currentSpeedKBps = 0.0;
                 t.etaSeconds = -1;
                 t.finishedAtMs = nowMs;
             }
         }
+        stopEpoch_.fetch_add(1);
     }
     interruptActiveWorkers();
-    std::unordered_map<quint64, std::thread> workersToJoin;
     {
-        std::lock_guard<std::mutex> wl(workersMutex_);
-        workersToJoin.swap(workers_);
+        // Local copy runs poll canceledTasks_ between chunks.
+        std::unique_lock<std::mutex> lk(mtx_);
+        localCopiesIdleCv_.wait(lk,
+                                [this] { return localCopiesInFlight_ == 0; });
     }
-    for (auto &kv : workersToJoin) {
-        if (kv.second.joinable())
-            kv.second.join();
+    std::vector<std::thread> threadsToJoin;
+    {
+        std::lock_guard<std::mutex> lk(jobQueueMutex_);
+        stopJobThreads_ = true;
+        threadsToJoin.swap(jobThreads_);
+    }
+    jobQueueCv_.notify_all();
+    for (auto &th : threadsToJoin) {
+        if (th.joinable())
+            th.join();
     }
+    drainWorkerPool();
     running_ = 0;
 }
 
@@ -194,6 +328,7 @@ void TransferManager::setClient(openscp::SftpClient *c) {
         std::lock_guard<std::mutex> lk(mtx_);
         client_ = c;
     }
+    precheck_->clear();
     if (c) {
         // Re-enable queue execution after a disconnect/clearClient cycle.
         paused_ = false;
@@ -205,8 +340,200 @@ void TransferManager::setClient(openscp::SftpClient *c) {
 }
 
 void TransferManager::setSessionOptions(const openscp::SessionOptions &opt) {
-    std::lock_guard<std::mutex> lk(mtx_);
-    sessionOpt_ = opt;
+    bool restored = false;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        sessionOpt_ = opt;
+        sessionKey_ = journalSessionKey(opt);
+        restored = restoreJournaledTasksLocked();
+    }
+    // Pooled sessions belong to the previous options; never lease them out
+    // for the new ones.
+    drainWorkerPool();
+    precheck_->clear();
+    if (restored) {
+        emit tasksChanged();
+        QMetaObject::invokeMethod(this, "schedule", Qt::QueuedConnection);
+    }
+}
+
+void TransferManager::openJournal() {
+    const QString dir =
+        QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    if (dir.isEmpty() || !QDir().mkpath(dir))
+        return;
+    const std::string path = (dir + "/transfer-queue.journal").toStdString();
+    const qint64 startedAtMs = QDateTime::currentMSecsSinceEpoch();
+    std::vector<openscp::JournalTask> tasks;
+    std::string err;
+    if (!journal_.open(path, tasks, err)) {
+        if (journal_.lockedElsewhere()) {
+            // Another instance owns the queue journal; leave it to that one.
+            qCInfo(ocXfer) << "transfer journal disabled:"
+                           << QString::fromStdString(err);
+            return;
+        }
+        qCWarning(ocXfer) << "transfer journal discarded:"
+                          << QString::fromStdString(err);
+        std::remove(path.c_str());
+        if (!journal_.open(path, tasks, err)) {
+            qCWarning(ocXfer) << "transfer journal unavailable:"
+                              << QString::fromStdString(err);
+            return;
+        }
+    }
+    // Restored tasks keep their ids; new ones continue after them.
+    for (const auto &jt : tasks)
+        nextId_ = std::max<quint64>(nextId_, jt.id + 1);
+    journalRestore_ = std::move(tasks);
+    qCInfo(ocXfer) << "transfer journal replayed"
+                   << "tasks=" << journalRestore_.size()
+                   << "ms=" << (QDateTime::currentMSecsSinceEpoch() -
+                                startedAtMs);
+}
+
+bool TransferManager::restoreJournaledTasksLocked() {
+    if (journalRestore_.empty() || sessionKey_.isEmpty())
+        return false;
+    const std::string session = sessionKey_.toStdString();
+    auto mine = std::stable_partition(
+        journalRestore_.begin(), journalRestore_.end(),
+        [&](const openscp::JournalTask &jt) { return jt.session != session; });
+    if (mine == journalRestore_.end())
+        return false;
+
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    int count = 0;
+    for (auto it = mine; it != journalRestore_.end(); ++it) {
+        TransferTask t{it->upload ? TransferTask::Type::Upload
+                                  : TransferTask::Type::Download};
+        t.id = it->id;
+        t.src = QString::fromStdString(it->src);
+        t.dst = QString::fromStdString(it->dst);
+        t.replaceExisting = it->replaceExisting;
+        t.priority = it->priority;
+        t.sizeHint = it->sizeHint;
+        if (it->batchFiles) {
+            auto batch = std::make_shared<TransferBatch>();
+            batch->files = *it->batchFiles;
+            batch->totalBytes = it->batchTotalBytes;
+            t.batch = std::move(batch);
+        }
+        // It may have stopped mid-file: continue from the .part file.
+        t.resumeHint = true;
+        t.queuedAtMs = nowMs;
+        t.sessionKey = sessionKey_;
+        t.journaled = true;
+        if (it->state == openscp::JournalTaskState::Paused) {
+            t.status = TransferTask::Status::Paused;
+            pausedTasks_.insert(t.id);
+        } else if (it->state == openscp::JournalTaskState::Error) {
+            t.status = TransferTask::Status::Error;
+            t.error = QCoreApplication::translate(
+                "TransferManager", "Failed in a previous session.");
+            t.finishedAtMs = nowMs;
+        }
+        appendTaskLocked(t);
+        if (t.status == TransferTask::Status::Queued)
+            pushReadyLocked(tasks_.back());
+        ++count;
+    }
+    journalRestore_.erase(mine, journalRestore_.end());
+    qCInfo(ocXfer) << "restored journaled tasks"
+                   << "session=" << sessionKey_ << "tasks=" << count;
+    return true;
+}
+
+openscp::JournalTask
+TransferManager::journalTaskLocked(const QueuedTask &t) const {
+    openscp::JournalTask jt;
+    jt.id = t.id;
+    jt.upload = (t.type == TransferTask::Type::Upload);
+    jt.session = sessionKeyLocked(t).toStdString();
+    jt.src = paths_.str(t.src);
+    jt.dst = paths_.str(t.dst);
+    jt.state = journalStateFor(t.status);
+    jt.priority = t.priority;
+    jt.replaceExisting = t.replaceExisting;
+    jt.sizeHint = t.bytesTotal > 0 ? t.bytesTotal : t.sizeHint;
+    if (t.batch) {
+        // Share the file list with the task instead of copying it
+        jt.batchFiles = std::shared_ptr<const std::vector<std::string>>(
+            t.batch, &t.batch->files);
+        jt.batchTotalBytes = t.batch->totalBytes;
+    }
+    return jt;
+}
+
+void TransferManager::journalPutLocked(QueuedTask &t) {
+    if (!journal_.isOpen() || sessionKey_.isEmpty() ||
+        t.type == TransferTask::Type::RemoteCopy)
+        return;
+    t.session = internSessionKeyLocked(sessionKey_);
+    journal_.put(journalTaskLocked(t));
+    t.journaled = true;
+    armJournalFlush();
+}
+
+void TransferManager::journalStateLocked(QueuedTask &t) {
+    if (!t.journaled || !journal_.isOpen())
+        return;
+    // While suspended only completions count; the rest is the teardown.
+    if (journalSuspended_ && t.status != TransferTask::Status::Done)
+        return;
+    if (t.status == TransferTask::Status::Done ||
+        t.status == TransferTask::Status::Canceled) {
+        journal_.remove(t.id);
+        t.journaled = false;
+    } else {
+        journal_.setState(t.id, journalStateFor(t.status), t.priority);
+    }
+    armJournalFlush();
+}
+
+void TransferManager::journalForgetLocked(const QueuedTask &t) {
+    if (!t.journaled || !journal_.isOpen())
+        return;
+    journal_.remove(t.id);
+    armJournalFlush();
+}
+
+void TransferManager::armJournalFlush() {
+    // Callable from workers; the timer lives on the manager's thread.
+    if (journalFlushArmed_.exchange(true))
+        return;
+    QMetaObject::invokeMethod(
+        this,
+        [this] {
+            if (!journalFlushTimer_->isActive())
+                journalFlushTimer_->start();
+        },
+        Qt::QueuedConnection);
+}
+
+void TransferManager::flushJournal() {
+    journalFlushArmed_.store(false);
+    std::string err;
+    bool ok = true;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!journal_.isOpen())
+            return;
+        if (journal_.needsCompaction()) {
+            std::vector<openscp::JournalTask> live = journalRestore_;
+            live.reserve(live.size() + journal_.liveCount());
+            for (const auto &t : tasks_) {
+                if (t.journaled)
+                    live.push_back(journalTaskLocked(t));
+            }
+            ok = journal_.compact(live, err);
+        } else {
+            ok = journal_.flush(err);
+        }
+    }
+    if (!ok)
+        qCWarning(ocXfer) << "transfer journal write failed:"
+                          << QString::fromStdString(err);
 }
 
 void TransferManager::clearClient() {
@@ -221,6 +548,7 @@ void TransferManager::clearClient() {
                    << "runningCounter=" << running_.load();
     // Signal pause/cancel so workers cooperate and finish quickly.
     paused_ = true;
+    precheck_->clear();
     bool changed = false;
     const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
     {
@@ -229,19 +557,26 @@ void TransferManager::clearClient() {
         // wipe a newer session set by a subsequent reconnect.
         client_ = nullptr;
         sessionOpt_.reset();
+        sessionKey_.clear();
+        // Tasks cancelled by the disconnect leave the journal like any
+        // other cancel; only a quit keeps unfinished tasks for next start.
         resumeRequestedTasks_.clear();
         for (auto &t : tasks_) {
+            // Local copies do not depend on the session.
+            if (t.type == TransferTask::Type::LocalCopy)
+                continue;
             canceledTasks_.insert(t.id);
             if (t.status == TransferTask::Status::Queued ||
                 t.status == TransferTask::Status::Running ||
                 t.status == TransferTask::Status::Paused) {
-                t.status = TransferTask::Status::Canceled;
+                setStatusLocked(t, TransferTask::Status::Canceled);
                 t.currentSpeedKBps = 0.0;
                 t.etaSeconds = -1;
                 t.finishedAtMs = nowMs;
                 changed = true;
             }
         }
+        stopEpoch_.fetch_add(1);
     }
     if (changed)
         emit tasksChanged();
@@ -249,15 +584,8 @@ void TransferManager::clearClient() {
     // Nudge active workers so blocking I/O exits quickly on cancellation.
     interruptActiveWorkers();
 
-    std::unordered_map<quint64, std::thread> workersToJoin;
-    {
-        std::lock_guard<std::mutex> wl(workersMutex_);
-        workersToJoin.swap(workers_);
-    }
-    for (auto &kv : workersToJoin) {
-        if (kv.second.joinable())
-            kv.second.join();
-    }
+    waitForJobsIdle();
+    drainWorkerPool();
     qCInfo(ocXfer) << "clearClient finished"
                    << "elapsedMs="
                    << (QDateTime::currentMSecsSinceEpoch() - startedAtMs)
@@ -266,7 +594,254 @@ void TransferManager::clearClient() {
 
 QVector<TransferTask> TransferManager::tasksSnapshot() const {
     std::lock_guard<std::mutex> lk(mtx_);
-    return tasks_;
+    QVector<TransferTask> out;
+    out.reserve(tasks_.size());
+    // Running tasks publish progress through lock-free slots; overlay them.
+    for (const QueuedTask &q : tasks_) {
+        out.push_back(expandLocked(q));
+        overlayLiveProgressLocked(out.back());
+    }
+    return out;
+}
+
+QVector<TransferTask>
+TransferManager::tasksSnapshot(const QVector<quint64> &ids) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    QVector<TransferTask> out;
+    out.reserve(ids.size());
+    for (quint64 id : ids) {
+        const int i = indexForId(id);
+        if (i < 0)
+            continue;
+        out.push_back(expandLocked(tasks_[i]));
+        overlayLiveProgressLocked(out.back());
+    }
+    return out;
+}
+
+void TransferManager::overlayLiveProgressLocked(TransferTask &t) const {
+    if (t.status != TransferTask::Status::Running)
+        return;
+    auto it = liveProgress_.find(t.id);
+    if (it == liveProgress_.end())
+        return;
+    const LiveProgress &live = *it->second;
+    t.progress = live.progress.load();
+    t.bytesDone = live.bytesDone.load();
+    t.bytesTotal = live.bytesTotal.load();
+    t.currentSpeedKBps = live.currentSpeedKBps.load();
+    t.etaSeconds = live.etaSeconds.load();
+}
+
+bool TransferManager::taskAt(int row, TransferTask &out) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (row < 0 || row >= tasks_.size())
+        return false;
+    out = expandLocked(tasks_[row]);
+    overlayLiveProgressLocked(out);
+    return true;
+}
+
+int TransferManager::rowOf(quint64 id) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return indexForId(id);
+}
+
+int TransferManager::taskCount(quint64 &version) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    version = changeLog_.readVersion();
+    return static_cast<int>(tasks_.size());
+}
+
+bool TransferManager::changesSince(
+    quint64 &version, std::vector<TransferTaskChange> &out) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const std::size_t first = out.size();
+    std::uint64_t v = version;
+    if (!changeLog_.readSince(v, out))
+        return false;
+    for (std::size_t k = first; k < out.size(); ++k) {
+        if (out[k].kind == TransferTaskChange::Kind::Updated)
+            out[k].row = indexForId(out[k].id);
+    }
+    version = v;
+    return true;
+}
+
+TransferQueueCounts TransferManager::statusCounts() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    TransferQueueCounts c;
+    c.total = static_cast<int>(tasks_.size());
+    c.queued = statusCounts_[static_cast<int>(TransferTask::Status::Queued)];
+    c.running = statusCounts_[static_cast<int>(TransferTask::Status::Running)];
+    c.paused = statusCounts_[static_cast<int>(TransferTask::Status::Paused)];
+    c.done = statusCounts_[static_cast<int>(TransferTask::Status::Done)];
+    c.error = statusCounts_[static_cast<int>(TransferTask::Status::Error)];
+    c.canceled =
+        statusCounts_[static_cast<int>(TransferTask::Status::Canceled)];
+    return c;
+}
+
+void TransferManager::markProgressDirty(quint64 id) {
+    bool armTimer = false;
+    {
+        std::lock_guard<std::mutex> lk(dirtyMtx_);
+        armTimer = dirtyTaskIds_.empty();
+        dirtyTaskIds_.insert(id);
+    }
+    // Only the first dirty id of a batch arms the timer; the rest ride along.
+    if (!armTimer)
+        return;
+    QMetaObject::invokeMethod(
+        this,
+        [this] {
+            if (!progressFlushTimer_->isActive())
+                progressFlushTimer_->start();
+        },
+        Qt::QueuedConnection);
+}
+
+void TransferManager::flushDirtyProgress() {
+    std::unordered_set<quint64> dirty;
+    {
+        std::lock_guard<std::mutex> lk(dirtyMtx_);
+        dirty.swap(dirtyTaskIds_);
+    }
+    if (dirty.empty())
+        return;
+    QVector<quint64> ids;
+    ids.reserve(int(dirty.size()));
+    for (quint64 id : dirty)
+        ids.push_back(id);
+    emit tasksUpdated(ids);
+}
+
+void TransferManager::setAdaptiveConcurrency(bool enabled, int minWorkers,
+                                             int maxWorkers) {
+    if (!enabled) {
+        adaptive_.reset();
+        if (adaptiveTimer_)
+            adaptiveTimer_->stop();
+        return;
+    }
+    if (adaptive_) {
+        adaptive_->setBounds(minWorkers, maxWorkers);
+    } else {
+        adaptive_ = std::make_unique<openscp::ConcurrencyController>(
+            minWorkers, maxWorkers, kAdaptiveInitialWorkers);
+        adaptiveBytes_.store(0);
+        {
+            std::lock_guard<std::mutex> lk(perfMtx_);
+            adaptiveCompleted_ = 0;
+            adaptiveFailed_ = 0;
+            adaptiveTaskMs_ = 0;
+        }
+        adaptiveLastTickMs_ = QDateTime::currentMSecsSinceEpoch();
+    }
+    if (!adaptiveTimer_) {
+        adaptiveTimer_ = new QTimer(this);
+        adaptiveTimer_->setInterval(kAdaptiveIntervalMs);
+        connect(adaptiveTimer_, &QTimer::timeout, this,
+                &TransferManager::adaptConcurrency);
+    }
+    adaptiveTimer_->start();
+    setMaxConcurrent(adaptive_->limit());
+    schedule();
+}
+
+void TransferManager::adaptConcurrency() {
+    if (!adaptive_)
+        return;
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    openscp::ConcurrencySample sample;
+    sample.interval = std::chrono::milliseconds(nowMs - adaptiveLastTickMs_);
+    adaptiveLastTickMs_ = nowMs;
+    sample.bytes = adaptiveBytes_.exchange(0);
+    sample.rtt = std::chrono::milliseconds(adaptiveRttMs_.exchange(0));
+    {
+        std::lock_guard<std::mutex> lk(perfMtx_);
+        sample.completed = adaptiveCompleted_;
+        sample.failed = adaptiveFailed_;
+        if (adaptiveCompleted_ > 0)
+            sample.meanTaskTime = std::chrono::milliseconds(
+                adaptiveTaskMs_ / adaptiveCompleted_);
+        adaptiveCompleted_ = 0;
+        adaptiveFailed_ = 0;
+        adaptiveTaskMs_ = 0;
+    }
+    sample.active = running_.load();
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!client_)
+            return;
+        // May count tasks that left Queued since; close enough here.
+        sample.backlog = !readyQueue_.empty();
+    }
+    if (paused_)
+        return;
+
+    const int before = maxConcurrent_;
+    const int limit = adaptive_->update(sample);
+    if (limit == before)
+        return;
+    maxConcurrent_ = limit;
+    qCInfo(ocXfer) << "adaptive concurrency"
+                   << "limit=" << limit << "previous=" << before
+                   << "bytesPerSec="
+                   << (sample.interval.count() > 0
+                           ? sample.bytes * 1000 / sample.interval.count()
+                           : 0)
+                   << "completed=" << sample.completed
+                   << "networkErrors=" << sample.failed;
+    if (limit > before)
+        schedule();
+    else
+        trimWorkerPool(limit);
+}
+
+void TransferManager::trimWorkerPool(int keep) {
+    std::vector<PooledWorkerClient> extra;
+    {
+        std::lock_guard<std::mutex> lk(workerPoolMutex_);
+        while ((int)idleWorkerClients_.size() > keep) {
+            extra.push_back(std::move(idleWorkerClients_.back()));
+            idleWorkerClients_.pop_back();
+        }
+    }
+    for (auto &pooled : extra) {
+        if (pooled.client)
+            pooled.client->disconnect();
+    }
+}
+
+void TransferManager::setGlobalSpeedLimitKBps(int kbps) {
+    globalSpeedKBps_.store(std::max(0, kbps));
+    applyBandwidthLimits();
+}
+
+void TransferManager::setDirectionSpeedLimitKBps(TransferTask::Type type,
+                                                 int kbps) {
+    auto &slot = (type == TransferTask::Type::Upload) ? uploadSpeedKBps_
+                                                      : downloadSpeedKBps_;
+    slot.store(std::max(0, kbps));
+    applyBandwidthLimits();
+}
+
+int TransferManager::directionSpeedLimitKBps(TransferTask::Type type) const {
+    return (type == TransferTask::Type::Upload) ? uploadSpeedKBps_.load()
+                                                : downloadSpeedKBps_.load();
+}
+
+void TransferManager::applyBandwidthLimits() {
+    const int global = globalSpeedKBps_.load();
+    auto bytesPerSec = [global](int direction) -> std::uint64_t {
+        const int kbps = direction > 0 ? direction : global;
+        return kbps > 0 ? std::uint64_t(kbps) * 1024u : 0u;
+    };
+    bandwidth_.setRate(openscp::TransferDirection::Upload,
+                       bytesPerSec(uploadSpeedKBps_.load()));
+    bandwidth_.setRate(openscp::TransferDirection::Download,
+                       bytesPerSec(downloadSpeedKBps_.load()));
 }
 
 std::unique_ptr<openscp::SftpClient>
@@ -324,73 +899,468 @@ TransferManager::createWorkerClient(quint64 taskId, std::string &err) {
     return nullptr;
 }
 
-void TransferManager::enqueueUpload(const QString &local,
-                                    const QString &remote) {
-    TransferTask t{TransferTask::Type::Upload};
-    t.id = nextId_++;
-    t.src = local;
-    t.dst = remote;
-    t.queuedAtMs = QDateTime::currentMSecsSinceEpoch();
+std::shared_ptr<openscp::SftpClient>
+TransferManager::leaseWorkerClient(quint64 taskId, quint64 &generation,
+                                   std::string &err) {
+    // Sessions idle for longer than this are probed before reuse; servers and
+    // middleboxes commonly drop quiet SSH connections.
+    static constexpr qint64 kProbeIdleAfterMs = 15000;
+    {
+        // The job may have waited in the queue; do not hand a live session
+        // to a task that was canceled or paused meanwhile.
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (paused_.load() || canceledTasks_.count(taskId) > 0 ||
+            pausedTasks_.count(taskId) > 0) {
+            err = "Transfer queue paused/canceled";
+            return nullptr;
+        }
+    }
+    while (true) {
+        PooledWorkerClient pooled;
+        {
+            std::lock_guard<std::mutex> lk(workerPoolMutex_);
+            generation = workerPoolGeneration_;
+            if (idleWorkerClients_.empty())
+                break;
+            pooled = std::move(idleWorkerClients_.back());
+            idleWorkerClients_.pop_back();
+        }
+        bool healthy = pooled.client && pooled.client->isConnected();
+        const qint64 idleMs =
+            QDateTime::currentMSecsSinceEpoch() - pooled.idleSinceMs;
+        if (healthy && idleMs >= kProbeIdleAfterMs &&
+            pooled.client->capabilities().supports_metadata) {
+            bool isDir = false;
+            std::string probeErr;
+            (void)pooled.client->exists("/", isDir, probeErr);
+            healthy = probeErr.empty();
+        }
+        if (healthy) {
+            qCInfo(ocXfer) << "worker session reused"
+                           << "taskId=" << taskId << "idleMs=" << idleMs;
+            return pooled.client;
+        }
+        qCInfo(ocXfer) << "worker session discarded on lease"
+                       << "taskId=" << taskId << "idleMs=" << idleMs;
+        if (pooled.client)
+            pooled.client->disconnect();
+    }
+    std::unique_ptr<openscp::SftpClient> fresh =
+        createWorkerClient(taskId, err);
+    return std::shared_ptr<openscp::SftpClient>(std::move(fresh));
+}
+
+void TransferManager::returnWorkerClient(
+    quint64 taskId, std::shared_ptr<openscp::SftpClient> client,
+    quint64 generation, bool reusable) {
+    if (!client)
+        return;
+    bool interrupted = false;
+    {
+        std::lock_guard<std::mutex> lk(activeWorkersMutex_);
+        interrupted = interruptedWorkerTasks_.erase(taskId) > 0;
+    }
+    // A session is only kept if its task finished cleanly: an interrupt
+    // tears down the transport, and a failed transfer may leave the session
+    // in an unknown protocol state.
+    if (reusable && !interrupted && !paused_.load() && client->isConnected()) {
+        std::lock_guard<std::mutex> lk(workerPoolMutex_);
+        if (generation == workerPoolGeneration_ &&
+            (int)idleWorkerClients_.size() < maxConcurrent_) {
+            PooledWorkerClient pooled;
+            pooled.client = std::move(client);
+            pooled.idleSinceMs = QDateTime::currentMSecsSinceEpoch();
+            idleWorkerClients_.push_back(std::move(pooled));
+            return;
+        }
+    }
+    client->disconnect();
+}
+
+std::shared_ptr<openscp::SftpClient>
+TransferManager::takeIdleSession(quint64 &generation) {
+    std::lock_guard<std::mutex> lk(workerPoolMutex_);
+    generation = workerPoolGeneration_;
+    if (idleWorkerClients_.empty())
+        return nullptr;
+    std::shared_ptr<openscp::SftpClient> client =
+        std::move(idleWorkerClients_.back().client);
+    idleWorkerClients_.pop_back();
+    return client;
+}
+
+void TransferManager::returnSession(
+    std::shared_ptr<openscp::SftpClient> client, quint64 generation) {
+    // Task id 0 is never assigned; see downloadInSegments().
+    returnWorkerClient(0, std::move(client), generation, true);
+}
+
+void TransferManager::drainWorkerPool() {
+    std::vector<PooledWorkerClient> idle;
+    std::vector<PooledPeerClient> idlePeers;
+    {
+        std::lock_guard<std::mutex> lk(workerPoolMutex_);
+        ++workerPoolGeneration_;
+        idle.swap(idleWorkerClients_);
+        idlePeers.swap(idlePeerClients_);
+    }
+    for (auto &pooled : idle) {
+        if (pooled.client)
+            pooled.client->disconnect();
+    }
+    for (auto &pooled : idlePeers) {
+        if (pooled.client)
+            pooled.client->disconnect();
+    }
+}
+
+std::shared_ptr<openscp::SftpClient> TransferManager::leasePeerClient(
+    const std::shared_ptr<const openscp::SessionOptions> &peer,
+    std::string &err) {
+    if (!peer) {
+        err = "Missing destination server";
+        return nullptr;
+    }
+    while (true) {
+        std::shared_ptr<openscp::SftpClient> client;
+        {
+            std::lock_guard<std::mutex> lk(workerPoolMutex_);
+            auto it = std::find_if(idlePeerClients_.begin(),
+                                   idlePeerClients_.end(),
+                                   [&](const PooledPeerClient &p) {
+                                       return p.peer == peer;
+                                   });
+            if (it == idlePeerClients_.end())
+                break;
+            client = std::move(it->client);
+            idlePeerClients_.erase(it);
+        }
+        if (client && client->isConnected())
+            return client;
+    }
+    std::unique_ptr<openscp::SftpClient> fresh;
+    {
+        std::lock_guard<std::mutex> lk(connFactoryMutex_);
+        fresh = openscp::CreateConnectedClient(*peer, err);
+    }
+    if (!fresh && err.empty())
+        err = "Could not connect to the destination server";
+    return std::shared_ptr<openscp::SftpClient>(std::move(fresh));
+}
+
+void TransferManager::returnPeerClient(
+    std::shared_ptr<const openscp::SessionOptions> peer,
+    std::shared_ptr<openscp::SftpClient> client, bool reusable) {
+    if (!client)
+        return;
+    if (reusable && !paused_.load() && client->isConnected()) {
+        std::lock_guard<std::mutex> lk(workerPoolMutex_);
+        if ((int)idlePeerClients_.size() < maxConcurrent_) {
+            idlePeerClients_.push_back({std::move(peer), std::move(client)});
+            return;
+        }
+    }
+    client->disconnect();
+}
+
+void TransferManager::enqueueJob(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lk(jobQueueMutex_);
+        if (stopJobThreads_)
+            return;
+        // Grow the pool lazily up to the configured concurrency; threads are
+        // kept for the manager's lifetime instead of one per task.
+        while ((int)jobThreads_.size() < maxConcurrent_)
+            jobThreads_.emplace_back([this]() { jobThreadLoop(); });
+        jobQueue_.push_back(std::move(job));
+        ++pendingJobs_;
+    }
+    jobQueueCv_.notify_one();
+}
+
+void TransferManager::jobThreadLoop() {
+    openscp::setTraceThreadName("transfer-job");
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lk(jobQueueMutex_);
+            jobQueueCv_.wait(lk, [this]() {
+                return stopJobThreads_ || !jobQueue_.empty();
+            });
+            // On shutdown the queue is still drained so every job runs its
+            // cancellation path and releases its session.
+            if (jobQueue_.empty())
+                return;
+            job = std::move(jobQueue_.front());
+            jobQueue_.pop_front();
+        }
+        {
+            OPENSCP_TRACE_SPAN("task", "queue");
+            job();
+        }
+        {
+            std::lock_guard<std::mutex> lk(jobQueueMutex_);
+            --pendingJobs_;
+        }
+        jobsIdleCv_.notify_all();
+    }
+}
+
+void TransferManager::waitForJobsIdle() {
+    std::unique_lock<std::mutex> lk(jobQueueMutex_);
+    jobsIdleCv_.wait(lk, [this]() { return pendingJobs_ == 0; });
+}
+
+quint64 TransferManager::enqueueUpload(const QString &local,
+                                       const QString &remote,
+                                       bool replaceExisting) {
+    TransferRequest r;
+    r.type = TransferTask::Type::Upload;
+    r.src = local;
+    r.dst = remote;
+    r.replaceExisting = replaceExisting;
+    r.sizeHint = static_cast<quint64>(QFileInfo(local).size());
+    return enqueueMany({r});
+}
+
+quint64 TransferManager::enqueueDownload(const QString &remote,
+                                         const QString &local,
+                                         bool replaceExisting) {
+    TransferRequest r;
+    r.type = TransferTask::Type::Download;
+    r.src = remote;
+    r.dst = local;
+    r.replaceExisting = replaceExisting;
+    return enqueueMany({r});
+}
+
+quint64 TransferManager::enqueueMany(const QVector<TransferRequest> &requests) {
+    if (requests.isEmpty())
+        return 0;
+    const quint64 firstId = nextId_;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
     {
         // Protect the structure
         // (other functions will access concurrently)
         // mtx_ protects tasks_
         std::lock_guard<std::mutex> lk(mtx_);
-        tasks_.push_back(t);
+        tasks_.reserve(tasks_.size() + requests.size());
+        for (const TransferRequest &r : requests) {
+            TransferTask t{r.type};
+            t.id = nextId_++;
+            t.src = r.src;
+            t.dst = r.dst;
+            t.replaceExisting = r.replaceExisting;
+            t.sizeHint = r.sizeHint;
+            t.peer = r.peer;
+            t.queuedAtMs = now;
+            appendTaskLocked(t);
+            pushReadyLocked(tasks_.back());
+            journalPutLocked(tasks_.back());
+        }
     }
     emit tasksChanged();
     if (!paused_)
         schedule();
+    return firstId;
 }
 
-void TransferManager::enqueueDownload(const QString &remote,
-                                      const QString &local) {
-    TransferTask t{TransferTask::Type::Download};
+quint64 TransferManager::enqueueUploadBatch(const QString &localRoot,
+                                            std::vector<std::string> files,
+                                            const QString &remoteRoot,
+                                            quint64 totalBytes) {
+    TransferTask t{TransferTask::Type::Upload};
     t.id = nextId_++;
-    t.src = remote;
-    t.dst = local;
+    t.src = localRoot;
+    t.dst = remoteRoot;
     t.queuedAtMs = QDateTime::currentMSecsSinceEpoch();
+    auto batch = std::make_shared<TransferBatch>();
+    batch->files = std::move(files);
+    batch->totalBytes = totalBytes;
+    t.batch = std::move(batch);
+    t.sizeHint = totalBytes;
     {
         std::lock_guard<std::mutex> lk(mtx_);
-        tasks_.push_back(t);
+        appendTaskLocked(t);
+        pushReadyLocked(tasks_.back());
+        journalPutLocked(tasks_.back());
     }
     emit tasksChanged();
     if (!paused_)
         schedule();
+    return t.id;
 }
 
-void TransferManager::pauseAll() {
-    paused_ = true;
+quint64 TransferManager::enqueueDownloadBatch(const QString &remoteRoot,
+                                              std::vector<std::string> files,
+                                              const QString &localRoot,
+                                              quint64 totalBytes) {
+    TransferTask t{TransferTask::Type::Download};
+    t.id = nextId_++;
+    t.src = remoteRoot;
+    t.dst = localRoot;
+    t.queuedAtMs = QDateTime::currentMSecsSinceEpoch();
+    auto batch = std::make_shared<TransferBatch>();
+    batch->files = std::move(files);
+    batch->totalBytes = totalBytes;
+    t.batch = std::move(batch);
+    t.sizeHint = totalBytes;
     {
         std::lock_guard<std::mutex> lk(mtx_);
-        for (auto &t : tasks_) {
-            if (t.status == TransferTask::Status::Running) {
-                pausedTasks_.insert(t.id);
-                t.status = TransferTask::Status::Paused;
-                t.currentSpeedKBps = 0.0;
-                t.etaSeconds = -1;
-                t.finishedAtMs = 0;
-            }
-        }
+        appendTaskLocked(t);
+        pushReadyLocked(tasks_.back());
+        journalPutLocked(tasks_.back());
     }
     emit tasksChanged();
-    interruptActiveWorkers();
+    if (!paused_)
+        schedule();
+    return t.id;
 }
 
-void TransferManager::resumeAll() {
-    bool changed = false;
-    if (paused_) {
-        paused_ = false;
-        changed = true;
+quint64
+TransferManager::startLocalCopy(std::vector<openscp::LocalCopyItem> items,
+                                bool move, LocalCopyDone done) {
+    TransferTask t{TransferTask::Type::LocalCopy};
+    t.id = nextId_++;
+    if (items.size() == 1) {
+        t.src = QString::fromStdString(items.front().source);
+        t.dst = QString::fromStdString(items.front().target);
+    } else if (!items.empty()) {
+        t.src = QFileInfo(QString::fromStdString(items.front().source))
+                    .absolutePath();
+        t.dst = QFileInfo(QString::fromStdString(items.front().target))
+                    .absolutePath();
     }
-    std::unordered_set<quint64> activeNow;
+    t.status = TransferTask::Status::Running;
+    t.queuedAtMs = QDateTime::currentMSecsSinceEpoch();
+    t.startedAtMs = t.queuedAtMs;
+    const quint64 id = t.id;
     {
-        std::lock_guard<std::mutex> lk(activeWorkersMutex_);
-        activeNow.reserve(activeWorkerClients_.size());
-        for (const auto &kv : activeWorkerClients_)
-            activeNow.insert(kv.first);
+        std::lock_guard<std::mutex> lk(mtx_);
+        appendTaskLocked(t);
+        ++localCopiesInFlight_;
     }
-    {
+    emit tasksChanged();
+
+    std::thread([this, id, move, items = std::move(items),
+                 done = std::move(done)]() {
+        openscp::LocalCopyOptions opt;
+        opt.threads = kLocalCopyThreads;
+        opt.move = move;
+        opt.progress = [this, id](std::uint64_t copied, std::uint64_t total) {
+            updateLocalCopyProgress(id, copied, total);
+        };
+        opt.shouldCancel = [this, id] {
+            std::lock_guard<std::mutex> lk(mtx_);
+            return canceledTasks_.count(id) > 0;
+        };
+        std::vector<openscp::LocalCopyOutcome> outcomes;
+        (void)openscp::runLocalCopy(items, opt, outcomes);
+        QMetaObject::invokeMethod(
+            this,
+            [this, id, outcomes, done] {
+                finishLocalCopy(id, outcomes);
+                if (done)
+                    done(outcomes);
+            },
+            Qt::QueuedConnection);
+        // Notify under the lock: once the count reaches zero the destructor
+        // may return and destroy the cv as soon as it can take mtx_.
+        std::lock_guard<std::mutex> lk(mtx_);
+        --localCopiesInFlight_;
+        localCopiesIdleCv_.notify_all();
+    }).detach();
+    return id;
+}
+
+void TransferManager::updateLocalCopyProgress(quint64 id, quint64 done,
+                                              quint64 total) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        const int i = indexForId(id);
+        if (i < 0 || tasks_[i].status != TransferTask::Status::Running)
+            return;
+        QueuedTask &t = tasks_[i];
+        t.bytesDone = done;
+        t.bytesTotal = total;
+        t.progress = total > 0 ? int(done * 100 / total) : 0;
+        const qint64 elapsedMs =
+            QDateTime::currentMSecsSinceEpoch() - t.startedAtMs;
+        if (elapsedMs > 0) {
+            t.currentSpeedKBps = (double(done) / 1024.0) / (elapsedMs / 1000.0);
+            t.etaSeconds =
+                (t.currentSpeedKBps > 0.0 && total >= done)
+                    ? int(double(total - done) / 1024.0 / t.currentSpeedKBps)
+                    : -1;
+        }
+    }
+    markProgressDirty(id);
+}
+
+void TransferManager::finishLocalCopy(
+    quint64 id, const std::vector<openscp::LocalCopyOutcome> &out) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        canceledTasks_.erase(id);
+        const int i = indexForId(id);
+        if (i < 0)
+            return;
+        QueuedTask &t = tasks_[i];
+        t.currentSpeedKBps = 0.0;
+        t.etaSeconds = -1;
+        if (t.status == TransferTask::Status::Running) {
+            auto failed = std::find_if(
+                out.begin(), out.end(),
+                [](const openscp::LocalCopyOutcome &o) { return !o.ok; });
+            if (failed == out.end()) {
+                setStatusLocked(t, TransferTask::Status::Done);
+                t.progress = 100;
+                t.bytesDone = t.bytesTotal;
+            } else {
+                setStatusLocked(t, TransferTask::Status::Error);
+                setErrorLocked(t, QString::fromStdString(failed->error));
+            }
+            t.finishedAtMs = QDateTime::currentMSecsSinceEpoch();
+        }
+    }
+    emit tasksChanged();
+}
+
+void TransferManager::pauseAll() {
+    paused_ = true;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (auto &t : tasks_) {
+            if (t.status == TransferTask::Status::Running &&
+                t.type != TransferTask::Type::LocalCopy) {
+                pausedTasks_.insert(t.id);
+                setStatusLocked(t, TransferTask::Status::Paused);
+                t.currentSpeedKBps = 0.0;
+                t.etaSeconds = -1;
+                t.finishedAtMs = 0;
+                journalStateLocked(t);
+            }
+        }
+        stopEpoch_.fetch_add(1);
+    }
+    emit tasksChanged();
+    interruptActiveWorkers();
+}
+
+void TransferManager::resumeAll() {
+    bool changed = false;
+    if (paused_) {
+        paused_ = false;
+        changed = true;
+    }
+    std::unordered_set<quint64> activeNow;
+    {
+        std::lock_guard<std::mutex> lk(activeWorkersMutex_);
+        activeNow.reserve(activeWorkerClients_.size());
+        for (const auto &kv : activeWorkerClients_)
+            activeNow.insert(kv.first);
+    }
+    {
         std::lock_guard<std::mutex> lk(mtx_);
         const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
         for (auto &t : tasks_) {
@@ -400,11 +1370,13 @@ void TransferManager::resumeAll() {
                     // until it fully exits.
                     resumeRequestedTasks_.insert(t.id);
                 } else {
-                    t.status = TransferTask::Status::Queued;
+                    setStatusLocked(t, TransferTask::Status::Queued);
                     t.resumeHint = true;
                     t.queuedAtMs = nowMs;
                     t.startedAtMs = 0;
                     t.finishedAtMs = 0;
+                    pushReadyLocked(t);
+                    journalStateLocked(t);
                     pausedTasks_.erase(t.id);
                     resumeRequestedTasks_.erase(t.id);
                     changed = true;
@@ -433,12 +1405,14 @@ void TransferManager::cancelAll() {
                 ++affected;
                 if (t.status == TransferTask::Status::Running)
                     ++runningNow;
-                t.status = TransferTask::Status::Canceled;
+                setStatusLocked(t, TransferTask::Status::Canceled);
                 t.currentSpeedKBps = 0.0;
                 t.etaSeconds = -1;
                 t.finishedAtMs = nowMs;
+                journalStateLocked(t);
             }
         }
+        stopEpoch_.fetch_add(1);
     }
     emit tasksChanged();
     qCInfo(ocXfer) << "cancelAll requested"
@@ -452,19 +1426,28 @@ void TransferManager::retryFailed() {
         std::lock_guard<std::mutex> lk(mtx_);
         const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
         for (auto &t : tasks_) {
+            if (t.type == TransferTask::Type::LocalCopy)
+                continue;
             if (t.status == TransferTask::Status::Error ||
                 t.status == TransferTask::Status::Canceled) {
-                t.status = TransferTask::Status::Queued;
+                setStatusLocked(t, TransferTask::Status::Queued);
                 t.attempts = 0;
                 t.progress = 0;
                 t.bytesDone = 0;
+                if (t.bytesTotal > 0)
+                    t.sizeHint = t.bytesTotal;
                 t.bytesTotal = 0;
                 t.currentSpeedKBps = 0.0;
                 t.etaSeconds = -1;
-                t.error.clear();
+                setErrorLocked(t, QString());
                 t.queuedAtMs = nowMs;
                 t.startedAtMs = 0;
                 t.finishedAtMs = 0;
+                pushReadyLocked(t);
+                if (t.journaled)
+                    journalStateLocked(t);
+                else
+                    journalPutLocked(t);
                 canceledTasks_.erase(t.id);
                 pausedTasks_.erase(t.id);
             }
@@ -479,21 +1462,29 @@ void TransferManager::retryTask(quint64 id) {
     {
         std::lock_guard<std::mutex> lk(mtx_);
         int i = indexForId(id);
-        if (i >= 0 && (tasks_[i].status == TransferTask::Status::Error ||
-                       tasks_[i].status == TransferTask::Status::Canceled)) {
+        if (i >= 0 && tasks_[i].type != TransferTask::Type::LocalCopy &&
+            (tasks_[i].status == TransferTask::Status::Error ||
+             tasks_[i].status == TransferTask::Status::Canceled)) {
             auto &t = tasks_[i];
             const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
-            t.status = TransferTask::Status::Queued;
+            setStatusLocked(t, TransferTask::Status::Queued);
             t.attempts = 0;
             t.progress = 0;
             t.bytesDone = 0;
+            if (t.bytesTotal > 0)
+                t.sizeHint = t.bytesTotal;
             t.bytesTotal = 0;
             t.currentSpeedKBps = 0.0;
             t.etaSeconds = -1;
-            t.error.clear();
+            setErrorLocked(t, QString());
             t.queuedAtMs = nowMs;
             t.startedAtMs = 0;
             t.finishedAtMs = 0;
+            pushReadyLocked(t);
+            if (t.journaled)
+                journalStateLocked(t);
+            else
+                journalPutLocked(t);
             canceledTasks_.erase(t.id);
             pausedTasks_.erase(t.id);
             changed = true;
@@ -508,29 +1499,9 @@ void TransferManager::retryTask(quint64 id) {
 void TransferManager::clearCompleted() {
     {
         std::lock_guard<std::mutex> lk(mtx_);
-        QVector<TransferTask> next;
-        next.reserve(tasks_.size());
-        for (const auto &t : tasks_) {
-            if (t.status != TransferTask::Status::Done)
-                next.push_back(t);
-        }
-        tasks_.swap(next);
-        std::unordered_set<quint64> remainingIds;
-        remainingIds.reserve(tasks_.size());
-        for (const auto &t : tasks_)
-            remainingIds.insert(t.id);
-        for (auto it = canceledTasks_.begin(); it != canceledTasks_.end();) {
-            if (!remainingIds.count(*it))
-                it = canceledTasks_.erase(it);
-            else
-                ++it;
-        }
-        for (auto it = pausedTasks_.begin(); it != pausedTasks_.end();) {
-            if (!remainingIds.count(*it))
-                it = pausedTasks_.erase(it);
-            else
-                ++it;
-        }
+        removeTasksLocked([](const QueuedTask &t) {
+            return t.status == TransferTask::Status::Done;
+        });
     }
     emit tasksChanged();
 }
@@ -538,30 +1509,13 @@ void TransferManager::clearCompleted() {
 void TransferManager::clearFailedCanceled() {
     {
         std::lock_guard<std::mutex> lk(mtx_);
-        QVector<TransferTask> next;
-        next.reserve(tasks_.size());
-        for (const auto &t : tasks_) {
+        removeTasksLocked([this](const QueuedTask &t) {
             if (t.status != TransferTask::Status::Error &&
                 t.status != TransferTask::Status::Canceled)
-                next.push_back(t);
-        }
-        tasks_.swap(next);
-        std::unordered_set<quint64> remainingIds;
-        remainingIds.reserve(tasks_.size());
-        for (const auto &t : tasks_)
-            remainingIds.insert(t.id);
-        for (auto it = canceledTasks_.begin(); it != canceledTasks_.end();) {
-            if (!remainingIds.count(*it))
-                it = canceledTasks_.erase(it);
-            else
-                ++it;
-        }
-        for (auto it = pausedTasks_.begin(); it != pausedTasks_.end();) {
-            if (!remainingIds.count(*it))
-                it = pausedTasks_.erase(it);
-            else
-                ++it;
-        }
+                return false;
+            journalForgetLocked(t);
+            return true;
+        });
     }
     emit tasksChanged();
 }
@@ -575,9 +1529,7 @@ void TransferManager::clearFinishedOlderThan(int minutes, bool clearDone,
     bool changed = false;
     {
         std::lock_guard<std::mutex> lk(mtx_);
-        QVector<TransferTask> next;
-        next.reserve(tasks_.size());
-        for (const auto &t : tasks_) {
+        auto expired = [&](const QueuedTask &t) {
             const bool isDone = (t.status == TransferTask::Status::Done);
             const bool isFailed = (t.status == TransferTask::Status::Error ||
                                    t.status == TransferTask::Status::Canceled);
@@ -585,32 +1537,12 @@ void TransferManager::clearFinishedOlderThan(int minutes, bool clearDone,
                 (clearDone && isDone) || (clearFailedCanceled && isFailed);
             const bool oldEnough =
                 (t.finishedAtMs > 0 && t.finishedAtMs <= cutoff);
-            if (candidate && oldEnough) {
-                changed = true;
-                continue;
-            }
-            next.push_back(t);
-        }
-        tasks_.swap(next);
-        if (changed) {
-            std::unordered_set<quint64> remainingIds;
-            remainingIds.reserve(tasks_.size());
-            for (const auto &t : tasks_)
-                remainingIds.insert(t.id);
-            for (auto it = canceledTasks_.begin();
-                 it != canceledTasks_.end();) {
-                if (!remainingIds.count(*it))
-                    it = canceledTasks_.erase(it);
-                else
-                    ++it;
-            }
-            for (auto it = pausedTasks_.begin(); it != pausedTasks_.end();) {
-                if (!remainingIds.count(*it))
-                    it = pausedTasks_.erase(it);
-                else
-                    ++it;
-            }
-        }
+            if (!candidate || !oldEnough)
+                return false;
+            journalForgetLocked(t);
+            return true;
+        };
+        changed = removeTasksLocked(expired) > 0;
     }
     if (changed)
         emit tasksChanged();
@@ -621,31 +1553,27 @@ void TransferManager::processNext() {
     schedule();
 }
 
-int TransferManager::nextQueuedTaskIndexLocked() {
-    if (tasks_.isEmpty()) {
-        schedulingCursor_ = 0;
-        return -1;
-    }
-    if (schedulingCursor_ < 0 || schedulingCursor_ >= tasks_.size())
-        schedulingCursor_ = 0;
+void TransferManager::pushReadyLocked(const QueuedTask &t) {
+    quint64 size = t.bytesTotal > 0 ? t.bytesTotal : t.sizeHint;
+    readyQueue_.push(t.id, t.priority,
+                     size > 0 ? size : openscp::kUnknownTransferSize);
+}
 
-    const int total = tasks_.size();
-    for (int off = 0; off < total; ++off) {
-        const int idx = (schedulingCursor_ + off) % total;
-        if (tasks_[idx].status == TransferTask::Status::Queued) {
-            schedulingCursor_ = (idx + 1) % total;
+int TransferManager::nextQueuedTaskIndexLocked() {
+    while (auto id = readyQueue_.pop(maxConcurrent_)) {
+        const int idx = indexForId(*id);
+        if (idx >= 0 && tasks_[idx].status == TransferTask::Status::Queued)
             return idx;
-        }
+        // Paused, canceled or removed since it was queued
+        readyQueue_.release(*id);
     }
     return -1;
 }
 
-void TransferManager::recordCompletionMetrics(quint64 taskId,
-                                              TransferTask::Status status,
-                                              quint64 bytesDone,
-                                              qint64 queueLatencyMs,
-                                              qint64 precheckMs,
-                                              qint64 transferMs) {
+void TransferManager::recordCompletionMetrics(
+    quint64 taskId, const std::string &backend, TransferTask::Type type,
+    TransferTask::Status status, quint64 bytesDone, qint64 queueLatencyMs,
+    qint64 precheckMs, qint64 transferMs, const std::string &rawError) {
     if (queueLatencyMs < 0)
         queueLatencyMs = 0;
     if (precheckMs < 0)
@@ -668,13 +1596,35 @@ void TransferManager::recordCompletionMetrics(quint64 taskId,
                    << "bytesDone=" << bytesDone
                    << "throughputKBps=" << throughputKBps;
 
+    metrics_.recordPhase(backend, openscp::TransferPhase::Precheck,
+                         std::chrono::milliseconds(precheckMs));
+    metrics_.addBytes(backend,
+                      type == TransferTask::Type::Upload
+                          ? openscp::TransferDirection::Upload
+                          : openscp::TransferDirection::Download,
+                      bytesDone);
+    if (status == TransferTask::Status::Done ||
+        status == TransferTask::Status::Error)
+        metrics_.recordTask(backend, status == TransferTask::Status::Done);
+    if (status == TransferTask::Status::Error)
+        metrics_.recordError(backend,
+                             openscp::classifyTransferError(rawError));
+
     const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
-    std::lock_guard<std::mutex> lk(perfMtx_);
+    std::unique_lock<std::mutex> lk(perfMtx_);
     perfCompletedTasks_ += 1;
     perfCompletedBytes_ += bytesDone;
     perfTotalQueueLatencyMs_ += queueLatencyMs;
     perfTotalPrecheckMs_ += precheckMs;
     perfTotalTransferMs_ += transferMs;
+    if (status == TransferTask::Status::Done) {
+        adaptiveCompleted_ += 1;
+        adaptiveTaskMs_ += transferMs;
+    } else if (status == TransferTask::Status::Error &&
+               openscp::classifyTransferError(rawError) ==
+                   openscp::TransferErrorClass::Network) {
+        adaptiveFailed_ += 1;
+    }
 
     const bool periodic =
         ((nowMs - perfLastLogAtMs_) >= 10000) || (perfCompletedTasks_ % 10 == 0);
@@ -699,11 +1649,21 @@ void TransferManager::recordCompletionMetrics(quint64 taskId,
                    << "avgTransferMs=" << avgTransferMs
                    << "aggThroughputKBps=" << aggThroughputKBps
                    << "runningCounter=" << running_.load();
+
+    lk.unlock();
+    if (!metricsTarget_.empty()) {
+        std::string exportErr;
+        if (!metrics_.exportTo(metricsTarget_, metricsFormat_, nowMs,
+                               exportErr))
+            qCWarning(ocXfer) << "metrics export failed:"
+                              << QString::fromStdString(exportErr);
+    }
 }
 
 void TransferManager::schedule() {
     if (paused_)
         return;
+    OPENSCP_TRACE_SPAN("schedule", "queue");
 
     while (running_.load() < maxConcurrent_) {
         TransferTask t;
@@ -715,14 +1675,14 @@ void TransferManager::schedule() {
             idx = nextQueuedTaskIndexLocked();
             if (idx >= 0) {
                 const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
-                t = tasks_[idx];
-                tasks_[idx].status = TransferTask::Status::Running;
+                t = expandLocked(tasks_[idx]);
+                setStatusLocked(tasks_[idx], TransferTask::Status::Running);
                 tasks_[idx].progress = 0;
                 tasks_[idx].bytesDone = 0;
                 tasks_[idx].bytesTotal = 0;
                 tasks_[idx].currentSpeedKBps = 0.0;
                 tasks_[idx].etaSeconds = -1;
-                tasks_[idx].error.clear();
+                setErrorLocked(tasks_[idx], QString());
                 tasks_[idx].startedAtMs = nowMs;
                 tasks_[idx].finishedAtMs = 0;
             }
@@ -733,658 +1693,1212 @@ void TransferManager::schedule() {
 
         running_.fetch_add(1);
         const quint64 taskId = t.id;
-        const bool workerActiveNow = isWorkerActive(taskId);
-        bool deferredRelaunch = false;
-        {
-            std::lock_guard<std::mutex> wl(workersMutex_);
-            auto it = workers_.find(taskId);
-            if (it != workers_.end() && it->second.joinable()) {
-                if (workerActiveNow) {
-                    // Do not block UI by joining an active worker; defer this
-                    // relaunch until the existing worker fully exits.
-                    {
-                        std::lock_guard<std::mutex> lk(mtx_);
-                        int i = indexForId(taskId);
-                        if (i >= 0) {
-                            tasks_[i].status = TransferTask::Status::Paused;
+        if (isWorkerActive(taskId)) {
+            // A previous job for this task is still unwinding (e.g. from a
+            // pause); defer this relaunch until that job fully exits.
+            {
+                std::lock_guard<std::mutex> lk(mtx_);
+                int i = indexForId(taskId);
+                if (i >= 0) {
+                    setStatusLocked(tasks_[i], TransferTask::Status::Paused);
+                    tasks_[i].currentSpeedKBps = 0.0;
+                    tasks_[i].etaSeconds = -1;
+                    tasks_[i].finishedAtMs = 0;
+                    pausedTasks_.insert(taskId);
+                    resumeRequestedTasks_.insert(taskId);
+                    stopEpoch_.fetch_add(1);
+                    journalStateLocked(tasks_[i]);
+                }
+                readyQueue_.release(taskId);
+            }
+            emit tasksChanged();
+            qCInfo(ocXfer) << "schedule deferred relaunch; worker still active"
+                           << "taskId=" << taskId;
+            decrementRunningCounter();
+            continue;
+        }
+
+        enqueueJob([this, t, taskId]() mutable {
+            auto finalize = [this, taskId]() {
+                {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    readyQueue_.release(taskId);
+                }
+                decrementRunningCounter();
+                QMetaObject::invokeMethod(this, "schedule",
+                                          Qt::QueuedConnection);
+            };
+            std::string backend = "unknown";
+            bool integrityChecked = false;
+            {
+                std::lock_guard<std::mutex> lk(mtx_);
+                if (sessionOpt_) {
+                    backend =
+                        openscp::protocolMetricLabel(sessionOpt_->protocol);
+                    integrityChecked =
+                        sessionOpt_->transfer_integrity_policy !=
+                        openscp::TransferIntegrityPolicy::Off;
+                }
+            }
+            std::string lastRawError; // classified into metrics_ on failure
+            auto emitAndFinalize = [this, taskId, &t, &backend, &lastRawError,
+                                    &finalize](qint64 precheckMs,
+                                       qint64 transferStartMs) {
+                qint64 transferMs = 0;
+                if (transferStartMs > 0) {
+                    transferMs = QDateTime::currentMSecsSinceEpoch() -
+                                 transferStartMs;
+                }
+
+                TransferTask::Status finalStatus =
+                    TransferTask::Status::Error;
+                quint64 bytesDone = 0;
+                qint64 queueLatencyMs = 0;
+                {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    const int i = indexForId(taskId);
+                    if (i >= 0) {
+                        journalStateLocked(tasks_[i]);
+                        finalStatus = tasks_[i].status;
+                        bytesDone = tasks_[i].bytesDone;
+                        if (tasks_[i].queuedAtMs > 0 &&
+                            tasks_[i].startedAtMs >=
+                                tasks_[i].queuedAtMs) {
+                            queueLatencyMs = tasks_[i].startedAtMs -
+                                             tasks_[i].queuedAtMs;
+                        }
+                    }
+                }
+                emit tasksChanged();
+                recordCompletionMetrics(taskId, backend, t.type, finalStatus,
+                                        bytesDone, queueLatencyMs, precheckMs,
+                                        transferMs, lastRawError);
+                finalize();
+            };
+
+            struct ActiveWorkerGuard {
+                TransferManager *self = nullptr;
+                quint64 id = 0;
+                ~ActiveWorkerGuard() {
+                    if (!self)
+                        return;
+                    std::lock_guard<std::mutex> lk(
+                        self->activeWorkersMutex_);
+                    const std::size_t prevCount =
+                        self->activeWorkerTaskIds_.size();
+                    self->activeWorkerClients_.erase(id);
+                    self->extraWorkerClients_.erase(id);
+                    self->activeWorkerTaskIds_.erase(id);
+                    self->pendingInterruptTasks_.erase(id);
+                    qCInfo(ocXfer) << "worker active cleared"
+                                   << "taskId=" << id
+                                   << "prevActiveCount=" << prevCount
+                                   << "activeCount="
+                                   << self->activeWorkerTaskIds_.size();
+                }
+            };
+            std::string err;
+            {
+                std::lock_guard<std::mutex> lk(activeWorkersMutex_);
+                activeWorkerTaskIds_.insert(taskId);
+                qCInfo(ocXfer) << "worker active registered"
+                               << "taskId=" << taskId
+                               << "activeCount="
+                               << activeWorkerTaskIds_.size();
+            }
+            quint64 leaseGeneration = 0;
+            const std::int64_t connectStartUs = steadyNowUs();
+            openscp::TraceSpan leaseSpan("task.lease", "queue");
+            std::shared_ptr<openscp::SftpClient> workerClient =
+                leaseWorkerClient(taskId, leaseGeneration, err);
+            leaseSpan.end();
+            metrics_.recordPhase(
+                backend, openscp::TransferPhase::Connect,
+                std::chrono::microseconds(steadyNowUs() - connectStartUs));
+            if (!workerClient) {
+                {
+                    std::lock_guard<std::mutex> lk(activeWorkersMutex_);
+                    activeWorkerTaskIds_.erase(taskId);
+                    pendingInterruptTasks_.erase(taskId);
+                    interruptedWorkerTasks_.erase(taskId);
+                }
+                const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+                {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    int i = indexForId(taskId);
+                    if (i >= 0) {
+                        const bool explicitlyCanceled =
+                            canceledTasks_.count(taskId) > 0;
+                        const bool pausedTask =
+                            !explicitlyCanceled &&
+                            (pausedTasks_.count(taskId) > 0 ||
+                             paused_.load());
+                        if (explicitlyCanceled || pausedTask) {
+                            setStatusLocked(tasks_[i],
+                                            explicitlyCanceled
+                                                ? TransferTask::Status::Canceled
+                                                : TransferTask::Status::Paused);
+                            setErrorLocked(tasks_[i], QString());
+                            tasks_[i].currentSpeedKBps = 0.0;
+                            tasks_[i].etaSeconds = -1;
+                            tasks_[i].finishedAtMs =
+                                explicitlyCanceled ? nowMs : 0;
+                        } else {
+                            setStatusLocked(tasks_[i],
+                                            TransferTask::Status::Error);
+                            setErrorLocked(tasks_[i], transferErrorForUi(err));
+                            lastRawError = err;
                             tasks_[i].currentSpeedKBps = 0.0;
                             tasks_[i].etaSeconds = -1;
-                            tasks_[i].finishedAtMs = 0;
-                            pausedTasks_.insert(taskId);
-                            resumeRequestedTasks_.insert(taskId);
+                            tasks_[i].finishedAtMs = nowMs;
                         }
                     }
-                    deferredRelaunch = true;
-                } else {
-                    qCInfo(ocXfer) << "schedule joining finished worker thread"
-                                   << "taskId=" << taskId;
-                    it->second.join();
                 }
+                emitAndFinalize(0, 0);
+                return;
             }
-            if (!deferredRelaunch) {
-                workers_[taskId] =
-                std::thread([this, t, taskId]() mutable {
-                    auto finalize = [this]() {
-                        decrementRunningCounter();
-                        QMetaObject::invokeMethod(this, "schedule",
-                                                  Qt::QueuedConnection);
-                    };
-                    auto emitAndFinalize = [this, taskId, &finalize](
-                                               qint64 precheckMs,
-                                               qint64 transferStartMs) {
-                        qint64 transferMs = 0;
-                        if (transferStartMs > 0) {
-                            transferMs = QDateTime::currentMSecsSinceEpoch() -
-                                         transferStartMs;
-                        }
+            std::optional<ActiveWorkerGuard> activeGuard;
+            bool applyDeferredInterrupt = false;
+            {
+                std::lock_guard<std::mutex> lk(activeWorkersMutex_);
+                activeWorkerClients_[taskId] = workerClient;
+                applyDeferredInterrupt =
+                    pendingInterruptTasks_.erase(taskId) > 0;
+            }
+            if (applyDeferredInterrupt) {
+                qCInfo(ocXfer) << "Applying deferred interrupt to worker"
+                               << "taskId=" << taskId;
+                workerClient->interrupt();
+            }
+            // Construct in-place to avoid a temporary guard whose
+            // destructor would clear active state immediately.
+            activeGuard.emplace();
+            activeGuard->self = this;
+            activeGuard->id = taskId;
+            // Hand the session back to the pool (or drop it). The
+            // active-worker entry is cleared first so a late
+            // interrupt cannot reach a session leased to another task.
+            auto releaseWorker = [this, taskId, leaseGeneration,
+                                  &workerClient,
+                                  &activeGuard](bool reusable) {
+                activeGuard.reset();
+                returnWorkerClient(taskId, std::move(workerClient),
+                                   leaseGeneration, reusable);
+            };
+            const openscp::ProtocolCapabilities workerCaps =
+                workerClient->capabilities();
+
+            // Mark attempt and publish the lock-free progress slot
+            auto live = std::make_shared<LiveProgress>();
+            {
+                std::lock_guard<std::mutex> lk(mtx_);
+                int i = indexForId(taskId);
+                if (i >= 0) {
+                    tasks_[i].attempts += 1;
+                    noteTaskUpdatedLocked(taskId);
+                    live->speedLimitKBps.store(tasks_[i].speedLimitKBps);
+                }
+                liveProgress_[taskId] = live;
+            }
+            struct LiveProgressGuard {
+                TransferManager *self = nullptr;
+                quint64 id = 0;
+                std::shared_ptr<LiveProgress> live;
+                ~LiveProgressGuard() {
+                    std::lock_guard<std::mutex> lk(self->mtx_);
+                    auto it = self->liveProgress_.find(id);
+                    if (it != self->liveProgress_.end() && it->second == live)
+                        self->liveProgress_.erase(it);
+                }
+            } liveGuard{this, taskId, live};
+            emit tasksChanged();
 
-                        TransferTask::Status finalStatus =
-                            TransferTask::Status::Error;
-                        quint64 bytesDone = 0;
-                        qint64 queueLatencyMs = 0;
-                        {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            const int i = indexForId(taskId);
-                            if (i >= 0) {
-                                finalStatus = tasks_[i].status;
-                                bytesDone = tasks_[i].bytesDone;
-                                if (tasks_[i].queuedAtMs > 0 &&
-                                    tasks_[i].startedAtMs >=
-                                        tasks_[i].queuedAtMs) {
-                                    queueLatencyMs = tasks_[i].startedAtMs -
-                                                     tasks_[i].queuedAtMs;
-                                }
-                            }
-                        }
-                        emit tasksChanged();
-                        recordCompletionMetrics(taskId, finalStatus, bytesDone,
-                                                queueLatencyMs, precheckMs,
-                                                transferMs);
-                        finalize();
-                    };
+            // Polled per chunk by the backends. mtx_ is only taken when a
+            // pause/cancel was requested somewhere since the last check.
+            auto shouldCancel = [this, taskId,
+                                 seenEpoch = ~quint64(0)]() mutable -> bool {
+                if (paused_.load())
+                    return true;
+                const quint64 epoch = stopEpoch_.load();
+                if (epoch == seenEpoch)
+                    return false;
+                std::lock_guard<std::mutex> lk(mtx_);
+                const bool stop = canceledTasks_.count(taskId) > 0 ||
+                                  pausedTasks_.count(taskId) > 0;
+                if (!stop)
+                    seenEpoch = epoch;
+                return stop;
+            };
+            // Fold the final counters back into tasks_ once the backend
+            // call has returned.
+            auto marks = std::make_shared<TaskPhaseMarks>();
+            auto foldLiveProgress = [this, taskId, live, marks]() {
+                marks->returnedUs.store(steadyNowUs());
+                std::lock_guard<std::mutex> lk(mtx_);
+                const int i = indexForId(taskId);
+                if (i >= 0) {
+                    tasks_[i].progress = live->progress.load();
+                    tasks_[i].bytesDone = live->bytesDone.load();
+                    tasks_[i].bytesTotal = live->bytesTotal.load();
+                }
+            };
 
-                    struct ActiveWorkerGuard {
-                        TransferManager *self = nullptr;
-                        quint64 id = 0;
-                        ~ActiveWorkerGuard() {
-                            if (!self)
-                                return;
-                            std::lock_guard<std::mutex> lk(
-                                self->activeWorkersMutex_);
-                            const std::size_t prevCount =
-                                self->activeWorkerTaskIds_.size();
-                            self->activeWorkerClients_.erase(id);
-                            self->activeWorkerTaskIds_.erase(id);
-                            self->pendingInterruptTasks_.erase(id);
-                            qCInfo(ocXfer) << "worker active cleared"
-                                           << "taskId=" << id
-                                           << "prevActiveCount=" << prevCount
-                                           << "activeCount="
-                                           << self->activeWorkerTaskIds_.size();
-                        }
+            auto markCanceledOrPaused = [this, taskId](qint64 nowMs) {
+                std::lock_guard<std::mutex> lk(mtx_);
+                const int i = indexForId(taskId);
+                if (i < 0)
+                    return;
+                const bool canceled = canceledTasks_.count(taskId) > 0;
+                setStatusLocked(tasks_[i],
+                                canceled ? TransferTask::Status::Canceled
+                                         : TransferTask::Status::Paused);
+                setErrorLocked(tasks_[i], QString());
+                tasks_[i].currentSpeedKBps = 0.0;
+                tasks_[i].etaSeconds = -1;
+                tasks_[i].finishedAtMs = canceled ? nowMs : 0;
+            };
+
+            bool resume = t.resumeHint;
+            bool delta = false;
+            const qint64 precheckStartedMs =
+                QDateTime::currentMSecsSinceEpoch();
+            auto precheckDoneMs = precheckStartedMs;
+            openscp::TraceSpan precheckSpan("task.precheck", "queue");
+            auto failPrecheck = [this, taskId, &shouldCancel, &lastRawError,
+                                 &markCanceledOrPaused,
+                                 &emitAndFinalize, &releaseWorker,
+                                 &precheckStartedMs, &precheckDoneMs](
+                                    const std::string &rawErr) {
+                precheckDoneMs = QDateTime::currentMSecsSinceEpoch();
+                const qint64 nowMs = precheckDoneMs;
+                if (shouldCancel()) {
+                    markCanceledOrPaused(nowMs);
+                } else {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    const int i = indexForId(taskId);
+                    if (i >= 0) {
+                        setStatusLocked(tasks_[i], TransferTask::Status::Error);
+                        setErrorLocked(tasks_[i], transferErrorForUi(rawErr));
+                        lastRawError = rawErr;
+                        tasks_[i].currentSpeedKBps = 0.0;
+                        tasks_[i].etaSeconds = -1;
+                        tasks_[i].finishedAtMs = nowMs;
+                    }
+                }
+                releaseWorker(false);
+                emitAndFinalize(precheckDoneMs - precheckStartedMs, 0);
+            };
+            auto skipTransfer = [this, taskId, &emitAndFinalize,
+                                 &releaseWorker, &precheckStartedMs,
+                                 &precheckDoneMs]() {
+                precheckDoneMs = QDateTime::currentMSecsSinceEpoch();
+                {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    const int i = indexForId(taskId);
+                    if (i >= 0) {
+                        setStatusLocked(tasks_[i], TransferTask::Status::Done);
+                        tasks_[i].currentSpeedKBps = 0.0;
+                        tasks_[i].etaSeconds = 0;
+                        tasks_[i].finishedAtMs = precheckDoneMs;
+                    }
+                }
+                releaseWorker(true);
+                emitAndFinalize(precheckDoneMs - precheckStartedMs, 0);
+            };
+
+            // RemoteCopy: the session to the destination server.
+            std::shared_ptr<openscp::SftpClient> peerClient;
+            if (t.batch) {
+                // Archive batches replace files in place and create their
+                // own directories; per-file prompts do not apply.
+            } else if (t.type == TransferTask::Type::RemoteCopy) {
+                std::string peerErr;
+                peerClient = leasePeerClient(t.peer, peerErr);
+                if (!peerClient) {
+                    failPrecheck(peerErr);
+                    return;
+                }
+                // Cancelling the task must also stop the destination side.
+                registerExtraWorkerClient(taskId, peerClient);
+                const openscp::ProtocolCapabilities peerCaps =
+                    peerClient->capabilities();
+                if (!workerCaps.supports_streaming ||
+                    !peerCaps.supports_streaming) {
+                    failPrecheck("Streamed copies are not supported between "
+                                 "these servers.");
+                    return;
+                }
+                const std::string dst = t.dst.toStdString();
+                openscp::FileInfo dinfo{};
+                std::string stErr;
+                if (peerClient->stat(dst, dinfo, stErr) &&
+                    !t.replaceExisting) {
+                    openscp::FileInfo sinfo{};
+                    std::string sErr;
+                    (void)workerClient->stat(t.src.toStdString(), sinfo, sErr);
+                    auto describe = [](const openscp::FileInfo &fi) {
+                        return QString("%1 bytes, %2")
+                            .arg(fi.size)
+                            .arg(fi.mtime ? openscpui::localShortTime(
+                                                (quint64)fi.mtime)
+                                          : QStringLiteral("?"));
                     };
-                    std::string err;
-                    {
-                        std::lock_guard<std::mutex> lk(activeWorkersMutex_);
-                        activeWorkerTaskIds_.insert(taskId);
-                        qCInfo(ocXfer) << "worker active registered"
-                                       << "taskId=" << taskId
-                                       << "activeCount="
-                                       << activeWorkerTaskIds_.size();
+                    int choice = askOverwriteConflictOnUi(
+                        this, QFileInfo(t.dst).fileName(), describe(sinfo),
+                        describe(dinfo), shouldCancel);
+                    if (choice < 0 || shouldCancel()) {
+                        precheckDoneMs = QDateTime::currentMSecsSinceEpoch();
+                        markCanceledOrPaused(precheckDoneMs);
+                        releaseWorker(false);
+                        emitAndFinalize(precheckDoneMs - precheckStartedMs,
+                                        0);
+                        return;
                     }
-                    auto workerClientUnique = createWorkerClient(taskId, err);
-                    if (!workerClientUnique) {
-                        {
-                            std::lock_guard<std::mutex> lk(activeWorkersMutex_);
-                            activeWorkerTaskIds_.erase(taskId);
-                            pendingInterruptTasks_.erase(taskId);
-                        }
-                        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
-                        {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            int i = indexForId(taskId);
-                            if (i >= 0) {
-                                const bool explicitlyCanceled =
-                                    canceledTasks_.count(taskId) > 0;
-                                const bool pausedTask =
-                                    !explicitlyCanceled &&
-                                    (pausedTasks_.count(taskId) > 0 ||
-                                     paused_.load());
-                                if (explicitlyCanceled || pausedTask) {
-                                    tasks_[i].status =
-                                        explicitlyCanceled
-                                            ? TransferTask::Status::Canceled
-                                            : TransferTask::Status::Paused;
-                                    tasks_[i].error.clear();
-                                    tasks_[i].currentSpeedKBps = 0.0;
-                                    tasks_[i].etaSeconds = -1;
-                                    tasks_[i].finishedAtMs =
-                                        explicitlyCanceled ? nowMs : 0;
-                                } else {
-                                    tasks_[i].status = TransferTask::Status::Error;
-                                    tasks_[i].error = transferErrorForUi(err);
-                                    tasks_[i].currentSpeedKBps = 0.0;
-                                    tasks_[i].etaSeconds = -1;
-                                    tasks_[i].finishedAtMs = nowMs;
-                                }
-                            }
-                        }
-                        emitAndFinalize(0, 0);
+                    if (choice == 0) {
+                        skipTransfer();
                         return;
                     }
-                    std::shared_ptr<openscp::SftpClient> workerClient =
-                        std::move(workerClientUnique);
-                    std::optional<ActiveWorkerGuard> activeGuard;
-                    bool applyDeferredInterrupt = false;
-                    {
-                        std::lock_guard<std::mutex> lk(activeWorkersMutex_);
-                        activeWorkerClients_[taskId] = workerClient;
-                        applyDeferredInterrupt =
-                            pendingInterruptTasks_.erase(taskId) > 0;
+                    resume = (choice == 2);
+                }
+                if (!workerCaps.supports_resume || !peerCaps.supports_resume)
+                    resume = false;
+
+                // Create the destination folder one component at a time.
+                const QString parentDir = QFileInfo(t.dst).path();
+                QString cur = "/";
+                for (const QString &part :
+                     parentDir.split('/', Qt::SkipEmptyParts)) {
+                    cur = (cur == "/") ? ("/" + part) : (cur + "/" + part);
+                    bool isDir = false;
+                    std::string e;
+                    if (peerClient->exists(cur.toStdString(), isDir, e)) {
+                        if (!isDir) {
+                            failPrecheck("Remote path component is not a "
+                                         "directory: " +
+                                         cur.toStdString());
+                            return;
+                        }
+                        continue;
                     }
-                    if (applyDeferredInterrupt) {
-                        qCInfo(ocXfer) << "Applying deferred interrupt to worker"
-                                       << "taskId=" << taskId;
-                        workerClient->interrupt();
+                    if (!e.empty()) {
+                        failPrecheck(e);
+                        return;
                     }
-                    // Construct in-place to avoid a temporary guard whose
-                    // destructor would clear active state immediately.
-                    activeGuard.emplace();
-                    activeGuard->self = this;
-                    activeGuard->id = taskId;
-                    const openscp::ProtocolCapabilities workerCaps =
-                        workerClient->capabilities();
-
-                    // Mark attempt
-                    {
-                        std::lock_guard<std::mutex> lk(mtx_);
-                        int i = indexForId(taskId);
-                        if (i >= 0)
-                            tasks_[i].attempts += 1;
+                    std::string me;
+                    if (!peerClient->mkdir(cur.toStdString(), me, 0755) &&
+                        !(peerClient->exists(cur.toStdString(), isDir, e) &&
+                          isDir)) {
+                        failPrecheck(me.empty()
+                                         ? "Could not create remote "
+                                           "directory: " +
+                                               cur.toStdString()
+                                         : me);
+                        return;
                     }
-                    emit tasksChanged();
-
-                    auto isCanceled = [this, taskId]() -> bool {
-                        std::lock_guard<std::mutex> lk(mtx_);
-                        return canceledTasks_.count(taskId) > 0;
-                    };
-                    auto isPausedTask = [this, taskId]() -> bool {
-                        std::lock_guard<std::mutex> lk(mtx_);
-                        return pausedTasks_.count(taskId) > 0;
-                    };
-                    auto shouldCancel = [this, isCanceled, isPausedTask]() -> bool {
-                        if (paused_.load())
-                            return true;
-                        if (isCanceled())
-                            return true;
-                        if (isPausedTask())
-                            return true;
-                        return false;
-                    };
-
-                    auto markCanceledOrPaused = [this, taskId](qint64 nowMs) {
-                        std::lock_guard<std::mutex> lk(mtx_);
-                        const int i = indexForId(taskId);
-                        if (i < 0)
+                }
+            } else if (t.type == TransferTask::Type::Upload) {
+                if (workerCaps.supports_metadata) {
+                    // Siblings share one listing of the destination folder;
+                    // ask the server per file only if it cannot be listed.
+                    bool existsRemote = false;
+                    openscp::FileInfo rinfo{};
+                    std::string existsErr;
+                    if (!precheck_->lookup(*workerClient, t.dst.toStdString(),
+                                          existsRemote, rinfo, existsErr)) {
+                        bool isDir = false;
+                        existsErr.clear();
+                        existsRemote = workerClient->exists(
+                            t.dst.toStdString(), isDir, existsErr);
+                        if (!existsErr.empty()) {
+                            failPrecheck(existsErr);
                             return;
-                        const bool canceled = canceledTasks_.count(taskId) > 0;
-                        tasks_[i].status = canceled
-                                               ? TransferTask::Status::Canceled
-                                               : TransferTask::Status::Paused;
-                        tasks_[i].error.clear();
-                        tasks_[i].currentSpeedKBps = 0.0;
-                        tasks_[i].etaSeconds = -1;
-                        tasks_[i].finishedAtMs = canceled ? nowMs : 0;
-                    };
+                        }
+                        if (existsRemote) {
+                            std::string stErr;
+                            (void)workerClient->stat(t.dst.toStdString(),
+                                                     rinfo, stErr);
+                        }
+                    }
 
-                    bool resume = t.resumeHint;
-                    const qint64 precheckStartedMs =
-                        QDateTime::currentMSecsSinceEpoch();
-                    auto precheckDoneMs = precheckStartedMs;
-                    auto failPrecheck = [this, taskId, &shouldCancel,
-                                         &markCanceledOrPaused,
-                                         &emitAndFinalize, &workerClient,
-                                         &precheckStartedMs, &precheckDoneMs](
-                                            const std::string &rawErr) {
-                        precheckDoneMs = QDateTime::currentMSecsSinceEpoch();
-                        const qint64 nowMs = precheckDoneMs;
-                        if (shouldCancel()) {
-                            markCanceledOrPaused(nowMs);
-                        } else {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            const int i = indexForId(taskId);
-                            if (i >= 0) {
-                                tasks_[i].status = TransferTask::Status::Error;
-                                tasks_[i].error = transferErrorForUi(rawErr);
-                                tasks_[i].currentSpeedKBps = 0.0;
-                                tasks_[i].etaSeconds = -1;
-                                tasks_[i].finishedAtMs = nowMs;
-                            }
+                    if (existsRemote) {
+                        const QString srcInfo =
+                            QString("%1 bytes, %2")
+                                .arg(QFileInfo(t.src).size())
+                                .arg(openscpui::localShortTime(
+                                    QFileInfo(t.src).lastModified()));
+                        const QString dstInfo =
+                            QString("%1 bytes, %2")
+                                .arg(rinfo.size)
+                                .arg(rinfo.mtime
+                                         ? openscpui::localShortTime(
+                                               (quint64)rinfo.mtime)
+                                         : QStringLiteral("?"));
+                        int choice =
+                            t.replaceExisting
+                                ? 1
+                                : askOverwriteConflictOnUi(
+                                      this, QFileInfo(t.src).fileName(),
+                                      srcInfo, dstInfo, shouldCancel);
+                        if (choice < 0 || shouldCancel()) {
+                            precheckDoneMs =
+                                QDateTime::currentMSecsSinceEpoch();
+                            markCanceledOrPaused(precheckDoneMs);
+                            releaseWorker(false);
+                            emitAndFinalize(precheckDoneMs -
+                                                precheckStartedMs,
+                                            0);
+                            return;
                         }
-                        workerClient->disconnect();
-                        emitAndFinalize(precheckDoneMs - precheckStartedMs, 0);
-                    };
-                    auto skipTransfer = [this, taskId, &emitAndFinalize,
-                                         &workerClient, &precheckStartedMs,
-                                         &precheckDoneMs]() {
-                        precheckDoneMs = QDateTime::currentMSecsSinceEpoch();
-                        {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            const int i = indexForId(taskId);
-                            if (i >= 0) {
-                                tasks_[i].status = TransferTask::Status::Done;
-                                tasks_[i].currentSpeedKBps = 0.0;
-                                tasks_[i].etaSeconds = 0;
-                                tasks_[i].finishedAtMs = precheckDoneMs;
-                            }
+                        if (choice == 0) {
+                            skipTransfer();
+                            return;
                         }
-                        workerClient->disconnect();
-                        emitAndFinalize(precheckDoneMs - precheckStartedMs, 0);
-                    };
+                        if (choice == 2 &&
+                            !workerCaps.supports_resume) {
+                            choice = 1;
+                        }
+                        resume = (choice == 2);
+                        delta = choice == 1 &&
+                                workerCaps.supports_delta_upload &&
+                                rinfo.size >= kDeltaUploadMinBytes &&
+                                quint64(QFileInfo(t.src).size()) >=
+                                    kDeltaUploadMinBytes;
+                    }
+                }
 
-                    if (t.type == TransferTask::Type::Upload) {
-                        if (workerCaps.supports_metadata) {
-                            bool isDir = false;
-                            std::string existsErr;
-                            const bool existsRemote = workerClient->exists(
-                                t.dst.toStdString(), isDir, existsErr);
-                            if (!existsErr.empty()) {
-                                failPrecheck(existsErr);
-                                return;
-                            }
+                if (resume && !workerCaps.supports_resume)
+                    resume = false;
 
-                            if (existsRemote) {
-                                openscp::FileInfo rinfo{};
-                                std::string stErr;
-                                (void)workerClient->stat(
-                                    t.dst.toStdString(), rinfo, stErr);
-                                const QString srcInfo =
-                                    QString("%1 bytes, %2")
-                                        .arg(QFileInfo(t.src).size())
-                                        .arg(openscpui::localShortTime(
-                                            QFileInfo(t.src).lastModified()));
-                                const QString dstInfo =
-                                    QString("%1 bytes, %2")
-                                        .arg(rinfo.size)
-                                        .arg(rinfo.mtime
-                                                 ? openscpui::localShortTime(
-                                                       (quint64)rinfo.mtime)
-                                                 : QStringLiteral("?"));
-                                int choice = askOverwriteConflictOnUi(
-                                    this, QFileInfo(t.src).fileName(), srcInfo,
-                                    dstInfo, shouldCancel);
-                                if (choice < 0 || shouldCancel()) {
-                                    precheckDoneMs =
-                                        QDateTime::currentMSecsSinceEpoch();
-                                    markCanceledOrPaused(precheckDoneMs);
-                                    workerClient->disconnect();
-                                    emitAndFinalize(precheckDoneMs -
-                                                        precheckStartedMs,
-                                                    0);
-                                    return;
-                                }
-                                if (choice == 0) {
-                                    skipTransfer();
-                                    return;
-                                }
-                                if (choice == 2 &&
-                                    !workerCaps.supports_resume) {
-                                    choice = 1;
-                                }
-                                resume = (choice == 2);
+                if (workerCaps.supports_metadata) {
+                    auto ensureRemoteDir =
+                        [&](const QString &dir,
+                            std::string &ensureErr) -> bool {
+                        if (dir.isEmpty())
+                            return true;
+                        QString cur = "/";
+                        const QStringList parts =
+                            dir.split('/', Qt::SkipEmptyParts);
+                        for (const QString &part : parts) {
+                            const QString next =
+                                (cur == "/") ? ("/" + part)
+                                             : (cur + "/" + part);
+                            bool isD = false;
+                            bool exs = false;
+                            openscp::FileInfo cinfo{};
+                            std::string e;
+                            if (precheck_->lookup(*workerClient,
+                                                 next.toStdString(), exs,
+                                                 cinfo, e)) {
+                                isD = cinfo.is_dir;
+                            } else {
+                                e.clear();
+                                exs = workerClient->exists(next.toStdString(),
+                                                           isD, e);
                             }
-                        }
-
-                        if (resume && !workerCaps.supports_resume)
-                            resume = false;
-
-                        if (workerCaps.supports_metadata) {
-                            auto ensureRemoteDir =
-                                [&](const QString &dir,
-                                    std::string &ensureErr) -> bool {
-                                if (dir.isEmpty())
-                                    return true;
-                                QString cur = "/";
-                                const QStringList parts =
-                                    dir.split('/', Qt::SkipEmptyParts);
-                                for (const QString &part : parts) {
-                                    const QString next =
-                                        (cur == "/") ? ("/" + part)
-                                                     : (cur + "/" + part);
-                                    bool isD = false;
-                                    std::string e;
-                                    const bool exs = workerClient->exists(
-                                        next.toStdString(), isD, e);
-                                    if (!e.empty()) {
-                                        ensureErr = e;
-                                        return false;
-                                    }
-                                    if (!exs) {
-                                        std::string me;
-                                        if (!workerClient->mkdir(
-                                                next.toStdString(), me, 0755)) {
-                                            ensureErr = me.empty()
-                                                            ? ("Could not "
-                                                               "create remote "
-                                                               "directory: " +
-                                                               next.toStdString())
-                                                            : me;
-                                            return false;
-                                        }
-                                    } else if (!isD) {
+                            if (!e.empty()) {
+                                ensureErr = e;
+                                return false;
+                            }
+                            if (!exs) {
+                                std::string me;
+                                if (workerClient->mkdir(next.toStdString(), me,
+                                                        0755)) {
+                                    precheck_->noteDirectory(
+                                        next.toStdString());
+                                } else {
+                                    // Another worker may have just created
+                                    // it for a sibling file.
+                                    std::string e2;
+                                    if (!workerClient->exists(
+                                            next.toStdString(), isD, e2) ||
+                                        !isD) {
                                         ensureErr =
-                                            "Remote path component is not a "
-                                            "directory: " +
-                                            next.toStdString();
+                                            me.empty()
+                                                ? ("Could not "
+                                                   "create remote "
+                                                   "directory: " +
+                                                   next.toStdString())
+                                                : me;
                                         return false;
                                     }
-                                    cur = next;
-                                }
-                                return true;
-                            };
-
-                            const QString parentDir = QFileInfo(t.dst).path();
-                            if (!parentDir.isEmpty()) {
-                                std::string ensureErr;
-                                if (!ensureRemoteDir(parentDir, ensureErr)) {
-                                    failPrecheck(ensureErr);
-                                    return;
+                                    precheck_->invalidate(next.toStdString());
                                 }
+                            } else if (!isD) {
+                                ensureErr =
+                                    "Remote path component is not a "
+                                    "directory: " +
+                                    next.toStdString();
+                                return false;
                             }
+                            cur = next;
                         }
-                    } else {
-                        const QFileInfo lfi(t.dst);
-                        if (lfi.exists()) {
-                            QString srcInfo = QStringLiteral("? bytes, ?");
-                            if (workerCaps.supports_metadata) {
-                                openscp::FileInfo rinfo{};
-                                std::string stErr;
-                                (void)workerClient->stat(t.src.toStdString(),
-                                                         rinfo, stErr);
-                                srcInfo = QString("%1 bytes, %2")
-                                              .arg(rinfo.size)
-                                              .arg(rinfo.mtime
-                                                       ? openscpui::localShortTime(
-                                                             (quint64)rinfo.mtime)
-                                                       : QStringLiteral("?"));
-                            }
-                            const QString dstInfo =
-                                QString("%1 bytes, %2")
-                                    .arg(lfi.size())
-                                    .arg(openscpui::localShortTime(
-                                        lfi.lastModified()));
-                            int choice = askOverwriteConflictOnUi(
-                                this, lfi.fileName(), srcInfo, dstInfo,
-                                shouldCancel);
-                            if (choice < 0 || shouldCancel()) {
-                                precheckDoneMs =
-                                    QDateTime::currentMSecsSinceEpoch();
-                                markCanceledOrPaused(precheckDoneMs);
-                                workerClient->disconnect();
-                                emitAndFinalize(precheckDoneMs -
-                                                    precheckStartedMs,
-                                                0);
-                                return;
-                            }
-                            if (choice == 0) {
-                                skipTransfer();
-                                return;
-                            }
-                            if (choice == 2 && !workerCaps.supports_resume)
-                                choice = 1;
-                            resume = (choice == 2);
-                        }
-                        if (!QDir().mkpath(QFileInfo(t.dst).dir().absolutePath())) {
-                            failPrecheck("Could not create local destination "
-                                         "directory");
+                        return true;
+                    };
+
+                    // Listing the destination folder above already proved
+                    // that it exists.
+                    const QString parentDir = QFileInfo(t.dst).path();
+                    if (!parentDir.isEmpty() &&
+                        !precheck_->knownDirectory(parentDir.toStdString())) {
+                        std::string ensureErr;
+                        if (!ensureRemoteDir(parentDir, ensureErr)) {
+                            failPrecheck(ensureErr);
                             return;
                         }
                     }
+                }
+            } else {
+                const QFileInfo lfi(t.dst);
+                if (lfi.exists() && !t.replaceExisting) {
+                    QString srcInfo = QStringLiteral("? bytes, ?");
+                    if (workerCaps.supports_metadata) {
+                        openscp::FileInfo rinfo{};
+                        std::string stErr;
+                        (void)workerClient->stat(t.src.toStdString(),
+                                                 rinfo, stErr);
+                        srcInfo = QString("%1 bytes, %2")
+                                      .arg(rinfo.size)
+                                      .arg(rinfo.mtime
+                                               ? openscpui::localShortTime(
+                                                     (quint64)rinfo.mtime)
+                                               : QStringLiteral("?"));
+                    }
+                    const QString dstInfo =
+                        QString("%1 bytes, %2")
+                            .arg(lfi.size())
+                            .arg(openscpui::localShortTime(
+                                lfi.lastModified()));
+                    int choice = askOverwriteConflictOnUi(
+                        this, lfi.fileName(), srcInfo, dstInfo,
+                        shouldCancel);
+                    if (choice < 0 || shouldCancel()) {
+                        precheckDoneMs =
+                            QDateTime::currentMSecsSinceEpoch();
+                        markCanceledOrPaused(precheckDoneMs);
+                        releaseWorker(false);
+                        emitAndFinalize(precheckDoneMs -
+                                            precheckStartedMs,
+                                        0);
+                        return;
+                    }
+                    if (choice == 0) {
+                        skipTransfer();
+                        return;
+                    }
+                    if (choice == 2 && !workerCaps.supports_resume)
+                        choice = 1;
+                    resume = (choice == 2);
+                }
+                if (!QDir().mkpath(QFileInfo(t.dst).dir().absolutePath())) {
+                    failPrecheck("Could not create local destination "
+                                 "directory");
+                    return;
+                }
+            }
 
-                    if (resume && !workerCaps.supports_resume)
-                        resume = false;
-
-                    precheckDoneMs = QDateTime::currentMSecsSinceEpoch();
-
-                    // Speed control (per task and global): simple bucket-based
-                    // throttling
-                    using clock = std::chrono::steady_clock;
-                    static constexpr double KIB = 1024.0;
-                    std::size_t lastDone = 0;
-                    auto lastTick = clock::now();
-                    auto progress = [this, taskId, lastTick, lastDone](
-                                        std::size_t done,
-                                        std::size_t total) mutable {
-                        int pct = (total > 0) ? int((done * 100) / total) : 0;
-                        const auto now = clock::now();
-                        const double elapsedSec =
-                            std::chrono::duration_cast<
-                                std::chrono::duration<double>>(now - lastTick)
-                                .count();
-                        const double deltaBytes =
-                            (done > lastDone) ? double(done - lastDone) : 0.0;
-                        double measuredKBps = 0.0;
-                        if (elapsedSec > 0.000001 && deltaBytes > 0.0) {
-                            measuredKBps = (deltaBytes / KIB) / elapsedSec;
-                        }
-                        int etaSec = -1;
-                        if (total > done && measuredKBps > 0.0) {
-                            etaSec =
-                                int((double(total - done) / KIB) / measuredKBps);
-                        } else if (total > 0 && done >= total) {
-                            etaSec = 0;
-                        }
-                        {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            int i = indexForId(taskId);
-                            if (i >= 0) {
-                                tasks_[i].progress = pct;
-                                tasks_[i].bytesDone = done;
-                                tasks_[i].bytesTotal = total;
-                                if (measuredKBps > 0.0)
-                                    tasks_[i].currentSpeedKBps = measuredKBps;
-                                tasks_[i].etaSeconds = etaSec;
-                            }
-                        }
-                        emit tasksChanged();
-
-                        int taskLimit = 0; // KB/s (0 = unlimited)
-                        int globalLimit = globalSpeedKBps_.load();
-                        {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            int i = indexForId(taskId);
-                            if (i >= 0)
-                                taskLimit = tasks_[i].speedLimitKBps;
-                        }
-                        int effKBps = 0;
-                        if (taskLimit > 0 && globalLimit > 0)
-                            effKBps = std::min(taskLimit, globalLimit);
-                        else
-                            effKBps = (taskLimit > 0
-                                           ? taskLimit
-                                           : (globalLimit > 0 ? globalLimit : 0));
-                        if (effKBps > 0 && done > lastDone) {
-                            const auto now2 = clock::now();
-                            const double deltaBytes2 = double(done - lastDone);
-                            const double expectedSec = deltaBytes2 / (effKBps * KIB);
-                            const double elapsedSec2 =
-                                std::chrono::duration_cast<
-                                    std::chrono::duration<double>>(now2 - lastTick)
-                                    .count();
-                            if (elapsedSec2 < expectedSec) {
-                                const double sleepSec = expectedSec - elapsedSec2;
-                                if (sleepSec > 0.0005) {
-                                    std::this_thread::sleep_for(
-                                        std::chrono::duration<double>(sleepSec));
-                                }
-                            }
-                            lastTick = clock::now();
-                            lastDone = done;
+            if (resume && !workerCaps.supports_resume)
+                resume = false;
+
+            precheckDoneMs = QDateTime::currentMSecsSinceEpoch();
+            precheckSpan.end();
+
+            // Speed control: every chunk is charged to the shared
+            // per-direction budget, with the task limit as a per-flow cap.
+            using clock = std::chrono::steady_clock;
+            static constexpr double KIB = 1024.0;
+            std::shared_ptr<openscp::BandwidthScheduler::Flow> flow =
+                bandwidth_.openFlow(t.type == TransferTask::Type::Upload
+                                        ? openscp::TransferDirection::Upload
+                                        : openscp::TransferDirection::Download);
+            std::size_t lastDone = 0;
+            // Without resume every reported byte crossed the wire, so the
+            // meter starts at zero instead of at the first report.
+            std::optional<std::size_t> lastMetered;
+            if (!resume)
+                lastMetered = 0;
+            auto lastTick = clock::now();
+            auto progress = [this, taskId, live, flow, shouldCancel, lastTick,
+                             lastDone, lastMetered,
+                             marks](std::size_t done,
+                                    std::size_t total) mutable {
+                if (done > 0) {
+                    std::int64_t unset = 0;
+                    const std::int64_t nowUs = steadyNowUs();
+                    marks->firstByteUs.compare_exchange_strong(unset, nowUs);
+                    if (total > 0 && done >= total)
+                        marks->lastByteUs.store(nowUs);
+                }
+                int pct = (total > 0) ? int((done * 100) / total) : 0;
+                const auto now = clock::now();
+                const double elapsedSec =
+                    std::chrono::duration_cast<
+                        std::chrono::duration<double>>(now - lastTick)
+                        .count();
+                const double deltaBytes =
+                    (done > lastDone) ? double(done - lastDone) : 0.0;
+                double measuredKBps = 0.0;
+                if (elapsedSec > 0.000001 && deltaBytes > 0.0) {
+                    measuredKBps = (deltaBytes / KIB) / elapsedSec;
+                }
+                int etaSec = -1;
+                if (total > done && measuredKBps > 0.0) {
+                    etaSec =
+                        int((double(total - done) / KIB) / measuredKBps);
+                } else if (total > 0 && done >= total) {
+                    etaSec = 0;
+                }
+                live->progress.store(pct);
+                live->bytesDone.store(done);
+                live->bytesTotal.store(total);
+                if (measuredKBps > 0.0)
+                    live->currentSpeedKBps.store(measuredKBps);
+                live->etaSeconds.store(etaSec);
+                markProgressDirty(taskId);
+
+                // The first report may include a resumed prefix that never
+                // crossed the wire; it only sets the metering baseline.
+                if (!lastMetered)
+                    lastMetered = done;
+                const int taskLimit = live->speedLimitKBps.load();
+                const std::uint64_t capBytes =
+                    taskLimit > 0 ? std::uint64_t(taskLimit) * 1024u : 0u;
+                flow->setRateLimit(capBytes);
+                const bool throttled =
+                    taskLimit > 0 || bandwidth_.rate(flow->direction()) > 0;
+                if (done > *lastMetered) {
+                    adaptiveBytes_.fetch_add(done - *lastMetered,
+                                             std::memory_order_relaxed);
+                    bandwidth_.acquire(*flow, done - *lastMetered,
+                                       shouldCancel);
+                    lastMetered = done;
+                }
+                if (throttled && done > lastDone) {
+                    lastTick = clock::now();
+                    lastDone = done;
+                }
+            };
+
+            const qint64 transferStartedMs =
+                QDateTime::currentMSecsSinceEpoch();
+            marks->transferStartUs = steadyNowUs();
+            openscp::TraceSpan transferSpan("task.transfer", "queue");
+            bool ok = false;
+            if (t.type == TransferTask::Type::Upload ||
+                t.type == TransferTask::Type::RemoteCopy || t.batch) {
+                std::string perr;
+                if (t.type == TransferTask::Type::RemoteCopy) {
+                    ok = openscp::streamRemoteFile(
+                        *workerClient, t.src.toStdString(), *peerClient,
+                        t.dst.toStdString(), perr, progress, shouldCancel,
+                        resume);
+                    const bool peerInterrupted =
+                        unregisterExtraWorkerClient(taskId, peerClient.get());
+                    returnPeerClient(t.peer, std::move(peerClient),
+                                     ok && !peerInterrupted);
+                } else if (t.batch) {
+                    ok = transferArchiveBatch(t, workerClient.get(), progress,
+                                              shouldCancel, perr);
+                    if (t.type == TransferTask::Type::Upload)
+                        precheck_->invalidate(t.dst.toStdString());
+                } else {
+                    if (delta) {
+                        ok = workerClient->putDelta(t.src.toStdString(),
+                                                    t.dst.toStdString(), perr,
+                                                    progress, shouldCancel);
+                        if (!ok && !shouldCancel()) {
+                            qCInfo(ocXfer) << "Delta upload unavailable, "
+                                              "sending the whole file:"
+                                           << QString::fromStdString(perr);
+                            perr.clear();
                         }
-                    };
-
-                    const qint64 transferStartedMs =
-                        QDateTime::currentMSecsSinceEpoch();
-                    bool ok = false;
-                    if (t.type == TransferTask::Type::Upload) {
-                        std::string perr;
+                    }
+                    // Each call gets its own copy of `progress`, so the
+                    // fallback re-upload is metered and throttled from zero
+                    // rather than from where the delta attempt stopped.
+                    if (!delta || (!ok && !shouldCancel()))
                         ok = workerClient->put(t.src.toStdString(),
-                                               t.dst.toStdString(), perr, progress,
-                                               shouldCancel, resume);
-                        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
-                        if (!ok && shouldCancel()) {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            int i = indexForId(taskId);
-                            if (i >= 0) {
-                                // Avoid re-locking mtx_ via isCanceled() while
-                                // already holding this mutex (self-deadlock).
-                                const bool canceled =
-                                    canceledTasks_.count(taskId) > 0;
-                                tasks_[i].status = canceled
-                                                       ? TransferTask::Status::Canceled
-                                                       : TransferTask::Status::Paused;
-                                tasks_[i].currentSpeedKBps = 0.0;
-                                tasks_[i].etaSeconds = -1;
-                                tasks_[i].finishedAtMs = canceled ? nowMs : 0;
-                            }
-                        } else if (!ok) {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            int i = indexForId(taskId);
-                            if (i >= 0) {
-                                tasks_[i].status = TransferTask::Status::Error;
-                                tasks_[i].error = transferErrorForUi(perr);
-                                tasks_[i].currentSpeedKBps = 0.0;
-                                tasks_[i].etaSeconds = -1;
-                                tasks_[i].finishedAtMs = nowMs;
-                            }
-                        } else {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            int i = indexForId(taskId);
-                            if (i >= 0) {
-                                tasks_[i].progress = 100;
-                                if (tasks_[i].bytesTotal > 0)
-                                    tasks_[i].bytesDone = tasks_[i].bytesTotal;
-                                tasks_[i].status = TransferTask::Status::Done;
-                                tasks_[i].currentSpeedKBps = 0.0;
-                                tasks_[i].etaSeconds = 0;
-                                tasks_[i].finishedAtMs = nowMs;
-                            }
-                        }
+                                               t.dst.toStdString(), perr,
+                                               progress, shouldCancel, resume);
+                    // Keep sibling prechecks right; a failed upload may have
+                    // left a partial file behind.
+                    if (ok) {
+                        precheck_->noteFile(
+                            t.dst.toStdString(),
+                            static_cast<std::uint64_t>(
+                                QFileInfo(t.src).size()),
+                            static_cast<std::uint64_t>(
+                                QDateTime::currentSecsSinceEpoch()));
                     } else {
-                        std::string gerr;
-                        ok = workerClient->get(t.src.toStdString(),
-                                               t.dst.toStdString(), gerr, progress,
-                                               shouldCancel, resume);
-                        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
-                        if (!ok && shouldCancel()) {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            int i = indexForId(taskId);
-                            if (i >= 0) {
-                                // Avoid re-locking mtx_ via isCanceled() while
-                                // already holding this mutex (self-deadlock).
-                                const bool canceled =
-                                    canceledTasks_.count(taskId) > 0;
-                                tasks_[i].status = canceled
-                                                       ? TransferTask::Status::Canceled
-                                                       : TransferTask::Status::Paused;
-                                tasks_[i].currentSpeedKBps = 0.0;
-                                tasks_[i].etaSeconds = -1;
-                                tasks_[i].finishedAtMs = canceled ? nowMs : 0;
-                            }
-                        } else if (!ok) {
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            int i = indexForId(taskId);
-                            if (i >= 0) {
-                                tasks_[i].status = TransferTask::Status::Error;
-                                tasks_[i].error = transferErrorForUi(gerr);
-                                tasks_[i].currentSpeedKBps = 0.0;
-                                tasks_[i].etaSeconds = -1;
-                                tasks_[i].finishedAtMs = nowMs;
-                            }
-                        } else {
-                            openscp::FileInfo rinfo{};
-                            std::string stErr;
-                            (void)workerClient->stat(t.src.toStdString(), rinfo,
-                                                     stErr);
-                            if (rinfo.mtime > 0) {
-                                QFile f(t.dst);
-                                if (f.exists()) {
-                                    const QDateTime tsUtc =
-                                        QDateTime::fromSecsSinceEpoch(
-                                            (qint64)rinfo.mtime,
-                                            QTimeZone::utc());
-                                    if (!f.setFileTime(
-                                            tsUtc,
-                                            QFileDevice::FileModificationTime)) {
-                                        if (openscp::sensitiveLoggingEnabled()) {
-                                            qWarning(ocXfer)
-                                                << "Failed to set mtime for"
-                                                << t.dst << "to" << tsUtc;
-                                        } else {
-                                            qWarning(ocXfer)
-                                                << "Failed to set local file "
-                                                   "mtime";
-                                        }
-                                    }
+                        precheck_->invalidate(t.dst.toStdString());
+                    }
+                }
+                foldLiveProgress();
+                const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+                if (!ok && shouldCancel()) {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    int i = indexForId(taskId);
+                    if (i >= 0) {
+                        // Avoid re-locking mtx_ via isCanceled() while
+                        // already holding this mutex (self-deadlock).
+                        const bool canceled =
+                            canceledTasks_.count(taskId) > 0;
+                        setStatusLocked(tasks_[i],
+                                        canceled
+                                            ? TransferTask::Status::Canceled
+                                            : TransferTask::Status::Paused);
+                        tasks_[i].currentSpeedKBps = 0.0;
+                        tasks_[i].etaSeconds = -1;
+                        tasks_[i].finishedAtMs = canceled ? nowMs : 0;
+                    }
+                } else if (!ok) {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    int i = indexForId(taskId);
+                    if (i >= 0) {
+                        setStatusLocked(tasks_[i], TransferTask::Status::Error);
+                        setErrorLocked(tasks_[i], transferErrorForUi(perr));
+                        lastRawError = perr;
+                        tasks_[i].currentSpeedKBps = 0.0;
+                        tasks_[i].etaSeconds = -1;
+                        tasks_[i].finishedAtMs = nowMs;
+                    }
+                } else {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    int i = indexForId(taskId);
+                    if (i >= 0) {
+                        tasks_[i].progress = 100;
+                        if (tasks_[i].bytesTotal > 0)
+                            tasks_[i].bytesDone = tasks_[i].bytesTotal;
+                        setStatusLocked(tasks_[i], TransferTask::Status::Done);
+                        tasks_[i].currentSpeedKBps = 0.0;
+                        tasks_[i].etaSeconds = 0;
+                        tasks_[i].finishedAtMs = nowMs;
+                    }
+                }
+            } else {
+                // The remote size decides between one stream and segments;
+                // the same stat later supplies the mtime to restore.
+                openscp::FileInfo rinfo{};
+                bool haveRemoteInfo = false;
+                bool integrityRequired = false;
+                {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    integrityRequired =
+                        sessionOpt_.has_value() &&
+                        sessionOpt_->transfer_integrity_policy ==
+                            openscp::TransferIntegrityPolicy::Required;
+                }
+                if (workerCaps.supports_ranged_get && !integrityRequired) {
+                    std::string stErr;
+                    haveRemoteInfo = workerClient->stat(t.src.toStdString(),
+                                                        rinfo, stErr);
+                }
+                const bool segmented = haveRemoteInfo && !rinfo.is_dir &&
+                                       rinfo.has_size &&
+                                       rinfo.size >= kSegmentedDownloadMinBytes;
+                const std::string localDst = t.dst.toStdString();
+                if (!segmented &&
+                    QFileInfo::exists(QString::fromStdString(
+                        openscp::segmentedStatePath(localDst)))) {
+                    // A sparse .part left by a segmented attempt is not a
+                    // prefix a streaming resume could continue from.
+                    QFile::remove(QString::fromStdString(
+                        openscp::segmentedStatePath(localDst)));
+                    QFile::remove(QString::fromStdString(
+                        openscp::segmentedPartPath(localDst)));
+                    resume = false;
+                }
+                std::string gerr;
+                if (segmented) {
+                    ok = downloadInSegments(taskId, t, workerClient.get(),
+                                            rinfo, resume, progress,
+                                            shouldCancel, gerr);
+                } else {
+                    ok = workerClient->get(t.src.toStdString(), localDst,
+                                           gerr, progress, shouldCancel,
+                                           resume);
+                }
+                foldLiveProgress();
+                const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+                if (!ok && shouldCancel()) {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    int i = indexForId(taskId);
+                    if (i >= 0) {
+                        // Avoid re-locking mtx_ via isCanceled() while
+                        // already holding this mutex (self-deadlock).
+                        const bool canceled =
+                            canceledTasks_.count(taskId) > 0;
+                        setStatusLocked(tasks_[i],
+                                        canceled
+                                            ? TransferTask::Status::Canceled
+                                            : TransferTask::Status::Paused);
+                        tasks_[i].currentSpeedKBps = 0.0;
+                        tasks_[i].etaSeconds = -1;
+                        tasks_[i].finishedAtMs = canceled ? nowMs : 0;
+                    }
+                } else if (!ok) {
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    int i = indexForId(taskId);
+                    if (i >= 0) {
+                        setStatusLocked(tasks_[i], TransferTask::Status::Error);
+                        setErrorLocked(tasks_[i], transferErrorForUi(gerr));
+                        lastRawError = gerr;
+                        tasks_[i].currentSpeedKBps = 0.0;
+                        tasks_[i].etaSeconds = -1;
+                        tasks_[i].finishedAtMs = nowMs;
+                    }
+                } else {
+                    if (!haveRemoteInfo) {
+                        std::string stErr;
+                        (void)workerClient->stat(t.src.toStdString(), rinfo,
+                                                 stErr);
+                    }
+                    if (rinfo.mtime > 0) {
+                        QFile f(t.dst);
+                        if (f.exists()) {
+                            const QDateTime tsUtc =
+                                QDateTime::fromSecsSinceEpoch(
+                                    (qint64)rinfo.mtime,
+                                    QTimeZone::utc());
+                            if (!f.setFileTime(
+                                    tsUtc,
+                                    QFileDevice::FileModificationTime)) {
+                                if (openscp::sensitiveLoggingEnabled()) {
+                                    qWarning(ocXfer)
+                                        << "Failed to set mtime for"
+                                        << t.dst << "to" << tsUtc;
+                                } else {
+                                    qWarning(ocXfer)
+                                        << "Failed to set local file "
+                                           "mtime";
                                 }
                             }
-                            std::lock_guard<std::mutex> lk(mtx_);
-                            int i = indexForId(taskId);
-                            if (i >= 0) {
-                                tasks_[i].progress = 100;
-                                if (tasks_[i].bytesTotal > 0)
-                                    tasks_[i].bytesDone = tasks_[i].bytesTotal;
-                                tasks_[i].status = TransferTask::Status::Done;
-                                tasks_[i].currentSpeedKBps = 0.0;
-                                tasks_[i].etaSeconds = 0;
-                                tasks_[i].finishedAtMs = nowMs;
-                            }
                         }
                     }
+                    std::lock_guard<std::mutex> lk(mtx_);
+                    int i = indexForId(taskId);
+                    if (i >= 0) {
+                        tasks_[i].progress = 100;
+                        if (tasks_[i].bytesTotal > 0)
+                            tasks_[i].bytesDone = tasks_[i].bytesTotal;
+                        setStatusLocked(tasks_[i], TransferTask::Status::Done);
+                        tasks_[i].currentSpeedKBps = 0.0;
+                        tasks_[i].etaSeconds = 0;
+                        tasks_[i].finishedAtMs = nowMs;
+                    }
+                }
+            }
 
-                    workerClient->disconnect();
-                    {
-                        std::lock_guard<std::mutex> lk(mtx_);
-                        auto itResume = resumeRequestedTasks_.find(taskId);
-                        if (itResume != resumeRequestedTasks_.end()) {
-                            int i = indexForId(taskId);
-                            if (i >= 0 &&
-                                tasks_[i].status == TransferTask::Status::Paused) {
-                                const qint64 nowMs =
-                                    QDateTime::currentMSecsSinceEpoch();
-                                tasks_[i].status = TransferTask::Status::Queued;
-                                tasks_[i].resumeHint = true;
-                                tasks_[i].queuedAtMs = nowMs;
-                                tasks_[i].startedAtMs = 0;
-                                tasks_[i].finishedAtMs = 0;
-                                pausedTasks_.erase(taskId);
-                            }
-                            resumeRequestedTasks_.erase(itResume);
-                            qCInfo(ocXfer)
-                                << "Deferred resume armed after worker unwind"
-                                << "taskId=" << taskId;
-                        }
+            transferSpan.setArg("bytes", live->bytesDone.load());
+            transferSpan.end();
+            recordTransferPhases(metrics_, backend, *marks, integrityChecked);
+            releaseWorker(ok);
+            {
+                std::lock_guard<std::mutex> lk(mtx_);
+                auto itResume = resumeRequestedTasks_.find(taskId);
+                if (itResume != resumeRequestedTasks_.end()) {
+                    int i = indexForId(taskId);
+                    if (i >= 0 &&
+                        tasks_[i].status == TransferTask::Status::Paused) {
+                        const qint64 nowMs =
+                            QDateTime::currentMSecsSinceEpoch();
+                        setStatusLocked(tasks_[i],
+                                        TransferTask::Status::Queued);
+                        tasks_[i].resumeHint = true;
+                        tasks_[i].queuedAtMs = nowMs;
+                        tasks_[i].startedAtMs = 0;
+                        tasks_[i].finishedAtMs = 0;
+                        pushReadyLocked(tasks_[i]);
+                        journalStateLocked(tasks_[i]);
+                        pausedTasks_.erase(taskId);
                     }
-                    emitAndFinalize(precheckDoneMs - precheckStartedMs,
-                                    transferStartedMs);
-                });
+                    resumeRequestedTasks_.erase(itResume);
+                    qCInfo(ocXfer)
+                        << "Deferred resume armed after worker unwind"
+                        << "taskId=" << taskId;
+                }
             }
+            emitAndFinalize(precheckDoneMs - precheckStartedMs,
+                            transferStartedMs);
+        });
+    }
+}
+
+bool TransferManager::transferArchiveBatch(
+    const TransferTask &t, openscp::SftpClient *client,
+    const std::function<void(std::size_t, std::size_t)> &progress,
+    const std::function<bool()> &shouldCancel, std::string &err) {
+    const TransferBatch &batch = *t.batch;
+    const std::size_t total = static_cast<std::size_t>(batch.totalBytes);
+    std::size_t done = 0;
+    progress(0, total);
+    auto onFile = [&](const std::string &, std::uint64_t size) {
+        done += static_cast<std::size_t>(size);
+        progress(done, std::max(total, done));
+    };
+    if (t.type == TransferTask::Type::Upload) {
+        return client->putBatch(t.src.toStdString(), batch.files,
+                                t.dst.toStdString(), err, onFile,
+                                shouldCancel);
+    }
+    return client->getBatch(t.src.toStdString(), batch.files,
+                            t.dst.toStdString(), err, onFile, shouldCancel);
+}
+
+bool TransferManager::downloadInSegments(
+    quint64 taskId, const TransferTask &t, openscp::SftpClient *primary,
+    const openscp::FileInfo &remoteInfo, bool resume,
+    const std::function<void(std::size_t, std::size_t)> &progress,
+    const std::function<bool()> &shouldCancel, std::string &err) {
+    // Extra sessions come from the worker pool like any task's would; the
+    // download proceeds on however many could be leased.
+    std::vector<std::shared_ptr<openscp::SftpClient>> extra;
+    std::vector<quint64> generations;
+    std::vector<openscp::SftpClient *> clients{primary};
+    for (int i = 1; i < kSegmentedDownloadSessions; ++i) {
+        quint64 generation = 0;
+        std::string leaseErr;
+        std::shared_ptr<openscp::SftpClient> c =
+            leaseWorkerClient(taskId, generation, leaseErr);
+        if (!c || !c->capabilities().supports_ranged_get) {
+            if (c)
+                c->disconnect();
+            break;
         }
-        if (deferredRelaunch) {
-            emit tasksChanged();
-            qCInfo(ocXfer) << "schedule deferred relaunch; worker still active"
-                           << "taskId=" << taskId;
-            decrementRunningCounter();
-            continue;
+        registerExtraWorkerClient(taskId, c);
+        clients.push_back(c.get());
+        extra.push_back(std::move(c));
+        generations.push_back(generation);
+    }
+
+    openscp::SegmentedDownloadJob job;
+    job.remote = t.src.toStdString();
+    job.local = t.dst.toStdString();
+    job.size = remoteInfo.size;
+    job.mtime = remoteInfo.mtime;
+    job.resume = resume;
+    job.progress = progress;
+    job.shouldCancel = shouldCancel;
+    const bool ok = openscp::runSegmentedDownload(clients, job, err);
+    qCInfo(ocXfer) << "segmented download finished"
+                   << "taskId=" << taskId << "sessions=" << clients.size()
+                   << "ok=" << ok;
+    for (std::size_t i = 0; i < extra.size(); ++i) {
+        const bool interrupted =
+            unregisterExtraWorkerClient(taskId, extra[i].get());
+        // Task id 0 is never assigned, so returning the extra sessions does
+        // not consume the interrupt marker of the task's own session.
+        returnWorkerClient(0, std::move(extra[i]), generations[i],
+                           ok && !interrupted);
+    }
+    return ok;
+}
+
+void TransferManager::registerExtraWorkerClient(
+    quint64 taskId, const std::shared_ptr<openscp::SftpClient> &client) {
+    bool interruptNow = false;
+    {
+        std::lock_guard<std::mutex> lk(activeWorkersMutex_);
+        extraWorkerClients_.emplace(taskId, client);
+        interruptNow = interruptedWorkerTasks_.count(taskId) > 0;
+    }
+    if (interruptNow)
+        client->interrupt();
+}
+
+bool TransferManager::unregisterExtraWorkerClient(
+    quint64 taskId, const openscp::SftpClient *client) {
+    std::lock_guard<std::mutex> lk(activeWorkersMutex_);
+    auto [begin, end] = extraWorkerClients_.equal_range(taskId);
+    for (auto it = begin; it != end; ++it) {
+        if (it->second.lock().get() == client) {
+            extraWorkerClients_.erase(it);
+            break;
         }
     }
+    return interruptedWorkerTasks_.count(taskId) > 0;
 }
 
 int TransferManager::indexForId(quint64 id) const {
+    auto it = indexById_.find(id);
+    if (it == indexById_.end())
+        return -1;
+    const int i = it->second;
+    return (i >= 0 && i < tasks_.size() && tasks_[i].id == id) ? i : -1;
+}
+
+void TransferManager::rebuildIndexLocked() {
+    indexById_.clear();
+    indexById_.reserve(tasks_.size());
     for (int i = 0; i < tasks_.size(); ++i)
-        if (tasks_[i].id == id)
-            return i;
-    return -1;
+        indexById_[tasks_[i].id] = i;
+}
+
+TransferTask TransferManager::expandLocked(const QueuedTask &q) const {
+    TransferTask t{q.type};
+    t.id = q.id;
+    t.src = pathLocked(q.src);
+    t.dst = pathLocked(q.dst);
+    t.resumeHint = q.resumeHint;
+    t.speedLimitKBps = q.speedLimitKBps;
+    t.progress = q.progress;
+    t.bytesDone = q.bytesDone;
+    t.bytesTotal = q.bytesTotal;
+    t.currentSpeedKBps = q.currentSpeedKBps;
+    t.etaSeconds = q.etaSeconds;
+    t.attempts = q.attempts;
+    t.maxAttempts = q.maxAttempts;
+    t.queuedAtMs = q.queuedAtMs;
+    t.startedAtMs = q.startedAtMs;
+    t.status = q.status;
+    if (q.hasError) {
+        auto it = taskErrors_.find(q.id);
+        if (it != taskErrors_.end())
+            t.error = it->second;
+    }
+    t.finishedAtMs = q.finishedAtMs;
+    t.batch = q.batch;
+    t.replaceExisting = q.replaceExisting;
+    t.priority = q.priority;
+    t.sizeHint = q.sizeHint;
+    t.sessionKey = sessionKeyLocked(q);
+    t.journaled = q.journaled;
+    if (q.type == TransferTask::Type::RemoteCopy) {
+        auto it = peers_.find(q.id);
+        if (it != peers_.end())
+            t.peer = it->second;
+    }
+    return t;
+}
+
+QString TransferManager::pathLocked(const openscp::PathPool::Ref &r) const {
+    return QString::fromStdString(paths_.str(r));
+}
+
+QString TransferManager::sessionKeyLocked(const QueuedTask &q) const {
+    return q.session ? sessionKeys_[q.session - 1] : QString();
+}
+
+quint16 TransferManager::internSessionKeyLocked(const QString &key) {
+    if (key.isEmpty())
+        return 0;
+    // A handful of sessions per run; a linear scan is enough.
+    const int i = sessionKeys_.indexOf(key);
+    if (i >= 0)
+        return static_cast<quint16>(i + 1);
+    sessionKeys_.push_back(key);
+    return static_cast<quint16>(sessionKeys_.size());
+}
+
+void TransferManager::setErrorLocked(QueuedTask &q, const QString &error) {
+    if (error.isEmpty()) {
+        if (q.hasError)
+            taskErrors_.erase(q.id);
+        q.hasError = false;
+        return;
+    }
+    taskErrors_[q.id] = error;
+    q.hasError = true;
+}
+
+void TransferManager::appendTaskLocked(const TransferTask &t) {
+    const int row = static_cast<int>(tasks_.size());
+    QueuedTask q;
+    q.id = t.id;
+    q.bytesDone = t.bytesDone;
+    q.bytesTotal = t.bytesTotal;
+    q.sizeHint = t.sizeHint;
+    q.queuedAtMs = t.queuedAtMs;
+    q.startedAtMs = t.startedAtMs;
+    q.finishedAtMs = t.finishedAtMs;
+    q.currentSpeedKBps = t.currentSpeedKBps;
+    q.batch = t.batch;
+    q.src = paths_.intern(t.src.toStdString());
+    q.dst = paths_.intern(t.dst.toStdString());
+    q.speedLimitKBps = t.speedLimitKBps;
+    q.etaSeconds = t.etaSeconds;
+    q.priority = t.priority;
+    q.attempts = static_cast<quint16>(t.attempts);
+    q.maxAttempts = static_cast<quint16>(t.maxAttempts);
+    q.session = internSessionKeyLocked(t.sessionKey);
+    q.progress = static_cast<quint8>(t.progress);
+    q.type = t.type;
+    q.status = t.status;
+    q.resumeHint = t.resumeHint;
+    q.replaceExisting = t.replaceExisting;
+    q.journaled = t.journaled;
+    setErrorLocked(q, t.error);
+    if (t.peer)
+        peers_[q.id] = t.peer;
+    ++statusCounts_[static_cast<int>(q.status)];
+    indexById_[q.id] = row;
+    tasks_.push_back(std::move(q));
+    changeLog_.appended(row);
+}
+
+int TransferManager::removeTasksLocked(
+    const std::function<bool(const QueuedTask &)> &drop) {
+    // Find the removed runs first and log them last row first, so every
+    // record's rows are still valid once the ones before it are applied.
+    std::vector<std::pair<int, int>> runs; // first row, count
+    QVector<QueuedTask> next;
+    next.reserve(tasks_.size());
+    for (int i = 0; i < tasks_.size(); ++i) {
+        const QueuedTask &t = tasks_[i];
+        if (!drop(t)) {
+            next.push_back(t);
+            continue;
+        }
+        --statusCounts_[static_cast<int>(t.status)];
+        canceledTasks_.erase(t.id);
+        pausedTasks_.erase(t.id);
+        if (t.hasError)
+            taskErrors_.erase(t.id);
+        if (t.type == TransferTask::Type::RemoteCopy)
+            peers_.erase(t.id);
+        paths_.release(t.src);
+        paths_.release(t.dst);
+        if (!runs.empty() && runs.back().first + runs.back().second == i)
+            ++runs.back().second;
+        else
+            runs.emplace_back(i, 1);
+    }
+    if (runs.empty())
+        return 0;
+    tasks_.swap(next);
+    rebuildIndexLocked();
+    if (tasks_.isEmpty())
+        paths_.clear();
+    else if (paths_.needsCompaction())
+        compactPathsLocked();
+    int removed = 0;
+    for (auto it = runs.rbegin(); it != runs.rend(); ++it) {
+        changeLog_.removed(it->first, it->second);
+        removed += it->second;
+    }
+    return removed;
+}
+
+void TransferManager::compactPathsLocked() {
+    openscp::PathPool fresh;
+    for (QueuedTask &t : tasks_) {
+        t.src = fresh.intern(paths_.str(t.src));
+        t.dst = fresh.intern(paths_.str(t.dst));
+    }
+    paths_ = std::move(fresh);
+}
+
+void TransferManager::setStatusLocked(QueuedTask &t,
+                                      TransferTask::Status status) {
+    if (t.status != status) {
+        --statusCounts_[static_cast<int>(t.status)];
+        ++statusCounts_[static_cast<int>(status)];
+        t.status = status;
+    }
+    noteTaskUpdatedLocked(t.id);
+}
+
+void TransferManager::noteTaskUpdatedLocked(quint64 id) {
+    changeLog_.updated(id);
 }
 
 void TransferManager::decrementRunningCounter() {
@@ -1422,9 +2936,16 @@ void TransferManager::interruptActiveWorker(quint64 id) {
                    << "active=" << active
                    << "activeCount=" << activeWorkerTaskIds_.size()
                    << "clientsCount=" << activeWorkerClients_.size();
+    interruptedWorkerTasks_.insert(id);
     auto it = activeWorkerClients_.find(id);
     if (it != activeWorkerClients_.end())
         clientToInterrupt = it->second.lock();
+    std::vector<std::shared_ptr<openscp::SftpClient>> extras;
+    auto [extraBegin, extraEnd] = extraWorkerClients_.equal_range(id);
+    for (auto e = extraBegin; e != extraEnd; ++e) {
+        if (auto c = e->second.lock())
+            extras.push_back(std::move(c));
+    }
     if (!active || !clientToInterrupt) {
         pendingInterruptTasks_.insert(id);
         deferred = true;
@@ -1438,6 +2959,8 @@ void TransferManager::interruptActiveWorker(quint64 id) {
     } else if (deferred) {
         qCInfo(ocXfer) << "interruptActiveWorker deferred" << "taskId=" << id;
     }
+    for (const auto &extra : extras)
+        extra->interrupt();
 }
 
 void TransferManager::interruptActiveWorkers() {
@@ -1465,10 +2988,16 @@ void TransferManager::interruptActiveWorkers() {
     immediate.reserve(activeWorkerTaskIds_.size());
     deferred.reserve(activeWorkerTaskIds_.size());
     for (quint64 taskId : activeWorkerTaskIds_) {
+        interruptedWorkerTasks_.insert(taskId);
         std::shared_ptr<openscp::SftpClient> client;
         auto it = activeWorkerClients_.find(taskId);
         if (it != activeWorkerClients_.end())
             client = it->second.lock();
+        auto [extraBegin, extraEnd] = extraWorkerClients_.equal_range(taskId);
+        for (auto e = extraBegin; e != extraEnd; ++e) {
+            if (auto c = e->second.lock())
+                immediate.emplace_back(taskId, std::move(c));
+        }
         if (client) {
             immediate.emplace_back(taskId, std::move(client));
         } else {
@@ -1501,14 +3030,17 @@ void TransferManager::pauseTask(quint64 id) {
         int i = indexForId(id);
         if (i >= 0) {
             previousStatus = tasks_[i].status;
-            if (tasks_[i].status == TransferTask::Status::Queued ||
-                tasks_[i].status == TransferTask::Status::Running) {
+            if (tasks_[i].type != TransferTask::Type::LocalCopy &&
+                (tasks_[i].status == TransferTask::Status::Queued ||
+                 tasks_[i].status == TransferTask::Status::Running)) {
                 resumeRequestedTasks_.erase(id);
                 pausedTasks_.insert(id);
-                tasks_[i].status = TransferTask::Status::Paused;
+                stopEpoch_.fetch_add(1);
+                setStatusLocked(tasks_[i], TransferTask::Status::Paused);
                 tasks_[i].currentSpeedKBps = 0.0;
                 tasks_[i].etaSeconds = -1;
                 tasks_[i].finishedAtMs = 0;
+                journalStateLocked(tasks_[i]);
                 changed = true;
                 shouldInterrupt =
                     (previousStatus == TransferTask::Status::Running);
@@ -1541,11 +3073,13 @@ void TransferManager::resumeTask(quint64 id) {
             } else {
                 const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
                 pausedTasks_.erase(id);
-                tasks_[i].status = TransferTask::Status::Queued;
+                setStatusLocked(tasks_[i], TransferTask::Status::Queued);
                 tasks_[i].resumeHint = true;
                 tasks_[i].queuedAtMs = nowMs;
                 tasks_[i].startedAtMs = 0;
                 tasks_[i].finishedAtMs = 0;
+                pushReadyLocked(tasks_[i]);
+                journalStateLocked(tasks_[i]);
                 resumeRequestedTasks_.erase(id);
                 changed = true;
                 queueNow = true;
@@ -1571,10 +3105,53 @@ void TransferManager::setTaskSpeedLimit(quint64 id, int kbps) {
         int i = indexForId(id);
         if (i >= 0)
             tasks_[i].speedLimitKBps = kbps;
+        auto it = liveProgress_.find(id);
+        if (it != liveProgress_.end())
+            it->second->speedLimitKBps.store(kbps);
+    }
+    emit tasksChanged();
+}
+
+void TransferManager::setTaskPriority(quint64 id,
+                                      openscp::TransferPriority priority) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        int i = indexForId(id);
+        if (i < 0 || tasks_[i].priority == priority)
+            return;
+        tasks_[i].priority = priority;
+        if (tasks_[i].status == TransferTask::Status::Queued)
+            pushReadyLocked(tasks_[i]);
+        journalStateLocked(tasks_[i]);
     }
     emit tasksChanged();
 }
 
+void TransferManager::setSchedulingPolicy(openscp::SchedulingPolicy policy) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (readyQueue_.policy() == policy)
+            return;
+        readyQueue_.setPolicy(policy);
+    }
+    qCInfo(ocXfer) << "scheduling policy"
+                   << openscp::schedulingPolicyName(policy);
+    schedule();
+}
+
+openscp::SchedulingPolicy TransferManager::schedulingPolicy() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return readyQueue_.policy();
+}
+
+void TransferManager::setSmallFileThreshold(quint64 bytes) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        readyQueue_.setSmallFileThreshold(bytes);
+    }
+    schedule();
+}
+
 void TransferManager::cancelTask(quint64 id) {
     const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
     const bool activeWorker = isWorkerActive(id);
@@ -1593,13 +3170,17 @@ void TransferManager::cancelTask(quint64 id) {
                 tasks_[i].status == TransferTask::Status::Paused) {
                 resumeRequestedTasks_.erase(id);
                 canceledTasks_.insert(id);
+                stopEpoch_.fetch_add(1);
                 pausedTasks_.erase(id);
-                tasks_[i].status = TransferTask::Status::Canceled;
+                setStatusLocked(tasks_[i], TransferTask::Status::Canceled);
                 tasks_[i].currentSpeedKBps = 0.0;
                 tasks_[i].etaSeconds = -1;
                 tasks_[i].finishedAtMs = nowMs;
+                journalStateLocked(tasks_[i]);
                 transitionedToCanceled = true;
+                // Local copies poll canceledTasks_ instead.
                 shouldInterrupt =
+                    tasks_[i].type != TransferTask::Type::LocalCopy &&
                     (previousStatus == TransferTask::Status::Running ||
                      previousStatus == TransferTask::Status::Paused);
             }
@@ -1,25 +1,51 @@
 // Transfer queue manager with concurrent worker execution.
 #pragma once
+#include "openscp/BandwidthScheduler.hpp"
+#include "openscp/ConcurrencyController.hpp"
+#include "openscp/LocalCopy.hpp"
+#include "openscp/PathPool.hpp"
+#include "openscp/PrecheckCache.hpp"
+#include "openscp/RowChangeLog.hpp"
 #include "openscp/SftpTypes.hpp"
+#include "openscp/TransferJournal.hpp"
+#include "openscp/TransferMetrics.hpp"
+#include "openscp/TransferReadyQueue.hpp"
 #include <QObject>
 #include <QString>
 #include <QVector>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
+
+class QTimer;
 
 namespace openscp {
 class SftpClient;
 }
 
+// Files moved together as one archive stream (SftpClient::putBatch/getBatch).
+struct TransferBatch {
+    std::vector<std::string> files; // relative to the roots, '/'-separated
+    quint64 totalBytes = 0;         // sum of the file sizes if known
+};
+
 // Transfer queue item.
 // Represents an upload or download operation with its state and options.
+// LocalCopy rows mirror a local copy/move run (see startLocalCopy); both of
+// their paths are local and they never go through the scheduler.
+// RemoteCopy rows stream a file from the session to another server (see
+// `peer`) without staging it locally.
 struct TransferTask {
-    enum class Type { Upload, Download } type;
+    enum class Type : quint8 { Upload, Download, LocalCopy, RemoteCopy } type;
     quint64 id = 0;                // stable identifier for cross-thread updates
     QString src;                   // local for uploads, remote for downloads
     QString dst;                   // remote for uploads, local for downloads
@@ -41,7 +67,7 @@ struct TransferTask {
     //  - Done: completed successfully
     //  - Error: finished with error
     //  - Canceled: canceled by the user
-    enum class Status {
+    enum class Status : quint8 {
         Queued,
         Running,
         Paused,
@@ -51,6 +77,43 @@ struct TransferTask {
     } status = Status::Queued;
     QString error;
     qint64 finishedAtMs = 0; // epoch ms when task entered final state
+    // Archive batch task: src/dst are the two roots of these files.
+    std::shared_ptr<const TransferBatch> batch;
+    // Replace an existing destination without the overwrite prompt.
+    bool replaceExisting = false;
+    // Scheduling class; higher classes start first.
+    openscp::TransferPriority priority = openscp::TransferPriority::Normal;
+    quint64 sizeHint = 0; // size used for scheduling, 0 = unknown
+    QString sessionKey;     // connection the task was queued on
+    bool journaled = false; // has a live record in the queue journal
+    // RemoteCopy: the server `dst` lives on. Never journaled (it carries
+    // credentials), so these tasks do not survive a restart.
+    std::shared_ptr<const openscp::SessionOptions> peer;
+};
+
+// Tasks per status (TransferManager::statusCounts()).
+struct TransferQueueCounts {
+    int total = 0;
+    int queued = 0;
+    int running = 0;
+    int paused = 0;
+    int done = 0;
+    int error = 0;
+    int canceled = 0;
+};
+
+// One change to the task list (TransferManager::changesSince()); an
+// Updated record's row is where the task is now.
+using TransferTaskChange = openscp::RowChange;
+
+// One single-file task for TransferManager::enqueueMany().
+struct TransferRequest {
+    TransferTask::Type type = TransferTask::Type::Upload; // or Download
+    QString src;
+    QString dst;
+    bool replaceExisting = false;
+    quint64 sizeHint = 0; // local size of an upload, 0 = unknown
+    std::shared_ptr<const openscp::SessionOptions> peer; // RemoteCopy only
 };
 
 class TransferManager : public QObject {
@@ -64,6 +127,19 @@ class TransferManager : public QObject {
     void clearClient();
     // Session options used to create independent worker connections.
     void setSessionOptions(const openscp::SessionOptions &opt);
+    // Destination precheck cache of the workers. Changes made outside the
+    // queue (panel rename, delete, mkdir, ...) must be reported to it.
+    std::shared_ptr<openscp::PrecheckCache> precheckCache() const {
+        return precheck_;
+    }
+    // Borrow an idle pooled session for a short side job (such as the
+    // writability probe) without blocking; null if none is idle.
+    // `generation` is set either way, so a session the caller opens itself
+    // can be donated through returnSession() too.
+    std::shared_ptr<openscp::SftpClient> takeIdleSession(quint64 &generation);
+    // Hand a healthy session back to the pool (it may still be dropped).
+    void returnSession(std::shared_ptr<openscp::SftpClient> client,
+                       quint64 generation);
     // Concurrency: maximum number of simultaneous tasks
     void setMaxConcurrent(int n) {
         if (n < 1)
@@ -71,9 +147,28 @@ class TransferManager : public QObject {
         maxConcurrent_ = n;
     }
     int maxConcurrent() const { return maxConcurrent_; }
-    // Global speed limit (KB/s). 0 = unlimited
-    void setGlobalSpeedLimitKBps(int kbps) { globalSpeedKBps_.store(kbps); }
+    // Let an AIMD controller (openscp::ConcurrencyController) move the
+    // limit between minWorkers and maxWorkers from observed throughput,
+    // task times and network errors. Idle pooled sessions follow it.
+    // Disabling keeps the current limit until setMaxConcurrent().
+    void setAdaptiveConcurrency(bool enabled, int minWorkers, int maxWorkers);
+    bool adaptiveConcurrency() const { return adaptive_ != nullptr; }
+    // Latest round trip of the session (SftpClient::ping); the adaptive
+    // controller reads it as a queueing-delay signal.
+    void noteRoundTrip(quint32 rttMs) { adaptiveRttMs_.store(rttMs); }
+    // Order in which queued tasks start (see openscp::TransferReadyQueue).
+    void setSchedulingPolicy(openscp::SchedulingPolicy policy);
+    openscp::SchedulingPolicy schedulingPolicy() const;
+    // Size up to which a task counts as small for SmallFilesLane.
+    void setSmallFileThreshold(quint64 bytes);
+    // Global speed limit (KB/s). 0 = unlimited. Shared by all workers;
+    // uploads and downloads each draw from their own budget of this size.
+    void setGlobalSpeedLimitKBps(int kbps);
     int globalSpeedLimitKBps() const { return globalSpeedKBps_.load(); }
+    // Direction-specific budget (KB/s) overriding the global limit; 0 = use
+    // the global limit.
+    void setDirectionSpeedLimitKBps(TransferTask::Type type, int kbps);
+    int directionSpeedLimitKBps(TransferTask::Type type) const;
     bool isQueuePaused() const { return paused_.load(); }
 
     // Pause/Resume per task
@@ -85,12 +180,64 @@ class TransferManager : public QObject {
     void cancelAll();
     // Adjust per-task speed limit (KB/s). 0 = unlimited
     void setTaskSpeedLimit(quint64 id, int kbps);
+    // Change the scheduling class of a task (takes effect while queued)
+    void setTaskPriority(quint64 id, openscp::TransferPriority priority);
 
-    void enqueueUpload(const QString &local, const QString &remote);
-    void enqueueDownload(const QString &remote, const QString &local);
+    // Enqueue functions return the new task's id. With replaceExisting an
+    // existing destination is overwritten without asking (folder sync).
+    quint64 enqueueUpload(const QString &local, const QString &remote,
+                          bool replaceExisting = false);
+    quint64 enqueueDownload(const QString &remote, const QString &local,
+                            bool replaceExisting = false);
+    // Queue a whole batch under one lock with a single tasksChanged(), so
+    // a scanner can feed the queue while earlier batches already run. The
+    // new ids are consecutive; returns the first one (0 if empty).
+    quint64 enqueueMany(const QVector<TransferRequest> &requests);
+    // Queue many small files below two roots as a single task that streams
+    // them as one tar archive. Callers check the session's
+    // capabilities().supports_batch_archive first. Existing files are
+    // replaced without the per-file overwrite prompt.
+    quint64 enqueueUploadBatch(const QString &localRoot,
+                               std::vector<std::string> files,
+                               const QString &remoteRoot, quint64 totalBytes);
+    quint64 enqueueDownloadBatch(const QString &remoteRoot,
+                                 std::vector<std::string> files,
+                                 const QString &localRoot,
+                                 quint64 totalBytes);
+    // Copy (or move) local entries on a background thread with
+    // openscp::runLocalCopy. The run shows up as one LocalCopy task with
+    // the aggregate progress; it can be canceled but not paused or retried.
+    // `done` runs on the manager's thread with one outcome per item.
+    using LocalCopyDone =
+        std::function<void(const std::vector<openscp::LocalCopyOutcome> &)>;
+    quint64 startLocalCopy(std::vector<openscp::LocalCopyItem> items,
+                           bool move, LocalCopyDone done);
+
+    // Per-phase latency histograms and byte/error counters of finished
+    // tasks. With OPENSCP_METRICS_EXPORT set they are also published
+    // periodically (see openscp::TransferMetrics::exportTo).
+    const openscp::TransferMetrics &metrics() const { return metrics_; }
 
     // Thread-safe copy of the current task list.
     QVector<TransferTask> tasksSnapshot() const;
+    // Thread-safe copy of only the given tasks (unknown ids are skipped).
+    QVector<TransferTask> tasksSnapshot(const QVector<quint64> &ids) const;
+    // Row `row` with its live progress, without copying the queue; false
+    // past the end. Rows move only on the manager's thread.
+    bool taskAt(int row, TransferTask &out) const;
+    // Current row of a task, -1 once it left the queue.
+    int rowOf(quint64 id) const;
+    // Number of tasks and the change version it reflects.
+    int taskCount(quint64 &version) const;
+    // Append the changes made after `version`, oldest first, and advance
+    // `version`. Updated records carry the task's row after all of them
+    // (-1 if it is gone). Returns false when the log no longer reaches back
+    // that far; the caller then starts over from taskCount(). Lets a view
+    // follow a queue of millions of tasks without copying it.
+    bool changesSince(quint64 &version,
+                      std::vector<TransferTaskChange> &out) const;
+    // Maintained as tasks change state, so this does not scan the queue.
+    TransferQueueCounts statusCounts() const;
 
     // Pause/Resume the whole queue
     void pauseAll();
@@ -105,6 +252,9 @@ class TransferManager : public QObject {
     signals:
     // Emitted when the task list/state changes (to refresh the UI)
     void tasksChanged();
+    // Emitted at a bounded rate with the ids whose progress counters moved
+    // since the previous emission; rows were neither added nor removed.
+    void tasksUpdated(const QVector<quint64> &ids);
 
     public slots:
     void processNext(); // process in order; one at a time
@@ -112,15 +262,77 @@ class TransferManager : public QObject {
 
     private:
     openscp::SftpClient *client_ = nullptr; // not owned by the manager
-    QVector<TransferTask> tasks_;
+    // A task as kept in tasks_. Queues run to hundreds of thousands of
+    // files, so paths are interned in paths_ (folders stored once), the
+    // session key is an index into sessionKeys_ and the error message sits
+    // in taskErrors_ only while there is one. Other fields keep
+    // TransferTask's names and meaning; expandLocked() rebuilds the full
+    // TransferTask for snapshots and workers.
+    struct QueuedTask {
+        quint64 id = 0;
+        quint64 bytesDone = 0;
+        quint64 bytesTotal = 0;
+        quint64 sizeHint = 0;
+        qint64 queuedAtMs = 0;
+        qint64 startedAtMs = 0;
+        qint64 finishedAtMs = 0;
+        double currentSpeedKBps = 0.0;
+        std::shared_ptr<const TransferBatch> batch;
+        openscp::PathPool::Ref src;
+        openscp::PathPool::Ref dst;
+        int speedLimitKBps = 0;
+        int etaSeconds = -1;
+        openscp::TransferPriority priority = openscp::TransferPriority::Normal;
+        quint16 attempts = 0;
+        quint16 maxAttempts = 3;
+        quint16 session = 0; // 1-based index into sessionKeys_; 0 = none
+        quint8 progress = 0;
+        TransferTask::Type type = TransferTask::Type::Upload;
+        TransferTask::Status status = TransferTask::Status::Queued;
+        bool resumeHint = false;
+        bool replaceExisting = false;
+        bool journaled = false;
+        bool hasError = false; // taskErrors_ holds its message
+    };
+    QVector<QueuedTask> tasks_;
+    // Side storage of tasks_ rows (guarded by mtx_, like tasks_).
+    openscp::PathPool paths_;
+    QVector<QString> sessionKeys_;
+    std::unordered_map<quint64, QString> taskErrors_; // id -> message
+    // RemoteCopy id -> destination server
+    std::unordered_map<quint64, std::shared_ptr<const openscp::SessionOptions>>
+        peers_;
     std::atomic<bool> paused_{false};
     std::atomic<int> running_{0};
-    int maxConcurrent_ = 2;
+    std::atomic<int> maxConcurrent_{2};
+    // Adaptive concurrency (controller and timer live on the UI thread)
+    std::unique_ptr<openscp::ConcurrencyController> adaptive_;
+    QTimer *adaptiveTimer_ = nullptr;
+    qint64 adaptiveLastTickMs_ = 0;
+    std::atomic<quint64> adaptiveBytes_{0}; // moved since the last tick
+    std::atomic<quint32> adaptiveRttMs_{0}; // measured since the last tick
+    // Finished tasks since the last tick (guarded by perfMtx_)
+    quint32 adaptiveCompleted_ = 0;
+    quint32 adaptiveFailed_ = 0;
+    qint64 adaptiveTaskMs_ = 0;
+    void adaptConcurrency();
+    void trimWorkerPool(int keep);
     std::atomic<int> globalSpeedKBps_{0};
+    std::atomic<int> uploadSpeedKBps_{0};
+    std::atomic<int> downloadSpeedKBps_{0};
+    // Paces every worker's chunks against the shared per-direction budgets.
+    openscp::BandwidthScheduler bandwidth_;
+    void applyBandwidthLimits();
 
-    // Worker threads per task
-    std::unordered_map<quint64, std::thread> workers_;
-    std::mutex workersMutex_; // protects workers_
+    // Fixed pool of job threads, sized to maxConcurrent_, that run each
+    // task's state machine pulled from jobQueue_.
+    std::vector<std::thread> jobThreads_;
+    std::deque<std::function<void()>> jobQueue_;
+    int pendingJobs_ = 0; // queued + running jobs
+    bool stopJobThreads_ = false;
+    std::mutex jobQueueMutex_; // protects the job pool fields above
+    std::condition_variable jobQueueCv_;
+    std::condition_variable jobsIdleCv_;
     // Auxiliary state: paused/canceled ids for worker cooperation
     std::unordered_set<quint64> pausedTasks_;
     std::unordered_set<quint64> canceledTasks_;
@@ -129,8 +341,60 @@ class TransferManager : public QObject {
         mtx_; // protects tasks_, client_, options and auxiliary sets
     std::mutex connFactoryMutex_; // serializes creation of worker SFTP clients
     quint64 nextId_ = 1;
+    // id -> position in tasks_ (guarded by mtx_; rebuilt when rows are removed)
+    std::unordered_map<quint64, int> indexById_;
+    // Bumped (under mtx_) whenever a task is added to pausedTasks_ or
+    // canceledTasks_, so workers can poll for stop requests without locking.
+    std::atomic<quint64> stopEpoch_{0};
+    // Hot progress counters of a running task. The worker updates them per
+    // chunk without taking mtx_; tasksSnapshot() overlays them onto tasks_.
+    struct LiveProgress {
+        std::atomic<int> progress{0};
+        std::atomic<quint64> bytesDone{0};
+        std::atomic<quint64> bytesTotal{0};
+        std::atomic<double> currentSpeedKBps{0.0};
+        std::atomic<int> etaSeconds{-1};
+        std::atomic<int> speedLimitKBps{0};
+    };
+    // Registered slots of running tasks (map guarded by mtx_)
+    std::unordered_map<quint64, std::shared_ptr<LiveProgress>> liveProgress_;
+    // Coalesced progress notifications: workers mark ids dirty per chunk and
+    // a single-shot timer on the manager's thread flushes them as one
+    // tasksUpdated() batch.
+    std::mutex dirtyMtx_; // protects dirtyTaskIds_
+    std::unordered_set<quint64> dirtyTaskIds_;
+    QTimer *progressFlushTimer_ = nullptr;
+    void markProgressDirty(quint64 id);
+    void flushDirtyProgress();
 
     int indexForId(quint64 id) const;
+    void rebuildIndexLocked();
+    // Copy a running task's lock-free progress counters into `t`.
+    void overlayLiveProgressLocked(TransferTask &t) const;
+    // Full task of a tasks_ row (without live progress).
+    TransferTask expandLocked(const QueuedTask &q) const;
+    QString pathLocked(const openscp::PathPool::Ref &r) const;
+    QString sessionKeyLocked(const QueuedTask &q) const;
+    quint16 internSessionKeyLocked(const QString &key);
+    // Set or, with an empty message, clear a row's error.
+    void setErrorLocked(QueuedTask &q, const QString &error);
+    // Every change to tasks_ rows goes through these (under mtx_), which
+    // keep statusCounts_ and changeLog_ current.
+    void appendTaskLocked(const TransferTask &t);
+    // Remove the tasks `drop` accepts; returns how many.
+    int removeTasksLocked(const std::function<bool(const QueuedTask &)> &drop);
+    // Re-intern the paths of the remaining rows into a fresh pool.
+    void compactPathsLocked();
+    void setStatusLocked(QueuedTask &t, TransferTask::Status status);
+    void noteTaskUpdatedLocked(quint64 id);
+    // Tasks per TransferTask::Status value (guarded by mtx_).
+    int statusCounts_[6] = {};
+    // Recent row changes for changesSince() (guarded by mtx_).
+    openscp::RowChangeLog changeLog_;
+    void enqueueJob(std::function<void()> job);
+    void jobThreadLoop();
+    // Block until every queued or running job has finished.
+    void waitForJobsIdle();
     void decrementRunningCounter();
     void interruptActiveWorker(quint64 id);
     void interruptActiveWorkers();
@@ -143,9 +407,71 @@ class TransferManager : public QObject {
         activeWorkerClients_;
     std::unordered_set<quint64> activeWorkerTaskIds_;
     std::unordered_set<quint64> pendingInterruptTasks_;
+    // Tasks whose session received interrupt(); never returned to the pool.
+    std::unordered_set<quint64> interruptedWorkerTasks_;
+    // Sessions a task leased besides its own (segmented download ranges,
+    // the destination of a remote copy); interrupted with the task's own.
+    std::unordered_multimap<quint64, std::weak_ptr<openscp::SftpClient>>
+        extraWorkerClients_;
     std::mutex activeWorkersMutex_;
+    // Track `client` as an extra session of `taskId`; it is interrupted
+    // at once if the task already was.
+    void registerExtraWorkerClient(
+        quint64 taskId, const std::shared_ptr<openscp::SftpClient> &client);
+    // Stop tracking `client`; true if its task was interrupted meanwhile.
+    bool unregisterExtraWorkerClient(quint64 taskId,
+                                     const openscp::SftpClient *client);
+    // Pool of idle authenticated worker sessions, reused across tasks so a
+    // queue of many small files does not pay a full handshake per file.
+    struct PooledWorkerClient {
+        std::shared_ptr<openscp::SftpClient> client;
+        qint64 idleSinceMs = 0;
+    };
+    std::vector<PooledWorkerClient> idleWorkerClients_;
+    quint64 workerPoolGeneration_ = 0; // bumped whenever the pool is drained
+    // Idle sessions to RemoteCopy destinations, keyed by the task's peer.
+    struct PooledPeerClient {
+        std::shared_ptr<const openscp::SessionOptions> peer;
+        std::shared_ptr<openscp::SftpClient> client;
+    };
+    std::vector<PooledPeerClient> idlePeerClients_;
+    std::mutex workerPoolMutex_; // protects the idle pools and generation
+    // Lease a pooled session (probing stale ones) or create a new one.
+    std::shared_ptr<openscp::SftpClient>
+    leaseWorkerClient(quint64 taskId, quint64 &generation, std::string &err);
+    // Return a leased session; it is kept only if healthy and reusable.
+    void returnWorkerClient(quint64 taskId,
+                            std::shared_ptr<openscp::SftpClient> client,
+                            quint64 generation, bool reusable);
+    void drainWorkerPool();
+    // Session to a RemoteCopy destination: an idle one to the same peer or
+    // a new connection.
+    std::shared_ptr<openscp::SftpClient>
+    leasePeerClient(const std::shared_ptr<const openscp::SessionOptions> &peer,
+                    std::string &err);
+    void returnPeerClient(std::shared_ptr<const openscp::SessionOptions> peer,
+                          std::shared_ptr<openscp::SftpClient> client,
+                          bool reusable);
+    // Download one large file as byte ranges over the task's session plus
+    // up to three extra pooled sessions (see openscp::runSegmentedDownload).
+    bool downloadInSegments(
+        quint64 taskId, const TransferTask &t, openscp::SftpClient *primary,
+        const openscp::FileInfo &remoteInfo, bool resume,
+        const std::function<void(std::size_t, std::size_t)> &progress,
+        const std::function<bool()> &shouldCancel, std::string &err);
+    // Run an archive batch task; progress advances file by file.
+    bool transferArchiveBatch(
+        const TransferTask &t, openscp::SftpClient *client,
+        const std::function<void(std::size_t, std::size_t)> &progress,
+        const std::function<bool()> &shouldCancel, std::string &err);
+    // Upload destination checks answered from one listing per remote
+    // folder; workers report the files and folders they create.
+    std::shared_ptr<openscp::PrecheckCache> precheck_ =
+        std::make_shared<openscp::PrecheckCache>();
     std::unordered_set<quint64> resumeRequestedTasks_;
-    int schedulingCursor_ = 0;
+    // Queued task ids in start order. Entries are dropped lazily: a task
+    // that left Queued is skipped when it comes up.
+    openscp::TransferReadyQueue readyQueue_;
     mutable std::mutex perfMtx_;
     quint64 perfCompletedTasks_ = 0;
     quint64 perfCompletedBytes_ = 0;
@@ -153,9 +479,45 @@ class TransferManager : public QObject {
     qint64 perfTotalPrecheckMs_ = 0;
     qint64 perfTotalTransferMs_ = 0;
     qint64 perfLastLogAtMs_ = 0;
+    openscp::TransferMetrics metrics_;
+    std::string metricsTarget_; // OPENSCP_METRICS_EXPORT; empty = off
+    openscp::MetricsFormat metricsFormat_ = openscp::MetricsFormat::Prometheus;
+
+    // Put a task that just became Queued on the ready queue.
+    void pushReadyLocked(const QueuedTask &t);
 
+    // Crash-safe log of unfinished tasks (guarded by mtx_). Tasks replayed
+    // at startup wait in journalRestore_ until their session is set.
+    // Cancellations by shutdown are not journaled, so those tasks come back
+    // as well; a disconnect cancels (and unjournals) like the user would.
+    // The file is locked while open: a second instance runs unjournaled.
+    openscp::TransferJournal journal_;
+    std::vector<openscp::JournalTask> journalRestore_;
+    bool journalSuspended_ = false;
+    QString sessionKey_; // of sessionOpt_; empty while disconnected
+    std::atomic<bool> journalFlushArmed_{false};
+    QTimer *journalFlushTimer_ = nullptr;
+    void openJournal();
+    // Record a new task, or the current status of a journaled one.
+    void journalPutLocked(QueuedTask &t);
+    void journalStateLocked(QueuedTask &t);
+    // Drop the record of a row being removed from the queue.
+    void journalForgetLocked(const QueuedTask &t);
+    openscp::JournalTask journalTaskLocked(const QueuedTask &t) const;
+    bool restoreJournaledTasksLocked();
+    void armJournalFlush();
+    void flushJournal();
     int nextQueuedTaskIndexLocked();
-    void recordCompletionMetrics(quint64 taskId, TransferTask::Status status,
+    // Local copy runs in flight (guarded by mtx_); the destructor waits.
+    int localCopiesInFlight_ = 0;
+    std::condition_variable localCopiesIdleCv_;
+    void updateLocalCopyProgress(quint64 id, quint64 done, quint64 total);
+    void finishLocalCopy(quint64 id,
+                         const std::vector<openscp::LocalCopyOutcome> &out);
+    void recordCompletionMetrics(quint64 taskId, const std::string &backend,
+                                 TransferTask::Type type,
+                                 TransferTask::Status status,
                                  quint64 bytesDone, qint64 queueLatencyMs,
-                                 qint64 precheckMs, qint64 transferMs);
+                                 qint64 precheckMs, qint64 transferMs,
+                                 const std::string &rawError);
 };
@@ -13,6 +13,7 @@
 #include <QFileInfo>
 #include <QGuiApplication>
 #include <QHBoxLayout>
+#include <QHash>
 #include <QHeaderView>
 #include <QInputDialog>
 #include <QLabel>
@@ -23,11 +24,15 @@
 #include <QSortFilterProxyModel>
 #include <QSpinBox>
 #include <QTableView>
+#include <QTimer>
 #include <QToolButton>
 #include <QUrl>
 #include <QVBoxLayout>
+#include <algorithm>
+#include <vector>
 
 static constexpr int kProgressColumnWidthPx = 84;
+static constexpr int kAutoClearCheckMs = 30 * 1000;
 
 static QString statusText(TransferTask::Status s) {
     switch (s) {
@@ -133,28 +138,23 @@ struct SelectedActionsState {
     bool canOpenDestination = false;
 };
 
+// `selected` holds the selected tasks (TransferManager::tasksSnapshot(ids)).
 static SelectedActionsState
-buildSelectedActionsState(const QVector<quint64> &ids,
-                          const QVector<TransferTask> &snapshot) {
+buildSelectedActionsState(const QVector<TransferTask> &selected) {
     SelectedActionsState out;
-    out.hasSelection = !ids.isEmpty();
-    if (!out.hasSelection)
-        return out;
-
-    for (quint64 id : ids) {
-        for (const auto &t : snapshot) {
-            if (t.id != id)
-                continue;
-            out.canPause = out.canPause || canPauseStatus(t.status);
-            out.canResume = out.canResume || canResumeStatus(t.status);
-            out.canLimit = out.canLimit || canLimitStatus(t.status);
-            out.canCancel = out.canCancel || canCancelStatus(t.status);
-            out.canRetry = out.canRetry || canRetryStatus(t.status);
-            out.canOpenDestination =
-                out.canOpenDestination ||
-                (t.type == TransferTask::Type::Download);
-            break;
-        }
+    out.hasSelection = !selected.isEmpty();
+    for (const auto &t : selected) {
+        out.canCancel = out.canCancel || canCancelStatus(t.status);
+        out.canOpenDestination = out.canOpenDestination ||
+                                 (t.type != TransferTask::Type::Upload &&
+                                  t.type != TransferTask::Type::RemoteCopy);
+        // Local copies run outside the scheduler: cancel only.
+        if (t.type == TransferTask::Type::LocalCopy)
+            continue;
+        out.canPause = out.canPause || canPauseStatus(t.status);
+        out.canResume = out.canResume || canResumeStatus(t.status);
+        out.canLimit = out.canLimit || canLimitStatus(t.status);
+        out.canRetry = out.canRetry || canRetryStatus(t.status);
     }
     return out;
 }
@@ -187,13 +187,18 @@ class TransferTaskTableModel final : public QAbstractTableModel {
         ColCount = 11
     };
 
-    explicit TransferTaskTableModel(QObject *parent = nullptr)
-        : QAbstractTableModel(parent) {}
+    // Rows are read from `mgr` on demand; the model only tracks their
+    // number, following the manager's change log (see sync()).
+    explicit TransferTaskTableModel(TransferManager *mgr,
+                                    QObject *parent = nullptr)
+        : QAbstractTableModel(parent), mgr_(mgr) {
+        rows_ = mgr_->taskCount(version_);
+    }
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override {
         if (parent.isValid())
             return 0;
-        return tasks_.size();
+        return rows_;
     }
 
     int columnCount(const QModelIndex &parent = QModelIndex()) const override {
@@ -240,9 +245,10 @@ class TransferTaskTableModel final : public QAbstractTableModel {
     QVariant data(const QModelIndex &index, int role) const override {
         if (!index.isValid())
             return {};
-        if (index.row() < 0 || index.row() >= tasks_.size())
+        const TransferTask *task = taskAt(index.row());
+        if (!task)
             return {};
-        const auto &t = tasks_[index.row()];
+        const auto &t = *task;
 
         if (role == StatusRole)
             return static_cast<int>(t.status);
@@ -299,6 +305,10 @@ class TransferTaskTableModel final : public QAbstractTableModel {
         case ColEta:
             return formatEta(t.etaSeconds);
         case ColType:
+            if (t.type == TransferTask::Type::LocalCopy)
+                return TransferQueueDialog::tr("Local copy");
+            if (t.type == TransferTask::Type::RemoteCopy)
+                return TransferQueueDialog::tr("Server copy");
             return t.type == TransferTask::Type::Upload
                        ? TransferQueueDialog::tr("Upload")
                        : TransferQueueDialog::tr("Download");
@@ -315,57 +325,113 @@ class TransferTaskTableModel final : public QAbstractTableModel {
         }
     }
 
-    void sync(const QVector<TransferTask> &incoming) {
-        if (tasks_.size() != incoming.size()) {
-            beginResetModel();
-            tasks_ = incoming;
-            endResetModel();
+    // Apply the manager's changes since the last call: rows are inserted
+    // and removed where the queue changed, and rows whose state changed
+    // are repainted. Cost follows the number of changes, not the queue.
+    void sync() {
+        std::vector<TransferTaskChange> changes;
+        if (!mgr_->changesSince(version_, changes) ||
+            !canApplyInPlace(changes)) {
+            reload();
             return;
         }
-
-        bool orderChanged = false;
-        for (int i = 0; i < tasks_.size(); ++i) {
-            if (tasks_[i].id != incoming[i].id) {
-                orderChanged = true;
+        if (changes.empty())
+            return;
+        rowCache_.clear();
+        std::vector<int> updated;
+        for (const TransferTaskChange &c : changes) {
+            switch (c.kind) {
+            case TransferTaskChange::Kind::Appended:
+                beginInsertRows(QModelIndex(), c.row, c.row + c.count - 1);
+                rows_ += c.count;
+                endInsertRows();
+                break;
+            case TransferTaskChange::Kind::Removed:
+                beginRemoveRows(QModelIndex(), c.row, c.row + c.count - 1);
+                rows_ -= c.count;
+                endRemoveRows();
+                break;
+            case TransferTaskChange::Kind::Updated:
+                if (c.row >= 0 && c.row < rows_)
+                    updated.push_back(c.row);
                 break;
             }
         }
-        if (orderChanged) {
-            beginResetModel();
-            tasks_ = incoming;
-            endResetModel();
-            return;
+        std::sort(updated.begin(), updated.end());
+        updated.erase(std::unique(updated.begin(), updated.end()),
+                      updated.end());
+        // One dataChanged() per run of adjacent rows.
+        for (std::size_t k = 0; k < updated.size();) {
+            std::size_t end = k + 1;
+            while (end < updated.size() &&
+                   updated[end] == updated[end - 1] + 1)
+                ++end;
+            emit dataChanged(index(updated[k], 0),
+                             index(updated[end - 1], ColCount - 1),
+                             {Qt::DisplayRole, Qt::TextAlignmentRole,
+                              Qt::ToolTipRole, StatusRole, TaskIdRole,
+                              ProgressRole, TypeRole, SourceRole,
+                              DestinationRole});
+            k = end;
         }
+    }
 
-        for (int row = 0; row < tasks_.size(); ++row) {
-            const auto &prev = tasks_[row];
-            const auto &next = incoming[row];
-            const bool changed =
-                prev.type != next.type || prev.src != next.src ||
-                prev.dst != next.dst || prev.status != next.status ||
-                prev.progress != next.progress ||
-                prev.bytesDone != next.bytesDone ||
-                prev.bytesTotal != next.bytesTotal ||
-                prev.currentSpeedKBps != next.currentSpeedKBps ||
-                prev.etaSeconds != next.etaSeconds ||
-                prev.attempts != next.attempts ||
-                prev.maxAttempts != next.maxAttempts ||
-                prev.error != next.error;
-            tasks_[row] = next;
-            if (changed) {
-                emit dataChanged(index(row, 0), index(row, ColCount - 1),
-                                 {Qt::DisplayRole, Qt::TextAlignmentRole,
-                                  Qt::ToolTipRole, StatusRole, TaskIdRole,
-                                  ProgressRole, TypeRole, SourceRole,
-                                  DestinationRole});
-            }
+    // Repaint the given tasks after a progress-only batch; rows are never
+    // added or removed here.
+    void updateProgress(const QVector<quint64> &ids) {
+        for (quint64 id : ids) {
+            const int row = mgr_->rowOf(id);
+            if (row < 0 || row >= rows_)
+                continue;
+            rowCache_.remove(row);
+            emit dataChanged(index(row, 0), index(row, ColCount - 1),
+                             {Qt::DisplayRole, Qt::ToolTipRole, ProgressRole});
         }
     }
 
-    const QVector<TransferTask> &tasks() const { return tasks_; }
-
     private:
-    QVector<TransferTask> tasks_;
+    // Rows of the queue are read from the manager as the view asks for
+    // them; the few on screen are kept until the next change.
+    const TransferTask *taskAt(int row) const {
+        if (row < 0 || row >= rows_)
+            return nullptr;
+        auto it = rowCache_.find(row);
+        if (it != rowCache_.end())
+            return &it.value();
+        TransferTask t{TransferTask::Type::Upload};
+        if (!mgr_->taskAt(row, t))
+            return nullptr;
+        if (rowCache_.size() >= kRowCacheSize)
+            rowCache_.clear();
+        return &rowCache_.insert(row, std::move(t)).value();
+    }
+
+    // Rows read after an insertion are those of the queue as it is now;
+    // a removal later in the same batch would shift them under the view.
+    static bool
+    canApplyInPlace(const std::vector<TransferTaskChange> &changes) {
+        bool appended = false;
+        for (const TransferTaskChange &c : changes) {
+            if (c.kind == TransferTaskChange::Kind::Appended)
+                appended = true;
+            else if (c.kind == TransferTaskChange::Kind::Removed && appended)
+                return false;
+        }
+        return true;
+    }
+
+    void reload() {
+        beginResetModel();
+        rowCache_.clear();
+        rows_ = mgr_->taskCount(version_);
+        endResetModel();
+    }
+
+    static constexpr int kRowCacheSize = 256;
+    TransferManager *mgr_;
+    int rows_ = 0;
+    quint64 version_ = 0; // of the manager's change log
+    mutable QHash<int, TransferTask> rowCache_; // row -> task
 };
 
 class TransferTaskFilterProxyModel final : public QSortFilterProxyModel {
@@ -460,7 +526,7 @@ TransferQueueDialog::TransferQueueDialog(TransferManager *mgr, QWidget *parent)
     lay->addWidget(filters);
 
     // Row 2: table
-    model_ = new TransferTaskTableModel(this);
+    model_ = new TransferTaskTableModel(mgr_, this);
     proxy_ = new TransferTaskFilterProxyModel(this);
     proxy_->setSourceModel(model_);
 
@@ -663,25 +729,41 @@ TransferQueueDialog::TransferQueueDialog(TransferManager *mgr, QWidget *parent)
 
     connect(mgr_, &TransferManager::tasksChanged, this,
             &TransferQueueDialog::refresh);
+    connect(mgr_, &TransferManager::tasksUpdated, this,
+            &TransferQueueDialog::onTasksUpdated);
     connect(table_->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &TransferQueueDialog::updateSummary);
     connect(table_, &QTableView::customContextMenuRequested, this,
             &TransferQueueDialog::showContextMenu);
     connect(this, &QDialog::finished, this, [this] { saveUiState(); });
 
+    // Finished tasks expire with time, not with queue changes.
+    auto *autoClearTimer = new QTimer(this);
+    autoClearTimer->setInterval(kAutoClearCheckMs);
+    connect(autoClearTimer, &QTimer::timeout, this,
+            &TransferQueueDialog::maybeAutoClear);
+    autoClearTimer->start();
+
     loadUiState();
     refresh();
+    maybeAutoClear();
 }
 
 void TransferQueueDialog::refresh() {
     if (!model_)
         return;
-    const auto snapshot = mgr_->tasksSnapshot();
-    model_->sync(snapshot);
-    maybeAutoClear(snapshot);
+    model_->sync();
     updateSummary();
 }
 
+void TransferQueueDialog::onTasksUpdated(const QVector<quint64> &ids) {
+    if (!model_ || ids.isEmpty())
+        return;
+    // Progress-only batch: repaint just the changed rows, leave badges
+    // alone.
+    model_->updateProgress(ids);
+}
+
 void TransferQueueDialog::onPause() { mgr_->pauseAll(); }
 void TransferQueueDialog::onResume() { mgr_->resumeAll(); }
 void TransferQueueDialog::onRetry() { mgr_->retryFailed(); }
@@ -691,15 +773,9 @@ void TransferQueueDialog::onPauseSelected() {
     const auto ids = selectedTaskIds();
     if (ids.isEmpty())
         return;
-    const auto snapshot = mgr_->tasksSnapshot();
-    for (quint64 id : ids) {
-        for (const auto &t : snapshot) {
-            if (t.id != id)
-                continue;
-            if (canPauseStatus(t.status))
-                mgr_->pauseTask(id);
-            break;
-        }
+    for (const auto &t : mgr_->tasksSnapshot(ids)) {
+        if (canPauseStatus(t.status))
+            mgr_->pauseTask(t.id);
     }
 }
 
@@ -707,15 +783,9 @@ void TransferQueueDialog::onResumeSelected() {
     const auto ids = selectedTaskIds();
     if (ids.isEmpty())
         return;
-    const auto snapshot = mgr_->tasksSnapshot();
-    for (quint64 id : ids) {
-        for (const auto &t : snapshot) {
-            if (t.id != id)
-                continue;
-            if (canResumeStatus(t.status))
-                mgr_->resumeTask(id);
-            break;
-        }
+    for (const auto &t : mgr_->tasksSnapshot(ids)) {
+        if (canResumeStatus(t.status))
+            mgr_->resumeTask(t.id);
     }
 }
 
@@ -728,17 +798,11 @@ void TransferQueueDialog::onLimitSelected() {
     const auto ids = selectedTaskIds();
     if (ids.isEmpty())
         return;
-    const auto snapshot = mgr_->tasksSnapshot();
     QVector<quint64> eligible;
     eligible.reserve(ids.size());
-    for (quint64 id : ids) {
-        for (const auto &t : snapshot) {
-            if (t.id != id)
-                continue;
-            if (canLimitStatus(t.status))
-                eligible.push_back(id);
-            break;
-        }
+    for (const auto &t : mgr_->tasksSnapshot(ids)) {
+        if (canLimitStatus(t.status))
+            eligible.push_back(t.id);
     }
     if (eligible.isEmpty())
         return;
@@ -757,15 +821,9 @@ void TransferQueueDialog::onStopSelected() {
     const auto ids = selectedTaskIds();
     if (ids.isEmpty())
         return;
-    const auto snapshot = mgr_->tasksSnapshot();
-    for (quint64 id : ids) {
-        for (const auto &t : snapshot) {
-            if (t.id != id)
-                continue;
-            if (canCancelStatus(t.status))
-                mgr_->cancelTask(id);
-            break;
-        }
+    for (const auto &t : mgr_->tasksSnapshot(ids)) {
+        if (canCancelStatus(t.status))
+            mgr_->cancelTask(t.id);
     }
 }
 
@@ -785,15 +843,9 @@ void TransferQueueDialog::onRetrySelected() {
     const auto ids = selectedTaskIds();
     if (ids.isEmpty())
         return;
-    const auto snapshot = mgr_->tasksSnapshot();
-    for (quint64 id : ids) {
-        for (const auto &t : snapshot) {
-            if (t.id != id)
-                continue;
-            if (canRetryStatus(t.status))
-                mgr_->retryTask(id);
-            break;
-        }
+    for (const auto &t : mgr_->tasksSnapshot(ids)) {
+        if (canRetryStatus(t.status))
+            mgr_->retryTask(t.id);
     }
 }
 
@@ -802,29 +854,25 @@ void TransferQueueDialog::onOpenDestination() {
     if (ids.isEmpty())
         return;
 
-    const auto snapshot = mgr_->tasksSnapshot();
     QSet<QString> opened;
-    for (quint64 id : ids) {
-        for (const auto &t : snapshot) {
-            if (t.id != id)
-                continue;
-            if (t.type != TransferTask::Type::Download)
-                break;
-
-            QString path = t.dst;
-            QFileInfo fi(path);
-            if (!fi.exists()) {
-                const QString parent = fi.dir().absolutePath();
-                if (!parent.isEmpty() && QDir(parent).exists())
-                    path = parent;
-            }
-            const QString normalized = QFileInfo(path).absoluteFilePath();
-            if (normalized.isEmpty() || opened.contains(normalized))
-                break;
-            opened.insert(normalized);
-            QDesktopServices::openUrl(QUrl::fromLocalFile(normalized));
-            break;
+    for (const auto &t : mgr_->tasksSnapshot(ids)) {
+        // Only local destinations can be opened.
+        if (t.type == TransferTask::Type::Upload ||
+            t.type == TransferTask::Type::RemoteCopy)
+            continue;
+
+        QString path = t.dst;
+        QFileInfo fi(path);
+        if (!fi.exists()) {
+            const QString parent = fi.dir().absolutePath();
+            if (!parent.isEmpty() && QDir(parent).exists())
+                path = parent;
         }
+        const QString normalized = QFileInfo(path).absoluteFilePath();
+        if (normalized.isEmpty() || opened.contains(normalized))
+            continue;
+        opened.insert(normalized);
+        QDesktopServices::openUrl(QUrl::fromLocalFile(normalized));
     }
 }
 
@@ -832,17 +880,9 @@ void TransferQueueDialog::onCopySourcePath() {
     const auto ids = selectedTaskIds();
     if (ids.isEmpty())
         return;
-    const auto snapshot = mgr_->tasksSnapshot();
-
     QStringList lines;
-    for (quint64 id : ids) {
-        for (const auto &t : snapshot) {
-            if (t.id == id) {
-                lines << t.src;
-                break;
-            }
-        }
-    }
+    for (const auto &t : mgr_->tasksSnapshot(ids))
+        lines << t.src;
     if (!lines.isEmpty())
         QGuiApplication::clipboard()->setText(lines.join("\n"));
 }
@@ -851,17 +891,9 @@ void TransferQueueDialog::onCopyDestinationPath() {
     const auto ids = selectedTaskIds();
     if (ids.isEmpty())
         return;
-    const auto snapshot = mgr_->tasksSnapshot();
-
     QStringList lines;
-    for (quint64 id : ids) {
-        for (const auto &t : snapshot) {
-            if (t.id == id) {
-                lines << t.dst;
-                break;
-            }
-        }
-    }
+    for (const auto &t : mgr_->tasksSnapshot(ids))
+        lines << t.dst;
     if (!lines.isEmpty())
         QGuiApplication::clipboard()->setText(lines.join("\n"));
 }
@@ -880,40 +912,24 @@ void TransferQueueDialog::onAutoClearChanged() {
         return;
     saveUiState();
     updateSummary();
+    maybeAutoClear();
 }
 
 void TransferQueueDialog::updateSummary() {
     if (!model_)
         return;
 
-    const auto &tasks = model_->tasks();
-    int queued = 0, running = 0, paused = 0, done = 0, error = 0, canceled = 0;
-    for (const auto &t : tasks) {
-        switch (t.status) {
-        case TransferTask::Status::Queued:
-            ++queued;
-            break;
-        case TransferTask::Status::Running:
-            ++running;
-            break;
-        case TransferTask::Status::Paused:
-            ++paused;
-            break;
-        case TransferTask::Status::Done:
-            ++done;
-            break;
-        case TransferTask::Status::Error:
-            ++error;
-            break;
-        case TransferTask::Status::Canceled:
-            ++canceled;
-            break;
-        }
-    }
+    const TransferQueueCounts counts = mgr_->statusCounts();
+    const int queued = counts.queued;
+    const int running = counts.running;
+    const int paused = counts.paused;
+    const int done = counts.done;
+    const int error = counts.error;
+    const int canceled = counts.canceled;
 
     const int active = queued + running + paused;
     if (badgeTotal_)
-        badgeTotal_->setText(tr("Total: %1").arg(tasks.size()));
+        badgeTotal_->setText(tr("Total: %1").arg(counts.total));
     if (badgeActive_)
         badgeActive_->setText(tr("Active: %1").arg(active));
     if (badgeRunning_)
@@ -933,7 +949,7 @@ void TransferQueueDialog::updateSummary() {
                                      : tr("Global limit: off"));
     }
 
-    const bool hasAny = !tasks.isEmpty();
+    const bool hasAny = counts.total > 0;
     const bool queuePaused = mgr_ && mgr_->isQueuePaused();
     const bool canPause = !queuePaused && (queued + running) > 0;
     const bool canResume = queuePaused || paused > 0;
@@ -942,7 +958,7 @@ void TransferQueueDialog::updateSummary() {
     const bool canClearFailed = (error + canceled) > 0;
     const bool canCancelAll = active > 0;
     const auto selectedState =
-        buildSelectedActionsState(selectedTaskIds(), tasks);
+        buildSelectedActionsState(mgr_->tasksSnapshot(selectedTaskIds()));
 
     if (pauseBtn_)
         pauseBtn_->setEnabled(hasAny && canPause);
@@ -1000,8 +1016,8 @@ void TransferQueueDialog::showContextMenu(const QPoint &pos) {
     }
 
     const auto ids = selectedTaskIds();
-    const auto snapshot = mgr_->tasksSnapshot();
-    const auto selectedState = buildSelectedActionsState(ids, snapshot);
+    const auto selectedState =
+        buildSelectedActionsState(mgr_->tasksSnapshot(ids));
 
     QMenu menu(this);
     QAction *actPauseSel = menu.addAction(tr("Pause selected"));
@@ -1009,6 +1025,14 @@ void TransferQueueDialog::showContextMenu(const QPoint &pos) {
     QAction *actLimitSel = menu.addAction(tr("Limit selected"));
     QAction *actCancelSel = menu.addAction(tr("Cancel selected"));
     QAction *actRetrySel = menu.addAction(tr("Retry selected"));
+    QMenu *priorityMenu = menu.addMenu(tr("Priority"));
+    QAction *actPrioHigh = priorityMenu->addAction(tr("High"));
+    QAction *actPrioNormal = priorityMenu->addAction(tr("Normal"));
+    QAction *actPrioLow = priorityMenu->addAction(tr("Low"));
+    actPrioHigh->setData(static_cast<int>(openscp::TransferPriority::High));
+    actPrioNormal->setData(
+        static_cast<int>(openscp::TransferPriority::Normal));
+    actPrioLow->setData(static_cast<int>(openscp::TransferPriority::Low));
     menu.addSeparator();
     QAction *actOpenDest = menu.addAction(tr("Open destination"));
     QAction *actCopySrc = menu.addAction(tr("Copy source path"));
@@ -1021,6 +1045,7 @@ void TransferQueueDialog::showContextMenu(const QPoint &pos) {
     actLimitSel->setEnabled(selectedState.canLimit);
     actCancelSel->setEnabled(selectedState.canCancel);
     actRetrySel->setEnabled(selectedState.canRetry);
+    priorityMenu->setEnabled(selectedState.hasSelection);
     actOpenDest->setEnabled(selectedState.canOpenDestination);
     actCopySrc->setEnabled(selectedState.hasSelection);
     actCopyDst->setEnabled(selectedState.hasSelection);
@@ -1039,6 +1064,13 @@ void TransferQueueDialog::showContextMenu(const QPoint &pos) {
         onStopSelected();
     else if (chosen == actRetrySel)
         onRetrySelected();
+    else if (chosen == actPrioHigh || chosen == actPrioNormal ||
+             chosen == actPrioLow) {
+        const auto priority =
+            static_cast<openscp::TransferPriority>(chosen->data().toInt());
+        for (quint64 id : ids)
+            mgr_->setTaskPriority(id, priority);
+    }
     else if (chosen == actOpenDest)
         onOpenDestination();
     else if (chosen == actCopySrc)
@@ -1124,8 +1156,7 @@ void TransferQueueDialog::saveUiState() const {
     s.sync();
 }
 
-void TransferQueueDialog::maybeAutoClear(
-    const QVector<TransferTask> &snapshot) {
+void TransferQueueDialog::maybeAutoClear() {
     if (!autoClearModeCombo_ || !autoClearMinutesSpin_)
         return;
 
@@ -1137,29 +1168,7 @@ void TransferQueueDialog::maybeAutoClear(
     if (minutes <= 0)
         return;
 
-    const qint64 cutoff =
-        QDateTime::currentMSecsSinceEpoch() - qint64(minutes) * 60 * 1000;
-    bool needsCleanup = false;
-    for (const auto &t : snapshot) {
-        const bool isDone = t.status == TransferTask::Status::Done;
-        const bool isFailed = (t.status == TransferTask::Status::Error ||
-                               t.status == TransferTask::Status::Canceled);
-        bool candidate = false;
-        if (mode == AutoClearCompleted)
-            candidate = isDone;
-        else if (mode == AutoClearFailedCanceled)
-            candidate = isFailed;
-        else if (mode == AutoClearFinished)
-            candidate = (isDone || isFailed);
-
-        if (candidate && t.finishedAtMs > 0 && t.finishedAtMs <= cutoff) {
-            needsCleanup = true;
-            break;
-        }
-    }
-    if (!needsCleanup)
-        return;
-
+    // The manager removes only what expired and signals only if it did.
     if (mode == AutoClearCompleted)
         mgr_->clearFinishedOlderThan(minutes, true, false);
     else if (mode == AutoClearFailedCanceled)
@@ -23,6 +23,7 @@ class TransferQueueDialog : public QDialog {
 
     private slots:
     void refresh();            // refresh table from manager
+    void onTasksUpdated(const QVector<quint64> &ids); // progress-only rows
     void onPause();            // pause the whole queue
     void onResume();           // resume the queue (and paused tasks)
     void onRetry();            // retry failed/canceled
@@ -62,7 +63,7 @@ class TransferQueueDialog : public QDialog {
     QVector<quint64> selectedTaskIds() const;
     void loadUiState();
     void saveUiState() const;
-    void maybeAutoClear(const QVector<TransferTask> &snapshot);
+    void maybeAutoClear(); // drop finished tasks past the auto-clear age
     void closeEvent(QCloseEvent *e) override;
 
     TransferManager *mgr_;                    // source of truth for the queue
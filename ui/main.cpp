@@ -1,6 +1,7 @@
 // Application entry point: initialize Qt and show MainWindow.
 #include "AppVersion.hpp"
 #include "MainWindow.hpp"
+#include "openscp/Trace.hpp"
 #include <QApplication>
 #include <QDir>
 #include <QFile>
@@ -11,6 +12,7 @@
 
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
+    openscp::setTraceThreadName("ui");
     QCoreApplication::setApplicationName("OpenSCP");
     QCoreApplication::setOrganizationName("OpenSCP");
     QCoreApplication::setApplicationVersion(
@@ -44,7 +46,18 @@ int main(int argc, char *argv[]) {
     if (qtTranslator.load(qtBaseName, qtTransPath)) {
         app.installTranslator(&qtTranslator);
     }
-    MainWindow w;
-    w.show();
-    return app.exec();
+    int rc = 0;
+    {
+        MainWindow w;
+        w.show();
+        rc = app.exec();
+    }
+    // OPENSCP_TRACE=<file.json>: dump the spans once the window (and its
+    // transfer workers) are gone.
+    if (!openscp::traceOutputPath().empty()) {
+        std::string err;
+        if (!openscp::writeChromeTrace(openscp::traceOutputPath(), err))
+            qWarning("%s", err.c_str());
+    }
+    return rc;
 }